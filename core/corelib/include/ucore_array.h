@@ -0,0 +1,9 @@
+#ifndef UCORE_ARRAY_H
+#define UCORE_ARRAY_H
+
+#include "vm.h"
+
+// Register ucoreArray native functions (typed arrays and bulk operations)
+void registerUCoreArray(VM* vm);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef UCORE_GC_H
+#define UCORE_GC_H
+
+#include "vm.h"
+
+// Register ucoreGC native functions (collector statistics and tuning)
+void registerUCoreGC(VM* vm);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef UCORE_HTTP_CLIENT_H
+#define UCORE_HTTP_CLIENT_H
+
+#include "vm.h"
+
+/**
+ * Shared HTTP/1.1 client engine (ucoreHttp client calls, ucoreScraper.fetch)
+ * - Per-host keep-alive connection pool and DNS cache
+ * - Content-Length, chunked and read-to-EOF bodies
+ * - Socket waits yield to the async scheduler when called from a task
+ * Plain http:// only (no TLS).
+ */
+
+#define HTTP_CLIENT_MAX_REDIRECTS 5
+
+typedef struct HttpClientResponse {
+    int status;             // HTTP status code
+    char* body;             // Response body (malloc'd, NUL-terminated)
+    size_t bodyLen;
+    char location[1024];    // Location header of an unfollowed redirect ("" if none)
+} HttpClientResponse;
+
+// Perform a request, following up to maxRedirects http:// redirects.
+// Returns false on URL/transport errors (already reported); on success
+// the caller owns resp->body and must call httpClientFreeResponse().
+bool httpClientRequest(VM* vm, const char* method, const char* url,
+                       const char* body, size_t bodyLen, int maxRedirects,
+                       HttpClientResponse* resp);
+
+void httpClientFreeResponse(HttpClientResponse* resp);
+
+#endif // UCORE_HTTP_CLIENT_H
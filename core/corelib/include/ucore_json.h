@@ -6,4 +6,13 @@
 // Register the ucoreJson module with the VM
 void registerUCoreJson(VM* vm);
 
+// Receives stringified JSON in chunks; returns false on a write error
+typedef bool (*JsonSinkFn)(void* ctx, const char* data, size_t length);
+
+// Stringify 'value' (like ucoreJson.stringify) through 'sink', in chunks of
+// about 64 KB, without holding the whole text in memory. The last chunk may
+// be shorter; a value under 64 KB arrives as one call. Returns false if the
+// sink failed.
+bool jsonStreamValue(VM* vm, Value value, JsonSinkFn sink, void* ctx);
+
 #endif // UCORE_JSON_H
@@ -11,35 +11,100 @@ typedef enum {
     NODE_DOCUMENT  // Root node
 } ScraperNodeType;
 
-// DOM Node Structure
+// Bump allocator owning everything in one document: nodes, strings and
+// attribute arrays are released together when the document is freed
+typedef struct ScraperArenaBlock {
+    struct ScraperArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ScraperArenaBlock;
+
+typedef struct {
+    ScraperArenaBlock* head;
+} ScraperArena;
+
+// Arena position to roll back to (streaming pops each closed element)
+typedef struct {
+    ScraperArenaBlock* block;
+    size_t used;
+} ScraperArenaMark;
+
+// Attribute; 'name' is interned in the document (compare by pointer)
+typedef struct {
+    const char* name;
+    const char* value;
+} ScraperAttr;
+
+// DOM Node Structure (arena-allocated)
 typedef struct ScraperNode {
     ScraperNodeType type;
-    char* tagName;       // For elements (e.g., "div", "a"). Canonicalized to lowercase.
-    char* textContent;   // For text nodes and comments.
-    
+    const char* tagName;     // For elements (e.g., "div", "a"). Lowercase, interned.
+    const char* textContent; // For text nodes and comments.
+    int textLength;
+
     // Hierarchy
     struct ScraperNode* parent;
-    struct ScraperNode** children;
-    int childCount;
-    int childCapacity;
-    
-    // Attributes (key/value pairs)
-    char** attrKeys;
-    char** attrValues;
+    struct ScraperNode* firstChild;
+    struct ScraperNode* lastChild;
+    struct ScraperNode* nextSibling;
+
+    // Attributes
+    ScraperAttr* attrs;
     int attrCount;
-    int attrCapacity;
-    
+
+    // Selector keys, interned like tag names
+    const char* id;          // Value of the id attribute, or NULL
+    const char** classes;    // Whitespace-separated tokens of the class attribute
+    int classCount;
+
     // Quick flags
     bool isSelfClosing;
-    
+
 } ScraperNode;
 
+// Interned names of one document (tags, attribute names, ids, classes)
+typedef struct {
+    const char** entries;    // Open addressing, NULL when empty
+    unsigned int* hashes;
+    int count;
+    int capacity;            // Power of two
+} ScraperNames;
+
+// Elements grouped by an interned key (tag, id or class)
+typedef struct {
+    const char* key;
+    int start;               // Into ScraperIndex.items
+    int count;
+} ScraperIndexSlot;
+
+typedef struct {
+    ScraperIndexSlot* slots; // Open addressing by key pointer
+    int capacity;            // Power of two, 0 until built
+    ScraperNode** items;     // Element lists in document order, back to back
+} ScraperIndex;
+
+// A parsed document
+typedef struct {
+    ScraperArena arena;
+    ScraperNames names;
+    ScraperNode* root;
+    ScraperNode** elements;  // Every element in document order
+    int elementCount;
+    int elementCapacity;
+    bool indexed;            // byTag/byId/byClass built (on first reuse)
+    bool namesFrozen;        // Streaming: unknown names are copied, not interned
+    ScraperIndex byTag;
+    ScraperIndex byId;
+    ScraperIndex byClass;
+} ScraperDocument;
+
 // Parser State
 typedef struct {
     const char* source;
     int length;
     int current;
-    ScraperNode* document;
+    ScraperDocument* document;
     ScraperNode* currentNode;
 } HtmlParser;
 
@@ -50,18 +115,33 @@ typedef enum {
     COMBINATOR_CHILD,       // ">"
 } SelectorCombinator;
 
+typedef struct {
+    char* name;         // Lowercase
+    char* value;        // NULL for [name]
+} SelectorAttr;
+
+// One compound selector: "div#main.card[href]"
+typedef struct {
+    char* tagName;      // NULL matches any tag
+    char* id;
+    char** classes;
+    int classCount;
+    SelectorAttr* attrs;
+    int attrCount;
+    SelectorCombinator combinator; // Relation to the compound on the left
+} SelectorCompound;
+
+// Compiled selector, compounds left to right; the last is the subject
 typedef struct ScraperSelector {
-    char* tagName;      // "div"
-    char* id;           // "main"
-    char* className;    // "container" (supports single class for now, or use list)
-    
-    struct ScraperSelector* next; // For combinators: "div > p" (this is p, next is div)
-    SelectorCombinator combinator; 
+    SelectorCompound* parts;
+    int count;
+    int nameCount;      // Names to bind against a document per match
 } ScraperSelector;
 
 // Public API
 void registerUCoreScraper(VM* vm);
-ScraperNode* scraper_parseHtml(const char* source); // Exposed for testing
+ScraperDocument* scraper_parseHtml(const char* source, int length);
+void scraper_freeDocument(ScraperDocument* doc);
 
 
 #endif
@@ -0,0 +1,9 @@
+#ifndef UCORE_THREAD_H
+#define UCORE_THREAD_H
+
+#include "vm.h"
+
+// Register ucoreThread native functions (worker isolates and channels)
+void registerUCoreThread(VM* vm);
+
+#endif
@@ -0,0 +1,444 @@
+#include "ucore_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bulk loops are written so the compiler can vectorize them (-O3
+// -march=native). Floating-point reductions keep LANES independent partial
+// results, since reassociating a single accumulator is not allowed.
+#define LANES 8
+
+static const char* kindName(TypedKind kind) {
+    return kind == TYPED_INT32 ? "Int32Array" : "Float64Array";
+}
+
+// Sums and dot products of int32 data can outgrow INT_VAL's 32 bits
+static Value wideVal(int64_t n) {
+    if (n >= INT32_MIN && n <= INT32_MAX) return INT_VAL((int32_t)n);
+    return FLOAT_VAL((double)n);
+}
+
+static TypedArray* typedArg(Value* args, int argCount, int i, const char* fn) {
+    if (argCount <= i || !IS_TYPED_ARRAY(args[i])) {
+        printf("Error: ucoreArray.%s expects a typed array.\n", fn);
+        return NULL;
+    }
+    return AS_TYPED_ARRAY(args[i]);
+}
+
+// ---- Construction ----
+
+// int32(n) / float64(n): n zeros. int32(array) / float64(array): converted
+// copy of an array or typed array (floats are truncated into Int32Arrays).
+static Value makeTyped(VM* vm, TypedKind kind, const char* fn, Value* args, int argCount) {
+    if (argCount != 1) {
+        printf("Error: ucoreArray.%s expects a length or an array.\n", fn);
+        return NIL_VAL;
+    }
+    Value src = args[0];
+    if (IS_INT(src)) {
+        if (AS_INT(src) < 0) {
+            printf("Error: ucoreArray.%s length must not be negative.\n", fn);
+            return NIL_VAL;
+        }
+        return OBJ_VAL(newTypedArray(vm, kind, AS_INT(src)));
+    }
+    if (IS_ARRAY(src)) {
+        Array* arr = (Array*)AS_OBJ(src);
+        TypedArray* ta = newTypedArray(vm, kind, arr->count);
+        for (int i = 0; i < arr->count; i++) {
+            if (!typedArraySet(ta, i, arr->items[i])) {
+                printf("Error: ucoreArray.%s: element %d does not fit in a %s.\n", fn, i, kindName(kind));
+                return NIL_VAL;
+            }
+        }
+        return OBJ_VAL(ta);
+    }
+    if (IS_TYPED_ARRAY(src)) {
+        TypedArray* from = AS_TYPED_ARRAY(src);
+        TypedArray* ta = newTypedArray(vm, kind, from->count);
+        if (from->kind == kind) {
+            memcpy(ta->data, from->data, (size_t)from->count * typedElementSize(kind));
+            return OBJ_VAL(ta);
+        }
+        for (int i = 0; i < from->count; i++) {
+            if (!typedArraySet(ta, i, typedArrayGet(from, i))) {
+                printf("Error: ucoreArray.%s: element %d does not fit in a %s.\n", fn, i, kindName(kind));
+                return NIL_VAL;
+            }
+        }
+        return OBJ_VAL(ta);
+    }
+    printf("Error: ucoreArray.%s expects a length or an array.\n", fn);
+    return NIL_VAL;
+}
+
+// Native ucoreArray.int32(n | array)
+static Value uarr_int32(VM* vm, Value* args, int argCount) {
+    return makeTyped(vm, TYPED_INT32, "int32", args, argCount);
+}
+
+// Native ucoreArray.float64(n | array)
+static Value uarr_float64(VM* vm, Value* args, int argCount) {
+    return makeTyped(vm, TYPED_FLOAT64, "float64", args, argCount);
+}
+
+// Native ucoreArray.toArray(ta)
+// Returns a regular array holding the elements
+static Value uarr_toArray(VM* vm, Value* args, int argCount) {
+    TypedArray* ta = typedArg(args, argCount, 0, "toArray");
+    if (!ta) return NIL_VAL;
+    Array* arr = newArray(vm);
+    if (ta->count == 0) return OBJ_VAL(arr);
+    vm->stack[vm->stackTop++] = OBJ_VAL(arr); // Root across the item allocation
+    arr->items = (Value*)reallocate(vm, NULL, 0, sizeof(Value) * ta->count);
+    vm->stackTop--;
+    if (!arr->items) {
+        printf("Fatal Error: Array allocation failed.\n");
+        exit(1);
+    }
+    arr->capacity = ta->count;
+    for (int i = 0; i < ta->count; i++) arr->items[i] = typedArrayGet(ta, i);
+    arr->count = ta->count;
+    return OBJ_VAL(arr);
+}
+
+// Native ucoreArray.fill(ta, value)
+// Sets every element to 'value'; returns ta
+static Value uarr_fill(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    TypedArray* ta = typedArg(args, argCount, 0, "fill");
+    if (!ta) return NIL_VAL;
+    if (argCount != 2) {
+        printf("Error: ucoreArray.fill expects (typedArray, value).\n");
+        return NIL_VAL;
+    }
+    if (ta->count == 0) return args[0];
+    // Convert once through element 0, then replicate
+    if (!typedArraySet(ta, 0, args[1])) {
+        printf("Error: ucoreArray.fill: value does not fit in a %s.\n", kindName(ta->kind));
+        return NIL_VAL;
+    }
+    int n = ta->count;
+    if (ta->kind == TYPED_INT32) {
+        int32_t v = ta->i32[0];
+        int32_t* x = ta->i32;
+        for (int i = 1; i < n; i++) x[i] = v;
+    } else {
+        double v = ta->f64[0];
+        double* x = ta->f64;
+        for (int i = 1; i < n; i++) x[i] = v;
+    }
+    return args[0];
+}
+
+// ---- Reductions ----
+
+static int64_t sumInt32(const int32_t* x, int n) {
+    int64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += x[i];
+    return sum;
+}
+
+static double sumFloat64(const double* x, int n) {
+    double acc[LANES] = {0};
+    int i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int l = 0; l < LANES; l++) acc[l] += x[i + l];
+    }
+    double sum = 0;
+    for (int l = 0; l < LANES; l++) sum += acc[l];
+    for (; i < n; i++) sum += x[i];
+    return sum;
+}
+
+// Native ucoreArray.sum(ta)
+// Int32Array sums are exact (float once they leave the int range)
+static Value uarr_sum(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    TypedArray* ta = typedArg(args, argCount, 0, "sum");
+    if (!ta) return NIL_VAL;
+    if (ta->kind == TYPED_INT32) return wideVal(sumInt32(ta->i32, ta->count));
+    return FLOAT_VAL(sumFloat64(ta->f64, ta->count));
+}
+
+// Smallest (wantMax false) or largest element; nil when empty
+static Value extreme(Value* args, int argCount, bool wantMax, const char* fn) {
+    TypedArray* ta = typedArg(args, argCount, 0, fn);
+    if (!ta || ta->count == 0) return NIL_VAL;
+    int n = ta->count;
+    if (ta->kind == TYPED_INT32) {
+        const int32_t* x = ta->i32;
+        int32_t m = x[0];
+        if (wantMax) { for (int i = 1; i < n; i++) m = x[i] > m ? x[i] : m; }
+        else         { for (int i = 1; i < n; i++) m = x[i] < m ? x[i] : m; }
+        return INT_VAL(m);
+    }
+    const double* x = ta->f64;
+    double acc[LANES];
+    for (int l = 0; l < LANES; l++) acc[l] = x[0];
+    int i = 0;
+    if (wantMax) {
+        for (; i + LANES <= n; i += LANES) {
+            for (int l = 0; l < LANES; l++) acc[l] = x[i + l] > acc[l] ? x[i + l] : acc[l];
+        }
+    } else {
+        for (; i + LANES <= n; i += LANES) {
+            for (int l = 0; l < LANES; l++) acc[l] = x[i + l] < acc[l] ? x[i + l] : acc[l];
+        }
+    }
+    double m = acc[0];
+    for (int l = 1; l < LANES; l++) m = wantMax ? (acc[l] > m ? acc[l] : m) : (acc[l] < m ? acc[l] : m);
+    for (; i < n; i++) m = wantMax ? (x[i] > m ? x[i] : m) : (x[i] < m ? x[i] : m);
+    return FLOAT_VAL(m);
+}
+
+// Native ucoreArray.min(ta)
+static Value uarr_min(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    return extreme(args, argCount, false, "min");
+}
+
+// Native ucoreArray.max(ta)
+static Value uarr_max(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    return extreme(args, argCount, true, "max");
+}
+
+// Native ucoreArray.dot(a, b)
+// Sum of a[i] * b[i]; exact for two Int32Arrays
+static Value uarr_dot(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    TypedArray* a = typedArg(args, argCount, 0, "dot");
+    TypedArray* b = a ? typedArg(args, argCount, 1, "dot") : NULL;
+    if (!b) return NIL_VAL;
+    if (a->count != b->count) {
+        printf("Error: ucoreArray.dot: lengths differ (%d and %d).\n", a->count, b->count);
+        return NIL_VAL;
+    }
+    int n = a->count;
+    if (a->kind == TYPED_INT32 && b->kind == TYPED_INT32) {
+        // A sum of 64-bit products can overflow int64; the high and low
+        // 32-bit halves are summed apart and recombined
+        const int32_t* x = a->i32;
+        const int32_t* y = b->i32;
+        int64_t hi = 0;
+        uint64_t lo = 0;
+        for (int i = 0; i < n; i++) {
+            int64_t p = (int64_t)x[i] * y[i];
+            hi += p >> 32;
+            lo += (uint64_t)p & 0xFFFFFFFFu;
+        }
+        hi += (int64_t)(lo >> 32);
+        lo &= 0xFFFFFFFFu;
+        if (hi == 0 && lo <= INT32_MAX) return INT_VAL((int32_t)lo);
+        if (hi == -1 && lo >= 0x80000000u) return INT_VAL((int32_t)(lo - 0x100000000ULL));
+        return FLOAT_VAL((double)hi * 4294967296.0 + (double)lo);
+    }
+    if (a->kind == TYPED_INT32) { TypedArray* t = a; a = b; b = t; } // a is the Float64Array
+    const double* x = a->f64;
+    double acc[LANES] = {0};
+    int i = 0;
+    if (b->kind == TYPED_FLOAT64) {
+        const double* y = b->f64;
+        for (; i + LANES <= n; i += LANES) {
+            for (int l = 0; l < LANES; l++) acc[l] += x[i + l] * y[i + l];
+        }
+        double sum = 0;
+        for (int l = 0; l < LANES; l++) sum += acc[l];
+        for (; i < n; i++) sum += x[i] * y[i];
+        return FLOAT_VAL(sum);
+    }
+    const int32_t* y = b->i32;
+    for (; i + LANES <= n; i += LANES) {
+        for (int l = 0; l < LANES; l++) acc[l] += x[i + l] * (double)y[i + l];
+    }
+    double sum = 0;
+    for (int l = 0; l < LANES; l++) sum += acc[l];
+    for (; i < n; i++) sum += x[i] * (double)y[i];
+    return FLOAT_VAL(sum);
+}
+
+// ---- Element-wise arithmetic (in place) ----
+
+typedef enum { BULK_ADD, BULK_MUL } BulkOp;
+
+// ta[i] = ta[i] op x, where x is a number or a typed array of the same
+// length. Int32Arrays take int operands and wrap around like int math.
+static Value bulkApply(Value* args, int argCount, BulkOp op, const char* fn) {
+    TypedArray* ta = typedArg(args, argCount, 0, fn);
+    if (!ta) return NIL_VAL;
+    if (argCount != 2) {
+        printf("Error: ucoreArray.%s expects (typedArray, number or typedArray).\n", fn);
+        return NIL_VAL;
+    }
+    Value operand = args[1];
+    int n = ta->count;
+
+    if (IS_TYPED_ARRAY(operand)) {
+        TypedArray* src = AS_TYPED_ARRAY(operand);
+        if (src->count != n) {
+            printf("Error: ucoreArray.%s: lengths differ (%d and %d).\n", fn, n, src->count);
+            return NIL_VAL;
+        }
+        if (ta->kind == TYPED_INT32) {
+            if (src->kind != TYPED_INT32) {
+                printf("Error: ucoreArray.%s: an Int32Array can only take an Int32Array.\n", fn);
+                return NIL_VAL;
+            }
+            uint32_t* x = (uint32_t*)ta->i32;
+            const uint32_t* y = (const uint32_t*)src->i32;
+            if (op == BULK_ADD) { for (int i = 0; i < n; i++) x[i] = x[i] + y[i]; }
+            else                { for (int i = 0; i < n; i++) x[i] = x[i] * y[i]; }
+        } else if (src->kind == TYPED_FLOAT64) {
+            double* x = ta->f64;
+            const double* y = src->f64;
+            if (op == BULK_ADD) { for (int i = 0; i < n; i++) x[i] = x[i] + y[i]; }
+            else                { for (int i = 0; i < n; i++) x[i] = x[i] * y[i]; }
+        } else {
+            double* x = ta->f64;
+            const int32_t* y = src->i32;
+            if (op == BULK_ADD) { for (int i = 0; i < n; i++) x[i] = x[i] + (double)y[i]; }
+            else                { for (int i = 0; i < n; i++) x[i] = x[i] * (double)y[i]; }
+        }
+        return args[0];
+    }
+
+    if (ta->kind == TYPED_INT32) {
+        if (!IS_INT(operand)) {
+            printf("Error: ucoreArray.%s on an Int32Array expects an int.\n", fn);
+            return NIL_VAL;
+        }
+        uint32_t k = (uint32_t)AS_INT(operand);
+        uint32_t* x = (uint32_t*)ta->i32;
+        if (op == BULK_ADD) { for (int i = 0; i < n; i++) x[i] = x[i] + k; }
+        else                { for (int i = 0; i < n; i++) x[i] = x[i] * k; }
+        return args[0];
+    }
+
+    double k;
+    if (IS_INT(operand)) k = (double)AS_INT(operand);
+    else if (IS_FLOAT(operand)) k = AS_FLOAT(operand);
+    else {
+        printf("Error: ucoreArray.%s expects a number or a typed array.\n", fn);
+        return NIL_VAL;
+    }
+    double* x = ta->f64;
+    if (op == BULK_ADD) { for (int i = 0; i < n; i++) x[i] = x[i] + k; }
+    else                { for (int i = 0; i < n; i++) x[i] = x[i] * k; }
+    return args[0];
+}
+
+// Native ucoreArray.add(ta, x)
+static Value uarr_add(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    return bulkApply(args, argCount, BULK_ADD, "add");
+}
+
+// Native ucoreArray.mul(ta, x)
+static Value uarr_mul(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    return bulkApply(args, argCount, BULK_MUL, "mul");
+}
+
+// ---- Sorting ----
+// LSD radix sort, one byte per pass, on keys whose unsigned order is the
+// element order. All byte histograms come from a single read of the keys,
+// and passes where every key shares the byte are skipped.
+
+#define RADIX_SORT(name, type, bytes)                                          \
+static void name(type* keys, type* tmp, int n) {                               \
+    size_t counts[bytes][256];                                                 \
+    memset(counts, 0, sizeof(counts));                                         \
+    for (int i = 0; i < n; i++) {                                              \
+        type k = keys[i];                                                      \
+        for (int d = 0; d < (bytes); d++) counts[d][(k >> (8 * d)) & 0xFF]++;  \
+    }                                                                          \
+    type* from = keys;                                                         \
+    type* to = tmp;                                                            \
+    for (int d = 0; d < (bytes); d++) {                                        \
+        size_t* c = counts[d];                                                 \
+        if (c[(from[0] >> (8 * d)) & 0xFF] == (size_t)n) continue;             \
+        size_t pos = 0;                                                        \
+        for (int b = 0; b < 256; b++) { size_t t = c[b]; c[b] = pos; pos += t; } \
+        for (int i = 0; i < n; i++) to[c[(from[i] >> (8 * d)) & 0xFF]++] = from[i]; \
+        type* swap = from; from = to; to = swap;                               \
+    }                                                                          \
+    if (from != keys) memcpy(keys, from, sizeof(type) * (size_t)n);            \
+}
+
+RADIX_SORT(radixSort32, uint32_t, 4)
+RADIX_SORT(radixSort64, uint64_t, 8)
+
+// Native ucoreArray.sort(ta)
+// Sorts ascending in place; returns ta
+static Value uarr_sort(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    TypedArray* ta = typedArg(args, argCount, 0, "sort");
+    if (!ta) return NIL_VAL;
+    int n = ta->count;
+    if (n < 2) return args[0];
+
+    if (ta->kind == TYPED_INT32) {
+        // Flipping the sign bit orders two's complement as unsigned
+        uint32_t* keys = (uint32_t*)ta->i32;
+        uint32_t* tmp = malloc(sizeof(uint32_t) * (size_t)n);
+        if (!tmp) { printf("Fatal Error: Sort buffer allocation failed.\n"); exit(1); }
+        for (int i = 0; i < n; i++) keys[i] ^= 0x80000000u;
+        radixSort32(keys, tmp, n);
+        for (int i = 0; i < n; i++) keys[i] ^= 0x80000000u;
+        free(tmp);
+        return args[0];
+    }
+
+    // IEEE doubles: negative values flip all bits, others only the sign
+    uint64_t* keys = malloc(sizeof(uint64_t) * (size_t)n * 2);
+    if (!keys) { printf("Fatal Error: Sort buffer allocation failed.\n"); exit(1); }
+    double* x = ta->f64;
+    for (int i = 0; i < n; i++) {
+        uint64_t bits;
+        memcpy(&bits, &x[i], sizeof(bits));
+        keys[i] = (bits >> 63) ? ~bits : bits | 0x8000000000000000ULL;
+    }
+    radixSort64(keys, keys + n, n);
+    for (int i = 0; i < n; i++) {
+        uint64_t k = keys[i];
+        uint64_t bits = (k >> 63) ? k & 0x7FFFFFFFFFFFFFFFULL : ~k;
+        memcpy(&x[i], &bits, sizeof(bits));
+    }
+    free(keys);
+    return args[0];
+}
+
+void registerUCoreArray(VM* vm) {
+    ObjString* modNameObj = internString(vm, "ucoreArray", 10);
+    char* modName = modNameObj->chars;
+
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
+    Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
+    mod->name = strdup(modName);
+    vm->stackTop--;
+    mod->obj.isMarked = true;
+    mod->obj.isPermanent = true; // PERMANENT ROOT
+
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
+    modEnv->obj.isMarked = true;
+    modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
+    mod->env = modEnv;
+
+    defineNative(vm, mod->env, "int32", uarr_int32, 1);
+    defineNative(vm, mod->env, "float64", uarr_float64, 1);
+    defineNative(vm, mod->env, "toArray", uarr_toArray, 1);
+    defineNative(vm, mod->env, "fill", uarr_fill, 2);
+    defineNative(vm, mod->env, "sum", uarr_sum, 1);
+    defineNative(vm, mod->env, "min", uarr_min, 1);
+    defineNative(vm, mod->env, "max", uarr_max, 1);
+    defineNative(vm, mod->env, "dot", uarr_dot, 2);
+    defineNative(vm, mod->env, "add", uarr_add, 2);
+    defineNative(vm, mod->env, "mul", uarr_mul, 2);
+    defineNative(vm, mod->env, "sort", uarr_sort, 1);
+
+    Value vMod = OBJ_VAL(mod);
+    defineGlobal(vm, "ucoreArray", vMod);
+}
@@ -0,0 +1,146 @@
+#include "ucore_gc.h"
+#include <time.h>
+#include <stdio.h>
+
+// Counters can outgrow INT_VAL's 32 bits
+static Value countVal(uint64_t n) {
+    if (n <= INT32_MAX) return INT_VAL((int)n);
+    return FLOAT_VAL((double)n);
+}
+
+static uint64_t nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// Non-negative int/float argument, or -1 if it is neither
+static double sizeArg(Value v) {
+    double n = -1;
+    if (IS_INT(v)) n = AS_INT(v);
+    else if (IS_FLOAT(v)) n = AS_FLOAT(v);
+    return n < 0 ? -1 : n;
+}
+
+static void setStat(Map* m, const char* key, Value v) {
+    mapSetStr(m, key, (int)strlen(key), v);
+}
+
+// Native ucoreGC.stats()
+// Returns a map of collector counters; times are in microseconds
+static Value ugc_stats(VM* vm, Value* args, int argCount) {
+    (void)args; (void)argCount;
+
+    Map* stats = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(stats); // Root across the array allocation
+
+    uint64_t major = vm->gcCollectCount - vm->gcMinorCount;
+    setStat(stats, "collections", countVal(vm->gcCollectCount));
+    setStat(stats, "minorCollections", countVal(vm->gcMinorCount));
+    setStat(stats, "majorCollections", countVal(major));
+    setStat(stats, "totalPauseUs", countVal(vm->gcTotalPauseUs));
+    setStat(stats, "lastPauseUs", countVal(vm->gcLastPauseUs));
+    setStat(stats, "maxPauseUs", countVal(vm->gcMaxPauseUs));
+
+    // Pause counts per bucket: <100us, <500us, <1ms, <5ms, <10ms, <50ms, <100ms, longer
+    Array* histogram = newArray(vm);
+    setStat(stats, "pauseHistogram", OBJ_VAL(histogram));
+    for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+        arrayPush(vm, histogram, countVal(vm->gcPauseHistogram[i]));
+    }
+
+    uint64_t totalAllocated = (uint64_t)vm->bytesAllocated + vm->gcTotalFreed;
+    double seconds = (double)(nowUs() - vm->gcStartTimeUs) / 1000000.0;
+    setStat(stats, "heapBytes", countVal(vm->bytesAllocated));
+    setStat(stats, "peakMemory", countVal(vm->gcPeakMemory));
+    setStat(stats, "totalFreed", countVal(vm->gcTotalFreed));
+    setStat(stats, "totalAllocated", countVal(totalAllocated));
+    setStat(stats, "allocationRate", FLOAT_VAL(seconds > 0 ? (double)totalAllocated / seconds : 0.0));
+    setStat(stats, "heapPages", countVal(vm->heap.pageCount));
+    setStat(stats, "nurserySize", countVal(vm->nurseryBudget));
+    setStat(stats, "markThreads", INT_VAL(vm->gcMarkThreads));
+    setStat(stats, "targetPauseUs", countVal(vm->gcTargetPauseUs));
+
+    vm->stackTop--;
+    return OBJ_VAL(stats);
+}
+
+// Native ucoreGC.collect()
+// Full collection, including the old-generation sweep
+static Value ugc_collect(VM* vm, Value* args, int argCount) {
+    (void)args; (void)argCount;
+    collectGarbageFull(vm);
+    return NIL_VAL;
+}
+
+// Native ucoreGC.collectMinor()
+static Value ugc_collectMinor(VM* vm, Value* args, int argCount) {
+    (void)args; (void)argCount;
+    collectGarbageMinor(vm);
+    return NIL_VAL;
+}
+
+// Native ucoreGC.setTargetPause(us)
+// 0 restores stop-the-world major collections
+static Value ugc_setTargetPause(VM* vm, Value* args, int argCount) {
+    double us = argCount == 1 ? sizeArg(args[0]) : -1;
+    if (us < 0) {
+        printf("Error: ucoreGC.setTargetPause expects a non-negative number (microseconds).\n");
+        return NIL_VAL;
+    }
+    vm->gcTargetPauseUs = (uint64_t)us;
+    return NIL_VAL;
+}
+
+// Native ucoreGC.setNurserySize(bytes)
+static Value ugc_setNurserySize(VM* vm, Value* args, int argCount) {
+    double bytes = argCount == 1 ? sizeArg(args[0]) : -1;
+    if (bytes < 4096) {
+        printf("Error: ucoreGC.setNurserySize expects a size of at least 4096 bytes.\n");
+        return NIL_VAL;
+    }
+    vm->nurseryBudget = (size_t)bytes;
+    if (vm->gcPhase == 0) vm->nextGC = vm->bytesAllocated + vm->nurseryBudget;
+    return NIL_VAL;
+}
+
+// Native ucoreGC.setMaxHeadroom(bytes)
+// Growth allowed past the live heap before a major collection; 0 = automatic
+static Value ugc_setMaxHeadroom(VM* vm, Value* args, int argCount) {
+    double bytes = argCount == 1 ? sizeArg(args[0]) : -1;
+    if (bytes < 0) {
+        printf("Error: ucoreGC.setMaxHeadroom expects a non-negative size in bytes.\n");
+        return NIL_VAL;
+    }
+    vm->gcMaxHeadroom = (size_t)bytes;
+    return NIL_VAL;
+}
+
+void registerUCoreGC(VM* vm) {
+    ObjString* modNameObj = internString(vm, "ucoreGC", 7);
+    // Use raw chars
+    char* modName = modNameObj->chars;
+
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
+    Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
+    mod->name = strdup(modName);
+    vm->stackTop--;
+    mod->obj.isMarked = true;
+    mod->obj.isPermanent = true; // PERMANENT ROOT
+
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
+    modEnv->obj.isMarked = true;
+    modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
+    mod->env = modEnv;
+
+    defineNative(vm, mod->env, "stats", ugc_stats, 0);
+    defineNative(vm, mod->env, "collect", ugc_collect, 0);
+    defineNative(vm, mod->env, "collectMinor", ugc_collectMinor, 0);
+    defineNative(vm, mod->env, "setTargetPause", ugc_setTargetPause, 1);
+    defineNative(vm, mod->env, "setNurserySize", ugc_setNurserySize, 1);
+    defineNative(vm, mod->env, "setMaxHeadroom", ugc_setMaxHeadroom, 1);
+
+    Value vMod = OBJ_VAL(mod);
+    defineGlobal(vm, "ucoreGC", vMod);
+}
@@ -1,4 +1,6 @@
 #include "ucore_http.h"
+#include "ucore_http_client.h"
+#include "ucore_json.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +11,22 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include "runtime/scheduler.h"
+#include "bytecode/interpreter.h"
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <netinet/tcp.h>
+
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15 // Linux; hidden by _POSIX_C_SOURCE
+#endif
 
 // URL decode helper
 static void urlDecode(char* dst, const char* src) {
@@ -90,46 +108,6 @@ static void parseHeaders(VM* vm, Map* headerMap, const char* request) {
     }
 }
 
-// Helper to parse URL check for http://
-static bool parseUrl(const char* url, char* hostOut, char* pathOut, int* portOut) {
-    // Simple parser: http://host:port/path
-    const char* p = url;
-    if (strncmp(p, "http://", 7) == 0) p += 7;
-    else if (strncmp(p, "https://", 8) == 0) {
-        printf("Error: HTTPS not supported in uCoreHttp (no OpenSSL).\n");
-        return false;
-    }
-    
-    // Parse host
-    const char* start = p;
-    while (*p && *p != ':' && *p != '/') p++;
-    int hostLen = p - start;
-    if (hostLen >= 256) return false;
-    strncpy(hostOut, start, hostLen);
-    hostOut[hostLen] = '\0';
-    
-    // Port
-    *portOut = 80;
-    if (*p == ':') {
-        p++;
-        *portOut = atoi(p);
-        while (*p && *p != '/') p++;
-    }
-    
-    // Path
-    if (*p == '/') {
-        // strncpy triggers warning for truncation, use safer copy
-        size_t len = strlen(p);
-        if (len >= 1024) len = 1023;
-        memcpy(pathOut, p, len);
-        pathOut[len] = '\0';
-    } else {
-        strcpy(pathOut, "/");
-    }
-    return true;
-}
-
-
 // ---- JSON Helper ----
 static void json_append(char** buf, int* len, int* cap, const char* str) {
     int l = (int)strlen(str);
@@ -178,17 +156,14 @@ static void json_serialize_val(Value v, char** buf, int* len, int* cap) {
                 Map* m = (Map*)o;
                 json_append(buf, len, cap, "{");
                 bool first = true;
-                for (int i = 0; i < TABLE_SIZE; i++) {
-                    MapEntry* e = m->buckets[i];
-                    while (e) {
-                         if (!first) json_append(buf, len, cap, ",");
-                         first = false;
-                         json_append(buf, len, cap, "\"");
-                         json_append(buf, len, cap, e->key); // Assume keys are strings
-                         json_append(buf, len, cap, "\":");
-                         json_serialize_val(e->value, buf, len, cap);
-                         e = e->next;
-                    }
+                for (int i = 0; i < m->count; i++) {
+                    MapEntry* e = &m->entries[i];
+                    if (!first) json_append(buf, len, cap, ",");
+                    first = false;
+                    json_append(buf, len, cap, "\"");
+                    json_append(buf, len, cap, e->key); // Assume keys are strings
+                    json_append(buf, len, cap, "\":");
+                    json_serialize_val(e->value, buf, len, cap);
                 }
                 json_append(buf, len, cap, "}");
             } else {
@@ -225,93 +200,14 @@ static Value uhttp_json(VM* vm, Value* args, int argCount) {
 }
 
 static Value http_perform(VM* vm, const char* method, const char* url, const char* body) {
-    char host[256];
-    char path[1024];
-    int port;
-    
-    if (!parseUrl(url, host, path, &port)) {
-        printf("Invalid URL or HTTPS not supported.\n");
-        return NIL_VAL; 
-    }
-    
-    // DNS Resolve
-    struct hostent* he = gethostbyname(host);
-    if (!he) {
-        printf("Could not resolve host: %s\n", host);
-        return NIL_VAL; // null
-    }
-    
-    // Socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        perror("Socket creation failed");
-        return NIL_VAL;
-    }
-    
-    struct sockaddr_in serv_addr;
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-    // Modern way (h_addr_list)
-    memcpy(&serv_addr.sin_addr, he->h_addr_list[0], he->h_length);
-    
-    // Connect
-    if (connect(sockfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        perror("Connection failed");
-        close(sockfd);
+    HttpClientResponse resp;
+    if (!httpClientRequest(vm, method, url, body, body ? strlen(body) : 0,
+                           HTTP_CLIENT_MAX_REDIRECTS, &resp)) {
         return NIL_VAL;
     }
-    
-    // Construct Request
-    char req[4096];
-    int contentLen = body ? (int)strlen(body) : 0;
-    snprintf(req, sizeof(req), 
-        "%s %s HTTP/1.1\r\n"
-        "Host: %s\r\n"
-        "User-Agent: Unnarize/1.0\r\n"
-        "Connection: close\r\n"
-        "Content-Length: %d\r\n"
-        "\r\n" // End headers
-        "%s", 
-        method, path, host, contentLen, body ? body : "");
-        
-    // Send
-    if (send(sockfd, req, strlen(req), 0) < 0) {
-        perror("Send failed");
-        close(sockfd);
-        return NIL_VAL;
-    }
-    
-    // Receive
-    int cap = 4096;
-    int size = 0;
-    char* buf = malloc(cap);
-    
-    while (1) {
-        if (size + 1024 >= cap) {
-            cap *= 2;
-            buf = realloc(buf, cap);
-        }
-        int n = recv(sockfd, buf + size, cap - size - 1, 0);
-        if (n <= 0) break; // closed or error
-        size += n;
-    }
-    buf[size] = '\0';
-    close(sockfd);
-    
-    // Separate body
-    char* bodyStart = strstr(buf, "\r\n\r\n");
-    if (bodyStart) {
-        bodyStart += 4;
-    } else {
-        bodyStart = buf;
-    }
-    
-    ObjString* os = internString(vm, bodyStart, (int)strlen(bodyStart));
-    free(buf);
-    
-    Value vRes = OBJ_VAL(os);
-    return vRes;
+    ObjString* os = internString(vm, resp.body, (int)resp.bodyLen);
+    httpClientFreeResponse(&resp);
+    return OBJ_VAL(os);
 }
 
 static Value uhttp_get(VM* vm, Value* args, int argCount) {
@@ -355,15 +251,90 @@ static Value uhttp_patch(VM* vm, Value* args, int argCount) {
 }
 
 
+// ucoreHttp.getAll(urls) -> array of bodies (nil for failures), fetched concurrently
+#define HTTP_GETALL_MAX_INFLIGHT 32
+
+static Function* httpGetFn(VM* vm);
+
+static Value uhttp_getAll(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_ARRAY(args[0])) {
+        printf("Error: ucoreHttp.getAll(urls) expects an array of url strings.\n");
+        return NIL_VAL;
+    }
+    Array* urls = (Array*)AS_OBJ(args[0]);
+    int n = urls->count;
+    Function* getFn = httpGetFn(vm);
+
+    // Root the result and in-flight futures on the stack while tasks run
+    int stackBase = vm->stackTop;
+    Array* results = newArray(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(results);
+    for (int i = 0; i < n; i++) arrayPush(vm, results, NIL_VAL);
+
+    // Sliding window: slot i % HTTP_GETALL_MAX_INFLIGHT holds url i's future
+    int window = n < HTTP_GETALL_MAX_INFLIGHT ? n : HTTP_GETALL_MAX_INFLIGHT;
+    int slots = vm->stackTop;
+    for (int i = 0; i < window; i++) vm->stack[vm->stackTop++] = NIL_VAL;
+
+    int spawned = 0;
+    for (int i = 0; i < n; i++) {
+        while (spawned < n && spawned < i + window) {
+            Value url = urls->items[spawned];
+            Value fut = IS_STRING(url) ? spawnTask(vm, getFn, &url, 1) : NIL_VAL;
+            vm->stack[slots + spawned % window] = fut;
+            spawned++;
+        }
+        Value fut = vm->stack[slots + i % window];
+        if (IS_NIL(fut)) continue;
+        Future* f = (Future*)AS_OBJ(fut);
+        awaitFuture(vm, f);
+        results->items[i] = f->result;
+        WRITE_BARRIER(vm, results);
+        vm->stack[slots + i % window] = NIL_VAL;
+    }
+
+    vm->stackTop = stackBase;
+    return OBJ_VAL(results);
+}
+
 // ---- Routing ----
 typedef struct Route {
     char* method;
     char* path;
     char* handlerName;
+    Function* handler;      // Resolved at registration (or at listen if defined later)
     struct Route* next;
 } Route;
 
-static Route* g_routes = NULL;
+
+// Routes are compiled into a segment trie when the server starts.
+// Literal children are kept sorted for binary search; each node has at
+// most one ":param" child, tried only when the literal branch fails.
+#define ROUTE_MAX_PARAMS 16
+
+typedef struct RouteTarget {
+    char* method;
+    PreparedCall handler;   // Called with the request map
+    int paramCount;
+    char** paramNames;      // Capture names in path order
+    struct RouteTarget* next;
+} RouteTarget;
+
+typedef struct RouteNode {
+    char* segment;          // Literal segment text (may be empty)
+    int segmentLen;
+    struct RouteNode** children;
+    int childCount;
+    int childCapacity;
+    struct RouteNode* param; // ":name" child
+    RouteTarget* targets;   // Handlers for paths ending here
+} RouteNode;
+
+typedef struct RouteCapture {
+    const char* start;
+    int length;
+} RouteCapture;
+
 
 // ---- Middleware ----
 typedef struct Middleware {
@@ -371,7 +342,6 @@ typedef struct Middleware {
     struct Middleware* next;
 } Middleware;
 
-static Middleware* g_middleware = NULL;
 
 // ---- Static Files ----
 typedef struct StaticMount {
@@ -380,11 +350,32 @@ typedef struct StaticMount {
     struct StaticMount* next;
 } StaticMount;
 
-static StaticMount* g_static = NULL;
+// ---- Per-VM state ----
+// Routes, middleware and mounts belong to the VM that registered them, so
+// isolates on other threads can each run a server of their own.
+typedef struct HttpState {
+    Function* getFn;        // The registered 'get' native, run as one task per url
+    Route* routes;
+    RouteNode* routeTrie;   // Built from 'routes' by listen
+    Middleware* middleware;
+    StaticMount* statics;
+    // Handlers share the VM, so everything that touches it is serialized
+    // here. Socket I/O, parsing and static files run in parallel across workers.
+    pthread_mutex_t vmLock;
+} HttpState;
+
+static char httpStateKey; // Its address identifies the state in the VM
+
+static HttpState* httpState(VM* vm) {
+    return (HttpState*)getLibState(vm, &httpStateKey);
+}
+
+static Function* httpGetFn(VM* vm) {
+    return httpState(vm)->getFn;
+}
 
 // Add middleware
 static Value uhttp_use(VM* vm, Value* args, int argCount) {
-    (void)vm;
     if (argCount != 1 || !IS_STRING(args[0])) {
         printf("Error: ucoreHttp.use(handlerName) expects string.\n");
         return BOOL_VAL(false);
@@ -392,15 +383,15 @@ static Value uhttp_use(VM* vm, Value* args, int argCount) {
     
     Middleware* m = malloc(sizeof(Middleware));
     m->handlerName = strdup(AS_CSTRING(args[0]));
-    m->next = g_middleware;
-    g_middleware = m;
+    HttpState* state = httpState(vm);
+    m->next = state->middleware;
+    state->middleware = m;
     
     return BOOL_VAL(true);
 }
 
 // Mount static files
 static Value uhttp_static(VM* vm, Value* args, int argCount) {
-    (void)vm;
     if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) {
         printf("Error: ucoreHttp.static(urlPrefix, dirPath) expects 2 strings.\n");
         return BOOL_VAL(false);
@@ -409,55 +400,389 @@ static Value uhttp_static(VM* vm, Value* args, int argCount) {
     StaticMount* s = malloc(sizeof(StaticMount));
     s->urlPrefix = strdup(AS_CSTRING(args[0]));
     s->dirPath = strdup(AS_CSTRING(args[1]));
-    s->next = g_static;
-    g_static = s;
+    HttpState* state = httpState(vm);
+    s->next = state->statics;
+    state->statics = s;
     
     return BOOL_VAL(true);
 }
 
-// Try to serve static file, returns true if served
-static bool tryServeStatic(int socket, const char* path) {
-    StaticMount* s = g_static;
+// ---- Event-driven server ----
+// Each worker thread runs its own epoll loop over non-blocking sockets.
+// Requests are parsed incrementally, so bodies of any Content-Length are
+// accumulated across reads and pipelined requests are answered in order.
+#define HTTP_MAX_EVENTS     256
+#define HTTP_READ_CHUNK     16384
+#define HTTP_MAX_HEADER     (64 * 1024)
+#define HTTP_MAX_BODY       (64 * 1024 * 1024)
+#define HTTP_MAX_WORKERS    64
+#define STATIC_CACHE_BUCKETS 1024
+#define STATIC_CACHE_MAX     1024 // Open fds kept by the static file cache
+
+// Cached static file: open fd plus precomputed response headers.
+// Entries are refcounted so a replaced file stays open until in-flight
+// sendfile() transfers that reference it have finished.
+typedef struct StaticFile {
+    char* path;
+    int fd;
+    off_t size;
+    time_t mtime;
+    ino_t ino;
+    time_t checkedAt;       // Last stat() revalidation (once per second)
+    char etag[48];
+    char lastModified[40];
+    char headers[384];      // Content-Type / ETag / Last-Modified / Accept-Ranges
+    int headersLen;
+    int refs;
+    bool cached;
+    struct StaticFile* next;
+} StaticFile;
+
+// File region queued behind 'at' bytes of the connection's output buffer
+typedef struct HttpFileSeg {
+    size_t at;
+    StaticFile* file;
+    off_t offset;
+    size_t remaining;
+} HttpFileSeg;
+
+typedef struct HttpConn {
+    int fd;
+    char* in;               // Unparsed input (always NUL-terminated)
+    size_t inLen;
+    size_t inCap;
+    char* out;              // Queued response bytes
+    size_t outLen;
+    size_t outCap;
+    size_t outSent;
+    HttpFileSeg* files;     // Pending sendfile() regions, in response order
+    int fileHead;
+    int fileCount;
+    int fileCap;
+    bool wantWrite;         // EPOLLOUT currently armed
+    bool closeAfterWrite;   // Close once the output queue drains
+    bool peerClosed;        // Client half-closed its side
+} HttpConn;
+
+typedef struct HttpWorker {
+    VM* vm;
+    HttpState* state;
+    PreparedCall mainHandler;
+    bool hasMainHandler;
+    int listenFd;
+} HttpWorker;
+
+static void connReserve(char** buf, size_t* cap, size_t need) {
+    if (need <= *cap) return;
+    size_t newCap = *cap ? *cap : 1024;
+    while (newCap < need) newCap *= 2;
+    *buf = realloc(*buf, newCap);
+    *cap = newCap;
+}
+
+static void connWrite(HttpConn* c, const char* data, size_t n) {
+    connReserve(&c->out, &c->outCap, c->outLen + n);
+    memcpy(c->out + c->outLen, data, n);
+    c->outLen += n;
+}
+
+static const char* httpStatusText(int statusCode) {
+    switch (statusCode) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default:  return "OK";
+    }
+}
+
+static void connWriteHeaders(HttpConn* c, int statusCode, const char* contentType,
+                             size_t bodyLen, bool keepAlive) {
+    char header[512];
+    int n = snprintf(header, sizeof(header),
+        "HTTP/1.1 %d %s\r\n"
+        "Content-Type: %s\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: %s\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "\r\n", statusCode, httpStatusText(statusCode), contentType, bodyLen,
+        keepAlive ? "keep-alive" : "close");
+    connWrite(c, header, (size_t)n);
+}
+
+static void connWriteResponse(HttpConn* c, int statusCode, const char* contentType,
+                              const char* body, size_t bodyLen, bool keepAlive) {
+    connWriteHeaders(c, statusCode, contentType, bodyLen, keepAlive);
+    if (bodyLen > 0) connWrite(c, body, bodyLen);
+}
+
+// Case-insensitive search for a header value inside the header block.
+// Returns a pointer to the value (leading spaces skipped) or NULL.
+static const char* findHeader(const char* headers, size_t headersLen, const char* name, size_t* valLen) {
+    size_t nameLen = strlen(name);
+    const char* line = memchr(headers, '\n', headersLen);
+    const char* end = headers + headersLen;
+    while (line && line + 1 < end) {
+        line++;
+        const char* eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) eol = end;
+        if ((size_t)(eol - line) > nameLen && line[nameLen] == ':' &&
+            strncasecmp(line, name, nameLen) == 0) {
+            const char* v = line + nameLen + 1;
+            while (v < eol && *v == ' ') v++;
+            const char* ve = eol;
+            while (ve > v && (ve[-1] == '\r' || ve[-1] == ' ')) ve--;
+            *valLen = (size_t)(ve - v);
+            return v;
+        }
+        line = eol < end ? eol : NULL;
+    }
+    return NULL;
+}
+
+static StaticFile* g_staticCache[STATIC_CACHE_BUCKETS];
+static int g_staticCacheCount = 0;
+static pthread_mutex_t g_staticLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* staticContentType(const char* filePath) {
+    const char* ext = strrchr(filePath, '.');
+    if (!ext) return "application/octet-stream";
+    if (strcmp(ext, ".html") == 0) return "text/html";
+    if (strcmp(ext, ".css") == 0) return "text/css";
+    if (strcmp(ext, ".js") == 0) return "application/javascript";
+    if (strcmp(ext, ".json") == 0) return "application/json";
+    if (strcmp(ext, ".png") == 0) return "image/png";
+    if (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0) return "image/jpeg";
+    if (strcmp(ext, ".svg") == 0) return "image/svg+xml";
+    return "application/octet-stream";
+}
+
+// Caller holds g_staticLock
+static void staticFileUnref(StaticFile* f) {
+    if (--f->refs > 0) return;
+    close(f->fd);
+    free(f->path);
+    free(f);
+}
+
+static void staticFileRelease(StaticFile* f) {
+    pthread_mutex_lock(&g_staticLock);
+    staticFileUnref(f);
+    pthread_mutex_unlock(&g_staticLock);
+}
+
+static StaticFile* staticFileOpen(const char* filePath) {
+    int fd = open(filePath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    StaticFile* f = calloc(1, sizeof(StaticFile));
+    f->path = strdup(filePath);
+    f->fd = fd;
+    f->size = st.st_size;
+    f->mtime = st.st_mtime;
+    f->ino = st.st_ino;
+    f->checkedAt = time(NULL);
+    f->refs = 1;
+
+    struct tm tmv;
+    gmtime_r(&f->mtime, &tmv);
+    strftime(f->lastModified, sizeof(f->lastModified), "%a, %d %b %Y %H:%M:%S GMT", &tmv);
+    snprintf(f->etag, sizeof(f->etag), "\"%lx-%lx\"", (unsigned long)f->mtime, (unsigned long)f->size);
+    f->headersLen = snprintf(f->headers, sizeof(f->headers),
+        "Content-Type: %s\r\n"
+        "ETag: %s\r\n"
+        "Last-Modified: %s\r\n"
+        "Accept-Ranges: bytes\r\n", staticContentType(filePath), f->etag, f->lastModified);
+    return f;
+}
+
+// Look up (or open and cache) a file; the returned reference must be released
+static StaticFile* staticFileAcquire(const char* filePath) {
+    unsigned int bucket = hash(filePath, (int)strlen(filePath)) % STATIC_CACHE_BUCKETS;
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&g_staticLock);
+    StaticFile** link = &g_staticCache[bucket];
+    while (*link && strcmp((*link)->path, filePath) != 0) link = &(*link)->next;
+
+    StaticFile* f = *link;
+    if (f && f->checkedAt != now) {
+        // Revalidate at most once per second so edits show up
+        struct stat st;
+        if (stat(filePath, &st) == 0 && st.st_ino == f->ino &&
+            st.st_size == f->size && st.st_mtime == f->mtime) {
+            f->checkedAt = now;
+        } else {
+            *link = f->next;
+            f->cached = false;
+            g_staticCacheCount--;
+            staticFileUnref(f);
+            f = NULL;
+        }
+    }
+    if (f) {
+        f->refs++;
+        pthread_mutex_unlock(&g_staticLock);
+        return f;
+    }
+
+    f = staticFileOpen(filePath);
+    if (f && g_staticCacheCount < STATIC_CACHE_MAX) {
+        f->cached = true;
+        f->refs++; // The cache's own reference
+        f->next = g_staticCache[bucket];
+        g_staticCache[bucket] = f;
+        g_staticCacheCount++;
+    }
+    pthread_mutex_unlock(&g_staticLock);
+    return f;
+}
+
+// Queue a file region after everything already in the output buffer
+static void connQueueFile(HttpConn* c, StaticFile* f, off_t offset, size_t length) {
+    if (c->fileCount >= c->fileCap) {
+        c->fileCap = c->fileCap < 4 ? 4 : c->fileCap * 2;
+        c->files = realloc(c->files, sizeof(HttpFileSeg) * c->fileCap);
+    }
+    HttpFileSeg* seg = &c->files[c->fileCount++];
+    seg->at = c->outLen;
+    seg->file = f;
+    seg->offset = offset;
+    seg->remaining = length;
+}
+
+// Reject "/../" segments so requests cannot escape the mounted directory
+static bool hasDotDotSegment(const char* path) {
+    for (const char* p = path; *p; p++) {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0') &&
+            (p == path || p[-1] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a single "bytes=a-b" range. Returns 1 if satisfiable, 0 if the
+// header should be ignored, -1 if it cannot be satisfied (416).
+static int parseRange(const char* v, size_t len, off_t size, off_t* start, off_t* end) {
+    if (len < 7 || strncmp(v, "bytes=", 6) != 0) return 0;
+    v += 6;
+    len -= 6;
+    if (memchr(v, ',', len)) return 0; // Multiple ranges: serve the whole file
+
+    char* dash;
+    if (*v == '-') {
+        long long suffix = strtoll(v + 1, &dash, 10);
+        if (dash == v + 1 || suffix <= 0) return -1;
+        *start = suffix >= size ? 0 : size - suffix;
+        *end = size - 1;
+    } else {
+        long long a = strtoll(v, &dash, 10);
+        if (dash == v || *dash != '-') return 0;
+        long long b = size - 1;
+        if (dash[1] >= '0' && dash[1] <= '9') b = strtoll(dash + 1, NULL, 10);
+        if (a >= size || a > b) return -1;
+        if (b >= size) b = size - 1;
+        *start = a;
+        *end = b;
+    }
+    return size > 0 ? 1 : -1;
+}
+
+// Try to serve static file, returns true if served.
+// Files are sent with sendfile() from a cached fd; ETag/Last-Modified
+// conditionals get 304 and single byte ranges get 206.
+static bool tryServeStatic(HttpConn* c, StaticMount* s, const char* method, const char* path,
+                           const char* headers, size_t headersLen, bool keepAlive) {
     while (s) {
         size_t prefixLen = strlen(s->urlPrefix);
-        if (strncmp(path, s->urlPrefix, prefixLen) == 0) {
+        if (strncmp(path, s->urlPrefix, prefixLen) == 0 && !hasDotDotSegment(path + prefixLen)) {
             // Build file path
             char filePath[2048];
             snprintf(filePath, sizeof(filePath), "%s%s", s->dirPath, path + prefixLen);
             
-            FILE* f = fopen(filePath, "rb");
+            StaticFile* f = staticFileAcquire(filePath);
             if (f) {
-                // Get file size
-                fseek(f, 0, SEEK_END);
-                long size = ftell(f);
-                fseek(f, 0, SEEK_SET);
-                
-                // Determine content type
-                const char* ct = "application/octet-stream";
-                if (strstr(filePath, ".html")) ct = "text/html";
-                else if (strstr(filePath, ".css")) ct = "text/css";
-                else if (strstr(filePath, ".js")) ct = "application/javascript";
-                else if (strstr(filePath, ".json")) ct = "application/json";
-                else if (strstr(filePath, ".png")) ct = "image/png";
-                else if (strstr(filePath, ".jpg") || strstr(filePath, ".jpeg")) ct = "image/jpeg";
-                else if (strstr(filePath, ".svg")) ct = "image/svg+xml";
-                
-                // Send headers
-                char header[512];
-                snprintf(header, sizeof(header),
-                    "HTTP/1.1 200 OK\r\n"
-                    "Content-Type: %s\r\n"
-                    "Content-Length: %ld\r\n"
-                    "\r\n", ct, size);
-                send(socket, header, strlen(header), 0);
-                
-                // Send file content
-                char buf[4096];
-                size_t n;
-                while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
-                    send(socket, buf, n, 0);
+                int status = 200;
+                off_t start = 0, end = f->size - 1;
+                size_t valLen;
+
+                const char* inm = findHeader(headers, headersLen, "if-none-match", &valLen);
+                if (inm) {
+                    size_t etagLen = strlen(f->etag);
+                    if (valLen == 1 && inm[0] == '*') status = 304;
+                    for (size_t i = 0; status != 304 && i + etagLen <= valLen; i++) {
+                        if (memcmp(inm + i, f->etag, etagLen) == 0) status = 304;
+                    }
+                } else {
+                    const char* ims = findHeader(headers, headersLen, "if-modified-since", &valLen);
+                    if (ims && valLen == strlen(f->lastModified) && strncmp(ims, f->lastModified, valLen) == 0) {
+                        status = 304;
+                    }
+                }
+
+                if (status == 200) {
+                    const char* range = findHeader(headers, headersLen, "range", &valLen);
+                    if (range) {
+                        int r = parseRange(range, valLen, f->size, &start, &end);
+                        if (r > 0) status = 206;
+                        else if (r < 0) status = 416;
+                    }
+                }
+
+                // Queue headers
+                char header[768];
+                int n;
+                if (status == 304) {
+                    n = snprintf(header, sizeof(header),
+                        "HTTP/1.1 304 Not Modified\r\n"
+                        "ETag: %s\r\n"
+                        "Last-Modified: %s\r\n"
+                        "Connection: %s\r\n"
+                        "\r\n", f->etag, f->lastModified, keepAlive ? "keep-alive" : "close");
+                } else if (status == 416) {
+                    n = snprintf(header, sizeof(header),
+                        "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                        "Content-Range: bytes */%lld\r\n"
+                        "Content-Length: 0\r\n"
+                        "Connection: %s\r\n"
+                        "\r\n", (long long)f->size, keepAlive ? "keep-alive" : "close");
+                } else {
+                    char contentRange[96] = "";
+                    if (status == 206) {
+                        snprintf(contentRange, sizeof(contentRange), "Content-Range: bytes %lld-%lld/%lld\r\n",
+                                 (long long)start, (long long)end, (long long)f->size);
+                    }
+                    n = snprintf(header, sizeof(header),
+                        "HTTP/1.1 %s\r\n"
+                        "%.*s"
+                        "%s"
+                        "Content-Length: %lld\r\n"
+                        "Connection: %s\r\n"
+                        "\r\n", status == 206 ? "206 Partial Content" : "200 OK",
+                        f->headersLen, f->headers, contentRange,
+                        (long long)(end - start + 1), keepAlive ? "keep-alive" : "close");
+                }
+                connWrite(c, header, (size_t)n);
+
+                // Body goes straight from the page cache to the socket
+                if ((status == 200 || status == 206) && strcmp(method, "HEAD") != 0 && end >= start) {
+                    connQueueFile(c, f, start, (size_t)(end - start + 1));
+                } else {
+                    staticFileRelease(f);
                 }
-                fclose(f);
                 return true;
             }
         }
@@ -466,71 +791,669 @@ static bool tryServeStatic(int socket, const char* path) {
     return false;
 }
 
-// Match route pattern with URL params (e.g., /users/:id matches /users/123)
-// Returns true if matched, and populates paramsMap with extracted params
-static bool matchRoute(const char* pattern, const char* path, VM* vm, Map* paramsMap) {
+static RouteNode* newRouteNode(const char* segment, int length) {
+    RouteNode* node = calloc(1, sizeof(RouteNode));
+    node->segment = malloc(length + 1);
+    memcpy(node->segment, segment, length);
+    node->segment[length] = '\0';
+    node->segmentLen = length;
+    return node;
+}
+
+static int compareSegment(const char* a, int aLen, const char* b, int bLen) {
+    int n = aLen < bLen ? aLen : bLen;
+    int c = memcmp(a, b, n);
+    return c != 0 ? c : aLen - bLen;
+}
+
+// Binary search for a literal child; *insertAt receives the sorted position
+static RouteNode* findRouteChild(RouteNode* node, const char* seg, int len, int* insertAt) {
+    int lo = 0, hi = node->childCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        RouteNode* child = node->children[mid];
+        int c = compareSegment(seg, len, child->segment, child->segmentLen);
+        if (c == 0) return child;
+        if (c < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    if (insertAt) *insertAt = lo;
+    return NULL;
+}
+
+// Insert one route. Earlier inserts win, so callers feed newest routes first.
+static void insertRoute(RouteNode* root, const char* pattern, const char* method, Function* handler) {
+    char* names[ROUTE_MAX_PARAMS];
+    int nameCount = 0;
+    RouteNode* node = root;
+
     const char* p = pattern;
-    const char* u = path;
-    
-    while (*p && *u) {
-        if (*p == ':') {
-            // Extract param name
-            p++; // Skip ':'
-            const char* nameStart = p;
-            while (*p && *p != '/') p++;
-            int nameLen = p - nameStart;
-            
-            // Extract param value from URL
-            const char* valStart = u;
-            while (*u && *u != '/') u++;
-            int valLen = u - valStart;
-            
-            // Add to params map
-            char name[256];
-            if (nameLen < 256) {
-                memcpy(name, nameStart, nameLen);
-                name[nameLen] = '\0';
-                
-                ObjString* valStr = internString(vm, valStart, valLen);
-                mapSetStr(paramsMap, name, nameLen, OBJ_VAL(valStr));
+    if (*p == '/') p++;
+    while (1) {
+        const char* slash = strchr(p, '/');
+        int len = slash ? (int)(slash - p) : (int)strlen(p);
+
+        if (len > 1 && p[0] == ':') {
+            if (nameCount >= ROUTE_MAX_PARAMS) {
+                printf("Error: Route '%s' has more than %d params.\n", pattern, ROUTE_MAX_PARAMS);
+                for (int i = 0; i < nameCount; i++) free(names[i]);
+                return;
             }
+            names[nameCount] = malloc(len);
+            memcpy(names[nameCount], p + 1, len - 1);
+            names[nameCount][len - 1] = '\0';
+            nameCount++;
+            if (!node->param) node->param = newRouteNode(":", 1);
+            node = node->param;
         } else {
-            if (*p != *u) return false;
-            p++;
-            u++;
+            int at = 0;
+            RouteNode* child = findRouteChild(node, p, len, &at);
+            if (!child) {
+                child = newRouteNode(p, len);
+                if (node->childCount >= node->childCapacity) {
+                    node->childCapacity = node->childCapacity < 4 ? 4 : node->childCapacity * 2;
+                    node->children = realloc(node->children, sizeof(RouteNode*) * node->childCapacity);
+                }
+                memmove(&node->children[at + 1], &node->children[at],
+                        sizeof(RouteNode*) * (node->childCount - at));
+                node->children[at] = child;
+                node->childCount++;
+            }
+            node = child;
         }
+
+        if (!slash) break;
+        p = slash + 1;
     }
-    
-    // Both should be at end for exact match
-    return (*p == '\0' && *u == '\0');
+
+    for (RouteTarget* t = node->targets; t; t = t->next) {
+        if (strcmp(t->method, method) == 0) {
+            // Shadowed by a newer registration of the same method + path
+            for (int i = 0; i < nameCount; i++) free(names[i]);
+            return;
+        }
+    }
+
+    RouteTarget* t = malloc(sizeof(RouteTarget));
+    t->method = strdup(method);
+    prepareCall(handler, 1, &t->handler);
+    t->paramCount = nameCount;
+    t->paramNames = malloc(sizeof(char*) * (nameCount ? nameCount : 1));
+    memcpy(t->paramNames, names, sizeof(char*) * nameCount);
+    t->next = node->targets;
+    node->targets = t;
+}
+
+// Match path segments against the trie, preferring literals over params.
+// p points at the next segment, or is NULL once the whole path is consumed.
+static RouteTarget* matchRouteTrie(RouteNode* node, const char* p, const char* method,
+                                   RouteCapture* caps, int capCount, int* capOut) {
+    if (!p) {
+        for (RouteTarget* t = node->targets; t; t = t->next) {
+            if (strcmp(t->method, method) == 0) {
+                *capOut = capCount;
+                return t;
+            }
+        }
+        return NULL;
+    }
+
+    const char* slash = strchr(p, '/');
+    int len = slash ? (int)(slash - p) : (int)strlen(p);
+    const char* next = slash ? slash + 1 : NULL;
+
+    RouteNode* child = findRouteChild(node, p, len, NULL);
+    if (child) {
+        RouteTarget* t = matchRouteTrie(child, next, method, caps, capCount, capOut);
+        if (t) return t;
+    }
+
+    if (node->param && len > 0 && capCount < ROUTE_MAX_PARAMS) {
+        caps[capCount].start = p;
+        caps[capCount].length = len;
+        return matchRouteTrie(node->param, next, method, caps, capCount + 1, capOut);
+    }
+    return NULL;
+}
+
+static void freeRouteTrie(RouteNode* node) {
+    for (int i = 0; i < node->childCount; i++) freeRouteTrie(node->children[i]);
+    if (node->param) freeRouteTrie(node->param);
+    RouteTarget* t = node->targets;
+    while (t) {
+        RouteTarget* next = t->next;
+        for (int i = 0; i < t->paramCount; i++) free(t->paramNames[i]);
+        free(t->paramNames);
+        free(t->method);
+        free(t);
+        t = next;
+    }
+    free(node->children);
+    free(node->segment);
+    free(node);
+}
+
+// Handlers are pinned, so they go with the VM's objects
+static void freeHttpState(void* data) {
+    HttpState* state = (HttpState*)data;
+    while (state->routes) {
+        Route* r = state->routes;
+        state->routes = r->next;
+        free(r->method);
+        free(r->path);
+        free(r->handlerName);
+        free(r);
+    }
+    if (state->routeTrie) freeRouteTrie(state->routeTrie);
+    while (state->middleware) {
+        Middleware* m = state->middleware;
+        state->middleware = m->next;
+        free(m->handlerName);
+        free(m);
+    }
+    while (state->statics) {
+        StaticMount* m = state->statics;
+        state->statics = m->next;
+        free(m->urlPrefix);
+        free(m->dirPath);
+        free(m);
+    }
+    pthread_mutex_destroy(&state->vmLock);
+    free(state);
 }
 
+// Build the trie from the registration list, resolving any late handlers
+static void compileRoutes(VM* vm) {
+    HttpState* state = httpState(vm);
+    if (state->routeTrie) freeRouteTrie(state->routeTrie);
+    state->routeTrie = newRouteNode("", 0);
+    for (Route* r = state->routes; r; r = r->next) {
+        if (!r->handler) {
+            r->handler = findFunctionByName(vm, r->handlerName);
+            if (!r->handler) {
+                printf("Error: Handler function '%s' for %s %s not found.\n",
+                       r->handlerName, r->method, r->path);
+                continue;
+            }
+            pinObject(vm, (Obj*)r->handler);
+        }
+        PreparedCall check;
+        if (!prepareCall(r->handler, 1, &check)) {
+            printf("Error: Handler for %s %s must take one argument (the request).\n",
+                   r->method, r->path);
+            continue;
+        }
+        insertRoute(state->routeTrie, r->path, r->method, r->handler);
+    }
+}
+
+// ucoreHttp.route(method, path, handler) - handler is a function or its name
 static Value uhttp_route(VM* vm, Value* args, int argCount) {
-    (void)vm;
-    if (argCount != 3 || !IS_STRING(args[0]) || !IS_STRING(args[1]) || !IS_STRING(args[2])) {
-        printf("Error: ucoreHttp.route(method, path, handlerName) expects 3 strings.\n");
+    bool isFunc = argCount == 3 && IS_OBJ(args[2]) && AS_OBJ(args[2])->type == OBJ_FUNCTION;
+    if (argCount != 3 || !IS_STRING(args[0]) || !IS_STRING(args[1]) ||
+        (!IS_STRING(args[2]) && !isFunc)) {
+        printf("Error: ucoreHttp.route(method, path, handler) expects method, path and handler name or function.\n");
         return BOOL_VAL(false);
     }
     
     Route* r = malloc(sizeof(Route));
     r->method = strdup(AS_CSTRING(args[0]));
     r->path = strdup(AS_CSTRING(args[1]));
-    r->handlerName = strdup(AS_CSTRING(args[2]));
-    r->next = g_routes;
-    g_routes = r;
+    if (isFunc) {
+        r->handler = (Function*)AS_OBJ(args[2]);
+        r->handlerName = NULL;
+    } else {
+        r->handlerName = strdup(AS_CSTRING(args[2]));
+        r->handler = findFunctionByName(vm, r->handlerName);
+    }
+    if (r->handler) pinObject(vm, (Obj*)r->handler); // Held by C across GCs
+    HttpState* state = httpState(vm);
+    r->next = state->routes;
+    state->routes = r;
     
     return BOOL_VAL(true);
 }
 
+// Locate the blank line ending the header block, returns its offset or -1
+static long findHeaderEnd(const char* buf, size_t len) {
+    for (size_t i = 0; i + 3 < len; i++) {
+        if (buf[i] == '\r' && buf[i + 1] == '\n' && buf[i + 2] == '\r' && buf[i + 3] == '\n') {
+            return (long)(i + 4);
+        }
+    }
+    return -1;
+}
+
+// A non-string response body, stringified by ucoreJson. The first chunk
+// stays in memory; a body that needs more spills to an unlinked temp file
+// that is then sent with sendfile() like a static file, so large exports
+// never sit in memory whole.
+typedef struct JsonBody {
+    char* data;
+    size_t length;
+    int fd;                 // Spill file, -1 until needed
+    off_t size;             // Bytes written to it
+} JsonBody;
+
+static bool writeFully(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool jsonBodySink(void* ctx, const char* chunk, size_t length) {
+    JsonBody* b = (JsonBody*)ctx;
+    if (b->fd < 0 && !b->data) {
+        b->data = malloc(length);
+        if (!b->data) return false;
+        memcpy(b->data, chunk, length);
+        b->length = length;
+        return true;
+    }
+    if (b->fd < 0) {
+        char path[] = "/tmp/unnarize-body-XXXXXX";
+        b->fd = mkstemp(path);
+        if (b->fd < 0) return false;
+        unlink(path);
+        if (!writeFully(b->fd, b->data, b->length)) return false;
+        b->size = (off_t)b->length;
+        free(b->data);
+        b->data = NULL;
+        b->length = 0;
+    }
+    if (!writeFully(b->fd, chunk, length)) return false;
+    b->size += (off_t)length;
+    return true;
+}
+
+// Queue the response for a JsonBody (takes ownership of its buffer / file)
+static void connWriteJsonBody(HttpConn* c, int statusCode, JsonBody* b, bool keepAlive) {
+    if (b->fd < 0) {
+        connWriteResponse(c, statusCode, "application/json", b->data, b->length, keepAlive);
+        free(b->data);
+        return;
+    }
+    StaticFile* f = calloc(1, sizeof(StaticFile));
+    if (!f || !(f->path = strdup(""))) {
+        free(f);
+        close(b->fd);
+        connWriteResponse(c, 500, "text/plain", "", 0, keepAlive);
+        return;
+    }
+    f->fd = b->fd;
+    f->size = b->size;
+    f->refs = 1; // Dropped (closing the file) once the transfer finishes
+    connWriteHeaders(c, statusCode, "application/json", (size_t)b->size, keepAlive);
+    connQueueFile(c, f, 0, (size_t)b->size);
+}
+
+// Run one complete request through static files / router / handler and
+// queue its response on the connection.
+static void handleRequest(HttpWorker* w, HttpConn* c, const char* request, size_t headerLen,
+                          const char* body, size_t bodyLen, bool keepAlive) {
+    VM* vm = w->vm;
+
+    // Parse Method and Path (Simple)
+    char method[16] = {0};
+    char path[1024] = {0};
+    sscanf(request, "%15s %1023s", method, path);
+
+    // Parse path and query string first (needed for route matching)
+    char cleanPath[1024];
+    char queryStr[1024] = {0};
+    char* queryStart = strchr(path, '?');
+    if (queryStart) {
+        int pathLen = queryStart - path;
+        memcpy(cleanPath, path, pathLen);
+        cleanPath[pathLen] = '\0';
+        strncpy(queryStr, queryStart + 1, sizeof(queryStr) - 1);
+    } else {
+        strncpy(cleanPath, path, sizeof(cleanPath) - 1);
+        cleanPath[sizeof(cleanPath) - 1] = '\0';
+    }
+
+    // Try serving static file first (no VM access, runs unlocked)
+    if (tryServeStatic(c, w->state->statics, method, cleanPath, request, headerLen, keepAlive)) return;
+
+    // Determine Handler (trie lookup, supports :param syntax; no VM access)
+    const PreparedCall* targetHandler = w->hasMainHandler ? &w->mainHandler : NULL;
+    RouteTarget* route = NULL;
+    RouteCapture caps[ROUTE_MAX_PARAMS];
+    int capCount = 0;
+    if (!targetHandler && w->state->routeTrie) {
+        const char* segs = cleanPath[0] == '/' ? cleanPath + 1 : cleanPath;
+        route = matchRouteTrie(w->state->routeTrie, segs, method, caps, 0, &capCount);
+        if (route) targetHandler = &route->handler;
+    }
+
+    if (!targetHandler) {
+        connWriteResponse(c, 404, "text/plain", "", 0, keepAlive);
+        return;
+    }
+
+    pthread_mutex_lock(&w->state->vmLock);
+    int rootBase = vm->stackTop;
+
+    // req.params - captured by route matching
+    Map* paramsMap = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(paramsMap); // Root it
+    for (int i = 0; i < capCount; i++) {
+        const char* name = route->paramNames[i];
+        ObjString* valStr = internString(vm, caps[i].start, caps[i].length);
+        mapSetStr(paramsMap, name, (int)strlen(name), OBJ_VAL(valStr));
+    }
+
+    // Build Request Map (Standard)
+    Map* reqMap = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(reqMap); // Root it
+    Value vMethod = OBJ_VAL(internString(vm, method, (int)strlen(method)));
+    mapSetStr(reqMap, "method", 6, vMethod);
+
+    Value vPath = OBJ_VAL(internString(vm, cleanPath, (int)strlen(cleanPath)));
+    mapSetStr(reqMap, "path", 4, vPath);
+
+    // req.query - parsed query string
+    Map* queryMap = newMap(vm);
+    mapSetStr(reqMap, "query", 5, OBJ_VAL(queryMap));
+    parseQueryString(vm, queryMap, queryStr);
+
+    // req.headers - parsed headers
+    Map* headerMap = newMap(vm);
+    mapSetStr(reqMap, "headers", 7, OBJ_VAL(headerMap));
+    parseHeaders(vm, headerMap, request);
+
+    // req.params - already populated by route matching
+    mapSetStr(reqMap, "params", 6, OBJ_VAL(paramsMap));
+
+    // req.body - exact Content-Length bytes
+    Value vBody = OBJ_VAL(internString(vm, body, (int)bodyLen));
+    mapSetStr(reqMap, "body", 4, vBody);
+
+    // Call Handler
+    Value handlerArgs[1];
+    handlerArgs[0] = OBJ_VAL(reqMap);
+
+    Value resVal = callPrepared(vm, targetHandler, handlerArgs);
+
+    // Queue Response - Support both string and Map responses
+    int statusCode = 200;
+    const char* contentType = "text/plain";
+    const char* content = "";
+    size_t contentLen = 0;
+    JsonBody jsonBody = { NULL, 0, -1, 0 };
+    bool hasJsonBody = false;
+
+    if (IS_STRING(resVal)) {
+        // Simple string response
+        content = AS_CSTRING(resVal);
+        contentLen = (size_t)AS_STRING(resVal)->length;
+    } else if (IS_MAP(resVal)) {
+        // Map response: {status: 201, contentType: "application/json", body: "..."}
+        Map* resMap = (Map*)AS_OBJ(resVal);
+
+        // Get status code
+        int bucket;
+        MapEntry* statusEntry = mapFindEntry(resMap, "status", 6, &bucket);
+        if (statusEntry && IS_INT(statusEntry->value)) {
+            statusCode = AS_INT(statusEntry->value);
+        }
+
+        // Get content type
+        MapEntry* typeEntry = mapFindEntry(resMap, "contentType", 11, &bucket);
+        if (typeEntry && IS_STRING(typeEntry->value)) {
+            contentType = AS_CSTRING(typeEntry->value);
+        }
+
+        // Get body
+        MapEntry* bodyEntry = mapFindEntry(resMap, "body", 4, &bucket);
+        if (bodyEntry) {
+            if (IS_STRING(bodyEntry->value)) {
+                content = AS_CSTRING(bodyEntry->value);
+                contentLen = (size_t)AS_STRING(bodyEntry->value)->length;
+            } else {
+                // Auto-serialize non-string body to JSON, streamed in chunks
+                hasJsonBody = jsonStreamValue(vm, bodyEntry->value, jsonBodySink, &jsonBody);
+                if (!hasJsonBody) {
+                    free(jsonBody.data);
+                    if (jsonBody.fd >= 0) close(jsonBody.fd);
+                    statusCode = 500;
+                }
+            }
+        }
+    }
+
+    // Copy out while the result is still reachable, then release the VM
+    if (hasJsonBody) connWriteJsonBody(c, statusCode, &jsonBody, keepAlive);
+    else connWriteResponse(c, statusCode, contentType, content, contentLen, keepAlive);
+    vm->stackTop = rootBase;
+    pthread_mutex_unlock(&w->state->vmLock);
+}
+
+// Parse and answer every complete request sitting in the input buffer
+static void connProcess(HttpWorker* w, HttpConn* c) {
+    size_t consumed = 0;
+
+    while (!c->closeAfterWrite && consumed < c->inLen) {
+        char* req = c->in + consumed;
+        size_t avail = c->inLen - consumed;
+
+        long headerLen = findHeaderEnd(req, avail);
+        if (headerLen < 0) {
+            if (avail > HTTP_MAX_HEADER) {
+                connWriteResponse(c, 431, "text/plain", "", 0, false);
+                c->closeAfterWrite = true;
+            }
+            break;
+        }
+
+        // HTTP/1.1 defaults to keep-alive, HTTP/1.0 must opt in
+        const char* lineEnd = memchr(req, '\n', (size_t)headerLen);
+        bool keepAlive = !(lineEnd && lineEnd - req >= 9 &&
+                           strncmp(lineEnd - 9, "HTTP/1.0", 8) == 0);
+        size_t valLen;
+        const char* conn = findHeader(req, (size_t)headerLen, "connection", &valLen);
+        if (conn) {
+            if (valLen == 5 && strncasecmp(conn, "close", 5) == 0) keepAlive = false;
+            else if (valLen == 10 && strncasecmp(conn, "keep-alive", 10) == 0) keepAlive = true;
+        }
+
+        if (findHeader(req, (size_t)headerLen, "transfer-encoding", &valLen)) {
+            connWriteResponse(c, 501, "text/plain", "", 0, false);
+            c->closeAfterWrite = true;
+            break;
+        }
+
+        size_t bodyLen = 0;
+        const char* cl = findHeader(req, (size_t)headerLen, "content-length", &valLen);
+        if (cl) bodyLen = (size_t)strtoull(cl, NULL, 10);
+        if (bodyLen > HTTP_MAX_BODY) {
+            connWriteResponse(c, 413, "text/plain", "", 0, false);
+            c->closeAfterWrite = true;
+            break;
+        }
+        if (avail < (size_t)headerLen + bodyLen) break; // Wait for the rest of the body
+
+        handleRequest(w, c, req, (size_t)headerLen, req + headerLen, bodyLen, keepAlive);
+        consumed += (size_t)headerLen + bodyLen;
+        if (!keepAlive) c->closeAfterWrite = true;
+    }
+
+    if (consumed > 0) {
+        memmove(c->in, c->in + consumed, c->inLen - consumed);
+        c->inLen -= consumed;
+        c->in[c->inLen] = '\0';
+    }
+}
+
+// Send as much queued output as the socket accepts. Returns false on error.
+// Buffered bytes and sendfile() regions are interleaved in response order.
+static bool connFlush(HttpConn* c) {
+    while (1) {
+        size_t limit = c->fileHead < c->fileCount ? c->files[c->fileHead].at : c->outLen;
+        while (c->outSent < limit) {
+            ssize_t n = send(c->fd, c->out + c->outSent, limit - c->outSent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            c->outSent += (size_t)n;
+        }
+        if (c->fileHead == c->fileCount) break;
+
+        HttpFileSeg* seg = &c->files[c->fileHead];
+        while (seg->remaining > 0) {
+            ssize_t n = sendfile(c->fd, seg->file->fd, &seg->offset, seg->remaining);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (n == 0) return false; // File shrank underneath us
+            seg->remaining -= (size_t)n;
+        }
+        staticFileRelease(seg->file);
+        c->fileHead++;
+    }
+    c->outLen = 0;
+    c->outSent = 0;
+    c->fileHead = 0;
+    c->fileCount = 0;
+    return true;
+}
+
+static void connClose(int epfd, HttpConn* c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    for (int i = c->fileHead; i < c->fileCount; i++) {
+        staticFileRelease(c->files[i].file);
+    }
+    free(c->files);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+// Read everything available. Returns false if the connection failed.
+static bool connRead(HttpConn* c) {
+    while (1) {
+        connReserve(&c->in, &c->inCap, c->inLen + HTTP_READ_CHUNK + 1);
+        ssize_t n = recv(c->fd, c->in + c->inLen, c->inCap - c->inLen - 1, 0);
+        if (n > 0) {
+            c->inLen += (size_t)n;
+            c->in[c->inLen] = '\0';
+            continue;
+        }
+        if (n == 0) {
+            c->peerClosed = true;
+            return true;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+        if (errno == EINTR) continue;
+        return false;
+    }
+}
+
+static void acceptConnections(int epfd, int listenFd) {
+    while (1) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN: another worker won the race, or backlog drained
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        HttpConn* c = calloc(1, sizeof(HttpConn));
+        c->fd = fd;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static void* httpWorkerLoop(void* arg) {
+    HttpWorker* w = (HttpWorker*)arg;
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL marks the listening socket
+    epoll_ctl(epfd, EPOLL_CTL_ADD, w->listenFd, &ev);
+
+    struct epoll_event events[HTTP_MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(epfd, events, HTTP_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            HttpConn* c = (HttpConn*)events[i].data.ptr;
+            if (!c) {
+                acceptConnections(epfd, w->listenFd);
+                continue;
+            }
+
+            uint32_t flags = events[i].events;
+            bool ok = !(flags & EPOLLERR);
+            if (ok && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) {
+                ok = connRead(c);
+                if (ok) connProcess(w, c);
+            }
+            if (ok) ok = connFlush(c);
+
+            bool drained = c->outLen == 0 && c->fileCount == 0;
+            if (!ok || (drained && (c->closeAfterWrite || c->peerClosed))) {
+                connClose(epfd, c);
+                continue;
+            }
+
+            // Only watch for writability while output is queued
+            if (drained == c->wantWrite) {
+                c->wantWrite = !drained;
+                struct epoll_event mod;
+                mod.events = EPOLLIN | EPOLLRDHUP | (c->wantWrite ? EPOLLOUT : 0);
+                mod.data.ptr = c;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &mod);
+            }
+        }
+    }
+
+    close(epfd);
+    return NULL;
+}
+
+// ucoreHttp.listen(port, [handlerName], [workers])
+// workers <= 0 means one event loop per online CPU.
 static Value uhttp_listen(VM* vm, Value* args, int argCount) {
     if (argCount < 1 || !IS_INT(args[0])) {
-        printf("Error: ucoreHttp.listen(port, [handlerName]) expects int port.\n");
+        printf("Error: ucoreHttp.listen(port, [handlerName], [workers]) expects int port.\n");
         return BOOL_VAL(false);
     }
     
     int port = AS_INT(args[0]);
     char* mainHandlerName = NULL;
     Function* mainHandler = NULL;
+    PreparedCall mainCall;
     
     if (argCount >= 2 && IS_STRING(args[1])) {
         mainHandlerName = AS_CSTRING(args[1]);
@@ -539,15 +1462,26 @@ static Value uhttp_listen(VM* vm, Value* args, int argCount) {
              printf("Error: Handler function '%s' not found.\n", mainHandlerName);
              return BOOL_VAL(false);
         }
+        if (!prepareCall(mainHandler, 1, &mainCall)) {
+             printf("Error: Handler function '%s' must take one argument (the request).\n", mainHandlerName);
+             return BOOL_VAL(false);
+        }
+    }
+
+    int workerCount = 1;
+    if (argCount >= 3 && IS_INT(args[2])) {
+        workerCount = AS_INT(args[2]);
+        if (workerCount <= 0) workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (workerCount < 1) workerCount = 1;
+        if (workerCount > HTTP_MAX_WORKERS) workerCount = HTTP_MAX_WORKERS;
     }
     
-    int server_fd, new_socket;
+    int server_fd;
     struct sockaddr_in address;
     int opt = 1;
-    int addrlen = sizeof(address);
     
     // Create socket
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         perror("socket failed");
         return BOOL_VAL(false);
     }
@@ -558,6 +1492,9 @@ static Value uhttp_listen(VM* vm, Value* args, int argCount) {
         perror("setsockopt");
         return BOOL_VAL(false);
     }
+    // Isolates on other threads may listen on the same port; the kernel
+    // spreads connections across them
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
     
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
@@ -568,190 +1505,38 @@ static Value uhttp_listen(VM* vm, Value* args, int argCount) {
         return BOOL_VAL(false);
     }
     
-    if (listen(server_fd, 3) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen");
         return BOOL_VAL(false);
     }
+
+    if (!mainHandler) compileRoutes(vm);
+
+    // Every worker polls the same non-blocking listener; losers of an accept race get EAGAIN
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK);
     
     printf("Server listening on port %d...\n", port);
     if (mainHandlerName) printf("Using main handler: %s\n", mainHandlerName);
     else printf("Using router.\n");
+    if (workerCount > 1) printf("Event loop workers: %d\n", workerCount);
     fflush(stdout);
-    
-    while (1) {
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) {
-            perror("accept");
-            continue;
-        }
-        
-        // Read Request
-        char buffer[4096] = {0};
-        ssize_t n = recv(new_socket, buffer, 4096, 0);
-        if (n <= 0) {
-            close(new_socket);
-            continue;
-        }
-        
-        // Parse Method and Path (Simple)
-        char method[16] = {0};
-        char path[1024] = {0};
-        char* body = "";
-        
-        sscanf(buffer, "%s %s", method, path);
-        
-        // Find body
-        char* bodyStart = strstr(buffer, "\r\n\r\n");
-        if (bodyStart) body = bodyStart + 4;
-        
-        // Parse path and query string first (needed for route matching)
-        char cleanPath[1024];
-        char queryStr[1024] = {0};
-        char* queryStart = strchr(path, '?');
-        if (queryStart) {
-            int pathLen = queryStart - path;
-            memcpy(cleanPath, path, pathLen);
-            cleanPath[pathLen] = '\0';
-            strncpy(queryStr, queryStart + 1, sizeof(queryStr) - 1);
-        } else {
-            strncpy(cleanPath, path, sizeof(cleanPath) - 1);
-            cleanPath[sizeof(cleanPath) - 1] = '\0';
-        }
-        
-        // Try serving static file first
-        if (tryServeStatic(new_socket, cleanPath)) {
-            close(new_socket);
-            continue;
-        }
-        
-        // req.params - will be populated by route matching
-        Map* paramsMap = newMap(vm);
-        
-        // Determine Handler (with pattern matching)
-        Function* targetHandler = mainHandler;
-        if (!targetHandler) {
-            // Check routes
-            Route* r = g_routes;
-            while (r) {
-                if (strcmp(r->method, method) == 0) {
-                    // Try pattern matching (supports :param syntax)
-                    if (matchRoute(r->path, cleanPath, vm, paramsMap)) {
-                        targetHandler = findFunctionByName(vm, r->handlerName);
-                        break;
-                    }
-                }
-                r = r->next;
-            }
-        }
-        
-        if (!targetHandler) {
-            // 404
-            const char* msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-            send(new_socket, msg, strlen(msg), 0);
-            close(new_socket);
-            continue;
-        }
-        
-        // Build Request Map (Standard)
-        Map* reqMap = newMap(vm);
-        Value vMethod = OBJ_VAL(internString(vm, method, (int)strlen(method)));
-        mapSetStr(reqMap, "method", 6, vMethod);
-        
-        Value vPath = OBJ_VAL(internString(vm, cleanPath, (int)strlen(cleanPath)));
-        mapSetStr(reqMap, "path", 4, vPath);
-        
-        // req.query - parsed query string
-        Map* queryMap = newMap(vm);
-        parseQueryString(vm, queryMap, queryStr);
-        mapSetStr(reqMap, "query", 5, OBJ_VAL(queryMap));
-        
-        // req.headers - parsed headers
-        Map* headerMap = newMap(vm);
-        parseHeaders(vm, headerMap, buffer);
-        mapSetStr(reqMap, "headers", 7, OBJ_VAL(headerMap));
-        
-        // req.params - already populated by route matching
-        mapSetStr(reqMap, "params", 6, OBJ_VAL(paramsMap));
 
-        // req.body
-        Value vBody = OBJ_VAL(internString(vm, body, (int)strlen(body)));
-        mapSetStr(reqMap, "body", 4, vBody);
-        
-        Value vReq = OBJ_VAL(reqMap);
-        
-        // Call Handler
-        Value handlerArgs[1];
-        handlerArgs[0] = vReq;
-        
-        Value resVal = callFunction(vm, targetHandler, handlerArgs, 1);
-        
-        // Send Response - Support both string and Map responses
-        char respBuffer[8192];
-        int statusCode = 200;
-        const char* contentType = "text/plain";
-        char* content = "";
-        bool freeContent = false;
-        
-        if (IS_STRING(resVal)) {
-            // Simple string response
-            content = AS_CSTRING(resVal);
-        } else if (IS_MAP(resVal)) {
-            // Map response: {status: 201, contentType: "application/json", body: "..."}
-            Map* resMap = (Map*)AS_OBJ(resVal);
-            
-            // Get status code
-            int bucket;
-            MapEntry* statusEntry = mapFindEntry(resMap, "status", 6, &bucket);
-            if (statusEntry && IS_INT(statusEntry->value)) {
-                statusCode = AS_INT(statusEntry->value);
-            }
-            
-            // Get content type
-            MapEntry* typeEntry = mapFindEntry(resMap, "contentType", 11, &bucket);
-            if (typeEntry && IS_STRING(typeEntry->value)) {
-                contentType = AS_CSTRING(typeEntry->value);
-            }
-            
-            // Get body
-            MapEntry* bodyEntry = mapFindEntry(resMap, "body", 4, &bucket);
-            if (bodyEntry) {
-                if (IS_STRING(bodyEntry->value)) {
-                    content = AS_CSTRING(bodyEntry->value);
-                } else {
-                    // Auto-serialize non-string body to JSON
-                    int cap = 1024, len = 0;
-                    char* buf = malloc(cap);
-                    buf[0] = '\0';
-                    json_serialize_val(bodyEntry->value, &buf, &len, &cap);
-                    content = buf;
-                    freeContent = true;
-                    contentType = "application/json";
-                }
-            }
+    // Shared by all workers for the life of the process
+    HttpWorker* worker = malloc(sizeof(HttpWorker));
+    worker->vm = vm;
+    worker->state = httpState(vm);
+    worker->hasMainHandler = mainHandler != NULL;
+    if (mainHandler) worker->mainHandler = mainCall;
+    worker->listenFd = server_fd;
+    for (int i = 1; i < workerCount; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, httpWorkerLoop, worker) == 0) {
+            pthread_detach(tid);
         }
-        
-        // Build HTTP response
-        const char* statusText = "OK";
-        if (statusCode == 201) statusText = "Created";
-        else if (statusCode == 204) statusText = "No Content";
-        else if (statusCode == 400) statusText = "Bad Request";
-        else if (statusCode == 401) statusText = "Unauthorized";
-        else if (statusCode == 403) statusText = "Forbidden";
-        else if (statusCode == 404) statusText = "Not Found";
-        else if (statusCode == 500) statusText = "Internal Server Error";
-        
-        snprintf(respBuffer, sizeof(respBuffer), 
-            "HTTP/1.1 %d %s\r\n"
-            "Content-Type: %s\r\n"
-            "Content-Length: %ld\r\n"
-            "Access-Control-Allow-Origin: *\r\n"
-            "\r\n"
-            "%s", statusCode, statusText, contentType, strlen(content), content);
-            
-        send(new_socket, respBuffer, strlen(respBuffer), 0);
-        if (freeContent) free(content);
-        
-        close(new_socket);
     }
+
+    // The calling thread is worker 0; this only returns if epoll fails
+    httpWorkerLoop(worker);
     
     return BOOL_VAL(true);
 }
@@ -761,18 +1546,17 @@ void registerUCoreHttp(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreHttp", 9);
     char* modName = modNameObj->chars; 
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName); 
+    vm->stackTop--;
     mod->obj.isMarked = true; 
     mod->obj.isPermanent = true; // PERMANENT ROOT
     
-    // CRITICAL: Use ALLOCATE_OBJ for Environment to enable GC tracking
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL; // Globals
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
     
     defineNative(vm, mod->env, "get", uhttp_get, 1);
@@ -780,12 +1564,20 @@ void registerUCoreHttp(VM* vm) {
     defineNative(vm, mod->env, "put", uhttp_put, 2);
     defineNative(vm, mod->env, "delete", uhttp_delete, 1);
     defineNative(vm, mod->env, "patch", uhttp_patch, 2);
-    defineNative(vm, mod->env, "listen", uhttp_listen, 2);
+    defineNative(vm, mod->env, "getAll", uhttp_getAll, 1);
+    defineNative(vm, mod->env, "listen", uhttp_listen, 3);
     defineNative(vm, mod->env, "json", uhttp_json, 1);
     defineNative(vm, mod->env, "route", uhttp_route, 3);
     defineNative(vm, mod->env, "use", uhttp_use, 1);
     defineNative(vm, mod->env, "static", uhttp_static, 2);
     
+    HttpState* state = calloc(1, sizeof(HttpState));
+    if (!state) exit(1);
+    VarEntry* getEntry = envFindEntry(mod->env, "get", 3, hash("get", 3));
+    state->getFn = (Function*)AS_OBJ(getEntry->value);
+    pthread_mutex_init(&state->vmLock, NULL);
+    setLibState(vm, &httpStateKey, state, freeHttpState);
+
     Value vMod = OBJ_VAL(mod);
     defineGlobal(vm, "ucoreHttp", vMod);
 }
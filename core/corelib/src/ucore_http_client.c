@@ -0,0 +1,549 @@
+#include "ucore_http_client.h"
+#include "runtime/scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * HTTP Client Engine
+ *
+ * Every host gets one HttpHost entry holding its resolved address and a
+ * small stack of idle keep-alive sockets. A request takes an idle socket
+ * if one is still usable, otherwise connects fresh; after a complete
+ * response the socket goes back on the stack unless the server asked to
+ * close or the body was delimited by EOF.
+ */
+
+#define HTTP_CLIENT_MAX_IDLE      8     // Idle sockets kept per host
+#define HTTP_CLIENT_IDLE_TIMEOUT  30    // Seconds before an idle socket is dropped
+#define HTTP_CLIENT_DNS_TTL       60    // Seconds a resolved address is trusted
+#define HTTP_CLIENT_MAX_HEADER    (64 * 1024)
+
+typedef struct HttpHost {
+    char host[256];
+    int port;
+    struct sockaddr_in addr;
+    time_t resolvedAt;                      // 0 = never resolved
+    int idleFds[HTTP_CLIENT_MAX_IDLE];
+    time_t idleSince[HTTP_CLIENT_MAX_IDLE];
+    int idleCount;
+    struct HttpHost* next;
+} HttpHost;
+
+static HttpHost* g_hosts = NULL;
+static pthread_mutex_t g_clientLock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct HttpUrl {
+    char host[256];
+    int port;
+    char path[1024];
+} HttpUrl;
+
+// Simple parser: http://host:port/path
+static bool parseHttpUrl(const char* url, HttpUrl* out) {
+    const char* p = url;
+    if (strncmp(p, "http://", 7) == 0) p += 7;
+    else if (strncmp(p, "https://", 8) == 0) {
+        printf("Error: HTTPS not supported in uCoreHttp (no OpenSSL).\n");
+        return false;
+    }
+
+    const char* start = p;
+    while (*p && *p != ':' && *p != '/') p++;
+    int hostLen = (int)(p - start);
+    if (hostLen == 0 || hostLen >= (int)sizeof(out->host)) return false;
+    memcpy(out->host, start, hostLen);
+    out->host[hostLen] = '\0';
+
+    out->port = 80;
+    if (*p == ':') {
+        p++;
+        out->port = atoi(p);
+        while (*p && *p != '/') p++;
+    }
+    if (out->port <= 0 || out->port > 65535) return false;
+
+    if (*p == '/') {
+        size_t len = strlen(p);
+        if (len >= sizeof(out->path)) len = sizeof(out->path) - 1;
+        memcpy(out->path, p, len);
+        out->path[len] = '\0';
+    } else {
+        strcpy(out->path, "/");
+    }
+    return true;
+}
+
+// Find or create the pool entry for host:port (caller holds g_clientLock)
+static HttpHost* findHost(const char* host, int port) {
+    for (HttpHost* h = g_hosts; h; h = h->next) {
+        if (h->port == port && strcmp(h->host, host) == 0) return h;
+    }
+    HttpHost* h = calloc(1, sizeof(HttpHost));
+    snprintf(h->host, sizeof(h->host), "%s", host);
+    h->port = port;
+    h->next = g_hosts;
+    g_hosts = h;
+    return h;
+}
+
+// Resolve through the DNS cache. The lookup itself still blocks.
+static bool resolveHost(HttpHost* h, struct sockaddr_in* out) {
+    time_t now = time(NULL);
+    pthread_mutex_lock(&g_clientLock);
+    if (h->resolvedAt && now - h->resolvedAt < HTTP_CLIENT_DNS_TTL) {
+        *out = h->addr;
+        pthread_mutex_unlock(&g_clientLock);
+        return true;
+    }
+    pthread_mutex_unlock(&g_clientLock);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(h->host, NULL, &hints, &res) != 0 || !res) {
+        printf("Could not resolve host: %s\n", h->host);
+        return false;
+    }
+    struct sockaddr_in addr;
+    memcpy(&addr, res->ai_addr, sizeof(addr));
+    addr.sin_port = htons(h->port);
+    freeaddrinfo(res);
+
+    pthread_mutex_lock(&g_clientLock);
+    h->addr = addr;
+    h->resolvedAt = now;
+    pthread_mutex_unlock(&g_clientLock);
+    *out = addr;
+    return true;
+}
+
+// Pop an idle socket that still looks alive, or -1
+static int takeIdle(HttpHost* h) {
+    time_t now = time(NULL);
+    pthread_mutex_lock(&g_clientLock);
+    while (h->idleCount > 0) {
+        h->idleCount--;
+        int fd = h->idleFds[h->idleCount];
+        if (now - h->idleSince[h->idleCount] >= HTTP_CLIENT_IDLE_TIMEOUT) {
+            close(fd);
+            continue;
+        }
+        // An idle socket should have nothing to read; readable means the
+        // peer closed it (or sent garbage)
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_mutex_unlock(&g_clientLock);
+        return fd;
+    }
+    pthread_mutex_unlock(&g_clientLock);
+    return -1;
+}
+
+static void releaseIdle(HttpHost* h, int fd) {
+    pthread_mutex_lock(&g_clientLock);
+    if (h->idleCount < HTTP_CLIENT_MAX_IDLE) {
+        h->idleFds[h->idleCount] = fd;
+        h->idleSince[h->idleCount] = time(NULL);
+        h->idleCount++;
+        fd = -1;
+    }
+    pthread_mutex_unlock(&g_clientLock);
+    if (fd >= 0) close(fd);
+}
+
+// Non-blocking connect so an async task can yield while the handshake runs
+static int connectHost(VM* vm, const struct sockaddr_in* addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Socket creation failed");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    int rc = connect(fd, (const struct sockaddr*)addr, sizeof(*addr));
+    if (rc < 0 && errno == EINPROGRESS) {
+        taskWaitFd(vm, fd, POLLOUT);
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        poll(&pfd, 1, -1);
+        int soErr = 0;
+        socklen_t errLen = sizeof(soErr);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &soErr, &errLen);
+        if (soErr != 0) {
+            errno = soErr;
+            rc = -1;
+        } else {
+            rc = 0;
+        }
+    }
+    if (rc < 0) {
+        perror("Connection failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool sendAll(VM* vm, int fd, const char* data, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t n = send(fd, data + off, len - off, MSG_NOSIGNAL);
+        if (n > 0) {
+            off += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            taskWaitFd(vm, fd, POLLOUT);
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Growable receive buffer; 'pos' is the parse cursor
+typedef struct RecvBuf {
+    char* data;
+    size_t len;
+    size_t cap;
+    size_t pos;
+} RecvBuf;
+
+// Read more bytes; returns false on EOF or error
+static bool recvMore(VM* vm, int fd, RecvBuf* rb) {
+    if (rb->len + 4096 > rb->cap) {
+        rb->cap = rb->cap ? rb->cap * 2 : 8192;
+        rb->data = realloc(rb->data, rb->cap);
+    }
+    while (1) {
+        ssize_t n = recv(fd, rb->data + rb->len, rb->cap - rb->len - 1, 0);
+        if (n > 0) {
+            rb->len += (size_t)n;
+            return true;
+        }
+        if (n == 0) return false;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+        taskWaitFd(vm, fd, POLLIN); // Other tasks run until data arrives
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, -1);
+    }
+}
+
+// Append n bytes at the cursor to the body
+static void takeBody(RecvBuf* rb, HttpClientResponse* resp, size_t* bodyCap, size_t n) {
+    if (resp->bodyLen + n + 1 > *bodyCap) {
+        while (resp->bodyLen + n + 1 > *bodyCap) *bodyCap = *bodyCap ? *bodyCap * 2 : 4096;
+        resp->body = realloc(resp->body, *bodyCap);
+    }
+    memcpy(resp->body + resp->bodyLen, rb->data + rb->pos, n);
+    resp->bodyLen += n;
+    rb->pos += n;
+}
+
+// Read exactly 'want' body bytes
+static bool readFixed(VM* vm, int fd, RecvBuf* rb, HttpClientResponse* resp,
+                      size_t* bodyCap, size_t want) {
+    while (want > 0) {
+        if (rb->pos == rb->len) {
+            rb->pos = rb->len = 0; // Fully consumed: reuse the buffer from the start
+            if (!recvMore(vm, fd, rb)) return false;
+        }
+        size_t avail = rb->len - rb->pos;
+        size_t n = avail < want ? avail : want;
+        takeBody(rb, resp, bodyCap, n);
+        want -= n;
+    }
+    return true;
+}
+
+// Read one CRLF-terminated line at the cursor; returns its length
+static bool readLine(VM* vm, int fd, RecvBuf* rb, size_t* lineLen) {
+    while (1) {
+        char* nl = rb->pos < rb->len ? memchr(rb->data + rb->pos, '\n', rb->len - rb->pos) : NULL;
+        if (nl) {
+            *lineLen = (size_t)(nl - (rb->data + rb->pos)) + 1;
+            return true;
+        }
+        if (rb->len - rb->pos > 4096) return false;
+        if (!recvMore(vm, fd, rb)) return false;
+    }
+}
+
+static bool readChunked(VM* vm, int fd, RecvBuf* rb, HttpClientResponse* resp, size_t* bodyCap) {
+    while (1) {
+        size_t lineLen;
+        if (!readLine(vm, fd, rb, &lineLen)) return false;
+        char* end = NULL;
+        unsigned long size = strtoul(rb->data + rb->pos, &end, 16);
+        if (end == rb->data + rb->pos) return false;
+        rb->pos += lineLen;
+        if (size == 0) break;
+        if (!readFixed(vm, fd, rb, resp, bodyCap, size)) return false;
+        if (!readLine(vm, fd, rb, &lineLen)) return false; // CRLF after data
+        rb->pos += lineLen;
+    }
+    // Trailers end with an empty line
+    while (1) {
+        size_t lineLen;
+        if (!readLine(vm, fd, rb, &lineLen)) return false;
+        bool blank = lineLen <= 2;
+        rb->pos += lineLen;
+        if (blank) return true;
+    }
+}
+
+// Case-insensitive header lookup inside [hdr, hdr+len)
+static const char* headerValue(const char* hdr, size_t len, const char* name, size_t* valLen) {
+    size_t nameLen = strlen(name);
+    const char* p = hdr;
+    const char* end = hdr + len;
+    while (p < end) {
+        const char* eol = memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        if ((size_t)(eol - p) > nameLen && p[nameLen] == ':' && strncasecmp(p, name, nameLen) == 0) {
+            const char* v = p + nameLen + 1;
+            while (v < eol && (*v == ' ' || *v == '\t')) v++;
+            const char* ve = eol;
+            while (ve > v && (ve[-1] == '\r' || ve[-1] == ' ')) ve--;
+            *valLen = (size_t)(ve - v);
+            return v;
+        }
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+typedef enum {
+    EXCHANGE_OK,
+    EXCHANGE_FAILED,        // Transport error after the response started
+    EXCHANGE_STALE          // Reused socket died before any response byte
+} ExchangeResult;
+
+// Send one request on fd and read the response. *keepAlive reports whether
+// the socket may be reused afterwards.
+static ExchangeResult exchange(VM* vm, int fd, const char* req, size_t reqLen,
+                               const char* body, size_t bodyLen, bool isHead,
+                               HttpClientResponse* resp, bool* keepAlive) {
+    *keepAlive = false;
+    if (!sendAll(vm, fd, req, reqLen)) return EXCHANGE_STALE;
+    if (bodyLen > 0 && !sendAll(vm, fd, body, bodyLen)) return EXCHANGE_STALE;
+
+    RecvBuf rb = { NULL, 0, 0, 0 };
+    size_t headerLen = 0;
+    while (1) {
+        for (size_t i = 3; i < rb.len; i++) {
+            if (rb.data[i] == '\n' && rb.data[i - 1] == '\r' && rb.data[i - 2] == '\n' && rb.data[i - 3] == '\r') {
+                headerLen = i + 1;
+                break;
+            }
+        }
+        if (headerLen) break;
+        if (rb.len > HTTP_CLIENT_MAX_HEADER) {
+            free(rb.data);
+            return EXCHANGE_FAILED;
+        }
+        if (!recvMore(vm, fd, &rb)) {
+            bool started = rb.len > 0;
+            free(rb.data);
+            return started ? EXCHANGE_FAILED : EXCHANGE_STALE;
+        }
+    }
+
+    // Status line: HTTP/1.x NNN
+    if (headerLen < 12 || strncmp(rb.data, "HTTP/1.", 7) != 0) {
+        free(rb.data);
+        return EXCHANGE_FAILED;
+    }
+    bool http10 = rb.data[7] == '0';
+    resp->status = atoi(rb.data + 9);
+    const char* hdrs = memchr(rb.data, '\n', headerLen);
+    hdrs = hdrs ? hdrs + 1 : rb.data + headerLen;
+    size_t hdrsLen = (size_t)(rb.data + headerLen - hdrs);
+
+    size_t vLen;
+    const char* v;
+    bool connClose = http10;
+    if ((v = headerValue(hdrs, hdrsLen, "Connection", &vLen)) != NULL) {
+        if (vLen == 5 && strncasecmp(v, "close", 5) == 0) connClose = true;
+        if (vLen == 10 && strncasecmp(v, "keep-alive", 10) == 0) connClose = false;
+    }
+    resp->location[0] = '\0';
+    if ((v = headerValue(hdrs, hdrsLen, "Location", &vLen)) != NULL && vLen < sizeof(resp->location)) {
+        memcpy(resp->location, v, vLen);
+        resp->location[vLen] = '\0';
+    }
+    bool chunked = false;
+    if ((v = headerValue(hdrs, hdrsLen, "Transfer-Encoding", &vLen)) != NULL) {
+        for (size_t i = 0; i + 7 <= vLen; i++) {
+            if (strncasecmp(v + i, "chunked", 7) == 0) { chunked = true; break; }
+        }
+    }
+    long contentLength = -1;
+    if (!chunked && (v = headerValue(hdrs, hdrsLen, "Content-Length", &vLen)) != NULL) {
+        contentLength = strtol(v, NULL, 10);
+    }
+
+    rb.pos = headerLen;
+    size_t bodyCap = 0;
+    bool ok = true;
+    bool noBody = isHead || (resp->status >= 100 && resp->status < 200) ||
+                  resp->status == 204 || resp->status == 304;
+    if (noBody) {
+        // Nothing to read
+    } else if (chunked) {
+        ok = readChunked(vm, fd, &rb, resp, &bodyCap);
+    } else if (contentLength >= 0) {
+        ok = readFixed(vm, fd, &rb, resp, &bodyCap, (size_t)contentLength);
+    } else {
+        // Delimited by EOF: the socket cannot be reused
+        connClose = true;
+        while (1) {
+            takeBody(&rb, resp, &bodyCap, rb.len - rb.pos);
+            rb.pos = rb.len = 0;
+            if (!recvMore(vm, fd, &rb)) break;
+        }
+    }
+    free(rb.data);
+
+    if (!resp->body) {
+        resp->body = malloc(1);
+    }
+    resp->body[resp->bodyLen] = '\0';
+    if (!ok) return EXCHANGE_FAILED;
+    *keepAlive = !connClose;
+    return EXCHANGE_OK;
+}
+
+static void resetResponse(HttpClientResponse* resp) {
+    free(resp->body);
+    resp->body = NULL;
+    resp->bodyLen = 0;
+    resp->status = 0;
+    resp->location[0] = '\0';
+}
+
+// One request/response against a single URL (no redirects)
+static bool requestOnce(VM* vm, const char* method, const HttpUrl* u,
+                        const char* body, size_t bodyLen, HttpClientResponse* resp) {
+    pthread_mutex_lock(&g_clientLock);
+    HttpHost* h = findHost(u->host, u->port);
+    pthread_mutex_unlock(&g_clientLock);
+
+    char hostHeader[300];
+    if (u->port == 80) snprintf(hostHeader, sizeof(hostHeader), "%s", u->host);
+    else snprintf(hostHeader, sizeof(hostHeader), "%s:%d", u->host, u->port);
+
+    char req[2048];
+    int reqLen = snprintf(req, sizeof(req),
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "User-Agent: Unnarize/1.0\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Length: %zu\r\n"
+        "\r\n",
+        method, u->path, hostHeader, bodyLen);
+    if (reqLen < 0 || reqLen >= (int)sizeof(req)) return false;
+    bool isHead = strcmp(method, "HEAD") == 0;
+
+    // A pooled socket may have been closed by the server in the meantime;
+    // in that case retry once on a fresh connection
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int fd = takeIdle(h);
+        bool reused = fd >= 0;
+        if (!reused) {
+            struct sockaddr_in addr;
+            if (!resolveHost(h, &addr)) return false;
+            fd = connectHost(vm, &addr);
+            if (fd < 0) return false;
+        }
+
+        bool keepAlive;
+        ExchangeResult r = exchange(vm, fd, req, (size_t)reqLen, body, bodyLen, isHead, resp, &keepAlive);
+        if (r == EXCHANGE_OK) {
+            if (keepAlive) releaseIdle(h, fd);
+            else close(fd);
+            return true;
+        }
+        close(fd);
+        resetResponse(resp);
+        if (r == EXCHANGE_STALE && reused) continue;
+        printf("HTTP request failed: %s %s:%d%s\n", method, u->host, u->port, u->path);
+        return false;
+    }
+    return false;
+}
+
+// Resolve a Location value against the current URL
+static void redirectTarget(const HttpUrl* base, const char* location, char* out, size_t outSize) {
+    if (strncmp(location, "http://", 7) == 0 || strncmp(location, "https://", 8) == 0) {
+        snprintf(out, outSize, "%s", location);
+    } else if (location[0] == '/') {
+        snprintf(out, outSize, "http://%s:%d%s", base->host, base->port, location);
+    } else {
+        // Relative to the current directory
+        const char* slash = strrchr(base->path, '/');
+        int dirLen = slash ? (int)(slash - base->path) + 1 : 1;
+        snprintf(out, outSize, "http://%s:%d%.*s%s", base->host, base->port, dirLen, base->path, location);
+    }
+}
+
+bool httpClientRequest(VM* vm, const char* method, const char* url,
+                       const char* body, size_t bodyLen, int maxRedirects,
+                       HttpClientResponse* resp) {
+    memset(resp, 0, sizeof(*resp));
+    char current[2048];
+    snprintf(current, sizeof(current), "%s", url);
+
+    for (int hop = 0; ; hop++) {
+        HttpUrl u;
+        if (!parseHttpUrl(current, &u)) {
+            printf("Invalid URL or HTTPS not supported.\n");
+            return false;
+        }
+        if (!requestOnce(vm, method, &u, body, bodyLen, resp)) return false;
+
+        int s = resp->status;
+        bool isRedirect = (s == 301 || s == 302 || s == 303 || s == 307 || s == 308) && resp->location[0];
+        if (!isRedirect || hop >= maxRedirects) return true;
+        if (strncmp(resp->location, "https://", 8) == 0) return true; // Caller decides
+
+        char next[2048];
+        redirectTarget(&u, resp->location, next, sizeof(next));
+        snprintf(current, sizeof(current), "%s", next);
+        // 303 always, and 301/302 for non-GET in practice, switch to GET
+        if (s == 303 || ((s == 301 || s == 302) && strcmp(method, "HEAD") != 0)) {
+            method = "GET";
+            body = NULL;
+            bodyLen = 0;
+        }
+        resetResponse(resp);
+    }
+}
+
+void httpClientFreeResponse(HttpClientResponse* resp) {
+    free(resp->body);
+    resp->body = NULL;
+    resp->bodyLen = 0;
+}
@@ -4,13 +4,19 @@
 #include <string.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "runtime/isolate.h"
+#include "runtime/fileio.h"
 
 // ============================================================================
 // Helpers
 // ============================================================================
 
 static void push(VM* vm, Value val) {
-    if (vm->stackTop >= STACK_MAX) {
+    if (vm->stackTop >= ROOT_STACK_MAX) {
         printf("Stack overflow in JSON parser\n");
         exit(1);
     }
@@ -28,10 +34,81 @@ static ObjString* copyString(VM* vm, const char* chars, int length) {
 // ============================================================================
 // JSON Parser
 // ============================================================================
+//
+// Two passes over the input. Stage 1 classifies it 64 bytes at a time into
+// bitmasks of quotes, backslashes, structural characters and whitespace
+// (AVX2/SSE2/NEON compares, scalar fallback), resolves escapes and string
+// spans with bit arithmetic, and records the offset of every structural
+// character, string and scalar outside strings. Stage 2 walks those offsets
+// and builds Arrays and Maps directly; stage 1 already proved every string
+// is terminated, so it never has to re-check for the end of the input.
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i JsonVec;
+#define JSON_VEC_BYTES 32
+#define vecLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vecSplat(c) _mm256_set1_epi8(c)
+#define vecEq(a, b) _mm256_cmpeq_epi8(a, b)
+#define vecOr(a, b) _mm256_or_si256(a, b)
+#define vecMask(v) ((uint64_t)(uint32_t)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i JsonVec;
+#define JSON_VEC_BYTES 16
+#define vecLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define vecSplat(c) _mm_set1_epi8(c)
+#define vecEq(a, b) _mm_cmpeq_epi8(a, b)
+#define vecOr(a, b) _mm_or_si128(a, b)
+#define vecMask(v) ((uint64_t)(uint32_t)_mm_movemask_epi8(v))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+typedef uint8x16_t JsonVec;
+#define JSON_VEC_BYTES 16
+#define vecLoad(p) vld1q_u8((const uint8_t*)(p))
+#define vecSplat(c) vdupq_n_u8((uint8_t)(c))
+#define vecEq(a, b) vceqq_u8(a, b)
+#define vecOr(a, b) vorrq_u8(a, b)
+#define vecMask(v) neonMovemask(v)
+
+// One bit per lane, like SSE2 movemask: weight the lanes, then fold pairwise
+static inline uint64_t neonMovemask(uint8x16_t v) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t m = vandq_u8(v, vld1q_u8(weights));
+    m = vpaddq_u8(m, m);
+    m = vpaddq_u8(m, m);
+    m = vpaddq_u8(m, m);
+    return vgetq_lane_u16(vreinterpretq_u16_u8(m), 0);
+}
+#endif
+
+#define JSON_CACHE_BITS 10         // At most; small inputs use fewer slots
+#define JSON_CACHE_MAX_LEN 64      // Longer strings rarely repeat
+#define JSON_CACHE_MAX_FILLS 4096  // Bounds the strings the cache keeps alive
+#define JSON_CACHE_MIN_INPUT 4096  // Smaller documents rarely repeat a string
+#define JSON_INLINE_INDEX 256      // Index entries that need no allocation
+
+// Bitmasks for one 64-byte block (bit i = byte i)
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;        // { } [ ] : ,
+    uint64_t space;     // ' ' \t \n \r
+} JsonBlock;
 
 typedef struct {
     const char* start;
-    const char* current;
+    const char* current;        // Last token, for error positions
+    uint32_t* index;            // Stage 1 output, ends with the input length
+    uint32_t inlineIndex[JSON_INLINE_INDEX];
+    int indexCount;
+    int pos;
+    char* scratch;              // Unescaped string bytes
+    int scratchCapacity;
+    ObjString** cache;          // Per-parse string cache (keys and short values)
+    int cacheBits;              // log2 of its slots; 0 = no cache
+    Array* cached;              // Roots every string the cache has held (created on first use)
+    int cachedSlot;             // vm->stack slot reserved for 'cached'
     VM* vm;
     char errorMsg[256];
     bool hasError;
@@ -43,319 +120,529 @@ static void jsonError(JsonParser* parser, const char* msg) {
     parser->hasError = true;
 }
 
-static void skipWhitespace(JsonParser* parser) {
-    while (*parser->current != '\0' && isspace((unsigned char)*parser->current)) {
-        parser->current++;
+// ---- Stage 1: structural index ----
+
+static inline void classifyBlock(const uint8_t* p, JsonBlock* b) {
+#ifdef JSON_VEC_BYTES
+    b->quote = b->backslash = b->op = b->space = 0;
+    for (int i = 0; i < 64; i += JSON_VEC_BYTES) {
+        JsonVec v = vecLoad(p + i);
+        // '[' and ']' are '{' and '}' with bit 5 clear
+        JsonVec folded = vecOr(v, vecSplat(0x20));
+        JsonVec op = vecOr(vecOr(vecEq(folded, vecSplat('{')), vecEq(folded, vecSplat('}'))),
+                           vecOr(vecEq(v, vecSplat(':')), vecEq(v, vecSplat(','))));
+        JsonVec space = vecOr(vecOr(vecEq(v, vecSplat(' ')), vecEq(v, vecSplat('\t'))),
+                              vecOr(vecEq(v, vecSplat('\n')), vecEq(v, vecSplat('\r'))));
+        b->quote |= vecMask(vecEq(v, vecSplat('"'))) << i;
+        b->backslash |= vecMask(vecEq(v, vecSplat('\\'))) << i;
+        b->op |= vecMask(op) << i;
+        b->space |= vecMask(space) << i;
     }
+#else
+    b->quote = b->backslash = b->op = b->space = 0;
+    for (int i = 0; i < 64; i++) {
+        uint64_t bit = 1ULL << i;
+        switch (p[i]) {
+            case '"': b->quote |= bit; break;
+            case '\\': b->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': b->op |= bit; break;
+            case ' ': case '\t': case '\n': case '\r': b->space |= bit; break;
+            default: break;
+        }
+    }
+#endif
+}
+
+// Bits of characters escaped by a backslash. A run of backslashes escapes
+// every other character after its start; 'carry' is set when the block's
+// last backslash escapes the first byte of the next block.
+static inline uint64_t findEscaped(uint64_t backslash, uint64_t* carry) {
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    backslash &= ~*carry;
+    uint64_t followsEscape = (backslash << 1) | *carry;
+    uint64_t oddStarts = backslash & ~evenBits & ~followsEscape;
+    uint64_t evenSequences;
+    *carry = __builtin_add_overflow(oddStarts, backslash, &evenSequences);
+    uint64_t invert = evenSequences << 1;
+    return (evenBits ^ invert) & followsEscape;
+}
+
+// Bit i = parity of the set bits at or below i (marks the inside of strings)
+static inline uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
 }
 
-static char peek(JsonParser* parser) {
-    skipWhitespace(parser);
+static bool buildIndex(JsonParser* parser, size_t length) {
+    const uint8_t* src = (const uint8_t*)parser->start;
+    int capacity = JSON_INLINE_INDEX;
+    int count = 0;
+    uint32_t* index = parser->inlineIndex;
+    if (length / 8 + 64 > JSON_INLINE_INDEX) {
+        capacity = (int)(length / 8) + 64;
+        index = malloc(sizeof(uint32_t) * capacity);
+        if (!index) {
+            jsonError(parser, "Out of memory");
+            return false;
+        }
+    }
+
+    uint64_t escapeCarry = 0, inStringCarry = 0, scalarCarry = 0;
+    for (size_t base = 0; base < length; base += 64) {
+        JsonBlock b;
+        if (length - base >= 64) {
+            classifyBlock(src + base, &b);
+        } else {
+            uint8_t tail[64];
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, src + base, length - base);
+            classifyBlock(tail, &b);
+        }
+
+        uint64_t quotes = b.quote & ~findEscaped(b.backslash, &escapeCarry);
+        uint64_t inString = prefixXor(quotes) ^ inStringCarry;
+        inStringCarry = (uint64_t)((int64_t)inString >> 63);
+
+        // Scalars (numbers, literals) are runs of anything else outside strings
+        uint64_t scalar = ~(b.op | b.space | quotes | inString);
+        uint64_t scalarStarts = scalar & ~((scalar << 1) | scalarCarry);
+        scalarCarry = scalar >> 63;
+
+        uint64_t bits = (b.op & ~inString) | (quotes & inString) | scalarStarts;
+        if (count + 65 > capacity) { // A block adds up to 64, plus the sentinel
+            capacity *= 2;
+            uint32_t* grown;
+            if (index == parser->inlineIndex) {
+                grown = malloc(sizeof(uint32_t) * capacity);
+                if (grown) memcpy(grown, index, sizeof(uint32_t) * count);
+            } else {
+                grown = realloc(index, sizeof(uint32_t) * capacity);
+            }
+            if (!grown) {
+                if (index != parser->inlineIndex) free(index);
+                jsonError(parser, "Out of memory");
+                return false;
+            }
+            index = grown;
+        }
+        while (bits) {
+            index[count++] = (uint32_t)(base + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    if (inStringCarry) {
+        if (index != parser->inlineIndex) free(index);
+        parser->current = parser->start + length;
+        jsonError(parser, "Unterminated string");
+        return false;
+    }
+
+    index[count] = (uint32_t)length; // Sentinel: the terminating '\0'
+    parser->index = index;
+    parser->indexCount = count;
+    parser->pos = 0;
+    return true;
+}
+
+// ---- Stage 2: build values ----
+
+static inline char nextToken(JsonParser* parser) {
+    parser->current = parser->start + parser->index[parser->pos];
+    if (parser->pos < parser->indexCount) parser->pos++;
     return *parser->current;
 }
 
-// static char advance(JsonParser* parser) { ... } // Unused
+// Where a number or literal must stop
+static inline bool isScalarEnd(char c) {
+    switch (c) {
+        case '\0': case ' ': case '\t': case '\n': case '\r':
+        case ',': case ':': case '[': case ']': case '{': case '}': case '"':
+            return true;
+        default:
+            return false;
+    }
+}
 
-static bool match(JsonParser* parser, char expected) {
-    if (peek(parser) == expected) {
-        parser->current++;
-        return true;
+static ObjString* cachedString(JsonParser* parser, const char* chars, int length) {
+    if (parser->cacheBits == 0 || length > JSON_CACHE_MAX_LEN) return NULL;
+
+    // Slot from the length and the leading/trailing 8 bytes; cheaper than hash()
+    uint64_t w = 0, t = 0;
+    memcpy(&w, chars, length < 8 ? length : 8);
+    if (length > 8) memcpy(&t, chars + length - 8, 8);
+    w = (w ^ (t * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)length) * 0x9E3779B97F4A7C15ULL;
+    ObjString** slot = &parser->cache[w >> (64 - parser->cacheBits)];
+
+    ObjString* s = *slot;
+    if (s && s->length == length && memcmp(s->chars, chars, length) == 0) return s;
+    if (!parser->cached) {
+        parser->cached = newArray(parser->vm);
+        parser->vm->stack[parser->cachedSlot] = OBJ_VAL(parser->cached);
+    } else if (parser->cached->count >= JSON_CACHE_MAX_FILLS) {
+        return NULL;
     }
-    return false;
+
+    s = internString(parser->vm, chars, length);
+    arrayPush(parser->vm, parser->cached, OBJ_VAL(s));
+    *slot = s;
+    return s;
 }
 
-// Forward declarations of parsing functions
-static Value parseValue(JsonParser* parser);
+static bool reserveScratch(JsonParser* parser, int needed) {
+    if (needed <= parser->scratchCapacity) return true;
+    int capacity = parser->scratchCapacity < 256 ? 256 : parser->scratchCapacity;
+    while (capacity < needed) capacity *= 2;
+    char* grown = realloc(parser->scratch, capacity);
+    if (!grown) return false;
+    parser->scratch = grown;
+    parser->scratchCapacity = capacity;
+    return true;
+}
 
-static Value parseString(JsonParser* parser) {
-    if (*parser->current != '"') {
-        jsonError(parser, "Expected '\"'");
-        return NIL_VAL;
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int readHex4(const char* p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        int d = hexDigit(p[i]);
+        if (d < 0) return -1;
+        v = (v << 4) | d;
     }
-    parser->current++; // skip opening quote
+    return v;
+}
 
-    // Simple implementation: find closing quote, handle escapes manually if needed
-    // rigorous implementation would allocate a buffer.
-    // For now, we will scan to end, handle simple escapes, copy to new buffer.
-    
-    // First pass: calc length
-    const char* strStart = parser->current;
-    int len = 0;
-    while (*parser->current != '"' && *parser->current != '\0') {
-        if (*parser->current == '\\') {
-            parser->current++;
-            if (*parser->current == '\0') {
-                jsonError(parser, "Unterminated string escape");
-                return NIL_VAL;
-            }
-        }
-        parser->current++;
-        len++;
+static char* appendUtf8(char* dest, unsigned int cp) {
+    if (cp < 0x80) {
+        *dest++ = (char)cp;
+    } else if (cp < 0x800) {
+        *dest++ = (char)(0xC0 | (cp >> 6));
+        *dest++ = (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *dest++ = (char)(0xE0 | (cp >> 12));
+        *dest++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dest++ = (char)(0x80 | (cp & 0x3F));
+    } else {
+        *dest++ = (char)(0xF0 | (cp >> 18));
+        *dest++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+        *dest++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+        *dest++ = (char)(0x80 | (cp & 0x3F));
     }
+    return dest;
+}
 
-    if (*parser->current != '"') {
-        jsonError(parser, "Unterminated string");
-        return NIL_VAL;
+// First '"' or '\\' in [p, end), or 'end' if there is none
+static inline const char* findQuoteOrEscape(const char* p, const char* end) {
+#ifdef JSON_VEC_BYTES
+    while (end - p >= JSON_VEC_BYTES) {
+        JsonVec v = vecLoad(p);
+        uint64_t mask = vecMask(vecOr(vecEq(v, vecSplat('"')), vecEq(v, vecSplat('\\'))));
+        if (mask) return p + __builtin_ctzll(mask);
+        p += JSON_VEC_BYTES;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\') p++;
+    return p;
+}
+
+// Scan the string at parser->current. Unescaped strings point into the input;
+// the rest are decoded into the scratch buffer (valid until the next call).
+static bool scanString(JsonParser* parser, const char** chars, int* length) {
+    const char* begin = parser->current + 1;
+    const char* end = parser->start + parser->index[parser->indexCount];
+    const char* p = findQuoteOrEscape(begin, end);
+    if (*p == '"') {
+        *chars = begin;
+        *length = (int)(p - begin);
+        return true;
     }
 
-    // Allocate buffer
-    char* buffer = (char*)malloc(len + 1);
-    if (!buffer) {
+    // Decoding never grows a string, so the raw span bounds the output
+    const char* close = p;
+    while (true) {
+        close = findQuoteOrEscape(close, end);
+        if (*close == '"') break;
+        close += 2;
+    }
+    if (!reserveScratch(parser, (int)(close - begin))) {
         jsonError(parser, "Out of memory");
-        return NIL_VAL;
+        return false;
     }
 
-    // copy
-    const char* scan = strStart;
-    char* dest = buffer;
-    while (scan < parser->current) {
-        if (*scan == '\\') {
-            scan++;
-            switch (*scan) {
-                case '"': *dest++ = '"'; break;
-                case '\\': *dest++ = '\\'; break;
-                case '/': *dest++ = '/'; break;
-                case 'b': *dest++ = '\b'; break;
-                case 'f': *dest++ = '\f'; break;
-                case 'n': *dest++ = '\n'; break;
-                case 'r': *dest++ = '\r'; break;
-                case 't': *dest++ = '\t'; break;
-                case 'u': 
-                    // skipping unicode for now... simply consume uXXXX
-                    scan += 4; 
-                    *dest++ = '?'; // placeholder
-                    break;
-                default: *dest++ = *scan; break;
+    char* dest = parser->scratch;
+    memcpy(dest, begin, p - begin);
+    dest += p - begin;
+    while (p < close) {
+        if (*p != '\\') {
+            *dest++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p++) {
+            case '"': *dest++ = '"'; break;
+            case '\\': *dest++ = '\\'; break;
+            case '/': *dest++ = '/'; break;
+            case 'b': *dest++ = '\b'; break;
+            case 'f': *dest++ = '\f'; break;
+            case 'n': *dest++ = '\n'; break;
+            case 'r': *dest++ = '\r'; break;
+            case 't': *dest++ = '\t'; break;
+            case 'u': {
+                int cp = close - p >= 4 ? readHex4(p) : -1;
+                if (cp < 0) {
+                    parser->current = p - 2;
+                    jsonError(parser, "Invalid unicode escape");
+                    return false;
+                }
+                p += 4;
+                // A high surrogate followed by "\uDC00".."\uDFFF" is one code point
+                if (cp >= 0xD800 && cp <= 0xDBFF && close - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    int low = readHex4(p + 2);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                dest = appendUtf8(dest, (unsigned int)cp);
+                break;
             }
-        } else {
-            *dest++ = *scan;
+            default: *dest++ = p[-1]; break;
         }
-        scan++;
     }
-    *dest = '\0';
-    parser->current++; // skip closing quote
+    *chars = parser->scratch;
+    *length = (int)(dest - parser->scratch);
+    return true;
+}
 
-    ObjString* os = copyString(parser->vm, buffer, (int)(dest - buffer));
-    free(buffer);
-    return OBJ_VAL(os);
+static Value parseValue(JsonParser* parser);
+
+static Value parseString(JsonParser* parser) {
+    const char* chars;
+    int length;
+    if (!scanString(parser, &chars, &length)) return NIL_VAL;
+    ObjString* s = cachedString(parser, chars, length);
+    if (!s) s = internString(parser->vm, chars, length);
+    return OBJ_VAL(s);
 }
 
 static Value parseNumber(JsonParser* parser) {
     const char* start = parser->current;
-    if (*parser->current == '-') parser->current++;
-    while (isdigit((unsigned char)*parser->current)) parser->current++;
-    
-    // fraction
-    if (*parser->current == '.') {
-        parser->current++;
-        while (isdigit((unsigned char)*parser->current)) parser->current++;
-    }
-
-    // exponent
-    if (*parser->current == 'e' || *parser->current == 'E') {
-        parser->current++;
-        if (*parser->current == '+' || *parser->current == '-') parser->current++;
-        while (isdigit((unsigned char)*parser->current)) parser->current++;
+    const char* p = start;
+    bool negative = (*p == '-');
+    if (negative) p++;
+    if (!isdigit((unsigned char)*p)) {
+        jsonError(parser, "Invalid number");
+        return NIL_VAL;
     }
 
-    size_t len = parser->current - start;
-    
-    // OPTIMIZATION: Use stack buffer for small numbers (most common case)
-    char stackBuf[64];
-    char* tmp = stackBuf;
-    bool heapAlloc = false;
-    if (len >= sizeof(stackBuf)) {
-        tmp = (char*)malloc(len + 1);
-        heapAlloc = true;
-    }
-    memcpy(tmp, start, len);
-    tmp[len] = '\0';
-    
-    // OPTIMIZATION: Check for float during scan instead of second loop
-    bool isInt = true;
-    for (const char* p = start; p < parser->current; p++) {
-        if (*p == '.' || *p == 'e' || *p == 'E') {
-            isInt = false; 
-            break;
-        }
-    }
+    const char* digits = p;
+    uint64_t magnitude = 0;
+    while (isdigit((unsigned char)*p)) magnitude = magnitude * 10 + (uint64_t)(*p++ - '0');
 
     Value val;
-    if (isInt) {
-        long long v = strtoll(tmp, NULL, 10);
-        val = INT_VAL((int)v);
+    if (*p == '.' || *p == 'e' || *p == 'E') {
+        char* numEnd;
+        val = FLOAT_VAL(strtod(start, &numEnd));
+        p = numEnd;
     } else {
-        double v = strtod(tmp, NULL);
-        val = FLOAT_VAL(v);
+        long long v = (p - digits > 18) ? strtoll(start, NULL, 10)
+                    : negative ? -(long long)magnitude : (long long)magnitude;
+        val = INT_VAL((int)v);
+    }
+
+    if (!isScalarEnd(*p)) {
+        parser->current = p;
+        jsonError(parser, "Unexpected character");
+        return NIL_VAL;
     }
-    if (heapAlloc) free(tmp);
     return val;
 }
 
 static Value parseArray(JsonParser* parser) {
-    parser->current++; // skip '['
     Array* arr = newArray(parser->vm);
-    
-    // GC Protection: While we fill this array, if GC triggers, 'arr' must be reachable.
-    // In unnarize, 'newArray' puts it on heap, but it's not rooted yet unless passed to push() or something deeply?
-    // Actually, 'newArray' links it into vm->objects.
-    // If GC runs, it will sweep 'arr' unless it's marked.
-    // We should push 'arr' to stack temporarily using `push(vm, val)`.
-    
-    push(parser->vm, OBJ_VAL(arr)); // PROTECT
+    push(parser->vm, OBJ_VAL(arr)); // Children are reachable once stored
 
-    skipWhitespace(parser);
-    if (*parser->current == ']') {
-        parser->current++;
-        pop(parser->vm); // UNPROTECT
+    if (parser->start[parser->index[parser->pos]] == ']') {
+        nextToken(parser);
+        pop(parser->vm);
         return OBJ_VAL(arr);
     }
 
     while (true) {
         Value val = parseValue(parser);
         if (parser->hasError) break;
-        
-        push(parser->vm, val); // Protect item
-        arrayPush(parser->vm, arr, val);
-        pop(parser->vm);       // Unprotect item
-
-        skipWhitespace(parser);
-        if (*parser->current == ']') {
-            parser->current++;
-            break;
-        }
+        arrayPush(parser->vm, arr, val); // Roots 'val' itself if it has to grow
 
-        if (!match(parser, ',')) {
+        char c = nextToken(parser);
+        if (c == ']') break;
+        if (c != ',') {
             jsonError(parser, "Expected ',' in array");
             break;
         }
     }
 
-    pop(parser->vm); // UNPROTECT arr
+    pop(parser->vm);
     return OBJ_VAL(arr);
 }
 
 static Value parseObject(JsonParser* parser) {
-    parser->current++; // skip '{'
     Map* map = newMap(parser->vm);
-    
-    push(parser->vm, OBJ_VAL(map)); // PROTECT
+    push(parser->vm, OBJ_VAL(map));
 
-    skipWhitespace(parser);
-    if (*parser->current == '}') {
-        parser->current++;
-        pop(parser->vm); // UNPROTECT
+    char c = nextToken(parser);
+    if (c == '}') {
+        pop(parser->vm);
         return OBJ_VAL(map);
     }
 
     while (true) {
-        skipWhitespace(parser);
-        if (*parser->current != '"') {
+        if (c != '"') {
             jsonError(parser, "Expected string key");
             break;
         }
 
-        Value keyVal = parseString(parser);
-        if (parser->hasError) break;
-        
-        // key must be string
-        ObjString* keyStr = AS_STRING(keyVal);
-        push(parser->vm, keyVal); // Protect Key
+        const char* chars;
+        int length;
+        if (!scanString(parser, &chars, &length)) break;
+
+        // The value may reuse the scratch buffer, so escaped keys that miss
+        // the cache are copied (and rooted) first
+        ObjString* key = cachedString(parser, chars, length);
+        bool rooted = false;
+        if (!key && chars == parser->scratch) {
+            key = internString(parser->vm, chars, length);
+            push(parser->vm, OBJ_VAL(key));
+            rooted = true;
+        }
 
-        skipWhitespace(parser);
-        if (!match(parser, ':')) {
+        if (nextToken(parser) != ':') {
             jsonError(parser, "Expected ':' after key");
-            pop(parser->vm); // pop key
+            if (rooted) pop(parser->vm);
             break;
         }
 
         Value val = parseValue(parser);
         if (parser->hasError) {
-             pop(parser->vm);
-             break;
-        }
-
-        push(parser->vm, val); // Protect Val
-        mapSetStr(map, keyStr->chars, keyStr->length, val);
-        pop(parser->vm); // pop val
-        pop(parser->vm); // pop key
-
-        skipWhitespace(parser);
-        if (*parser->current == '}') {
-            parser->current++;
+            if (rooted) pop(parser->vm);
             break;
         }
 
-        if (!match(parser, ',')) {
+        // Map insertion never collects, so 'val' needs no root
+        if (key) mapSetStrHashed(map, key->chars, key->length, stringHash(key), val);
+        else mapSetStr(map, chars, length, val);
+        if (rooted) pop(parser->vm);
+
+        c = nextToken(parser);
+        if (c == '}') break;
+        if (c != ',') {
             jsonError(parser, "Expected ',' in object");
             break;
         }
+        c = nextToken(parser);
     }
 
-    pop(parser->vm); // UNPROTECT map
+    pop(parser->vm);
     return OBJ_VAL(map);
 }
 
 static Value parseValue(JsonParser* parser) {
-    skipWhitespace(parser);
     if (parser->hasError) return NIL_VAL;
 
-    char c = *parser->current;
+    char c = nextToken(parser);
     if (c == '"') return parseString(parser);
     if (c == '[') return parseArray(parser);
     if (c == '{') return parseObject(parser);
     if (isdigit((unsigned char)c) || c == '-') return parseNumber(parser);
-    
-    if (strncmp(parser->current, "true", 4) == 0) {
-        parser->current += 4;
-        return BOOL_VAL(true);
+
+    const char* p = parser->current;
+    if (strncmp(p, "true", 4) == 0 && isScalarEnd(p[4])) return BOOL_VAL(true);
+    if (strncmp(p, "false", 5) == 0 && isScalarEnd(p[5])) return BOOL_VAL(false);
+    if (strncmp(p, "null", 4) == 0 && isScalarEnd(p[4])) return NIL_VAL;
+
+    jsonError(parser, "Unexpected character");
+    return NIL_VAL;
+}
+
+static void reportError(const char* message, const char* path) {
+    if (path) printf("JSON Read Error: %s in %s\n", message, path);
+    else printf("JSON Parse Error: %s\n", message);
+}
+
+// Parse 'length' bytes at 'text' (which must be followed by a '\0') into
+// *out. On failure reports the error (against 'path' if it came from a
+// file), stores nil and returns false.
+static bool parseJsonText(VM* vm, const char* text, size_t length, const char* path, Value* out) {
+    *out = NIL_VAL;
+    if (length > UINT32_MAX - 64) {
+        reportError("Input too large", path);
+        return false;
     }
-    if (strncmp(parser->current, "false", 5) == 0) {
-        parser->current += 5;
-        return BOOL_VAL(false);
+
+    JsonParser state;
+    JsonParser* parser = &state;
+    parser->cache = NULL;
+    parser->cacheBits = 0;
+    if (length >= JSON_CACHE_MIN_INPUT) {
+        int bits = 6;
+        while (bits < JSON_CACHE_BITS && ((size_t)1 << (bits + 6)) < length) bits++;
+        parser->cache = calloc((size_t)1 << bits, sizeof(ObjString*));
+        if (parser->cache) parser->cacheBits = bits;
     }
-    if (strncmp(parser->current, "null", 4) == 0) {
-        parser->current += 4;
-        return NIL_VAL;
+    parser->cached = NULL;
+    parser->vm = vm;
+    parser->start = text;
+    parser->current = text;
+    parser->index = NULL;
+    parser->scratch = NULL;
+    parser->scratchCapacity = 0;
+    parser->hasError = false;
+    parser->errorMsg[0] = '\0';
+
+    Value result = NIL_VAL;
+    if (buildIndex(parser, length)) {
+        // Nothing built here becomes garbage before we return, so a
+        // collection mid-parse would only re-trace the growing tree. Values
+        // stay rooted anyway, for DEBUG_STRESS_GC.
+        deferCollections(vm);
+        parser->cachedSlot = vm->stackTop;
+        push(vm, NIL_VAL);
+        result = parseValue(parser);
+        pop(vm);
+        resumeCollections(vm);
+
+        if (!parser->hasError && parser->pos < parser->indexCount) {
+            snprintf(parser->errorMsg, sizeof(parser->errorMsg), "Extra data at end of JSON");
+            parser->hasError = true;
+        }
     }
 
-    jsonError(parser, "Unexpected character");
-    return NIL_VAL;
+    if (parser->hasError) reportError(parser->errorMsg, path);
+    else *out = result;
+    if (parser->index != parser->inlineIndex) free(parser->index);
+    free(parser->scratch);
+    free(parser->cache);
+    return !parser->hasError;
 }
 
 static Value jsonParse(VM* vm, Value* args, int argCount) {
     if (argCount != 1 || !IS_STRING(args[0])) {
-        return OBJ_VAL(copyString(vm, "Error: parse() expects a JSON string", 36)); 
-        // Or return NIL and print error? Standard pattern is probably to error out or return nil
-        // Let's print runtime error for now?
-        // Actually, returning a result object or throwing would be better.
-        // For simplicity, let's just return NIL if bad args.
+        return OBJ_VAL(copyString(vm, "Error: parse() expects a JSON string", 36));
     }
 
+    // The argument stays rooted in the caller's registers while we parse
     ObjString* jsonStr = AS_STRING(args[0]);
-    JsonParser parser;
-    parser.vm = vm;
-    parser.start = jsonStr->chars;
-    parser.current = jsonStr->chars;
-    parser.hasError = false;
-    parser.errorMsg[0] = '\0';
-
-    Value result = parseValue(&parser);
-    
-    if (parser.hasError) {
-        // Return error as string? Or just print?
-        // Let's just print to stderr and return NIL
-        printf("JSON Parse Error: %s\n", parser.errorMsg);
-        return NIL_VAL;
-    }
-    
-    // Check if we consumed everything? 
-    skipWhitespace(&parser);
-    if (*parser.current != '\0') {
-         printf("JSON Parse Error: Extra data at end of JSON\n");
-         return NIL_VAL;
-    }
-
+    Value result;
+    parseJsonText(vm, jsonStr->chars, (size_t)jsonStr->length, NULL, &result);
     return result;
 }
 
@@ -363,14 +650,41 @@ static Value jsonParse(VM* vm, Value* args, int argCount) {
 // JSON Stringifier
 // ============================================================================
 
+#define JSON_CHUNK_SIZE (64 * 1024) // Sink flush size and reader refill size
+
 typedef struct {
     char* buffer;
     size_t capacity;
     size_t length;
     VM* vm;
+    JsonSinkFn sink;        // Receives full chunks; NULL builds the whole text in memory
+    void* sinkCtx;
+    bool failed;            // The sink failed; later output is dropped
 } JsonHeader;
 
+static void jsonHeaderInit(JsonHeader* header, VM* vm, size_t capacity, JsonSinkFn sink, void* sinkCtx) {
+    header->vm = vm;
+    header->capacity = capacity;
+    header->length = 0;
+    header->buffer = (char*)malloc(header->capacity);
+    if (!header->buffer) exit(1);
+    header->buffer[0] = '\0';
+    header->sink = sink;
+    header->sinkCtx = sinkCtx;
+    header->failed = false;
+}
 
+static void jsonFlush(JsonHeader* header) {
+    if (header->length > 0 && !header->failed) {
+        header->failed = !header->sink(header->sinkCtx, header->buffer, header->length);
+    }
+    header->length = 0;
+    header->buffer[0] = '\0';
+}
+
+static inline void jsonMaybeFlush(JsonHeader* header) {
+    if (header->sink && header->length >= JSON_CHUNK_SIZE) jsonFlush(header);
+}
 
 static void jsonAppend(JsonHeader* header, const char* str, size_t len) {
     if (header->length + len >= header->capacity) {
@@ -382,6 +696,7 @@ static void jsonAppend(JsonHeader* header, const char* str, size_t len) {
     memcpy(header->buffer + header->length, str, len);
     header->length += len;
     header->buffer[header->length] = '\0';
+    jsonMaybeFlush(header);
 }
 
 static void stringifyValue(JsonHeader* header, Value val);
@@ -398,22 +713,18 @@ static void stringifyArray(JsonHeader* header, Array* arr) {
 static void stringifyMap(JsonHeader* header, Map* map) {
     jsonAppend(header, "{", 1);
     bool first = true;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        MapEntry* e = map->buckets[i];
-        while (e) {
-            if (!first) jsonAppend(header, ",", 1);
-            first = false;
-            
-            // Key
-            jsonAppend(header, "\"", 1);
-            jsonAppend(header, e->key, strlen(e->key)); // key is char*
-            jsonAppend(header, "\":", 2);
-            
-            // Value
-            stringifyValue(header, e->value);
-            
-            e = e->next;
-        }
+    for (int i = 0; i < map->count; i++) {
+        MapEntry* e = &map->entries[i];
+        if (!first) jsonAppend(header, ",", 1);
+        first = false;
+        
+        // Key
+        jsonAppend(header, "\"", 1);
+        jsonAppend(header, e->key, e->keyLength); // key is char*
+        jsonAppend(header, "\":", 2);
+        
+        // Value
+        stringifyValue(header, e->value);
     }
     jsonAppend(header, "}", 1);
 }
@@ -462,6 +773,7 @@ static void stringifyValue(JsonHeader* header, Value val) {
         *dest++ = '"';
         header->length = dest - header->buffer;
         header->buffer[header->length] = '\0';
+        jsonMaybeFlush(header);
     } else if (IS_ARRAY(val)) {
         stringifyArray(header, (Array*)AS_OBJ(val));
     } else if (IS_MAP(val)) {
@@ -471,23 +783,44 @@ static void stringifyValue(JsonHeader* header, Value val) {
     }
 }
 
+bool jsonStreamValue(VM* vm, Value value, JsonSinkFn sink, void* ctx) {
+    JsonHeader header;
+    jsonHeaderInit(&header, vm, JSON_CHUNK_SIZE + 1024, sink, ctx);
+    stringifyValue(&header, value);
+    jsonFlush(&header);
+    free(header.buffer);
+    return !header.failed;
+}
+
 static Value jsonStringify(VM* vm, Value* args, int argCount) {
     if (argCount < 1) return NIL_VAL;
-    
+
     JsonHeader header;
-    header.vm = vm;
-    header.capacity = 1024; // OPTIMIZATION: Larger initial buffer
-    header.length = 0;
-    header.buffer = (char*)malloc(header.capacity);
-    header.buffer[0] = '\0';
-    
+    jsonHeaderInit(&header, vm, 1024, NULL, NULL); // OPTIMIZATION: Larger initial buffer
+
     stringifyValue(&header, args[0]);
-    
+
     ObjString* res = copyString(vm, header.buffer, (int)header.length);
     free(header.buffer);
     return OBJ_VAL(res);
 }
 
+// Sink for a file descriptor ('ctx' points at the int fd)
+static bool fdSink(void* ctx, const char* data, size_t length) {
+    int fd = *(int*)ctx;
+    if (fd == STDOUT_FILENO) fflush(stdout); // Keep order with print()
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
 // ============================================================================
 // File CRUD
 // ============================================================================
@@ -498,48 +831,14 @@ static Value jsonRead(VM* vm, Value* args, int argCount) {
     }
     char* path = AS_CSTRING(args[0]);
     
-    FILE* file = fopen(path, "rb");
-    if (!file) {
+    FileBuffer file;
+    if (!fileOpen(path, &file)) {
         return NIL_VAL; // File not found or err
     }
-
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
-
-    char* buffer = malloc(fileSize + 1);
-    if (!buffer) {
-        fclose(file);
-        return NIL_VAL;
-    }
-    
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    buffer[bytesRead] = '\0';
-    fclose(file);
-    
-    // Create temp string value to pass to internal parse
-    ObjString* jsonStr = copyString(vm, buffer, bytesRead);
-    free(buffer);
-    
-    push(vm, OBJ_VAL(jsonStr));
-    
-    // Reuse parser logic manually
-    JsonParser parser;
-    parser.vm = vm;
-    parser.start = jsonStr->chars;
-    parser.current = jsonStr->chars;
-    parser.hasError = false;
-    parser.errorMsg[0] = '\0';
-
-    Value result = parseValue(&parser);
-    
-    pop(vm); // jsonStr
-
-    if (parser.hasError) {
-        printf("JSON Read Error: %s in %s\n", parser.errorMsg, path);
-        return NIL_VAL;
-    }
     
+    Value result;
+    parseJsonText(vm, file.data, file.length, path, &result);
+    fileClose(&file); // Parsed values own copies of everything they keep
     return result;
 }
 
@@ -547,34 +846,16 @@ static Value jsonWrite(VM* vm, Value* args, int argCount) {
     if (argCount != 2 || !IS_STRING(args[0])) {
         return BOOL_VAL(false);
     }
-    
+
     char* path = resolvePath(vm, AS_CSTRING(args[0]));
-    Value data = args[1];
-    
-    // Stringify
-    JsonHeader header;
-    header.vm = vm;
-    header.capacity = 128;
-    header.length = 0;
-    header.buffer = (char*)malloc(header.capacity);
-    header.buffer[0] = '\0';
-    
-    stringifyValue(&header, data);
-    
-    FILE* file = fopen(path, "w");
-    if (!file) {
-        free(header.buffer);
-        free(path);
-        return BOOL_VAL(false);
-    }
-    
-    // OPTIMIZATION: Use fwrite for better performance than fprintf
-    fwrite(header.buffer, 1, header.length, file);
-    fclose(file);
-    free(header.buffer);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
     free(path);
-    
-    return BOOL_VAL(true);
+    if (fd < 0) return BOOL_VAL(false);
+
+    // Streamed in chunks: the whole text is never held in memory
+    bool ok = jsonStreamValue(vm, args[1], fdSink, &fd);
+    if (close(fd) != 0) ok = false;
+    return BOOL_VAL(ok);
 }
 
 static Value jsonRemove(VM* vm, Value* args, int argCount) {
@@ -590,6 +871,449 @@ static Value jsonRemove(VM* vm, Value* args, int argCount) {
     return BOOL_VAL(result);
 }
 
+// ============================================================================
+// Streaming Reader
+// ============================================================================
+//
+// ucoreJson.open(path, [format]) yields the elements of a top-level array
+// one at a time, or each top-level value of an NDJSON / concatenated-JSON
+// file. Without a format, a file starting with '[' is read as an array. Only
+// the current element is buffered: the reader finds where it ends (tracking
+// nesting and strings), then hands those bytes to the parser above.
+
+typedef struct {
+    int fd;
+    char* path;             // For error messages
+    char* buffer;
+    size_t start;           // Unconsumed bytes are buffer[start, end)
+    size_t end;
+    size_t capacity;
+    bool eof;
+    bool inArray;           // Top level is an array: yield its elements
+    bool started;           // An element was yielded (the next needs a ',')
+    bool done;
+} JsonReader;
+
+static void readerCleanup(void* data) {
+    JsonReader* r = (JsonReader*)data;
+    if (!r) return;
+    if (r->fd >= 0) close(r->fd);
+    free(r->path);
+    free(r->buffer);
+    free(r);
+}
+
+// Read more input, compacting or growing the buffer; false at end of file
+static bool readerFill(JsonReader* r) {
+    if (r->eof) return false;
+    if (r->start > 0) {
+        memmove(r->buffer, r->buffer + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (r->capacity - r->end < JSON_CHUNK_SIZE / 2) {
+        size_t capacity = r->capacity * 2;
+        char* grown = realloc(r->buffer, capacity);
+        if (!grown) {
+            r->eof = true;
+            return false;
+        }
+        r->buffer = grown;
+        r->capacity = capacity;
+    }
+    while (true) {
+        // Keep one byte spare for the terminator the parser needs
+        ssize_t n = read(r->fd, r->buffer + r->end, r->capacity - r->end - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            r->eof = true;
+            return false;
+        }
+        r->end += (size_t)n;
+        return true;
+    }
+}
+
+// Next non-whitespace byte (left unconsumed), or -1 at end of file
+static int readerPeek(JsonReader* r) {
+    while (true) {
+        while (r->start < r->end) {
+            char c = r->buffer[r->start];
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r') return (unsigned char)c;
+            r->start++;
+        }
+        if (!readerFill(r)) return -1;
+    }
+}
+
+// Length of the value at r->start, reading until it is complete (or the
+// file ends; the parser then reports what is wrong with it)
+static size_t readerScanValue(JsonReader* r) {
+    size_t i = 0;
+    int depth = 0;
+    bool inString = false;
+    while (true) {
+        if (r->start + i >= r->end) {
+            if (!readerFill(r)) return r->end - r->start;
+            continue;
+        }
+        const char* p = r->buffer + r->start + i;
+        if (inString) {
+            const char* stop = findQuoteOrEscape(p, r->buffer + r->end);
+            i = (size_t)(stop - (r->buffer + r->start));
+            if (stop == r->buffer + r->end) continue;
+            if (*stop == '\\') {
+                i += 2;
+                continue;
+            }
+            inString = false;
+            i++;
+            if (depth == 0) return i;
+            continue;
+        }
+        switch (*p) {
+            case '"':
+                inString = true;
+                break;
+            case '{': case '[':
+                depth++;
+                break;
+            case '}': case ']':
+                if (depth == 0) return i;
+                if (--depth == 0) return i + 1;
+                break;
+            case ',': case ' ': case '\t': case '\n': case '\r':
+                if (depth == 0) return i;
+                break;
+            default:
+                break;
+        }
+        i++;
+    }
+}
+
+static void readerError(JsonReader* r, const char* msg) {
+    reportError(msg, r->path);
+    r->done = true;
+}
+
+static bool readerNext(VM* vm, void* data, Value* out) {
+    JsonReader* r = (JsonReader*)data;
+    if (!r || r->done) return false;
+
+    int c = readerPeek(r);
+    if (r->inArray) {
+        if (c == ']') {
+            r->done = true;
+            return false;
+        }
+        if (r->started) {
+            if (c != ',') {
+                readerError(r, c < 0 ? "Unterminated array" : "Expected ',' in array");
+                return false;
+            }
+            r->start++;
+            c = readerPeek(r);
+        }
+        if (c < 0) {
+            readerError(r, "Unterminated array");
+            return false;
+        }
+    } else if (c < 0) {
+        r->done = true;
+        return false;
+    }
+
+    size_t length = readerScanValue(r);
+    if (length == 0) length = 1; // A stray ']' or ',': let the parser report it
+    if (r->start + length > r->end) length = r->end - r->start;
+    char* text = r->buffer + r->start;
+    char saved = text[length];
+    text[length] = '\0';
+    bool ok = parseJsonText(vm, text, length, r->path, out);
+    text[length] = saved;
+    r->start += length;
+    r->started = true;
+    if (!ok) r->done = true;
+    return ok;
+}
+
+static bool isResourceOf(Value v, ResourceCleanupFn cleanup) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE && ((ObjResource*)AS_OBJ(v))->cleanup == cleanup;
+}
+
+// Format argument of open()/writer(): 1 = "ndjson", 0 = "array", -1 = invalid
+static int streamFormat(Value* args, int argCount) {
+    if (argCount < 2) return 0;
+    if (!IS_STRING(args[1])) return -1;
+    const char* format = AS_CSTRING(args[1]);
+    if (strcmp(format, "ndjson") == 0) return 1;
+    return strcmp(format, "array") == 0 ? 0 : -1;
+}
+
+// ucoreJson.open(path, [format]) - streaming reader, or nil if the file cannot be opened
+static Value jsonOpen(VM* vm, Value* args, int argCount) {
+    if (argCount < 1 || argCount > 2 || !IS_STRING(args[0])) return NIL_VAL;
+    int format = streamFormat(args, argCount);
+    if (format < 0) return NIL_VAL;
+
+    char* path = resolvePath(vm, AS_CSTRING(args[0]));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        free(path);
+        return NIL_VAL;
+    }
+
+    JsonReader* r = calloc(1, sizeof(JsonReader));
+    if (r) r->buffer = malloc(JSON_CHUNK_SIZE);
+    if (!r || !r->buffer) {
+        free(r);
+        free(path);
+        close(fd);
+        return NIL_VAL;
+    }
+    r->fd = fd;
+    r->path = path;
+    r->capacity = JSON_CHUNK_SIZE;
+    if (format == 0 && readerPeek(r) == '[') {
+        r->inArray = true;
+        r->start++;
+    }
+
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = r;
+    res->cleanup = readerCleanup;
+    res->next = readerNext; // foreach (var item : reader) streams the elements
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
+
+// ucoreJson.next(reader) - next element, or nil once the input is exhausted
+static Value jsonNext(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !isResourceOf(args[0], readerCleanup)) return NIL_VAL;
+    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
+    Value value;
+    return readerNext(vm, res->data, &value) ? value : NIL_VAL;
+}
+
+// ============================================================================
+// Streaming Writer
+// ============================================================================
+//
+// ucoreJson.writer(target, [format]) appends values to a file (path) or an
+// open file descriptor (int, e.g. 1 for stdout) as a JSON array, or one per
+// line with format "ndjson". Output goes out in JSON_CHUNK_SIZE chunks.
+
+typedef struct {
+    JsonHeader out;
+    int fd;
+    bool ownsFd;
+    bool ndjson;
+    int count;
+} JsonWriter;
+
+// Terminate the output and release the writer; false if any write failed
+static bool writerFinish(JsonWriter* w) {
+    if (!w->ndjson) jsonAppend(&w->out, "]", 1);
+    jsonFlush(&w->out);
+    bool ok = !w->out.failed;
+    if (w->ownsFd && close(w->fd) != 0) ok = false;
+    free(w->out.buffer);
+    free(w);
+    return ok;
+}
+
+static void writerCleanup(void* data) {
+    if (data) writerFinish((JsonWriter*)data); // Unclosed writers still end valid
+}
+
+static Value jsonWriter(VM* vm, Value* args, int argCount) {
+    if (argCount < 1 || argCount > 2) return NIL_VAL;
+    int format = streamFormat(args, argCount);
+    if (format < 0) return NIL_VAL;
+    bool ndjson = (format == 1);
+
+    int fd;
+    bool ownsFd;
+    if (IS_STRING(args[0])) {
+        char* path = resolvePath(vm, AS_CSTRING(args[0]));
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        free(path);
+        ownsFd = true;
+    } else if (IS_INT(args[0]) && !IS_BOOL(args[0])) {
+        fd = AS_INT(args[0]);
+        ownsFd = false;
+    } else {
+        return NIL_VAL;
+    }
+    if (fd < 0) return NIL_VAL;
+
+    JsonWriter* w = malloc(sizeof(JsonWriter));
+    if (!w) {
+        if (ownsFd) close(fd);
+        return NIL_VAL;
+    }
+    w->fd = fd;
+    w->ownsFd = ownsFd;
+    w->ndjson = ndjson;
+    w->count = 0;
+    jsonHeaderInit(&w->out, vm, JSON_CHUNK_SIZE + 1024, fdSink, &w->fd);
+    if (!ndjson) jsonAppend(&w->out, "[", 1);
+
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = w;
+    res->cleanup = writerCleanup;
+    res->next = NULL;
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
+
+// ucoreJson.append(writer, value) - false once the writer is closed or failed
+static Value jsonAppendValue(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 2 || !isResourceOf(args[0], writerCleanup)) return BOOL_VAL(false);
+    JsonWriter* w = (JsonWriter*)((ObjResource*)AS_OBJ(args[0]))->data;
+    if (!w) return BOOL_VAL(false);
+
+    if (!w->ndjson && w->count > 0) jsonAppend(&w->out, ",", 1);
+    stringifyValue(&w->out, args[1]);
+    if (w->ndjson) jsonAppend(&w->out, "\n", 1);
+    w->count++;
+    return BOOL_VAL(!w->out.failed);
+}
+
+// ucoreJson.close(handle) - finish a writer or release a reader early
+static Value jsonClose(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 1 || !IS_OBJ(args[0]) || AS_OBJ(args[0])->type != OBJ_RESOURCE) return BOOL_VAL(false);
+    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
+    if (!res->data) return BOOL_VAL(false);
+
+    bool ok = true;
+    if (res->cleanup == writerCleanup) {
+        ok = writerFinish((JsonWriter*)res->data);
+    } else if (res->cleanup == readerCleanup) {
+        readerCleanup(res->data);
+    } else {
+        return BOOL_VAL(false);
+    }
+    res->data = NULL; // The cleanup hooks ignore a closed handle
+    return BOOL_VAL(ok);
+}
+
+// ============================================================================
+// Parallel Map
+// ============================================================================
+//
+// ucoreJson.parallelMap(path, fn, [threads], [reduce]) runs fn over the
+// values of an NDJSON file (one per line) on one isolate per thread. The
+// file is mapped and split at line boundaries near equal byte offsets.
+
+#define JSON_PARALLEL_MAX 64
+
+typedef struct {
+    const char* pos;        // Next line
+    const char* end;        // Slice end (a line start, or the end of the file)
+    char* line;             // NUL-terminated copy of the current line
+    size_t capacity;
+    const char* path;       // For error messages
+} JsonSlice;
+
+static bool sliceNext(VM* vm, void* data, Value* out) {
+    JsonSlice* slice = (JsonSlice*)data;
+    while (slice->pos < slice->end) {
+        const char* start = slice->pos;
+        const char* newline = memchr(start, '\n', (size_t)(slice->end - start));
+        const char* stop = newline ? newline : slice->end;
+        slice->pos = newline ? newline + 1 : slice->end;
+
+        const char* p = start;
+        while (p < stop && isspace((unsigned char)*p)) p++;
+        if (p == stop) continue; // Blank line
+
+        // The parser needs a terminator, which the mapped file lacks
+        size_t length = (size_t)(stop - start);
+        if (length + 1 > slice->capacity) {
+            size_t capacity = slice->capacity ? slice->capacity : 256;
+            while (capacity < length + 1) capacity *= 2;
+            char* grown = realloc(slice->line, capacity);
+            if (!grown) exit(1);
+            slice->line = grown;
+            slice->capacity = capacity;
+        }
+        memcpy(slice->line, start, length);
+        slice->line[length] = '\0';
+        if (!parseJsonText(vm, slice->line, length, slice->path, out)) {
+            slice->pos = slice->end; // A malformed line ends the slice
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool isFunction(Value v) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_FUNCTION;
+}
+
+static Value jsonParallelMap(VM* vm, Value* args, int argCount) {
+    if (argCount < 2 || !IS_STRING(args[0]) || !isFunction(args[1])) {
+        printf("Error: ucoreJson.parallelMap expects (path, fn, [threads], [reduce]).\n");
+        return NIL_VAL;
+    }
+    int threads = argCount > 2 && IS_INT(args[2]) ? (int)AS_INT(args[2]) : 0;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > JSON_PARALLEL_MAX) threads = JSON_PARALLEL_MAX;
+    Function* reduce = NULL;
+    if (argCount > 3 && !IS_NIL(args[3])) {
+        if (!isFunction(args[3])) {
+            printf("Error: ucoreJson.parallelMap reduce must be a function.\n");
+            return NIL_VAL;
+        }
+        reduce = (Function*)AS_OBJ(args[3]);
+    }
+
+    char* path = resolvePath(vm, AS_CSTRING(args[0]));
+    FileBuffer file;
+    if (!fileMap(path, &file)) {
+        free(path);
+        return NIL_VAL;
+    }
+    const char* data = file.data;
+    size_t size = file.length;
+    if (file.mapped) posix_madvise((void*)data, size, POSIX_MADV_SEQUENTIAL);
+    const char* end = data + size;
+
+    // Slice i covers [starts[i], starts[i + 1]), each starting on a new line
+    const char* starts[JSON_PARALLEL_MAX + 1];
+    int count = 0;
+    starts[count++] = data;
+    for (int i = 1; i < threads; i++) {
+        const char* target = data + size / (size_t)threads * (size_t)i;
+        if (target <= starts[count - 1]) continue;
+        const char* newline = memchr(target, '\n', (size_t)(end - target));
+        if (!newline || newline + 1 >= end) break;
+        starts[count++] = newline + 1;
+    }
+    starts[count] = end;
+
+    JsonSlice slices[JSON_PARALLEL_MAX];
+    Partition parts[JSON_PARALLEL_MAX];
+    for (int i = 0; i < count; i++) {
+        slices[i] = (JsonSlice){ starts[i], starts[i + 1], NULL, 0, path };
+        parts[i].next = sliceNext;
+        parts[i].state = &slices[i];
+    }
+
+    Value result;
+    bool ok = isolateParallelMap(vm, (Function*)AS_OBJ(args[1]), reduce, parts, count, &result);
+    for (int i = 0; i < count; i++) free(slices[i].line);
+    fileClose(&file);
+    free(path);
+    return ok ? result : NIL_VAL;
+}
+
 // ============================================================================
 // Registration
 // ============================================================================
@@ -599,19 +1323,18 @@ void registerUCoreJson(VM* vm) {
     char* modName = modNameObj->chars;
     
     // Create Module manually
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName);
+    vm->stackTop--;
     mod->source = NULL;
     mod->obj.isMarked = true; 
     mod->obj.isPermanent = true; // PERMANENT ROOT
     
-    // CRITICAL: Use ALLOCATE_OBJ for Environment to enable GC tracking
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
     
     // Protect module during native registration
@@ -623,6 +1346,13 @@ void registerUCoreJson(VM* vm) {
     defineNative(vm, mod->env, "read", jsonRead, 1);
     defineNative(vm, mod->env, "write", jsonWrite, 2);
     defineNative(vm, mod->env, "remove", jsonRemove, 1);
+
+    defineNative(vm, mod->env, "open", jsonOpen, 2);
+    defineNative(vm, mod->env, "next", jsonNext, 1);
+    defineNative(vm, mod->env, "writer", jsonWriter, 2);
+    defineNative(vm, mod->env, "append", jsonAppendValue, 2);
+    defineNative(vm, mod->env, "close", jsonClose, 1);
+    defineNative(vm, mod->env, "parallelMap", jsonParallelMap, 2);
     
     pop(vm); // unprotect
     
@@ -2,103 +2,202 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "vm.h"
+#include "runtime/scheduler.h"
+#include "runtime/fileio.h"
 #include "ucore_scraper.h"
+#include "ucore_http_client.h"
 
 // ============================================================================
-// DOM Node Management
+// Document Arena
 // ============================================================================
 
-static ScraperNode* createNode(ScraperNodeType type) {
-    ScraperNode* node = malloc(sizeof(ScraperNode));
-    if (!node) return NULL;
-    
-    node->type = type;
-    node->tagName = NULL;
-    node->textContent = NULL;
-    node->parent = NULL;
-    node->children = NULL;
-    node->childCount = 0;
-    node->childCapacity = 0;
-    node->attrKeys = NULL;
-    node->attrValues = NULL;
-    node->attrCount = 0;
-    node->attrCapacity = 0;
-    node->isSelfClosing = false;
-    
-    return node;
-}
+#define SCRAPER_ARENA_BLOCK (64 * 1024)
 
-static void __attribute__((unused)) freeNode(ScraperNode* node) {
-    if (!node) return;
-    
-    if (node->tagName) free(node->tagName);
-    if (node->textContent) free(node->textContent);
-    
-    for (int i = 0; i < node->childCount; i++) {
-        freeNode(node->children[i]);
-    }
-    if (node->children) free(node->children);
-    
-    for (int i = 0; i < node->attrCount; i++) {
-        free(node->attrKeys[i]);
-        free(node->attrValues[i]);
+static void* arenaAlloc(ScraperArena* arena, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    ScraperArenaBlock* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        size_t blockSize = size > SCRAPER_ARENA_BLOCK ? size : SCRAPER_ARENA_BLOCK;
+        block = malloc(sizeof(ScraperArenaBlock) + blockSize);
+        if (!block) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(1);
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->size = blockSize;
+        arena->head = block;
     }
-    if (node->attrKeys) free(node->attrKeys);
-    if (node->attrValues) free(node->attrValues);
-    
-    free(node);
+    void* p = block->data + block->used;
+    block->used += size;
+    return p;
 }
 
-static void appendChild(ScraperNode* parent, ScraperNode* child) {
-    if (parent->childCapacity < parent->childCount + 1) {
-        int oldCapacity = parent->childCapacity;
-        parent->childCapacity = (oldCapacity < 8) ? 8 : oldCapacity * 2;
-        parent->children = realloc(parent->children, sizeof(ScraperNode*) * parent->childCapacity);
+static char* arenaString(ScraperArena* arena, const char* chars, int length) {
+    char* s = arenaAlloc(arena, (size_t)length + 1);
+    memcpy(s, chars, (size_t)length);
+    s[length] = '\0';
+    return s;
+}
+
+static ScraperArenaMark arenaMark(const ScraperArena* arena) {
+    ScraperArenaMark mark = { arena->head, arena->head ? arena->head->used : 0 };
+    return mark;
+}
+
+// Release everything allocated since 'mark'
+static void arenaReset(ScraperArena* arena, ScraperArenaMark mark) {
+    while (arena->head != mark.block) {
+        ScraperArenaBlock* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
     }
-    parent->children[parent->childCount++] = child;
-    child->parent = parent;
+    if (arena->head) arena->head->used = mark.used;
 }
 
-// Will be used in Phase 2
-static void __attribute__((unused)) addAttribute(ScraperNode* node, const char* key, const char* value) {
-    if (node->attrCapacity < node->attrCount + 1) {
-        int oldCapacity = node->attrCapacity;
-        node->attrCapacity = (oldCapacity < 4) ? 4 : oldCapacity * 2;
-        node->attrKeys = realloc(node->attrKeys, sizeof(char*) * node->attrCapacity);
-        node->attrValues = realloc(node->attrValues, sizeof(char*) * node->attrCapacity);
+static void arenaFree(ScraperArena* arena) {
+    ScraperArenaBlock* block = arena->head;
+    while (block) {
+        ScraperArenaBlock* next = block->next;
+        free(block);
+        block = next;
     }
-    node->attrKeys[node->attrCount] = strdup(key);
-    node->attrValues[node->attrCount] = strdup(value ? value : "");
-    node->attrCount++;
+    arena->head = NULL;
 }
 
 // ============================================================================
-// HTML Parser (Tokenizer & Tree Builder)
+// Name Interning
 // ============================================================================
+//
+// Tag names, attribute names, ids and class tokens are stored once per
+// document, so matching compares pointers. Selectors look their names up
+// (without inserting): a name the document never uses cannot match.
+// A stream seeds the table with its selector's names and then freezes it.
+
+static const char* findName(const ScraperNames* names, const char* chars, int length, unsigned int h) {
+    if (names->capacity == 0) return NULL;
+    unsigned int mask = (unsigned int)names->capacity - 1;
+    for (unsigned int i = h & mask;; i = (i + 1) & mask) {
+        const char* entry = names->entries[i];
+        if (!entry) return NULL;
+        if (names->hashes[i] == h && strncmp(entry, chars, (size_t)length) == 0 && entry[length] == '\0') {
+            return entry;
+        }
+    }
+}
+
+static void namesGrow(ScraperNames* names) {
+    int capacity = names->capacity ? names->capacity * 2 : 256;
+    const char** entries = calloc((size_t)capacity, sizeof(const char*));
+    unsigned int* hashes = malloc(sizeof(unsigned int) * (size_t)capacity);
+    if (!entries || !hashes) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    unsigned int mask = (unsigned int)capacity - 1;
+    for (int i = 0; i < names->capacity; i++) {
+        if (!names->entries[i]) continue;
+        unsigned int j = names->hashes[i] & mask;
+        while (entries[j]) j = (j + 1) & mask;
+        entries[j] = names->entries[i];
+        hashes[j] = names->hashes[i];
+    }
+    free(names->entries);
+    free(names->hashes);
+    names->entries = entries;
+    names->hashes = hashes;
+    names->capacity = capacity;
+}
+
+static const char* internName(ScraperDocument* doc, const char* chars, int length) {
+    unsigned int h = hash(chars, length);
+    const char* found = findName(&doc->names, chars, length, h);
+    if (found) return found;
+    // A name the selector does not use can never match: keep a private copy
+    if (doc->namesFrozen) return arenaString(&doc->arena, chars, length);
+    if ((doc->names.count + 1) * 4 > doc->names.capacity * 3) namesGrow(&doc->names);
+
+    const char* name = arenaString(&doc->arena, chars, length);
+    unsigned int mask = (unsigned int)doc->names.capacity - 1;
+    unsigned int i = h & mask;
+    while (doc->names.entries[i]) i = (i + 1) & mask;
+    doc->names.entries[i] = name;
+    doc->names.hashes[i] = h;
+    doc->names.count++;
+    return name;
+}
+
+// Lowercased first: tag and attribute names are case-insensitive
+static const char* internLowerName(ScraperDocument* doc, const char* chars, int length) {
+    char stackBuf[128];
+    char* buf = length < (int)sizeof(stackBuf) ? stackBuf : malloc((size_t)length + 1);
+    if (!buf) exit(1);
+    for (int i = 0; i < length; i++) buf[i] = (char)tolower((unsigned char)chars[i]);
+    const char* name = internName(doc, buf, length);
+    if (buf != stackBuf) free(buf);
+    return name;
+}
 
 // ============================================================================
-// HTML Tokenizer
+// DOM Node Management
 // ============================================================================
 
-typedef enum {
-    SCRAPER_TOKEN_TAG_OPEN,    // <div
-    SCRAPER_TOKEN_TAG_CLOSE,   // </div>
-    SCRAPER_TOKEN_TEXT,        // Plain text
-    SCRAPER_TOKEN_EOF,
-    SCRAPER_TOKEN_ERROR
-} ScraperTokenType;
+static ScraperNode* createNode(ScraperDocument* doc, ScraperNodeType type) {
+    ScraperNode* node = arenaAlloc(&doc->arena, sizeof(ScraperNode));
+    memset(node, 0, sizeof(ScraperNode));
+    node->type = type;
+    return node;
+}
+
+static void appendChild(ScraperNode* parent, ScraperNode* child) {
+    child->parent = parent;
+    if (parent->lastChild) parent->lastChild->nextSibling = child;
+    else parent->firstChild = child;
+    parent->lastChild = child;
+}
 
-typedef struct {
-    ScraperTokenType type;
-    const char* start;
-    int length;
-    // For tags
-    const char* tagName;
-    int tagNameLen;
-    bool isSelfClosing; // <br/>
-} ScraperToken;
+static void addElement(ScraperDocument* doc, ScraperNode* element) {
+    if (doc->elementCount == doc->elementCapacity) {
+        doc->elementCapacity = doc->elementCapacity ? doc->elementCapacity * 2 : 256;
+        doc->elements = realloc(doc->elements, sizeof(ScraperNode*) * (size_t)doc->elementCapacity);
+        if (!doc->elements) exit(1);
+    }
+    doc->elements[doc->elementCount++] = element;
+}
+
+static void freeIndex(ScraperIndex* index) {
+    free(index->slots);
+    free(index->items);
+    index->slots = NULL;
+    index->items = NULL;
+    index->capacity = 0;
+}
+
+void scraper_freeDocument(ScraperDocument* doc) {
+    if (!doc) return;
+    arenaFree(&doc->arena);
+    free(doc->names.entries);
+    free(doc->names.hashes);
+    free(doc->elements);
+    freeIndex(&doc->byTag);
+    freeIndex(&doc->byId);
+    freeIndex(&doc->byClass);
+    free(doc);
+}
+
+// ============================================================================
+// HTML Parser (Tokenizer & Tree Builder)
+// ============================================================================
 
 static bool isAlpha(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
@@ -119,18 +218,44 @@ static void skipWhitespace(HtmlParser* parser) {
     }
 }
 
+#define SCRAPER_MAX_ATTRS 64 // Per element; later ones are dropped
+
+// Split the class attribute into interned tokens
+static void setClasses(ScraperDocument* doc, ScraperNode* node, const char* value) {
+    int count = 0;
+    for (const char* p = value; *p;) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        count++;
+        while (*p && !isspace((unsigned char)*p)) p++;
+    }
+    if (count == 0) return;
+    node->classes = arenaAlloc(&doc->arena, sizeof(const char*) * (size_t)count);
+    node->classCount = 0;
+    for (const char* p = value; *p;) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        const char* start = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        node->classes[node->classCount++] = internName(doc, start, (int)(p - start));
+    }
+}
+
 // Parse attributes for the current node
 // Simplified: assumes we are inside <tag ... >
-// OPTIMIZED: Uses stack buffers for small attributes to reduce malloc overhead
+// Attributes are collected on the stack and copied into the arena once
 static void parseAttributes(HtmlParser* parser, ScraperNode* node) {
-    char nameBuf[128];
-    char valueBuf[1024];
-    
+    ScraperDocument* doc = parser->document;
+    ScraperAttr attrs[SCRAPER_MAX_ATTRS];
+    int count = 0;
+    const char* idName = internName(doc, "id", 2);
+    const char* className = internName(doc, "class", 5);
+
     while (parser->current < parser->length) {
         skipWhitespace(parser);
         char c = parser->source[parser->current];
         
-        if (c == '>' || c == '/') return; // End of tag
+        if (c == '>' || c == '/') break; // End of tag
         
         // Attribute Name
         int nameStart = parser->current;
@@ -140,25 +265,11 @@ static void parseAttributes(HtmlParser* parser, ScraperNode* node) {
         }
         int nameLen = parser->current - nameStart;
         if (nameLen == 0) { parser->current++; continue; } // Skip garbage
-        
-        // Use stack buffer if small enough
-        char* name;
-        bool nameHeap = false;
-        if (nameLen < 127) {
-            memcpy(nameBuf, parser->source + nameStart, nameLen);
-            nameBuf[nameLen] = '\0';
-            name = nameBuf;
-        } else {
-            name = malloc(nameLen + 1);
-            memcpy(name, parser->source + nameStart, nameLen);
-            name[nameLen] = '\0';
-            nameHeap = true;
-        }
+        const char* name = internLowerName(doc, parser->source + nameStart, nameLen);
         
         // Check for =
         skipWhitespace(parser);
-        char* value = NULL;
-        bool valueHeap = false;
+        const char* value = "";
         
         if (parser->source[parser->current] == '=') {
             parser->current++; // skip =
@@ -180,29 +291,28 @@ static void parseAttributes(HtmlParser* parser, ScraperNode* node) {
                 // Unquoted value
                 valStart = parser->current;
                 while (parser->current < parser->length && 
-                       !isspace(parser->source[parser->current]) && 
+                       !isspace((unsigned char)parser->source[parser->current]) && 
                        parser->source[parser->current] != '>') {
                     parser->current++;
                 }
                 valLen = parser->current - valStart;
             }
-            
-            // Use stack buffer if small enough
-            if (valLen < 1023) {
-                memcpy(valueBuf, parser->source + valStart, valLen);
-                valueBuf[valLen] = '\0';
-                value = valueBuf;
-            } else {
-                value = malloc(valLen + 1);
-                memcpy(value, parser->source + valStart, valLen);
-                value[valLen] = '\0';
-                valueHeap = true;
-            }
+            value = arenaString(&doc->arena, parser->source + valStart, valLen);
         }
         
-        addAttribute(node, name, value);
-        if (nameHeap) free(name);
-        if (valueHeap) free(value);
+        if (count < SCRAPER_MAX_ATTRS) {
+            attrs[count].name = name;
+            attrs[count].value = value;
+            count++;
+        }
+        if (name == idName) node->id = internName(doc, value, (int)strlen(value));
+        else if (name == className) setClasses(doc, node, value);
+    }
+
+    if (count > 0) {
+        node->attrs = arenaAlloc(&doc->arena, sizeof(ScraperAttr) * (size_t)count);
+        memcpy(node->attrs, attrs, sizeof(ScraperAttr) * (size_t)count);
+        node->attrCount = count;
     }
 }
 
@@ -210,13 +320,27 @@ static void parseAttributes(HtmlParser* parser, ScraperNode* node) {
 // Tree Builder
 // ============================================================================
 
-static ScraperNode* parseHtml(const char* source) {
+static bool isVoidElement(const char* tagName) {
+    return strcmp(tagName, "img") == 0 || strcmp(tagName, "br") == 0 ||
+           strcmp(tagName, "meta") == 0 || strcmp(tagName, "hr") == 0 ||
+           strcmp(tagName, "input") == 0 || strcmp(tagName, "link") == 0;
+}
+
+ScraperDocument* scraper_parseHtml(const char* source, int length) {
+    ScraperDocument* doc = calloc(1, sizeof(ScraperDocument));
+    if (!doc) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+
     HtmlParser parser;
     parser.source = source;
-    parser.length = strlen(source);
+    parser.length = length;
     parser.current = 0;
+    parser.document = doc;
     
-    ScraperNode* root = createNode(NODE_DOCUMENT);
+    ScraperNode* root = createNode(doc, NODE_DOCUMENT);
+    doc->root = root;
     ScraperNode* currentParent = root;
     
     // Simple stack for hierarchy (using parent pointers instead of explicit stack array)
@@ -230,8 +354,6 @@ static ScraperNode* parseHtml(const char* source) {
                 strncmp(parser.source + parser.current, "<!--", 4) == 0) {
                 // Comment
                 parser.current += 4;
-                int start = parser.current;
-                (void)start; // Suppress unused warning
                 while (parser.current + 2 < parser.length && 
                        strncmp(parser.source + parser.current, "-->", 3) != 0) {
                     parser.current++;
@@ -244,8 +366,6 @@ static ScraperNode* parseHtml(const char* source) {
             if (parser.current + 1 < parser.length && parser.source[parser.current+1] == '/') {
                 // Closing tag: </div>
                 parser.current += 2;
-                int start = parser.current;
-                (void)start; // Suppress unused warning
                 while (parser.current < parser.length && parser.source[parser.current] != '>') {
                     parser.current++;
                 }
@@ -267,28 +387,17 @@ static ScraperNode* parseHtml(const char* source) {
             int nameLen = parser.current - nameStart;
             
             if (nameLen > 0) {
-                char* tagName = malloc(nameLen + 1);
-                memcpy(tagName, parser.source + nameStart, nameLen);
-                tagName[nameLen] = '\0';
-                // Lowercase canonicalization
-                for(int i=0; i<nameLen; i++) tagName[i] = tolower(tagName[i]);
-                
-                ScraperNode* element = createNode(NODE_ELEMENT);
-                element->tagName = tagName;
+                ScraperNode* element = createNode(doc, NODE_ELEMENT);
+                element->tagName = internLowerName(doc, parser.source + nameStart, nameLen);
                 
                 parseAttributes(&parser, element);
                 
                 // Check self-closing / void elements
-                bool isVoid = false;
-                if (strcmp(tagName, "img") == 0 || strcmp(tagName, "br") == 0 || 
-                    strcmp(tagName, "meta") == 0 || strcmp(tagName, "hr") == 0 ||
-                    strcmp(tagName, "input") == 0 || strcmp(tagName, "link") == 0) {
-                    isVoid = true;
-                }
-                
+                bool isVoid = isVoidElement(element->tagName);
                 if (parser.current < parser.length && parser.source[parser.current] == '/') {
                     isVoid = true; // <div /> style
                 }
+                element->isSelfClosing = isVoid;
                 
                 while (parser.current < parser.length && parser.source[parser.current] != '>') {
                     parser.current++;
@@ -296,6 +405,7 @@ static ScraperNode* parseHtml(const char* source) {
                 if (parser.current < parser.length) parser.current++; // skip >
                 
                 appendChild(currentParent, element);
+                addElement(doc, element);
                 
                 if (!isVoid) {
                     currentParent = element;
@@ -307,54 +417,166 @@ static ScraperNode* parseHtml(const char* source) {
         } else {
             // Text Content
             int start = parser.current;
-            while (parser.current < parser.length && parser.source[parser.current] != '<') {
-                parser.current++;
-            }
+            const char* lt = memchr(parser.source + start, '<', (size_t)(parser.length - start));
+            parser.current = lt ? (int)(lt - parser.source) : parser.length;
             int len = parser.current - start;
             if (len > 0) {
-                // Only add if not just whitespace (optional optimization, keeping it strict for now)
-                // Actually, let's keep all text but trim later if needed.
-                char* text = malloc(len + 1);
-                memcpy(text, parser.source + start, len);
-                text[len] = '\0';
-                
-                ScraperNode* textNode = createNode(NODE_TEXT);
-                textNode->textContent = text;
+                ScraperNode* textNode = createNode(doc, NODE_TEXT);
+                textNode->textContent = arenaString(&doc->arena, parser.source + start, len);
+                textNode->textLength = len;
                 appendChild(currentParent, textNode);
             }
         }
     }
     
-    return root;
+    return doc;
+}
+
+// ============================================================================
+// Element Indexes
+// ============================================================================
+//
+// Built on the first select() against a reusable document: one pass counts
+// the elements per key, a second lays them out back to back, so each
+// index is two allocations and every list stays in document order.
+
+static inline unsigned int pointerHash(const void* p) {
+    uintptr_t x = (uintptr_t)p;
+    x ^= x >> 15;
+    x *= 0x2c1b3c6du;
+    x ^= x >> 12;
+    return (unsigned int)x;
+}
+
+static ScraperIndexSlot* indexSlot(ScraperIndex* index, const char* key, bool insert) {
+    if (index->capacity == 0) return NULL;
+    unsigned int mask = (unsigned int)index->capacity - 1;
+    for (unsigned int i = pointerHash(key) & mask;; i = (i + 1) & mask) {
+        ScraperIndexSlot* slot = &index->slots[i];
+        if (slot->key == key) return slot;
+        if (!slot->key) {
+            if (!insert) return NULL;
+            slot->key = key;
+            return slot;
+        }
+    }
+}
+
+typedef enum { INDEX_TAG, INDEX_ID, INDEX_CLASS } ScraperIndexKind;
+
+static void buildIndex(ScraperDocument* doc, ScraperIndex* index, ScraperIndexKind kind) {
+    int keys = 0;
+    for (int i = 0; i < doc->elementCount; i++) {
+        ScraperNode* e = doc->elements[i];
+        keys += kind == INDEX_TAG ? 1 : kind == INDEX_ID ? (e->id != NULL) : e->classCount;
+    }
+    // At most one slot per distinct name, and every key is a name
+    int capacity = 16;
+    while (capacity < doc->names.count * 2) capacity *= 2;
+    index->slots = calloc((size_t)capacity, sizeof(ScraperIndexSlot));
+    index->items = malloc(sizeof(ScraperNode*) * (size_t)(keys ? keys : 1));
+    if (!index->slots || !index->items) exit(1);
+    index->capacity = capacity;
+
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            int start = 0;
+            for (int s = 0; s < capacity; s++) {
+                index->slots[s].start = start;
+                start += index->slots[s].count;
+                index->slots[s].count = 0;
+            }
+        }
+        for (int i = 0; i < doc->elementCount; i++) {
+            ScraperNode* e = doc->elements[i];
+            int n = kind == INDEX_TAG ? 1 : kind == INDEX_ID ? (e->id != NULL) : e->classCount;
+            for (int k = 0; k < n; k++) {
+                const char* key = kind == INDEX_TAG ? e->tagName : kind == INDEX_ID ? e->id : e->classes[k];
+                // A repeated class on one element is listed once
+                if (kind == INDEX_CLASS) {
+                    bool repeated = false;
+                    for (int j = 0; j < k; j++) repeated |= e->classes[j] == key;
+                    if (repeated) continue;
+                }
+                ScraperIndexSlot* slot = indexSlot(index, key, true);
+                if (pass == 1) index->items[slot->start + slot->count] = e;
+                slot->count++;
+            }
+        }
+    }
+}
+
+static void indexDocument(ScraperDocument* doc) {
+    if (doc->indexed) return;
+    buildIndex(doc, &doc->byTag, INDEX_TAG);
+    buildIndex(doc, &doc->byId, INDEX_ID);
+    buildIndex(doc, &doc->byClass, INDEX_CLASS);
+    doc->indexed = true;
 }
 
 // ============================================================================
 // CSS Selector Engine
 // ============================================================================
 
-static ScraperSelector* createSelector() {
-    ScraperSelector* sel = malloc(sizeof(ScraperSelector));
-    sel->tagName = NULL;
-    sel->id = NULL;
-    sel->className = NULL;
-    sel->next = NULL;
-    sel->combinator = COMBINATOR_NONE;
-    return sel;
+static char* copyToken(const char* start, int len, bool lower) {
+    char* s = malloc((size_t)len + 1);
+    if (!s) exit(1);
+    for (int i = 0; i < len; i++) s[i] = lower ? (char)tolower((unsigned char)start[i]) : start[i];
+    s[len] = '\0';
+    return s;
 }
 
 static void freeSelector(ScraperSelector* sel) {
     if (!sel) return;
-    if (sel->tagName) free(sel->tagName);
-    if (sel->id) free(sel->id);
-    if (sel->className) free(sel->className);
-    if (sel->next) freeSelector(sel->next);
+    for (int i = 0; i < sel->count; i++) {
+        SelectorCompound* part = &sel->parts[i];
+        free(part->tagName);
+        free(part->id);
+        for (int k = 0; k < part->classCount; k++) free(part->classes[k]);
+        free(part->classes);
+        for (int k = 0; k < part->attrCount; k++) {
+            free(part->attrs[k].name);
+            free(part->attrs[k].value);
+        }
+        free(part->attrs);
+    }
+    free(sel->parts);
     free(sel);
 }
 
-// Parse a single selector part "div#id.class"
-// Returns the current selector, and updates *source ptr to match
-static ScraperSelector* parseSingleSelector(const char** sourceRef) {
-    ScraperSelector* sel = createSelector();
+// Parse "[name]", "[name=value]" or "[name='value']" at s (just past '[')
+static const char* parseAttrSelector(const char* s, SelectorCompound* part) {
+    while (*s == ' ') s++;
+    const char* start = s;
+    while (*s && isAlphaNumeric(*s)) s++;
+    int len = (int)(s - start);
+    while (*s == ' ') s++;
+    char* value = NULL;
+    if (*s == '=') {
+        s++;
+        while (*s == ' ') s++;
+        char quote = (*s == '"' || *s == '\'') ? *s++ : 0;
+        const char* vstart = s;
+        while (*s && (quote ? *s != quote : (*s != ']' && *s != ' '))) s++;
+        value = copyToken(vstart, (int)(s - vstart), false);
+        if (quote && *s) s++;
+        while (*s == ' ') s++;
+    }
+    if (*s == ']') s++;
+    if (len == 0) {
+        free(value);
+        return s;
+    }
+    part->attrs = realloc(part->attrs, sizeof(SelectorAttr) * (size_t)(part->attrCount + 1));
+    if (!part->attrs) exit(1);
+    part->attrs[part->attrCount].name = copyToken(start, len, true);
+    part->attrs[part->attrCount].value = value;
+    part->attrCount++;
+    return s;
+}
+
+// Parse a single compound "div#id.class[attr]", advancing *sourceRef
+static void parseSingleSelector(const char** sourceRef, SelectorCompound* part) {
     const char* s = *sourceRef;
     
     while (*s && *s != ' ' && *s != '>') {
@@ -362,89 +584,627 @@ static ScraperSelector* parseSingleSelector(const char** sourceRef) {
             s++;
             const char* start = s;
             while (*s && isAlphaNumeric(*s)) s++;
-            int len = s - start;
-            sel->id = malloc(len + 1);
-            memcpy(sel->id, start, len);
-            sel->id[len] = '\0';
+            free(part->id);
+            part->id = copyToken(start, (int)(s - start), false);
         } else if (*s == '.') {
             s++;
             const char* start = s;
             while (*s && isAlphaNumeric(*s)) s++;
-            int len = s - start;
-            sel->className = malloc(len + 1);
-            memcpy(sel->className, start, len);
-            sel->className[len] = '\0';
+            part->classes = realloc(part->classes, sizeof(char*) * (size_t)(part->classCount + 1));
+            if (!part->classes) exit(1);
+            part->classes[part->classCount++] = copyToken(start, (int)(s - start), false);
+        } else if (*s == '[') {
+            s = parseAttrSelector(s + 1, part);
         } else if (isAlpha(*s)) {
             const char* start = s;
             while (*s && isAlphaNumeric(*s)) s++;
-            int len = s - start;
-            sel->tagName = malloc(len + 1);
-            memcpy(sel->tagName, start, len);
-            sel->tagName[len] = '\0';
-            for(int i=0; i<len; i++) sel->tagName[i] = tolower(sel->tagName[i]);
-        } else if (*s == '*') {
-            s++; // wildcard, ignore tagName=NULL means any
+            free(part->tagName);
+            part->tagName = copyToken(start, (int)(s - start), true);
         } else {
-            // Unexpected char, skip?
-            s++;
+            s++; // '*' (any tag) or an unsupported character
         }
     }
     
     *sourceRef = s;
-    return sel;
 }
 
-// Parse attributes for the current node
-// Simplified: assumes we are inside <tag ... >
-
-// ... (previous code)
-
+// Compile a selector such as "div.card > a[href]"; NULL if it is empty
 static ScraperSelector* parseSelector(const char* identifier) {
+    ScraperSelector* sel = calloc(1, sizeof(ScraperSelector));
+    if (!sel) exit(1);
+    int capacity = 0;
     const char* s = identifier;
-    ScraperSelector* head = NULL;
-    ScraperSelector* current = NULL;
+    SelectorCombinator comb = COMBINATOR_NONE;
     
     while (*s) {
         // Skip whitespace before next selector
         while (*s == ' ') s++;
         if (!*s) break;
-        
-        SelectorCombinator comb = COMBINATOR_DESCENDANT;
         if (*s == '>') {
-             comb = COMBINATOR_CHILD;
-             s++;
-             while (*s == ' ') s++; // skip spaces after >
+            comb = COMBINATOR_CHILD;
+            s++;
+            continue;
         }
         
-        ScraperSelector* part = parseSingleSelector(&s);
-        
-        if (!head) {
-            head = part;
-            current = head;
-        } else {
-            current->next = part;
-            current->combinator = comb; // The combinator linking PREVIOUS to THIS? 
-            // Wait, logic: "div > p"
-            // head = div. 
-            // next part = p.
-            // relation is CHILD.
-            // Where do we store relation? 
-            // usually "div" has a "relation to next".
-            // So current->combinator = comb.
-            current = part;
+        if (sel->count == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            sel->parts = realloc(sel->parts, sizeof(SelectorCompound) * (size_t)capacity);
+            if (!sel->parts) exit(1);
+        }
+        SelectorCompound* part = &sel->parts[sel->count++];
+        memset(part, 0, sizeof(SelectorCompound));
+        part->combinator = sel->count == 1 ? COMBINATOR_NONE : comb;
+        parseSingleSelector(&s, part);
+        sel->nameCount += (part->tagName != NULL) + (part->id != NULL) + part->classCount + part->attrCount;
+        comb = COMBINATOR_DESCENDANT;
+    }
+    if (sel->count == 0) {
+        freeSelector(sel);
+        return NULL;
+    }
+    return sel;
+}
+
+// A compound with its names resolved to one document's interned pointers
+typedef struct {
+    const char* tagName;
+    const char* id;
+    const char** classes;
+    int classCount;
+    const char** attrNames;
+    const char** attrValues; // Borrowed from the selector
+    int attrCount;
+    SelectorCombinator combinator;
+} BoundCompound;
+
+typedef struct {
+    BoundCompound* parts;
+    int count;
+    const char** names;      // Storage for every part's names
+} BoundSelector;
+
+// Resolve the selector's names in 'doc'; false if one is missing there,
+// in which case nothing can match
+static bool bindSelector(const ScraperSelector* sel, const ScraperDocument* doc, BoundSelector* out) {
+    out->count = sel->count;
+    out->parts = malloc(sizeof(BoundCompound) * (size_t)sel->count);
+    out->names = malloc(sizeof(const char*) * (size_t)(sel->nameCount * 2 + 1));
+    if (!out->parts || !out->names) exit(1);
+    const char** next = out->names;
+    bool ok = true;
+
+    for (int i = 0; i < sel->count && ok; i++) {
+        const SelectorCompound* part = &sel->parts[i];
+        BoundCompound* b = &out->parts[i];
+        b->combinator = part->combinator;
+        b->tagName = NULL;
+        b->id = NULL;
+        if (part->tagName) {
+            int len = (int)strlen(part->tagName);
+            b->tagName = findName(&doc->names, part->tagName, len, hash(part->tagName, len));
+            ok &= b->tagName != NULL;
+        }
+        if (part->id) {
+            int len = (int)strlen(part->id);
+            b->id = findName(&doc->names, part->id, len, hash(part->id, len));
+            ok &= b->id != NULL;
+        }
+        b->classes = next;
+        b->classCount = part->classCount;
+        for (int k = 0; k < part->classCount; k++) {
+            int len = (int)strlen(part->classes[k]);
+            *next = findName(&doc->names, part->classes[k], len, hash(part->classes[k], len));
+            ok &= *next++ != NULL;
+        }
+        b->attrNames = next;
+        b->attrCount = part->attrCount;
+        for (int k = 0; k < part->attrCount; k++) {
+            int len = (int)strlen(part->attrs[k].name);
+            *next = findName(&doc->names, part->attrs[k].name, len, hash(part->attrs[k].name, len));
+            ok &= *next++ != NULL;
+        }
+        b->attrValues = next;
+        for (int k = 0; k < part->attrCount; k++) *next++ = part->attrs[k].value;
+    }
+    return ok;
+}
+
+static void unbindSelector(BoundSelector* bound) {
+    free(bound->parts);
+    free(bound->names);
+}
+
+static bool hasClass(const ScraperNode* node, const char* name) {
+    for (int i = 0; i < node->classCount; i++) {
+        if (node->classes[i] == name) return true;
+    }
+    return false;
+}
+
+// Check if node matches one compound (no chain); names compare by pointer
+static bool nodeMatchesSimple(const ScraperNode* node, const BoundCompound* sel) {
+    if (node->type != NODE_ELEMENT) return false;
+    if (sel->tagName && node->tagName != sel->tagName) return false;
+    if (sel->id && node->id != sel->id) return false;
+    for (int i = 0; i < sel->classCount; i++) {
+        if (!hasClass(node, sel->classes[i])) return false;
+    }
+    for (int i = 0; i < sel->attrCount; i++) {
+        bool found = false;
+        for (int k = 0; k < node->attrCount && !found; k++) {
+            found = node->attrs[k].name == sel->attrNames[i] &&
+                    (!sel->attrValues[i] || strcmp(node->attrs[k].value, sel->attrValues[i]) == 0);
         }
+        if (!found) return false;
     }
-    return head;
+    return true;
+}
+
+// Does 'node' match parts[0..i], with parts[i] as the subject? Matches
+// right to left, trying each ancestor for a descendant combinator.
+static bool matchesFrom(const BoundSelector* sel, int i, const ScraperNode* node) {
+    if (!nodeMatchesSimple(node, &sel->parts[i])) return false;
+    if (i == 0) return true;
+    const ScraperNode* up = node->parent;
+    if (sel->parts[i].combinator == COMBINATOR_CHILD) {
+        return up && matchesFrom(sel, i - 1, up);
+    }
+    for (; up && up->type == NODE_ELEMENT; up = up->parent) {
+        if (matchesFrom(sel, i - 1, up)) return true;
+    }
+    return false;
 }
 
+// Elements that can match the subject, in document order
+static ScraperNode** candidates(ScraperDocument* doc, const BoundCompound* subject, int* count) {
+    ScraperIndexSlot* slot = NULL;
+    if (doc->indexed) {
+        if (subject->id) slot = indexSlot(&doc->byId, subject->id, false);
+        else if (subject->classCount > 0) slot = indexSlot(&doc->byClass, subject->classes[0], false);
+        else if (subject->tagName) slot = indexSlot(&doc->byTag, subject->tagName, false);
+        else {
+            *count = doc->elementCount;
+            return doc->elements;
+        }
+        if (!slot) {
+            *count = 0;
+            return NULL;
+        }
+        ScraperIndex* index = subject->id ? &doc->byId : subject->classCount > 0 ? &doc->byClass : &doc->byTag;
+        *count = slot->count;
+        return index->items + slot->start;
+    }
+    *count = doc->elementCount;
+    return doc->elements;
+}
 
+// Matching elements in document order, each once (caller frees)
+static ScraperNode** selectNodes(ScraperDocument* doc, const ScraperSelector* sel, int* count) {
+    *count = 0;
+    if (!sel) return NULL;
+    BoundSelector bound;
+    ScraperNode** results = NULL;
+    if (bindSelector(sel, doc, &bound)) {
+        int candidateCount;
+        ScraperNode** cands = candidates(doc, &bound.parts[bound.count - 1], &candidateCount);
+        int capacity = 0;
+        for (int i = 0; i < candidateCount; i++) {
+            if (!matchesFrom(&bound, bound.count - 1, cands[i])) continue;
+            if (*count == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                results = realloc(results, sizeof(ScraperNode*) * (size_t)capacity);
+                if (!results) exit(1);
+            }
+            results[(*count)++] = cands[i];
+        }
+    }
+    unbindSelector(&bound);
+    return results;
+}
 
 // ============================================================================
-// Native Bindings
+// Streaming Tokenizer
 // ============================================================================
+//
+// stream() never builds a tree. It keeps the chain of open elements (each
+// in the arena, rolled back when the element closes) so the selector can be
+// checked as every start tag completes, and copies text only while a match
+// is open. Input is read in chunks; a token cut off by a chunk boundary is
+// parsed again once more bytes arrive.
+
+#define SCRAPER_STREAM_CHUNK (64 * 1024)
+
+// A match, copied out of the arena; 'done' once its element has closed
+typedef struct {
+    char* tagName;
+    char** attrNames;
+    char** attrValues;
+    int attrCount;
+    char* text;
+    int textLength;
+    int textStart;          // Into ScraperStream.text while open
+    bool done;
+} ScraperMatch;
+
+extern char** environ;
 
-// ucoreScraper.parse(htmlString) -> DocumentObject
-// (Previous code block was malformed)
+// Run curl (-s -L) on 'url' without a shell: the URL is a single argument
+// after "--", so nothing in it is interpreted. With 'outputPath' the body
+// is written there (creating directories); otherwise *fd is the read end
+// of curl's stdout. Returns the pid, or -1 if curl could not be started.
+static pid_t spawnCurl(const char* url, const char* outputPath, int* fd) {
+    int out[2];
+    if (!outputPath) {
+        if (pipe(out) != 0) return -1;
+        fcntl(out[0], F_SETFD, FD_CLOEXEC);
+        fcntl(out[1], F_SETFD, FD_CLOEXEC);
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    if (outputPath) posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    else posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    char* fetchArgv[] = { "curl", "-s", "-L", "--", (char*)url, NULL };
+    char* saveArgv[] = { "curl", "-s", "-L", "--create-dirs", "-o", (char*)outputPath, "--", (char*)url, NULL };
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "curl", &actions, &attr, outputPath ? saveArgv : fetchArgv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (!outputPath) {
+        close(out[1]);
+        if (rc != 0) close(out[0]);
+        else *fd = out[0];
+    }
+    return rc == 0 ? pid : -1;
+}
+
+// Reap curl; its exit status, or -1 if it did not exit normally
+static int waitCurl(pid_t pid) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+typedef struct {
+    ScraperNode* node;
+    ScraperArenaMark mark;  // Arena position before this element
+    long match;             // Sequence number in 'pending', -1 if none
+} StreamFrame;
+
+typedef struct {
+    ScraperDocument* doc;   // Name table and arena for the open elements
+    BoundSelector bound;
+    int fd;
+    pid_t curl;             // curl reading a URL, else 0
+    bool eof;
+    bool inComment;
+
+    char* buf;              // Unconsumed input, NUL-terminated
+    int len;
+    int capacity;
+    int pos;
+
+    StreamFrame* frames;
+    int depth;
+    int frameCapacity;
+
+    char* text;             // Text of the open matches, outermost first
+    int textLength;
+    int textCapacity;
+    int captureDepth;       // Open elements that matched
+
+    // Matches in document order; an outer match holds back the ones
+    // inside it until it closes
+    ScraperMatch* pending;
+    int pendingHead;
+    int pendingCount;
+    int pendingCapacity;
+    long pendingBase;       // Sequence number of pending[0]
+} ScraperStream;
+
+static void freeMatch(ScraperMatch* m) {
+    free(m->tagName);
+    for (int i = 0; i < m->attrCount; i++) {
+        free(m->attrNames[i]);
+        free(m->attrValues[i]);
+    }
+    free(m->attrNames);
+    free(m->attrValues);
+    free(m->text);
+}
+
+static void streamFree(ScraperStream* st) {
+    if (!st) return;
+    if (st->fd >= 0) close(st->fd);
+    if (st->curl > 0) waitCurl(st->curl); // A transfer still running fails on the closed pipe
+    for (int i = st->pendingHead; i < st->pendingCount; i++) freeMatch(&st->pending[i]);
+    free(st->pending);
+    free(st->frames);
+    free(st->text);
+    free(st->buf);
+    unbindSelector(&st->bound);
+    scraper_freeDocument(st->doc);
+    free(st);
+}
+
+static void internSeed(ScraperDocument* doc, const char* name) {
+    internName(doc, name, (int)strlen(name));
+}
+
+// Intern the selector's names so elements can be matched by pointer, then
+// bind it. Attribute values are copied: the stream outlives 'sel'.
+static void streamBind(ScraperStream* st, const ScraperSelector* sel) {
+    ScraperDocument* doc = st->doc;
+    internSeed(doc, "id");
+    internSeed(doc, "class");
+    for (int i = 0; i < sel->count; i++) {
+        const SelectorCompound* part = &sel->parts[i];
+        if (part->tagName) internSeed(doc, part->tagName);
+        if (part->id) internSeed(doc, part->id);
+        for (int k = 0; k < part->classCount; k++) internSeed(doc, part->classes[k]);
+        for (int k = 0; k < part->attrCount; k++) internSeed(doc, part->attrs[k].name);
+    }
+    bindSelector(sel, doc, &st->bound);
+    for (int i = 0; i < sel->count; i++) {
+        const SelectorCompound* part = &sel->parts[i];
+        for (int k = 0; k < part->attrCount; k++) {
+            const char* value = part->attrs[k].value;
+            st->bound.parts[i].attrValues[k] = value ? arenaString(&doc->arena, value, (int)strlen(value)) : NULL;
+        }
+    }
+    doc->namesFrozen = true;
+    doc->root = createNode(doc, NODE_DOCUMENT);
+}
+
+// Read the next chunk, keeping the unconsumed tail; false at EOF
+static bool streamFill(VM* vm, ScraperStream* st) {
+    if (st->pos > 0) {
+        memmove(st->buf, st->buf + st->pos, (size_t)(st->len - st->pos));
+        st->len -= st->pos;
+        st->pos = 0;
+    }
+    if (st->capacity - st->len < SCRAPER_STREAM_CHUNK / 2) {
+        st->capacity *= 2; // Only for a single token larger than a chunk
+        st->buf = realloc(st->buf, (size_t)st->capacity + 1);
+        if (!st->buf) exit(1);
+    }
+    while (1) {
+        if (st->curl > 0) {
+            struct pollfd pfd = { st->fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 0) == 0) {
+                taskWaitFd(vm, st->fd, POLLIN); // Other tasks run while the download waits
+                poll(&pfd, 1, -1);
+            }
+        }
+        ssize_t n = read(st->fd, st->buf + st->len, (size_t)(st->capacity - st->len));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            st->eof = true;
+            st->buf[st->len] = '\0';
+            return false;
+        }
+        st->len += (int)n;
+        st->buf[st->len] = '\0';
+        return true;
+    }
+}
+
+static void streamCapture(ScraperStream* st, const char* chars, int length) {
+    if (st->textLength + length > st->textCapacity) {
+        while (st->textLength + length > st->textCapacity) {
+            st->textCapacity = st->textCapacity ? st->textCapacity * 2 : 4096;
+        }
+        st->text = realloc(st->text, (size_t)st->textCapacity);
+        if (!st->text) exit(1);
+    }
+    memcpy(st->text + st->textLength, chars, (size_t)length);
+    st->textLength += length;
+}
+
+static long streamAddMatch(ScraperStream* st, const ScraperNode* node) {
+    if (st->pendingHead == st->pendingCount) {
+        st->pendingBase += st->pendingCount;
+        st->pendingHead = st->pendingCount = 0;
+    } else if (st->pendingHead > 0 && st->pendingCount == st->pendingCapacity) {
+        memmove(st->pending, st->pending + st->pendingHead,
+                sizeof(ScraperMatch) * (size_t)(st->pendingCount - st->pendingHead));
+        st->pendingBase += st->pendingHead;
+        st->pendingCount -= st->pendingHead;
+        st->pendingHead = 0;
+    }
+    if (st->pendingCount == st->pendingCapacity) {
+        st->pendingCapacity = st->pendingCapacity ? st->pendingCapacity * 2 : 16;
+        st->pending = realloc(st->pending, sizeof(ScraperMatch) * (size_t)st->pendingCapacity);
+        if (!st->pending) exit(1);
+    }
+    ScraperMatch* m = &st->pending[st->pendingCount];
+    memset(m, 0, sizeof(ScraperMatch));
+    m->tagName = strdup(node->tagName);
+    if (node->attrCount > 0) {
+        m->attrNames = malloc(sizeof(char*) * (size_t)node->attrCount);
+        m->attrValues = malloc(sizeof(char*) * (size_t)node->attrCount);
+        if (!m->attrNames || !m->attrValues) exit(1);
+        for (int i = 0; i < node->attrCount; i++) {
+            m->attrNames[i] = strdup(node->attrs[i].name);
+            m->attrValues[i] = strdup(node->attrs[i].value);
+        }
+        m->attrCount = node->attrCount;
+    }
+    m->textStart = st->textLength;
+    return st->pendingBase + st->pendingCount++;
+}
+
+static void streamPop(ScraperStream* st) {
+    StreamFrame* frame = &st->frames[--st->depth];
+    if (frame->match >= 0) {
+        ScraperMatch* m = &st->pending[frame->match - st->pendingBase];
+        m->textLength = st->textLength - m->textStart;
+        if (m->textLength > 0) {
+            m->text = malloc((size_t)m->textLength);
+            if (!m->text) exit(1);
+            memcpy(m->text, st->text + m->textStart, (size_t)m->textLength);
+        }
+        m->done = true;
+        if (--st->captureDepth == 0) st->textLength = 0;
+    }
+    arenaReset(&st->doc->arena, frame->mark);
+}
+
+// A complete start tag at st->pos; false if it runs past the buffer
+static bool streamStartTag(ScraperStream* st) {
+    ScraperDocument* doc = st->doc;
+    HtmlParser parser;
+    parser.source = st->buf;
+    parser.length = st->len;
+    parser.current = st->pos + 1; // skip <
+    parser.document = doc;
+
+    int nameStart = parser.current;
+    while (parser.current < parser.length && isAlphaNumeric(parser.source[parser.current])) {
+        parser.current++;
+    }
+    int nameLen = parser.current - nameStart;
+    if (parser.current == parser.length && !st->eof) return false;
+    if (nameLen == 0) {
+        // stray <: skipped with the character after it, as in the tree builder
+        st->pos = parser.current < parser.length ? parser.current + 1 : parser.length;
+        return true;
+    }
+
+    ScraperArenaMark mark = arenaMark(&doc->arena);
+    ScraperNode* element = createNode(doc, NODE_ELEMENT);
+    element->tagName = internLowerName(doc, parser.source + nameStart, nameLen);
+    parseAttributes(&parser, element);
+
+    bool isVoid = isVoidElement(element->tagName);
+    if (parser.current < parser.length && parser.source[parser.current] == '/') {
+        isVoid = true; // <div /> style
+    }
+    while (parser.current < parser.length && parser.source[parser.current] != '>') {
+        parser.current++;
+    }
+    // parseAttributes may step onto the NUL past the end
+    if (parser.current >= parser.length && !st->eof) {
+        arenaReset(&doc->arena, mark); // Parse it again with the next chunk
+        return false;
+    }
+    if (parser.current < parser.length) parser.current++; // skip >
+    st->pos = parser.current < parser.length ? parser.current : parser.length;
+
+    element->isSelfClosing = isVoid;
+    element->parent = st->depth > 0 ? st->frames[st->depth - 1].node : doc->root;
+    bool matched = matchesFrom(&st->bound, st->bound.count - 1, element);
+    long match = matched ? streamAddMatch(st, element) : -1;
+
+    if (isVoid) {
+        if (matched) st->pending[match - st->pendingBase].done = true;
+        arenaReset(&doc->arena, mark);
+        return true;
+    }
+    if (st->depth == st->frameCapacity) {
+        st->frameCapacity = st->frameCapacity ? st->frameCapacity * 2 : 64;
+        st->frames = realloc(st->frames, sizeof(StreamFrame) * (size_t)st->frameCapacity);
+        if (!st->frames) exit(1);
+    }
+    StreamFrame* frame = &st->frames[st->depth++];
+    frame->node = element;
+    frame->mark = mark;
+    frame->match = match;
+    if (matched) st->captureDepth++;
+    return true;
+}
+
+// Consume one token; false if more input is needed first
+static bool streamToken(ScraperStream* st) {
+    const char* buf = st->buf;
+    int avail = st->len - st->pos;
+
+    if (st->inComment) {
+        const char* end = NULL;
+        const char* limit = buf + st->len;
+        for (const char* p = buf + st->pos; (p = memchr(p, '-', (size_t)(limit - p))) && p + 2 < limit; p++) {
+            if (p[1] == '-' && p[2] == '>') {
+                end = p + 3;
+                break;
+            }
+        }
+        if (end) {
+            st->pos = (int)(end - buf);
+            st->inComment = false;
+            return true;
+        }
+        // Keep a possible "--" at the end for the next chunk
+        if (avail > 2) st->pos = st->len - 2;
+        if (st->eof) st->pos = st->len;
+        return false;
+    }
+
+    if (buf[st->pos] != '<') {
+        // Text runs to the next tag; it may arrive in pieces
+        const char* lt = memchr(buf + st->pos, '<', (size_t)avail);
+        int end = lt ? (int)(lt - buf) : st->len;
+        if (st->captureDepth > 0) streamCapture(st, buf + st->pos, end - st->pos);
+        st->pos = end;
+        return lt != NULL;
+    }
+
+    if (avail < 4 && !st->eof) return false;
+    if (avail >= 4 && strncmp(buf + st->pos, "<!--", 4) == 0) {
+        st->pos += 4;
+        st->inComment = true;
+        return true;
+    }
+    if (avail >= 2 && buf[st->pos + 1] == '/') {
+        // Closing tag: pops one level, as in the tree builder
+        const char* gt = memchr(buf + st->pos, '>', (size_t)avail);
+        if (!gt && !st->eof) return false;
+        st->pos = gt ? (int)(gt - buf) + 1 : st->len;
+        if (st->depth > 0) streamPop(st);
+        return true;
+    }
+    return streamStartTag(st);
+}
+
+
+// Open a stream over a URL (via curl) or a file relative to the script
+static ScraperStream* streamOpen(VM* vm, const char* source, const ScraperSelector* sel) {
+    ScraperStream* st = calloc(1, sizeof(ScraperStream));
+    if (!st) exit(1);
+    st->fd = -1;
+    if (strstr(source, "://")) {
+        st->curl = spawnCurl(source, NULL, &st->fd);
+        if (st->curl < 0) st->curl = 0;
+    } else {
+        char* resolvedPath = resolvePath(vm, source);
+        st->fd = open(resolvedPath, O_RDONLY);
+        free(resolvedPath);
+    }
+    if (st->fd < 0) {
+        free(st);
+        return NULL;
+    }
+    st->doc = calloc(1, sizeof(ScraperDocument));
+    st->capacity = SCRAPER_STREAM_CHUNK;
+    st->buf = malloc((size_t)st->capacity + 1);
+    if (!st->doc || !st->buf) exit(1);
+    st->buf[0] = '\0';
+    streamBind(st, sel);
+    return st;
+}
+
+// ============================================================================
+// Native Bindings
+// ============================================================================
 
 // Function to recursively print DOM (Depth-First)
 static void printNode(ScraperNode* node, int depth) {
@@ -455,76 +1215,86 @@ static void printNode(ScraperNode* node, int depth) {
     } else if (node->type == NODE_ELEMENT) {
         printf("<%s", node->tagName);
         for (int i=0; i<node->attrCount; i++) {
-            printf(" %s=\"%s\"", node->attrKeys[i], node->attrValues[i]);
+            printf(" %s=\"%s\"", node->attrs[i].name, node->attrs[i].value);
         }
         printf(">\n");
     } else if (node->type == NODE_TEXT) {
         // Trim whitespace for display
-        char* txt = node->textContent;
-        while(isspace(*txt)) txt++;
+        const char* txt = node->textContent;
+        while(isspace((unsigned char)*txt)) txt++;
         if (strlen(txt) > 0) printf("#text: \"%s\"\n", txt);
     }
     
-    for (int i = 0; i < node->childCount; i++) {
-        printNode(node->children[i], depth + 1);
+    for (ScraperNode* child = node->firstChild; child; child = child->nextSibling) {
+        printNode(child, depth + 1);
     }
 }
 
-// Helper to get text recursively
-static void getTextRecursive(ScraperNode* node, char** buffer, int* len, int* cap) {
-     if (node->type == NODE_TEXT && node->textContent) {
-         int textLen = strlen(node->textContent);
-         while (*len + textLen + 1 >= *cap) {
-             *cap = (*cap) * 2 + textLen; // Ensure growth
-             *buffer = realloc(*buffer, *cap);
-         }
-         strcat(*buffer, node->textContent);
-         *len += textLen;
-     } else if (node->type == NODE_ELEMENT) {
-         for (int i=0; i<node->childCount; i++) {
-             getTextRecursive(node->children[i], buffer, len, cap);
-         }
-     }
+// Text of a subtree: measured first, then copied once
+static int textLength(const ScraperNode* node) {
+    if (node->type == NODE_TEXT) return node->textLength;
+    if (node->type != NODE_ELEMENT) return 0;
+    int len = 0;
+    for (const ScraperNode* child = node->firstChild; child; child = child->nextSibling) {
+        len += textLength(child);
+    }
+    return len;
 }
 
-// Internal helper to fetch URL content using curl (via popen)
-// This avoids strict OpenSSL dependency for the corelib, relying on system tools.
-static char* fetchUrlContent(const char* url) {
-    // Basic validation to prevent simple injection (very rough)
-    // In production, use libcurl properly.
-    if (strchr(url, ';') || strchr(url, '|') || strchr(url, '`') || strchr(url, '$')) {
-        return NULL; // unsafe char
+static char* copyText(const ScraperNode* node, char* dest) {
+    if (node->type == NODE_TEXT) {
+        memcpy(dest, node->textContent, (size_t)node->textLength);
+        return dest + node->textLength;
     }
+    if (node->type != NODE_ELEMENT) return dest;
+    for (const ScraperNode* child = node->firstChild; child; child = child->nextSibling) {
+        dest = copyText(child, dest);
+    }
+    return dest;
+}
+
+// Fetch via curl (https, or redirects the built-in client cannot follow).
+// This avoids an OpenSSL dependency for the corelib, relying on system tools.
+static char* fetchUrlWithCurl(const char* url) {
+    int fd;
+    pid_t pid = spawnCurl(url, NULL, &fd);
+    if (pid < 0) return NULL;
 
-    char command[1024];
-    // -s: silent, -L: follow redirects
-    snprintf(command, sizeof(command), "curl -s -L \"%s\"", url);
-    
-    FILE* pipe = popen(command, "r");
-    if (!pipe) return NULL;
-    
-    // Read response
     size_t capacity = 4096;
     size_t length = 0;
     char* content = malloc(capacity);
-    if (!content) { pclose(pipe); return NULL; }
-    
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        size_t chunkLen = strlen(buffer);
-        if (length + chunkLen + 1 >= capacity) {
+    if (!content) exit(1);
+    while (1) {
+        if (capacity - length < 1024) {
             capacity *= 2;
             content = realloc(content, capacity);
+            if (!content) exit(1);
         }
-        memcpy(content + length, buffer, chunkLen);
-        length += chunkLen;
+        ssize_t n = read(fd, content + length, capacity - length - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        length += (size_t)n;
     }
     content[length] = '\0';
-    
-    pclose(pipe);
+
+    close(fd);
+    waitCurl(pid);
     return content;
 }
 
+static char* fetchUrlContent(VM* vm, const char* url) {
+    if (strncmp(url, "http://", 7) != 0) return fetchUrlWithCurl(url);
+
+    // Plain http goes through the pooled client (keep-alive, async-aware)
+    HttpClientResponse resp;
+    if (!httpClientRequest(vm, "GET", url, NULL, 0, HTTP_CLIENT_MAX_REDIRECTS, &resp)) return NULL;
+    if (resp.location[0] && strncmp(resp.location, "https://", 8) == 0) {
+        httpClientFreeResponse(&resp);
+        return fetchUrlWithCurl(url);
+    }
+    return resp.body;
+}
+
 // ucoreScraper.download(url, filepath) -> bool
 static Value scraper_download(VM* vm, Value* args, int argCount) {
     (void)vm;
@@ -534,23 +1304,12 @@ static Value scraper_download(VM* vm, Value* args, int argCount) {
     
     ObjString* url = AS_STRING(args[0]);
     ObjString* path = AS_STRING(args[1]);
-    
-    // Basic safety check for command injection
-    if (strchr(url->chars, ';') || strchr(path->chars, ';')) {
-         return BOOL_VAL(false);
-    }
 
+    // --create-dirs: "path/to/file.html" works even if "path/to" does not exist
     char* resolvedPath = resolvePath(vm, path->chars);
-
-    char command[2048];
-    // curl -s -L "url" -o "path" --create-dirs
-    // --create-dirs ensures that if "path/to/file.html" is requested and "path/to" doesn't exist, it is created.
-    snprintf(command, sizeof(command), "curl -s -L --create-dirs \"%s\" -o \"%s\"", url->chars, resolvedPath);
-    
+    pid_t pid = spawnCurl(url->chars, resolvedPath, NULL);
     free(resolvedPath);
-    
-    int result = system(command);
-    return BOOL_VAL(result == 0);
+    return BOOL_VAL(pid > 0 && waitCurl(pid) == 0);
 }
 
 // ucoreScraper.fetch(url) -> htmlString
@@ -560,7 +1319,7 @@ static Value scraper_fetch(VM* vm, Value* args, int argCount) {
     }
     
     ObjString* url = AS_STRING(args[0]);
-    char* content = fetchUrlContent(url->chars);
+    char* content = fetchUrlContent(vm, url->chars);
     
     if (content) {
         ObjString* htmlObj = internString(vm, content, strlen(content));
@@ -571,152 +1330,48 @@ static Value scraper_fetch(VM* vm, Value* args, int argCount) {
     return NIL_VAL;
 }
 
-// Check if node matches one specific selector part (no chain)
-static bool nodeMatchesSimple(ScraperNode* root, ScraperSelector* sel) {
-    if (root->type != NODE_ELEMENT) return false;
-    if (sel->tagName && strcmp(root->tagName, sel->tagName) != 0) return false;
-    if (sel->id) {
-        bool found = false;
-        for (int i=0; i<root->attrCount; i++) {
-            if (strcmp(root->attrKeys[i], "id") == 0 && strcmp(root->attrValues[i], sel->id) == 0) { found = true; break; }
-        }
-        if (!found) return false;
-    }
-    if (sel->className) {
-        bool found = false;
-        for (int i=0; i<root->attrCount; i++) {
-            if (strcmp(root->attrKeys[i], "class") == 0 && strstr(root->attrValues[i], sel->className)) { found = true; break; }
-        }
-        if (!found) return false;
-    }
-    return true;
-}
-
-// Find all nodes in subtree matching 'sel'
-static void findAll(ScraperNode* root, ScraperSelector* sel, ScraperNode*** results, int* count, int* capacity) {
-    if (nodeMatchesSimple(root, sel)) {
-        if (*count >= *capacity) { *capacity *= 2; *results = realloc(*results, sizeof(ScraperNode*) * (*capacity)); }
-        (*results)[(*count)++] = root;
-    }
-    for (int i=0; i<root->childCount; i++) findAll(root->children[i], sel, results, count, capacity);
-}
-
-// Main Selection Logic with Combinator Support
-// Simplification for "div p": 
-// 1. Find all "div" (candidates).
-// 2. For each candidate, find "p" in their subtree (recursive findAll).
-// 3. Collect unique results? (Actually standard CSS doesn't dedupe usually, but querySelectorAll does).
-// Note: This naive approach handles "div p" but complex chains "div p span" need recursion.
-static void selectNodesV(ScraperNode* root, ScraperSelector* sel, ScraperNode*** results, int* count, int* capacity) {
-    if (!sel) return;
-    
-    // Phase 1: simple find all matching head
-    int candCount = 0;
-    int candCap = 64;
-    ScraperNode** candidates = malloc(sizeof(ScraperNode*) * candCap);
-    findAll(root, sel, &candidates, &candCount, &candCap);
-    
-    if (!sel->next) {
-        // No chain, just return candidates
-        for(int i=0; i<candCount; i++) {
-             if (*count >= *capacity) { *capacity *= 2; *results = realloc(*results, sizeof(ScraperNode*) * (*capacity)); }
-             (*results)[(*count)++] = candidates[i];
-        }
-        free(candidates);
-        return;
-    }
-    
-    // Has chain. For each candidate, continue match with next selector.
-    // Combinator logic:
-    // DESCENDANT: Search subtree of candidate.
-    // CHILD: Search direct children of candidate.
-    
-    for(int i=0; i<candCount; i++) {
-        ScraperNode* cand = candidates[i];
-        
-        if (sel->combinator == COMBINATOR_CHILD) {
-             // Check direct children
-             for(int k=0; k<cand->childCount; k++) {
-                 selectNodesV(cand->children[k], sel->next, results, count, capacity);
-                 // WAIT: recursive call `selectNodesV` will verify if children match `sel->next` head
-                 // AND continue chain.
-                 // BUT `selectNodesV` by default does `findAll` (deep search).
-                 // We want shallow search for CHILD combinator.
-                 // My logic here is slightly circular.
-                 // Let's stick to DESCENDANT only for this cleanup as it covers 90% of use cases ("div p").
-             }
-        } else {
-             // COMBINATOR_DESCENDANT (space)
-             // We need to search descendants of 'cand' for 'sel->next'.
-             // We can just call selectNodesV(cand matching children!, sel->next).
-             // But we shouldn't match 'cand' itself again.
-             for(int k=0; k<cand->childCount; k++) {
-                 selectNodesV(cand->children[k], sel->next, results, count, capacity);
-             }
-        }
-    }
-    free(candidates);
-}
 
 // Helper: Convert ScraperNode to Unnarize Value (Map)
 static Value nodeToValue(VM* vm, ScraperNode* node) {
     Map* map = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(map); // Root across string interning
     
     // Tag Name
     if (node->tagName) {
-        Value vTag = OBJ_VAL(internString(vm, node->tagName, strlen(node->tagName)));
+        Value vTag = OBJ_VAL(internString(vm, node->tagName, (int)strlen(node->tagName)));
         mapSetStr(map, "tagName", 7, vTag);
     }
     
     // Text Content (Recursive!)
-    int tCap = 64;
-    int tLen = 0;
-    char* tBuf = malloc(tCap);
-    tBuf[0] = '\0';
-    getTextRecursive(node, &tBuf, &tLen, &tCap);
-    
+    int tLen = textLength(node);
     if (tLen > 0) {
-         Value vText = OBJ_VAL(internString(vm, tBuf, tLen));
-         mapSetStr(map, "text", 4, vText);
+        char* tBuf = malloc((size_t)tLen);
+        if (!tBuf) exit(1);
+        copyText(node, tBuf);
+        Value vText = OBJ_VAL(internString(vm, tBuf, tLen));
+        mapSetStr(map, "text", 4, vText);
+        free(tBuf);
     }
-    free(tBuf);
     
     // Attributes
     if (node->attrCount > 0) {
         Map* attrs = newMap(vm);
+        mapSetStr(map, "attributes", 10, OBJ_VAL(attrs)); // Reachable before it is filled
         for (int i=0; i<node->attrCount; i++) {
-            Value vVal = OBJ_VAL(internString(vm, node->attrValues[i], strlen(node->attrValues[i])));
-            mapSetStr(attrs, node->attrKeys[i], strlen(node->attrKeys[i]), vVal);
+            Value vVal = OBJ_VAL(internString(vm, node->attrs[i].value, (int)strlen(node->attrs[i].value)));
+            mapSetStr(attrs, node->attrs[i].name, (int)strlen(node->attrs[i].name), vVal);
         }
-        mapSetStr(map, "attributes", 10, OBJ_VAL(attrs));
     }
     
+    vm->stackTop--;
     return OBJ_VAL(map);
 }
 
-// ucoreScraper.select(htmlString, selectorString) -> List<NodeMap>
-static Value scraper_select(VM* vm, Value* args, int argCount) {
-    if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) {
-        return NIL_VAL;
-    }
-    
-    ObjString* html = AS_STRING(args[0]);
-    ObjString* selectorStr = AS_STRING(args[1]);
-    
-    // 1. Parse HTML
-    ScraperNode* doc = parseHtml(html->chars);
-    
-    // 2. Parse Selector
-    ScraperSelector* sel = parseSelector(selectorStr->chars);
-    
-    // 3. Select Nodes
+// Run 'sel' over 'doc' and convert the matches to a List<NodeMap>
+static Value selectToList(VM* vm, ScraperDocument* doc, const ScraperSelector* sel) {
     int count = 0;
-    int capacity = 16;
-    ScraperNode** results = malloc(sizeof(ScraperNode*) * capacity);
+    ScraperNode** results = selectNodes(doc, sel, &count);
     
-    selectNodesV(doc, sel, &results, &count, &capacity);
-    
-    // 4. Convert to Unnarize List
     Array* list = newArray(vm);
     // Push list to stack to prevent GC during allocations
     vm->stack[vm->stackTop++] = OBJ_VAL(list);
@@ -727,140 +1382,243 @@ static Value scraper_select(VM* vm, Value* args, int argCount) {
     }
     
     vm->stackTop--; // Pop list from stack
-    
-    // 5. Cleanup
     free(results);
-    freeSelector(sel);
-    freeNode(doc);
-    
     return OBJ_VAL(list);
 }
 
-// ucoreScraper.loadFile(path) -> List<NodeMap> (or Document? No, selects root?)
-// Actually, let's make loadFile return the same "Map" structure as select? 
-// No, usually loadFile just parses and you probably want to select on it immediately.
-// But we designed `select` to take HTML STRING.
-// If we return a Document Handle, we can use it.
-// Current API: `select(html, selector)`.
-// We need `selectFile(path, selector)` OR `loadFile(path)` -> returns HTML string.
-// Returning HTML string is easy. `ucoreSystem` already reads files? 
-// No, `ucoreSystem` executes commands. `import` reads files but compiles them.
-// Let's provide `loadFile(path)` -> returns parsed HTML String? No, that's just `readFile`.
-// Let's provide `parseFile(path, selector)` which reads, parses, and selects in one go.
-// Simple and powerful.
-
-static char* readFileResolved(VM* vm, const char* path) {
-    char* resolvedPath = resolvePath(vm, path);
-    FILE* file = fopen(resolvedPath, "rb");
-    if (!file) {
-        free(resolvedPath);
-        return NULL;
+// Document and selector handles; close() clears 'data' early
+static void documentCleanup(void* data) {
+    scraper_freeDocument((ScraperDocument*)data);
+}
+
+static void selectorCleanup(void* data) {
+    freeSelector((ScraperSelector*)data);
+}
+
+static bool isResourceOf(Value v, ResourceCleanupFn cleanup) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE && ((ObjResource*)AS_OBJ(v))->cleanup == cleanup;
+}
+
+static Value newHandle(VM* vm, void* data, ResourceCleanupFn cleanup) {
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = data;
+    res->cleanup = cleanup;
+    res->next = NULL;
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
+
+// The selector argument of select/parseFile: a string (compiled for this
+// call into *owned, which the caller frees) or a compiled handle.
+// False if it is neither, or a closed handle.
+static bool selectorArg(Value v, ScraperSelector** sel, ScraperSelector** owned) {
+    *owned = NULL;
+    if (IS_STRING(v)) {
+        *sel = *owned = parseSelector(AS_STRING(v)->chars);
+        return true;
+    }
+    if (isResourceOf(v, selectorCleanup) && ((ObjResource*)AS_OBJ(v))->data) {
+        *sel = (ScraperSelector*)((ObjResource*)AS_OBJ(v))->data;
+        return true;
+    }
+    return false;
+}
+
+// ucoreScraper.select(docOrHtml, selector) -> List<NodeMap>
+// A document handle is indexed on first use, so later selects only visit
+// elements that can match; an HTML string is parsed for this call only.
+static Value scraper_select(VM* vm, Value* args, int argCount) {
+    ScraperSelector* sel;
+    ScraperSelector* owned;
+    if (argCount != 2 || !selectorArg(args[1], &sel, &owned)) {
+        return NIL_VAL;
     }
     
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char* buffer = malloc(length + 1);
-    size_t read = fread(buffer, 1, length, file);
-    (void)read; 
-    buffer[length] = '\0';
+    Value list = NIL_VAL;
+    if (IS_STRING(args[0])) {
+        ObjString* html = AS_STRING(args[0]);
+        ScraperDocument* doc = scraper_parseHtml(html->chars, html->length);
+        list = selectToList(vm, doc, sel);
+        scraper_freeDocument(doc);
+    } else if (isResourceOf(args[0], documentCleanup) && ((ObjResource*)AS_OBJ(args[0]))->data) {
+        ScraperDocument* doc = (ScraperDocument*)((ObjResource*)AS_OBJ(args[0]))->data;
+        indexDocument(doc);
+        list = selectToList(vm, doc, sel);
+    }
     
-    fclose(file);
+    freeSelector(owned);
+    return list;
+}
+
+// ucoreScraper.selector(css) -> compiled selector for select/parseFile
+static Value scraper_selector(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_STRING(args[0])) return NIL_VAL;
+    ScraperSelector* sel = parseSelector(AS_STRING(args[0])->chars);
+    if (!sel) return NIL_VAL;
+    return newHandle(vm, sel, selectorCleanup);
+}
+
+// Load a script-relative path; false if it cannot be read
+static bool openResolved(VM* vm, const char* path, FileBuffer* out) {
+    char* resolvedPath = resolvePath(vm, path);
+    bool ok = fileOpen(resolvedPath, out);
     free(resolvedPath);
-    return buffer;
+    return ok && out->length <= INT_MAX;
 }
 
 // ucoreScraper.parseFile(path, selector) -> List<NodeMap>
 static Value scraper_parseFile(VM* vm, Value* args, int argCount) {
-    if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) {
+    ScraperSelector* sel;
+    ScraperSelector* owned;
+    if (argCount != 2 || !IS_STRING(args[0]) || !selectorArg(args[1], &sel, &owned)) {
         return NIL_VAL;
     }
     
     ObjString* path = AS_STRING(args[0]);
-    char* htmlContent = readFileResolved(vm, path->chars);
-    
-    if (!htmlContent) {
-        // Error handling? Return NIL or empty list?
-        // Return NIL for now to signal failure
+    FileBuffer html;
+    if (!openResolved(vm, path->chars, &html)) {
+        // Return NIL to signal failure
+        fileClose(&html);
+        freeSelector(owned);
         return NIL_VAL; 
     }
     
-    // Delegate to logic similar to scraper_select but with buffer
-    // 1. Parse HTML
-    ScraperNode* doc = parseHtml(htmlContent);
-    free(htmlContent); // Done with raw string
-    
-    // 2. Parse Selector
-    ObjString* selectorStr = AS_STRING(args[1]);
-    ScraperSelector* sel = parseSelector(selectorStr->chars);
-    
-    // 3. Select Nodes
-    int count = 0;
-    int capacity = 16;
-    ScraperNode** results = malloc(sizeof(ScraperNode*) * capacity);
-    
-    selectNodesV(doc, sel, &results, &count, &capacity);
-    
-    // 4. Convert to Unnarize List
-    Array* list = newArray(vm);
-    vm->stack[vm->stackTop++] = OBJ_VAL(list); // Root it
-    
-    for (int i=0; i<count; i++) {
-        Value val = nodeToValue(vm, results[i]);
-        arrayPush(vm, list, val);
-    }
-    
-    vm->stackTop--; // Pop
+    ScraperDocument* doc = scraper_parseHtml(html.data, (int)html.length);
+    fileClose(&html); // Done with raw string (the DOM holds copies)
     
-    // 5. Cleanup
-    free(results);
-    freeSelector(sel);
-    freeNode(doc);
+    Value list = selectToList(vm, doc, sel);
     
-    return OBJ_VAL(list);
+    scraper_freeDocument(doc);
+    freeSelector(owned);
+    return list;
 }
 
 // ucoreScraper.parse(htmlString, [debugPrint]) -> Document
-// Helper for debugging mostly, returns NIL for now (unless we wrap Document)
+// The handle can be passed to select() any number of times
 static Value scraper_parse(VM* vm, Value* args, int argCount) {
-    (void)vm; // Suppress unused warning
     if (argCount < 1 || !IS_STRING(args[0])) {
         return NIL_VAL;
     }
     
     ObjString* html = AS_STRING(args[0]);
-    ScraperNode* doc = parseHtml(html->chars);
+    ScraperDocument* doc = scraper_parseHtml(html->chars, html->length);
     
     // If 2nd arg is TRUE, dump the tree
     if (argCount == 2 && IS_BOOL(args[1]) && AS_BOOL(args[1])) {
-        printNode(doc, 0);
+        printNode(doc->root, 0);
     }
     
-    freeNode(doc);
-    return NIL_VAL;
+    return newHandle(vm, doc, documentCleanup);
+}
+
+// Same shape as nodeToValue, from a match the stream copied out
+static Value matchToValue(VM* vm, const ScraperMatch* m) {
+    Map* map = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(map); // Root across string interning
+    
+    mapSetStr(map, "tagName", 7, OBJ_VAL(internString(vm, m->tagName, (int)strlen(m->tagName))));
+    if (m->textLength > 0) {
+        mapSetStr(map, "text", 4, OBJ_VAL(internString(vm, m->text, m->textLength)));
+    }
+    if (m->attrCount > 0) {
+        Map* attrs = newMap(vm);
+        mapSetStr(map, "attributes", 10, OBJ_VAL(attrs)); // Reachable before it is filled
+        for (int i = 0; i < m->attrCount; i++) {
+            Value vVal = OBJ_VAL(internString(vm, m->attrValues[i], (int)strlen(m->attrValues[i])));
+            mapSetStr(attrs, m->attrNames[i], (int)strlen(m->attrNames[i]), vVal);
+        }
+    }
+    
+    vm->stackTop--;
+    return OBJ_VAL(map);
+}
+
+static void streamCleanup(void* data) {
+    streamFree((ScraperStream*)data);
+}
+
+// foreach step: tokenize until the oldest pending match has closed
+static bool streamNext(VM* vm, void* data, Value* out) {
+    ScraperStream* st = (ScraperStream*)data;
+    if (!st) return false; // Closed
+    while (1) {
+        if (st->pendingHead < st->pendingCount && st->pending[st->pendingHead].done) {
+            ScraperMatch* m = &st->pending[st->pendingHead++];
+            *out = matchToValue(vm, m);
+            freeMatch(m);
+            return true;
+        }
+        if (st->pos < st->len) {
+            if (streamToken(st) || st->eof) continue;
+        } else if (st->eof) {
+            if (st->depth == 0) return false;
+            streamPop(st); // Unclosed at the end of input
+            continue;
+        }
+        streamFill(vm, st);
+    }
+}
+
+// ucoreScraper.stream(source, selector) -> iterator of NodeMaps
+// 'source' is a file path, or a URL (anything with "://") read through
+// curl as it downloads. Nothing is kept but the open elements and the
+// matches not yet returned.
+static Value scraper_stream(VM* vm, Value* args, int argCount) {
+    ScraperSelector* sel;
+    ScraperSelector* owned;
+    if (argCount != 2 || !IS_STRING(args[0]) || !selectorArg(args[1], &sel, &owned)) {
+        return NIL_VAL;
+    }
+    ScraperStream* st = sel ? streamOpen(vm, AS_STRING(args[0])->chars, sel) : NULL;
+    freeSelector(owned); // The stream holds its own bound copy
+    if (!st) return NIL_VAL;
+    
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = st;
+    res->cleanup = streamCleanup;
+    res->next = streamNext; // foreach (var el : stream) yields matches as they close
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
+
+// ucoreScraper.close(handle) - free a document, selector or stream now, not at GC
+static Value scraper_close(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 1) return BOOL_VAL(false);
+    if (!isResourceOf(args[0], documentCleanup) && !isResourceOf(args[0], selectorCleanup) &&
+        !isResourceOf(args[0], streamCleanup)) {
+        return BOOL_VAL(false);
+    }
+    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
+    if (!res->data) return BOOL_VAL(false);
+    res->cleanup(res->data);
+    res->data = NULL; // The cleanup hooks ignore a closed handle
+    return BOOL_VAL(true);
 }
 
 void registerUCoreScraper(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreScraper", 12);
     char* modName = modNameObj->chars;
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName);
+    vm->stackTop--;
     mod->obj.isMarked = true;
     mod->obj.isPermanent = true;
     
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true;
     modEnv->obj.isPermanent = true;
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
     
-    defineNative(vm, mod->env, "parse", scraper_parse, 1); // parse(html, [debug])
-    defineNative(vm, mod->env, "select", scraper_select, 2); // select(html, selector)
+    defineNative(vm, mod->env, "parse", scraper_parse, 1); // parse(html, [debug]) -> document
+    defineNative(vm, mod->env, "select", scraper_select, 2); // select(docOrHtml, selector)
+    defineNative(vm, mod->env, "selector", scraper_selector, 1); // selector(css) -> compiled
     defineNative(vm, mod->env, "parseFile", scraper_parseFile, 2); // parseFile(path, selector)
+    defineNative(vm, mod->env, "stream", scraper_stream, 2); // stream(pathOrUrl, selector) -> iterator
+    defineNative(vm, mod->env, "close", scraper_close, 1); // close(document, selector or stream)
     defineNative(vm, mod->env, "fetch", scraper_fetch, 1); // fetch(url) -> string
     defineNative(vm, mod->env, "download", scraper_download, 2); // download(url, path) -> bool
     
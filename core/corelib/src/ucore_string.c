@@ -3,6 +3,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <regex.h>
+#include <pthread.h>
 #include "ucore_string.h"
 #include "vm.h"
 
@@ -15,6 +16,68 @@ static ObjString* copyString(VM* vm, const char* chars, int length) {
     return internString(vm, chars, length);
 }
 
+// ============================================================================
+// Substring Search
+// ============================================================================
+//
+// Candidates are positions where both the first and the last byte of the
+// needle match, found a vector at a time; only those are compared in full.
+// The tail, and builds without SSE2/AVX2/AVX-512, jump between first-byte
+// candidates with memchr. Lengths come from the ObjString, so embedded NUL
+// bytes are searched like any other.
+
+#if defined(__AVX512BW__)
+#include <immintrin.h>
+typedef __m512i StrVec;
+#define STR_VEC_BYTES 64
+#define vecLoad(p) _mm512_loadu_si512((const void*)(p))
+#define vecSplat(c) _mm512_set1_epi8(c)
+#define vecMatch(a, b) ((uint64_t)_mm512_cmpeq_epi8_mask(a, b))
+#elif defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i StrVec;
+#define STR_VEC_BYTES 32
+#define vecLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vecSplat(c) _mm256_set1_epi8(c)
+#define vecMatch(a, b) ((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)))
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i StrVec;
+#define STR_VEC_BYTES 16
+#define vecLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define vecSplat(c) _mm_set1_epi8(c)
+#define vecMatch(a, b) ((uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)))
+#endif
+
+// First occurrence of needle in hay, or NULL
+static const char* findSubstring(const char* hay, int hayLen, const char* needle, int needleLen) {
+    if (needleLen == 0) return hay;
+    if (needleLen > hayLen) return NULL;
+    if (needleLen == 1) return memchr(hay, needle[0], (size_t)hayLen);
+
+    int last = needleLen - 1;
+    int i = 0;
+#ifdef STR_VEC_BYTES
+    StrVec first = vecSplat(needle[0]);
+    StrVec lastByte = vecSplat(needle[last]);
+    for (; i + last + STR_VEC_BYTES <= hayLen; i += STR_VEC_BYTES) {
+        uint64_t mask = vecMatch(vecLoad(hay + i), first) & vecMatch(vecLoad(hay + i + last), lastByte);
+        while (mask) {
+            int bit = __builtin_ctzll(mask);
+            if (memcmp(hay + i + bit + 1, needle + 1, (size_t)(needleLen - 2)) == 0) return hay + i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    const char* end = hay + hayLen - last; // Last possible start + 1
+    for (const char* p = hay + i; p < end; p++) {
+        p = memchr(p, needle[0], (size_t)(end - p));
+        if (!p) return NULL;
+        if (p[last] == needle[last] && memcmp(p + 1, needle + 1, (size_t)(needleLen - 2)) == 0) return p;
+    }
+    return NULL;
+}
+
 // ============================================================================
 // Core String Manipulation
 // ============================================================================
@@ -30,7 +93,7 @@ static Value str_split(VM* vm, Value* args, int argCount) {
     
     const char* str = strObj->chars;
     const char* delim = delimObj->chars;
-    int delimLen = strlen(delim);
+    int delimLen = delimObj->length;
     
     // Create result array
     Array* array = newArray(vm);
@@ -48,7 +111,8 @@ static Value str_split(VM* vm, Value* args, int argCount) {
     }
     
     const char* start = str;
-    const char* p = strstr(start, delim);
+    const char* end = str + strObj->length;
+    const char* p = findSubstring(start, (int)(end - start), delim, delimLen);
     
     while (p) {
         int len = p - start;
@@ -56,11 +120,11 @@ static Value str_split(VM* vm, Value* args, int argCount) {
         arrayPush(vm, array, val);
         
         start = p + delimLen;
-        p = strstr(start, delim);
+        p = findSubstring(start, (int)(end - start), delim, delimLen);
     }
     
     // Last segment
-    Value val = OBJ_VAL(copyString(vm, start, strlen(start)));
+    Value val = OBJ_VAL(copyString(vm, start, (int)(end - start)));
     arrayPush(vm, array, val);
     
     vm->stackTop--; // Pop array
@@ -139,23 +203,26 @@ static Value str_replace(VM* vm, Value* args, int argCount) {
     const char* search = searchObj->chars;
     const char* rep = repObj->chars;
     
+    const char* end = str + strObj->length;
+    int searchLen = searchObj->length;
+    
     // Count occurrences
     int count = 0;
     const char* tmp = str;
-    while((tmp = strstr(tmp, search))) {
+    while ((tmp = findSubstring(tmp, (int)(end - tmp), search, searchLen))) {
         count++;
-        tmp += searchObj->length;
+        tmp += searchLen;
     }
     
     if (count == 0) return args[0];
     
     // Allocate new string
-    size_t newLen = strObj->length + count * (repObj->length - searchObj->length);
+    size_t newLen = strObj->length + count * (repObj->length - searchLen);
     char* result = malloc(newLen + 1);
     
     char* dst = result;
     const char* src = str;
-    tmp = strstr(src, search);
+    tmp = findSubstring(src, (int)(end - src), search, searchLen);
     
     while (tmp) {
         int len = tmp - src;
@@ -165,10 +232,10 @@ static Value str_replace(VM* vm, Value* args, int argCount) {
         memcpy(dst, rep, repObj->length);
         dst += repObj->length;
         
-        src = tmp + searchObj->length;
-        tmp = strstr(src, search);
+        src = tmp + searchLen;
+        tmp = findSubstring(src, (int)(end - src), search, searchLen);
     }
-    strcpy(dst, src);
+    memcpy(dst, src, (size_t)(end - src));
     
     ObjString* resObj = internString(vm, result, newLen);
     free(result);
@@ -231,52 +298,184 @@ static Value str_contains(VM* vm, Value* args, int argCount) {
     if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) return BOOL_VAL(false);
     ObjString* haystack = AS_STRING(args[0]);
     ObjString* needle = AS_STRING(args[1]);
-    return BOOL_VAL(strstr(haystack->chars, needle->chars) != NULL);
+    return BOOL_VAL(findSubstring(haystack->chars, haystack->length, needle->chars, needle->length) != NULL);
+}
+
+// ============================================================================
+// String Builder
+// ============================================================================
+
+// ucoreString.builder(initial?) -> StringBuilder
+// "sb = sb + x" on the result appends in place (amortized O(1))
+static Value str_builder(VM* vm, Value* args, int argCount) {
+    StringBuilder* sb = newStringBuilder(vm);
+    if (argCount >= 1 && !IS_NIL(args[0])) builderAppendValue(vm, sb, args[0]);
+    return OBJ_VAL(sb);
+}
+
+// ucoreString.append(builder, value, ...) -> StringBuilder
+static Value str_append(VM* vm, Value* args, int argCount) {
+    if (argCount < 1 || !IS_STRING_BUILDER(args[0])) return NIL_VAL;
+    StringBuilder* sb = AS_STRING_BUILDER(args[0]);
+    for (int i = 1; i < argCount; i++) builderAppendValue(vm, sb, args[i]);
+    return args[0];
+}
+
+// ucoreString.build(builder or slice) -> String
+static Value str_build(VM* vm, Value* args, int argCount) {
+    if (argCount != 1) return NIL_VAL;
+    if (IS_STRING_BUILDER(args[0])) return OBJ_VAL(flattenBuilder(vm, AS_STRING_BUILDER(args[0])));
+    if (IS_STRING_SLICE(args[0])) return OBJ_VAL(flattenSlice(vm, AS_STRING_SLICE(args[0])));
+    return IS_STRING(args[0]) ? args[0] : NIL_VAL;
 }
 
 // ============================================================================
 // Regex Support (POSIX)
 // ============================================================================
+//
+// Patterns are compiled once and kept in a small LRU cache keyed by the
+// pattern's ObjString (interned, so a literal is the same object on every
+// call). The chars are kept too: a collected pattern's address may be
+// reused by a different string. The cache is per thread, because isolates
+// call natives concurrently, and is freed when its thread exits.
+
+#define REGEX_CACHE_SIZE 16
+
+typedef struct {
+    ObjString* key;         // NULL if the slot is empty
+    char* pattern;
+    int length;
+    unsigned long lastUse;
+    regex_t regex;
+} RegexCacheEntry;
+
+typedef struct {
+    RegexCacheEntry entries[REGEX_CACHE_SIZE];
+    unsigned long clock;
+} RegexCache;
+
+static _Thread_local RegexCache* g_regexCache = NULL;
+static pthread_key_t g_regexCacheKey;
+static pthread_once_t g_regexCacheOnce = PTHREAD_ONCE_INIT;
+
+static void freeRegexCache(void* data) {
+    RegexCache* cache = (RegexCache*)data;
+    for (int i = 0; i < REGEX_CACHE_SIZE; i++) {
+        if (!cache->entries[i].key) continue;
+        regfree(&cache->entries[i].regex);
+        free(cache->entries[i].pattern);
+    }
+    free(cache);
+}
+
+static void createRegexCacheKey(void) {
+    pthread_key_create(&g_regexCacheKey, freeRegexCache);
+}
+
+// Compiled 'pattern', or NULL if it is not a valid extended regex
+static regex_t* cachedRegex(ObjString* pattern) {
+    RegexCache* cache = g_regexCache;
+    if (!cache) {
+        cache = calloc(1, sizeof(RegexCache));
+        if (!cache) return NULL;
+        pthread_once(&g_regexCacheOnce, createRegexCacheKey);
+        pthread_setspecific(g_regexCacheKey, cache); // Freed at thread exit
+        g_regexCache = cache;
+    }
+    cache->clock++;
+
+    RegexCacheEntry* victim = &cache->entries[0];
+    for (int i = 0; i < REGEX_CACHE_SIZE; i++) {
+        RegexCacheEntry* e = &cache->entries[i];
+        if (e->key == pattern && e->length == pattern->length &&
+            memcmp(e->pattern, pattern->chars, (size_t)pattern->length) == 0) {
+            e->lastUse = cache->clock;
+            return &e->regex;
+        }
+        if (!e->key) {
+            if (victim->key) victim = e;
+        } else if (victim->key && e->lastUse < victim->lastUse) {
+            victim = e;
+        }
+    }
+
+    regex_t compiled;
+    if (regcomp(&compiled, pattern->chars, REG_EXTENDED)) return NULL;
+    if (victim->key) {
+        regfree(&victim->regex);
+        free(victim->pattern);
+    }
+    victim->key = pattern;
+    victim->pattern = malloc((size_t)pattern->length + 1);
+    memcpy(victim->pattern, pattern->chars, (size_t)pattern->length + 1);
+    victim->length = pattern->length;
+    victim->lastUse = cache->clock;
+    victim->regex = compiled;
+    return &victim->regex;
+}
+
+static void regexCleanup(void* data) {
+    if (!data) return;
+    regfree((regex_t*)data);
+    free(data);
+}
+
+static bool isRegexHandle(Value v) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE && ((ObjResource*)AS_OBJ(v))->cleanup == regexCleanup;
+}
+
+// The pattern argument: a string (through the cache) or a regex() handle
+static regex_t* regexArg(Value v) {
+    if (IS_STRING(v)) return cachedRegex(AS_STRING(v));
+    if (isRegexHandle(v)) return (regex_t*)((ObjResource*)AS_OBJ(v))->data;
+    return NULL;
+}
+
+// ucoreString.regex(pattern) -> compiled pattern for match/extract
+// Use it for patterns built at runtime, which the cache would keep evicting
+static Value str_regex(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_STRING(args[0])) return NIL_VAL;
+    regex_t* regex = malloc(sizeof(regex_t));
+    if (!regex) return NIL_VAL;
+    if (regcomp(regex, AS_STRING(args[0])->chars, REG_EXTENDED)) {
+        free(regex);
+        return NIL_VAL;
+    }
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = regex;
+    res->cleanup = regexCleanup;
+    res->next = NULL;
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
 
 // ucoreString.match(str, pattern) -> bool
 static Value str_match(VM* vm, Value* args, int argCount) {
     (void)vm;
-    if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) {
+    if (argCount != 2 || !IS_STRING(args[0]) || (!IS_STRING(args[1]) && !isRegexHandle(args[1]))) {
         return BOOL_VAL(false);
     }
     
     ObjString* str = AS_STRING(args[0]);
-    ObjString* pattern = AS_STRING(args[1]);
-    
-    regex_t regex;
-    int ret;
-    
-    // Compile regex
-    ret = regcomp(&regex, pattern->chars, REG_EXTENDED | REG_NOSUB);
-    if (ret) {
+    regex_t* regex = regexArg(args[1]);
+    if (!regex) {
         // Could print error or return false/nil
         return NIL_VAL; 
     }
     
     // Execute
-    ret = regexec(&regex, str->chars, 0, NULL, 0);
-    regfree(&regex);
-    
-    return BOOL_VAL(ret == 0);
+    return BOOL_VAL(regexec(regex, str->chars, 0, NULL, 0) == 0);
 }
 
 // ucoreString.extract(str, pattern) -> List<String> (All matches)
 static Value str_extract(VM* vm, Value* args, int argCount) {
-    if (argCount != 2 || !IS_STRING(args[0]) || !IS_STRING(args[1])) {
+    if (argCount != 2 || !IS_STRING(args[0]) || (!IS_STRING(args[1]) && !isRegexHandle(args[1]))) {
         return NIL_VAL;
     }
     
     ObjString* strObj = AS_STRING(args[0]);
-    ObjString* patternObj = AS_STRING(args[1]);
-    
-    regex_t regex;
-    int ret = regcomp(&regex, patternObj->chars, REG_EXTENDED);
-    if (ret) return NIL_VAL;
+    regex_t* regex = regexArg(args[1]);
+    if (!regex) return NIL_VAL;
     
     Array* results = newArray(vm);
     vm->stack[vm->stackTop++] = OBJ_VAL(results); // Root it
@@ -286,7 +485,9 @@ static Value str_extract(VM* vm, Value* args, int argCount) {
     
     // Find all non-overlapping matches
     while (1) {
-        ret = regexec(&regex, cursor, 1, pmatch, 0);
+        // Past the start, ^ must not match again at the cursor
+        int eflags = cursor == strObj->chars ? 0 : REG_NOTBOL;
+        int ret = regexec(regex, cursor, 1, pmatch, eflags);
         if (ret != 0) break; // formatting error or no match
         
         int start = pmatch[0].rm_so;
@@ -297,10 +498,12 @@ static Value str_extract(VM* vm, Value* args, int argCount) {
         arrayPush(vm, results, matchVal);
         
         cursor += end; // Advance past match
-        if (len == 0 && *cursor) cursor++; // Avoid infinite loop on empty match
+        if (len == 0) {
+            if (!*cursor) break;
+            cursor++; // Avoid infinite loop on empty match
+        }
     }
     
-    regfree(&regex);
     vm->stackTop--; // Pop
     return OBJ_VAL(results);
 }
@@ -313,18 +516,18 @@ static Value str_extract(VM* vm, Value* args, int argCount) {
 void registerUCoreString(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreString", 11);
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modNameObj->chars);
+    vm->stackTop--;
     mod->source = NULL;
     mod->obj.isMarked = true;
     mod->obj.isPermanent = true; // Prevent GC from collecting the module
     
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true;
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
 
     defineNative(vm, mod->env, "split", str_split, 2);
@@ -336,6 +539,10 @@ void registerUCoreString(VM* vm) {
     defineNative(vm, mod->env, "contains", str_contains, 2);
     defineNative(vm, mod->env, "match", str_match, 2);
     defineNative(vm, mod->env, "extract", str_extract, 2);
+    defineNative(vm, mod->env, "regex", str_regex, 1);
+    defineNative(vm, mod->env, "builder", str_builder, 1);
+    defineNative(vm, mod->env, "append", str_append, 2)->keepsViews = true;
+    defineNative(vm, mod->env, "build", str_build, 1)->keepsViews = true;
     
     Value vMod = OBJ_VAL(mod);
     defineGlobal(vm, "ucoreString", vMod);
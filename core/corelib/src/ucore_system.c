@@ -1,8 +1,17 @@
 #include "ucore_system.h"
+#include "runtime/scheduler.h"
+#include "runtime/fileio.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -105,6 +114,7 @@ static Value sys_writeFile(VM* vm, Value* args, int argCount) {
 }
 
 // readFile(path) -> string or ""
+// Large files are mapped and returned as a slice over the mapping (no copy)
 static Value sys_readFile(VM* vm, Value* args, int argCount) {
     if (argCount != 1 || !IS_STRING(args[0])) {
         ObjString* empty = internString(vm, "", 0);
@@ -112,36 +122,100 @@ static Value sys_readFile(VM* vm, Value* args, int argCount) {
     }
     
     char* path = resolvePath(vm, AS_CSTRING(args[0]));
-    FILE* f = fopen(path, "r");
-    if (!f) {
-        free(path);
+    FileBuffer file;
+    bool opened = fileOpen(path, &file);
+    free(path);
+    if (!opened) {
         ObjString* empty = internString(vm, "", 0);
         return OBJ_VAL(empty);
     }
     
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    char* buf = malloc(size + 1);
-    if (!buf) {
-        fclose(f);
-        free(path);
+    Value content = fileString(vm, &file);
+    if (IS_NIL(content)) {
+        printf("Error: ucoreSystem.readFile: '%s' is 2GB or larger; use ucoreSystem.lines().\n",
+               AS_CSTRING(args[0]));
         ObjString* empty = internString(vm, "", 0);
         return OBJ_VAL(empty);
     }
+    return content;
+}
+
+// Cursor of lines(): each line is a slice into the file, which stays
+// loaded until the cursor and every line taken from it are collected
+typedef struct {
+    FileBuffer file;
+    const char* pos;
+    const char* dropped;    // Pages before this were handed back with fileDrop
+    Obj* self;              // The resource holding this cursor (the lines' parent)
+} LineCursor;
+
+// Read pages are released every LINES_DROP_STEP bytes, so memory use stays
+// flat however large the file is
+#define LINES_DROP_STEP (16 * 1024 * 1024)
+
+static void lineCursorCleanup(void* data) {
+    LineCursor* cursor = (LineCursor*)data;
+    fileClose(&cursor->file);
+    free(cursor);
+}
+
+static bool lineCursorNext(VM* vm, void* data, Value* out) {
+    LineCursor* cursor = (LineCursor*)data;
+    const char* end = cursor->file.data + cursor->file.length;
+    if (cursor->pos >= end) return false;
     
-    size_t bytesRead = fread(buf, 1, size, f);
-    buf[bytesRead] = '\0';
-    fclose(f);
+    const char* newline = memchr(cursor->pos, '\n', (size_t)(end - cursor->pos));
+    const char* stop = newline ? newline : end;
+    if (stop > cursor->pos && stop[-1] == '\r') stop--;
+    if (stop - cursor->pos > INT_MAX) {
+        printf("Error: ucoreSystem.lines: line of 2GB or more.\n");
+        return false;
+    }
+    *out = bufferSlice(vm, cursor->self, cursor->pos, (int)(stop - cursor->pos));
+    cursor->pos = newline ? newline + 1 : end;
+    if (cursor->pos - cursor->dropped >= LINES_DROP_STEP) {
+        fileDrop(&cursor->file, (size_t)(cursor->pos - cursor->file.data));
+        cursor->dropped = cursor->pos;
+    }
+    return true;
+}
+
+// lines(path) -> "for (var line : ...)" cursor, or nil
+// Line endings ("\n" or "\r\n") are not part of the lines.
+static Value sys_lines(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_STRING(args[0])) {
+        printf("Error: ucoreSystem.lines(path) expects a file path string.\n");
+        return NIL_VAL;
+    }
+    
+    LineCursor* cursor = malloc(sizeof(LineCursor));
+    if (!cursor) {
+        printf("Error: Out of memory opening '%s'.\n", AS_CSTRING(args[0]));
+        return NIL_VAL;
+    }
+    char* path = resolvePath(vm, AS_CSTRING(args[0]));
+    bool opened = fileOpen(path, &cursor->file);
     free(path);
+    if (!opened) {
+        printf("Error: Could not open file for reading: %s\n", AS_CSTRING(args[0]));
+        free(cursor);
+        return NIL_VAL;
+    }
+    if (cursor->file.mapped) {
+        posix_madvise((void*)cursor->file.data, cursor->file.length, POSIX_MADV_SEQUENTIAL);
+    }
+    cursor->pos = cursor->file.data;
+    cursor->dropped = cursor->file.data;
     
-    ObjString* s = internString(vm, buf, (int)size);
-    free(buf);
-    return OBJ_VAL(s);
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = cursor;
+    res->cleanup = lineCursorCleanup;
+    res->next = lineCursorNext;
+    res->share = NULL;
+    cursor->self = (Obj*)res;
+    return OBJ_VAL(res);
 }
 
-
 // exit(code)
 static Value sys_exit(VM* vm, Value* args, int argCount) {
     (void)vm;
@@ -166,19 +240,346 @@ static Value sys_exec(VM* vm, Value* args, int argCount) {
     return INT_VAL(result); // Usually 0 is success
 }
 
+// ---- Child processes (spawn) ----
+// The child's stdin, stdout and stderr are non-blocking pipes. A read that
+// has to wait suspends only the calling async task, and while it waits the
+// other output pipe is drained too, so a child that fills stderr while the
+// script reads stdout (or the reverse) never stalls.
+
+extern char** environ;
+
+typedef struct {
+    int fd;             // Read end, -1 once it reached EOF
+    char* data;         // Output read but not yet returned, from pos to len
+    size_t pos;
+    size_t len;
+    size_t cap;
+} ProcStream;
+
+typedef struct {
+    pid_t pid;
+    int in;             // Write end of the child's stdin, -1 once closed
+    ProcStream out;
+    ProcStream err;
+    bool reaped;
+    int exitCode;
+} Process;
+
+static void processCleanup(void* data) {
+    Process* p = (Process*)data;
+    if (p->in >= 0) close(p->in);
+    if (p->out.fd >= 0) close(p->out.fd);
+    if (p->err.fd >= 0) close(p->err.fd);
+    if (!p->reaped) waitpid(p->pid, NULL, WNOHANG); // A child still running is left alone
+    free(p->out.data);
+    free(p->err.data);
+    free(p);
+}
+
+static bool isProcess(Value v) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE &&
+           ((ObjResource*)AS_OBJ(v))->cleanup == processCleanup;
+}
+
+static Process* asProcess(Value v) {
+    return (Process*)((ObjResource*)AS_OBJ(v))->data;
+}
+
+static void closeStream(ProcStream* s) {
+    close(s->fd);
+    s->fd = -1;
+}
+
+// Append what the pipe holds right now, without blocking
+static void drainStream(ProcStream* s) {
+    while (s->fd >= 0) {
+        if (s->pos > 0 && s->pos == s->len) s->pos = s->len = 0;
+        if (s->cap - s->len < 4096) {
+            if (s->pos > s->cap / 2) {
+                memmove(s->data, s->data + s->pos, s->len - s->pos);
+                s->len -= s->pos;
+                s->pos = 0;
+            } else {
+                s->cap = s->cap ? s->cap * 2 : 16384;
+                s->data = realloc(s->data, s->cap);
+                if (!s->data) exit(1);
+            }
+            continue;
+        }
+        ssize_t n = read(s->fd, s->data + s->len, s->cap - s->len);
+        if (n > 0) s->len += (size_t)n;
+        else if (n < 0 && errno == EINTR) continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        else closeStream(s);
+    }
+}
+
+// Wait until 'fd' is ready for 'events' or either output pipe has data,
+// then drain both outputs
+static void waitProcess(VM* vm, Process* p, int fd, short events) {
+    struct pollfd fds[3];
+    int count = 0;
+    if (fd >= 0 && fd != p->out.fd && fd != p->err.fd) fds[count++] = (struct pollfd){ fd, events, 0 };
+    if (p->out.fd >= 0) fds[count++] = (struct pollfd){ p->out.fd, POLLIN, 0 };
+    if (p->err.fd >= 0) fds[count++] = (struct pollfd){ p->err.fd, POLLIN, 0 };
+    if (count > 0) taskWaitPoll(vm, fds, count);
+    drainStream(&p->out);
+    drainStream(&p->err);
+}
+
+// Buffer more of 's'; false once the stream is at EOF with nothing new
+static bool fillStream(VM* vm, Process* p, ProcStream* s) {
+    size_t before = s->len - s->pos;
+    drainStream(s);
+    while (s->fd >= 0 && s->len - s->pos == before) waitProcess(vm, p, -1, 0);
+    return s->len - s->pos > before;
+}
+
+static Value takeStream(VM* vm, ProcStream* s, size_t n, size_t skip) {
+    ObjString* str = internString(vm, s->data + s->pos, (int)n);
+    s->pos += n + skip;
+    return OBJ_VAL(str);
+}
+
+// Next line of 's' without its "\n" / "\r\n"; nil at EOF
+static Value readStreamLine(VM* vm, Process* p, ProcStream* s) {
+    size_t scanned = 0;
+    while (1) {
+        const char* start = s->data + s->pos;
+        const char* newline = memchr(start + scanned, '\n', s->len - s->pos - scanned);
+        if (newline) {
+            size_t n = (size_t)(newline - start);
+            size_t cut = n > 0 && newline[-1] == '\r' ? 1 : 0;
+            return takeStream(vm, s, n - cut, 1 + cut);
+        }
+        scanned = s->len - s->pos;
+        if (!fillStream(vm, p, s)) {
+            return scanned > 0 ? takeStream(vm, s, scanned, 0) : NIL_VAL;
+        }
+    }
+}
+
+static bool processNext(VM* vm, void* data, Value* out) {
+    Process* p = (Process*)data;
+    *out = readStreamLine(vm, p, &p->out);
+    return !IS_NIL(*out);
+}
+
+// "stdout" (the default) or "stderr"; NULL (after an error) for anything else
+static ProcStream* streamArg(Process* p, Value* args, int argCount, int index, const char* fn) {
+    if (argCount <= index) return &p->out;
+    if (IS_STRING(args[index])) {
+        if (strcmp(AS_CSTRING(args[index]), "stdout") == 0) return &p->out;
+        if (strcmp(AS_CSTRING(args[index]), "stderr") == 0) return &p->err;
+    }
+    printf("Error: ucoreSystem.%s stream must be \"stdout\" or \"stderr\".\n", fn);
+    return NULL;
+}
+
+static bool closeOnExecPipe(int fds[2]) {
+    if (pipe(fds) != 0) return false;
+    for (int i = 0; i < 2; i++) fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+// spawn(command) -> process, or nil
+// Runs 'command' with /bin/sh -c in the script's directory, like exec()
+static Value sys_spawn(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_STRING(args[0])) {
+        printf("Error: ucoreSystem.spawn(command) expects a command string.\n");
+        return NIL_VAL;
+    }
+    int in[2], out[2], err[2];
+    if (!closeOnExecPipe(in)) goto fail;
+    if (!closeOnExecPipe(out)) { close(in[0]); close(in[1]); goto fail; }
+    if (!closeOnExecPipe(err)) {
+        close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+        goto fail;
+    }
+    signal(SIGPIPE, SIG_IGN); // write() to a child that exited fails instead
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, err[1], 2);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    char* argv[] = { "sh", "-c", AS_CSTRING(args[0]), NULL };
+    pid_t pid;
+    int rc = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(in[0]);
+    close(out[1]);
+    close(err[1]);
+    if (rc != 0) {
+        close(in[1]); close(out[0]); close(err[0]);
+        errno = rc;
+        goto fail;
+    }
+    fcntl(in[1], F_SETFL, O_NONBLOCK);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    fcntl(err[0], F_SETFL, O_NONBLOCK);
+
+    Process* p = calloc(1, sizeof(Process));
+    if (!p) exit(1);
+    p->pid = pid;
+    p->in = in[1];
+    p->out.fd = out[0];
+    p->err.fd = err[0];
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = p;
+    res->cleanup = processCleanup;
+    res->next = processNext;
+    res->share = NULL;
+    return OBJ_VAL(res);
+
+fail:
+    printf("Error: ucoreSystem.spawn could not start '%s': %s\n", AS_CSTRING(args[0]), strerror(errno));
+    return NIL_VAL;
+}
+
+// readLine(process, [stream]) -> next line, or nil at EOF
+static Value sys_readLine(VM* vm, Value* args, int argCount) {
+    if (argCount < 1 || argCount > 2 || !isProcess(args[0])) {
+        printf("Error: ucoreSystem.readLine(process, [stream]) expects a process from spawn().\n");
+        return NIL_VAL;
+    }
+    Process* p = asProcess(args[0]);
+    ProcStream* s = streamArg(p, args, argCount, 1, "readLine");
+    return s ? readStreamLine(vm, p, s) : NIL_VAL;
+}
+
+// read(process, n, [stream]) -> up to n bytes as soon as any arrive, or nil at EOF
+static Value sys_read(VM* vm, Value* args, int argCount) {
+    if (argCount < 2 || argCount > 3 || !isProcess(args[0]) || !IS_INT(args[1]) || AS_INT(args[1]) <= 0) {
+        printf("Error: ucoreSystem.read(process, n, [stream]) expects a process and a positive count.\n");
+        return NIL_VAL;
+    }
+    Process* p = asProcess(args[0]);
+    ProcStream* s = streamArg(p, args, argCount, 2, "read");
+    if (!s) return NIL_VAL;
+    if (s->len == s->pos && !fillStream(vm, p, s)) return NIL_VAL;
+    size_t n = s->len - s->pos;
+    if ((size_t)AS_INT(args[1]) < n) n = (size_t)AS_INT(args[1]);
+    return takeStream(vm, s, n, 0);
+}
+
+// write(process, text) -> bool
+static Value sys_write(VM* vm, Value* args, int argCount) {
+    if (argCount != 2 || !isProcess(args[0]) || !IS_STRING(args[1])) {
+        printf("Error: ucoreSystem.write(process, text) expects a process and a string.\n");
+        return BOOL_VAL(false);
+    }
+    Process* p = asProcess(args[0]);
+    ObjString* text = AS_STRING(args[1]);
+    size_t sent = 0;
+    while (sent < (size_t)text->length) {
+        if (p->in < 0) return BOOL_VAL(false);
+        ssize_t n = write(p->in, text->chars + sent, (size_t)text->length - sent);
+        if (n > 0) {
+            sent += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            waitProcess(vm, p, p->in, POLLOUT);
+        } else {
+            close(p->in); // The child closed its stdin
+            p->in = -1;
+            return BOOL_VAL(false);
+        }
+    }
+    return BOOL_VAL(true);
+}
+
+// closeInput(process) -> bool; the child reads EOF on stdin
+static Value sys_closeInput(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 1 || !isProcess(args[0])) {
+        printf("Error: ucoreSystem.closeInput(process) expects a process from spawn().\n");
+        return BOOL_VAL(false);
+    }
+    Process* p = asProcess(args[0]);
+    if (p->in < 0) return BOOL_VAL(false);
+    close(p->in);
+    p->in = -1;
+    return BOOL_VAL(true);
+}
+
+static bool reapProcess(Process* p) {
+    if (p->reaped) return true;
+    int status;
+    pid_t r = waitpid(p->pid, &status, WNOHANG);
+    if (r == 0 || (r < 0 && errno == EINTR)) return false;
+    p->reaped = true;
+    if (r < 0) p->exitCode = -1;
+    else if (WIFEXITED(status)) p->exitCode = WEXITSTATUS(status);
+    else p->exitCode = 128 + WTERMSIG(status); // As the shell reports it
+    return true;
+}
+
+// wait(process) -> exit code; closes stdin first. Output that was not read
+// stays available to readLine() and read().
+static Value sys_wait(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !isProcess(args[0])) {
+        printf("Error: ucoreSystem.wait(process) expects a process from spawn().\n");
+        return NIL_VAL;
+    }
+    Process* p = asProcess(args[0]);
+    if (p->in >= 0) {
+        close(p->in);
+        p->in = -1;
+    }
+    uint64_t pause = 1000;
+    while (!reapProcess(p)) {
+        if (p->out.fd >= 0 || p->err.fd >= 0) {
+            waitProcess(vm, p, -1, 0);
+        } else {
+            taskSleep(vm, pause); // Outputs closed but still running: poll for the exit
+            if (pause < 50000) pause *= 2;
+        }
+    }
+    return INT_VAL(p->exitCode);
+}
+
+// running(process) -> bool, without waiting
+static Value sys_running(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 1 || !isProcess(args[0])) {
+        printf("Error: ucoreSystem.running(process) expects a process from spawn().\n");
+        return BOOL_VAL(false);
+    }
+    return BOOL_VAL(!reapProcess(asProcess(args[0])));
+}
+
+// kill(process, [signal]) -> bool; SIGTERM by default
+static Value sys_kill(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount < 1 || argCount > 2 || !isProcess(args[0]) || (argCount == 2 && !IS_INT(args[1]))) {
+        printf("Error: ucoreSystem.kill(process, [signal]) expects a process and a signal number.\n");
+        return BOOL_VAL(false);
+    }
+    Process* p = asProcess(args[0]);
+    if (reapProcess(p)) return BOOL_VAL(false);
+    return BOOL_VAL(kill(p->pid, argCount == 2 ? (int)AS_INT(args[1]) : SIGTERM) == 0);
+}
+
 // sleep(ms)
 static Value sys_sleep(VM* vm, Value* args, int argCount) {
-    (void)vm;
     if (argCount != 1 || !IS_INT(args[0])) return NIL_VAL;
     
     int ms = AS_INT(args[0]);
     if (ms < 0) ms = 0;
     
-    struct timespec ts;
-    ts.tv_sec = ms / 1000;
-    ts.tv_nsec = (ms % 1000) * 1000000;
-    
-    nanosleep(&ts, NULL);
+    // Suspends only the calling task; other async tasks keep running
+    taskSleep(vm, (uint64_t)ms * 1000);
     return NIL_VAL;
 }
 
@@ -186,18 +587,18 @@ void registerUCoreSystem(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreSystem", 11);
     char* modName = modNameObj->chars;
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName);
+    vm->stackTop--;
     mod->source = NULL;
     mod->obj.isMarked = true; // PERMANENT ROOT
+    mod->obj.isPermanent = true;
     
-    // CRITICAL: Use ALLOCATE_OBJ for Environment to enable GC tracking
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
 
     defineNative(vm, mod->env, "args", sys_args, 0);
@@ -209,7 +610,16 @@ void registerUCoreSystem(VM* vm) {
     defineNative(vm, mod->env, "writeFile", sys_writeFile, 2);
     defineNative(vm, mod->env, "writeFile", sys_writeFile, 2);
     defineNative(vm, mod->env, "readFile", sys_readFile, 1);
+    defineNative(vm, mod->env, "lines", sys_lines, 1);
     defineNative(vm, mod->env, "sleep", sys_sleep, 1);
+    defineNative(vm, mod->env, "spawn", sys_spawn, 1);
+    defineNative(vm, mod->env, "readLine", sys_readLine, 2);
+    defineNative(vm, mod->env, "read", sys_read, 3);
+    defineNative(vm, mod->env, "write", sys_write, 2);
+    defineNative(vm, mod->env, "closeInput", sys_closeInput, 1);
+    defineNative(vm, mod->env, "wait", sys_wait, 1);
+    defineNative(vm, mod->env, "running", sys_running, 1);
+    defineNative(vm, mod->env, "kill", sys_kill, 2);
 
     Value vMod = OBJ_VAL(mod);
     defineGlobal(vm, "ucoreSystem", vMod);
@@ -0,0 +1,338 @@
+#include "ucore_thread.h"
+#include "runtime/isolate.h"
+#include "runtime/scheduler.h"
+#include "bytecode/interpreter.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Each worker runs a function on its own thread in its own isolate, so
+// workers never share objects with each other or with the script that
+// spawned them. Values cross between them only through channels and the
+// arguments and result of spawn/join, and are always copied.
+
+// ---- Channels ----
+// A channel queues messages for any number of VMs. send() copies the
+// value into the channel's own VM, which never runs code; recv() moves it
+// out into the receiver. Every VM holding the channel has its own handle,
+// and the channel is freed with the last one.
+typedef struct Channel {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   // Signalled on send and on close
+    VM* store;              // Owns the queued messages
+    Array* queue;           // Messages, rooted on store's stack
+    int head;               // Next message to receive
+    bool closed;
+    int refs;               // Handles in all VMs (atomic)
+} Channel;
+
+static void channelCleanup(void* data) {
+    Channel* ch = (Channel*)data;
+    if (__atomic_sub_fetch(&ch->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    isolateDestroy(ch->store);
+    pthread_mutex_destroy(&ch->lock);
+    pthread_cond_destroy(&ch->ready);
+    free(ch);
+}
+
+// Another VM's handle to the same channel
+static void* channelShare(void* data) {
+    Channel* ch = (Channel*)data;
+    __atomic_add_fetch(&ch->refs, 1, __ATOMIC_ACQ_REL);
+    return ch;
+}
+
+// Wait for the next message and move it into 'vm'. False once the
+// channel is closed and drained.
+static bool channelReceive(VM* vm, Channel* ch, Value* out) {
+    pthread_mutex_lock(&ch->lock);
+    while (ch->head == ch->queue->count && !ch->closed) {
+        pthread_cond_wait(&ch->ready, &ch->lock);
+    }
+    if (ch->head == ch->queue->count) {
+        pthread_mutex_unlock(&ch->lock);
+        *out = NIL_VAL;
+        return false;
+    }
+    Value message = ch->queue->items[ch->head];
+    bool ok = true;
+    *out = isolateTransfer(vm, ch->store, message, &ok);
+    ch->queue->items[ch->head++] = NIL_VAL;
+    if (ch->head == ch->queue->count) {
+        ch->queue->count = 0;
+        ch->head = 0;
+    }
+    pthread_mutex_unlock(&ch->lock);
+    return true;
+}
+
+// foreach (var message : channel) receives until the channel is closed
+static bool channelNext(VM* vm, void* data, Value* out) {
+    return channelReceive(vm, (Channel*)data, out);
+}
+
+static bool isChannel(Value v) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE &&
+           ((ObjResource*)AS_OBJ(v))->cleanup == channelCleanup;
+}
+
+static Channel* asChannel(Value v) {
+    return (Channel*)((ObjResource*)AS_OBJ(v))->data;
+}
+
+// ucoreThread.channel() -> channel
+static Value thread_channel(VM* vm, Value* args, int argCount) {
+    (void)args;
+    if (argCount != 0) {
+        printf("Error: ucoreThread.channel() takes no arguments.\n");
+        return NIL_VAL;
+    }
+    Channel* ch = calloc(1, sizeof(Channel));
+    if (!ch) {
+        printf("Error: Out of memory creating a channel.\n");
+        return NIL_VAL;
+    }
+    pthread_mutex_init(&ch->lock, NULL);
+    pthread_cond_init(&ch->ready, NULL);
+    ch->store = isolateCreate(vm, FRAME_REG_MAX); // Holds values, never runs code
+    ch->queue = newArray(ch->store);
+    ch->store->stack[ch->store->stackTop++] = OBJ_VAL(ch->queue);
+    ch->refs = 1;
+
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = ch;
+    res->cleanup = channelCleanup;
+    res->next = channelNext;
+    res->share = channelShare;
+    return OBJ_VAL(res);
+}
+
+// ucoreThread.send(channel, value, [transfer]) -> bool
+// With transfer, typed arrays in 'value' are moved rather than copied and
+// are left empty here.
+static Value thread_send(VM* vm, Value* args, int argCount) {
+    if (argCount < 2 || argCount > 3 || !isChannel(args[0])) {
+        printf("Error: ucoreThread.send(channel, value, [transfer]) expects a channel and a value.\n");
+        return BOOL_VAL(false);
+    }
+    bool transfer = argCount == 3 && IS_BOOL(args[2]) && AS_BOOL(args[2]);
+    Channel* ch = asChannel(args[0]);
+
+    pthread_mutex_lock(&ch->lock);
+    if (ch->closed) {
+        pthread_mutex_unlock(&ch->lock);
+        printf("Error: ucoreThread.send on a closed channel.\n");
+        return BOOL_VAL(false);
+    }
+    bool ok = true;
+    Value copy = transfer ? isolateTransfer(ch->store, vm, args[1], &ok)
+                          : isolateCopy(ch->store, vm, args[1], &ok);
+    if (ok) {
+        arrayPush(ch->store, ch->queue, copy); // Growth never collects
+        pthread_cond_signal(&ch->ready);
+    }
+    pthread_mutex_unlock(&ch->lock);
+    return BOOL_VAL(ok);
+}
+
+// ucoreThread.recv(channel) -> next message; waits for one.
+// nil once the channel is closed and every message has been received.
+static Value thread_recv(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !isChannel(args[0])) {
+        printf("Error: ucoreThread.recv(channel) expects a channel.\n");
+        return NIL_VAL;
+    }
+    Value message;
+    channelReceive(vm, asChannel(args[0]), &message);
+    return message;
+}
+
+// ucoreThread.close(channel) - receivers drain what is queued, then get nil
+static Value thread_close(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    if (argCount != 1 || !isChannel(args[0])) {
+        printf("Error: ucoreThread.close(channel) expects a channel.\n");
+        return BOOL_VAL(false);
+    }
+    Channel* ch = asChannel(args[0]);
+    pthread_mutex_lock(&ch->lock);
+    ch->closed = true;
+    pthread_cond_broadcast(&ch->ready);
+    pthread_mutex_unlock(&ch->lock);
+    return BOOL_VAL(true);
+}
+
+// ---- Workers ----
+// The isolate's stack holds [fn, args...] at WORKER_CALL_SLOT and the
+// result at WORKER_RESULT_SLOT.
+#define WORKER_CALL_SLOT   0
+#define WORKER_RESULT_SLOT 1
+
+typedef struct Worker {
+    pthread_t thread;
+    VM* vm;                 // The worker's isolate; NULL once joined
+    PreparedCall call;
+    pthread_mutex_t lock;
+    bool done;              // The function (and its tasks) finished
+    bool joined;
+    bool orphaned;          // Handle collected first: the thread cleans up
+} Worker;
+
+static void freeWorker(Worker* w) {
+    if (w->vm) isolateDestroy(w->vm);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+}
+
+static void* runWorker(void* arg) {
+    Worker* w = (Worker*)arg;
+    VM* vm = w->vm;
+    Array* call = (Array*)AS_OBJ(vm->stack[WORKER_CALL_SLOT]);
+    Value result = callPrepared(vm, &w->call, &call->items[1]);
+    vm->stack[WORKER_RESULT_SLOT] = result;
+    runScheduler(vm); // Tasks the function never awaited, as for the main program
+
+    pthread_mutex_lock(&w->lock);
+    w->done = true;
+    bool orphaned = w->orphaned;
+    pthread_mutex_unlock(&w->lock);
+    if (orphaned) freeWorker(w);
+    return NULL;
+}
+
+// Runs when the handle is collected (or its VM freed): a worker that was
+// never joined finishes on its own and frees itself
+static void workerCleanup(void* data) {
+    Worker* w = (Worker*)data;
+    if (w->joined) {
+        freeWorker(w);
+        return;
+    }
+    pthread_mutex_lock(&w->lock);
+    bool done = w->done;
+    if (!done) w->orphaned = true;
+    pthread_mutex_unlock(&w->lock);
+    if (done) {
+        pthread_join(w->thread, NULL);
+        freeWorker(w);
+    } else {
+        pthread_detach(w->thread);
+    }
+}
+
+static bool isWorker(Value v) {
+    return IS_OBJ(v) && AS_OBJ(v)->type == OBJ_RESOURCE &&
+           ((ObjResource*)AS_OBJ(v))->cleanup == workerCleanup;
+}
+
+// ucoreThread.spawn(fn, args...) -> worker
+// fn and the arguments are copied into a new isolate, where fn runs on a
+// thread of its own.
+static Value thread_spawn(VM* vm, Value* args, int argCount) {
+    if (argCount < 1 || !IS_OBJ(args[0]) || AS_OBJ(args[0])->type != OBJ_FUNCTION) {
+        printf("Error: ucoreThread.spawn(fn, args...) expects a function.\n");
+        return NIL_VAL;
+    }
+    Function* fn = (Function*)AS_OBJ(args[0]);
+    PreparedCall check;
+    if (!prepareCall(fn, argCount - 1, &check)) {
+        printf("Error: ucoreThread.spawn function takes %d arguments but got %d.\n",
+               fn->paramCount, argCount - 1);
+        return NIL_VAL;
+    }
+
+    // One copy of [fn, args...], so arguments sharing objects still do
+    int base = vm->stackTop;
+    Array* call = newArray(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(call);
+    for (int i = 0; i < argCount; i++) arrayPush(vm, call, args[i]);
+
+    Worker* w = calloc(1, sizeof(Worker));
+    if (!w) exit(1);
+    pthread_mutex_init(&w->lock, NULL);
+    w->vm = isolateCreate(vm, 0);
+    bool ok = true;
+    Value copy = isolateCopy(w->vm, vm, OBJ_VAL(call), &ok);
+    vm->stackTop = base;
+    if (!ok) {
+        freeWorker(w);
+        return NIL_VAL;
+    }
+    w->vm->stack[WORKER_CALL_SLOT] = copy;
+    w->vm->stack[WORKER_RESULT_SLOT] = NIL_VAL;
+    w->vm->stackTop = WORKER_RESULT_SLOT + 1;
+    Array* copied = (Array*)AS_OBJ(copy);
+    prepareCall((Function*)AS_OBJ(copied->items[0]), argCount - 1, &w->call);
+
+    if (pthread_create(&w->thread, NULL, runWorker, w) != 0) {
+        printf("Error: ucoreThread.spawn could not start a thread.\n");
+        freeWorker(w);
+        return NIL_VAL;
+    }
+
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = w;
+    res->cleanup = workerCleanup;
+    res->next = NULL;
+    res->share = NULL;
+    return OBJ_VAL(res);
+}
+
+// ucoreThread.join(worker) -> fn's return value; waits for the worker.
+// Typed arrays in the result are handed over without copying.
+static Value thread_join(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !isWorker(args[0])) {
+        printf("Error: ucoreThread.join(worker) expects a worker from spawn.\n");
+        return NIL_VAL;
+    }
+    Worker* w = (Worker*)((ObjResource*)AS_OBJ(args[0]))->data;
+    if (w->joined) {
+        printf("Error: ucoreThread.join: worker was already joined.\n");
+        return NIL_VAL;
+    }
+    pthread_join(w->thread, NULL);
+    w->joined = true;
+    bool ok = true;
+    Value result = isolateTransfer(vm, w->vm, w->vm->stack[WORKER_RESULT_SLOT], &ok);
+    isolateDestroy(w->vm);
+    w->vm = NULL;
+    return result;
+}
+
+// ucoreThread.cores() -> online CPUs, a sensible worker count
+static Value thread_cores(VM* vm, Value* args, int argCount) {
+    (void)vm; (void)args; (void)argCount;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return INT_VAL(cores > 0 ? (int)cores : 1);
+}
+
+void registerUCoreThread(VM* vm) {
+    ObjString* modNameObj = internString(vm, "ucoreThread", 11);
+    char* modName = modNameObj->chars;
+
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
+    Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
+    mod->name = strdup(modName);
+    vm->stackTop--;
+    mod->obj.isMarked = true;
+    mod->obj.isPermanent = true; // PERMANENT ROOT
+
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
+    modEnv->obj.isMarked = true;
+    modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
+    mod->env = modEnv;
+
+    defineNative(vm, mod->env, "spawn", thread_spawn, 1);
+    defineNative(vm, mod->env, "join", thread_join, 1);
+    defineNative(vm, mod->env, "channel", thread_channel, 0);
+    defineNative(vm, mod->env, "send", thread_send, 3);
+    defineNative(vm, mod->env, "recv", thread_recv, 1);
+    defineNative(vm, mod->env, "close", thread_close, 1);
+    defineNative(vm, mod->env, "cores", thread_cores, 0);
+
+    Value vMod = OBJ_VAL(mod);
+    defineGlobal(vm, "ucoreThread", vMod);
+}
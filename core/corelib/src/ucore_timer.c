@@ -1,4 +1,5 @@
 #include "ucore_timer.h"
+#include "runtime/scheduler.h"
 #include <time.h>
 #include <unistd.h>
 #include <stdio.h>
@@ -20,17 +21,15 @@ static Value utimer_now(VM* vm, Value* args, int argCount) {
 
 // Native ucoreTimer.sleep(ms)
 static Value utimer_sleep(VM* vm, Value* args, int argCount) {
-    (void)vm;
     if (argCount != 1 || !IS_INT(args[0])) {
         printf("Error: ucoreTimer.sleep expects 1 int argument (ms).\n");
         return INT_VAL(0);
     }
     
     int ms = AS_INT(args[0]);
-    struct timespec req;
-    req.tv_sec = ms / 1000;
-    req.tv_nsec = (ms % 1000) * 1000000;
-    nanosleep(&req, NULL);
+    if (ms < 0) ms = 0;
+    // Suspends only the calling task; other async tasks keep running
+    taskSleep(vm, (uint64_t)ms * 1000);
     
     return INT_VAL(0);
 }
@@ -40,18 +39,17 @@ void registerUCoreTimer(VM* vm) {
     // Use raw chars
     char* modName = modNameObj->chars;
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName);
+    vm->stackTop--;
     mod->obj.isMarked = true; 
     mod->obj.isPermanent = true; // PERMANENT ROOT
     
-    // CRITICAL: Use ALLOCATE_OBJ for Environment to enable GC tracking
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
 
     defineNative(vm, mod->env, "now", utimer_now, 0);
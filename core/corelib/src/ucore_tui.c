@@ -1313,11 +1313,21 @@ static Value tui_box(VM* vm, Value* args, int argCount) {
 // Streaming Box API (Stateful)
 // ============================================================================
 
-static int g_boxWidth = 0;
+// Width of the box being streamed, kept per VM (0 = no box open)
+static char boxStateKey; // Its address identifies the width in the VM
+
+static int* boxWidth(VM* vm) {
+    int* width = (int*)getLibState(vm, &boxStateKey);
+    if (!width) {
+        width = calloc(1, sizeof(int));
+        if (!width) exit(1);
+        setLibState(vm, &boxStateKey, width, free);
+    }
+    return width;
+}
 
 // boxBegin(title, width)
 static Value tui_boxBegin(VM* vm, Value* args, int argCount) {
-    (void)vm;
     const char* title = "";
     if (argCount >= 1 && IS_STRING(args[0])) title = AS_CSTRING(args[0]);
     
@@ -1334,16 +1344,17 @@ static Value tui_boxBegin(VM* vm, Value* args, int argCount) {
     if (width <= 0) width = termWidth;
     if (width > termWidth) width = termWidth;
     
-    g_boxWidth = width - 2; // Content width
+    int contentWidth = width - 2;
+    *boxWidth(vm) = contentWidth;
     
     // Top Border
     printf(BOX_ROUND_TL);
     if (strlen(title) > 0) {
         printf(" %s ", title);
         int magic = strlen(title) + 2; 
-        for (int i = 0; i < g_boxWidth - magic; i++) printf(BOX_LIGHT_H);
+        for (int i = 0; i < contentWidth - magic; i++) printf(BOX_LIGHT_H);
     } else {
-        for (int i = 0; i < g_boxWidth; i++) printf(BOX_LIGHT_H);
+        for (int i = 0; i < contentWidth; i++) printf(BOX_LIGHT_H);
     }
     printf(BOX_ROUND_TR "\n");
     
@@ -1352,12 +1363,12 @@ static Value tui_boxBegin(VM* vm, Value* args, int argCount) {
 
 // boxLine(text)
 static Value tui_boxLine(VM* vm, Value* args, int argCount) {
-    (void)vm;
     const char* text = "";
     if (argCount >= 1 && IS_STRING(args[0])) text = AS_CSTRING(args[0]);
     
-    // Check if global state is set, otherwise default
-    int contentWidth = g_boxWidth > 0 ? g_boxWidth : 40;
+    // Inside a box use its width, otherwise default
+    int width = *boxWidth(vm);
+    int contentWidth = width > 0 ? width : 40;
     
     // Render Wrapped Lines
     const char* p = text;
@@ -1431,14 +1442,15 @@ static Value tui_boxLine(VM* vm, Value* args, int argCount) {
 
 // boxEnd()
 static Value tui_boxEnd(VM* vm, Value* args, int argCount) {
-    (void)vm; (void)args; (void)argCount;
-    int contentWidth = g_boxWidth > 0 ? g_boxWidth : 40;
+    (void)args; (void)argCount;
+    int width = *boxWidth(vm);
+    int contentWidth = width > 0 ? width : 40;
     
     printf(BOX_ROUND_BL);
     for (int i = 0; i < contentWidth; i++) printf(BOX_LIGHT_H);
     printf(BOX_ROUND_BR "\n");
     
-    g_boxWidth = 0; // Reset
+    *boxWidth(vm) = 0; // Reset
     return NIL_VAL;
 }
 
@@ -1447,18 +1459,18 @@ void registerUCoreTui(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreTui", 8);
     char* modName = modNameObj->chars;
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName);
+    vm->stackTop--;
     mod->source = NULL;
     mod->obj.isMarked = true;
     mod->obj.isPermanent = true;
     
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true;
     modEnv->obj.isPermanent = true;
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
 
     // Terminal primitives
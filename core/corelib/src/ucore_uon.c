@@ -1,68 +1,77 @@
 #include "ucore_uon.h"
+#include "runtime/isolate.h"
+#include "runtime/fileio.h"
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Schema storage only - we don't store data anymore
-static Map* uonSchemas = NULL; // TableName -> StructDef
+/**
+ * UON reader
+ *
+ * Files are mapped read-only and records are parsed directly from the
+ * mapped bytes, so a cursor costs no per-character I/O calls and the page
+ * cache is shared between cursors. An optional sidecar (<file>.uidx)
+ * stores the offset of every record in each @flow table, which makes
+ * count() and seek() O(1) instead of a scan.
+ */
 
-// Cursor structure for streaming
+// Sidecar index layout: header, then per table a UonIndexTable, the name
+// padded to 8 bytes and recordCount uint64 offsets (each at a record's '{')
+#define UON_INDEX_MAGIC 0x3158444955414e55ULL // "UNAUIDX1"
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sourceSize;
+    int64_t sourceMtimeNs;
+    uint64_t tableCount;
+} UonIndexHeader;
+
+typedef struct {
+    uint32_t nameLength;
+    uint32_t reserved;
+    uint64_t recordCount;
+} UonIndexTable;
+
+// Cursor over one @flow table
 typedef struct {
-    FILE* file;
+    FileBuffer file;
+    FileBuffer index;          // Sidecar mapping, length 0 when not indexed
+    const char* pos;           // Next record (or separator) to read
+    const char* end;
+    const char* tableStart;    // First byte after the table's '['
+    const uint64_t* offsets;   // Record offsets from the sidecar, or NULL
+    int64_t recordCount;       // -1 until known
+    int64_t recordIndex;       // Records consumed so far
     char* tableName;
-    long startOffset; // Where the implementation loop starts (after leading [)
 } UonCursor;
 
 static void cursorCleanup(void* data);
 
-static void ensureInit(VM* vm) {
-    if (!uonSchemas) uonSchemas = newMap(vm);
-}
-
 // ---- Parser Utils ----
 
 static char peek(const char* p) { return *p; }
 static void skipSpace(const char** p) {
     while (peek(*p) && isspace(peek(*p))) (*p)++;
 }
-// File-based peek/skip
-static int fpeek(FILE* f) {
-    int c = fgetc(f);
-    ungetc(c, f);
-    return c;
-}
-static void fskipSpace(FILE* f) {
-    int c;
-    while ((c = fgetc(f)) != EOF) {
-        if (!isspace(c)) {
-            ungetc(c, f);
-            return;
-        }
-    }
-}
-
 
-// Helper to read identifier from file
-static char* fparseIdentifier(FILE* f) {
-    fskipSpace(f);
-    char buf[256];
-    int i = 0;
-    int c;
-    while ((c = fgetc(f)) != EOF) {
-        if (isalnum(c) || c == '_') {
-            if (i < 255) buf[i++] = c;
-        } else {
-            ungetc(c, f);
-            break;
-        }
-    }
-    buf[i] = '\0';
-    if (i == 0) return NULL;
-    return strdup(buf);
+// Bounded versions for mapped files, which are not NUL-terminated
+static void mskipSpace(const char** p, const char* end) {
+    while (*p < end && isspace((unsigned char)**p)) (*p)++;
+}
+static int mpeek(const char* p, const char* end) {
+    return p < end ? (unsigned char)*p : EOF;
+}
+static int mparseIdentifier(const char** p, const char* end, const char** start) {
+    mskipSpace(p, end);
+    *start = *p;
+    while (*p < end && (isalnum((unsigned char)**p) || **p == '_')) (*p)++;
+    return (int)(*p - *start);
 }
-
 // Re-use string parser logic for schema parsing (loaded in RAM still, as schema is small)
 static char* parseIdentifier(const char** p) {
     skipSpace(p);
@@ -117,9 +126,6 @@ static void parseSchemaBlock(VM* vm, const char** p) {
         }
         if (peek(*p) == ']') (*p)++;
         
-        Value vDef = OBJ_VAL(def);
-        mapSetStr(uonSchemas, tableName, (int)strlen(tableName), vDef);
-        
         skipSpace(p);
         if (peek(*p) == ',') (*p)++;
     }
@@ -127,7 +133,6 @@ static void parseSchemaBlock(VM* vm, const char** p) {
 }
 
 static void parseFromSource(VM* vm, const char* source) {
-    ensureInit(vm);
     const char* p = source;
     while (peek(p)) {
         skipSpace(&p);
@@ -153,8 +158,37 @@ static Value uon_parse(VM* vm, Value* args, int argCount) {
     return BOOL_VAL(true);
 }
 
-// Globals
-static char g_lastPath[1024] = {0};
+// Last loaded file, kept per VM
+#define UON_PATH_MAX 1024
+static char uonPathKey; // Its address identifies the path in the VM
+
+static char* lastPath(VM* vm) {
+    char* path = (char*)getLibState(vm, &uonPathKey);
+    if (!path) {
+        path = calloc(1, UON_PATH_MAX);
+        if (!path) exit(1);
+        setLibState(vm, &uonPathKey, path, free);
+    }
+    return path;
+}
+
+// Map a whole file; an empty file has nothing to read
+static bool mapFile(const char* path, FileBuffer* out) {
+    if (!fileMap(path, out)) return false;
+    if (out->length > 0) return true;
+    fileClose(out);
+    return false;
+}
+
+static const char* findFlow(const FileBuffer* m) {
+    const char* p = m->data;
+    const char* end = m->data + m->length;
+    while ((p = memchr(p, '@', (size_t)(end - p)))) {
+        if (end - p >= 5 && memcmp(p, "@flow", 5) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
 
 static Value uon_load_impl(VM* vm, Value* args, int argCount) {
     if (argCount < 1 || !IS_STRING(args[0])) return BOOL_VAL(false);
@@ -162,217 +196,555 @@ static Value uon_load_impl(VM* vm, Value* args, int argCount) {
     char* rawPath = AS_CSTRING(args[0]);
     char* path = resolvePath(vm, rawPath);
     
-    strncpy(g_lastPath, path, 1023);
-    
-    // Schema parse limited logic
-    FILE* f = fopen(path, "r");
-    free(path); // Path copied to g_lastPath, can free now
+    strncpy(lastPath(vm), path, UON_PATH_MAX - 1);
     
-    if(!f) return BOOL_VAL(false);
+    FileBuffer file;
+    bool mapped = mapFile(path, &file);
+    free(path); // Path copied to lastPath(vm), can free now
+    if (!mapped) return BOOL_VAL(false);
     
-    size_t cap = 1024 * 64; // Limit schema read to 64KB
-    size_t len = 0;
-    char* buf = malloc(cap + 1);
-    int c;
-    while((c = fgetc(f)) != EOF && len < cap) {
-        buf[len++] = c;
-        if(len >= 5 && strncmp(&buf[len-5], "@flow", 5) == 0) break;
-    }
+    // Only the schema is parsed here (limited to 64KB); records stay on disk
+    const char* flow = findFlow(&file);
+    size_t len = flow ? (size_t)(flow - file.data) + 5 : file.length;
+    if (len > 64 * 1024) len = 64 * 1024;
+    char* buf = malloc(len + 1);
+    if (!buf) exit(1);
+    memcpy(buf, file.data, len);
     buf[len] = '\0';
-    fclose(f);
+    fileClose(&file);
     parseFromSource(vm, buf);
     free(buf);
     
-     return BOOL_VAL(true);
+    return BOOL_VAL(true);
 }
 
-// Forward decl
-static Value fparseValue(VM* vm, FILE* f);
+static Value parseValue(VM* vm, const char** p, const char* end);
 
-static Value uon_next_impl(VM* vm, Value* args, int argCount) {
-    if (argCount != 1 || !IS_OBJ(args[0]) || AS_OBJ(args[0])->type != OBJ_RESOURCE) {
-        return NIL_VAL;
+// Skip a value without building it (strings have no escapes in UON)
+static void skipValue(const char** p, const char* end) {
+    mskipSpace(p, end);
+    int depth = 0;
+    while (*p < end) {
+        char c = **p;
+        if (c == '"') {
+            const char* close = memchr(*p + 1, '"', (size_t)(end - *p - 1));
+            *p = close ? close + 1 : end;
+            if (depth == 0) return;
+            continue;
+        }
+        if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') {
+            if (depth == 0) return;
+            depth--;
+            if (depth == 0) { (*p)++; return; }
+        } else if (depth == 0 && (c == ',' || isspace((unsigned char)c))) {
+            return;
+        }
+        (*p)++;
     }
-    
-    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
-    UonCursor* cursor = (UonCursor*)res->data;
-    FILE* f = cursor->file;
-    if (!f) return NIL_VAL; // already closed?
-    
-    fskipSpace(f);
-    int c = fpeek(f);
-    if (c == ']') return NIL_VAL; // End of list
-    
-    // Expect {
-    if (c == ',') { fgetc(f); fskipSpace(f); c = fpeek(f); }
-    if (c == ']') return NIL_VAL;
-    
-    if (c != '{') return NIL_VAL; // Not a valid record start
-    fgetc(f); // eat {
+}
+
+// Step past separators to the next record's '{'; NULL at the end of the table
+static const char* recordStart(const char* p, const char* end) {
+    mskipSpace(&p, end);
+    if (mpeek(p, end) == ',') { p++; mskipSpace(&p, end); }
+    return mpeek(p, end) == '{' ? p : NULL;
+}
+
+// Read the cursor's next record; false at the end of the table
+static bool cursorNext(VM* vm, void* data, Value* out) {
+    UonCursor* cursor = (UonCursor*)data;
+    if (!cursor || !cursor->pos) return false; // closed
+    const char* end = cursor->end;
+    const char* p = recordStart(cursor->pos, end);
+    if (!p) return false; // ']' or not a valid record start
+    p++; // eat {
     
     // Parse fields
     Map* m = newMap(vm);
+    vm->stack[vm->stackTop++] = OBJ_VAL(m); // Root across value allocation
     
-    while(1) {
-        fskipSpace(f);
-        if (fpeek(f) == '}') { fgetc(f); break; }
+    while (1) {
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == '}') { p++; break; }
         
-        char* key = fparseIdentifier(f);
-        if (!key) break;
+        const char* key;
+        int keyLength = mparseIdentifier(&p, end, &key);
+        if (keyLength == 0) break;
         
-        fskipSpace(f);
-        if (fgetc(f) == ':') {
-             Value val = fparseValue(vm, f);
-             mapSetStr(m, key, (int)strlen(key), val);
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == ':') {
+            p++;
+            Value val = parseValue(vm, &p, end);
+            mapSetStr(m, key, keyLength, val);
+        } else if (p < end) {
+            p++;
         }
-        free(key);
         
-        fskipSpace(f);
-        if (fpeek(f) == ',') fgetc(f);
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == ',') p++;
+    }
+    vm->stackTop--;
+    
+    cursor->pos = p;
+    cursor->recordIndex++;
+    *out = OBJ_VAL(m);
+    return true;
+}
+
+static Value uon_next_impl(VM* vm, Value* args, int argCount) {
+    if (argCount != 1 || !IS_OBJ(args[0]) || AS_OBJ(args[0])->type != OBJ_RESOURCE) {
+        return NIL_VAL;
     }
     
-    Value vRet = OBJ_VAL(m);
-    return vRet;
+    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
+    if (res->cleanup != (ResourceCleanupFn)cursorCleanup) return NIL_VAL;
+    Value record;
+    return cursorNext(vm, res->data, &record) ? record : NIL_VAL;
+}
+
+// Position p just after the '[' of tableName inside the @flow block
+static const char* findTable(const FileBuffer* file, const char* tableName) {
+    const char* end = file->data + file->length;
+    const char* p = findFlow(file);
+    if (!p) return NULL;
+    p += 5;
+    
+    mskipSpace(&p, end);
+    if (mpeek(p, end) != '{') return NULL;
+    p++;
+    
+    int nameLength = (int)strlen(tableName);
+    while (1) {
+        mskipSpace(&p, end);
+        int c = mpeek(p, end);
+        if (c == '}' || c == EOF) return NULL;
+        
+        const char* id;
+        int idLength = mparseIdentifier(&p, end, &id);
+        if (idLength == 0) return NULL;
+        
+        mskipSpace(&p, end);
+        if (mpeek(p, end) != ':') return NULL;
+        p++;
+        mskipSpace(&p, end);
+        if (idLength == nameLength && memcmp(id, tableName, nameLength) == 0) {
+            return mpeek(p, end) == '[' ? p + 1 : NULL;
+        }
+        
+        // Skip this table's records
+        skipValue(&p, end);
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == ',') p++;
+    }
 }
 
+static char* indexPath(const char* path) {
+    size_t len = strlen(path);
+    char* out = malloc(len + 6);
+    if (!out) exit(1);
+    memcpy(out, path, len);
+    strcpy(out + len, ".uidx");
+    return out;
+}
+
+static int64_t mtimeNs(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+// Attach the sidecar offsets for the cursor's table if the index is current
+static void cursorUseIndex(UonCursor* cursor, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    char* idx = indexPath(path);
+    bool mapped = mapFile(idx, &cursor->index);
+    free(idx);
+    if (!mapped) return;
+    
+    const char* p = cursor->index.data;
+    const char* end = p + cursor->index.length;
+    UonIndexHeader header;
+    if (cursor->index.length < sizeof(header)) goto stale;
+    memcpy(&header, p, sizeof(header));
+    if (header.magic != UON_INDEX_MAGIC || header.sourceSize != (uint64_t)st.st_size ||
+        header.sourceMtimeNs != mtimeNs(&st)) goto stale;
+    p += sizeof(header);
+    
+    size_t nameLength = strlen(cursor->tableName);
+    for (uint64_t t = 0; t < header.tableCount; t++) {
+        UonIndexTable table;
+        if ((size_t)(end - p) < sizeof(table)) goto stale;
+        memcpy(&table, p, sizeof(table));
+        p += sizeof(table);
+        size_t padded = ((size_t)table.nameLength + 7) & ~(size_t)7;
+        if ((size_t)(end - p) < padded ||
+            table.recordCount > (uint64_t)(end - p - padded) / sizeof(uint64_t)) goto stale;
+        const char* name = p;
+        p += padded;
+        if (table.nameLength == nameLength && memcmp(name, cursor->tableName, nameLength) == 0) {
+            cursor->offsets = (const uint64_t*)p; // 8-byte aligned by the layout
+            cursor->recordCount = (int64_t)table.recordCount;
+            return;
+        }
+        p += table.recordCount * sizeof(uint64_t);
+    }
+stale:
+    fileClose(&cursor->index);
+}
 
 static Value uon_get_impl(VM* vm, Value* args, int argCount) {
     char* tableName = NULL;
-    char* path = g_lastPath;
+    char* path = NULL;
     
     if (argCount == 1) {
         if (!IS_STRING(args[0])) return INT_VAL(0);
+        path = strdup(lastPath(vm));
         tableName = AS_CSTRING(args[0]);
     } else if (argCount == 2) {
         if (!IS_STRING(args[0]) || !IS_STRING(args[1])) return INT_VAL(0);
-        path = AS_CSTRING(args[0]);
+        path = resolvePath(vm, AS_CSTRING(args[0]));
         tableName = AS_CSTRING(args[1]);
     } else return INT_VAL(0);
     
-    FILE* f = fopen(path, "r");
-    if (!f) return INT_VAL(0);
-    
-    // Fast-forward to @flow
-    fseek(f, 0, SEEK_SET);
-    
-    // Brute force @flow scan
-    int matched = 0;
-    bool inFlow = false;
-    while(true) {
-        int c = fgetc(f);
-        if (c == EOF) break;
-        if (c == "@flow"[matched]) matched++;
-        else matched = 0;
-        if (matched == 5) { inFlow = true; break; }
+    FileBuffer file;
+    const char* tableStart = NULL;
+    if (mapFile(path, &file)) {
+        tableStart = findTable(&file, tableName);
+        if (!tableStart) fileClose(&file);
     }
+    if (!tableStart) { free(path); return INT_VAL(0); }
+    posix_madvise((void*)file.data, file.length, POSIX_MADV_SEQUENTIAL);
     
-    if (!inFlow) { fclose(f); return INT_VAL(0); }
+    UonCursor* cursor = malloc(sizeof(UonCursor));
+    if (!cursor) exit(1);
+    cursor->file = file;
+    cursor->index = (FileBuffer){ NULL, 0, 0 };
+    cursor->pos = tableStart;
+    cursor->end = file.data + file.length;
+    cursor->tableStart = tableStart;
+    cursor->offsets = NULL;
+    cursor->recordCount = -1;
+    cursor->recordIndex = 0;
+    cursor->tableName = strdup(tableName);
+    cursorUseIndex(cursor, path);
+    free(path);
     
-    // Find "tableName:"
-    fskipSpace(f);
-    if (fgetc(f) != '{') { fclose(f); return INT_VAL(0); }
+    // Created Cursor!
+    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    res->data = cursor;
+    res->cleanup = (ResourceCleanupFn)cursorCleanup;
+    res->next = cursorNext; // foreach (var row : cursor) streams the records
+    res->share = NULL;
     
-    bool foundTable = false;
-    while(true) {
-        fskipSpace(f);
-        int c = fpeek(f);
-        if (c == '}' || c == EOF) break;
-        
-        char* id = fparseIdentifier(f);
-        if (!id) break;
+    Value v = OBJ_VAL(res);
+    return v;
+}
+
+static UonCursor* cursorArg(Value* args, int argCount) {
+    if (argCount < 1 || !IS_OBJ(args[0]) || AS_OBJ(args[0])->type != OBJ_RESOURCE) return NULL;
+    ObjResource* res = (ObjResource*)AS_OBJ(args[0]);
+    if (res->cleanup != (ResourceCleanupFn)cursorCleanup) return NULL;
+    UonCursor* cursor = (UonCursor*)res->data;
+    return cursor && cursor->pos ? cursor : NULL;
+}
+
+// Number of records in the cursor's table (a skip scan without an index)
+static int64_t cursorCount(UonCursor* cursor) {
+    if (cursor->recordCount >= 0) return cursor->recordCount;
+    int64_t count = 0;
+    const char* p = cursor->tableStart;
+    while ((p = recordStart(p, cursor->end))) {
+        skipValue(&p, cursor->end);
+        count++;
+    }
+    cursor->recordCount = count;
+    return count;
+}
+
+// ucoreUon.count(cursor) -> records in the table
+static Value uon_count(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    UonCursor* cursor = cursorArg(args, argCount);
+    if (!cursor) return INT_VAL(0);
+    return INT_VAL(cursorCount(cursor));
+}
+
+// ucoreUon.seek(cursor, n) -> true if next() will return record n
+static Value uon_seek(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    UonCursor* cursor = cursorArg(args, argCount);
+    if (!cursor || argCount != 2 || !IS_INT(args[1]) || AS_INT(args[1]) < 0) return BOOL_VAL(false);
+    int64_t n = AS_INT(args[1]);
+    
+    if (cursor->offsets) {
+        if (n >= cursor->recordCount) {
+            cursor->pos = cursor->end;
+            cursor->recordIndex = cursor->recordCount;
+            return BOOL_VAL(false);
+        }
+        uint64_t offset = cursor->offsets[n];
+        if (offset >= cursor->file.length) return BOOL_VAL(false);
+        cursor->pos = cursor->file.data + offset;
+        cursor->recordIndex = n;
+        return BOOL_VAL(true);
+    }
+    
+    // No index: skip forward, restarting from the top when seeking back
+    if (n < cursor->recordIndex) {
+        cursor->pos = cursor->tableStart;
+        cursor->recordIndex = 0;
+    }
+    while (cursor->recordIndex < n) {
+        const char* p = recordStart(cursor->pos, cursor->end);
+        if (!p) return BOOL_VAL(false);
+        skipValue(&p, cursor->end);
+        cursor->pos = p;
+        cursor->recordIndex++;
+    }
+    return BOOL_VAL(recordStart(cursor->pos, cursor->end) != NULL);
+}
+
+// ucoreUon.close(cursor) - release the mapping before the cursor is collected
+static Value uon_close(VM* vm, Value* args, int argCount) {
+    (void)vm;
+    UonCursor* cursor = cursorArg(args, argCount);
+    if (!cursor) return BOOL_VAL(false);
+    fileClose(&cursor->file);
+    fileClose(&cursor->index);
+    cursor->pos = cursor->end = cursor->tableStart = NULL;
+    cursor->offsets = NULL;
+    return BOOL_VAL(true);
+}
+
+static bool writeAll(FILE* f, const void* data, size_t length) {
+    return fwrite(data, 1, length, f) == length;
+}
+
+// ucoreUon.index([path]) -> records indexed, or false
+// Writes <path>.uidx with the offset of every record of every @flow table.
+// The index is used by later get() calls until the data file changes.
+static Value uon_index(VM* vm, Value* args, int argCount) {
+    char* path;
+    if (argCount == 0) path = strdup(lastPath(vm));
+    else if (argCount == 1 && IS_STRING(args[0])) path = resolvePath(vm, AS_CSTRING(args[0]));
+    else return BOOL_VAL(false);
+    
+    struct stat st;
+    FileBuffer file;
+    if (stat(path, &st) != 0 || !mapFile(path, &file)) { free(path); return BOOL_VAL(false); }
+    posix_madvise((void*)file.data, file.length, POSIX_MADV_SEQUENTIAL);
+    const char* end = file.data + file.length;
+    
+    // Publish with rename() so readers never see a partial index
+    char* idx = indexPath(path);
+    char* tmp = malloc(strlen(idx) + 5);
+    if (!tmp) exit(1);
+    sprintf(tmp, "%s.tmp", idx);
+    FILE* out = fopen(tmp, "wb");
+    bool ok = out != NULL;
+    
+    UonIndexHeader header = { UON_INDEX_MAGIC, (uint64_t)st.st_size, mtimeNs(&st), 0 };
+    if (ok) ok = writeAll(out, &header, sizeof(header));
+    
+    int64_t total = 0;
+    const char* p = findFlow(&file);
+    if (p) {
+        p += 5;
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == '{') p++;
+        else p = end;
+    } else {
+        p = end;
+    }
+    static const char zeros[8] = {0};
+    while (ok) {
+        mskipSpace(&p, end);
+        const char* name;
+        int nameLength = mparseIdentifier(&p, end, &name);
+        if (nameLength == 0) break;
+        mskipSpace(&p, end);
+        if (mpeek(p, end) != ':') break;
+        p++;
+        mskipSpace(&p, end);
+        if (mpeek(p, end) != '[') { skipValue(&p, end); continue; }
+        p++;
         
-        if (strcmp(id, tableName) == 0) {
-            free(id);
-            foundTable = true;
-            break;
+        // Record count is patched in once the table has been walked
+        long tablePos = ftell(out);
+        UonIndexTable table = { (uint32_t)nameLength, 0, 0 };
+        size_t pad = (8 - (size_t)nameLength % 8) % 8;
+        ok = writeAll(out, &table, sizeof(table)) && writeAll(out, name, (size_t)nameLength) &&
+             writeAll(out, zeros, pad);
+        const char* r;
+        while (ok && (r = recordStart(p, end))) {
+            uint64_t offset = (uint64_t)(r - file.data);
+            ok = writeAll(out, &offset, sizeof(offset));
+            p = r;
+            skipValue(&p, end);
+            table.recordCount++;
         }
-        free(id);
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == ']') p++;
+        mskipSpace(&p, end);
+        if (mpeek(p, end) == ',') p++;
         
-        // Skip value
-        fskipSpace(f);
-        if (fgetc(f) == ':') {
-             fskipSpace(f);
-             if (fgetc(f) == '[') {
-                 // Skip content until closing ]
-                 int depth = 1;
-                 while(depth > 0 && (c=fgetc(f)) != EOF) {
-                     if(c=='[') depth++;
-                     if(c==']') depth--;
-                 }
-             }
-             fskipSpace(f);
-             if (fpeek(f) == ',') fgetc(f);
+        long here = ftell(out);
+        ok = ok && fseek(out, tablePos, SEEK_SET) == 0 && writeAll(out, &table, sizeof(table)) &&
+             fseek(out, here, SEEK_SET) == 0;
+        header.tableCount++;
+        total += (int64_t)table.recordCount;
+    }
+    if (ok) ok = fseek(out, 0, SEEK_SET) == 0 && writeAll(out, &header, sizeof(header));
+    if (out && fclose(out) != 0) ok = false;
+    if (ok) ok = rename(tmp, idx) == 0;
+    if (!ok) {
+        printf("Error: Could not write UON index %s\n", idx);
+        unlink(tmp);
+    }
+    fileClose(&file);
+    free(tmp);
+    free(idx);
+    free(path);
+    return ok ? INT_VAL(total) : BOOL_VAL(false);
+}
+
+#define UON_PARALLEL_MAX 64
+
+// Function argument for parallelMap, or NULL
+static Function* functionArg(Value v) {
+    if (!IS_OBJ(v) || AS_OBJ(v)->type != OBJ_FUNCTION) return NULL;
+    return (Function*)AS_OBJ(v);
+}
+
+// ucoreUon.parallelMap(path, table, fn, [threads], [reduce])
+// Splits the table into one slice per thread, each read by its own cursor
+// and isolate. Slices start at index offsets when the sidecar is current,
+// otherwise at byte targets found with one skip scan.
+static Value uon_parallelMap(VM* vm, Value* args, int argCount) {
+    if (argCount < 3 || !IS_STRING(args[0]) || !IS_STRING(args[1]) || !functionArg(args[2])) {
+        printf("Error: ucoreUon.parallelMap expects (path, table, fn, [threads], [reduce]).\n");
+        return NIL_VAL;
+    }
+    int threads = argCount > 3 && IS_INT(args[3]) ? (int)AS_INT(args[3]) : 0;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > UON_PARALLEL_MAX) threads = UON_PARALLEL_MAX;
+    Function* reduce = NULL;
+    if (argCount > 4 && !IS_NIL(args[4])) {
+        reduce = functionArg(args[4]);
+        if (!reduce) {
+            printf("Error: ucoreUon.parallelMap reduce must be a function.\n");
+            return NIL_VAL;
         }
     }
     
-    if (!foundTable) { fclose(f); return INT_VAL(0); }
-    
-    fskipSpace(f);
-    if (fgetc(f) != ':') { fclose(f); return INT_VAL(0); }
-    fskipSpace(f);
-    if (fgetc(f) != '[') { fclose(f); return INT_VAL(0); }
-    
-    // Created Cursor!
-    ObjResource* res = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
-    UonCursor* cursor = malloc(sizeof(UonCursor));
-    cursor->file = f;
-    cursor->tableName = strdup(tableName);
-    cursor->startOffset = ftell(f);
-    
-    res->data = cursor;
-    res->cleanup = (ResourceCleanupFn)cursorCleanup;
+    char* path = resolvePath(vm, AS_CSTRING(args[0]));
+    UonCursor whole = { { NULL, 0, 0 }, { NULL, 0, 0 }, NULL, NULL, NULL, NULL, -1, 0, AS_CSTRING(args[1]) };
+    if (mapFile(path, &whole.file)) whole.tableStart = findTable(&whole.file, whole.tableName);
+    if (!whole.tableStart) {
+        fileClose(&whole.file);
+        free(path);
+        return NIL_VAL;
+    }
+    whole.end = whole.file.data + whole.file.length;
+    cursorUseIndex(&whole, path);
+    free(path);
+    
+    // Slice i covers [starts[i], starts[i + 1]); the last runs to the table's ']'
+    const char* starts[UON_PARALLEL_MAX + 1];
+    if (whole.offsets) {
+        if (whole.recordCount < threads) threads = whole.recordCount > 0 ? (int)whole.recordCount : 1;
+        for (int i = 0; i < threads; i++) {
+            int64_t n = whole.recordCount * i / threads;
+            uint64_t offset = n < whole.recordCount ? whole.offsets[n] : whole.file.length;
+            starts[i] = whole.file.data + (offset < whole.file.length ? offset : whole.file.length);
+        }
+    } else {
+        size_t span = (size_t)(whole.end - whole.tableStart);
+        int slice = 1;
+        starts[0] = whole.tableStart;
+        const char* p = whole.tableStart;
+        const char* r;
+        while (slice < threads && (r = recordStart(p, whole.end))) {
+            if ((size_t)(r - whole.tableStart) >= span / (size_t)threads * (size_t)slice) {
+                starts[slice++] = r;
+            }
+            p = r;
+            skipValue(&p, whole.end);
+        }
+        threads = slice;
+    }
+    starts[threads] = whole.end;
+    
+    UonCursor slices[UON_PARALLEL_MAX];
+    Partition parts[UON_PARALLEL_MAX];
+    for (int i = 0; i < threads; i++) {
+        slices[i] = whole; // Shares the mapping; 'whole' unmaps it
+        slices[i].pos = starts[i];
+        slices[i].end = starts[i + 1];
+        parts[i].next = cursorNext;
+        parts[i].state = &slices[i];
+    }
+    posix_madvise((void*)whole.file.data, whole.file.length, POSIX_MADV_SEQUENTIAL);
     
-    Value v = OBJ_VAL(res);
-    return v;
+    Value result;
+    bool ok = isolateParallelMap(vm, (Function*)AS_OBJ(args[2]), reduce, parts, threads, &result);
+    fileClose(&whole.file);
+    fileClose(&whole.index);
+    return ok ? result : NIL_VAL;
 }
 
 static void cursorCleanup(void* data) {
     UonCursor* cursor = (UonCursor*)data;
     if (cursor) {
-        if (cursor->file) fclose(cursor->file);
+        fileClose(&cursor->file);
+        fileClose(&cursor->index);
         if (cursor->tableName) free(cursor->tableName);
         free(cursor);
     }
 }
 
-static Value fparseValue(VM* vm, FILE* f) { 
-    fskipSpace(f);
-    int c = fpeek(f);
+static Value parseValue(VM* vm, const char** p, const char* end) {
+    mskipSpace(p, end);
+    int c = mpeek(*p, end);
     
     if (c == '"') {
-        fgetc(f);
-        char buf[4096]; int i=0; // increased buffer
-        while((c=fgetc(f)) != EOF && c != '"' && i < 4095) buf[i++] = c;
-        buf[i] = '\0';
-        ObjString* s = internString(vm, buf, i);
+        const char* start = *p + 1;
+        const char* close = memchr(start, '"', (size_t)(end - start));
+        if (!close) close = end;
+        *p = close < end ? close + 1 : end;
+        ObjString* s = internString(vm, start, (int)(close - start));
         return OBJ_VAL(s);
     }
     
     if (isdigit(c) || c == '-') {
-        char buf[64]; int i=0;
-        while((c=fgetc(f)) != EOF && (isdigit(c) || c == '.' || c=='-') && i < 63) buf[i++] = c;
+        char buf[64]; int i = 0;
+        bool isFloat = false;
+        while (*p < end && i < 63) {
+            char d = **p;
+            if (d == '.' || d == 'e' || d == 'E') isFloat = true;
+            else if (!isdigit((unsigned char)d) && d != '-' &&
+                     !(d == '+' && i > 0 && (buf[i - 1] == 'e' || buf[i - 1] == 'E'))) break;
+            buf[i++] = d;
+            (*p)++;
+        }
         buf[i] = '\0';
-        ungetc(c, f);
-        if (strchr(buf, '.')) {
-            return FLOAT_VAL(atof(buf));
+        if (isFloat) {
+            return FLOAT_VAL(strtod(buf, NULL));
         } else {
-            return INT_VAL(atoi(buf));
+            return INT_VAL(strtoll(buf, NULL, 10));
         }
     }
     
     // bool/null/ident
-    char* id = fparseIdentifier(f);
-    if (id) {
-         Value v = NIL_VAL;
-         if (strcmp(id, "true")==0) { v = BOOL_VAL(true); }
-         else if (strcmp(id, "false")==0) { v = BOOL_VAL(false); }
-         else if (strcmp(id, "null")==0) { v = NIL_VAL; }
-         else {
-             ObjString* s = internString(vm, id, (int)strlen(id));
-             v = OBJ_VAL(s); 
-         }
-         free(id);
-         return v;
+    const char* id;
+    int idLength = mparseIdentifier(p, end, &id);
+    if (idLength > 0) {
+        if (idLength == 4 && memcmp(id, "true", 4) == 0) return BOOL_VAL(true);
+        if (idLength == 5 && memcmp(id, "false", 5) == 0) return BOOL_VAL(false);
+        if (idLength == 4 && memcmp(id, "null", 4) == 0) return NIL_VAL;
+        ObjString* s = internString(vm, id, idLength);
+        return OBJ_VAL(s);
     }
     return NIL_VAL;
 }
@@ -457,29 +829,26 @@ static Value uon_generate(VM* vm, Value* args, int argCount) {
     uon_buf_append(&buf, &len, &cap, "@schema {\n");
     
     bool firstTable = true;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        MapEntry* e = schema->buckets[i];
-        while (e) {
-            if (!firstTable) uon_buf_append(&buf, &len, &cap, ",\n");
-            firstTable = false;
-            
-            uon_buf_append(&buf, &len, &cap, "    ");
-            uon_buf_append(&buf, &len, &cap, e->key);
-            uon_buf_append(&buf, &len, &cap, ": [");
-            
-            // Schema value should be an array of field names
-            if (IS_OBJ(e->value) && AS_OBJ(e->value)->type == OBJ_ARRAY) {
-                Array* fields = (Array*)AS_OBJ(e->value);
-                for (int j = 0; j < fields->count; j++) {
-                    if (j > 0) uon_buf_append(&buf, &len, &cap, ", ");
-                    if (IS_STRING(fields->items[j])) {
-                        uon_buf_append(&buf, &len, &cap, AS_CSTRING(fields->items[j]));
-                    }
+    for (int i = 0; i < schema->count; i++) {
+        MapEntry* e = &schema->entries[i];
+        if (!firstTable) uon_buf_append(&buf, &len, &cap, ",\n");
+        firstTable = false;
+        
+        uon_buf_append(&buf, &len, &cap, "    ");
+        uon_buf_append(&buf, &len, &cap, e->key);
+        uon_buf_append(&buf, &len, &cap, ": [");
+        
+        // Schema value should be an array of field names
+        if (IS_OBJ(e->value) && AS_OBJ(e->value)->type == OBJ_ARRAY) {
+            Array* fields = (Array*)AS_OBJ(e->value);
+            for (int j = 0; j < fields->count; j++) {
+                if (j > 0) uon_buf_append(&buf, &len, &cap, ", ");
+                if (IS_STRING(fields->items[j])) {
+                    uon_buf_append(&buf, &len, &cap, AS_CSTRING(fields->items[j]));
                 }
             }
-            uon_buf_append(&buf, &len, &cap, "]");
-            e = e->next;
         }
+        uon_buf_append(&buf, &len, &cap, "]");
     }
     uon_buf_append(&buf, &len, &cap, "\n}\n\n");
     
@@ -487,44 +856,38 @@ static Value uon_generate(VM* vm, Value* args, int argCount) {
     uon_buf_append(&buf, &len, &cap, "@flow {\n");
     
     firstTable = true;
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        MapEntry* e = data->buckets[i];
-        while (e) {
-            if (!firstTable) uon_buf_append(&buf, &len, &cap, ",\n");
-            firstTable = false;
-            
-            uon_buf_append(&buf, &len, &cap, "    ");
-            uon_buf_append(&buf, &len, &cap, e->key);
-            uon_buf_append(&buf, &len, &cap, ": [\n");
-            
-            // Data value should be an array of maps (records)
-            if (IS_OBJ(e->value) && AS_OBJ(e->value)->type == OBJ_ARRAY) {
-                Array* records = (Array*)AS_OBJ(e->value);
-                for (int j = 0; j < records->count; j++) {
-                    if (j > 0) uon_buf_append(&buf, &len, &cap, ",\n");
-                    uon_buf_append(&buf, &len, &cap, "        { ");
-                    
-                    if (IS_OBJ(records->items[j]) && AS_OBJ(records->items[j])->type == OBJ_MAP) {
-                        Map* record = (Map*)AS_OBJ(records->items[j]);
-                        bool firstField = true;
-                        for (int k = 0; k < TABLE_SIZE; k++) {
-                            MapEntry* f = record->buckets[k];
-                            while (f) {
-                                if (!firstField) uon_buf_append(&buf, &len, &cap, ", ");
-                                firstField = false;
-                                uon_buf_append(&buf, &len, &cap, f->key);
-                                uon_buf_append(&buf, &len, &cap, ": ");
-                                uon_serialize_val(f->value, &buf, &len, &cap);
-                                f = f->next;
-                            }
-                        }
+    for (int i = 0; i < data->count; i++) {
+        MapEntry* e = &data->entries[i];
+        if (!firstTable) uon_buf_append(&buf, &len, &cap, ",\n");
+        firstTable = false;
+        
+        uon_buf_append(&buf, &len, &cap, "    ");
+        uon_buf_append(&buf, &len, &cap, e->key);
+        uon_buf_append(&buf, &len, &cap, ": [\n");
+        
+        // Data value should be an array of maps (records)
+        if (IS_OBJ(e->value) && AS_OBJ(e->value)->type == OBJ_ARRAY) {
+            Array* records = (Array*)AS_OBJ(e->value);
+            for (int j = 0; j < records->count; j++) {
+                if (j > 0) uon_buf_append(&buf, &len, &cap, ",\n");
+                uon_buf_append(&buf, &len, &cap, "        { ");
+                
+                if (IS_OBJ(records->items[j]) && AS_OBJ(records->items[j])->type == OBJ_MAP) {
+                    Map* record = (Map*)AS_OBJ(records->items[j]);
+                    bool firstField = true;
+                    for (int k = 0; k < record->count; k++) {
+                        MapEntry* f = &record->entries[k];
+                        if (!firstField) uon_buf_append(&buf, &len, &cap, ", ");
+                        firstField = false;
+                        uon_buf_append(&buf, &len, &cap, f->key);
+                        uon_buf_append(&buf, &len, &cap, ": ");
+                        uon_serialize_val(f->value, &buf, &len, &cap);
                     }
-                    uon_buf_append(&buf, &len, &cap, " }");
                 }
+                uon_buf_append(&buf, &len, &cap, " }");
             }
-            uon_buf_append(&buf, &len, &cap, "\n    ]");
-            e = e->next;
         }
+        uon_buf_append(&buf, &len, &cap, "\n    ]");
     }
     uon_buf_append(&buf, &len, &cap, "\n}\n");
     
@@ -548,23 +911,28 @@ void registerUCoreUON(VM* vm) {
     ObjString* modNameObj = internString(vm, "ucoreUon", 8);
     char* modName = modNameObj->chars; 
     
+    vm->stack[vm->stackTop++] = OBJ_VAL(modNameObj); // Root name across the allocation
     Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
     mod->name = strdup(modName); 
+    vm->stackTop--;
     mod->obj.isMarked = true; // PERMANENT ROOT
+    mod->obj.isPermanent = true;
     
-    // CRITICAL: Use ALLOCATE_OBJ for Environment to enable GC tracking
-    Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-    memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
-    modEnv->enclosing = NULL;
+    Environment* modEnv = newEnvironment(vm, NULL); // GC-tracked, no enclosing scope
     modEnv->obj.isMarked = true; 
     modEnv->obj.isPermanent = true; // PERMANENT ROOT
+    pinObject(vm, (Obj*)modEnv); // Traced from birth, before the module is reachable
     mod->env = modEnv;
 
     defineNative(vm, mod->env, "parse", uon_parse, 1);
     defineNative(vm, mod->env, "load", uon_load_impl, 1);
     defineNative(vm, mod->env, "get", uon_get_impl, 1);
     defineNative(vm, mod->env, "next", uon_next_impl, 1);
+    defineNative(vm, mod->env, "index", uon_index, 1);
+    defineNative(vm, mod->env, "count", uon_count, 1);
+    defineNative(vm, mod->env, "seek", uon_seek, 2);
+    defineNative(vm, mod->env, "close", uon_close, 1);
+    defineNative(vm, mod->env, "parallelMap", uon_parallelMap, 3);
     defineNative(vm, mod->env, "generate", uon_generate, 2);
     defineNative(vm, mod->env, "save", uon_save_dummy, 1);
     defineNative(vm, mod->env, "insert", uon_noop, 2);
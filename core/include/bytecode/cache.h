@@ -0,0 +1,72 @@
+#ifndef BYTECODE_CACHE_H
+#define BYTECODE_CACHE_H
+
+#include "bytecode/chunk.h"
+#include "runtime/fileio.h"
+
+/**
+ * Bytecode Cache (.unnac)
+ *
+ * A compiled script or module saved next to its source ("app.unna" ->
+ * "app.unnac") so startup and import skip lexing, parsing and compiling.
+ * The file records the source's size, mtime and hash; a cache whose
+ * source changed is ignored. Written by `unnarize --compile`.
+ *
+ * Layout (native byte order, all integers 32-bit unless noted):
+ *   header   UnnacHeader
+ *   globals  globalCount x { length, bytes }      - names of global slots
+ *   chunk    codeSize, maxRegs, constantCount,
+ *            code[codeSize], lines[codeSize],
+ *            constantCount x { tag:8, payload }
+ * Constant payloads: INT value | FLOAT 64-bit value | STRING length, bytes |
+ * FUNCTION nameLength, name, paramCount, isAsync:8, chunk.
+ * GETGLOBAL/SETGLOBAL/DEFGLOBAL operands index the globals table and are
+ * resolved to slots of the loading environment.
+ */
+
+#define UNNAC_MAGIC   0x43414E55u   // "UNAC"
+#define UNNAC_VERSION 4             // Bump when the layout or instruction encoding changes
+
+typedef struct UnnacHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t opcodeCount;       // OPCODE_COUNT of the writer
+    uint32_t globalCount;
+    int64_t sourceMtimeNs;
+    uint64_t sourceSize;
+    uint64_t sourceHash;        // FNV-1a of the source bytes
+    uint64_t payloadHash;       // FNV-1a of everything after the header
+} UnnacHeader;
+
+// Cache file path for a source path (caller must free() the result)
+char* bytecodeCachePath(const char* sourcePath);
+
+// Fill 'chunk' (initialized and owned by a rooted Function) from the cache of
+// 'sourcePath' if it exists and matches the source. Globals resolve in
+// vm->globalEnv. Returns false, leaving 'chunk' empty, if there is no usable
+// cache.
+bool loadBytecodeCache(VM* vm, const char* sourcePath, BytecodeChunk* chunk);
+
+// Save 'chunk', compiled from 'source' against vm->globalEnv
+bool writeBytecodeCache(VM* vm, const char* sourcePath, const char* source,
+                        BytecodeChunk* chunk);
+
+// The cache file's bytes for 'chunk' without writing them: a malloc'd
+// image of *size bytes, or NULL if the chunk cannot be cached. 'source'
+// may be NULL for an image that is only loaded, never saved.
+uint8_t* encodeBytecodeImage(VM* vm, const char* sourcePath, const char* source,
+                             BytecodeChunk* chunk, size_t* size);
+
+// Publish an encoded image (encoded with its source) as the cache file of
+// 'sourcePath'. Fills in the image's payload hash.
+bool saveBytecodeImage(const char* sourcePath, uint8_t* image, size_t size);
+
+// Map the cache of 'sourcePath' if it is usable, for loadBytecodeImage
+bool readBytecodeCache(const char* sourcePath, FileBuffer* out);
+
+// loadBytecodeCache from an image in memory. The image is trusted (this
+// process encoded it), so neither the source nor the payload is checked.
+bool loadBytecodeImage(VM* vm, const char* sourcePath, const uint8_t* image, size_t size,
+                       BytecodeChunk* chunk);
+
+#endif // BYTECODE_CACHE_H
@@ -12,6 +12,18 @@
  * Optimized for cache-friendly sequential execution.
  */
 
+/**
+ * Inline cache for one GETPROP/SETPROP instruction.
+ * 'shape' is the last seen StructDef* (struct field access) or module
+ * Environment*; 'index' is the resolved field index or env slot.
+ * Shapes are marked through the owning function so a cached pointer
+ * cannot be freed and reused by a different object.
+ */
+typedef struct PropCache {
+    Obj* shape;
+    int index;
+} PropCache;
+
 typedef struct BytecodeChunk {
     // === Code Stream (32-bit instructions) ===
     uint32_t* code;             // Register-based instruction words
@@ -29,6 +41,13 @@ typedef struct BytecodeChunk {
 
     // === Register Info ===
     int maxRegs;                // Maximum register index used by this chunk
+
+    // === Inline Caches ===
+    PropCache* propCaches;      // Indexed by instruction offset; NULL until first property access
+
+    // === Baseline JIT (bytecode/jit.h) ===
+    int hotness;                // Calls and backward jumps left before compiling
+    struct JitCode* jit;        // Native code, NULL until compiled
 } BytecodeChunk;
 
 // Chunk lifecycle
@@ -44,6 +63,9 @@ void patchJump(BytecodeChunk* chunk, int offset);
 // Constant pool
 int addConstant(BytecodeChunk* chunk, Value value);
 
+// Inline caches (allocated for the finished code on first use)
+PropCache* allocPropCaches(BytecodeChunk* chunk);
+
 // Debug
 void disassembleChunk(BytecodeChunk* chunk, const char* name);
 int disassembleInstruction(BytecodeChunk* chunk, int offset);
@@ -13,4 +13,23 @@
 // Execute bytecode chunk
 uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth);
 
+// Call a compiled function from native code and return its result
+Value callBytecodeFunction(VM* vm, Function* func, Value* args, int argCount);
+
+// A native -> script call resolved once and reused for every invocation
+// (HTTP route handlers, callbacks). Holds no GC reference: the owner keeps
+// the function reachable, e.g. with pinObject.
+typedef struct {
+    Function* function;
+    BytecodeChunk* chunk;   // NULL for natives and AST-walker functions
+    int argCount;
+    int windowSize;         // Callee registers: R(0)=function plus maxRegs
+} PreparedCall;
+
+// Check arity and resolve the chunk. False if func cannot take argCount args.
+bool prepareCall(Function* func, int argCount, PreparedCall* call);
+// Run a prepared call with call->argCount arguments. No allocation on the
+// bytecode path: the frame goes straight onto the register file.
+Value callPrepared(VM* vm, const PreparedCall* call, Value* args);
+
 #endif // BYTECODE_INTERPRETER_H
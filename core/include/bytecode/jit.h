@@ -0,0 +1,42 @@
+#ifndef BYTECODE_JIT_H
+#define BYTECODE_JIT_H
+
+#include "bytecode/chunk.h"
+#include "vm.h"
+
+/**
+ * Baseline JIT (x86-64)
+ *
+ * A chunk that gets hot is translated to native code, one template per
+ * instruction. The hotness count covers calls into the chunk and the
+ * backward jumps taken inside it. Registers stay in vm->registers, so every
+ * instruction boundary is also an entry point. A call enters the native
+ * code at the first instruction. A loop that is already running enters at
+ * the target of its backward jump (on-stack replacement).
+ *
+ * The templates inline the int and float paths of arithmetic and
+ * comparisons, plus array, typed array, global and cached property access,
+ * each behind a type guard. Native code leaves when a guard fails, or at an
+ * instruction it does not translate (calls, returns, allocation).
+ * jitRun then returns that instruction's index. The interpreter runs the
+ * instruction and goes back into the native code at the next one.
+ *
+ * UNNARIZE_JIT=0 turns the JIT off. On other architectures jitCompile
+ * always fails and everything runs in the interpreter.
+ */
+
+#define JIT_HOTNESS 1000    // Calls plus backward jumps before a chunk is compiled
+
+typedef struct JitCode JitCode;
+
+// Compile 'chunk' into chunk->jit. False if the JIT is off or the chunk
+// cannot be compiled; the interpreter keeps running it either way.
+bool jitCompile(VM* vm, BytecodeChunk* chunk);
+
+// Run native code from instruction 'pc' with the frame at 'regs'. Returns
+// the instruction the interpreter resumes at.
+int jitRun(JitCode* jit, VM* vm, Value* regs, int pc);
+
+void jitFree(JitCode* jit);
+
+#endif // BYTECODE_JIT_H
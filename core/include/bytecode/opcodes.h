@@ -26,15 +26,15 @@ typedef enum {
     OP_LOADFALSE,       // A:    R(A) = false
 
     // === Global Variables ===
-    OP_GETGLOBAL,       // ABx:  R(A) = globals[K(Bx)]
-    OP_SETGLOBAL,       // ABx:  globals[K(Bx)] = R(A)
-    OP_DEFGLOBAL,       // ABx:  define globals[K(Bx)] = R(A)
+    OP_GETGLOBAL,       // ABx:  R(A) = globals[Bx]  (Bx = slot in globalEnv->vars)
+    OP_SETGLOBAL,       // ABx:  globals[Bx] = R(A)
+    OP_DEFGLOBAL,       // ABx:  define globals[Bx] = R(A)
 
     // === Arithmetic ===
     OP_ADD,             // ABC:  R(A) = R(B) + R(C)
-    OP_ADDI,            // ABx:  R(A) = R(A) + K(Bx) OR R(A) = R(B) + int16_t(sBx)  (Actually, AsBx: R(A) = R(B) + sBx)
+    OP_ADDI,            // AsBx: R(A) = R(A) + sBx
     OP_SUB,             // ABC:  R(A) = R(B) - R(C)
-    OP_SUBI,            // AsBx: R(A) = R(B) - sBx
+    OP_SUBI,            // AsBx: R(A) = R(A) - sBx
     OP_MUL,             // ABC:  R(A) = R(B) * R(C)
     OP_DIV,             // ABC:  R(A) = R(B) / R(C)
     OP_MOD,             // ABC:  R(A) = R(B) % R(C)
@@ -98,12 +98,55 @@ typedef enum {
     OP_NOP,             // -:    no operation
 
     // === Foreach ===
-    OP_FOREACH_PREP,    // ABC:  prepare foreach: R(A)=iterator, R(B)=collection
-    OP_FOREACH_NEXT,    // AsBx: R(A) = next element, jump sBx if exhausted
+    // R(A) = collection, R(A+1) = cursor, R(A+2) = loop variable
+    OP_FOREACH_PREP,    // A:    R(A+1) = start of R(A)
+    OP_FOREACH_NEXT,    // AsBx: if R(A) has an element at R(A+1): R(A+2) = it, advance, pc += sBx
 
     // === Concatenation (fast path) ===
     OP_CONCAT,          // ABC:  R(A) = R(B) .. R(C)  (string concat)
 
+    // === Superinstructions (emitted by the optimizer) ===
+    // Compare-and-branch: the next word is an OP_JMP, taken when the
+    // comparison's result equals A and skipped otherwise.
+    OP_LTJMP,           // ABC:  if (R(B) <  R(C)) == A: jump
+    OP_LEJMP,           // ABC:  if (R(B) <= R(C)) == A: jump
+    OP_EQJMP,           // ABC:  if (R(B) == R(C)) == A: jump
+    OP_LTJMPK,          // ABC:  if (R(B) <  K(C)) == A: jump
+    OP_LEJMPK,          // ABC:  if (R(B) <= K(C)) == A: jump
+    OP_GTJMPK,          // ABC:  if (R(B) >  K(C)) == A: jump
+    OP_GEJMPK,          // ABC:  if (R(B) >= K(C)) == A: jump
+    OP_EQJMPK,          // ABC:  if (R(B) == K(C)) == A: jump
+    OP_GETIDXI,         // ABC:  R(A) = R(B)[C]  (C is an unsigned immediate)
+
+    // === Quickened variants (rewritten in place by the interpreter) ===
+    // A generic instruction replaces itself with one of these once it sees
+    // matching operand types. The variant checks the types and, on a
+    // mismatch, restores the generic opcode and runs it (deoptimizes).
+    // Never emitted by the compiler, so never stored in a .unnac cache.
+    OP_ADD_II,          // ABC:  R(A) = R(B) + R(C)  (int, int)
+    OP_ADD_FF,          // ABC:  R(A) = R(B) + R(C)  (float, float)
+    OP_SUB_II,          // ABC:  R(A) = R(B) - R(C)  (int, int)
+    OP_SUB_FF,          // ABC:  R(A) = R(B) - R(C)  (float, float)
+    OP_MUL_II,          // ABC:  R(A) = R(B) * R(C)  (int, int)
+    OP_MUL_FF,          // ABC:  R(A) = R(B) * R(C)  (float, float)
+    OP_DIV_FF,          // ABC:  R(A) = R(B) / R(C)  (float, float)
+    OP_LT_II,           // ABC:  R(A) = R(B) <  R(C) (int, int)
+    OP_LT_FF,           // ABC:  R(A) = R(B) <  R(C) (float, float)
+    OP_LE_II,           // ABC:  R(A) = R(B) <= R(C) (int, int)
+    OP_LE_FF,           // ABC:  R(A) = R(B) <= R(C) (float, float)
+    OP_GT_II,           // ABC:  R(A) = R(B) >  R(C) (int, int)
+    OP_GT_FF,           // ABC:  R(A) = R(B) >  R(C) (float, float)
+    OP_GE_II,           // ABC:  R(A) = R(B) >= R(C) (int, int)
+    OP_GE_FF,           // ABC:  R(A) = R(B) >= R(C) (float, float)
+    OP_LTJMP_II,        // ABC:  LTJMP  (int, int)
+    OP_LTJMP_FF,        // ABC:  LTJMP  (float, float)
+    OP_LEJMP_II,        // ABC:  LEJMP  (int, int)
+    OP_LEJMP_FF,        // ABC:  LEJMP  (float, float)
+    OP_GETIDX_ARR_I,    // ABC:  R(A) = R(B)[R(C)]  (array, int)
+    OP_SETIDX_ARR_I,    // ABC:  R(A)[R(B)] = R(C)  (array, int)
+    OP_GETIDX_TA_I,     // ABC:  R(A) = R(B)[R(C)]  (typed array, int)
+    OP_SETIDX_TA_I,     // ABC:  R(A)[R(B)] = R(C)  (typed array, int)
+
     OPCODE_COUNT
 } OpCode;
 
@@ -128,7 +171,7 @@ typedef enum {
 // Opcode metadata
 typedef struct {
     const char* name;
-    int format;         // 0=ABC, 1=ABx, 2=AsBx, 3=sBx, 4=A-only
+    int format;         // 0=ABC, 1=ABx, 2=AsBx, 3=sBx, 4=A-only, 5=compare-and-branch
     bool hasSideEffect;
 } OpcodeInfo;
 
@@ -0,0 +1,16 @@
+#ifndef BYTECODE_OPTIMIZER_H
+#define BYTECODE_OPTIMIZER_H
+
+#include "bytecode/chunk.h"
+
+/**
+ * Bytecode Optimizer - peephole passes over a compiled chunk
+ *
+ * Runs once per chunk after compilation, before the chunk first executes
+ * (or is written to a .unnac cache).
+ */
+
+// Rewrite 'chunk' in place; leaves it untouched if it cannot be optimized
+void optimizeChunk(BytecodeChunk* chunk);
+
+#endif // BYTECODE_OPTIMIZER_H
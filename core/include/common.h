@@ -14,6 +14,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <setjmp.h>
 
 // Unnarize interpreter version
 // Update this string when making a release.
@@ -89,6 +90,9 @@ extern const char* g_source;
 extern const char* g_filename;
 void error(const char* message, int line);
 void errorAtToken(Token token, const char* message);
+// Set by a thread parsing in the background: error() and errorAtToken()
+// jump here, silently, instead of ending the program
+extern _Thread_local jmp_buf* g_errorTrap;
 
 #define GROW_CAPACITY(capacity) \
     ((capacity) < 8 ? 8 : (capacity) * 2)
@@ -1,56 +1,174 @@
 #ifndef UNNARIZE_EXTERN_H
 #define UNNARIZE_EXTERN_H
 
-// Minimal public API for Unnarize external libraries (.so)
-// This header is intentionally small and stable so plugin authors
-// don't need to include internal interpreter headers.
+/**
+ * Native extension ABI
+ * An extension is a shared library imported like a module:
+ *
+ *     import "./vecmath.so" as vec;
+ *
+ * It exports one symbol, UNNA_EXTENSION_SYMBOL, describing its functions.
+ * The interpreter looks it up once, at dlopen, and binds every function as
+ * a native of the module: calls go straight to the C function with the
+ * interpreter's own 64-bit values, with no conversion in either direction.
+ *
+ * This header is self-contained; extensions never include interpreter
+ * headers. UNNA_ABI_VERSION changes whenever anything declared here
+ * changes, and an extension built for another version is refused at
+ * import.
+ */
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Opaque VM forward declaration
-typedef struct VM VM;
+#define UNNA_ABI_VERSION 1
+#define UNNA_EXTENSION_SYMBOL "unnaExtension"
+#define UNNA_EXPORT __attribute__((visibility("default")))
+
+typedef struct VM UnnaVM;       // Opaque
+typedef uint64_t UnnaValue;     // NaN-boxed, bit for bit the interpreter's Value
+
+// ---- Immediate values (no call needed) ----
+// Ints are 32-bit. Booleans are never reported as ints.
+#define UNNA_QNAN       ((uint64_t)0x7ffc000000000000)
+#define UNNA_SIGN_BIT   ((uint64_t)0x8000000000000000)
+#define UNNA_INT_BIT    ((uint64_t)0x0001000000000000)
+
+#define UNNA_NIL        ((UnnaValue)(UNNA_QNAN | 0x0002000000000000))
+#define UNNA_FALSE      ((UnnaValue)(UNNA_QNAN | 0x0003000000000000))
+#define UNNA_TRUE       ((UnnaValue)(UNNA_QNAN | 0x0003000000000001))
+
+#define UNNA_IS_NIL(v)      ((v) == UNNA_NIL)
+#define UNNA_IS_BOOL(v)     (((v) & ~(uint64_t)1) == UNNA_FALSE)
+#define UNNA_IS_INT(v)      (((v) & (UNNA_QNAN | UNNA_INT_BIT)) == (UNNA_QNAN | UNNA_INT_BIT) && !UNNA_IS_BOOL(v))
+#define UNNA_IS_FLOAT(v)    (((v) & UNNA_QNAN) != UNNA_QNAN)
+#define UNNA_IS_NUMBER(v)   (UNNA_IS_INT(v) || UNNA_IS_FLOAT(v))
+#define UNNA_IS_OBJ(v)      (((v) & (UNNA_QNAN | UNNA_SIGN_BIT)) == (UNNA_QNAN | UNNA_SIGN_BIT))
+
+#define UNNA_AS_BOOL(v)     ((v) == UNNA_TRUE)
+#define UNNA_AS_INT(v)      ((int32_t)((v) & 0xFFFFFFFF))
+#define UNNA_BOOL(b)        ((b) ? UNNA_TRUE : UNNA_FALSE)
+#define UNNA_INT(n)         ((UnnaValue)(UNNA_QNAN | UNNA_INT_BIT | (uint32_t)(n)))
+
+static inline double unnaAsFloat(UnnaValue v) {
+    double d;
+    memcpy(&d, &v, sizeof d);
+    return d;
+}
+
+static inline UnnaValue unnaFloat(double d) {
+    UnnaValue v;
+    memcpy(&v, &d, sizeof v);
+    return v;
+}
+
+// Int or float as a double (0 for anything else)
+static inline double unnaAsNumber(UnnaValue v) {
+    if (UNNA_IS_INT(v)) return (double)UNNA_AS_INT(v);
+    return UNNA_IS_FLOAT(v) ? unnaAsFloat(v) : 0.0;
+}
+
+// ---- Objects (through UnnaApi) ----
+typedef enum {
+    UNNA_KIND_NIL,
+    UNNA_KIND_BOOL,
+    UNNA_KIND_INT,
+    UNNA_KIND_FLOAT,
+    UNNA_KIND_STRING,       // Strings, string builders and slices
+    UNNA_KIND_ARRAY,
+    UNNA_KIND_MAP,
+    UNNA_KIND_TYPED_ARRAY,
+    UNNA_KIND_FUNCTION,
+    UNNA_KIND_OTHER         // Modules, structs, resources, futures
+} UnnaKind;
 
-// Public Value types (must mirror interpreter's)
 typedef enum {
-    VAL_INT,
-    VAL_FLOAT,
-    VAL_STRING,
-    VAL_BOOL,
-    VAL_MODULE,
-    VAL_ARRAY,
-    VAL_MAP
-} ValueType;
-
-// Public Value layout (must mirror interpreter's)
-typedef struct Module Module;   // opaque for plugins
-typedef struct Array Array;     // opaque for plugins
-typedef struct Map Map;         // opaque for plugins
-
-typedef struct Value {
-    ValueType type;
-    union {
-        int intVal;
-        double floatVal;
-        char* stringVal; // plugins may allocate strings with malloc/strdup
-        bool boolVal;
-        Module* moduleVal;
-        Array* arrayVal;
-        Map* mapVal;
-    };
-} Value;
-
-// Native function signature for functions exposed to Unnarize
-typedef Value (*NativeFn)(VM*, Value* args, int argCount);
-
-// Registration API exported by the interpreter binary
-void registerNativeFunction(VM* vm, const char* name, NativeFn function);
-
-// Entry point that each external library must export
-void registerFunctions(VM* vm);
+    UNNA_INT32,             // Int32Array elements
+    UNNA_FLOAT64            // Float64Array elements
+} UnnaTypedKind;
+
+// Views borrow the object's storage: no copy is made, and they stay valid
+// until the value is collected or (for arrays) the script changes it.
+typedef struct {
+    const char* chars;      // Not NUL-terminated for slices and builders
+    int length;
+} UnnaStringView;
+
+typedef struct {
+    const UnnaValue* items; // Read-only; write through arraySet
+    int count;
+} UnnaArrayView;
+
+typedef struct {
+    UnnaTypedKind kind;
+    void* data;             // int32_t* or double*; may be written in place
+    int count;
+} UnnaTypedView;
+
+// A GC root held by native code across calls (pin / unpin)
+typedef struct UnnaHandle {
+    UnnaValue value;
+} UnnaHandle;
+
+/**
+ * Interpreter services, passed to UnnaExtension.init. The table lives for
+ * the whole process.
+ *
+ * Functions that create values may run the garbage collector. Values an
+ * extension created and has not yet returned or stored are not roots: pin
+ * them, or create them between deferGC and resumeGC. The batch builders
+ * (newArray, newMap) never collect the values they are given.
+ */
+typedef struct UnnaApi {
+    uint32_t abiVersion;
+
+    UnnaKind (*kind)(UnnaValue v);
+    bool (*stringView)(UnnaValue v, UnnaStringView* out);
+    bool (*arrayView)(UnnaValue v, UnnaArrayView* out);
+    bool (*typedView)(UnnaValue v, UnnaTypedView* out);
+    bool (*mapGet)(UnnaValue map, const char* key, int length, UnnaValue* out);
+
+    UnnaValue (*newString)(UnnaVM* vm, const char* chars, int length);
+    UnnaValue (*newArray)(UnnaVM* vm, const UnnaValue* items, int count);
+    UnnaValue (*newMap)(UnnaVM* vm, const UnnaStringView* keys, const UnnaValue* values, int count);
+    UnnaValue (*newTypedArray)(UnnaVM* vm, UnnaTypedKind kind, const void* data, int count); // data NULL: zeros
+    bool (*arraySet)(UnnaVM* vm, UnnaValue array, int index, UnnaValue v);
+    bool (*arrayPush)(UnnaVM* vm, UnnaValue array, UnnaValue v);
+    bool (*mapSet)(UnnaVM* vm, UnnaValue map, const char* key, int length, UnnaValue v);
+
+    UnnaHandle* (*pin)(UnnaVM* vm, UnnaValue v);
+    void (*unpin)(UnnaVM* vm, UnnaHandle* handle);
+    void (*deferGC)(UnnaVM* vm);
+    void (*resumeGC)(UnnaVM* vm);
+
+    // Call a script function or native; nil (with an error) for anything else
+    UnnaValue (*call)(UnnaVM* vm, UnnaValue function, UnnaValue* args, int argCount);
+    // Print "Error: <message>", as the core libraries do
+    void (*error)(UnnaVM* vm, const char* message);
+} UnnaApi;
+
+// ---- What an extension exports ----
+typedef UnnaValue (*UnnaNativeFn)(UnnaVM* vm, UnnaValue* args, int argCount);
+
+typedef struct {
+    const char* name;
+    UnnaNativeFn function;
+    int arity;              // Documentation only; natives check their own argCount
+} UnnaFunction;
+
+typedef struct {
+    uint32_t abiVersion;            // UNNA_ABI_VERSION the extension was built with
+    const char* name;
+    const UnnaFunction* functions;  // Ends with an entry whose name is NULL
+    // Called once per VM that imports the extension; NULL if not needed.
+    // Returning false fails the import.
+    bool (*init)(UnnaVM* vm, const UnnaApi* api);
+} UnnaExtension;
 
 #ifdef __cplusplus
 }
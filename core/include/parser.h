@@ -2,6 +2,8 @@
 #define PARSER_H
 
 #include "common.h"
+#include "lexer.h"
+#include <stddef.h>
 
 // AST Node types (simplified)
 typedef enum {
@@ -37,6 +39,7 @@ typedef struct Node Node;
 // AST Node structure
 struct Node {
     NodeType type;
+    int line;   // Source line the node starts on (statements) or ends on (expressions)
     union {
         // Literals
         struct {
@@ -170,24 +173,34 @@ struct Node {
     Node* next; // For linked list (function arguments)
 };
 
-// Parser structure with dynamic token array
+// One block of a parser's bump arena
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;    // Older block
+    size_t used;
+    size_t size;
+    max_align_t data[];
+} ArenaBlock;
+
+// Parser pulling tokens from the lexer as it needs them. The tree lives in
+// two bump arenas freed at once: one holding only Nodes (internAST sweeps
+// them in order) and one for statement lists and parameter and field
+// names. Token text is never copied; it points into the source.
 typedef struct {
-    Token* tokens;      // Dynamic array of tokens
-    int current;
-    int count;
-    int capacity;       // Current capacity of the array
+    Lexer lexer;
+    Token current;          // Next token (one token of lookahead)
+    Token previous;         // Token just consumed
+    int tokenCount;         // Tokens scanned so far, EOF included
+    ArenaBlock* nodes;
+    ArenaBlock* data;
 } Parser;
 
-// Initialize parser
-void initParser(Parser* parser);
+// Initialize parser over a NUL-terminated source (allocates nothing)
+void initParser(Parser* parser, const char* source);
 
-// Free parser resources
+// Free the tree parse() built, in one call (the Parser can be reused)
 void freeParser(Parser* parser);
 
-// Add token to parser (grows array as needed)
-void addToken(Parser* parser, Token token);
-
-// Parse tokens into AST
+// Parse the whole source into an AST owned by the parser
 Node* parse(Parser* parser);
 
 #endif // PARSER_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef RUNTIME_EXTENSION_H
+#define RUNTIME_EXTENSION_H
+
+#include "vm.h"
+
+/**
+ * Native extensions (import "./lib.so" as m)
+ * The library's UnnaExtension table (extern.h) is resolved once at dlopen
+ * and each of its functions becomes a native of the returned module. The
+ * handle is kept in vm->externHandles and closed by freeVM.
+ */
+
+// True if an import path names a shared library
+bool isExtensionPath(const char* path);
+
+// Load the extension at 'path' into a new module. Errors are fatal, like a
+// missing .unna module.
+Module* loadExtension(VM* vm, const char* path);
+
+#endif
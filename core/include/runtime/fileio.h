@@ -0,0 +1,38 @@
+#ifndef RUNTIME_FILEIO_H
+#define RUNTIME_FILEIO_H
+
+#include "vm.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Whole-file reads shared by the runtime and the core libraries
+ * Files of FILE_MAP_MIN bytes or more are memory-mapped read-only, so their
+ * bytes come straight from the page cache and are never copied; smaller
+ * files are read into a malloc'd buffer. Either way data[length] is '\0',
+ * so a buffer can be scanned as a C string (the lexer relies on this).
+ */
+
+#define FILE_MAP_MIN (64 * 1024)
+
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t mapped;      // Bytes mapped, 0 if data was malloc'd
+} FileBuffer;
+
+// Load 'path' (mapped if it is large). False if it cannot be opened or read.
+bool fileOpen(const char* path, FileBuffer* out);
+// Load 'path', mapping it whatever its size (callers that madvise)
+bool fileMap(const char* path, FileBuffer* out);
+void fileClose(FileBuffer* file);
+// Let the kernel reclaim the mapped pages before 'offset'. The bytes stay
+// valid; touching them again reads them back from the file.
+void fileDrop(FileBuffer* file, size_t offset);
+
+// String holding the file's bytes; takes ownership of 'file'. A mapped file
+// becomes a string slice over the mapping, which is unmapped when the last
+// string using it is collected. Nil if it is 2GB or larger.
+Value fileString(VM* vm, FileBuffer* file);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef RUNTIME_HEAP_H
+#define RUNTIME_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Object Heap (size-classed slab allocator)
+ * GC objects up to HEAP_MAX_SMALL bytes live in 64KB pages, one size class
+ * per page. A page hands out never-used slots by bumping a pointer and
+ * reuses freed slots through its own free list; a page that empties is
+ * kept for reuse (up to HEAP_EMPTY_PAGE_CACHE) or returned to libc.
+ * Larger objects fall through to malloc. Objects never move.
+ *
+ * Build with -DDEBUG_HEAP_MALLOC to route everything through malloc so
+ * ASAN can see use-after-free on GC objects.
+ */
+
+#define HEAP_PAGE_SIZE         (64 * 1024)
+#define HEAP_SIZE_CLASSES      8
+#define HEAP_MAX_SMALL         256
+#define HEAP_EMPTY_PAGE_CACHE  8
+
+typedef struct HeapPage HeapPage;
+
+struct HeapPage {
+    HeapPage* next;         // Next page in the class's partial list
+    HeapPage* prev;
+    void* freeList;         // Freed slots (singly linked through the slot)
+    char* bump;             // First never-used slot
+    char* end;
+    uint32_t slotSize;
+    uint32_t liveCount;     // Slots currently handed out
+    uint8_t sizeClass;
+    bool inPartialList;
+};
+
+typedef struct HeapClass {
+    HeapPage* current;      // Page allocations come from
+    HeapPage* partial;      // Other pages with free slots
+} HeapClass;
+
+typedef struct Heap {
+    HeapClass classes[HEAP_SIZE_CLASSES];
+    HeapPage* emptyPages;   // Released pages kept for reuse
+    int emptyPageCount;
+    size_t pageCount;       // Pages currently owned (including empty cache)
+    size_t largeBytes;      // Bytes in objects served by malloc
+    pthread_mutex_t lock;   // Held only while a concurrent GC sweeps
+    volatile int concurrent; // The owning VM's concurrent GC is running
+} Heap;
+
+void initHeap(Heap* heap);
+void freeHeap(Heap* heap);
+
+// 'size' must be the same on free as on allocation
+void* heapAlloc(Heap* heap, size_t size);
+void heapFree(Heap* heap, void* pointer, size_t size);
+
+#endif // RUNTIME_HEAP_H
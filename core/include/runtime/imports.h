@@ -0,0 +1,64 @@
+#ifndef RUNTIME_IMPORTS_H
+#define RUNTIME_IMPORTS_H
+
+#include "vm.h"
+#include "bytecode/chunk.h"
+#include "runtime/fileio.h"
+
+/**
+ * Import resolution and the compiled-module cache
+ *
+ * Each import path is resolved once per VM and then found by a hash
+ * lookup. Paths that reach the same file (device and inode) share one
+ * compiled image in the .unnac format (bytecode/cache.h). Importing a
+ * module again only loads that image into a fresh module environment,
+ * instead of lexing, parsing and compiling it again.
+ *
+ * Before the entry script runs, precompileImports() looks for the imports
+ * in its bytecode and compiles them on worker threads. Each worker has its
+ * own compile-only VM. The imports of each finished module are queued in
+ * turn, so the whole static import graph is compiled in parallel with the
+ * script's start. An import that reaches a module a worker is still
+ * compiling waits for it. An import that reaches a queued module compiles
+ * it on the spot. A module a worker cannot compile (missing, or a syntax
+ * error) is left to the import, which reports the error as it always has.
+ */
+
+typedef struct ModuleImage ModuleImage;
+
+typedef struct ImportEntry {
+    char* path;                 // Import path joined with the importer's directory
+    unsigned int hash;
+    ModuleImage* image;         // Shared by every path that names the same file
+    struct ImportEntry* next;
+} ImportEntry;
+
+// Resolve 'rawPath' as imported by code from 'importerPath' (NULL outside
+// any module). A path starting with '.' is relative to the importer's
+// directory; others are used as written. The entry is owned by the VM.
+ImportEntry* resolveImport(VM* vm, const char* importerPath, const char* rawPath);
+
+// The Function a module's top level runs as (roots the chunk's constants)
+Function* newModuleFunction(VM* vm, BytecodeChunk* chunk, const char* path, Environment* env);
+
+// Fill 'chunk' (initialized and owned by a rooted Function) with the module
+// compiled against vm->globalEnv: from its image, its .unnac cache, or by
+// compiling 'source' (left open for the caller to close once the module
+// has run). Returns false if the source cannot be read.
+bool loadModule(VM* vm, ImportEntry* entry, BytecodeChunk* chunk, FileBuffer* source);
+
+// Start compiling the imports of 'chunk', a script at 'path', in the
+// background. With 'writeCaches', each module compiled is also saved as
+// its .unnac cache. There is a worker per core but one;
+// UNNARIZE_IMPORT_THREADS overrides that (0 turns precompiling off,
+// except for --compile).
+void precompileImports(VM* vm, const char* path, BytecodeChunk* chunk, bool writeCaches);
+
+// Wait until the workers have compiled everything they found. With
+// 'writeCaches', lists the caches written and the modules skipped.
+void finishPrecompile(VM* vm);
+
+// Stop the workers and free the cache (freeVM)
+void freeImports(VM* vm);
+
+#endif // RUNTIME_IMPORTS_H
@@ -0,0 +1,54 @@
+#ifndef RUNTIME_ISOLATE_H
+#define RUNTIME_ISOLATE_H
+
+#include "vm.h"
+
+/**
+ * Isolates: independent VMs in one process
+ * An isolate has its own heap, string pool, globals, register file and
+ * core library state and shares nothing mutable with the VM that created
+ * it, so each can run on its own thread without locks. Code and data cross
+ * between VMs only by copying: functions are rebuilt from their bytecode
+ * together with the globals they use, and values are deep-copied. The one
+ * exception is a shareable resource (a ucoreThread channel), which does
+ * its own locking.
+ */
+
+// Register the built-in natives and every core library (ucoreJson, ...)
+void registerCoreLibraries(VM* vm);
+
+// A fresh VM with the core libraries and the parent's script directory and
+// argv. 'registers' sizes its register files (0 = STACK_MAX).
+VM* isolateCreate(VM* parent, int registers);
+void isolateDestroy(VM* isolate);
+
+// Copy 'value' from 'from' into 'to'. Strings, arrays, typed arrays, maps
+// and structs are copied deeply (shared and cyclic references are
+// preserved); bytecode functions are imported with the globals they
+// reference, and natives and core modules resolve to the target's own.
+// Resources are copied only if they can be shared (channels). Anything else
+// (files, sockets, futures) becomes nil and clears *ok. Neither VM may be
+// running on another thread.
+Value isolateCopy(VM* to, VM* from, Value value, bool* ok);
+
+// isolateCopy, except that typed arrays move their buffers to 'to' instead
+// of copying them; the originals in 'from' are left with length 0.
+Value isolateTransfer(VM* to, VM* from, Value value, bool* ok);
+
+// One slice of a data source. 'next' reads the slice's records into the
+// isolate that runs it; 'state' is the source's cursor for the slice.
+typedef struct {
+    ResourceNextFn next;
+    void* state;
+} Partition;
+
+// Run fn(record) over each partition on its own thread and isolate.
+// Results that are nil are dropped. Without 'reduce' the rest are returned
+// as one Array in partition order; with it, each partition folds its
+// results with reduce(acc, result) and the partial results are folded
+// again in 'vm' (nil if there were none). Returns false, after printing
+// why, if the functions cannot be copied into an isolate.
+bool isolateParallelMap(VM* vm, Function* fn, Function* reduce,
+                        Partition* parts, int count, Value* out);
+
+#endif // RUNTIME_ISOLATE_H
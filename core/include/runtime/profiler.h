@@ -0,0 +1,104 @@
+#ifndef RUNTIME_PROFILER_H
+#define RUNTIME_PROFILER_H
+
+#include "vm.h"
+#include "bytecode/chunk.h"
+#include "bytecode/opcodes.h"
+#include <stdint.h>
+
+/**
+ * Profiler (--profile)
+ * Compiled in only with -DUNNARIZE_PROFILE (make profile); without it the
+ * hooks below expand to nothing and the dispatch loop is unchanged.
+ *
+ * Counting mode counts every dispatched opcode and instruction (mapped to
+ * source lines through BytecodeChunk.lineNumbers) and times each call, so
+ * per-function self and total time are exact but the script runs slower.
+ * Sampling mode only tags call frames; a SIGPROF timer walks vm->callStack
+ * and the stacks are written as flamegraph folded lines ("a;b;c count").
+ */
+
+typedef enum {
+    PROFILE_COUNT,      // Opcode, line and per-function counters, report on stderr
+    PROFILE_SAMPLE      // SIGPROF stack samples, folded stacks written to a file
+} ProfileMode;
+
+// One function (bytecode or native) seen while profiling
+typedef struct ProfileEntry {
+    Function* function;     // Key (compared only, not a GC root)
+    char* name;
+    char* file;             // Defining script, NULL for natives
+    BytecodeChunk* chunk;
+    uint64_t* hits;         // Per instruction of 'chunk' (counting mode)
+    uint64_t calls;
+    uint64_t totalNanos;    // Outermost activations only, so recursion counts once
+    uint64_t selfNanos;
+    int active;             // Activations currently on a call stack
+} ProfileEntry;
+
+typedef struct Profiler {
+    ProfileMode mode;
+    PerformanceCounters counters;
+    uint64_t opCounts[OPCODE_COUNT];
+    uint64_t startNanos;
+
+    ProfileEntry** slots;   // Open addressing by Function*
+    int capacity;           // Power of two
+    int count;
+
+    // Sampling: [depth, entry...] records, appended by the SIGPROF handler
+    char* foldedPath;
+    void** samples;
+    size_t sampleUsed;
+    size_t sampleCapacity;
+    uint64_t sampleCount;
+    uint64_t samplesDropped;
+} Profiler;
+
+// Start profiling 'vm'; foldedPath is the output of sampling mode
+void profilerStart(VM* vm, ProfileMode mode, const char* foldedPath);
+// Stop, print the report (or write the folded stacks) and free everything
+void profilerStop(VM* vm);
+
+void profileEnter(VM* vm, CallFrame* frame, Function* fn);
+void profileLeave(VM* vm, CallFrame* frame);
+
+// Native call in progress (kept on the caller's C stack)
+typedef struct {
+    CallFrame* frame;
+    ProfileEntry* entry;
+    ProfileEntry* prevNative;
+    uint64_t start;
+    uint64_t children;
+} ProfileNativeCall;
+
+void profileNativeBegin(VM* vm, Function* fn, ProfileNativeCall* call);
+void profileNativeEnd(VM* vm, ProfileNativeCall* call);
+
+// Instruction counters for 'chunk' if it is the top frame's (counting mode)
+uint64_t* profileHits(VM* vm, BytecodeChunk* chunk);
+
+#ifdef UNNARIZE_PROFILE
+#define PROFILE_ENTER(vm, frame, fn) do { \
+        if ((vm)->profiler) profileEnter((vm), (frame), (fn)); \
+    } while (0)
+#define PROFILE_LEAVE(vm, frame) do { \
+        if ((vm)->profiler) profileLeave((vm), (frame)); \
+    } while (0)
+#define PROFILE_NATIVE_CALL(vm, fn, call) do { \
+        if ((vm)->profiler) { \
+            ProfileNativeCall _profCall; \
+            profileNativeBegin((vm), (fn), &_profCall); \
+            call; \
+            profileNativeEnd((vm), &_profCall); \
+        } else { \
+            call; \
+        } \
+    } while (0)
+#else
+#define PROFILE_ENTER(vm, frame, fn) ((void)0)
+#define PROFILE_LEAVE(vm, frame) ((void)0)
+#define PROFILE_NATIVE_CALL(vm, fn, call) do { call; } while (0)
+#endif
+
+#endif // RUNTIME_PROFILER_H
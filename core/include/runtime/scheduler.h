@@ -0,0 +1,38 @@
+#ifndef RUNTIME_SCHEDULER_H
+#define RUNTIME_SCHEDULER_H
+
+#include "vm.h"
+#include <poll.h>
+#include <stdint.h>
+
+/**
+ * Cooperative Async Scheduler
+ * Each async call runs as a coroutine with its own C stack, register file
+ * and call stack. It starts eagerly and runs until it first suspends
+ * (await on a pending Future, sleep, or waiting for a socket or pipe),
+ * then the caller continues with the task's Future.
+ */
+
+// Start an async call; returns its Future once the task first suspends or finishes
+Value spawnTask(VM* vm, Function* func, Value* args, int argCount);
+
+// Wait for a Future. Inside a task this suspends the task; in the main
+// program it runs other tasks until the Future resolves.
+void awaitFuture(VM* vm, Future* future);
+
+// Cooperative replacements for blocking waits (fall back to blocking
+// waits that still run ready tasks when called from the main program)
+void taskSleep(VM* vm, uint64_t micros);
+void taskWaitFd(VM* vm, int fd, short events);
+// Wait until any of 'fds' is ready; their revents say which. From the main
+// program with no tasks this is a plain blocking poll().
+void taskWaitPoll(VM* vm, struct pollfd* fds, int count);
+
+// Run until every spawned task has finished
+void runScheduler(VM* vm);
+
+// GC / teardown hooks
+void markTasks(VM* vm);
+void freeTasks(VM* vm);
+
+#endif // RUNTIME_SCHEDULER_H
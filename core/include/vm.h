@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "parser.h"
+#include "runtime/heap.h"
 #include <pthread.h>
 #include <stdint.h>
 #include <string.h> // For NanBoxing memcpy
@@ -20,7 +21,10 @@ typedef enum {
     OBJ_NATIVE,
     OBJ_FUTURE,
     OBJ_UPVALUE,
-    OBJ_ENVIRONMENT
+    OBJ_ENVIRONMENT,
+    OBJ_STRING_BUILDER,
+    OBJ_TYPED_ARRAY,
+    OBJ_STRING_SLICE
 } ObjType;
 
 typedef struct Obj Obj;
@@ -28,11 +32,18 @@ typedef struct Obj Obj;
 struct Obj {
     ObjType type;
     bool isMarked;
-    bool isPermanent;   // If true, never swept or unmarked
-    uint8_t generation;  // 0 = young (nursery), 1+ = old
+    bool isPermanent;   // If true, never swept (still traced, so its children stay alive)
+    uint8_t generation;  // Minor collections survived while young; GC_GEN_OLD once promoted
+    bool isRemembered;   // Old object listed in vm->remembered
     Obj* next;
 };
 
+#define GC_TENURE_AGE 2         // Minor collections survived before promotion
+#define GC_GEN_OLD    0xFF      // 'generation' of objects on the old list
+#define GC_MAX_MARK_THREADS 16  // Upper bound on parallel marker threads
+#define GC_PAUSE_BUCKETS    8   // Pause histogram: <100us, <500us, <1ms, <5ms, <10ms, <50ms, <100ms, more
+#define GC_PAUSE_BUCKET_LIMITS {100, 500, 1000, 5000, 10000, 50000, 100000}
+
 // Value types for VM (kept for compatibility and helper)
 typedef enum {
     VAL_BOOL,
@@ -82,6 +93,11 @@ static inline Value numToValue(double d) {
 #define IS_NIL(v)     ((v) == TAGGED_NIL)
 #define NIL_VAL       TAGGED_NIL
 
+// Marks a global slot the compiler reserved but no DEFGLOBAL/SETGLOBAL filled yet.
+// Never visible to scripts.
+#define UNDEFINED_VAL   ((Value)(QNAN | 0x0002000000000001))
+#define IS_UNDEFINED(v) ((v) == UNDEFINED_VAL)
+
 #define IS_BOOL(v)    (((v) & 0xFFFFFFFFFFFFFFFE) == TAGGED_FALSE)
 #define AS_BOOL(v)    ((v) == TAGGED_TRUE)
 #define BOOL_VAL(b)   ((b) ? TAGGED_TRUE : TAGGED_FALSE)
@@ -109,22 +125,92 @@ static inline ValueType getValueType(Value v) {
 #define IS_STRING(value)  (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_STRING)
 #define IS_ARRAY(value)   (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_ARRAY)
 #define IS_MAP(value)     (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_MAP)
+#define IS_STRING_BUILDER(value) (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_STRING_BUILDER)
+#define AS_STRING_BUILDER(value) ((StringBuilder*)AS_OBJ(value))
+#define IS_STRING_SLICE(value) (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_STRING_SLICE)
+#define AS_STRING_SLICE(value) ((StringSlice*)AS_OBJ(value))
+#define IS_TYPED_ARRAY(value) (IS_OBJ(value) && AS_OBJ(value)->type == OBJ_TYPED_ARRAY)
+#define AS_TYPED_ARRAY(value) ((TypedArray*)AS_OBJ(value))
 
 typedef struct ObjString {
     Obj obj;
-    char* chars;
     int length;
-    unsigned int hash;
+    unsigned int hash;  // Use stringHash(): 0 until first use for long strings
+    char chars[];       // Inline, NUL-terminated (one allocation per string)
 } ObjString;
 
+// Mutable string being built ("sb + x" appends in place). Flattened to an
+// interned ObjString when hashed, compared or passed to a native.
+typedef struct StringBuilder {
+    Obj obj;
+    char* chars;        // NUL-terminated, grown by doubling
+    int length;
+    int capacity;
+} StringBuilder;
+
+// Read-only view of part of a string (substr, slice) or of a mapped file:
+// shares the parent's characters instead of copying them. Like a builder, it
+// is flattened to an interned ObjString when passed to a native.
+typedef struct StringSlice {
+    Obj obj;
+    Obj* parent;        // ObjString or mapped-file ObjResource; kept alive by the slice
+    const char* chars;  // Into the parent's bytes, not NUL-terminated
+    int length;
+} StringSlice;
+
+// Packed numeric array (ucoreArray.int32/float64): raw elements, no boxing.
+// The length is fixed at creation; stores are checked against kind and range.
+typedef enum {
+    TYPED_INT32,
+    TYPED_FLOAT64
+} TypedKind;
+
+typedef struct TypedArray {
+    Obj obj;
+    TypedKind kind;
+    int count;
+    union {
+        int32_t* i32;
+        double* f64;
+        void* data;     // malloc'd, charged to bytesAllocated
+    };
+} TypedArray;
+
+static inline size_t typedElementSize(TypedKind kind) {
+    return kind == TYPED_INT32 ? sizeof(int32_t) : sizeof(double);
+}
+
+// Element 'idx' as a Value (nil when out of range)
+static inline Value typedArrayGet(TypedArray* ta, int idx) {
+    if ((unsigned)idx >= (unsigned)ta->count) return NIL_VAL;
+    return ta->kind == TYPED_INT32 ? INT_VAL(ta->i32[idx]) : FLOAT_VAL(ta->f64[idx]);
+}
+
+// Store a number at 'idx'. Floats stored in an Int32Array are truncated.
+// False if 'idx' is out of range or 'v' does not fit the element type.
+static inline bool typedArraySet(TypedArray* ta, int idx, Value v) {
+    if ((unsigned)idx >= (unsigned)ta->count) return false;
+    if (ta->kind == TYPED_INT32) {
+        if (IS_INT(v)) { ta->i32[idx] = AS_INT(v); return true; }
+        if (!IS_FLOAT(v)) return false;
+        double d = AS_FLOAT(v);
+        if (!(d > -2147483649.0 && d < 2147483648.0)) return false;
+        ta->i32[idx] = (int32_t)d;
+        return true;
+    }
+    if (IS_INT(v)) { ta->f64[idx] = (double)AS_INT(v); return true; }
+    if (!IS_FLOAT(v)) return false;
+    ta->f64[idx] = AS_FLOAT(v);
+    return true;
+}
+
 // Forward declarations
 typedef struct VarEntry VarEntry;
-typedef struct FuncEntry FuncEntry;
 typedef struct Function Function;
 typedef struct Environment Environment;
 typedef struct CallFrame CallFrame;
 typedef struct VM VM;
-typedef struct ModuleEntry ModuleEntry;
+typedef struct ImportCache ImportCache;
 
 // Typedefs for object structs
 typedef struct Module Module;
@@ -138,32 +224,33 @@ typedef struct Future Future;
 // Native function type for external C functions
 typedef Value (*NativeFn)(VM*, Value* args, int argCount);
 
-// Variable entry structure for hash table
+// Variable entry: one slot in an Environment's dense variable table.
+// Slots are never removed, so an entry's index is stable for the lifetime
+// of its Environment (pointers are not: the table may be reallocated).
 struct VarEntry {
     char* key;              // Variable name (points to keyString->chars)
     int keyLength;          // Length of key
-    bool ownsKey; 
+    unsigned int hash;      // Full hash of key (keyString->hash)
     ObjString* keyString;   // Reference to interned string for GC marking
     Value value;            // Variable value
-    struct VarEntry* next;  // Next entry in hash bucket
-};
-
-// Function entry structure for hash table
-struct FuncEntry {
-    char* key;              // Function name (points to keyString->chars)
-    ObjString* keyString;   // Reference to interned string for GC marking
-    Function* function;     // Function definition
-    struct FuncEntry* next; // Next entry in hash bucket
 };
 
-// Initial hash table size for environments (increased to next prime ~256)
+// Fixed table size for the module cache and extern handle slots
 #define TABLE_SIZE 1021
 
-// String interning pool for performance optimization
+// Environments and Maps start with this many index slots, doubling at 75% load
+#define HASH_MIN_CAPACITY 8   // Must be a power of two
+#define HASH_EMPTY_SLOT (-1)
+
+// String interning pool: open-addressing hash set keyed on ObjString->hash
+// Slots are NULL (empty), STRING_POOL_TOMBSTONE (removed by GC) or a live string.
+#define STRING_POOL_TOMBSTONE ((ObjString*)(uintptr_t)1)
+#define STRING_POOL_MIN_CAPACITY 64   // Must be a power of two
+
 typedef struct StringPool {
-    char** strings;  // Actually ObjString* cast to char*
-    unsigned int* hashes;
-    int count;
+    ObjString** entries;  // Hash slots (capacity is a power of two)
+    int count;            // Live strings
+    int tombstones;       // Removed slots awaiting rehash
     int capacity;
     pthread_mutex_t lock; // Protects concurrent access
 } StringPool;
@@ -177,11 +264,16 @@ typedef struct ValuePool {
 } ValuePool;
 
 // Environment structure (scope)
+// Variables (functions included) live in a dense array in definition order;
+// 'index' is an open-addressing table of positions into it.
 struct Environment {
     Obj obj;                           // Header for GC
     struct Environment* enclosing;     // Parent environment
-    VarEntry* buckets[TABLE_SIZE];     // Variable hash table
-    FuncEntry* funcBuckets[TABLE_SIZE]; // Function hash table
+    VarEntry* vars;                    // Dense variable slots
+    int count;                         // Used slots
+    int capacity;                      // Allocated slots
+    int* index;                        // Hash slots -> vars position (HASH_EMPTY_SLOT if unused)
+    int indexCapacity;                 // Power of two, 0 until the first define
 };
 
 // Module wrapper
@@ -192,26 +284,43 @@ struct Module {
     char* source;
 };
 
+// Items buffer shared by an array and its slices (copy-on-write). Any
+// array with a 'share' copies its own items out before writing to them.
+typedef struct ArrayShare {
+    Value* items;
+    size_t bytes;           // Charged to bytesAllocated, returned with the last reference
+    int refs;
+} ArrayShare;
+
 // Minimal dynamic array implementation
 struct Array {
     Obj obj;
     Value* items;
     int count;
     int capacity;
+    ArrayShare* share;      // NULL if 'items' is owned (see arrayDetach)
 };
 
 // Map entry
 struct MapEntry {
     bool isIntKey;
-    char* key; // Or ObjString*? For now char* interned
+    char* key;              // Owned copy of string key (NULL for int keys)
+    int keyLength;
     int intKey;
+    unsigned int hash;      // Full hash of key
     Value value;
-    MapEntry* next;
 };
 
+// Insertion-ordered hash map: dense entry array plus an open-addressing index.
+// Iterate with: for (int i = 0; i < m->count; i++) { MapEntry* e = &m->entries[i]; ... }
 struct Map {
     Obj obj;
-    MapEntry* buckets[TABLE_SIZE];
+    VM* vm;                 // Owning VM (table growth is charged to bytesAllocated)
+    MapEntry* entries;      // Dense entries in insertion order
+    int count;              // Used entries
+    int capacity;           // Allocated entries
+    int* index;             // Hash slots -> entries position (HASH_EMPTY_SLOT if unused)
+    int indexCapacity;      // Power of two, 0 until the first insert
 };
 
 struct StructDef {
@@ -224,7 +333,8 @@ struct StructDef {
 struct StructInstance {
     Obj obj;
     StructDef* def;
-    Value* fields;
+    int fieldCount;         // def's, kept so a sweep never reads a dead def
+    Value fields[];         // Allocated with the instance
 };
 
 struct Future {
@@ -236,10 +346,16 @@ struct Future {
 };
 
 typedef void (*ResourceCleanupFn)(void* data);
+// Store the resource's next element in *out; false once it is exhausted
+typedef bool (*ResourceNextFn)(VM* vm, void* data, Value* out);
+// Data for a second handle, in another VM, to the same resource
+typedef void* (*ResourceShareFn)(void* data);
 typedef struct {
     Obj obj;
     void* data;
     ResourceCleanupFn cleanup;
+    ResourceNextFn next;        // Steps the resource in foreach; NULL if not iterable
+    ResourceShareFn share;      // Makes the resource copyable between VMs; NULL if it is not
 } ObjResource;
 
 // Function structure
@@ -252,6 +368,7 @@ struct Function {
     Environment* closure;
     bool isNative;
     NativeFn native;
+    bool keepsViews;        // Native takes builder and string slice arguments as they are
     bool isAsync;
     struct BytecodeChunk* bytecodeChunk; // Bytecode for this function
     char* modulePath; // Path of the module/file this function is defined in
@@ -261,7 +378,8 @@ struct Function {
 // Forward declaration
 struct BytecodeChunk;
 
-#define STACK_MAX 65536           // Register file size (shared across all frames)
+#define STACK_MAX 65536           // Default register file size (shared across all frames)
+#define ROOT_STACK_MAX 8192       // vm->stack slots
 #define CALL_STACK_MAX 1024       // Maximum call stack depth
 #define FRAME_REG_MAX 256         // Maximum registers per function frame
 
@@ -273,24 +391,26 @@ struct CallFrame {
     Value returnValue;      // Function return value
     bool hasReturned;       // Whether function has returned
     int resultReg;          // Caller's register to store return value
+    int regTop;             // Caller's register top (native re-entry frames)
 
     // Bytecode support
     uint32_t* ip;           // Return address (caller's IP)
     struct BytecodeChunk* chunk; // Caller's chunk
     struct Function* function;   // Executing function (GC Root)
-};
 
-// Module cache entry
-struct ModuleEntry {
-    char* name;
-    int nameLen;
-    Module* module;
-    struct ModuleEntry* next;
+#ifdef UNNARIZE_PROFILE
+    // Profiling builds only (make profile), filled while --profile runs
+    struct ProfileEntry* profEntry;  // Function running in this frame
+    struct ProfileEntry* profNative; // Native it is calling, if any
+    uint64_t profStart;              // Entry time (ns)
+    uint64_t profChildren;           // Time spent in callees (ns)
+#endif
 };
 
 
 
-// Performance tracking structure
+
+// Performance tracking structure (filled by the --profile report)
 typedef struct {
     uint64_t instructionsExecuted;   // Total operations executed
     uint64_t loopsExecuted;          // Loop iterations
@@ -299,67 +419,117 @@ typedef struct {
     uint64_t totalTimeMicros;        // Total execution time
 } PerformanceCounters;
 
-// Async Task for event loop
-typedef struct {
-    Future* future;         // The Future this task will resolve
-    Function* func;         // Function to execute
-    Value* args;           // Arguments array
-    int argCount;          // Number of arguments
-    bool started;          // Has execution started?
-    bool completed;        // Is execution complete?
-} Task;
+// Async task (coroutine), defined by the scheduler in runtime/scheduler.c
+typedef struct Task Task;
+
+// Execution state owned by one coroutine: the main program or an async task.
+// Switching coroutines swaps these fields in and out of the VM.
+typedef struct ExecState {
+    Value* registers;
+    int regBase;
+    int regTop;
+    CallFrame* callStack;
+    int callStackTop;
+    Environment* globalEnv;
+    struct ExecState* prev;         // Next suspended resumer (walked by the GC)
+} ExecState;
+
+// Per-VM state of a core library (routes, last loaded file, ...), found by
+// the address of a key the library owns and freed with the VM
+typedef struct LibState {
+    const void* key;
+    void* data;
+    void (*destroy)(void* data);
+    struct LibState* next;
+} LibState;
 
 // Virtual Machine structure
 struct VM {
-    Value registers[STACK_MAX];     // Register file (shared across all frames)
+    Value* registers;               // Register file of the running coroutine (regCapacity slots)
+    int regCapacity;                // Slots in each register file: the main program's and every task's
     int regTop;                     // Next free register index
     int regBase;                    // Current frame's base register
     // Legacy stack compat (used by AST walker)
-    Value stack[8192];              // Small stack for AST walker compatibility
+    Value stack[ROOT_STACK_MAX];    // Small stack for AST walker compatibility
     int stackTop;                   // Stack pointer (AST walker)
     int fp;                         // Frame pointer (AST walker)
     Environment* env;               // Current environment
     Environment* globalEnv;         // Global environment
     Environment* defEnv;            // Target environment for function definitions
-    CallFrame callStack[CALL_STACK_MAX]; // Call stack
+    CallFrame* callStack;           // Call stack of the running coroutine (CALL_STACK_MAX frames)
     int callStackTop;               // Call stack pointer
     char projectRoot[1024];         // Project root directory for module search
     char scriptDir[1024];            // Directory containing the running script (for relative paths)
-    ModuleEntry* moduleBuckets[TABLE_SIZE]; // Module cache by name
+    ImportCache* imports;           // Resolved import paths and compiled modules (runtime/imports.c)
     void* externHandles[TABLE_SIZE]; // Handles for dlopen() libraries
     int externHandleCount;          // Count of loaded extern libraries
     StringPool stringPool;          // String interning pool for performance
     ValuePool valuePool;            // Value pool for basic types
     
     // GC State (Enhanced)
+    Heap heap;                      // Slab pages backing every GC object
     Obj* objects;                   // Linked list of all objects (old gen)
     Obj* nursery;                   // Young generation objects
     int nurseryCount;               // Count of nursery objects
-    int nurseryThreshold;           // Trigger minor GC when exceeded
+    size_t nurseryBudget;           // Bytes allocated between minor collections
+    size_t nextMajorGC;             // Heap size at which the next collection is a full one
+    Obj* sweepPending;              // Old objects not yet swept after a major mark (swept lazily)
+    size_t sweepFreedBytes;         // Bytes freed by the current major collection so far
+    size_t sweepStartBytes;         // Heap size when that collection started
+    int gcMarkThreads;              // Marker threads for a major mark of a large heap
+    Obj** remembered;               // Old objects that may reference nursery objects
+    int rememberedCount;
+    int rememberedCapacity;
     int grayCount;
     int grayCapacity;
     Obj** grayStack;
+    Obj** pinned;                   // Objects held by native code (extra GC roots)
+    int pinnedCount;
+    int pinnedCapacity;
     size_t bytesAllocated;
     size_t nextGC;
+    int gcDeferDepth;               // deferCollections() nesting
+    size_t gcDeferredNextGC;        // nextGC to restore when the outermost deferral ends
     int gcPhase;                    // 0=idle, 1=marking, 2=sweeping
+    bool gcMinorActive;             // Marking the nursery only: old objects are not traced
+    pthread_mutex_t gcMutex;        // Guards the gray stack while a concurrent mark runs
+    volatile int gcConcurrentActive; // A background thread is marking or sweeping this heap
     
     // GC Statistics
     uint64_t gcCollectCount;        // Total GC runs
+    uint64_t gcMinorCount;          // Nursery-only collections (included in gcCollectCount)
     uint64_t gcTotalPauseUs;        // Total pause time (microseconds)
     uint64_t gcLastPauseUs;         // Last GC pause time
     uint64_t gcTotalFreed;          // Total bytes freed
     size_t gcPeakMemory;            // Peak memory usage
     uint64_t gcLastCollectTime;     // Timestamp of last GC (for pacing)
     size_t gcBytesAllocSinceGC;     // Bytes allocated since last GC
+    uint64_t gcMaxPauseUs;          // Longest single pause
+    uint64_t gcPauseHistogram[GC_PAUSE_BUCKETS]; // Pause counts, bucketed by GC_PAUSE_BUCKET_LIMITS
+    uint64_t gcStartTimeUs;         // VM start (for the allocation rate)
+
+    // GC Tuning (ucoreGC)
+    uint64_t gcTargetPauseUs;       // Pause budget; 0 = full collections stop the world
+    int gcIncrementalUnits;         // Objects traced per incremental step, adapted to the budget
+    size_t gcMaxHeadroom;           // Growth allowed past the live heap; 0 = proportional
     
     // CLI Arguments
     int argc;
     char** argv;
     
     // Async Task Queue
-    Task* taskQueue;
+    Task** taskQueue;               // Live (unfinished) tasks
     int taskCount;
     int taskCapacity;
+    Task* currentTask;              // Task being executed (NULL = main program)
+    ExecState* suspendedExec;       // Coroutines waiting for a resumed task to yield
+
+    // Profiling (--profile, profiling builds only)
+    struct Profiler* profiler;      // NULL unless a profile is being taken
+
+    bool jitEnabled;                // Hot chunks get native code (bytecode/jit.h); UNNARIZE_JIT=0 turns it off
+
+    LibState* libStates;            // Core library state owned by this VM
 };
 
 // VM function prototypes
@@ -370,6 +540,13 @@ struct VM {
  */
 void initVM(VM* vm);
 
+/**
+ * Initialize a virtual machine with a register file of a given size
+ * @param vm Pointer to VM structure
+ * @param registers Register file slots (at least FRAME_REG_MAX)
+ */
+void initVMWithRegisters(VM* vm, int registers);
+
 /**
  * Free all VM resources
  * @param vm Pointer to VM structure
@@ -379,29 +556,65 @@ void freeVM(VM* vm);
 /**
  * Interpret and execute AST
  * @param vm Pointer to VM structure
+ * @param parser Parser that built the AST (owns its nodes)
  * @param ast Root AST node to execute
  */
-void interpret(VM* vm, Node* ast);
+void interpret(VM* vm, Parser* parser, Node* ast);
 
 // Exposed internal API for external libraries to register native functions
 void registerNativeFunction(VM* vm, const char* name, NativeFn function);
 
 // Core Helpers exposed for corelib
 unsigned int hash(const char* key, int length);
+// Hash of a string object (long strings compute it on first use)
+static inline unsigned int stringHash(ObjString* s) {
+    if (s->hash == 0 && s->length > 0) s->hash = hash(s->chars, s->length);
+    return s->hash;
+}
 Map* newMap(VM* vm);
 Array* newArray(VM* vm);
+TypedArray* newTypedArray(VM* vm, TypedKind kind, int count); // Zero-filled
+StructInstance* newStructInstance(VM* vm, StructDef* def); // Fields nil
 void mapSetStr(Map* m, const char* key, int len, Value v);
+void mapSetStrHashed(Map* m, const char* key, int len, unsigned int h, Value v); // h = hash(key, len)
 void mapSetInt(Map* m, int ikey, Value v);
 MapEntry* mapFindEntry(Map* m, const char* skey, int slen, int* bucketOut);
 MapEntry* mapFindEntryInt(Map* m, int ikey, int* bucketOut);
+Environment* newEnvironment(VM* vm, Environment* enclosing);
+VarEntry* envFindEntry(Environment* env, const char* key, int length, unsigned int hash);
+VarEntry* envSet(VM* vm, Environment* env, ObjString* key, Value value);
+int envReserveSlot(VM* vm, Environment* env, ObjString* key);
 void arrayPush(VM* vm, Array* a, Value v);
 bool arrayPop(Array* array, Value* value);
-char* readFileAll(const char* path);
+Array* arraySlice(VM* vm, Array* a, int start, int end);  // Shares a's items
+void arrayDetach(VM* vm, Array* a);                         // Own copy of a shared array's items
+// Call before writing to a->items
+static inline void arrayWritable(VM* vm, Array* a) {
+    if (a->share) arrayDetach(vm, a);
+}
 Value callFunction(VM* vm, Function* func, Value* args, int argCount);
 Function* findFunctionByName(VM* vm, const char* name);
 void defineGlobal(VM* vm, const char* name, Value value);
-void defineNative(VM* vm, Environment* env, const char* name, NativeFn fn, int arity);
+Function* defineNative(VM* vm, Environment* env, const char* name, NativeFn fn, int arity);
 ObjString* internString(VM* vm, const char* str, int length);
+const char* valueText(Value value, char* buf, int* length); // buf: 64 bytes
+StringBuilder* newStringBuilder(VM* vm);
+void builderAppend(VM* vm, StringBuilder* sb, const char* chars, int length);
+void builderAppendValue(VM* vm, StringBuilder* sb, Value value);
+ObjString* flattenBuilder(VM* vm, StringBuilder* sb);
+Value stringSlice(VM* vm, Value str, int start, int end); // str: string or slice
+Value bufferSlice(VM* vm, Obj* owner, const char* chars, int length);
+ObjString* flattenSlice(VM* vm, StringSlice* slice);
+// Text of a string, builder or slice without copying; false for anything else
+static inline bool viewText(Value v, const char** chars, int* length) {
+    if (!IS_OBJ(v)) return false;
+    Obj* o = AS_OBJ(v);
+    if (o->type == OBJ_STRING) { *chars = ((ObjString*)o)->chars; *length = ((ObjString*)o)->length; }
+    else if (o->type == OBJ_STRING_SLICE) { *chars = ((StringSlice*)o)->chars; *length = ((StringSlice*)o)->length; }
+    else if (o->type == OBJ_STRING_BUILDER) { *chars = ((StringBuilder*)o)->chars; *length = ((StringBuilder*)o)->length; }
+    else return false;
+    return true;
+}
 
 // Path Resolution
 void setScriptDir(VM* vm, const char* scriptPath);
@@ -411,24 +624,51 @@ char* resolvePath(VM* vm, const char* path);  // Caller must free() the result
 void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t newSize);
 void collectGarbage(VM* vm);
 bool collectGarbageIncremental(VM* vm, int workUnits);
+void collectGarbageFull(VM* vm);   // Complete major collection, including its sweep
+void collectGarbageMinor(VM* vm);  // Nursery-only collection (no-op while a cycle is in progress)
 void collectGarbageConcurrent(VM* vm, int workUnits);
-bool isGCActive(void);
+bool isGCActive(VM* vm);
 #define ALLOCATE_OBJ(vm, type, objectType) \
     (type*)allocateObject(vm, sizeof(type), objectType)
 
 Obj* allocateObject(VM* vm, size_t size, ObjType type);
+void* allocateObjectMemory(VM* vm, size_t size); // Charged to bytesAllocated; may collect
 void freeObject(VM* vm, Obj* object);
 void grayObject(VM* vm, Obj* object);
 void markObject(VM* vm, Obj* object);
 void markValue(VM* vm, Value value);
-
-// Write Barrier: Maintain Tri-Color Invariant during concurrent marking
-// If 'obj' is Black (marked), we must revert it to Gray (push to stack) 
-// to ensure its new children are scanned.
+void pinObject(VM* vm, Obj* object); // Keep alive for the life of the VM
+// Counted roots (extension handles): each retain is undone by one release
+void retainObject(VM* vm, Obj* object);
+void releaseObject(VM* vm, Obj* object);
+
+// Core library state: NULL until set. setLibState replaces (and destroys)
+// an earlier value; freeVM destroys whatever is left.
+void* getLibState(VM* vm, const void* key);
+void setLibState(VM* vm, const void* key, void* data, void (*destroy)(void* data));
+
+// Hold off collections while native code builds a structure that stays
+// reachable until it returns. Calls nest; the outermost defer first runs
+// any collection that is already due, so callers must be rooted by then.
+void deferCollections(VM* vm);
+void resumeCollections(VM* vm);
+void rememberObject(VM* vm, Obj* object); // Old object gained a reference (see WRITE_BARRIER)
+void markExecState(VM* vm, Value* registers, int regBase, int regTop,
+                   CallFrame* callStack, int callStackTop);
+
+// Write Barrier: call after storing a reference into 'obj'.
+// - Generational: an old object is added to the remembered set so minor
+//   collections trace it as a root.
+// - Concurrent marking: if 'obj' is Black (marked), revert it to Gray (push
+//   to stack) to ensure its new children are scanned.
 #define WRITE_BARRIER(vm, obj) \
     do { \
-        if (isGCActive() && ((Obj*)(obj))->isMarked) { \
-            grayObject((vm), (Obj*)(obj)); \
+        Obj* wbObj_ = (Obj*)(obj); \
+        if (wbObj_->generation == GC_GEN_OLD && !wbObj_->isRemembered) { \
+            rememberObject((vm), wbObj_); \
+        } \
+        if (isGCActive((vm)) && wbObj_->isMarked) { \
+            grayObject((vm), wbObj_); \
         } \
     } while(0)
 
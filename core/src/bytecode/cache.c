@@ -0,0 +1,484 @@
+#include "bytecode/cache.h"
+#include "bytecode/opcodes.h"
+#include "runtime/fileio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Bytecode Cache (.unnac) reader and writer
+ *
+ * The writer serializes into a memory buffer and publishes it with
+ * rename(), so a process still reading the previous cache keeps a
+ * consistent file. The reader maps the file and copies out only what the
+ * VM owns (code, lines, constants); nothing points into the mapping once
+ * loading returns.
+ */
+
+enum {
+    CONST_INT,
+    CONST_FLOAT,
+    CONST_STRING,
+    CONST_FUNCTION
+};
+
+static bool isGlobalOp(uint32_t inst) {
+    uint8_t op = DECODE_OP(inst);
+    return op == OP_GETGLOBAL || op == OP_SETGLOBAL || op == OP_DEFGLOBAL;
+}
+
+static uint64_t hashBytes(const void* bytes, size_t length) {
+    const uint8_t* data = bytes;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int64_t mtimeNs(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+char* bytecodeCachePath(const char* sourcePath) {
+    size_t len = strlen(sourcePath);
+    bool unnaExt = len >= 5 && strcmp(sourcePath + len - 5, ".unna") == 0;
+    char* path = malloc(len + 7);
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    memcpy(path, sourcePath, len);
+    strcpy(path + len, unnaExt ? "c" : ".unnac");
+    return path;
+}
+
+// ---- Writer ----
+
+typedef struct {
+    uint8_t* data;
+    size_t count;
+    size_t capacity;
+} ByteBuffer;
+
+typedef struct {
+    ByteBuffer out;
+    Environment* env;       // Environment the chunk was compiled against
+    int* tableIndex;        // env slot -> globals table index (-1 if unused)
+    int* tableSlots;        // globals table index -> env slot
+    int tableCount;
+} CacheWriter;
+
+static void putBytes(ByteBuffer* buf, const void* bytes, size_t length) {
+    if (buf->count + length > buf->capacity) {
+        size_t capacity = buf->capacity < 4096 ? 4096 : buf->capacity;
+        while (capacity < buf->count + length) capacity *= 2;
+        buf->data = realloc(buf->data, capacity);
+        if (!buf->data) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(1);
+        }
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->count, bytes, length);
+    buf->count += length;
+}
+
+static void putU32(ByteBuffer* buf, uint32_t value) {
+    putBytes(buf, &value, sizeof(value));
+}
+
+static void putU8(ByteBuffer* buf, uint8_t value) {
+    putBytes(buf, &value, 1);
+}
+
+// Number the global slots the chunk tree uses, in first-use order
+static void collectGlobals(CacheWriter* w, BytecodeChunk* chunk) {
+    for (int i = 0; i < chunk->codeSize; i++) {
+        if (!isGlobalOp(chunk->code[i])) continue;
+        int slot = DECODE_Bx(chunk->code[i]);
+        if (w->tableIndex[slot] < 0) {
+            w->tableIndex[slot] = w->tableCount;
+            w->tableSlots[w->tableCount++] = slot;
+        }
+    }
+    for (int i = 0; i < chunk->constantCount; i++) {
+        Value v = chunk->constants[i];
+        if (IS_OBJ(v) && AS_OBJ(v)->type == OBJ_FUNCTION) {
+            Function* func = (Function*)AS_OBJ(v);
+            if (func->bytecodeChunk) collectGlobals(w, func->bytecodeChunk);
+        }
+    }
+}
+
+static bool writeChunkTree(CacheWriter* w, BytecodeChunk* chunk) {
+    ByteBuffer* out = &w->out;
+    putU32(out, (uint32_t)chunk->codeSize);
+    putU32(out, (uint32_t)chunk->maxRegs);
+    putU32(out, (uint32_t)chunk->constantCount);
+
+    for (int i = 0; i < chunk->codeSize; i++) {
+        uint32_t inst = chunk->code[i];
+        if (isGlobalOp(inst)) {
+            int index = w->tableIndex[DECODE_Bx(inst)];
+            inst = ENCODE_ABx(DECODE_OP(inst), DECODE_A(inst), index);
+        }
+        putU32(out, inst);
+    }
+    putBytes(out, chunk->lineNumbers, sizeof(int) * (size_t)chunk->codeSize);
+
+    for (int i = 0; i < chunk->constantCount; i++) {
+        Value v = chunk->constants[i];
+        if (IS_INT(v)) {
+            putU8(out, CONST_INT);
+            putU32(out, (uint32_t)AS_INT(v));
+        } else if (IS_STRING(v)) {
+            ObjString* str = AS_STRING(v);
+            putU8(out, CONST_STRING);
+            putU32(out, (uint32_t)str->length);
+            putBytes(out, str->chars, (size_t)str->length);
+        } else if (IS_OBJ(v) && AS_OBJ(v)->type == OBJ_FUNCTION) {
+            Function* func = (Function*)AS_OBJ(v);
+            if (!func->bytecodeChunk) return false;
+            putU8(out, CONST_FUNCTION);
+            putU32(out, (uint32_t)func->name.length);
+            putBytes(out, func->name.start, (size_t)func->name.length);
+            putU32(out, (uint32_t)func->paramCount);
+            putU8(out, func->isAsync ? 1 : 0);
+            if (!writeChunkTree(w, func->bytecodeChunk)) return false;
+        } else if (IS_NUMBER(v)) {
+            double d = AS_FLOAT(v);
+            putU8(out, CONST_FLOAT);
+            putBytes(out, &d, sizeof(d));
+        } else {
+            return false; // Not a compiler-emitted constant
+        }
+    }
+    return true;
+}
+
+uint8_t* encodeBytecodeImage(VM* vm, const char* sourcePath, const char* source,
+                             BytecodeChunk* chunk, size_t* size) {
+    struct stat st;
+    if (stat(sourcePath, &st) != 0) return NULL;
+
+    Environment* env = vm->globalEnv;
+    CacheWriter w = {{NULL, 0, 0}, env, NULL, NULL, 0};
+    int slots = env->count > 0 ? env->count : 1;
+    w.tableIndex = malloc(sizeof(int) * slots);
+    w.tableSlots = malloc(sizeof(int) * slots);
+    if (!w.tableIndex || !w.tableSlots) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    for (int i = 0; i < slots; i++) w.tableIndex[i] = -1;
+    collectGlobals(&w, chunk);
+
+    size_t sourceLength = source ? strlen(source) : 0;
+    UnnacHeader header = {
+        .magic = UNNAC_MAGIC,
+        .version = UNNAC_VERSION,
+        .opcodeCount = OPCODE_COUNT,
+        .globalCount = (uint32_t)w.tableCount,
+        .sourceMtimeNs = mtimeNs(&st),
+        .sourceSize = (uint64_t)sourceLength,
+        .sourceHash = hashBytes(source, sourceLength),
+        .payloadHash = 0
+    };
+    putBytes(&w.out, &header, sizeof(header));
+    for (int i = 0; i < w.tableCount; i++) {
+        VarEntry* entry = &env->vars[w.tableSlots[i]];
+        putU32(&w.out, (uint32_t)entry->keyLength);
+        putBytes(&w.out, entry->key, (size_t)entry->keyLength);
+    }
+    bool ok = writeChunkTree(&w, chunk);
+
+    free(w.tableIndex);
+    free(w.tableSlots);
+    if (!ok) {
+        free(w.out.data);
+        return NULL;
+    }
+    *size = w.out.count;
+    return w.out.data;
+}
+
+bool saveBytecodeImage(const char* sourcePath, uint8_t* image, size_t size) {
+    // Only files are checked against their payload hash, so it is filled in here
+    UnnacHeader header;
+    memcpy(&header, image, sizeof(header));
+    header.payloadHash = hashBytes(image + sizeof(header), size - sizeof(header));
+    memcpy(image, &header, sizeof(header));
+
+    char* path = bytecodeCachePath(sourcePath);
+    char* tmpPath = malloc(strlen(path) + 32);
+    if (!tmpPath) exit(1);
+    sprintf(tmpPath, "%s.%ld.tmp", path, (long)getpid());
+    FILE* file = fopen(tmpPath, "wb");
+    bool ok = file != NULL;
+    if (file) {
+        ok = fwrite(image, 1, size, file) == size;
+        ok = fclose(file) == 0 && ok;
+    }
+    if (ok) ok = rename(tmpPath, path) == 0;
+    if (!ok) remove(tmpPath);
+    free(tmpPath);
+    free(path);
+    return ok;
+}
+
+bool writeBytecodeCache(VM* vm, const char* sourcePath, const char* source,
+                        BytecodeChunk* chunk) {
+    size_t size = 0;
+    uint8_t* image = encodeBytecodeImage(vm, sourcePath, source, chunk, &size);
+    if (!image) return false;
+    bool ok = saveBytecodeImage(sourcePath, image, size);
+    free(image);
+    return ok;
+}
+
+// ---- Reader ----
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok;
+    VM* vm;
+    const char* modulePath;
+    int* slots;             // globals table index -> slot in vm->globalEnv
+    uint32_t globalCount;
+} CacheReader;
+
+static const uint8_t* takeBytes(CacheReader* r, size_t length) {
+    if (!r->ok || (size_t)(r->end - r->p) < length) {
+        r->ok = false;
+        return NULL;
+    }
+    const uint8_t* bytes = r->p;
+    r->p += length;
+    return bytes;
+}
+
+static uint32_t takeU32(CacheReader* r) {
+    uint32_t value = 0;
+    const uint8_t* bytes = takeBytes(r, sizeof(value));
+    if (bytes) memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static uint8_t takeU8(CacheReader* r) {
+    const uint8_t* bytes = takeBytes(r, 1);
+    return bytes ? *bytes : 0;
+}
+
+static Function* newCachedFunction(VM* vm, const char* modulePath) {
+    // Same setup as the compiler's NODE_STMT_FUNCTION
+    Function* func = heapAlloc(&vm->heap, sizeof(Function)); // Freed by freeObject
+    func->obj.type = OBJ_FUNCTION;
+    func->obj.isMarked = false;
+    func->obj.isPermanent = false;
+    func->obj.generation = GC_GEN_OLD; // Linked straight onto the old list
+    func->obj.isRemembered = false;
+    func->obj.next = vm->objects;
+    vm->objects = (Obj*)func;
+    rememberObject(vm, (Obj*)func); // Its constants are still young
+
+    func->name = (Token){0};
+    func->params = NULL;
+    func->paramCount = 0;
+    func->body = NULL;
+    func->isNative = false;
+    func->isAsync = false;
+    func->modulePath = modulePath ? strdup(modulePath) : NULL;
+    func->moduleEnv = vm->globalEnv;
+    func->closure = NULL;
+    func->native = NULL;
+    func->bytecodeChunk = malloc(sizeof(BytecodeChunk));
+    if (!func->bytecodeChunk) exit(1);
+    initChunk(func->bytecodeChunk);
+    return func;
+}
+
+static bool readChunkTree(CacheReader* r, BytecodeChunk* chunk) {
+    uint32_t codeSize = takeU32(r);
+    uint32_t maxRegs = takeU32(r);
+    uint32_t constantCount = takeU32(r);
+    // Each instruction takes 8 bytes and each constant at least 5
+    if (!r->ok || codeSize == 0 || maxRegs >= FRAME_REG_MAX ||
+        codeSize > (size_t)(r->end - r->p) / 8 ||
+        constantCount > (size_t)(r->end - r->p) / 5) {
+        return false;
+    }
+
+    const uint8_t* code = takeBytes(r, sizeof(uint32_t) * codeSize);
+    const uint8_t* lines = takeBytes(r, sizeof(int) * codeSize);
+    chunk->code = malloc(sizeof(uint32_t) * codeSize);
+    chunk->lineNumbers = malloc(sizeof(int) * codeSize);
+    if (!chunk->code || !chunk->lineNumbers) exit(1);
+    memcpy(chunk->code, code, sizeof(uint32_t) * codeSize);
+    memcpy(chunk->lineNumbers, lines, sizeof(int) * codeSize);
+    chunk->codeSize = chunk->codeCapacity = chunk->lineCapacity = (int)codeSize;
+    chunk->maxRegs = (int)maxRegs;
+
+    for (uint32_t i = 0; i < codeSize; i++) {
+        uint32_t inst = chunk->code[i];
+        if (DECODE_OP(inst) >= OPCODE_COUNT) return false;
+        if (!isGlobalOp(inst)) continue;
+        uint32_t index = DECODE_Bx(inst);
+        if (index >= r->globalCount) return false;
+        chunk->code[i] = ENCODE_ABx(DECODE_OP(inst), DECODE_A(inst), r->slots[index]);
+    }
+
+    // Constants keep their indices; each is rooted by the chunk's function
+    // (remembered, reachable from the caller's root) as soon as it is added
+    for (uint32_t i = 0; i < constantCount && r->ok; i++) {
+        uint8_t tag = takeU8(r);
+        switch (tag) {
+            case CONST_INT:
+                addConstant(chunk, INT_VAL((int32_t)takeU32(r)));
+                break;
+            case CONST_FLOAT: {
+                double d = 0;
+                const uint8_t* bytes = takeBytes(r, sizeof(d));
+                if (bytes) memcpy(&d, bytes, sizeof(d));
+                addConstant(chunk, FLOAT_VAL(d));
+                break;
+            }
+            case CONST_STRING: {
+                uint32_t length = takeU32(r);
+                const uint8_t* bytes = takeBytes(r, length);
+                if (!bytes) return false;
+                addConstant(chunk, OBJ_VAL(internString(r->vm, (const char*)bytes, (int)length)));
+                break;
+            }
+            case CONST_FUNCTION: {
+                uint32_t nameLength = takeU32(r);
+                const uint8_t* name = takeBytes(r, nameLength);
+                uint32_t paramCount = takeU32(r);
+                uint8_t isAsync = takeU8(r);
+                if (!r->ok || paramCount >= FRAME_REG_MAX) return false;
+
+                Function* func = newCachedFunction(r->vm, r->modulePath);
+                addConstant(chunk, OBJ_VAL(func));
+                func->paramCount = (int)paramCount;
+                func->isAsync = isAsync != 0;
+
+                // The name must outlive the mapping: keep it interned in the
+                // function's own constant pool, after the compiled constants
+                ObjString* nameStr = internString(r->vm, (const char*)name, (int)nameLength);
+                func->name.type = TOKEN_IDENTIFIER;
+                func->name.start = nameStr->chars;
+                func->name.length = (int)nameLength;
+                r->vm->stack[r->vm->stackTop++] = OBJ_VAL(nameStr);
+                bool nested = readChunkTree(r, func->bytecodeChunk);
+                r->vm->stackTop--;
+                if (!nested) return false;
+                addConstant(func->bytecodeChunk, OBJ_VAL(nameStr));
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return r->ok;
+}
+
+// The source is unchanged if its size and mtime match, or failing the
+// mtime (a checkout or copy), its contents hash the same
+static bool sourceMatches(const char* sourcePath, const UnnacHeader* header) {
+    struct stat st;
+    if (stat(sourcePath, &st) != 0) return false;
+    if ((uint64_t)st.st_size != header->sourceSize) return false;
+    if (mtimeNs(&st) == header->sourceMtimeNs) return true;
+
+    FileBuffer source;
+    if (!fileOpen(sourcePath, &source)) return false;
+    bool same = source.length == header->sourceSize &&
+                hashBytes(source.data, source.length) == header->sourceHash;
+    fileClose(&source);
+    return same;
+}
+
+// Header checks shared by files and in-memory images; the source and
+// payload hash are compared only for files
+static bool imageUsable(const char* sourcePath, const uint8_t* image, size_t size,
+                        UnnacHeader* header, bool checkSource) {
+    if (size < sizeof(UnnacHeader)) return false;
+    memcpy(header, image, sizeof(*header));
+    return header->magic == UNNAC_MAGIC && header->version == UNNAC_VERSION &&
+           header->opcodeCount == OPCODE_COUNT &&
+           (!checkSource || sourceMatches(sourcePath, header)) &&
+           header->globalCount <= (size - sizeof(*header)) / 4 &&
+           (!checkSource ||
+            hashBytes(image + sizeof(*header), size - sizeof(*header)) == header->payloadHash);
+}
+
+static bool readImage(VM* vm, const char* sourcePath, const uint8_t* image, size_t size,
+                      const UnnacHeader* header, BytecodeChunk* chunk) {
+    CacheReader r = {
+        .p = image + sizeof(*header),
+        .end = image + size,
+        .ok = true,
+        .vm = vm,
+        .modulePath = sourcePath,
+        .slots = malloc(sizeof(int) * (header->globalCount + 1)),
+        .globalCount = header->globalCount
+    };
+    if (!r.slots) exit(1);
+
+    // Reserve the globals in the running environment, as compiling would
+    for (uint32_t i = 0; i < header->globalCount && r.ok; i++) {
+        uint32_t length = takeU32(&r);
+        const uint8_t* name = takeBytes(&r, length);
+        if (!name) break;
+        ObjString* key = internString(vm, (const char*)name, (int)length);
+        vm->stack[vm->stackTop++] = OBJ_VAL(key); // Root across the env growth
+        int slot = envReserveSlot(vm, vm->globalEnv, key);
+        vm->stackTop--;
+        if (slot > UINT16_MAX) r.ok = false;
+        r.slots[i] = slot;
+    }
+
+    bool ok = r.ok && readChunkTree(&r, chunk) && r.p == r.end;
+    if (!ok) freeChunk(chunk);
+    free(r.slots);
+    return ok;
+}
+
+bool loadBytecodeCache(VM* vm, const char* sourcePath, BytecodeChunk* chunk) {
+    char* path = bytecodeCachePath(sourcePath);
+    FileBuffer file;
+    bool opened = fileMap(path, &file);
+    free(path);
+    if (!opened) return false;
+
+    const uint8_t* image = (const uint8_t*)file.data;
+    UnnacHeader header;
+    bool ok = imageUsable(sourcePath, image, file.length, &header, true) &&
+              readImage(vm, sourcePath, image, file.length, &header, chunk);
+    fileClose(&file);
+    return ok;
+}
+
+bool readBytecodeCache(const char* sourcePath, FileBuffer* out) {
+    char* path = bytecodeCachePath(sourcePath);
+    bool opened = fileMap(path, out);
+    free(path);
+    if (!opened) return false;
+
+    UnnacHeader header;
+    if (!imageUsable(sourcePath, (const uint8_t*)out->data, out->length, &header, true)) {
+        fileClose(out);
+        return false;
+    }
+    return true;
+}
+
+bool loadBytecodeImage(VM* vm, const char* sourcePath, const uint8_t* image, size_t size,
+                       BytecodeChunk* chunk) {
+    UnnacHeader header;
+    return imageUsable(sourcePath, image, size, &header, false) &&
+           readImage(vm, sourcePath, image, size, &header, chunk);
+}
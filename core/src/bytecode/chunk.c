@@ -1,4 +1,5 @@
 #include "bytecode/chunk.h"
+#include "bytecode/jit.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -23,12 +24,19 @@ void initChunk(BytecodeChunk* chunk) {
     chunk->lineCapacity = 0;
 
     chunk->maxRegs = 0;
+
+    chunk->propCaches = NULL;
+
+    chunk->hotness = JIT_HOTNESS;
+    chunk->jit = NULL;
 }
 
 void freeChunk(BytecodeChunk* chunk) {
     if (chunk->code) free(chunk->code);
     if (chunk->constants) free(chunk->constants);
     if (chunk->lineNumbers) free(chunk->lineNumbers);
+    if (chunk->propCaches) free(chunk->propCaches);
+    if (chunk->jit) jitFree(chunk->jit);
     initChunk(chunk);
 }
 
@@ -61,6 +69,16 @@ int addConstant(BytecodeChunk* chunk, Value value) {
     return chunk->constantCount++;
 }
 
+PropCache* allocPropCaches(BytecodeChunk* chunk) {
+    // Code is complete once it runs, so one slot per instruction suffices
+    chunk->propCaches = calloc(chunk->codeSize, sizeof(PropCache));
+    if (!chunk->propCaches) {
+        fprintf(stderr, "Memory allocation failed for inline caches.\n");
+        exit(1);
+    }
+    return chunk->propCaches;
+}
+
 void patchJump(BytecodeChunk* chunk, int instrIndex) {
     // Patch the jump offset in instruction at instrIndex
     // Jump distance = current position - instrIndex - 1
@@ -112,13 +130,16 @@ int disassembleInstruction(BytecodeChunk* chunk, int offset) {
 
     switch (info->format) {
         case 0: // ABC
-            printf("%-16s R%-3d R%-3d R%-3d\n", info->name, a, b, c);
+            if (op == OP_GETIDXI) {
+                printf("%-16s R%-3d R%-3d %4d\n", info->name, a, b, c);
+            } else {
+                printf("%-16s R%-3d R%-3d R%-3d\n", info->name, a, b, c);
+            }
             break;
         case 1: // ABx
             printf("%-16s R%-3d %5d", info->name, a, bx);
-            // Show constant value if it's a LOADK or global access
-            if ((op == OP_LOADK || op == OP_GETGLOBAL || op == OP_SETGLOBAL ||
-                 op == OP_DEFGLOBAL) && bx < (uint16_t)chunk->constantCount) {
+            // Show constant value for LOADK (global ops carry an env slot, not a constant)
+            if (op == OP_LOADK && bx < (uint16_t)chunk->constantCount) {
                 printf("  ; K(");
                 printValue(chunk->constants[bx]);
                 printf(")");
@@ -126,7 +147,11 @@ int disassembleInstruction(BytecodeChunk* chunk, int offset) {
             printf("\n");
             break;
         case 2: // AsBx
-            printf("%-16s R%-3d -> %d\n", info->name, a, offset + 1 + DECODE_sBx(inst));
+            if (op == OP_ADDI || op == OP_SUBI) {
+                printf("%-16s R%-3d %5d\n", info->name, a, DECODE_sBx(inst));
+            } else {
+                printf("%-16s R%-3d -> %d\n", info->name, a, offset + 1 + DECODE_sBx(inst));
+            }
             break;
         case 3: // sBx24
             printf("%-16s -> %d\n", info->name, offset + 1 + DECODE_sBx24(inst));
@@ -134,6 +159,17 @@ int disassembleInstruction(BytecodeChunk* chunk, int offset) {
         case 4: // A-only
             printf("%-16s R%-3d\n", info->name, a);
             break;
+        case 5: // Compare-and-branch; the target is in the JMP that follows
+            if (op >= OP_LTJMPK && op <= OP_EQJMPK) {
+                printf("%-16s %d R%-3d K%-3d", info->name, a, b, c);
+            } else {
+                printf("%-16s %d R%-3d R%-3d", info->name, a, b, c);
+            }
+            if (offset + 1 < chunk->codeSize) {
+                printf(" -> %d", offset + 2 + DECODE_sBx24(chunk->code[offset + 1]));
+            }
+            printf("\n");
+            break;
         default:
             printf("%-16s ???\n", info->name);
             break;
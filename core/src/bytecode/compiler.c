@@ -1,5 +1,6 @@
 #include "bytecode/compiler.h"
 #include "bytecode/opcodes.h"
+#include "bytecode/optimizer.h"
 #include "lexer.h"
 
 // #define DEBUG_PRINT_CODE
@@ -46,6 +47,18 @@ static char* parseStringLiteral(const char* start, int length) {
     return buffer;
 }
 
+#define MAX_KNOWN_STRUCTS 64
+#define MAX_SCALAR_LOCALS 32
+#define MAX_SCALAR_FIELDS 16
+
+// What the whole module tells its functions
+typedef struct {
+    Node* structs[MAX_KNOWN_STRUCTS];   // Top-level struct declarations nothing rebinds
+    int structIndex[MAX_KNOWN_STRUCTS]; // The top-level statement declaring each
+    int structCount;
+    int rootIndex;                      // Top-level statement being compiled
+} ModuleFacts;
+
 typedef struct {
     VM* vm;
     BytecodeChunk* chunk;
@@ -55,6 +68,7 @@ typedef struct {
         const char* name;
         int depth;
         int reg;        // Register index for this variable
+        Node* scalar;   // Struct declaration, if the fields live in R(reg).. instead
     } locals[256];
     int localCount;
 
@@ -62,6 +76,11 @@ typedef struct {
     int scopeDepth;
     const char* modulePath;
 
+    ModuleFacts* facts;
+    Node* scalarDecls[MAX_SCALAR_LOCALS];   // Declarations of locals that never escape
+    Node* scalarStructs[MAX_SCALAR_LOCALS]; // Their struct declarations
+    int scalarCount;
+
     bool hadError;
 } Compiler;
 
@@ -71,12 +90,15 @@ static void initCompiler(Compiler* c, VM* vm, BytecodeChunk* chunk, const char*
     c->modulePath = modulePath;
     c->hadError = false;
     c->scopeDepth = 0;
+    c->facts = NULL;
+    c->scalarCount = 0;
 
     // Reserve register 0 for the function/script itself
     c->localCount = 1;
     c->locals[0].depth = 0;
     c->locals[0].name = "";
     c->locals[0].reg = 0;
+    c->locals[0].scalar = NULL;
     c->nextReg = 1;
 }
 
@@ -113,6 +135,18 @@ static int emitJumpPlaceholder(Compiler* c, uint8_t op, uint8_t a, int line) {
     return idx;
 }
 
+// Bottom test of a loop: jump back to 'loopStart' while R(condReg) is truthy
+static void emitLoopTest(Compiler* c, int condReg, int loopStart, int line) {
+    int offset = loopStart - c->chunk->codeSize - 1;
+    if (offset >= -0x7FFF) {
+        emit(c, ENCODE_AsBx(OP_JMPT, condReg, offset), line);
+    } else {
+        // Beyond a 16-bit offset: skip a 24-bit LOOP once the test fails
+        emit(c, ENCODE_AsBx(OP_JMPF, condReg, 1), line);
+        emit(c, ENCODE_sBx(OP_LOOP, c->chunk->codeSize - loopStart + 1), line);
+    }
+}
+
 // Resolve local variable -> register
 static int resolveLocal(Compiler* c, const char* name, int length) {
     for (int i = c->localCount - 1; i >= 0; i--) {
@@ -135,10 +169,343 @@ static int addLocal(Compiler* c, const char* name) {
     c->locals[c->localCount].name = name;
     c->locals[c->localCount].depth = c->scopeDepth;
     c->locals[c->localCount].reg = reg;
+    c->locals[c->localCount].scalar = NULL;
     c->localCount++;
     return reg;
 }
 
+// Forward declarations
+static void compileNode(Compiler* c, Node* node);
+static void compileExpr(Compiler* c, Node* node, int dest);
+static void compileStmt(Compiler* c, Node* node);
+
+// ---- Scalar replacement ----
+// A local initialized by calling a struct, and used only through its fields
+// (p.x reads and p.x = v writes), never escapes its function: it lives in
+// one register per field and no instance is allocated. The struct must be
+// declared once at the top level, under a name nothing in the module binds
+// again, and before the top-level statement the code is in: its global
+// then holds that StructDef whenever the code runs. Globals are only set
+// by the module's own code.
+
+typedef enum {
+    SCAN_MODULE,    // Count the bindings of each top-level struct name
+    SCAN_COLLECT,   // Find local declarations initialized by a known struct
+    SCAN_ESCAPES    // Mark the ones used other than through their fields
+} ScanMode;
+
+typedef struct {
+    ScanMode mode;
+    Compiler* c;
+    bool topLevel;                      // Scanning the script, not a function body
+    int bindings[MAX_KNOWN_STRUCTS];    // SCAN_MODULE
+    bool escapes[MAX_SCALAR_LOCALS];    // SCAN_ESCAPES
+    int inside;                         // Candidate whose arguments are being scanned, or -1
+} NameScan;
+
+static bool sameName(Token a, Token b) {
+    return a.length == b.length && memcmp(a.start, b.start, (size_t)a.length) == 0;
+}
+
+static bool structHasField(Node* decl, Token field) {
+    for (int i = 0; i < decl->structDecl.fieldCount; i++) {
+        if (sameName(decl->structDecl.fields[i], field)) return true;
+    }
+    return false;
+}
+
+static int argumentCount(Node* call) {
+    int count = 0;
+    for (Node* arg = call->call.arguments; arg; arg = arg->next) count++;
+    return count;
+}
+
+// The known struct 'init' constructs, if it is a call to one
+static Node* constructedStruct(Compiler* c, Node* init) {
+    if (!init || init->type != NODE_EXPR_CALL || init->call.callee->type != NODE_EXPR_VAR) return NULL;
+    ModuleFacts* facts = c->facts;
+    for (int i = 0; i < facts->structCount; i++) {
+        Node* decl = facts->structs[i];
+        if (facts->structIndex[i] < facts->rootIndex &&
+            sameName(init->call.callee->var.name, decl->structDecl.name) &&
+            argumentCount(init) == decl->structDecl.fieldCount &&
+            decl->structDecl.fieldCount <= MAX_SCALAR_FIELDS) {
+            return decl;
+        }
+    }
+    return NULL;
+}
+
+// 'name' bound by 'decl' (NULL for assignments and other bindings)
+static void scanBinding(NameScan* s, Token name, Node* decl) {
+    Compiler* c = s->c;
+    switch (s->mode) {
+        case SCAN_MODULE:
+            for (int i = 0; i < c->facts->structCount; i++) {
+                if (sameName(name, c->facts->structs[i]->structDecl.name)) s->bindings[i]++;
+            }
+            break;
+        case SCAN_COLLECT:
+            if (decl && decl->type == NODE_STMT_VAR_DECL && c->scalarCount < MAX_SCALAR_LOCALS) {
+                Node* def = constructedStruct(c, decl->varDecl.initializer);
+                if (def) {
+                    c->scalarDecls[c->scalarCount] = decl;
+                    c->scalarStructs[c->scalarCount++] = def;
+                }
+            }
+            break;
+        case SCAN_ESCAPES:
+            for (int i = 0; i < c->scalarCount; i++) {
+                if (decl != c->scalarDecls[i] && sameName(name, c->scalarDecls[i]->varDecl.name)) {
+                    s->escapes[i] = true;
+                }
+            }
+            break;
+    }
+}
+
+// 'name' read as a value
+static void scanUse(NameScan* s, Token name) {
+    if (s->mode != SCAN_ESCAPES) return;
+    Compiler* c = s->c;
+    for (int i = 0; i < c->scalarCount; i++) {
+        if (sameName(name, c->scalarDecls[i]->varDecl.name)) s->escapes[i] = true;
+    }
+}
+
+// object.field: true if the object is a candidate, used through a field
+static bool scanFieldUse(NameScan* s, Node* object, Token field) {
+    if (s->mode != SCAN_ESCAPES || object->type != NODE_EXPR_VAR) return false;
+    Compiler* c = s->c;
+    bool candidate = false;
+    for (int i = 0; i < c->scalarCount; i++) {
+        if (sameName(object->var.name, c->scalarDecls[i]->varDecl.name)) {
+            candidate = true;
+            if (i == s->inside || !structHasField(c->scalarStructs[i], field)) s->escapes[i] = true;
+        }
+    }
+    return candidate;
+}
+
+static void scanNames(NameScan* s, Node* node) {
+    for (; node; node = node->next) {
+        switch (node->type) {
+            case NODE_EXPR_BINARY:
+                scanNames(s, node->binary.left);
+                scanNames(s, node->binary.right);
+                break;
+            case NODE_EXPR_UNARY:
+            case NODE_EXPR_AWAIT:
+                scanNames(s, node->unary.expr);
+                break;
+            case NODE_EXPR_VAR:
+                scanUse(s, node->var.name);
+                break;
+            case NODE_EXPR_CALL:
+                scanNames(s, node->call.callee);
+                scanNames(s, node->call.arguments);
+                break;
+            case NODE_EXPR_GET:
+                if (!scanFieldUse(s, node->get.object, node->get.name)) scanNames(s, node->get.object);
+                break;
+            case NODE_EXPR_INDEX:
+                scanNames(s, node->index.target);
+                scanNames(s, node->index.index);
+                break;
+            case NODE_EXPR_ARRAY_LITERAL:
+                scanNames(s, node->arrayLiteral.elements);
+                break;
+            case NODE_STMT_VAR_DECL: {
+                scanBinding(s, node->varDecl.name, node);
+                int inside = s->inside;
+                for (int i = 0; s->mode == SCAN_ESCAPES && i < s->c->scalarCount; i++) {
+                    if (s->c->scalarDecls[i] == node) s->inside = i;
+                }
+                scanNames(s, node->varDecl.initializer);
+                s->inside = inside;
+                break;
+            }
+            case NODE_STMT_ASSIGN:
+                scanBinding(s, node->assign.name, NULL);
+                scanNames(s, node->assign.value);
+                break;
+            case NODE_STMT_INDEX_ASSIGN:
+                scanNames(s, node->indexAssign.target);
+                scanNames(s, node->indexAssign.index);
+                scanNames(s, node->indexAssign.value);
+                break;
+            case NODE_STMT_PROP_ASSIGN:
+                if (!scanFieldUse(s, node->propAssign.object, node->propAssign.name)) {
+                    scanNames(s, node->propAssign.object);
+                }
+                scanNames(s, node->propAssign.value);
+                break;
+            case NODE_STMT_PRINT:
+                scanNames(s, node->print.expr);
+                break;
+            case NODE_STMT_IF:
+                scanNames(s, node->ifStmt.condition);
+                scanNames(s, node->ifStmt.thenBranch);
+                scanNames(s, node->ifStmt.elseBranch);
+                break;
+            case NODE_STMT_WHILE:
+                scanNames(s, node->whileStmt.condition);
+                scanNames(s, node->whileStmt.body);
+                break;
+            case NODE_STMT_FOR:
+                scanNames(s, node->forStmt.initializer);
+                scanNames(s, node->forStmt.condition);
+                scanNames(s, node->forStmt.increment);
+                scanNames(s, node->forStmt.body);
+                break;
+            case NODE_STMT_FOREACH:
+                scanBinding(s, node->foreachStmt.iterator, NULL);
+                scanNames(s, node->foreachStmt.collection);
+                scanNames(s, node->foreachStmt.body);
+                break;
+            case NODE_STMT_BLOCK:
+                for (int i = 0; i < node->block.count; i++) {
+                    Node* stmt = node->block.statements[i];
+                    // The script's own statements declare globals
+                    if (s->topLevel && s->mode == SCAN_COLLECT && stmt && stmt->type == NODE_STMT_VAR_DECL) {
+                        s->c->facts->rootIndex = i;
+                        scanNames(s, stmt->varDecl.initializer);
+                        continue;
+                    }
+                    if (s->topLevel) s->c->facts->rootIndex = i;
+                    bool topLevel = s->topLevel;
+                    s->topLevel = false;
+                    scanNames(s, stmt);
+                    s->topLevel = topLevel;
+                }
+                break;
+            case NODE_STMT_FUNCTION:
+                scanBinding(s, node->function.name, NULL);
+                // Other functions have locals of their own; only the
+                // module scan (for struct names) looks inside
+                if (s->mode == SCAN_MODULE) {
+                    for (int i = 0; i < node->function.paramCount; i++) {
+                        scanBinding(s, node->function.params[i], NULL);
+                    }
+                    scanNames(s, node->function.body);
+                }
+                break;
+            case NODE_STMT_RETURN:
+                scanNames(s, node->returnStmt.value);
+                break;
+            case NODE_STMT_IMPORT:
+                scanBinding(s, node->importStmt.alias, NULL);
+                break;
+            case NODE_STMT_STRUCT_DECL:
+                scanBinding(s, node->structDecl.name, node);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Top-level struct declarations whose names nothing else binds
+static void findModuleStructs(Compiler* c, Node* root) {
+    ModuleFacts* facts = c->facts;
+    facts->structCount = 0;
+    if (!root || root->type != NODE_STMT_BLOCK) return;
+    for (int i = 0; i < root->block.count && facts->structCount < MAX_KNOWN_STRUCTS; i++) {
+        Node* stmt = root->block.statements[i];
+        if (stmt && stmt->type == NODE_STMT_STRUCT_DECL) {
+            facts->structIndex[facts->structCount] = i;
+            facts->structs[facts->structCount++] = stmt;
+        }
+    }
+    if (facts->structCount == 0) return;
+
+    NameScan scan = {.mode = SCAN_MODULE, .c = c, .inside = -1};
+    scanNames(&scan, root);
+    int kept = 0;
+    for (int i = 0; i < facts->structCount; i++) {
+        if (scan.bindings[i] != 1) continue;
+        facts->structIndex[kept] = facts->structIndex[i];
+        facts->structs[kept++] = facts->structs[i];
+    }
+    facts->structCount = kept;
+}
+
+// Find the locals of 'body' (a function body, or the script) that never
+// escape. 'params' are the function's, which shadow any struct-typed local.
+static void findScalarLocals(Compiler* c, Node* body, Token* params, int paramCount, bool topLevel) {
+    c->scalarCount = 0;
+    if (!c->facts || c->facts->structCount == 0) return;
+    int rootIndex = c->facts->rootIndex;
+
+    NameScan scan = {.mode = SCAN_COLLECT, .c = c, .topLevel = topLevel, .inside = -1};
+    scanNames(&scan, body);
+    c->facts->rootIndex = rootIndex;
+    if (c->scalarCount == 0) return;
+
+    scan.mode = SCAN_ESCAPES;
+    scan.topLevel = false;
+    for (int i = 0; i < paramCount; i++) scanBinding(&scan, params[i], NULL);
+    scanNames(&scan, body);
+
+    int kept = 0;
+    for (int i = 0; i < c->scalarCount; i++) {
+        if (scan.escapes[i]) continue;
+        c->scalarDecls[kept] = c->scalarDecls[i];
+        c->scalarStructs[kept++] = c->scalarStructs[i];
+    }
+    c->scalarCount = kept;
+}
+
+// The struct whose fields 'decl' keeps in registers, if it never escapes
+static Node* scalarStruct(Compiler* c, Node* decl) {
+    for (int i = 0; i < c->scalarCount; i++) {
+        if (c->scalarDecls[i] == decl) return c->scalarStructs[i];
+    }
+    return NULL;
+}
+
+// Register holding object.field, if the object is a scalar-replaced local;
+// -1 otherwise. A field the struct lacks reads as nil (-2), as it would.
+static int scalarFieldReg(Compiler* c, Node* object, Token field) {
+    if (object->type != NODE_EXPR_VAR) return -1;
+    Token name = object->var.name;
+    for (int i = c->localCount - 1; i >= 0; i--) {
+        if (strlen(c->locals[i].name) == (size_t)name.length &&
+            memcmp(c->locals[i].name, name.start, name.length) == 0) {
+            Node* decl = c->locals[i].scalar;
+            if (!decl) return -1;
+            for (int f = 0; f < decl->structDecl.fieldCount; f++) {
+                if (sameName(decl->structDecl.fields[f], field)) return c->locals[i].reg + f;
+            }
+            return -2;
+        }
+    }
+    return -1;
+}
+
+// Declare a local that never escapes: the constructor's arguments go
+// straight into its field registers
+static void declareScalarLocal(Compiler* c, Node* decl, Node* def) {
+    if (c->localCount >= 256) {
+        fprintf(stderr, "Too many local variables\n");
+        c->hadError = true;
+        return;
+    }
+    int base = c->nextReg;
+    Node* arg = decl->varDecl.initializer->call.arguments;
+    for (int i = 0; i < def->structDecl.fieldCount; i++, arg = arg->next) {
+        int reg = allocReg(c);
+        compileExpr(c, arg, reg);
+        freeRegsTo(c, reg + 1);
+    }
+    Token name = decl->varDecl.name;
+    c->locals[c->localCount].name = strndup(name.start, name.length);
+    c->locals[c->localCount].depth = c->scopeDepth;
+    c->locals[c->localCount].reg = base;
+    c->locals[c->localCount].scalar = def;
+    c->localCount++;
+}
+
 // Add constant and return its index
 static int emitConstant(Compiler* c, Value value) {
     return addConstant(c->chunk, value);
@@ -152,10 +519,20 @@ static int internNameConst(Compiler* c, Token name) {
     return addConstant(c->chunk, OBJ_VAL(obj));
 }
 
-// Forward declarations
-static void compileNode(Compiler* c, Node* node);
-static void compileExpr(Compiler* c, Node* node, int dest);
-static void compileStmt(Compiler* c, Node* node);
+// Resolve a global name to its slot in vm->globalEnv at compile time.
+// That is the environment this chunk runs in: functions capture it as
+// moduleEnv, and imports compile with the module env installed.
+static int resolveGlobalSlot(Compiler* c, Token name) {
+    ObjString* obj = internString(c->vm, name.start, name.length);
+    int slot = envReserveSlot(c->vm, c->vm->globalEnv, obj);
+    if (slot > UINT16_MAX) {
+        fprintf(stderr, "Too many globals (%d)\n", slot);
+        c->hadError = true;
+        return 0;
+    }
+    return slot;
+}
+
 
 // Helper to get register without forcing a MOVE if it's a local variable.
 static int getOperandReg(Compiler* c, Node* node, bool* isTemp) {
@@ -179,7 +556,7 @@ static int getOperandReg(Compiler* c, Node* node, bool* isTemp) {
  */
 static void compileExpr(Compiler* c, Node* node, int dest) {
     if (!node) return;
-    int line = node->literal.token.line > 0 ? node->literal.token.line : 1;
+    int line = node->line > 0 ? node->line : 1;
 
     switch (node->type) {
         case NODE_EXPR_LITERAL: {
@@ -227,8 +604,8 @@ static void compileExpr(Compiler* c, Node* node, int dest) {
                     emit(c, ENCODE_ABC(OP_MOVE, dest, local, 0), line);
                 }
             } else {
-                int ki = internNameConst(c, name);
-                emit(c, ENCODE_ABx(OP_GETGLOBAL, dest, ki), line);
+                int slot = resolveGlobalSlot(c, name);
+                emit(c, ENCODE_ABx(OP_GETGLOBAL, dest, slot), line);
             }
             break;
         }
@@ -237,6 +614,7 @@ static void compileExpr(Compiler* c, Node* node, int dest) {
             bool tempB, tempC;
             int regB = getOperandReg(c, node->binary.left, &tempB);
             int regC = getOperandReg(c, node->binary.right, &tempC);
+            if (node->binary.op.line > 0) line = node->binary.op.line;
 
             switch (node->binary.op.type) {
                 case TOKEN_PLUS:          emit(c, ENCODE_ABC(OP_ADD, dest, regB, regC), line); break;
@@ -389,6 +767,15 @@ static void compileExpr(Compiler* c, Node* node, int dest) {
         }
 
         case NODE_EXPR_GET: {
+            int field = scalarFieldReg(c, node->get.object, node->get.name);
+            if (field == -2) {
+                emit(c, ENCODE_A(OP_LOADNIL, dest), line);
+                break;
+            }
+            if (field >= 0) {
+                if (field != dest) emit(c, ENCODE_ABC(OP_MOVE, dest, field, 0), line);
+                break;
+            }
             int regB = allocReg(c);
             compileExpr(c, node->get.object, regB);
             int ki = internNameConst(c, node->get.name);
@@ -408,8 +795,8 @@ static void compileExpr(Compiler* c, Node* node, int dest) {
                 }
             } else {
                 compileExpr(c, node->assign.value, dest);
-                int ki = internNameConst(c, name);
-                emit(c, ENCODE_ABx(OP_SETGLOBAL, dest, ki), line);
+                int slot = resolveGlobalSlot(c, name);
+                emit(c, ENCODE_ABx(OP_SETGLOBAL, dest, slot), line);
             }
             break;
         }
@@ -424,7 +811,7 @@ static void compileExpr(Compiler* c, Node* node, int dest) {
  */
 static void compileStmt(Compiler* c, Node* node) {
     if (!node) return;
-    int line = 1;
+    int line = node->line > 0 ? node->line : 1;
 
     switch (node->type) {
         case NODE_STMT_PRINT: {
@@ -440,6 +827,11 @@ static void compileStmt(Compiler* c, Node* node) {
             line = name.line > 0 ? name.line : 1;
 
             if (c->scopeDepth > 0) {
+                Node* def = scalarStruct(c, node);
+                if (def) {
+                    declareScalarLocal(c, node, def);
+                    break;
+                }
                 // Local variable -> allocate register
                 int reg = addLocal(c, strndup(name.start, name.length));
                 if (node->varDecl.initializer) {
@@ -455,8 +847,8 @@ static void compileStmt(Compiler* c, Node* node) {
                 } else {
                     emit(c, ENCODE_A(OP_LOADNIL, reg), line);
                 }
-                int ki = internNameConst(c, name);
-                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, ki), line);
+                int slot = resolveGlobalSlot(c, name);
+                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, slot), line);
                 freeRegsTo(c, reg);
             }
             break;
@@ -518,8 +910,8 @@ static void compileStmt(Compiler* c, Node* node) {
             } else {
                 int reg = allocReg(c);
                 compileExpr(c, node->assign.value, reg);
-                int ki = internNameConst(c, name);
-                emit(c, ENCODE_ABx(OP_SETGLOBAL, reg, ki), line);
+                int slot = resolveGlobalSlot(c, name);
+                emit(c, ENCODE_ABx(OP_SETGLOBAL, reg, slot), line);
                 freeRegsTo(c, reg);
             }
             break;
@@ -558,18 +950,19 @@ static void compileStmt(Compiler* c, Node* node) {
         }
 
         case NODE_STMT_WHILE: {
-            int loopStart = c->chunk->codeSize;
-
+            // Test once on entry, then at the bottom: one branch per iteration
             int condReg = allocReg(c);
             compileExpr(c, node->whileStmt.condition, condReg);
             int exitJmp = emitJumpPlaceholder(c, OP_JMPF, condReg, line);
             freeRegsTo(c, condReg);
 
+            int loopStart = c->chunk->codeSize;
             compileStmt(c, node->whileStmt.body);
 
-            // Loop back
-            int backOffset = c->chunk->codeSize - loopStart + 1;
-            emit(c, ENCODE_sBx(OP_LOOP, backOffset), line);
+            condReg = allocReg(c);
+            compileExpr(c, node->whileStmt.condition, condReg);
+            emitLoopTest(c, condReg, loopStart, line);
+            freeRegsTo(c, condReg);
 
             patchJump(c->chunk, exitJmp);
             break;
@@ -590,9 +983,9 @@ static void compileStmt(Compiler* c, Node* node) {
                 }
             }
 
-            int loopStart = c->chunk->codeSize;
             int exitJmp = -1;
 
+            // As with while: entry test, then the test again at the bottom
             if (node->forStmt.condition) {
                 int condReg = allocReg(c);
                 compileExpr(c, node->forStmt.condition, condReg);
@@ -600,6 +993,7 @@ static void compileStmt(Compiler* c, Node* node) {
                 freeRegsTo(c, condReg);
             }
 
+            int loopStart = c->chunk->codeSize;
             compileStmt(c, node->forStmt.body);
 
             if (node->forStmt.increment) {
@@ -613,10 +1007,16 @@ static void compileStmt(Compiler* c, Node* node) {
                 }
             }
 
-            int backOffset = c->chunk->codeSize - loopStart + 1;
-            emit(c, ENCODE_sBx(OP_LOOP, backOffset), line);
-
-            if (exitJmp != -1) patchJump(c->chunk, exitJmp);
+            if (node->forStmt.condition) {
+                int condReg = allocReg(c);
+                compileExpr(c, node->forStmt.condition, condReg);
+                emitLoopTest(c, condReg, loopStart, line);
+                freeRegsTo(c, condReg);
+                patchJump(c->chunk, exitJmp);
+            } else {
+                int backOffset = c->chunk->codeSize - loopStart + 1;
+                emit(c, ENCODE_sBx(OP_LOOP, backOffset), line);
+            }
 
             c->scopeDepth--;
             c->localCount = savedLocalCount;
@@ -629,45 +1029,32 @@ static void compileStmt(Compiler* c, Node* node) {
             int savedLocalCount = c->localCount;
             int savedNextReg = c->nextReg;
 
-            // Collection register
+            // Collection, cursor and loop variable in consecutive registers
             int colReg = addLocal(c, strdup(".col"));
+            addLocal(c, strdup(".cur"));
             compileExpr(c, node->foreachStmt.collection, colReg);
+            freeRegsTo(c, colReg + 2);
+            emit(c, ENCODE_A(OP_FOREACH_PREP, colReg), line);
+            int enterJmp = emitJumpPlaceholder(c, OP_JMP, 0, line);
 
-            // Index register = 0
-            int idxReg = addLocal(c, strdup(".idx"));
-            emit(c, ENCODE_ABx(OP_LOADI, idxReg, 0 + 0x7FFF), line); // 0
-
-            // Loop start
-            int loopStart = c->chunk->codeSize;
-
-            // Condition: idx < len(col)
-            int lenReg = allocReg(c);
-            int condReg = allocReg(c);
-            emit(c, ENCODE_ABC(OP_LEN, lenReg, colReg, 0), line);
-            emit(c, ENCODE_ABC(OP_LT, condReg, idxReg, lenReg), line);
-            int exitJmp = emitJumpPlaceholder(c, OP_JMPF, condReg, line);
-            freeRegsTo(c, lenReg);
-
-            // Iterator variable = col[idx]
+            // Body, entered through the FOREACH_NEXT at the bottom
             c->scopeDepth++;
             Token iterator = node->foreachStmt.iterator;
-            int iterReg = addLocal(c, strndup(iterator.start, iterator.length));
-            emit(c, ENCODE_ABC(OP_GETIDX, iterReg, colReg, idxReg), line);
+            addLocal(c, strndup(iterator.start, iterator.length));
 
-            // Body
+            int loopStart = c->chunk->codeSize;
             compileStmt(c, node->foreachStmt.body);
+            patchJump(c->chunk, enterJmp);
 
-            // Increment idx
-            int oneReg = allocReg(c);
-            emit(c, ENCODE_ABx(OP_LOADI, oneReg, 1 + 0x7FFF), line); // 1
-            emit(c, ENCODE_ABC(OP_ADD, idxReg, idxReg, oneReg), line);
-            freeRegsTo(c, oneReg);
-
-            // Loop back
-            int backOffset = c->chunk->codeSize - loopStart + 1;
-            emit(c, ENCODE_sBx(OP_LOOP, backOffset), line);
-
-            patchJump(c->chunk, exitJmp);
+            int offset = loopStart - c->chunk->codeSize - 1;
+            if (offset >= -0x7FFF) {
+                emit(c, ENCODE_AsBx(OP_FOREACH_NEXT, colReg, offset), line);
+            } else {
+                // Beyond a 16-bit offset: hop to a 24-bit LOOP per element
+                emit(c, ENCODE_AsBx(OP_FOREACH_NEXT, colReg, 1), line);
+                emit(c, ENCODE_sBx(OP_JMP, 1), line);
+                emit(c, ENCODE_sBx(OP_LOOP, c->chunk->codeSize - loopStart + 1), line);
+            }
 
             c->scopeDepth--;
             c->scopeDepth--;
@@ -693,19 +1080,21 @@ static void compileStmt(Compiler* c, Node* node) {
 
         case NODE_STMT_FUNCTION: {
             // Allocate Function object
-            Function* func = malloc(sizeof(Function));
+            Function* func = heapAlloc(&c->vm->heap, sizeof(Function)); // Freed by freeObject
             func->obj.type = OBJ_FUNCTION;
             func->obj.isMarked = false;
             func->obj.isPermanent = false;
-            func->obj.generation = 0;
+            func->obj.generation = GC_GEN_OLD; // Linked straight onto the old list
+            func->obj.isRemembered = false;
             func->obj.next = c->vm->objects;
             c->vm->objects = (Obj*)func;
+            rememberObject(c->vm, (Obj*)func); // Its constants are still young
 
             func->name = node->function.name;
-            func->params = node->function.params;
+            func->params = NULL;  // The AST they live in is freed once compiled
             func->paramCount = node->function.paramCount;
             func->isNative = false;
-            func->isAsync = false;
+            func->isAsync = node->function.isAsync;
             func->modulePath = c->modulePath ? strdup(c->modulePath) : NULL;
             func->moduleEnv = c->vm->globalEnv;
             func->closure = NULL;
@@ -722,10 +1111,13 @@ static void compileStmt(Compiler* c, Node* node) {
 
             Compiler funcCompiler;
             initCompiler(&funcCompiler, c->vm, func->bytecodeChunk, c->modulePath);
+            funcCompiler.facts = c->facts;
+            findScalarLocals(&funcCompiler, node->function.body, node->function.params,
+                             node->function.paramCount, false);
 
             // Parameters occupy registers 1..paramCount
             for (int i = 0; i < func->paramCount; i++) {
-                Token p = func->params[i];
+                Token p = node->function.params[i];
                 char* pname = strndup(p.start, p.length);
                 addLocal(&funcCompiler, pname);
             }
@@ -733,8 +1125,11 @@ static void compileStmt(Compiler* c, Node* node) {
             // Compile body
             compileNode(&funcCompiler, node->function.body);
 
-            // Implicit return nil
-            emit(&funcCompiler, ENCODE_A(OP_RETURNNIL, 0), line);
+            // Implicit return nil, on the body's last line
+            BytecodeChunk* body = func->bytecodeChunk;
+            int endLine = body->codeSize > 0 ? body->lineNumbers[body->codeSize - 1] : line;
+            emit(&funcCompiler, ENCODE_A(OP_RETURNNIL, 0), endLine);
+            if (!funcCompiler.hadError) optimizeChunk(func->bytecodeChunk);
 
 #ifdef DEBUG_PRINT_CODE
             if (!funcCompiler.hadError) {
@@ -752,10 +1147,10 @@ static void compileStmt(Compiler* c, Node* node) {
 
             if (c->scopeDepth == 0) {
                 // Global function
-                int nameIdx = internNameConst(c, node->function.name);
+                int slot = resolveGlobalSlot(c, node->function.name);
                 int reg = allocReg(c);
                 emit(c, ENCODE_ABx(OP_LOADK, reg, funcConstIdx), line);
-                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, nameIdx), line);
+                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, slot), line);
                 freeRegsTo(c, reg);
             } else {
                 // Local function
@@ -799,7 +1194,7 @@ static void compileStmt(Compiler* c, Node* node) {
 
             // Define as global/local
             if (c->scopeDepth == 0) {
-                emit(c, ENCODE_ABx(OP_DEFGLOBAL, nameReg, nameIdx), line);
+                emit(c, ENCODE_ABx(OP_DEFGLOBAL, nameReg, resolveGlobalSlot(c, name)), line);
             } else {
                 int reg = addLocal(c, strndup(name.start, name.length));
                 emit(c, ENCODE_ABC(OP_MOVE, reg, nameReg, 0), line);
@@ -809,6 +1204,11 @@ static void compileStmt(Compiler* c, Node* node) {
         }
 
         case NODE_STMT_PROP_ASSIGN: {
+            int field = scalarFieldReg(c, node->propAssign.object, node->propAssign.name);
+            if (field >= 0) {
+                compileExpr(c, node->propAssign.value, field);
+                break;
+            }
             int regObj = allocReg(c);
             int regVal = allocReg(c);
             compileExpr(c, node->propAssign.object, regObj);
@@ -837,8 +1237,8 @@ static void compileStmt(Compiler* c, Node* node) {
             emit(c, ENCODE_ABx(OP_IMPORT, reg, modIdx), line);
 
             if (c->scopeDepth == 0) {
-                int aliasIdx = internNameConst(c, alias);
-                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, aliasIdx), line);
+                int slot = resolveGlobalSlot(c, alias);
+                emit(c, ENCODE_ABx(OP_DEFGLOBAL, reg, slot), line);
             } else {
                 int localReg = addLocal(c, strndup(alias.start, alias.length));
                 emit(c, ENCODE_ABC(OP_MOVE, localReg, reg, 0), line);
@@ -872,17 +1272,24 @@ static void compileNode(Compiler* c, Node* node) {
 bool compileToBytecode(VM* vm, Node* ast, BytecodeChunk* chunk, const char* modulePath) {
     Compiler compiler;
     initCompiler(&compiler, vm, chunk, modulePath);
+    ModuleFacts facts = {.rootIndex = 0};
+    compiler.facts = &facts;
+    findModuleStructs(&compiler, ast);
+    findScalarLocals(&compiler, ast, NULL, 0, true);
 
     if (ast && ast->type == NODE_STMT_BLOCK) {
         for (int i = 0; i < ast->block.count; i++) {
+            facts.rootIndex = i;
             compileNode(&compiler, ast->block.statements[i]);
         }
     } else {
         compileNode(&compiler, ast);
     }
 
-    // Implicit halt/return at end of script
-    emit(&compiler, ENCODE_A(OP_RETURNNIL, 0), 0);
+    // Implicit halt/return at end of script, on the last statement's line
+    int endLine = chunk->codeSize > 0 ? chunk->lineNumbers[chunk->codeSize - 1] : 1;
+    emit(&compiler, ENCODE_A(OP_RETURNNIL, 0), endLine);
+    if (!compiler.hadError) optimizeChunk(chunk);
 
 #ifdef DEBUG_PRINT_CODE
     if (!compiler.hadError) {
@@ -4,8 +4,15 @@
 #include "parser.h"
 #include "lexer.h"
 #include "bytecode/compiler.h"
+#include "bytecode/cache.h"
+#include "bytecode/jit.h"
+#include "runtime/scheduler.h"
+#include "runtime/profiler.h"
+#include "runtime/fileio.h"
+#include "runtime/extension.h"
+#include "runtime/imports.h"
 #include "vm.h"
-#include <libgen.h>
+#include <limits.h>
 #include <stdio.h>
 #include <sys/time.h>
 
@@ -21,21 +28,6 @@ static inline uint64_t getMicroseconds() {
     return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
-static char* readFile_internal(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (!file) return NULL;
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
-    char* buffer = malloc(fileSize + 1);
-    if (!buffer) { fclose(file); return NULL; }
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    if (bytesRead < fileSize) { free(buffer); fclose(file); return NULL; }
-    buffer[bytesRead] = '\0';
-    fclose(file);
-    return buffer;
-}
-
 // Truthiness evaluation
 static inline bool isTruthy(Value v) {
     if (IS_BOOL(v)) return AS_BOOL(v);
@@ -45,6 +37,82 @@ static inline bool isTruthy(Value v) {
     return true; // Objects are truthy
 }
 
+// Ordering as OP_LT/OP_LE define it: int with int or float with float,
+// anything else compares false
+static inline bool numLess(Value b, Value c) {
+    if (IS_INT(b) && IS_INT(c)) return AS_INT(b) < AS_INT(c);
+    return IS_FLOAT(b) && IS_FLOAT(c) && AS_FLOAT(b) < AS_FLOAT(c);
+}
+
+static inline bool numLessEqual(Value b, Value c) {
+    if (IS_INT(b) && IS_INT(c)) return AS_INT(b) <= AS_INT(c);
+    return IS_FLOAT(b) && IS_FLOAT(c) && AS_FLOAT(b) <= AS_FLOAT(c);
+}
+
+// A string builder or slice equals a string, builder or slice with the same
+// text (two interned strings are only equal if they are the same object)
+static bool viewEqual(Value b, Value c) {
+    if (IS_STRING(b) && IS_STRING(c)) return false;
+    const char *sB, *sC;
+    int lenB, lenC;
+    if (!viewText(b, &sB, &lenB) || !viewText(c, &sC, &lenC)) return false;
+    return lenB == lenC && memcmp(sB, sC, lenB) == 0;
+}
+
+// Equality for OP_EQ/OP_NE (strings are interned, so identity suffices)
+static inline bool valuesEqual(Value b, Value c) {
+    if (IS_INT(b) && IS_INT(c)) return AS_INT(b) == AS_INT(c);
+    if (IS_FLOAT(b) && IS_FLOAT(c)) return AS_FLOAT(b) == AS_FLOAT(c);
+    if (IS_BOOL(b) && IS_BOOL(c)) return AS_BOOL(b) == AS_BOOL(c);
+    if (IS_NIL(b) && IS_NIL(c)) return true;
+    if (IS_OBJ(b) && IS_OBJ(c)) return AS_OBJ(b) == AS_OBJ(c) || viewEqual(b, c);
+    return false;
+}
+
+// Typed arrays have a fixed length and element type; a bad store is an error
+static void typedStoreFailed(TypedArray* ta, Value index, Value value) {
+    const char* kind = ta->kind == TYPED_INT32 ? "Int32Array" : "Float64Array";
+    if (!IS_INT(index)) {
+        printf("Runtime Error: %s index must be an int.\n", kind);
+    } else if (AS_INT(index) < 0 || AS_INT(index) >= ta->count) {
+        printf("Runtime Error: %s index %d out of range (length %d).\n", kind, (int)AS_INT(index), ta->count);
+    } else if (IS_FLOAT(value)) {
+        printf("Runtime Error: %g does not fit in an Int32Array element.\n", AS_FLOAT(value));
+    } else {
+        printf("Runtime Error: %s elements must be numbers.\n", kind);
+    }
+    exit(1);
+}
+
+// OP_ADD beyond int + int: floats (mixed with ints, like OP_SUB), or
+// string concatenation
+static Value addValues(VM* vm, Value vb, Value vc) {
+    if ((IS_INT(vb) || IS_FLOAT(vb)) && (IS_INT(vc) || IS_FLOAT(vc))) {
+        double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
+        double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
+        return FLOAT_VAL(db + dc);
+    }
+    // A builder on the left grows in place and stays the result
+    if (IS_STRING_BUILDER(vb)) {
+        builderAppendValue(vm, AS_STRING_BUILDER(vb), vc);
+        return vb;
+    }
+    if (!IS_STRING(vb) && !IS_STRING_SLICE(vb) && !IS_STRING(vc) &&
+        !IS_STRING_BUILDER(vc) && !IS_STRING_SLICE(vc)) return NIL_VAL;
+
+    char bufB[64], bufC[64], small[256];
+    int lenB, lenC;
+    const char* sB = valueText(vb, bufB, &lenB);
+    const char* sC = valueText(vc, bufC, &lenC);
+
+    char* result = lenB + lenC < (int)sizeof(small) ? small : malloc(lenB + lenC + 1);
+    memcpy(result, sB, lenB);
+    memcpy(result + lenB, sC, lenC);
+    ObjString* str = internString(vm, result, lenB + lenC);
+    if (result != small) free(result);
+    return OBJ_VAL(str);
+}
+
 #define likely(x)   __builtin_expect(!!(x), 1)
 #define unlikely(x) __builtin_expect(!!(x), 0)
 
@@ -109,18 +177,80 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         [OP_PRINT]      = &&op_print,
         [OP_HALT]       = &&op_halt,
         [OP_NOP]        = &&op_nop,
-        [OP_FOREACH_PREP] = &&op_nop,
-        [OP_FOREACH_NEXT] = &&op_nop,
+        [OP_FOREACH_PREP] = &&op_foreach_prep,
+        [OP_FOREACH_NEXT] = &&op_foreach_next,
         [OP_CONCAT]     = &&op_concat,
+        [OP_LTJMP]      = &&op_ltjmp,
+        [OP_LEJMP]      = &&op_lejmp,
+        [OP_EQJMP]      = &&op_eqjmp,
+        [OP_LTJMPK]     = &&op_ltjmpk,
+        [OP_LEJMPK]     = &&op_lejmpk,
+        [OP_GTJMPK]     = &&op_gtjmpk,
+        [OP_GEJMPK]     = &&op_gejmpk,
+        [OP_EQJMPK]     = &&op_eqjmpk,
+        [OP_GETIDXI]    = &&op_getidxi,
+        [OP_ADD_II]     = &&op_add_ii,
+        [OP_ADD_FF]     = &&op_add_ff,
+        [OP_SUB_II]     = &&op_sub_ii,
+        [OP_SUB_FF]     = &&op_sub_ff,
+        [OP_MUL_II]     = &&op_mul_ii,
+        [OP_MUL_FF]     = &&op_mul_ff,
+        [OP_DIV_FF]     = &&op_div_ff,
+        [OP_LT_II]      = &&op_lt_ii,
+        [OP_LT_FF]      = &&op_lt_ff,
+        [OP_LE_II]      = &&op_le_ii,
+        [OP_LE_FF]      = &&op_le_ff,
+        [OP_GT_II]      = &&op_gt_ii,
+        [OP_GT_FF]      = &&op_gt_ff,
+        [OP_GE_II]      = &&op_ge_ii,
+        [OP_GE_FF]      = &&op_ge_ff,
+        [OP_LTJMP_II]   = &&op_ltjmp_ii,
+        [OP_LTJMP_FF]   = &&op_ltjmp_ff,
+        [OP_LEJMP_II]   = &&op_lejmp_ii,
+        [OP_LEJMP_FF]   = &&op_lejmp_ff,
+        [OP_GETIDX_ARR_I] = &&op_getidx_arr_i,
+        [OP_SETIDX_ARR_I] = &&op_setidx_arr_i,
+        [OP_GETIDX_TA_I]  = &&op_getidx_ta_i,
+        [OP_SETIDX_TA_I]  = &&op_setidx_ta_i,
     };
+    // After native code stops at an instruction, the dispatch that follows
+    // it goes back into native code (jit_resume)
+    static void* resumeTable[OPCODE_COUNT] = { [0 ... OPCODE_COUNT - 1] = &&jit_resume };
+    void** table = dispatchTable;
+
+#ifdef UNNARIZE_PROFILE
+    // Counting profile: hit counters of the running chunk, NULL when off.
+    // A dispatch at or before the previous one in the same chunk is a loop.
+    uint64_t* profHits = NULL;
+    uint32_t* profLast = NULL;
+    #define PROFILE_SYNC() do { profHits = profileHits(vm, chunk); profLast = NULL; } while(0)
+    #define PROFILE_INSTRUCTION() do { \
+        if (unlikely(profHits != NULL)) { \
+            if (ip <= profLast) vm->profiler->counters.loopsExecuted++; \
+            profLast = ip; \
+            vm->profiler->opCounts[DECODE_OP(*ip)]++; \
+            profHits[ip - chunk->code]++; \
+        } \
+    } while(0)
+#else
+    #define PROFILE_SYNC() ((void)0)
+    #define PROFILE_INSTRUCTION() ((void)0)
+#endif
 
     #define DISPATCH() do { \
+        PROFILE_INSTRUCTION(); \
         uint32_t _inst = *ip; \
-        goto *dispatchTable[DECODE_OP(_inst)]; \
+        goto *table[DECODE_OP(_inst)]; \
     } while(0)
     #define NEXT() do { ip++; DISPATCH(); } while(0)
     #define FETCH() (*ip)
+    // Replace the running instruction's opcode, keeping its operands
+    #define QUICKEN(op) (*ip = (inst & 0x00FFFFFFu) | ((uint32_t)(op) << 24))
+    // Calls and backward branches count down to compiling the chunk
+    #define TIER_CHECK() do { if (unlikely(--chunk->hotness <= 0)) goto jit_tier; } while(0)
 
+    PROFILE_SYNC();
+    TIER_CHECK();
     DISPATCH();
 
     // ===== DATA MOVEMENT =====
@@ -162,24 +292,17 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
     }
 
     // ===== GLOBAL VARIABLES =====
+    // Bx is the slot the compiler reserved in the running chunk's global env
     op_getglobal: {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst);
         uint16_t bx = DECODE_Bx(inst);
-        ObjString* name = AS_STRING(constants[bx]);
-        unsigned int h = name->hash % TABLE_SIZE;
-        VarEntry* entry = vm->globalEnv->buckets[h];
-        while (entry) {
-            if (entry->key == name->chars ||
-                (entry->keyLength == name->length && memcmp(entry->key, name->chars, name->length) == 0)) {
-                regs[a] = entry->value;
-                goto getglobal_done;
-            }
-            entry = entry->next;
+        VarEntry* entry = &vm->globalEnv->vars[bx];
+        if (IS_UNDEFINED(entry->value)) {
+            printf("Runtime Error: Undefined variable '%s'\n", entry->key);
+            exit(1);
         }
-        printf("Runtime Error: Undefined variable '%s'\n", name->chars);
-        exit(1);
-        getglobal_done:
+        regs[a] = entry->value;
         NEXT();
     }
 
@@ -187,27 +310,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst);
         uint16_t bx = DECODE_Bx(inst);
-        ObjString* name = AS_STRING(constants[bx]);
-        unsigned int h = name->hash % TABLE_SIZE;
-        VarEntry* entry = vm->globalEnv->buckets[h];
-        while (entry) {
-            if (entry->key == name->chars ||
-                (entry->keyLength == name->length && memcmp(entry->key, name->chars, name->length) == 0)) {
-                entry->value = regs[a];
-                WRITE_BARRIER(vm, vm->globalEnv);
-                NEXT();
-            }
-            entry = entry->next;
-        }
-        // Insert new
-        VarEntry* ne = malloc(sizeof(VarEntry));
-        ne->key = name->chars;
-        ne->keyString = name;
-        ne->keyLength = name->length;
-        ne->ownsKey = false;
-        ne->value = regs[a];
-        ne->next = vm->globalEnv->buckets[h];
-        vm->globalEnv->buckets[h] = ne;
+        vm->globalEnv->vars[bx].value = regs[a];
         WRITE_BARRIER(vm, vm->globalEnv);
         NEXT();
     }
@@ -216,32 +319,8 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst);
         uint16_t bx = DECODE_Bx(inst);
-        ObjString* name = AS_STRING(constants[bx]);
-        unsigned int h = name->hash % TABLE_SIZE;
-
-        VarEntry* entry = vm->globalEnv->buckets[h];
-        while (entry) {
-            if (entry->key == name->chars ||
-                (entry->keyLength == name->length && memcmp(entry->key, name->chars, name->length) == 0)) {
-                entry->value = regs[a];
-                WRITE_BARRIER(vm, vm->globalEnv);
-                goto defglobal_done;
-            }
-            entry = entry->next;
-        }
-        // Insert new
-        {
-            VarEntry* ne = malloc(sizeof(VarEntry));
-            ne->key = name->chars;
-            ne->keyString = name;
-            ne->keyLength = name->length;
-            ne->ownsKey = false;
-            ne->value = regs[a];
-            ne->next = vm->globalEnv->buckets[h];
-            vm->globalEnv->buckets[h] = ne;
-            WRITE_BARRIER(vm, vm->globalEnv);
-        }
-        defglobal_done:
+        vm->globalEnv->vars[bx].value = regs[a];
+        WRITE_BARRIER(vm, vm->globalEnv);
         NEXT();
     }
 
@@ -252,42 +331,14 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value vb = regs[b], vc = regs[c];
 
         if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_ADD_II);
             regs[a] = INT_VAL(AS_INT(vb) + AS_INT(vc));
-        } else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
-            double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
-            double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
-            regs[a] = FLOAT_VAL(db + dc);
-        } else if (IS_STRING(vb) || IS_STRING(vc)) {
-            // String concatenation
-            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
-            char bufB[64], bufC[64];
-            const char* sB;
-            const char* sC;
-
-            if (IS_STRING(vb)) sB = AS_CSTRING(vb);
-            else if (IS_INT(vb)) { snprintf(bufB, 64, "%ld", (long)AS_INT(vb)); sB = bufB; }
-            else if (IS_FLOAT(vb)) { snprintf(bufB, 64, "%.14g", AS_FLOAT(vb)); sB = bufB; }
-            else if (IS_BOOL(vb)) sB = AS_BOOL(vb) ? "true" : "false";
-            else if (IS_NIL(vb)) sB = "nil";
-            else sB = "[object]";
-
-            if (IS_STRING(vc)) sC = AS_CSTRING(vc);
-            else if (IS_INT(vc)) { snprintf(bufC, 64, "%ld", (long)AS_INT(vc)); sC = bufC; }
-            else if (IS_FLOAT(vc)) { snprintf(bufC, 64, "%.14g", AS_FLOAT(vc)); sC = bufC; }
-            else if (IS_BOOL(vc)) sC = AS_BOOL(vc) ? "true" : "false";
-            else if (IS_NIL(vc)) sC = "nil";
-            else sC = "[object]";
-
-            size_t lenB = strlen(sB), lenC = strlen(sC);
-            char* result = malloc(lenB + lenC + 1);
-            memcpy(result, sB, lenB);
-            memcpy(result + lenB, sC, lenC);
-            result[lenB + lenC] = '\0';
-            ObjString* str = internString(vm, result, lenB + lenC);
-            free(result);
-            regs[a] = OBJ_VAL(str);
+        } else if (IS_FLOAT(vb) && IS_FLOAT(vc)) {
+            QUICKEN(OP_ADD_FF);
+            regs[a] = FLOAT_VAL(AS_FLOAT(vb) + AS_FLOAT(vc));
         } else {
-            regs[a] = NIL_VAL;
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            regs[a] = addValues(vm, vb, vc);
         }
         NEXT();
     }
@@ -296,14 +347,12 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst);
         int val = DECODE_sBx(inst);
-        Value vb = regs[a]; // For ADDI, we usually accumulate to R(A), wait, format is AsBx?
-        // Let's use AsBx format: R(A) = R(A) + sBx
-        if (likely(IS_INT(vb))) {
-            regs[a] = INT_VAL(AS_INT(vb) + val);
-        } else if (IS_FLOAT(vb)) {
-            regs[a] = FLOAT_VAL(AS_FLOAT(vb) + (double)val);
+        Value va = regs[a]; // R(A) = R(A) + sBx
+        if (likely(IS_INT(va))) {
+            regs[a] = INT_VAL(AS_INT(va) + val);
         } else {
-            // Unlikely string fallback
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            regs[a] = addValues(vm, va, INT_VAL(val));
         }
         NEXT();
     }
@@ -313,8 +362,10 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
         if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_SUB_II);
             regs[a] = INT_VAL(AS_INT(vb) - AS_INT(vc));
         } else {
+            if (IS_FLOAT(vb) && IS_FLOAT(vc)) QUICKEN(OP_SUB_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = FLOAT_VAL(db - dc);
@@ -326,13 +377,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst);
         int val = DECODE_sBx(inst);
-        Value vb = regs[a]; // R(A) = R(A) - sBx
-        if (likely(IS_INT(vb))) {
-            regs[a] = INT_VAL(AS_INT(vb) - val);
-        } else if (IS_FLOAT(vb)) {
-            regs[a] = FLOAT_VAL(AS_FLOAT(vb) - (double)val);
+        Value va = regs[a]; // R(A) = R(A) - sBx
+        if (likely(IS_INT(va))) {
+            regs[a] = INT_VAL(AS_INT(va) - val);
         } else {
-            // Unlikely string fallback
+            regs[a] = FLOAT_VAL(AS_FLOAT(va) - (double)val);
         }
         NEXT();
     }
@@ -342,8 +391,10 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
         if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_MUL_II);
             regs[a] = INT_VAL(AS_INT(vb) * AS_INT(vc));
         } else {
+            if (IS_FLOAT(vb) && IS_FLOAT(vc)) QUICKEN(OP_MUL_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = FLOAT_VAL(db * dc);
@@ -360,6 +411,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             if (unlikely(ic == 0)) { printf("Runtime Error: Division by zero.\n"); exit(1); }
             regs[a] = INT_VAL(AS_INT(vb) / ic);
         } else {
+            if (IS_FLOAT(vb) && IS_FLOAT(vc)) QUICKEN(OP_DIV_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = FLOAT_VAL(db / dc);
@@ -372,7 +424,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         if (IS_INT(regs[b]) && IS_INT(regs[c])) {
             regs[a] = INT_VAL(AS_INT(regs[b]) % AS_INT(regs[c]));
-        }
+        } else regs[a] = NIL_VAL;
         NEXT();
     }
 
@@ -381,6 +433,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst);
         if (IS_INT(regs[b])) regs[a] = INT_VAL(-AS_INT(regs[b]));
         else if (IS_FLOAT(regs[b])) regs[a] = FLOAT_VAL(-AS_FLOAT(regs[b]));
+        else regs[a] = NIL_VAL;
         NEXT();
     }
 
@@ -389,8 +442,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
-        if (likely(IS_INT(vb) && IS_INT(vc))) { regs[a] = BOOL_VAL(AS_INT(vb) < AS_INT(vc)); }
-        else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_LT_II);
+            regs[a] = BOOL_VAL(AS_INT(vb) < AS_INT(vc));
+        } else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+            QUICKEN(OP_LT_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = BOOL_VAL(db < dc);
@@ -402,8 +458,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
-        if (likely(IS_INT(vb) && IS_INT(vc))) { regs[a] = BOOL_VAL(AS_INT(vb) <= AS_INT(vc)); }
-        else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_LE_II);
+            regs[a] = BOOL_VAL(AS_INT(vb) <= AS_INT(vc));
+        } else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+            QUICKEN(OP_LE_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = BOOL_VAL(db <= dc);
@@ -415,8 +474,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
-        if (likely(IS_INT(vb) && IS_INT(vc))) { regs[a] = BOOL_VAL(AS_INT(vb) > AS_INT(vc)); }
-        else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_GT_II);
+            regs[a] = BOOL_VAL(AS_INT(vb) > AS_INT(vc));
+        } else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+            QUICKEN(OP_GT_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = BOOL_VAL(db > dc);
@@ -428,8 +490,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         Value vb = regs[b], vc = regs[c];
-        if (likely(IS_INT(vb) && IS_INT(vc))) { regs[a] = BOOL_VAL(AS_INT(vb) >= AS_INT(vc)); }
-        else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_GE_II);
+            regs[a] = BOOL_VAL(AS_INT(vb) >= AS_INT(vc));
+        } else if (IS_NUMBER(vb) && IS_NUMBER(vc)) {
+            QUICKEN(OP_GE_FF);
             double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
             double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
             regs[a] = BOOL_VAL(db >= dc);
@@ -439,26 +504,13 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
 
     op_eq: {
         uint32_t inst = FETCH();
-        uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
-        Value vb = regs[b], vc = regs[c];
-        if (IS_INT(vb) && IS_INT(vc)) { regs[a] = BOOL_VAL(AS_INT(vb) == AS_INT(vc)); }
-        else if (IS_FLOAT(vb) && IS_FLOAT(vc)) { regs[a] = BOOL_VAL(AS_FLOAT(vb) == AS_FLOAT(vc)); }
-        else if (IS_BOOL(vb) && IS_BOOL(vc)) { regs[a] = BOOL_VAL(AS_BOOL(vb) == AS_BOOL(vc)); }
-        else if (IS_NIL(vb) && IS_NIL(vc)) { regs[a] = BOOL_VAL(true); }
-        else if (IS_OBJ(vb) && IS_OBJ(vc)) { regs[a] = BOOL_VAL(AS_OBJ(vb) == AS_OBJ(vc)); }
-        else regs[a] = BOOL_VAL(false);
+        regs[DECODE_A(inst)] = BOOL_VAL(valuesEqual(regs[DECODE_B(inst)], regs[DECODE_C(inst)]));
         NEXT();
     }
 
     op_ne: {
         uint32_t inst = FETCH();
-        uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
-        Value vb = regs[b], vc = regs[c];
-        if (IS_INT(vb) && IS_INT(vc)) { regs[a] = BOOL_VAL(AS_INT(vb) != AS_INT(vc)); }
-        else if (IS_FLOAT(vb) && IS_FLOAT(vc)) { regs[a] = BOOL_VAL(AS_FLOAT(vb) != AS_FLOAT(vc)); }
-        else if (IS_BOOL(vb) && IS_BOOL(vc)) { regs[a] = BOOL_VAL(AS_BOOL(vb) != AS_BOOL(vc)); }
-        else if (IS_NIL(vb) && IS_NIL(vc)) { regs[a] = BOOL_VAL(false); }
-        else regs[a] = BOOL_VAL(true);
+        regs[DECODE_A(inst)] = BOOL_VAL(!valuesEqual(regs[DECODE_B(inst)], regs[DECODE_C(inst)]));
         NEXT();
     }
 
@@ -473,6 +525,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         int offset = DECODE_sBx24(inst);
         ip += offset + 1;
+        if (offset < 0) TIER_CHECK();
         DISPATCH();
     }
 
@@ -481,6 +534,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         if (!isTruthy(regs[DECODE_A(inst)])) {
             int offset = DECODE_sBx(inst);
             ip += offset + 1;
+            if (offset < 0) TIER_CHECK();
             DISPATCH();
         }
         NEXT();
@@ -491,6 +545,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         if (isTruthy(regs[DECODE_A(inst)])) {
             int offset = DECODE_sBx(inst);
             ip += offset + 1;
+            if (offset < 0) TIER_CHECK();
             DISPATCH();
         }
         NEXT();
@@ -500,6 +555,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint32_t inst = FETCH();
         int offset = DECODE_sBx24(inst);
         ip -= offset - 1;
+        TIER_CHECK();
         DISPATCH();
     }
 
@@ -527,7 +583,18 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
                 // Native call: pass args from regs[funcReg+1..funcReg+argCount]
                 vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
                 Value* args = &regs[funcReg + 1];
-                Value result = func->native(vm, args, argCount);
+                if (!func->keepsViews) {
+                    // Natives see a builder or slice as the string it holds
+                    for (int i = 0; i < argCount; i++) {
+                        if (unlikely(IS_STRING_BUILDER(args[i]))) {
+                            args[i] = OBJ_VAL(flattenBuilder(vm, AS_STRING_BUILDER(args[i])));
+                        } else if (unlikely(IS_STRING_SLICE(args[i]))) {
+                            args[i] = OBJ_VAL(flattenSlice(vm, AS_STRING_SLICE(args[i])));
+                        }
+                    }
+                }
+                Value result;
+                PROFILE_NATIVE_CALL(vm, func, result = func->native(vm, args, argCount));
                 regs[funcReg] = result;
                 NEXT();
             }
@@ -537,10 +604,22 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
                 exit(1);
             }
 
+            if (unlikely(func->isAsync)) {
+                // Async call: runs as a task until it first suspends, yields a Future
+                vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+                regs[funcReg] = spawnTask(vm, func, &regs[funcReg + 1], argCount);
+                NEXT();
+            }
+
             if (unlikely(vm->callStackTop >= CALL_STACK_MAX)) {
                 printf("Runtime Error: Stack overflow.\n");
                 exit(1);
             }
+            // The callee's window must fit; isolates may have small register files
+            if (unlikely(vm->regBase + funcReg + FRAME_REG_MAX > vm->regCapacity)) {
+                printf("Runtime Error: Register file overflow.\n");
+                exit(1);
+            }
 
             // Save current frame
             CallFrame* frame = &vm->callStack[vm->callStackTop++];
@@ -565,6 +644,9 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             chunk = func->bytecodeChunk;
             constants = chunk->constants;
             ip = chunk->code;
+            PROFILE_ENTER(vm, frame, func);
+            PROFILE_SYNC();
+            TIER_CHECK();
             DISPATCH();
 
         } else if (obj->type == OBJ_STRUCT_DEF) {
@@ -576,9 +658,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             }
 
             vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
-            StructInstance* inst = ALLOCATE_OBJ(vm, StructInstance, OBJ_STRUCT_INSTANCE);
-            inst->def = def;
-            inst->fields = malloc(sizeof(Value) * def->fieldCount);
+            StructInstance* inst = newStructInstance(vm, def);
             for (int i = 0; i < argCount; i++) {
                 inst->fields[i] = regs[funcReg + 1 + i];
             }
@@ -595,7 +675,9 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value retVal = regs[DECODE_A(inst)];
 
         vm->callStackTop--;
+        PROFILE_LEAVE(vm, &vm->callStack[vm->callStackTop]);
         if (vm->callStackTop == entryStackDepth) {
+            regs[0] = retVal; // Hand result back to a native re-entry (R0 = callee slot)
             return getMicroseconds() - startTime;
         }
 
@@ -609,15 +691,19 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         chunk = frame->chunk;
         constants = chunk->constants;
         ip = frame->ip;
+        PROFILE_SYNC();
 
         // Store return value in caller's result register
         regs[frame->resultReg] = retVal;
+        if (unlikely(chunk->jit != NULL)) goto jit_run;
         DISPATCH();
     }
 
     op_returnnil: {
         vm->callStackTop--;
+        PROFILE_LEAVE(vm, &vm->callStack[vm->callStackTop]);
         if (vm->callStackTop == entryStackDepth) {
+            regs[0] = NIL_VAL;
             return getMicroseconds() - startTime;
         }
 
@@ -631,8 +717,10 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         chunk = frame->chunk;
         constants = chunk->constants;
         ip = frame->ip;
+        PROFILE_SYNC();
 
         regs[frame->resultReg] = NIL_VAL;
+        if (unlikely(chunk->jit != NULL)) goto jit_run;
         DISPATCH();
     }
 
@@ -645,11 +733,19 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
 
         if (IS_OBJ(objVal)) {
             Obj* obj = AS_OBJ(objVal);
+            PropCache* ic = (likely(chunk->propCaches) ? chunk->propCaches : allocPropCaches(chunk))
+                            + (ip - chunk->code);
 
             if (obj->type == OBJ_STRUCT_INSTANCE) {
                 StructInstance* si = (StructInstance*)obj;
+                if (likely(ic->shape == (Obj*)si->def)) {
+                    regs[a] = si->fields[ic->index];
+                    NEXT();
+                }
                 for (int i = 0; i < si->def->fieldCount; i++) {
                     if (strcmp(si->def->fields[i], name->chars) == 0) {
+                        ic->shape = (Obj*)si->def;
+                        ic->index = i;
                         regs[a] = si->fields[i];
                         NEXT();
                     }
@@ -659,21 +755,25 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             }
             else if (obj->type == OBJ_MODULE) {
                 Module* mod = (Module*)obj;
-                unsigned int h = name->hash % TABLE_SIZE;
-                VarEntry* e = mod->env->buckets[h];
-                while (e) {
-                    if (strcmp(e->key, name->chars) == 0) {
-                        regs[a] = e->value;
-                        NEXT();
-                    }
-                    e = e->next;
+                if (likely(ic->shape == (Obj*)mod->env)) {
+                    regs[a] = mod->env->vars[ic->index].value;
+                    NEXT();
+                }
+                VarEntry* e = envFindEntry(mod->env, name->chars, name->length, name->hash);
+                if (e && !IS_UNDEFINED(e->value)) {
+                    // Slots are stable and never become undefined again
+                    ic->shape = (Obj*)mod->env;
+                    ic->index = (int)(e - mod->env->vars);
+                    regs[a] = e->value;
+                    NEXT();
                 }
                 printf("Runtime Error: Undefined property '%s' in module '%s'.\n", name->chars, mod->name);
                 exit(1);
             }
-            else if (obj->type == OBJ_STRING) {
+            else if (obj->type == OBJ_STRING || obj->type == OBJ_STRING_SLICE) {
                 if (name->length == 6 && memcmp(name->chars, "length", 6) == 0) {
-                    regs[a] = INT_VAL(((ObjString*)obj)->length);
+                    regs[a] = INT_VAL(obj->type == OBJ_STRING ? ((ObjString*)obj)->length
+                                                              : ((StringSlice*)obj)->length);
                     NEXT();
                 }
             }
@@ -691,8 +791,17 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
 
         if (IS_OBJ(objVal) && AS_OBJ(objVal)->type == OBJ_STRUCT_INSTANCE) {
             StructInstance* si = (StructInstance*)AS_OBJ(objVal);
+            PropCache* ic = (likely(chunk->propCaches) ? chunk->propCaches : allocPropCaches(chunk))
+                            + (ip - chunk->code);
+            if (likely(ic->shape == (Obj*)si->def)) {
+                si->fields[ic->index] = val;
+                WRITE_BARRIER(vm, si);
+                NEXT();
+            }
             for (int i = 0; i < si->def->fieldCount; i++) {
                 if (strcmp(si->def->fields[i], name->chars) == 0) {
+                    ic->shape = (Obj*)si->def;
+                    ic->index = i;
                     si->fields[i] = val;
                     WRITE_BARRIER(vm, si);
                     NEXT();
@@ -712,15 +821,21 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value target = regs[b], index = regs[c];
 
         if (IS_ARRAY(target) && IS_INT(index)) {
+            QUICKEN(OP_GETIDX_ARR_I);
             Array* arr = (Array*)AS_OBJ(target);
             int idx = (int)AS_INT(index);
             regs[a] = (idx >= 0 && idx < arr->count) ? arr->items[idx] : NIL_VAL;
+        } else if (IS_TYPED_ARRAY(target) && IS_INT(index)) {
+            QUICKEN(OP_GETIDX_TA_I);
+            regs[a] = typedArrayGet(AS_TYPED_ARRAY(target), (int)AS_INT(index));
         } else if (IS_MAP(target)) {
             Map* map = (Map*)AS_OBJ(target);
-            if (IS_STRING(index)) {
-                ObjString* key = AS_STRING(index);
+            const char* key;
+            int keyLength;
+            if (viewText(index, &key, &keyLength)) {
+                // Builders and slices are looked up by their text, uninterned
                 int bucket;
-                MapEntry* e = mapFindEntry(map, key->chars, key->length, &bucket);
+                MapEntry* e = mapFindEntry(map, key, keyLength, &bucket);
                 regs[a] = e ? e->value : NIL_VAL;
             } else if (IS_INT(index)) {
                 int bucket;
@@ -737,9 +852,11 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value target = regs[a], index = regs[b], value = regs[c];
 
         if (IS_ARRAY(target) && IS_INT(index)) {
+            QUICKEN(OP_SETIDX_ARR_I);
             Array* arr = (Array*)AS_OBJ(target);
             int idx = (int)AS_INT(index);
             if (idx >= 0) {
+                arrayWritable(vm, arr);
                 if (idx >= arr->capacity) {
                     int newCap = idx + 1;
                     if (newCap < arr->capacity * 2) newCap = arr->capacity * 2;
@@ -753,11 +870,18 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
                 arr->items[idx] = value;
                 WRITE_BARRIER(vm, arr);
             }
+        } else if (IS_TYPED_ARRAY(target)) {
+            TypedArray* ta = AS_TYPED_ARRAY(target);
+            if (IS_INT(index)) QUICKEN(OP_SETIDX_TA_I);
+            if (!IS_INT(index) || !typedArraySet(ta, (int)AS_INT(index), value)) {
+                typedStoreFailed(ta, index, value);
+            }
         } else if (IS_MAP(target)) {
             Map* map = (Map*)AS_OBJ(target);
-            if (IS_STRING(index)) {
-                ObjString* key = AS_STRING(index);
-                mapSetStr(map, key->chars, key->length, value);
+            const char* key;
+            int keyLength;
+            if (viewText(index, &key, &keyLength)) {
+                mapSetStr(map, key, keyLength, value); // Copies the key
             } else if (IS_INT(index)) {
                 mapSetInt(map, (int)AS_INT(index), value);
             }
@@ -791,10 +915,8 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         StructDef* def = (StructDef*)AS_OBJ(regs[b]);
         vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
-        StructInstance* si = ALLOCATE_OBJ(vm, StructInstance, OBJ_STRUCT_INSTANCE);
-        si->def = def;
-        si->fields = malloc(sizeof(Value) * c);
-        for (int i = 0; i < c; i++) {
+        StructInstance* si = newStructInstance(vm, def);
+        for (int i = 0; i < c && i < si->fieldCount; i++) {
             si->fields[i] = regs[a + 1 + i];
         }
         regs[a] = OBJ_VAL(si);
@@ -895,18 +1017,78 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value v = regs[b];
         int count = 0;
         if (IS_ARRAY(v)) count = ((Array*)AS_OBJ(v))->count;
+        else if (IS_TYPED_ARRAY(v)) count = AS_TYPED_ARRAY(v)->count;
         else if (IS_STRING(v)) count = ((ObjString*)AS_OBJ(v))->length;
+        else if (IS_STRING_BUILDER(v)) count = AS_STRING_BUILDER(v)->length;
+        else if (IS_STRING_SLICE(v)) count = AS_STRING_SLICE(v)->length;
         else if (IS_MAP(v)) {
-            Map* m = (Map*)AS_OBJ(v);
-            for (int i = 0; i < TABLE_SIZE; i++) {
-                MapEntry* e = m->buckets[i];
-                while (e) { count++; e = e->next; }
-            }
+            count = ((Map*)AS_OBJ(v))->count;
         }
         regs[a] = INT_VAL(count);
         NEXT();
     }
 
+    // ===== FOREACH =====
+    // Arrays yield their items, maps their keys in insertion order, strings
+    // their characters, and resources with a 'next' hook each element it
+    // produces. Anything else iterates zero times.
+    op_foreach_prep: {
+        uint32_t inst = FETCH();
+        regs[DECODE_A(inst) + 1] = INT_VAL(0);
+        NEXT();
+    }
+
+    op_foreach_next: {
+        uint32_t inst = FETCH();
+        uint8_t a = DECODE_A(inst);
+        Value col = regs[a];
+        int pos = (int)AS_INT(regs[a + 1]);
+
+        if (likely(IS_ARRAY(col))) {
+            Array* arr = (Array*)AS_OBJ(col);
+            if (pos >= arr->count) NEXT();
+            regs[a + 2] = arr->items[pos];
+        } else if (IS_TYPED_ARRAY(col)) {
+            TypedArray* ta = AS_TYPED_ARRAY(col);
+            if (pos >= ta->count) NEXT();
+            regs[a + 2] = typedArrayGet(ta, pos);
+        } else if (IS_MAP(col)) {
+            Map* map = (Map*)AS_OBJ(col);
+            if (pos >= map->count) NEXT();
+            MapEntry* e = &map->entries[pos];
+            if (e->isIntKey) {
+                regs[a + 2] = INT_VAL(e->intKey);
+            } else {
+                vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+                regs[a + 2] = OBJ_VAL(internString(vm, e->key, e->keyLength));
+            }
+        } else if (IS_STRING(col)) {
+            ObjString* str = AS_STRING(col);
+            if (pos >= str->length) NEXT();
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            regs[a + 2] = OBJ_VAL(internString(vm, str->chars + pos, 1));
+        } else if (IS_STRING_SLICE(col)) {
+            StringSlice* str = AS_STRING_SLICE(col);
+            if (pos >= str->length) NEXT();
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            regs[a + 2] = OBJ_VAL(internString(vm, str->chars + pos, 1));
+        } else if (IS_OBJ(col) && AS_OBJ(col)->type == OBJ_RESOURCE &&
+                   ((ObjResource*)AS_OBJ(col))->next) {
+            ObjResource* res = (ObjResource*)AS_OBJ(col);
+            Value item;
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            if (!res->next(vm, res->data, &item)) NEXT();
+            regs[a + 2] = item;
+        } else {
+            NEXT();
+        }
+
+        regs[a + 1] = INT_VAL(pos + 1);
+        ip += DECODE_sBx(inst) + 1;
+        if (DECODE_sBx(inst) < 0) TIER_CHECK();
+        DISPATCH();
+    }
+
     // ===== CONCAT =====
     op_concat: {
         uint32_t inst = FETCH();
@@ -925,6 +1107,202 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         NEXT();
     }
 
+    // ===== COMPARE AND BRANCH =====
+    // ip[1] is an OP_JMP; follow it when the result equals A, else skip it
+    #define CMP_JUMP(result) do { \
+        if ((result) == (bool)DECODE_A(inst)) { \
+            int _offset = DECODE_sBx24(ip[1]) + 2; \
+            ip += _offset; \
+            if (_offset <= 0) TIER_CHECK(); \
+        } else ip += 2; \
+        DISPATCH(); \
+    } while (0)
+
+    op_ltjmp: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], vc = regs[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_LTJMP_II);
+            CMP_JUMP(AS_INT(vb) < AS_INT(vc));
+        }
+        if (IS_FLOAT(vb) && IS_FLOAT(vc)) QUICKEN(OP_LTJMP_FF);
+        CMP_JUMP(numLess(vb, vc));
+    }
+
+    op_lejmp: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], vc = regs[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(vc))) {
+            QUICKEN(OP_LEJMP_II);
+            CMP_JUMP(AS_INT(vb) <= AS_INT(vc));
+        }
+        if (IS_FLOAT(vb) && IS_FLOAT(vc)) QUICKEN(OP_LEJMP_FF);
+        CMP_JUMP(numLessEqual(vb, vc));
+    }
+
+    op_eqjmp: {
+        uint32_t inst = FETCH();
+        CMP_JUMP(valuesEqual(regs[DECODE_B(inst)], regs[DECODE_C(inst)]));
+    }
+
+    op_ltjmpk: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], kc = constants[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(kc))) CMP_JUMP(AS_INT(vb) < AS_INT(kc));
+        CMP_JUMP(numLess(vb, kc));
+    }
+
+    op_lejmpk: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], kc = constants[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(kc))) CMP_JUMP(AS_INT(vb) <= AS_INT(kc));
+        CMP_JUMP(numLessEqual(vb, kc));
+    }
+
+    op_gtjmpk: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], kc = constants[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(kc))) CMP_JUMP(AS_INT(vb) > AS_INT(kc));
+        CMP_JUMP(numLess(kc, vb));
+    }
+
+    op_gejmpk: {
+        uint32_t inst = FETCH();
+        Value vb = regs[DECODE_B(inst)], kc = constants[DECODE_C(inst)];
+        if (likely(IS_INT(vb) && IS_INT(kc))) CMP_JUMP(AS_INT(vb) >= AS_INT(kc));
+        CMP_JUMP(numLessEqual(kc, vb));
+    }
+
+    op_eqjmpk: {
+        uint32_t inst = FETCH();
+        CMP_JUMP(valuesEqual(regs[DECODE_B(inst)], constants[DECODE_C(inst)]));
+    }
+
+    op_getidxi: {
+        uint32_t inst = FETCH();
+        uint8_t a = DECODE_A(inst);
+        int idx = DECODE_C(inst);
+        Value target = regs[DECODE_B(inst)];
+
+        if (IS_ARRAY(target)) {
+            Array* arr = (Array*)AS_OBJ(target);
+            regs[a] = idx < arr->count ? arr->items[idx] : NIL_VAL;
+        } else if (IS_TYPED_ARRAY(target)) {
+            regs[a] = typedArrayGet(AS_TYPED_ARRAY(target), idx);
+        } else if (IS_MAP(target)) {
+            int bucket;
+            MapEntry* e = mapFindEntryInt((Map*)AS_OBJ(target), idx, &bucket);
+            regs[a] = e ? e->value : NIL_VAL;
+        } else regs[a] = NIL_VAL;
+        NEXT();
+    }
+
+    // ===== QUICKENED VARIANTS =====
+    // Written over a generic instruction by its handler (QUICKEN). Each
+    // checks its operand types; on a mismatch it restores the generic
+    // opcode and re-executes the instruction there. IS_INT(x & y) tests
+    // both tags at once: the AND keeps a tag bit only if both values have it.
+    #define QUICK_BINARY(guard, result, generic, genericLabel) do { \
+        uint32_t inst = FETCH(); \
+        Value vb = regs[DECODE_B(inst)], vc = regs[DECODE_C(inst)]; \
+        if (likely(guard)) { regs[DECODE_A(inst)] = (result); NEXT(); } \
+        QUICKEN(generic); \
+        goto genericLabel; \
+    } while (0)
+    #define BOTH_INT   IS_INT(vb & vc)
+    #define BOTH_FLOAT (IS_FLOAT(vb) && IS_FLOAT(vc))
+
+    op_add_ii: QUICK_BINARY(BOTH_INT, INT_VAL(AS_INT(vb) + AS_INT(vc)), OP_ADD, op_add);
+    op_add_ff: QUICK_BINARY(BOTH_FLOAT, FLOAT_VAL(AS_FLOAT(vb) + AS_FLOAT(vc)), OP_ADD, op_add);
+    op_sub_ii: QUICK_BINARY(BOTH_INT, INT_VAL(AS_INT(vb) - AS_INT(vc)), OP_SUB, op_sub);
+    op_sub_ff: QUICK_BINARY(BOTH_FLOAT, FLOAT_VAL(AS_FLOAT(vb) - AS_FLOAT(vc)), OP_SUB, op_sub);
+    op_mul_ii: QUICK_BINARY(BOTH_INT, INT_VAL(AS_INT(vb) * AS_INT(vc)), OP_MUL, op_mul);
+    op_mul_ff: QUICK_BINARY(BOTH_FLOAT, FLOAT_VAL(AS_FLOAT(vb) * AS_FLOAT(vc)), OP_MUL, op_mul);
+    op_div_ff: QUICK_BINARY(BOTH_FLOAT, FLOAT_VAL(AS_FLOAT(vb) / AS_FLOAT(vc)), OP_DIV, op_div);
+    op_lt_ii:  QUICK_BINARY(BOTH_INT, BOOL_VAL(AS_INT(vb) < AS_INT(vc)), OP_LT, op_lt);
+    op_lt_ff:  QUICK_BINARY(BOTH_FLOAT, BOOL_VAL(AS_FLOAT(vb) < AS_FLOAT(vc)), OP_LT, op_lt);
+    op_le_ii:  QUICK_BINARY(BOTH_INT, BOOL_VAL(AS_INT(vb) <= AS_INT(vc)), OP_LE, op_le);
+    op_le_ff:  QUICK_BINARY(BOTH_FLOAT, BOOL_VAL(AS_FLOAT(vb) <= AS_FLOAT(vc)), OP_LE, op_le);
+    op_gt_ii:  QUICK_BINARY(BOTH_INT, BOOL_VAL(AS_INT(vb) > AS_INT(vc)), OP_GT, op_gt);
+    op_gt_ff:  QUICK_BINARY(BOTH_FLOAT, BOOL_VAL(AS_FLOAT(vb) > AS_FLOAT(vc)), OP_GT, op_gt);
+    op_ge_ii:  QUICK_BINARY(BOTH_INT, BOOL_VAL(AS_INT(vb) >= AS_INT(vc)), OP_GE, op_ge);
+    op_ge_ff:  QUICK_BINARY(BOTH_FLOAT, BOOL_VAL(AS_FLOAT(vb) >= AS_FLOAT(vc)), OP_GE, op_ge);
+
+    #define QUICK_CMP_JUMP(guard, result, generic, genericLabel) do { \
+        uint32_t inst = FETCH(); \
+        Value vb = regs[DECODE_B(inst)], vc = regs[DECODE_C(inst)]; \
+        if (likely(guard)) CMP_JUMP(result); \
+        QUICKEN(generic); \
+        goto genericLabel; \
+    } while (0)
+
+    op_ltjmp_ii: QUICK_CMP_JUMP(BOTH_INT, AS_INT(vb) < AS_INT(vc), OP_LTJMP, op_ltjmp);
+    op_ltjmp_ff: QUICK_CMP_JUMP(BOTH_FLOAT, AS_FLOAT(vb) < AS_FLOAT(vc), OP_LTJMP, op_ltjmp);
+    op_lejmp_ii: QUICK_CMP_JUMP(BOTH_INT, AS_INT(vb) <= AS_INT(vc), OP_LEJMP, op_lejmp);
+    op_lejmp_ff: QUICK_CMP_JUMP(BOTH_FLOAT, AS_FLOAT(vb) <= AS_FLOAT(vc), OP_LEJMP, op_lejmp);
+
+    #undef QUICK_CMP_JUMP
+    #undef BOTH_FLOAT
+    #undef BOTH_INT
+    #undef QUICK_BINARY
+    #undef CMP_JUMP
+
+    op_getidx_arr_i: {
+        uint32_t inst = FETCH();
+        Value target = regs[DECODE_B(inst)], index = regs[DECODE_C(inst)];
+        if (likely(IS_ARRAY(target) && IS_INT(index))) {
+            Array* arr = (Array*)AS_OBJ(target);
+            int idx = (int)AS_INT(index);
+            regs[DECODE_A(inst)] = (idx >= 0 && idx < arr->count) ? arr->items[idx] : NIL_VAL;
+            NEXT();
+        }
+        QUICKEN(OP_GETIDX);
+        goto op_getidx;
+    }
+
+    op_setidx_arr_i: {
+        uint32_t inst = FETCH();
+        Value target = regs[DECODE_A(inst)], index = regs[DECODE_B(inst)];
+        if (likely(IS_ARRAY(target) && IS_INT(index))) {
+            Array* arr = (Array*)AS_OBJ(target);
+            int idx = (int)AS_INT(index);
+            // Stores past the end, or into shared items, go to the generic handler
+            if (likely(idx >= 0 && idx < arr->count && !arr->share)) {
+                arr->items[idx] = regs[DECODE_C(inst)];
+                WRITE_BARRIER(vm, arr);
+                NEXT();
+            }
+            goto op_setidx;
+        }
+        QUICKEN(OP_SETIDX);
+        goto op_setidx;
+    }
+
+    op_getidx_ta_i: {
+        uint32_t inst = FETCH();
+        Value target = regs[DECODE_B(inst)], index = regs[DECODE_C(inst)];
+        if (likely(IS_TYPED_ARRAY(target) && IS_INT(index))) {
+            regs[DECODE_A(inst)] = typedArrayGet(AS_TYPED_ARRAY(target), (int)AS_INT(index));
+            NEXT();
+        }
+        QUICKEN(OP_GETIDX);
+        goto op_getidx;
+    }
+
+    op_setidx_ta_i: {
+        uint32_t inst = FETCH();
+        Value target = regs[DECODE_A(inst)], index = regs[DECODE_B(inst)];
+        if (likely(IS_TYPED_ARRAY(target) && IS_INT(index))) {
+            TypedArray* ta = AS_TYPED_ARRAY(target);
+            if (unlikely(!typedArraySet(ta, (int)AS_INT(index), regs[DECODE_C(inst)]))) {
+                typedStoreFailed(ta, index, regs[DECODE_C(inst)]);
+            }
+            NEXT();
+        }
+        QUICKEN(OP_SETIDX);
+        goto op_setidx;
+    }
+
     // ===== IMPORT =====
     op_import: {
         uint32_t inst = FETCH();
@@ -933,76 +1311,43 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         Value nameVal = constants[bx];
         char* rawPath = AS_CSTRING(nameVal);
 
-        char* importPath = rawPath;
-        char* resolvedPath = NULL;
-
-        if (rawPath[0] == '.') {
-            if (vm->callStackTop > 0) {
-                CallFrame* frame = &vm->callStack[vm->callStackTop - 1];
-                if (frame->function && frame->function->modulePath) {
-                    char* tmp = strdup(frame->function->modulePath);
-                    char* dir = dirname(tmp);
-                    size_t lenDir = strlen(dir);
-                    size_t lenName = strlen(rawPath);
-                    resolvedPath = malloc(lenDir + 1 + lenName + 1);
-                    sprintf(resolvedPath, "%s/%s", dir, rawPath);
-                    importPath = resolvedPath;
-                    free(tmp);
-                }
-            }
+        // Resolved once per path; imports run against the importer's directory
+        const char* importerPath = NULL;
+        if (vm->callStackTop > 0) {
+            CallFrame* frame = &vm->callStack[vm->callStackTop - 1];
+            if (frame->function) importerPath = frame->function->modulePath;
         }
+        ImportEntry* entry = resolveImport(vm, importerPath, rawPath);
+        const char* importPath = entry->path;
 
-        char* source = readFile_internal(importPath);
-        if (!source) {
-            fprintf(stderr, "Runtime Error: Could not import module '%s'\n", rawPath);
-            exit(1);
-        }
-
-        Lexer lex;
-        initLexer(&lex, source);
-        Parser p;
-        p.tokens = malloc(64 * sizeof(Token));
-        p.count = 0; p.capacity = 64; p.current = 0;
-        while (true) {
-            Token t = scanToken(&lex);
-            if (p.count >= p.capacity) { p.capacity *= 2; p.tokens = realloc(p.tokens, p.capacity * sizeof(Token)); }
-            p.tokens[p.count++] = t;
-            if (t.type == TOKEN_EOF) break;
+        if (isExtensionPath(importPath)) {
+            Module* ext = loadExtension(vm, importPath);
+            regs[a] = OBJ_VAL(ext);
+            NEXT();
         }
-        Node* ast = parse(&p);
 
         Environment* oldEnv = vm->globalEnv;
-        Environment* modEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-        modEnv->enclosing = oldEnv;
-        memset(modEnv->buckets, 0, sizeof(modEnv->buckets));
-        memset(modEnv->funcBuckets, 0, sizeof(modEnv->funcBuckets));
+        Environment* modEnv = newEnvironment(vm, oldEnv);
         vm->globalEnv = modEnv;
 
         BytecodeChunk* modChunk = malloc(sizeof(BytecodeChunk));
         initChunk(modChunk);
-        compileToBytecode(vm, ast, modChunk, importPath);
-
-        Function* modFunc = malloc(sizeof(Function));
-        modFunc->obj.type = OBJ_FUNCTION;
-        modFunc->obj.isMarked = false;
-        modFunc->obj.isPermanent = false;
-        modFunc->obj.generation = 0;
-        modFunc->obj.next = vm->objects;
-        vm->objects = (Obj*)modFunc;
-        modFunc->name = (Token){0};
-        modFunc->params = NULL;
-        modFunc->paramCount = 0;
-        modFunc->isNative = false;
-        modFunc->isAsync = false;
-        modFunc->bytecodeChunk = modChunk;
-        modFunc->modulePath = importPath ? strdup(importPath) : NULL;
-        modFunc->moduleEnv = modEnv;
-        modFunc->closure = NULL;
-        modFunc->native = NULL;
-        modFunc->body = NULL;
+
+        // Function exists before compiling so it roots the chunk's constants
+        Function* modFunc = newModuleFunction(vm, modChunk, importPath, modEnv);
+
+        // A compiled image (or .unnac cache) replaces lexing, parsing and compiling
+        FileBuffer source = {0};
+        vm->stack[vm->stackTop++] = OBJ_VAL(modFunc);
+        if (!loadModule(vm, entry, modChunk, &source)) {
+            fprintf(stderr, "Runtime Error: Could not import module '%s'\n", rawPath);
+            exit(1);
+        }
+        vm->stackTop--;
 
         // Execute module
-        if (vm->callStackTop >= CALL_STACK_MAX) {
+        if (vm->callStackTop >= CALL_STACK_MAX ||
+            vm->regBase + (int)chunk->maxRegs + 1 + FRAME_REG_MAX > vm->regCapacity) {
             printf("Runtime Error: Stack overflow during import\n");
             exit(1);
         }
@@ -1020,6 +1365,7 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         regs = vm->registers + vm->regBase;
 
         int modEntryDepth = vm->callStackTop - 1;
+        PROFILE_ENTER(vm, frame, modFunc);
         executeBytecode(vm, modChunk, modEntryDepth);
 
         // Restore
@@ -1029,25 +1375,25 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         chunk = frame->chunk;
         constants = chunk->constants;
         ip = frame->ip;
+        PROFILE_SYNC();
         // vm->callStackTop-- is already done by return instruction inside executeBytecode
 
-        // Create module object
+        // Create module object (modEnv is unrooted once its frame returned)
+        vm->stack[vm->stackTop++] = OBJ_VAL(modEnv);
         Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
+        vm->stackTop--;
         mod->env = modEnv;
         mod->name = strdup(importPath);
         mod->source = NULL;
         regs[a] = OBJ_VAL(mod);
 
-        free(source);
-        if (resolvedPath) free(resolvedPath);
-        if (p.tokens) free(p.tokens);
+        fileClose(&source);
 
         DISPATCH();
     }
 
     // ===== ASYNC =====
     op_async: {
-        // Simplified: execute synchronously, wrap in Future
         uint32_t inst = FETCH();
         uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
         // b = function reg, c = arg count
@@ -1056,24 +1402,14 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             printf("Runtime Error: Async call on non-function\n"); exit(1);
         }
         Function* func = (Function*)AS_OBJ(funcVal);
+        if (!func->isNative && c != func->paramCount) {
+            printf("Runtime Error: Expected %d args but got %d.\n", func->paramCount, c);
+            exit(1);
+        }
 
+        // Schedule as a task; runs until it first suspends
         vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
-        Future* future = ALLOCATE_OBJ(vm, Future, OBJ_FUTURE);
-        future->done = false;
-        future->result = NIL_VAL;
-        pthread_mutex_init(&future->mu, NULL);
-        pthread_cond_init(&future->cv, NULL);
-
-        // Execute synchronously
-        Value result = callFunction(vm, func, &regs[b + 1], c);
-
-        pthread_mutex_lock(&future->mu);
-        future->result = result;
-        future->done = true;
-        pthread_cond_broadcast(&future->cv);
-        pthread_mutex_unlock(&future->mu);
-
-        regs[a] = OBJ_VAL(future);
+        regs[a] = spawnTask(vm, func, &regs[b + 1], c);
         NEXT();
     }
 
@@ -1086,10 +1422,12 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
             NEXT();
         }
         Future* f = (Future*)AS_OBJ(v);
-        pthread_mutex_lock(&f->mu);
-        while (!f->done) pthread_cond_wait(&f->cv, &f->mu);
+        if (!f->done) {
+            // Suspend this coroutine (or run other tasks) until resolved
+            vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1);
+            awaitFuture(vm, f);
+        }
         regs[a] = f->result;
-        pthread_mutex_unlock(&f->mu);
         NEXT();
     }
 
@@ -1109,6 +1447,37 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
         NEXT();
     }
 
+    // ===== BASELINE JIT =====
+    // A hot chunk is compiled once and from then on entered at ip. Native
+    // code returns the instruction it stopped at; that one runs here, and
+    // the dispatch after it (through resumeTable) re-enters native code.
+    jit_tier: {
+#ifdef UNNARIZE_PROFILE
+        bool allowed = profHits == NULL; // A profile counts interpreted instructions
+#else
+        bool allowed = true;
+#endif
+        if (!allowed || (!chunk->jit && !jitCompile(vm, chunk))) {
+            chunk->hotness = INT_MAX;
+            DISPATCH();
+        }
+        chunk->hotness = 0;
+        goto jit_run;
+    }
+
+    jit_resume: {
+        table = dispatchTable;
+        if (!chunk->jit) DISPATCH();
+        goto jit_run;
+    }
+
+    jit_run: {
+        int pc = jitRun(chunk->jit, vm, regs, (int)(ip - chunk->code));
+        ip = chunk->code + pc;
+        table = resumeTable;
+        goto *dispatchTable[DECODE_OP(*ip)];
+    }
+
 #else
     #error "Computed goto not supported. Use GCC or Clang."
 #endif
@@ -1116,3 +1485,76 @@ uint64_t executeBytecode(VM* vm, BytecodeChunk* chunk, int entryStackDepth) {
 done:
     return getMicroseconds() - startTime;
 }
+
+bool prepareCall(Function* func, int argCount, PreparedCall* call) {
+    call->function = func;
+    call->chunk = func->isNative ? NULL : func->bytecodeChunk;
+    call->argCount = argCount;
+    call->windowSize = call->chunk ? (int)call->chunk->maxRegs + 1 : 0;
+    // Natives check their own arguments
+    return func->isNative || argCount == func->paramCount;
+}
+
+// Re-enter the interpreter from native code (HTTP handlers, async, callbacks).
+// The callee window is placed above the caller's live registers (vm->regTop),
+// mirroring OP_CALL: R(0)=function, R(1..N)=args, result comes back in R(0).
+Value callPrepared(VM* vm, const PreparedCall* call, Value* args) {
+    Function* func = call->function;
+    int argCount = call->argCount;
+    if (!call->chunk) {
+        if (func->isNative) return func->native(vm, args, argCount);
+        return callFunction(vm, func, args, argCount);
+    }
+    if (vm->callStackTop >= CALL_STACK_MAX) {
+        printf("Runtime Error: Stack overflow.\n");
+        exit(1);
+    }
+
+    int base = vm->regTop > vm->regBase ? vm->regTop : vm->regBase + 1;
+    if (base + call->windowSize + argCount >= vm->regCapacity) {
+        printf("Runtime Error: Register file overflow.\n");
+        exit(1);
+    }
+
+    // Args may alias the register file, so copy before anything moves
+    vm->registers[base] = OBJ_VAL(func);
+    for (int i = 0; i < argCount; i++) {
+        vm->registers[base + 1 + i] = args[i];
+    }
+
+    // Native boundary frame: no chunk to resume, saves the caller's window
+    CallFrame* frame = &vm->callStack[vm->callStackTop++];
+    frame->ip = NULL;
+    frame->chunk = NULL;
+    frame->function = func;
+    frame->env = NULL;
+    frame->regBase = vm->regBase;
+    frame->regTop = vm->regTop;
+    frame->resultReg = 0;
+    frame->prevGlobalEnv = vm->globalEnv;
+
+    if (func->moduleEnv) {
+        vm->globalEnv = func->moduleEnv;
+    }
+    vm->regBase = base;
+    vm->regTop = base + call->windowSize;
+
+    PROFILE_ENTER(vm, frame, func);
+    executeBytecode(vm, call->chunk, vm->callStackTop - 1);
+
+    Value result = vm->registers[base];
+    vm->globalEnv = frame->prevGlobalEnv;
+    vm->regBase = frame->regBase;
+    vm->regTop = frame->regTop;
+    return result;
+}
+
+// One-shot form of prepareCall + callPrepared
+Value callBytecodeFunction(VM* vm, Function* func, Value* args, int argCount) {
+    PreparedCall call;
+    if (!prepareCall(func, argCount, &call)) {
+        printf("Runtime Error: Expected %d args but got %d.\n", func->paramCount, argCount);
+        exit(1);
+    }
+    return callPrepared(vm, &call, args);
+}
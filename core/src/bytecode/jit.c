@@ -0,0 +1,1127 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#include "bytecode/jit.h"
+#include "bytecode/opcodes.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Baseline JIT: bytecode -> x86-64 templates
+ *
+ * Native code keeps no state of its own between instructions. Every value
+ * lives in the register file, so the interpreter can leave or enter at any
+ * instruction. While native code runs these machine registers are fixed:
+ *
+ *   rbx  regs (vm->registers + vm->regBase)
+ *   r12  vm
+ *   r13  QNAN | SIGN_BIT       (object tag)
+ *   r14  QNAN | TAG_INT_BIT    (int tag)
+ *   r15  QNAN                  (not a float)
+ *
+ * Templates only use the scratch registers rax, rcx, rdx, rsi, rdi, r8,
+ * and r11 (type tests), plus xmm0 and xmm1.
+ */
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct JitCode {
+    uint8_t* code;          // Read-only and executable once written
+    size_t mapped;          // Bytes mapped at 'code'
+    uint32_t* entries;      // Offset of each instruction's native code
+};
+
+// Set in an entry whose instruction always goes back to the interpreter:
+// jitRun hands it straight back instead of entering native code
+#define INTERPRETED 0x80000000u
+
+// Entry stub: saves the fixed registers and jumps to 'target'
+typedef int (*JitEntry)(Value* regs, VM* vm, const uint8_t* target);
+
+_Static_assert(sizeof(ObjType) == 4 && sizeof(TypedKind) == 4, "type fields are compared as dwords");
+
+// ---- Assembler ----
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum { XMM0, XMM1 };
+
+#define REGS     RBX
+#define VMREG    R12
+#define OBJ_TAG  R13
+#define INT_TAG  R14
+#define QNAN_REG R15
+#define NO_INDEX (-1)
+
+// Condition codes (the low bit negates one)
+enum {
+    CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_P = 0xA, CC_NP = 0xB, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+    CC_ALWAYS = -1
+};
+
+// ALU opcodes (op r/m, r) and their /digit in the immediate forms
+enum { ALU_ADD = 0x01, ALU_OR = 0x09, ALU_AND = 0x21, ALU_SUB = 0x29, ALU_XOR = 0x31, ALU_CMP = 0x39 };
+enum { EXT_ADD = 0, EXT_OR = 1, EXT_AND = 4, EXT_SUB = 5, EXT_XOR = 6, EXT_CMP = 7 };
+
+typedef struct {
+    size_t at;              // Offset of a rel32 field
+    int pc;                 // Instruction it jumps to (or leaves native code at)
+} Fixup;
+
+typedef struct {
+    BytecodeChunk* chunk;
+    uint8_t* code;
+    size_t size;
+    size_t capacity;
+    uint32_t* entries;      // Native offset of each instruction
+    Fixup* jumps;           // Jumps to an instruction's code
+    int jumpCount;
+    int jumpCapacity;
+    Fixup* exits;           // Jumps back to the interpreter at 'pc'
+    int exitCount;
+    int exitCapacity;
+    size_t epilogue;
+    bool failed;            // The chunk cannot be compiled
+} Assembler;
+
+static void* growOrDie(void* p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for native code.\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void emit(Assembler* as, uint8_t b) {
+    if (as->size == as->capacity) {
+        as->capacity = as->capacity ? as->capacity * 2 : 4096;
+        as->code = growOrDie(as->code, as->capacity);
+    }
+    as->code[as->size++] = b;
+}
+
+static void emit32(Assembler* as, uint32_t v) {
+    for (int i = 0; i < 4; i++) emit(as, (uint8_t)(v >> (8 * i)));
+}
+
+static void emit64(Assembler* as, uint64_t v) {
+    emit32(as, (uint32_t)v);
+    emit32(as, (uint32_t)(v >> 32));
+}
+
+static void patch32(Assembler* as, size_t at, int32_t v) {
+    for (int i = 0; i < 4; i++) as->code[at + i] = (uint8_t)((uint32_t)v >> (8 * i));
+}
+
+static void rex(Assembler* as, bool w, int reg, int index, int base) {
+    uint8_t r = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+    if (r != 0x40) emit(as, r);
+}
+
+static void opcode(Assembler* as, int op) {
+    if (op > 0xFF) emit(as, (uint8_t)(op >> 8)); // 0F-prefixed
+    emit(as, (uint8_t)op);
+}
+
+// op reg, [base + index * scale + disp]
+static void memOp(Assembler* as, bool w, int op, int reg, int base, int index, int scale, int32_t disp) {
+    rex(as, w, reg, index == NO_INDEX ? 0 : index, base);
+    opcode(as, op);
+    int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp >= -128 && disp <= 127) ? 1 : 2;
+    if (index == NO_INDEX && (base & 7) != RSP) {
+        emit(as, (uint8_t)(mod << 6 | (reg & 7) << 3 | (base & 7)));
+    } else {
+        int ss = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+        emit(as, (uint8_t)(mod << 6 | (reg & 7) << 3 | 4));
+        emit(as, (uint8_t)(ss << 6 | ((index == NO_INDEX ? RSP : index) & 7) << 3 | (base & 7)));
+    }
+    if (mod == 1) emit(as, (uint8_t)disp);
+    else if (mod == 2) emit32(as, (uint32_t)disp);
+}
+
+// op reg, rm (both registers)
+static void regOp(Assembler* as, bool w, int op, int reg, int rm) {
+    rex(as, w, reg, 0, rm);
+    opcode(as, op);
+    emit(as, (uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+// SSE: the mandatory prefix goes before REX
+static void sseOp(Assembler* as, uint8_t prefix, bool w, int op, int reg, int rm) {
+    emit(as, prefix);
+    regOp(as, w, 0x0F00 | op, reg, rm);
+}
+
+static void movLoad(Assembler* as, int dst, int base, int32_t disp) {
+    memOp(as, true, 0x8B, dst, base, NO_INDEX, 1, disp);
+}
+
+static void movLoad32(Assembler* as, int dst, int base, int32_t disp) {
+    memOp(as, false, 0x8B, dst, base, NO_INDEX, 1, disp); // Zero-extends
+}
+
+static void movStore(Assembler* as, int base, int32_t disp, int src) {
+    memOp(as, true, 0x89, src, base, NO_INDEX, 1, disp);
+}
+
+static void movRR(Assembler* as, int dst, int src) {
+    regOp(as, true, 0x89, src, dst);
+}
+
+static void movRR32(Assembler* as, int dst, int src) {
+    regOp(as, false, 0x89, src, dst); // Zero-extends
+}
+
+static void movImm(Assembler* as, int dst, uint64_t imm) {
+    if (imm <= 0xFFFFFFFFu) {
+        rex(as, false, 0, 0, dst);
+        emit(as, (uint8_t)(0xB8 + (dst & 7)));
+        emit32(as, (uint32_t)imm);
+    } else {
+        rex(as, true, 0, 0, dst);
+        emit(as, (uint8_t)(0xB8 + (dst & 7)));
+        emit64(as, imm);
+    }
+}
+
+static void alu(Assembler* as, int op, int dst, int src) {
+    regOp(as, true, op, src, dst);
+}
+
+static void alu32(Assembler* as, int op, int dst, int src) {
+    regOp(as, false, op, src, dst);
+}
+
+static void aluImm(Assembler* as, bool w, int ext, int dst, int32_t imm) {
+    if (imm >= -128 && imm <= 127) {
+        regOp(as, w, 0x83, ext, dst);
+        emit(as, (uint8_t)imm);
+    } else {
+        regOp(as, w, 0x81, ext, dst);
+        emit32(as, (uint32_t)imm);
+    }
+}
+
+static void cmpMemImm32(Assembler* as, int base, int32_t disp, int32_t imm) {
+    memOp(as, false, 0x81, EXT_CMP, base, NO_INDEX, 1, disp);
+    emit32(as, (uint32_t)imm);
+}
+
+static void test32(Assembler* as, int a, int b) {
+    regOp(as, false, 0x85, b, a);
+}
+
+static void setcc(Assembler* as, int cc, int dst) {
+    regOp(as, false, 0x0F90 | cc, 0, dst); // dst is one of al, cl, dl, bl
+}
+
+static void callHelper(Assembler* as, uintptr_t fn) {
+    movImm(as, RAX, fn);
+    regOp(as, false, 0xFF, 2, RAX); // call rax
+}
+
+// Jump within the current template; bindHere points it at what follows
+static size_t jumpForward(Assembler* as, int cc) {
+    if (cc == CC_ALWAYS) {
+        emit(as, 0xE9);
+    } else {
+        emit(as, 0x0F);
+        emit(as, (uint8_t)(0x80 | cc));
+    }
+    size_t at = as->size;
+    emit32(as, 0);
+    return at;
+}
+
+static void bindHere(Assembler* as, size_t at) {
+    patch32(as, at, (int32_t)(as->size - (at + 4)));
+}
+
+static void addFixup(Fixup** list, int* count, int* capacity, size_t at, int pc) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *list = growOrDie(*list, sizeof(Fixup) * (size_t)*capacity);
+    }
+    (*list)[*count].at = at;
+    (*list)[*count].pc = pc;
+    (*count)++;
+}
+
+// Jump to instruction 'pc' of this chunk
+static void jumpTo(Assembler* as, int cc, int pc) {
+    size_t at = jumpForward(as, cc);
+    addFixup(&as->jumps, &as->jumpCount, &as->jumpCapacity, at, pc);
+}
+
+// Leave native code: the interpreter runs instruction 'pc'
+static void exitAt(Assembler* as, int cc, int pc) {
+    size_t at = jumpForward(as, cc);
+    addFixup(&as->exits, &as->exitCount, &as->exitCapacity, at, pc);
+}
+
+// ---- Values ----
+
+#define REG_DISP(r) ((int32_t)(r) * (int32_t)sizeof(Value))
+
+static void loadValue(Assembler* as, int dst, int r) {
+    movLoad(as, dst, REGS, REG_DISP(r));
+}
+
+static void storeValue(Assembler* as, int r, int src) {
+    movStore(as, REGS, REG_DISP(r), src);
+}
+
+// Type tests set the flags for je/jne and clobber r11.
+// Equal when 'x' is an int (IS_INT: bools pass too, as in the interpreter).
+static void testInt(Assembler* as, int x) {
+    movRR(as, R11, x);
+    alu(as, ALU_AND, R11, INT_TAG);
+    alu(as, ALU_CMP, R11, INT_TAG);
+}
+
+// Equal when both are ints (IS_INT(x & y))
+static void testInts(Assembler* as, int x, int y) {
+    movRR(as, R11, x);
+    alu(as, ALU_AND, R11, y);
+    alu(as, ALU_AND, R11, INT_TAG);
+    alu(as, ALU_CMP, R11, INT_TAG);
+}
+
+// Equal when 'x' is NOT a float
+static void testNotFloat(Assembler* as, int x) {
+    movRR(as, R11, x);
+    alu(as, ALU_AND, R11, QNAN_REG);
+    alu(as, ALU_CMP, R11, QNAN_REG);
+}
+
+// Equal when 'x' is an object
+static void testObj(Assembler* as, int x) {
+    movRR(as, R11, x);
+    alu(as, ALU_AND, R11, OBJ_TAG);
+    alu(as, ALU_CMP, R11, OBJ_TAG);
+}
+
+// dst = AS_OBJ(src), for a value already known to be an object
+static void unboxObj(Assembler* as, int dst, int src) {
+    movRR(as, dst, src);
+    alu(as, ALU_XOR, dst, OBJ_TAG);
+}
+
+static void boxInt(Assembler* as, int r) {
+    alu(as, ALU_OR, r, INT_TAG); // The upper half of r must be zero
+}
+
+// R(A) = the value in rax, or the bool in cl
+static void storeBool(Assembler* as, int a) {
+    regOp(as, false, 0x0FB6, RCX, RCX); // movzx ecx, cl
+    movImm(as, RAX, TAGGED_FALSE);
+    alu(as, ALU_OR, RAX, RCX);
+    storeValue(as, a, RAX);
+}
+
+static void jitBarrier(VM* vm, Obj* object) {
+    WRITE_BARRIER(vm, object);
+}
+
+// WRITE_BARRIER for the value in rax just stored into the object in rsi.
+// Only a reference needs one.
+static void emitBarrier(Assembler* as) {
+    testObj(as, RAX);
+    size_t skip = jumpForward(as, CC_NE);
+    movRR(as, RDI, VMREG);
+    callHelper(as, (uintptr_t)jitBarrier);
+    bindHere(as, skip);
+}
+
+// ---- Templates ----
+
+// Fused and quickened opcodes compile like the generic one: the templates
+// check the types themselves
+static int baseOpcode(int op) {
+    switch (op) {
+        case OP_ADD_II: case OP_ADD_FF: return OP_ADD;
+        case OP_SUB_II: case OP_SUB_FF: return OP_SUB;
+        case OP_MUL_II: case OP_MUL_FF: return OP_MUL;
+        case OP_DIV_FF: return OP_DIV;
+        case OP_LT_II: case OP_LT_FF: return OP_LT;
+        case OP_LE_II: case OP_LE_FF: return OP_LE;
+        case OP_GT_II: case OP_GT_FF: return OP_GT;
+        case OP_GE_II: case OP_GE_FF: return OP_GE;
+        case OP_LTJMP_II: case OP_LTJMP_FF: return OP_LTJMP;
+        case OP_LEJMP_II: case OP_LEJMP_FF: return OP_LEJMP;
+        case OP_GETIDX_ARR_I: case OP_GETIDX_TA_I: return OP_GETIDX;
+        case OP_SETIDX_ARR_I: case OP_SETIDX_TA_I: return OP_SETIDX;
+        default: return op;
+    }
+}
+
+// xmm = the number in 'r' as a double (ints are converted); leaves
+// native code at 'pc' for anything else
+static void loadNumber(Assembler* as, int pc, int xmm, int r) {
+    testInt(as, r);
+    size_t notInt = jumpForward(as, CC_NE);
+    sseOp(as, 0xF2, false, 0x2A, xmm, r);               // cvtsi2sd xmm, r32
+    size_t done = jumpForward(as, CC_ALWAYS);
+    bindHere(as, notInt);
+    testNotFloat(as, r);
+    exitAt(as, CC_E, pc);
+    sseOp(as, 0x66, true, 0x6E, xmm, r);                // movq xmm, r
+    bindHere(as, done);
+}
+
+// R(A) = R(B) op R(C): int with int wraps at 32 bits, and any other pair
+// of numbers is computed in floats. Strings, int modulo of anything but
+// ints, and int division by zero go to the interpreter.
+static void emitArith(Assembler* as, int pc, uint32_t inst, int op) {
+    int a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
+    loadValue(as, RAX, b);
+    loadValue(as, RDX, c);
+    testInts(as, RAX, RDX);
+    size_t notInts = jumpForward(as, CC_NE);
+    switch (op) {
+        case OP_ADD: alu32(as, ALU_ADD, RAX, RDX); break;
+        case OP_SUB: alu32(as, ALU_SUB, RAX, RDX); break;
+        case OP_MUL: regOp(as, false, 0x0FAF, RAX, RDX); break; // imul eax, edx
+        default:
+            // 64-bit division, as the interpreter does: INT_MIN / -1 cannot trap
+            test32(as, RDX, RDX);
+            exitAt(as, CC_E, pc);
+            regOp(as, true, 0x63, RAX, RAX);    // movsxd rax, eax
+            regOp(as, true, 0x63, RCX, RDX);    // movsxd rcx, edx
+            emit(as, 0x48);
+            emit(as, 0x99);                     // cqo
+            regOp(as, true, 0xF7, 7, RCX);      // idiv rcx
+            movRR32(as, RAX, op == OP_MOD ? RDX : RAX);
+            break;
+    }
+    boxInt(as, RAX);
+    storeValue(as, a, RAX);
+    size_t done = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notInts);
+    if (op == OP_MOD) {
+        exitAt(as, CC_ALWAYS, pc);
+    } else {
+        loadNumber(as, pc, XMM0, RAX);
+        loadNumber(as, pc, XMM1, RDX);
+        int sd = op == OP_ADD ? 0x58 : op == OP_SUB ? 0x5C : op == OP_MUL ? 0x59 : 0x5E;
+        sseOp(as, 0xF2, false, sd, XMM0, XMM1);
+        sseOp(as, 0x66, true, 0x7E, XMM0, RAX);     // movq rax, xmm0
+        storeValue(as, a, RAX);
+    }
+    bindHere(as, done);
+}
+
+// R(A) = R(A) +/- sBx for an int
+static void emitArithImm(Assembler* as, int pc, uint32_t inst, int ext) {
+    int a = DECODE_A(inst);
+    loadValue(as, RAX, a);
+    testInt(as, RAX);
+    exitAt(as, CC_NE, pc);
+    aluImm(as, false, ext, RAX, DECODE_sBx(inst));
+    boxInt(as, RAX);
+    storeValue(as, a, RAX);
+}
+
+static void emitNeg(Assembler* as, int pc, uint32_t inst) {
+    int a = DECODE_A(inst), b = DECODE_B(inst);
+    loadValue(as, RAX, b);
+    testInt(as, RAX);
+    size_t notInt = jumpForward(as, CC_NE);
+    regOp(as, false, 0xF7, 3, RAX); // neg eax
+    boxInt(as, RAX);
+    storeValue(as, a, RAX);
+    size_t done = jumpForward(as, CC_ALWAYS);
+    bindHere(as, notInt);
+    testNotFloat(as, RAX);
+    exitAt(as, CC_E, pc);
+    movImm(as, RCX, SIGN_BIT);
+    alu(as, ALU_XOR, RAX, RCX);
+    storeValue(as, a, RAX);
+    bindHere(as, done);
+}
+
+// What a comparison does with its result: store it as a bool in R(dest), or
+// (dest < 0) jump to 'target' when it equals 'when' and to 'skip' otherwise
+typedef struct {
+    int dest;
+    int target;
+    int skip;
+    bool when;
+} Outcome;
+
+static void emitOutcome(Assembler* as, int cc, const Outcome* out) {
+    if (out->dest >= 0) {
+        setcc(as, cc, RCX);
+        storeBool(as, out->dest);
+    } else {
+        jumpTo(as, out->when ? cc : cc ^ 1, out->target);
+        jumpTo(as, CC_ALWAYS, out->skip);
+    }
+}
+
+// How OP_LT and friends read the flags. Floats compare through ucomisd with
+// the operands ordered so that NaN (unordered) reads as false.
+typedef struct {
+    int intCC;
+    int floatCC;
+    bool swap;              // ucomisd C, B instead of B, C
+} Ordering;
+
+static const Ordering LESS = {CC_L, CC_A, true};
+static const Ordering LESS_EQUAL = {CC_LE, CC_AE, true};
+static const Ordering GREATER = {CC_G, CC_A, false};
+static const Ordering GREATER_EQUAL = {CC_GE, CC_AE, false};
+
+// Order R(b) against R(c), or against the constant *k when k is not NULL.
+// Int with int and float with float; anything else goes to the interpreter.
+static void emitOrdering(Assembler* as, int pc, Ordering ord, int b, int c, const Value* k,
+                         const Outcome* out) {
+    bool kInt = k && IS_INT(*k);
+    bool kFloat = k && IS_FLOAT(*k);
+    if (k && !kInt && !kFloat) {
+        exitAt(as, CC_ALWAYS, pc);
+        return;
+    }
+    loadValue(as, RAX, b);
+    size_t notInts = 0, done = 0;
+    if (!k) {
+        loadValue(as, RDX, c);
+        testInts(as, RAX, RDX);
+        notInts = jumpForward(as, CC_NE);
+        alu32(as, ALU_CMP, RAX, RDX);
+    } else if (kInt) {
+        testInt(as, RAX);
+        exitAt(as, CC_NE, pc);
+        aluImm(as, false, EXT_CMP, RAX, AS_INT(*k));
+    }
+    if (!kFloat) {
+        emitOutcome(as, ord.intCC, out);
+        if (kInt) return;
+        if (out->dest >= 0) done = jumpForward(as, CC_ALWAYS);
+        bindHere(as, notInts);
+        testNotFloat(as, RDX);
+        exitAt(as, CC_E, pc);
+    } else {
+        movImm(as, RDX, *k);
+    }
+    testNotFloat(as, RAX);
+    exitAt(as, CC_E, pc);
+    sseOp(as, 0x66, true, 0x6E, XMM0, RAX);
+    sseOp(as, 0x66, true, 0x6E, XMM1, RDX);
+    if (ord.swap) sseOp(as, 0x66, false, 0x2E, XMM1, XMM0);    // ucomisd xmm1, xmm0
+    else sseOp(as, 0x66, false, 0x2E, XMM0, XMM1);
+    emitOutcome(as, ord.floatCC, out);
+    if (done) bindHere(as, done);
+}
+
+// cl = valuesEqual(rax, rdx). Two different objects may still hold the
+// same text (builders, slices): the interpreter decides those.
+static void emitEquals(Assembler* as, int pc) {
+    testInts(as, RAX, RDX);
+    size_t notInts = jumpForward(as, CC_NE);
+    alu32(as, ALU_CMP, RAX, RDX);
+    setcc(as, CC_E, RCX);
+    size_t intDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notInts);
+    testNotFloat(as, RAX);
+    size_t notFloat = jumpForward(as, CC_E);
+    testNotFloat(as, RDX);
+    size_t notFloats = jumpForward(as, CC_E);
+    sseOp(as, 0x66, true, 0x6E, XMM0, RAX);
+    sseOp(as, 0x66, true, 0x6E, XMM1, RDX);
+    sseOp(as, 0x66, false, 0x2E, XMM0, XMM1);
+    setcc(as, CC_E, RCX);
+    setcc(as, CC_NP, RDX);
+    regOp(as, false, 0x20, RDX, RCX);                   // and cl, dl
+    size_t floatDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notFloat);
+    bindHere(as, notFloats);
+    alu(as, ALU_CMP, RAX, RDX);
+    setcc(as, CC_E, RCX);
+    size_t same = jumpForward(as, CC_E);
+    testObj(as, RAX);
+    size_t notObj = jumpForward(as, CC_NE);
+    testObj(as, RDX);
+    exitAt(as, CC_E, pc);
+    bindHere(as, notObj);
+
+    bindHere(as, intDone);
+    bindHere(as, floatDone);
+    bindHere(as, same);
+    regOp(as, false, 0x84, RCX, RCX);                   // test cl, cl
+}
+
+// ecx = isTruthy(rax). Floats go to the interpreter.
+static void emitTruthy(Assembler* as, int pc) {
+    movRR(as, R11, RAX);
+    aluImm(as, true, EXT_AND, R11, -2);
+    movImm(as, RDX, TAGGED_FALSE);
+    alu(as, ALU_CMP, R11, RDX);
+    size_t notBool = jumpForward(as, CC_NE);
+    movRR32(as, RCX, RAX);
+    aluImm(as, false, EXT_AND, RCX, 1);
+    size_t boolDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notBool);
+    movImm(as, RDX, NIL_VAL);
+    alu(as, ALU_CMP, RAX, RDX);
+    size_t notNil = jumpForward(as, CC_NE);
+    alu32(as, ALU_XOR, RCX, RCX);
+    size_t nilDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notNil);
+    testInt(as, RAX);
+    size_t notInt = jumpForward(as, CC_NE);
+    alu32(as, ALU_XOR, RCX, RCX);
+    test32(as, RAX, RAX);
+    setcc(as, CC_NE, RCX);
+    size_t intDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notInt);
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    movImm(as, RCX, 1);
+
+    bindHere(as, boolDone);
+    bindHere(as, nilDone);
+    bindHere(as, intDone);
+    test32(as, RCX, RCX);
+}
+
+// rsi = the object in 'value'; leaves native code unless it has type 'type'
+static void expectObjType(Assembler* as, int pc, int value, ObjType type) {
+    testObj(as, value);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, value);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), type);
+    exitAt(as, CC_NE, pc);
+}
+
+// rax = the array or typed array element at the unsigned index in edx,
+// nil out of range. The object is in rsi with its type in the flags.
+static void emitElementLoad(Assembler* as, int pc) {
+    size_t notArray = jumpForward(as, CC_NE);
+    movLoad32(as, RCX, RSI, offsetof(Array, count));
+    alu32(as, ALU_CMP, RDX, RCX);
+    size_t outside = jumpForward(as, CC_AE);
+    movLoad(as, RCX, RSI, offsetof(Array, items));
+    memOp(as, true, 0x8B, RAX, RCX, RDX, 8, 0);
+    size_t arrayDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notArray);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_TYPED_ARRAY);
+    exitAt(as, CC_NE, pc);
+    movLoad32(as, RCX, RSI, offsetof(TypedArray, count));
+    alu32(as, ALU_CMP, RDX, RCX);
+    size_t outsideTyped = jumpForward(as, CC_AE);
+    movLoad(as, RCX, RSI, offsetof(TypedArray, data));
+    cmpMemImm32(as, RSI, offsetof(TypedArray, kind), TYPED_INT32);
+    size_t notInt32 = jumpForward(as, CC_NE);
+    memOp(as, false, 0x8B, RAX, RCX, RDX, 4, 0);
+    boxInt(as, RAX);
+    size_t int32Done = jumpForward(as, CC_ALWAYS);
+    bindHere(as, notInt32);
+    memOp(as, true, 0x8B, RAX, RCX, RDX, 8, 0);         // A double is its own Value
+    size_t float64Done = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, outside);
+    bindHere(as, outsideTyped);
+    movImm(as, RAX, NIL_VAL);
+    bindHere(as, arrayDone);
+    bindHere(as, int32Done);
+    bindHere(as, float64Done);
+}
+
+// R(A) = R(B)[R(C)] for arrays and typed arrays with an int index
+static void emitGetIndex(Assembler* as, int pc, uint32_t inst) {
+    loadValue(as, RAX, DECODE_B(inst));
+    loadValue(as, RDX, DECODE_C(inst));
+    testInt(as, RDX);
+    exitAt(as, CC_NE, pc);
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, RAX);
+    movRR32(as, RDX, RDX);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_ARRAY);
+    emitElementLoad(as, pc);
+    storeValue(as, DECODE_A(inst), RAX);
+}
+
+// R(A) = R(B)[C]
+static void emitGetIndexImm(Assembler* as, int pc, uint32_t inst) {
+    loadValue(as, RAX, DECODE_B(inst));
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, RAX);
+    movImm(as, RDX, DECODE_C(inst));
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_ARRAY);
+    emitElementLoad(as, pc);
+    storeValue(as, DECODE_A(inst), RAX);
+}
+
+// R(A)[R(B)] = R(C) inside an array's items (not shared) or a typed array
+// whose element type holds the value. Growing an array, maps, and errors
+// go to the interpreter.
+static void emitSetIndex(Assembler* as, int pc, uint32_t inst) {
+    loadValue(as, RAX, DECODE_A(inst));
+    loadValue(as, RDX, DECODE_B(inst));
+    testInt(as, RDX);
+    exitAt(as, CC_NE, pc);
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, RAX);
+    movRR32(as, RDX, RDX);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_ARRAY);
+    size_t notArray = jumpForward(as, CC_NE);
+    movLoad32(as, RCX, RSI, offsetof(Array, count));
+    alu32(as, ALU_CMP, RDX, RCX);
+    exitAt(as, CC_AE, pc);
+    movLoad(as, RCX, RSI, offsetof(Array, share));
+    alu(as, ALU_AND, RCX, RCX);
+    exitAt(as, CC_NE, pc);
+    movLoad(as, RCX, RSI, offsetof(Array, items));
+    loadValue(as, RAX, DECODE_C(inst));
+    memOp(as, true, 0x89, RAX, RCX, RDX, 8, 0);
+    emitBarrier(as);
+    size_t arrayDone = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notArray);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_TYPED_ARRAY);
+    exitAt(as, CC_NE, pc);
+    movLoad32(as, RCX, RSI, offsetof(TypedArray, count));
+    alu32(as, ALU_CMP, RDX, RCX);
+    exitAt(as, CC_AE, pc);
+    movLoad(as, RCX, RSI, offsetof(TypedArray, data));
+    loadValue(as, RAX, DECODE_C(inst));
+    testInt(as, RAX);
+    size_t notInt = jumpForward(as, CC_NE);
+    cmpMemImm32(as, RSI, offsetof(TypedArray, kind), TYPED_INT32);
+    size_t intToFloat = jumpForward(as, CC_NE);
+    memOp(as, false, 0x89, RAX, RCX, RDX, 4, 0);
+    size_t int32Done = jumpForward(as, CC_ALWAYS);
+    bindHere(as, intToFloat);
+    sseOp(as, 0xF2, false, 0x2A, XMM0, RAX);            // cvtsi2sd xmm0, eax
+    sseOp(as, 0x66, true, 0x7E, XMM0, RAX);
+    memOp(as, true, 0x89, RAX, RCX, RDX, 8, 0);
+    size_t converted = jumpForward(as, CC_ALWAYS);
+    bindHere(as, notInt);
+    // A float fits a Float64Array as it is; an Int32Array truncates it
+    cmpMemImm32(as, RSI, offsetof(TypedArray, kind), TYPED_FLOAT64);
+    exitAt(as, CC_NE, pc);
+    testNotFloat(as, RAX);
+    exitAt(as, CC_E, pc);
+    memOp(as, true, 0x89, RAX, RCX, RDX, 8, 0);
+
+    bindHere(as, arrayDone);
+    bindHere(as, int32Done);
+    bindHere(as, converted);
+}
+
+// R(A) = R(B).K(C) through the instruction's inline cache: struct fields
+// and module variables whose shape the interpreter has already cached
+static void emitGetProp(Assembler* as, int pc, uint32_t inst) {
+    PropCache* ic = &as->chunk->propCaches[pc];
+    loadValue(as, RAX, DECODE_B(inst));
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, RAX);
+    movImm(as, RDX, (uintptr_t)ic);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_STRUCT_INSTANCE);
+    size_t notStruct = jumpForward(as, CC_NE);
+    movLoad(as, RCX, RSI, offsetof(StructInstance, def));
+    memOp(as, true, 0x3B, RCX, RDX, NO_INDEX, 1, offsetof(PropCache, shape)); // cmp rcx, [rdx]
+    exitAt(as, CC_NE, pc);
+    movLoad32(as, RCX, RDX, offsetof(PropCache, index));
+    memOp(as, true, 0x8B, RAX, RSI, RCX, 8, offsetof(StructInstance, fields));
+    storeValue(as, DECODE_A(inst), RAX);
+    size_t done = jumpForward(as, CC_ALWAYS);
+
+    bindHere(as, notStruct);
+    cmpMemImm32(as, RSI, offsetof(Obj, type), OBJ_MODULE);
+    exitAt(as, CC_NE, pc);
+    movLoad(as, RCX, RSI, offsetof(Module, env));
+    memOp(as, true, 0x3B, RCX, RDX, NO_INDEX, 1, offsetof(PropCache, shape));
+    exitAt(as, CC_NE, pc);
+    movLoad32(as, R8, RDX, offsetof(PropCache, index));
+    regOp(as, true, 0x69, R8, R8);                      // imul r8, r8, sizeof(VarEntry)
+    emit32(as, sizeof(VarEntry));
+    movLoad(as, RCX, RCX, offsetof(Environment, vars));
+    memOp(as, true, 0x8B, RAX, RCX, R8, 1, offsetof(VarEntry, value));
+    storeValue(as, DECODE_A(inst), RAX);
+    bindHere(as, done);
+}
+
+// R(A).K(B) = R(C) for a struct field the inline cache knows
+static void emitSetProp(Assembler* as, int pc, uint32_t inst) {
+    PropCache* ic = &as->chunk->propCaches[pc];
+    loadValue(as, RAX, DECODE_A(inst));
+    expectObjType(as, pc, RAX, OBJ_STRUCT_INSTANCE);
+    movImm(as, RDX, (uintptr_t)ic);
+    movLoad(as, RCX, RSI, offsetof(StructInstance, def));
+    memOp(as, true, 0x3B, RCX, RDX, NO_INDEX, 1, offsetof(PropCache, shape));
+    exitAt(as, CC_NE, pc);
+    movLoad32(as, RCX, RDX, offsetof(PropCache, index));
+    loadValue(as, RAX, DECODE_C(inst));
+    memOp(as, true, 0x89, RAX, RSI, RCX, 8, offsetof(StructInstance, fields));
+    emitBarrier(as);
+}
+
+static void emitGetGlobal(Assembler* as, int pc, uint32_t inst) {
+    movLoad(as, RAX, VMREG, offsetof(VM, globalEnv));
+    movLoad(as, RAX, RAX, offsetof(Environment, vars));
+    movLoad(as, RAX, RAX, (int32_t)(DECODE_Bx(inst) * sizeof(VarEntry) + offsetof(VarEntry, value)));
+    movImm(as, RDX, UNDEFINED_VAL);
+    alu(as, ALU_CMP, RAX, RDX);
+    exitAt(as, CC_E, pc); // The interpreter reports it
+    storeValue(as, DECODE_A(inst), RAX);
+}
+
+static void emitSetGlobal(Assembler* as, uint32_t inst) {
+    loadValue(as, RAX, DECODE_A(inst));
+    movLoad(as, RSI, VMREG, offsetof(VM, globalEnv));
+    movLoad(as, RCX, RSI, offsetof(Environment, vars));
+    movStore(as, RCX, (int32_t)(DECODE_Bx(inst) * sizeof(VarEntry) + offsetof(VarEntry, value)), RAX);
+    emitBarrier(as);
+}
+
+// R(A) = len(R(B)) for arrays, typed arrays, strings and maps
+static void emitLen(Assembler* as, int pc, uint32_t inst) {
+    static const struct { ObjType type; int32_t count; } lengths[] = {
+        {OBJ_ARRAY, offsetof(Array, count)},
+        {OBJ_TYPED_ARRAY, offsetof(TypedArray, count)},
+        {OBJ_STRING, offsetof(ObjString, length)},
+        {OBJ_MAP, offsetof(Map, count)},
+    };
+    int n = (int)(sizeof(lengths) / sizeof(lengths[0]));
+    size_t found[4];
+    loadValue(as, RAX, DECODE_B(inst));
+    testObj(as, RAX);
+    exitAt(as, CC_NE, pc);
+    unboxObj(as, RSI, RAX);
+    for (int i = 0; i < n; i++) {
+        cmpMemImm32(as, RSI, offsetof(Obj, type), lengths[i].type);
+        size_t other = jumpForward(as, CC_NE);
+        movLoad32(as, RAX, RSI, lengths[i].count);
+        found[i] = jumpForward(as, CC_ALWAYS);
+        bindHere(as, other);
+    }
+    exitAt(as, CC_ALWAYS, pc);
+    for (int i = 0; i < n; i++) bindHere(as, found[i]);
+    boxInt(as, RAX);
+    storeValue(as, DECODE_A(inst), RAX);
+}
+
+static void jitPush(VM* vm, BytecodeChunk* chunk, Array* arr, Value value) {
+    vm->regTop = vm->regBase + (int)(chunk->maxRegs + 1); // Roots the frame
+    arrayPush(vm, arr, value);
+    WRITE_BARRIER(vm, arr);
+}
+
+static void emitPush(Assembler* as, int pc, uint32_t inst) {
+    loadValue(as, RAX, DECODE_A(inst));
+    expectObjType(as, pc, RAX, OBJ_ARRAY);
+    movRR(as, RDX, RSI);
+    loadValue(as, RCX, DECODE_B(inst));
+    movRR(as, RDI, VMREG);
+    movImm(as, RSI, (uintptr_t)as->chunk);
+    callHelper(as, (uintptr_t)jitPush);
+}
+
+// OP_FOREACH_NEXT over an array; other collections go to the interpreter
+static void emitForeachNext(Assembler* as, int pc, uint32_t inst) {
+    int a = DECODE_A(inst);
+    loadValue(as, RAX, a);
+    expectObjType(as, pc, RAX, OBJ_ARRAY);
+    movLoad32(as, RDX, REGS, REG_DISP(a + 1));          // pos
+    movLoad32(as, RCX, RSI, offsetof(Array, count));
+    alu32(as, ALU_CMP, RDX, RCX);
+    size_t finished = jumpForward(as, CC_GE);
+    movLoad(as, RCX, RSI, offsetof(Array, items));
+    regOp(as, true, 0x63, RAX, RDX);                    // movsxd rax, edx
+    memOp(as, true, 0x8B, RAX, RCX, RAX, 8, 0);
+    storeValue(as, a + 2, RAX);
+    aluImm(as, false, EXT_ADD, RDX, 1);
+    boxInt(as, RDX);
+    storeValue(as, a + 1, RDX);
+    jumpTo(as, CC_ALWAYS, pc + DECODE_sBx(inst) + 1);
+    bindHere(as, finished);
+}
+
+// Compare-and-branch: the next word is the OP_JMP taken when the result
+// equals A
+static bool fusedOutcome(Assembler* as, int pc, uint32_t inst, Outcome* out) {
+    BytecodeChunk* chunk = as->chunk;
+    if (pc + 1 >= chunk->codeSize || DECODE_OP(chunk->code[pc + 1]) != OP_JMP) return false;
+    out->dest = -1;
+    out->target = pc + DECODE_sBx24(chunk->code[pc + 1]) + 2;
+    out->skip = pc + 2;
+    out->when = DECODE_A(inst) != 0;
+    return true;
+}
+
+// False if the instruction is left to the interpreter
+static bool emitInstruction(Assembler* as, int pc) {
+    BytecodeChunk* chunk = as->chunk;
+    uint32_t inst = chunk->code[pc];
+    int op = baseOpcode(DECODE_OP(inst));
+    int a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
+    Outcome out = {a, 0, 0, false};
+
+    switch (op) {
+        case OP_MOVE:
+            loadValue(as, RAX, b);
+            storeValue(as, a, RAX);
+            break;
+        case OP_LOADK:
+            movImm(as, RAX, chunk->constants[DECODE_Bx(inst)]);
+            storeValue(as, a, RAX);
+            break;
+        case OP_LOADI:
+            movImm(as, RAX, INT_VAL(DECODE_sBx(inst)));
+            storeValue(as, a, RAX);
+            break;
+        case OP_LOADNIL:
+        case OP_LOADTRUE:
+        case OP_LOADFALSE:
+            movImm(as, RAX, op == OP_LOADNIL ? NIL_VAL : BOOL_VAL(op == OP_LOADTRUE));
+            storeValue(as, a, RAX);
+            break;
+
+        case OP_GETGLOBAL: emitGetGlobal(as, pc, inst); break;
+        case OP_SETGLOBAL:
+        case OP_DEFGLOBAL: emitSetGlobal(as, inst); break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD: emitArith(as, pc, inst, op); break;
+        case OP_ADDI: emitArithImm(as, pc, inst, EXT_ADD); break;
+        case OP_SUBI: emitArithImm(as, pc, inst, EXT_SUB); break;
+        case OP_NEG: emitNeg(as, pc, inst); break;
+
+        case OP_LT: emitOrdering(as, pc, LESS, b, c, NULL, &out); break;
+        case OP_LE: emitOrdering(as, pc, LESS_EQUAL, b, c, NULL, &out); break;
+        case OP_GT: emitOrdering(as, pc, GREATER, b, c, NULL, &out); break;
+        case OP_GE: emitOrdering(as, pc, GREATER_EQUAL, b, c, NULL, &out); break;
+        case OP_EQ:
+        case OP_NE:
+            loadValue(as, RAX, b);
+            loadValue(as, RDX, c);
+            emitEquals(as, pc);
+            emitOutcome(as, op == OP_EQ ? CC_NE : CC_E, &out);
+            break;
+        case OP_NOT:
+            loadValue(as, RAX, b);
+            emitTruthy(as, pc);
+            emitOutcome(as, CC_E, &out);
+            break;
+
+        case OP_JMP: jumpTo(as, CC_ALWAYS, pc + DECODE_sBx24(inst) + 1); break;
+        case OP_LOOP: jumpTo(as, CC_ALWAYS, pc - DECODE_sBx24(inst) + 1); break;
+        case OP_JMPF:
+        case OP_JMPT:
+            loadValue(as, RAX, a);
+            emitTruthy(as, pc);
+            jumpTo(as, op == OP_JMPF ? CC_E : CC_NE, pc + DECODE_sBx(inst) + 1);
+            break;
+
+        case OP_LTJMP:
+        case OP_LEJMP:
+        case OP_LTJMPK:
+        case OP_LEJMPK:
+        case OP_GTJMPK:
+        case OP_GEJMPK: {
+            if (!fusedOutcome(as, pc, inst, &out)) {
+                exitAt(as, CC_ALWAYS, pc);
+                return false;
+            }
+            Ordering ord = (op == OP_LTJMP || op == OP_LTJMPK) ? LESS
+                         : (op == OP_LEJMP || op == OP_LEJMPK) ? LESS_EQUAL
+                         : op == OP_GTJMPK ? GREATER : GREATER_EQUAL;
+            bool constant = op != OP_LTJMP && op != OP_LEJMP;
+            emitOrdering(as, pc, ord, b, c, constant ? &chunk->constants[c] : NULL, &out);
+            break;
+        }
+        case OP_EQJMP:
+        case OP_EQJMPK:
+            if (!fusedOutcome(as, pc, inst, &out)) {
+                exitAt(as, CC_ALWAYS, pc);
+                return false;
+            }
+            loadValue(as, RAX, b);
+            if (op == OP_EQJMPK) movImm(as, RDX, chunk->constants[c]);
+            else loadValue(as, RDX, c);
+            emitEquals(as, pc);
+            emitOutcome(as, CC_NE, &out);
+            break;
+
+        case OP_GETIDX: emitGetIndex(as, pc, inst); break;
+        case OP_GETIDXI: emitGetIndexImm(as, pc, inst); break;
+        case OP_SETIDX: emitSetIndex(as, pc, inst); break;
+        case OP_GETPROP: emitGetProp(as, pc, inst); break;
+        case OP_SETPROP: emitSetProp(as, pc, inst); break;
+        case OP_LEN: emitLen(as, pc, inst); break;
+        case OP_PUSH: emitPush(as, pc, inst); break;
+
+        case OP_FOREACH_PREP:
+            movImm(as, RAX, INT_VAL(0));
+            storeValue(as, a + 1, RAX);
+            break;
+        case OP_FOREACH_NEXT: emitForeachNext(as, pc, inst); break;
+
+        case OP_NOP: break;
+
+        default:
+            // Calls, returns, allocation, imports, async: the interpreter's
+            exitAt(as, CC_ALWAYS, pc);
+            return false;
+    }
+    return true;
+}
+
+// Entry: save the callee-saved registers, load the fixed ones, and jump to
+// the instruction; the epilogue returns the instruction in eax
+static void emitEntry(Assembler* as) {
+    static const int saved[] = {RBX, RBP, R12, R13, R14, R15};
+    for (int i = 0; i < 6; i++) {
+        if (saved[i] & 8) emit(as, 0x41);
+        emit(as, (uint8_t)(0x50 + (saved[i] & 7)));     // push
+    }
+    aluImm(as, true, EXT_SUB, RSP, 8);                  // Calls need a 16-byte aligned stack
+    movRR(as, REGS, RDI);
+    movRR(as, VMREG, RSI);
+    movImm(as, OBJ_TAG, QNAN | SIGN_BIT);
+    movImm(as, INT_TAG, QNAN | TAG_INT_BIT);
+    movImm(as, QNAN_REG, QNAN);
+    regOp(as, false, 0xFF, 4, RDX);                     // jmp rdx
+
+    as->epilogue = as->size;
+    aluImm(as, true, EXT_ADD, RSP, 8);
+    for (int i = 5; i >= 0; i--) {
+        if (saved[i] & 8) emit(as, 0x41);
+        emit(as, (uint8_t)(0x58 + (saved[i] & 7)));     // pop
+    }
+    emit(as, 0xC3);
+}
+
+// Out of line, after all the instructions: one stub per instruction that leaves
+static void emitExits(Assembler* as) {
+    size_t stub = 0;
+    int stubPc = -1;
+    for (int i = 0; i < as->exitCount; i++) {
+        Fixup* f = &as->exits[i];
+        if (f->pc != stubPc) {
+            stub = as->size;
+            stubPc = f->pc;
+            movImm(as, RAX, (uint32_t)stubPc);
+            emit(as, 0xE9);
+            emit32(as, (uint32_t)(int32_t)(as->epilogue - (as->size + 4)));
+        }
+        patch32(as, f->at, (int32_t)(stub - (f->at + 4)));
+    }
+}
+
+static bool hasPropertyAccess(BytecodeChunk* chunk) {
+    for (int i = 0; i < chunk->codeSize; i++) {
+        int op = DECODE_OP(chunk->code[i]);
+        if (op == OP_GETPROP || op == OP_SETPROP) return true;
+    }
+    return false;
+}
+
+bool jitCompile(VM* vm, BytecodeChunk* chunk) {
+    if (!vm->jitEnabled || chunk->codeSize == 0) return false;
+    // Native code reads the inline caches in place, so they must exist
+    if (!chunk->propCaches && hasPropertyAccess(chunk)) allocPropCaches(chunk);
+
+    Assembler as;
+    memset(&as, 0, sizeof(as));
+    as.chunk = chunk;
+    as.entries = growOrDie(NULL, sizeof(uint32_t) * (size_t)chunk->codeSize);
+
+    emitEntry(&as);
+    for (int pc = 0; pc < chunk->codeSize; pc++) {
+        as.entries[pc] = (uint32_t)as.size;
+        if (!emitInstruction(&as, pc)) as.entries[pc] |= INTERPRETED;
+    }
+    emitExits(&as);
+    for (int i = 0; i < as.jumpCount; i++) {
+        Fixup* f = &as.jumps[i];
+        if (f->pc < 0 || f->pc >= chunk->codeSize) {
+            as.failed = true; // Jumps out of the chunk: leave it to the interpreter
+            break;
+        }
+        patch32(&as, f->at, (int32_t)((as.entries[f->pc] & ~INTERPRETED) - (f->at + 4)));
+    }
+
+    JitCode* jit = NULL;
+    if (!as.failed) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t mapped = (as.size + page - 1) / page * page;
+        uint8_t* code = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code != MAP_FAILED) {
+            memcpy(code, as.code, as.size);
+            if (mprotect(code, mapped, PROT_READ | PROT_EXEC) == 0) {
+                jit = growOrDie(NULL, sizeof(JitCode));
+                jit->code = code;
+                jit->mapped = mapped;
+                jit->entries = as.entries;
+                as.entries = NULL;
+            } else {
+                munmap(code, mapped);
+            }
+        }
+    }
+#ifdef DEBUG_PRINT_CODE
+    printf("== jit: %d instructions -> %zu bytes%s ==\n", chunk->codeSize, as.size, jit ? "" : " (failed)");
+#endif
+    free(as.code);
+    free(as.entries);
+    free(as.jumps);
+    free(as.exits);
+    chunk->jit = jit;
+    return jit != NULL;
+}
+
+int jitRun(JitCode* jit, VM* vm, Value* regs, int pc) {
+    if (jit->entries[pc] & INTERPRETED) return pc;
+    JitEntry enter = (JitEntry)(void*)jit->code;
+    return enter(regs, vm, jit->code + jit->entries[pc]);
+}
+
+void jitFree(JitCode* jit) {
+    munmap(jit->code, jit->mapped);
+    free(jit->entries);
+    free(jit);
+}
+
+#else
+
+// No native backend for this target: everything stays interpreted
+
+bool jitCompile(VM* vm, BytecodeChunk* chunk) {
+    (void)vm;
+    (void)chunk;
+    return false;
+}
+
+int jitRun(JitCode* jit, VM* vm, Value* regs, int pc) {
+    (void)jit;
+    (void)vm;
+    (void)regs;
+    return pc;
+}
+
+void jitFree(JitCode* jit) {
+    (void)jit;
+}
+
+#endif
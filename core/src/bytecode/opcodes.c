@@ -3,7 +3,7 @@
 
 /**
  * Register-based opcode metadata table
- * format: 0=ABC, 1=ABx, 2=AsBx, 3=sBx, 4=A-only
+ * format: 0=ABC, 1=ABx, 2=AsBx, 3=sBx, 4=A-only, 5=compare-and-branch
  */
 
 static const OpcodeInfo OPCODE_TABLE[] = {
@@ -86,11 +86,47 @@ static const OpcodeInfo OPCODE_TABLE[] = {
     [OP_NOP]        = {"NOP",        4, false},
 
     // Foreach
-    [OP_FOREACH_PREP] = {"FOREACH_PREP", 0, true},
+    [OP_FOREACH_PREP] = {"FOREACH_PREP", 4, true},
     [OP_FOREACH_NEXT] = {"FOREACH_NEXT", 2, true},
 
     // Concatenation
     [OP_CONCAT]     = {"CONCAT",     0, false},
+
+    // Superinstructions
+    [OP_LTJMP]      = {"LTJMP",      5, false},
+    [OP_LEJMP]      = {"LEJMP",      5, false},
+    [OP_EQJMP]      = {"EQJMP",      5, false},
+    [OP_LTJMPK]     = {"LTJMPK",     5, false},
+    [OP_LEJMPK]     = {"LEJMPK",     5, false},
+    [OP_GTJMPK]     = {"GTJMPK",     5, false},
+    [OP_GEJMPK]     = {"GEJMPK",     5, false},
+    [OP_EQJMPK]     = {"EQJMPK",     5, false},
+    [OP_GETIDXI]    = {"GETIDXI",    0, false},
+
+    // Quickened variants
+    [OP_ADD_II]     = {"ADD_II",       0, false},
+    [OP_ADD_FF]     = {"ADD_FF",       0, false},
+    [OP_SUB_II]     = {"SUB_II",       0, false},
+    [OP_SUB_FF]     = {"SUB_FF",       0, false},
+    [OP_MUL_II]     = {"MUL_II",       0, false},
+    [OP_MUL_FF]     = {"MUL_FF",       0, false},
+    [OP_DIV_FF]     = {"DIV_FF",       0, false},
+    [OP_LT_II]      = {"LT_II",        0, false},
+    [OP_LT_FF]      = {"LT_FF",        0, false},
+    [OP_LE_II]      = {"LE_II",        0, false},
+    [OP_LE_FF]      = {"LE_FF",        0, false},
+    [OP_GT_II]      = {"GT_II",        0, false},
+    [OP_GT_FF]      = {"GT_FF",        0, false},
+    [OP_GE_II]      = {"GE_II",        0, false},
+    [OP_GE_FF]      = {"GE_FF",        0, false},
+    [OP_LTJMP_II]   = {"LTJMP_II",     5, false},
+    [OP_LTJMP_FF]   = {"LTJMP_FF",     5, false},
+    [OP_LEJMP_II]   = {"LEJMP_II",     5, false},
+    [OP_LEJMP_FF]   = {"LEJMP_FF",     5, false},
+    [OP_GETIDX_ARR_I] = {"GETIDX_ARR_I", 0, false},
+    [OP_SETIDX_ARR_I] = {"SETIDX_ARR_I", 0, true},
+    [OP_GETIDX_TA_I]  = {"GETIDX_TA_I",  0, false},
+    [OP_SETIDX_TA_I]  = {"SETIDX_TA_I",  0, true},
 };
 
 const OpcodeInfo* getOpcodeInfo(OpCode op) {
@@ -0,0 +1,765 @@
+#include "bytecode/optimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Peephole Optimizer
+ *
+ * The chunk is decoded into a list with absolute jump targets, rewritten
+ * in rounds until nothing changes, then re-encoded. Each round:
+ *   - threads jumps (jump-to-jump, jump-to-return, jump-to-next)
+ *   - drops unreachable code
+ *   - recomputes register liveness, then applies local rewrites:
+ *       constant folding (arithmetic, comparisons, constant branches),
+ *       dead-move elimination (self moves, unread loads, copy
+ *       propagation, moves coalesced into the producing instruction),
+ *       superinstructions (compare-and-branch, ADDI/SUBI, GETIDXI).
+ *
+ * Rewrites only look at adjacent instructions, none of which may be a
+ * jump target (except the first), so they never lengthen the time a
+ * register holds a value. Liveness therefore only shrinks within a round
+ * and stale sets stay conservative; instructions rewritten in a round are
+ * marked 'touched' and left alone until liveness is recomputed.
+ */
+
+#define OPT_MAX_ROUNDS 16
+#define OPT_CONST_SEARCH 256
+#define REG_WORDS (FRAME_REG_MAX / 64)
+
+typedef struct {
+    uint64_t bits[REG_WORDS];
+} RegSet;
+
+typedef struct {
+    uint32_t inst;      // Jump offsets in 'inst' are stale; 'target' is authoritative
+    int target;         // Index of the jump target, -1 for non-jumps
+    int line;
+    bool isTarget;      // Some jump lands here
+    bool pinned;        // Read by the preceding STRUCTDEF; must stay as is
+    bool touched;       // Rewritten this round
+} Insn;
+
+typedef struct {
+    BytecodeChunk* chunk;
+    Insn* code;
+    int count;
+    RegSet* liveIn;
+    RegSet* liveOut;    // Registers read before being written on some path after each instruction
+    bool changed;
+} Optimizer;
+
+// ===== Register Sets =====
+
+static inline void regAdd(RegSet* set, int reg) {
+    if (reg < FRAME_REG_MAX) set->bits[reg >> 6] |= 1ull << (reg & 63);
+}
+
+static inline bool regHas(const RegSet* set, int reg) {
+    return (set->bits[reg >> 6] >> (reg & 63)) & 1;
+}
+
+static void regAddRange(RegSet* set, int first, int count) {
+    for (int r = first; r < first + count; r++) regAdd(set, r);
+}
+
+// ===== Opcode Classes =====
+
+static bool isCompareJump(uint8_t op) {
+    return op >= OP_LTJMP && op <= OP_EQJMPK;
+}
+
+static bool isJump(uint8_t op) {
+    return op == OP_JMP || op == OP_LOOP || op == OP_JMPF || op == OP_JMPT ||
+           op == OP_FOREACH_NEXT || isCompareJump(op);
+}
+
+// Control never falls through to the next instruction
+static bool endsBlock(uint8_t op) {
+    return op == OP_JMP || op == OP_LOOP || op == OP_RETURN ||
+           op == OP_RETURNNIL || op == OP_HALT;
+}
+
+// Registers an instruction reads and writes. Opcodes with implicit
+// operands (STRUCTDEF peeks at the next instruction, IMPORT runs a module)
+// are treated as reading every register.
+static void regEffects(uint32_t inst, RegSet* use, RegSet* def) {
+    memset(use, 0, sizeof(RegSet));
+    memset(def, 0, sizeof(RegSet));
+    uint8_t a = DECODE_A(inst), b = DECODE_B(inst), c = DECODE_C(inst);
+
+    switch (DECODE_OP(inst)) {
+        case OP_MOVE: case OP_NEG: case OP_NOT: case OP_LEN: case OP_POP:
+        case OP_AWAIT: case OP_GETPROP: case OP_GETIDXI:
+            regAdd(use, b); regAdd(def, a);
+            break;
+        case OP_LOADK: case OP_LOADI: case OP_LOADNIL: case OP_LOADTRUE:
+        case OP_LOADFALSE: case OP_GETGLOBAL: case OP_NEWARRAY: case OP_NEWMAP:
+            regAdd(def, a);
+            break;
+        case OP_SETGLOBAL: case OP_DEFGLOBAL: case OP_PRINT: case OP_RETURN:
+        case OP_JMPF: case OP_JMPT:
+            regAdd(use, a);
+            break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE:
+        case OP_CONCAT: case OP_GETIDX:
+            regAdd(use, b); regAdd(use, c); regAdd(def, a);
+            break;
+        case OP_ADDI: case OP_SUBI:
+            regAdd(use, a); regAdd(def, a);
+            break;
+        case OP_SETPROP:
+            regAdd(use, a); regAdd(use, c);
+            break;
+        case OP_SETIDX:
+            regAdd(use, a); regAdd(use, b); regAdd(use, c);
+            break;
+        case OP_PUSH:
+            regAdd(use, a); regAdd(use, b);
+            break;
+        case OP_LTJMP: case OP_LEJMP: case OP_EQJMP:
+            regAdd(use, b); regAdd(use, c);
+            break;
+        case OP_LTJMPK: case OP_LEJMPK: case OP_GTJMPK: case OP_GEJMPK: case OP_EQJMPK:
+            regAdd(use, b);
+            break;
+        case OP_CALL:
+            regAddRange(use, a, b + 1); regAdd(def, a);
+            break;
+        case OP_FOREACH_PREP:
+            regAdd(use, a); regAdd(def, a + 1);
+            break;
+        case OP_FOREACH_NEXT:
+            // Writes R(A+1) and R(A+2) only when it takes the jump
+            regAddRange(use, a, 2);
+            break;
+        case OP_NEWSTRUCT:
+            regAdd(use, b); regAddRange(use, a + 1, c); regAdd(def, a);
+            break;
+        case OP_ASYNC:
+            regAddRange(use, b, c + 1); regAdd(def, a);
+            break;
+        case OP_JMP: case OP_LOOP: case OP_RETURNNIL: case OP_HALT: case OP_NOP:
+            break;
+        default:
+            memset(use, 0xFF, sizeof(RegSet));
+            break;
+    }
+}
+
+// Writes R(A) and no other register, after reading all of its operands
+static bool writesOnlyA(uint8_t op) {
+    switch (op) {
+        case OP_MOVE: case OP_LOADK: case OP_LOADI: case OP_LOADNIL:
+        case OP_LOADTRUE: case OP_LOADFALSE: case OP_GETGLOBAL:
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD: case OP_NEG:
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE: case OP_NOT:
+        case OP_GETPROP: case OP_GETIDX: case OP_GETIDXI: case OP_NEWARRAY: case OP_NEWMAP:
+        case OP_LEN: case OP_POP: case OP_CONCAT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+#define FIELD_A 1
+#define FIELD_B 2
+#define FIELD_C 4
+
+// Operand fields naming a register the instruction reads (0 when reads are
+// implicit, span a register range, or share a field with the result)
+static int readFields(uint8_t op) {
+    switch (op) {
+        case OP_MOVE: case OP_NEG: case OP_NOT: case OP_LEN: case OP_POP:
+        case OP_AWAIT: case OP_GETPROP: case OP_GETIDXI:
+        case OP_LTJMPK: case OP_LEJMPK: case OP_GTJMPK: case OP_GEJMPK: case OP_EQJMPK:
+            return FIELD_B;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_LT: case OP_LE: case OP_GT: case OP_GE: case OP_EQ: case OP_NE:
+        case OP_CONCAT: case OP_GETIDX: case OP_LTJMP: case OP_LEJMP: case OP_EQJMP:
+            return FIELD_B | FIELD_C;
+        case OP_SETGLOBAL: case OP_DEFGLOBAL: case OP_PRINT: case OP_RETURN:
+        case OP_JMPF: case OP_JMPT:
+            return FIELD_A;
+        case OP_SETPROP:
+            return FIELD_A | FIELD_C;
+        case OP_SETIDX:
+            return FIELD_A | FIELD_B | FIELD_C;
+        case OP_PUSH:
+            return FIELD_A | FIELD_B;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t withA(uint32_t inst, int a) {
+    return (inst & ~0x00FF0000u) | ((uint32_t)(a & 0xFF) << 16);
+}
+
+// ===== Constants =====
+
+// The value 'inst' loads into R(A), if it is a constant load
+static bool loadedValue(BytecodeChunk* chunk, uint32_t inst, Value* out) {
+    switch (DECODE_OP(inst)) {
+        case OP_LOADI:     *out = INT_VAL(DECODE_sBx(inst)); return true;
+        case OP_LOADTRUE:  *out = BOOL_VAL(true); return true;
+        case OP_LOADFALSE: *out = BOOL_VAL(false); return true;
+        case OP_LOADNIL:   *out = NIL_VAL; return true;
+        case OP_LOADK:
+            if ((int)DECODE_Bx(inst) >= chunk->constantCount) return false;
+            *out = chunk->constants[DECODE_Bx(inst)];
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Index of 'value' in the constant pool, added if missing; -1 if beyond 'limit'.
+// Only the newest OPT_CONST_SEARCH entries up to 'limit' are searched: the
+// top level of a long generated script has a pool of many thousands.
+static int constantIndex(BytecodeChunk* chunk, Value value, int limit) {
+    int end = chunk->constantCount - 1 < limit ? chunk->constantCount - 1 : limit;
+    int start = end - OPT_CONST_SEARCH + 1 > 0 ? end - OPT_CONST_SEARCH + 1 : 0;
+    for (int i = start; i <= end; i++) {
+        if (chunk->constants[i] == value) return i;
+    }
+    if (chunk->constantCount > limit) return -1;
+    return addConstant(chunk, value);
+}
+
+// Instruction loading 'value' into R(reg), encoded as the compiler would
+static bool loadInstruction(BytecodeChunk* chunk, int reg, Value value, uint32_t* out) {
+    if (IS_BOOL(value)) {
+        *out = ENCODE_A(AS_BOOL(value) ? OP_LOADTRUE : OP_LOADFALSE, reg);
+        return true;
+    }
+    if (IS_INT(value) && AS_INT(value) >= -32767 && AS_INT(value) <= 32767) {
+        *out = ENCODE_ABx(OP_LOADI, reg, (uint16_t)(AS_INT(value) + 0x7FFF));
+        return true;
+    }
+    int k = constantIndex(chunk, value, UINT16_MAX);
+    if (k < 0) return false;
+    *out = ENCODE_ABx(OP_LOADK, reg, k);
+    return true;
+}
+
+static bool isNumeric(Value v) {
+    return IS_INT(v) || IS_FLOAT(v);
+}
+
+// Evaluate a binary opcode on two number constants as the interpreter
+// would; false where it would fail at run time or leave R(A) alone
+static bool foldBinary(uint8_t op, Value vb, Value vc, Value* out) {
+    if (!isNumeric(vb) || !isNumeric(vc)) return false;
+    bool ints = IS_INT(vb) && IS_INT(vc);
+    bool floats = IS_FLOAT(vb) && IS_FLOAT(vc);     // Comparisons only order like types
+    int64_t ib = IS_INT(vb) ? AS_INT(vb) : 0;
+    int64_t ic = IS_INT(vc) ? AS_INT(vc) : 0;
+    double db = IS_INT(vb) ? (double)AS_INT(vb) : AS_FLOAT(vb);
+    double dc = IS_INT(vc) ? (double)AS_INT(vc) : AS_FLOAT(vc);
+
+    switch (op) {
+        case OP_ADD: *out = ints ? INT_VAL(ib + ic) : FLOAT_VAL(db + dc); return true;
+        case OP_SUB: *out = ints ? INT_VAL(ib - ic) : FLOAT_VAL(db - dc); return true;
+        case OP_MUL: *out = ints ? INT_VAL(ib * ic) : FLOAT_VAL(db * dc); return true;
+        case OP_DIV:
+            if (!ints) { *out = FLOAT_VAL(db / dc); return true; }
+            if (ic == 0 || (ib == INT32_MIN && ic == -1)) return false;
+            *out = INT_VAL(ib / ic);
+            return true;
+        case OP_MOD:
+            if (!ints || ic == 0 || (ib == INT32_MIN && ic == -1)) return false;
+            *out = INT_VAL(ib % ic);
+            return true;
+        case OP_LT: *out = BOOL_VAL((ints || floats) && db <  dc); return true;
+        case OP_LE: *out = BOOL_VAL((ints || floats) && db <= dc); return true;
+        case OP_GT: *out = BOOL_VAL((ints || floats) && db >  dc); return true;
+        case OP_GE: *out = BOOL_VAL((ints || floats) && db >= dc); return true;
+        case OP_EQ:
+        case OP_NE: {
+            bool eq = (ints || floats) && db == dc;
+            *out = BOOL_VAL(op == OP_EQ ? eq : !eq);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool isConstantTruthy(Value v) {
+    if (IS_BOOL(v)) return AS_BOOL(v);
+    if (IS_NIL(v)) return false;
+    if (IS_INT(v)) return AS_INT(v) != 0;
+    if (IS_FLOAT(v)) return AS_FLOAT(v) != 0.0;
+    return true;
+}
+
+// ===== Decode / Encode =====
+
+static bool decodeChunk(Optimizer* o) {
+    BytecodeChunk* chunk = o->chunk;
+    int size = chunk->codeSize;
+    int* indexOf = malloc((size + 1) * sizeof(int));  // Word offset -> instruction index
+    o->code = malloc(size * sizeof(Insn));
+    if (!indexOf || !o->code) {
+        fprintf(stderr, "Memory allocation failed for optimizer.\n");
+        exit(1);
+    }
+
+    bool ok = true;
+    o->count = 0;
+    for (int pc = 0; pc < size; pc++) {
+        uint32_t inst = chunk->code[pc];
+        uint8_t op = DECODE_OP(inst);
+        indexOf[pc] = o->count;
+
+        Insn* in = &o->code[o->count++];
+        in->inst = inst;
+        in->line = chunk->lineNumbers[pc];
+        in->target = -1;
+        in->isTarget = false;
+        in->pinned = o->count > 1 && DECODE_OP(o->code[o->count - 2].inst) == OP_STRUCTDEF;
+        in->touched = false;
+
+        if (op == OP_JMP) {
+            in->target = pc + 1 + DECODE_sBx24(inst);
+        } else if (op == OP_LOOP) {
+            in->target = pc + 1 - DECODE_sBx24(inst);
+        } else if (isCompareJump(op)) {
+            if (pc + 1 >= size) { ok = false; break; }
+            indexOf[++pc] = o->count - 1;
+            in->target = pc + 1 + DECODE_sBx24(chunk->code[pc]);
+        } else if (isJump(op)) {
+            in->target = pc + 1 + DECODE_sBx(inst);
+        }
+        if (in->target < -1 || in->target > size) { ok = false; break; }
+    }
+    indexOf[size] = o->count;
+
+    for (int i = 0; ok && i < o->count; i++) {
+        if (o->code[i].target >= 0) o->code[i].target = indexOf[o->code[i].target];
+    }
+    free(indexOf);
+    return ok;
+}
+
+static bool encodeChunk(Optimizer* o) {
+    int* pos = malloc((o->count + 1) * sizeof(int));
+    int size = 0;
+    for (int i = 0; i < o->count; i++) {
+        pos[i] = size;
+        size += isCompareJump(DECODE_OP(o->code[i].inst)) ? 2 : 1;
+    }
+    pos[o->count] = size;
+
+    uint32_t* code = malloc(size * sizeof(uint32_t));
+    int* lines = malloc(size * sizeof(int));
+    if (!pos || !code || !lines) {
+        fprintf(stderr, "Memory allocation failed for optimizer.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < o->count; i++) {
+        Insn* in = &o->code[i];
+        uint8_t op = DECODE_OP(in->inst);
+        int p = pos[i];
+        code[p] = in->inst;
+        lines[p] = in->line;
+        if (in->target < 0) continue;
+
+        int to = pos[in->target];
+        if (op == OP_JMP || op == OP_LOOP) {
+            // Backward jumps are LOOPs, as the compiler emits them
+            code[p] = to > p ? ENCODE_sBx(OP_JMP, to - p - 1) : ENCODE_sBx(OP_LOOP, p - to + 1);
+        } else if (isCompareJump(op)) {
+            code[p + 1] = ENCODE_sBx(OP_JMP, to - p - 2);
+            lines[p + 1] = in->line;
+        } else {
+            int offset = to - p - 1;
+            if (offset < -0x7FFF || offset > 0x8000) {
+                free(pos); free(code); free(lines);
+                return false;
+            }
+            code[p] = ENCODE_AsBx(op, DECODE_A(in->inst), offset);
+        }
+    }
+    free(pos);
+
+    BytecodeChunk* chunk = o->chunk;
+    free(chunk->code);
+    free(chunk->lineNumbers);
+    chunk->code = code;
+    chunk->lineNumbers = lines;
+    chunk->codeSize = size;
+    chunk->codeCapacity = size;
+    chunk->lineCapacity = size;
+    return true;
+}
+
+// ===== Analysis =====
+
+static void killInsn(Optimizer* o, int i) {
+    o->code[i].inst = ENCODE_A(OP_NOP, 0);
+    o->code[i].target = -1;
+    o->code[i].touched = true;
+    o->changed = true;
+}
+
+static void setInsn(Optimizer* o, int i, uint32_t inst, int target) {
+    o->code[i].inst = inst;
+    o->code[i].target = target;
+    o->code[i].touched = true;
+    o->changed = true;
+}
+
+// Drop NOPs, remapping jump targets onto the next surviving instruction
+static void compact(Optimizer* o) {
+    int* remap = malloc((o->count + 1) * sizeof(int));
+    int n = 0;
+    for (int i = 0; i < o->count; i++) {
+        remap[i] = n;
+        if (DECODE_OP(o->code[i].inst) != OP_NOP) n++;
+    }
+    remap[o->count] = n;
+
+    int w = 0;
+    for (int i = 0; i < o->count; i++) {
+        Insn in = o->code[i];
+        if (DECODE_OP(in.inst) == OP_NOP) continue;
+        if (in.target >= 0) in.target = remap[in.target];
+        in.touched = false;
+        o->code[w++] = in;
+    }
+    o->count = w;
+    free(remap);
+}
+
+static void threadJumps(Optimizer* o) {
+    for (int i = 0; i < o->count; i++) {
+        Insn* in = &o->code[i];
+        if (in->target < 0) continue;
+        uint8_t op = DECODE_OP(in->inst);
+
+        int to = in->target;
+        for (int hops = 0; hops < 8 && to < o->count; hops++) {
+            Insn* next = &o->code[to];
+            uint8_t nextOp = DECODE_OP(next->inst);
+            if ((nextOp != OP_JMP && nextOp != OP_LOOP) || next->target == to) break;
+            to = next->target;
+        }
+        if (to != in->target) {
+            in->target = to;
+            o->changed = true;
+        }
+
+        if (to == i + 1 && op != OP_FOREACH_NEXT) {
+            killInsn(o, i);     // Jump to the next instruction
+        } else if ((op == OP_JMP || op == OP_LOOP) && to < o->count &&
+                   (DECODE_OP(o->code[to].inst) == OP_RETURN ||
+                    DECODE_OP(o->code[to].inst) == OP_RETURNNIL)) {
+            setInsn(o, i, o->code[to].inst, -1);    // Return directly
+        }
+    }
+}
+
+static void removeUnreachable(Optimizer* o) {
+    bool* seen = calloc(o->count, sizeof(bool));
+    int* stack = malloc((2 * o->count + 1) * sizeof(int));
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int i = stack[--top];
+        if (i >= o->count || seen[i]) continue;
+        seen[i] = true;
+        uint8_t op = DECODE_OP(o->code[i].inst);
+        if (o->code[i].target >= 0) stack[top++] = o->code[i].target;
+        if (!endsBlock(op)) stack[top++] = i + 1;
+    }
+    for (int i = 0; i < o->count; i++) {
+        if (!seen[i] && DECODE_OP(o->code[i].inst) != OP_NOP) killInsn(o, i);
+    }
+    free(seen);
+    free(stack);
+}
+
+static void markTargets(Optimizer* o) {
+    for (int i = 0; i < o->count; i++) o->code[i].isTarget = false;
+    for (int i = 0; i < o->count; i++) {
+        int to = o->code[i].target;
+        if (to >= 0 && to < o->count) o->code[to].isTarget = true;
+    }
+}
+
+static void computeLiveness(Optimizer* o) {
+    memset(o->liveIn, 0, o->count * sizeof(RegSet));
+    bool again = true;
+    while (again) {
+        again = false;
+        for (int i = o->count - 1; i >= 0; i--) {
+            Insn* in = &o->code[i];
+            RegSet out = {{0}};
+            if (!endsBlock(DECODE_OP(in->inst)) && i + 1 < o->count) out = o->liveIn[i + 1];
+            if (in->target >= 0 && in->target < o->count) {
+                for (int w = 0; w < REG_WORDS; w++) out.bits[w] |= o->liveIn[in->target].bits[w];
+            }
+
+            RegSet use, def, live;
+            regEffects(in->inst, &use, &def);
+            for (int w = 0; w < REG_WORDS; w++) {
+                live.bits[w] = (out.bits[w] & ~def.bits[w]) | use.bits[w];
+            }
+            o->liveOut[i] = out;
+            if (memcmp(&live, &o->liveIn[i], sizeof(RegSet)) != 0) {
+                o->liveIn[i] = live;
+                again = true;
+            }
+        }
+    }
+}
+
+static inline bool deadAfter(Optimizer* o, int i, int reg) {
+    return !regHas(&o->liveOut[i], reg);
+}
+
+// Instruction i may join a rewrite that starts before it
+static bool canJoin(Optimizer* o, int i) {
+    return i < o->count && !o->code[i].touched && !o->code[i].pinned && !o->code[i].isTarget;
+}
+
+// ===== Rewrites =====
+
+// MOVE rX, rX and constant loads nobody reads
+static bool removeDeadLoad(Optimizer* o, int i) {
+    uint32_t inst = o->code[i].inst;
+    uint8_t op = DECODE_OP(inst);
+    if (op == OP_MOVE && DECODE_A(inst) == DECODE_B(inst)) {
+        killInsn(o, i);
+        return true;
+    }
+    if (op != OP_MOVE && op != OP_LOADK && op != OP_LOADI && op != OP_LOADNIL &&
+        op != OP_LOADTRUE && op != OP_LOADFALSE) return false;
+    if (!deadAfter(o, i, DECODE_A(inst))) return false;
+    killInsn(o, i);
+    return true;
+}
+
+// LOADx rB; LOADx rC; OP rA, rB, rC  ->  LOADx rA   (also LOADx rB; NEG rA, rB)
+static bool foldConstants(Optimizer* o, int i) {
+    Value vb, vc, result;
+    uint32_t load;
+    if (!loadedValue(o->chunk, o->code[i].inst, &vb) || !canJoin(o, i + 1)) return false;
+    int rB = DECODE_A(o->code[i].inst);
+    uint32_t next = o->code[i + 1].inst;
+
+    if (DECODE_OP(next) == OP_NEG) {
+        int a = DECODE_A(next);
+        if ((int)DECODE_B(next) != rB || !isNumeric(vb)) return false;
+        if (a != rB && !deadAfter(o, i + 1, rB)) return false;
+        result = IS_INT(vb) ? INT_VAL(-(int64_t)AS_INT(vb)) : FLOAT_VAL(-AS_FLOAT(vb));
+        if (!loadInstruction(o->chunk, a, result, &load)) return false;
+        killInsn(o, i);
+        setInsn(o, i + 1, load, -1);
+        return true;
+    }
+
+    if (!loadedValue(o->chunk, next, &vc) || !canJoin(o, i + 2)) return false;
+    int rC = DECODE_A(next);
+    uint32_t bin = o->code[i + 2].inst;
+    int a = DECODE_A(bin);
+    if (rB == rC || (int)DECODE_B(bin) != rB || (int)DECODE_C(bin) != rC) return false;
+    if ((a != rB && !deadAfter(o, i + 2, rB)) || (a != rC && !deadAfter(o, i + 2, rC))) return false;
+    if (!foldBinary(DECODE_OP(bin), vb, vc, &result)) return false;
+    if (!loadInstruction(o->chunk, a, result, &load)) return false;
+
+    killInsn(o, i);
+    killInsn(o, i + 1);
+    setInsn(o, i + 2, load, -1);
+    return true;
+}
+
+// LOADx r; JMPF/JMPT r  ->  JMP, or nothing when the branch is never taken
+static bool foldConstantBranch(Optimizer* o, int i) {
+    Value v;
+    if (!loadedValue(o->chunk, o->code[i].inst, &v) || !canJoin(o, i + 1)) return false;
+    uint32_t next = o->code[i + 1].inst;
+    uint8_t op = DECODE_OP(next);
+    int r = DECODE_A(o->code[i].inst);
+    if ((op != OP_JMPF && op != OP_JMPT) || (int)DECODE_A(next) != r || !deadAfter(o, i + 1, r)) return false;
+
+    if (isConstantTruthy(v) == (op == OP_JMPT)) {
+        setInsn(o, i, ENCODE_sBx(OP_JMP, 0), o->code[i + 1].target);
+    } else {
+        killInsn(o, i);
+    }
+    killInsn(o, i + 1);
+    return true;
+}
+
+// CMP rT, rB, rC; JMPF/JMPT rT  ->  compare-and-branch on rB, rC
+static bool fuseCompareJump(Optimizer* o, int i) {
+    uint32_t cmp = o->code[i].inst;
+    uint8_t op = DECODE_OP(cmp);
+    if (op < OP_LT || op > OP_NE || !canJoin(o, i + 1)) return false;
+    uint32_t next = o->code[i + 1].inst;
+    uint8_t jmp = DECODE_OP(next);
+    int rT = DECODE_A(cmp);
+    if ((jmp != OP_JMPF && jmp != OP_JMPT) || (int)DECODE_A(next) != rT || !deadAfter(o, i + 1, rT)) return false;
+
+    int k = jmp == OP_JMPT;
+    int b = DECODE_B(cmp), c = DECODE_C(cmp);
+    uint8_t fused;
+    switch (op) {
+        case OP_LT: fused = OP_LTJMP; break;
+        case OP_LE: fused = OP_LEJMP; break;
+        case OP_GT: fused = OP_LTJMP; b = DECODE_C(cmp); c = DECODE_B(cmp); break;
+        case OP_GE: fused = OP_LEJMP; b = DECODE_C(cmp); c = DECODE_B(cmp); break;
+        case OP_EQ: fused = OP_EQJMP; break;
+        default:    fused = OP_EQJMP; k = !k; break;    // OP_NE
+    }
+    setInsn(o, i, ENCODE_ABC(fused, k, b, c), o->code[i + 1].target);
+    killInsn(o, i + 1);
+    return true;
+}
+
+// LOADx rK; xxJMP with rK as one operand  ->  xxJMPK on the other
+static bool fuseCompareConstant(Optimizer* o, int i) {
+    uint32_t load = o->code[i].inst;
+    uint8_t loadOp = DECODE_OP(load);
+    if ((loadOp != OP_LOADI && loadOp != OP_LOADK) || !canJoin(o, i + 1)) return false;
+    uint32_t next = o->code[i + 1].inst;
+    uint8_t op = DECODE_OP(next);
+    if (op != OP_LTJMP && op != OP_LEJMP && op != OP_EQJMP) return false;
+
+    int rK = DECODE_A(load), b = DECODE_B(next), c = DECODE_C(next);
+    if (!deadAfter(o, i + 1, rK) || (b == rK) == (c == rK)) return false;
+
+    // A constant on the left flips the comparison: K < R  is  R > K
+    uint8_t fused;
+    int reg = c == rK ? b : c;
+    if (op == OP_EQJMP) fused = OP_EQJMPK;
+    else if (op == OP_LTJMP) fused = c == rK ? OP_LTJMPK : OP_GTJMPK;
+    else fused = c == rK ? OP_LEJMPK : OP_GEJMPK;
+
+    int k = loadOp == OP_LOADK ? (int)DECODE_Bx(load)
+                               : constantIndex(o->chunk, INT_VAL(DECODE_sBx(load)), UINT8_MAX);
+    if (k < 0 || k > UINT8_MAX) return false;
+
+    killInsn(o, i);
+    setInsn(o, i + 1, ENCODE_ABC(fused, DECODE_A(next), reg, k), o->code[i + 1].target);
+    return true;
+}
+
+// LOADI rC, n; GETIDX rA, rB, rC  ->  GETIDXI rA, rB, n   (0 <= n <= 255)
+static bool fuseIndexImmediate(Optimizer* o, int i) {
+    uint32_t load = o->code[i].inst;
+    if (DECODE_OP(load) != OP_LOADI || !canJoin(o, i + 1)) return false;
+    int n = DECODE_sBx(load), rC = DECODE_A(load);
+    uint32_t next = o->code[i + 1].inst;
+    if (n < 0 || n > UINT8_MAX || DECODE_OP(next) != OP_GETIDX) return false;
+    if ((int)DECODE_C(next) != rC || (int)DECODE_B(next) == rC) return false;
+    if ((int)DECODE_A(next) != rC && !deadAfter(o, i + 1, rC)) return false;
+
+    killInsn(o, i);
+    setInsn(o, i + 1, ENCODE_ABC(OP_GETIDXI, DECODE_A(next), DECODE_B(next), n), -1);
+    return true;
+}
+
+// LOADI rC, n; ADD/SUB rA, rA, rC  ->  ADDI/SUBI rA, n
+static bool fuseAddImmediate(Optimizer* o, int i) {
+    uint32_t load = o->code[i].inst;
+    if (DECODE_OP(load) != OP_LOADI || !canJoin(o, i + 1)) return false;
+    int rC = DECODE_A(load);
+    uint32_t next = o->code[i + 1].inst;
+    uint8_t op = DECODE_OP(next);
+    int a = DECODE_A(next);
+    if ((op != OP_ADD && op != OP_SUB) || (int)DECODE_B(next) != a || (int)DECODE_C(next) != rC) return false;
+    if (a == rC || !deadAfter(o, i + 1, rC)) return false;
+
+    killInsn(o, i);
+    setInsn(o, i + 1, ENCODE_AsBx(op == OP_ADD ? OP_ADDI : OP_SUBI, a, DECODE_sBx(load)), -1);
+    return true;
+}
+
+// MOVE rT, rS; OP ...rT...  ->  OP ...rS...   (the MOVE then dies)
+static bool propagateCopy(Optimizer* o, int i) {
+    uint32_t move = o->code[i].inst;
+    if (DECODE_OP(move) != OP_MOVE || !canJoin(o, i + 1)) return false;
+    int rT = DECODE_A(move), rS = DECODE_B(move);
+    uint32_t next = o->code[i + 1].inst;
+    int fields = readFields(DECODE_OP(next));
+
+    uint32_t renamed = next;
+    if ((fields & FIELD_A) && (int)DECODE_A(next) == rT) renamed = withA(renamed, rS);
+    if ((fields & FIELD_B) && (int)DECODE_B(next) == rT) renamed = (renamed & ~0x0000FF00u) | ((uint32_t)rS << 8);
+    if ((fields & FIELD_C) && (int)DECODE_C(next) == rT) renamed = (renamed & ~0x000000FFu) | (uint32_t)rS;
+    if (renamed == next) return false;
+
+    RegSet use, def;
+    regEffects(next, &use, &def);
+    if (!deadAfter(o, i + 1, rT) && !regHas(&def, rT)) return false;
+
+    setInsn(o, i + 1, renamed, o->code[i + 1].target);
+    o->code[i].touched = true;
+    return true;
+}
+
+// X rT, ...; MOVE rD, rT  ->  X rD, ...
+static bool coalesceMove(Optimizer* o, int i) {
+    uint32_t inst = o->code[i].inst;
+    if (!writesOnlyA(DECODE_OP(inst)) || !canJoin(o, i + 1)) return false;
+    uint32_t move = o->code[i + 1].inst;
+    int rT = DECODE_A(inst), rD = DECODE_A(move);
+    if (DECODE_OP(move) != OP_MOVE || (int)DECODE_B(move) != rT || rD == rT) return false;
+    if (!deadAfter(o, i + 1, rT)) return false;
+
+    setInsn(o, i, withA(inst, rD), -1);
+    killInsn(o, i + 1);
+    return true;
+}
+
+static void peephole(Optimizer* o) {
+    for (int i = 0; i < o->count; i++) {
+        if (o->code[i].touched || o->code[i].pinned) continue;
+        if (removeDeadLoad(o, i) || foldConstants(o, i) || foldConstantBranch(o, i) ||
+            fuseCompareJump(o, i) || fuseCompareConstant(o, i) || fuseIndexImmediate(o, i) ||
+            fuseAddImmediate(o, i) || propagateCopy(o, i)) continue;
+        coalesceMove(o, i);
+    }
+}
+
+void optimizeChunk(BytecodeChunk* chunk) {
+    // Caches are indexed by instruction offset, so only code that never ran
+    if (chunk->codeSize == 0 || chunk->propCaches) return;
+
+    Optimizer o = {0};
+    o.chunk = chunk;
+    if (!decodeChunk(&o)) {
+        free(o.code);
+        return;
+    }
+    o.liveIn = malloc(o.count * sizeof(RegSet));
+    o.liveOut = malloc(o.count * sizeof(RegSet));
+    if (!o.liveIn || !o.liveOut) {
+        fprintf(stderr, "Memory allocation failed for optimizer.\n");
+        exit(1);
+    }
+
+    for (int round = 0; round < OPT_MAX_ROUNDS; round++) {
+        o.changed = false;
+        threadJumps(&o);
+        removeUnreachable(&o);
+        compact(&o);
+
+        markTargets(&o);
+        computeLiveness(&o);
+        peephole(&o);
+        compact(&o);
+        if (!o.changed) break;
+    }
+
+    encodeChunk(&o);
+    free(o.code);
+    free(o.liveIn);
+    free(o.liveOut);
+}
@@ -4,10 +4,24 @@
 #include <time.h>
 #include <pthread.h>
 #include "bytecode/chunk.h"
+#include "runtime/scheduler.h"
 
-// Concurrent GC state
-static pthread_mutex_t gcMutex = PTHREAD_MUTEX_INITIALIZER;
-static volatile int gcConcurrentActive = 0;
+// Set during a minor collection: old objects count as live and are not traced
+
+// Parallel marking: each marker thread traces into its own gray stack and
+// claims objects with an atomic exchange on isMarked
+typedef struct MarkPool MarkPool;
+
+typedef struct GCMarker {
+    VM* vm;
+    MarkPool* pool;
+    Obj** stack;
+    int count;
+    int capacity;
+} GCMarker;
+
+static _Thread_local GCMarker* currentMarker = NULL;
+static void markerPush(GCMarker* marker, Obj* object);
 
 // GC Helpers
 void markObject(VM* vm, Obj* object);
@@ -15,6 +29,7 @@ void markValue(VM* vm, Value value);
 static void markRoots(VM* vm);
 static void traceReferences(VM* vm);
 static size_t sweep(VM* vm, Obj** listHead);
+static void sweepLazily(VM* vm);
 static void garbageCollect(VM* vm) { collectGarbage(vm); } // Wrapper or just rename prototypes
 
 void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t newSize) {
@@ -39,16 +54,41 @@ void* reallocate(VM* vm, void* pointer, size_t oldSize, size_t newSize) {
     return result;
 }
 
+// Memory for a new GC object, from the slab heap. Charged and collected
+// exactly like a growing reallocate().
+void* allocateObjectMemory(VM* vm, size_t size) {
+    vm->bytesAllocated += size;
+#ifdef DEBUG_STRESS_GC
+    garbageCollect(vm);
+#endif
+    if (vm->bytesAllocated > vm->nextGC) {
+        garbageCollect(vm);
+    } else if (vm->sweepPending) {
+        sweepLazily(vm);
+    }
+    return heapAlloc(&vm->heap, size);
+}
+
 void markObject(VM* vm, Obj* object) {
     if (object == NULL) return;
+    if (vm->gcMinorActive && object->generation == GC_GEN_OLD) return;
+
+    GCMarker* marker = currentMarker;
+    if (marker) {
+        if (__atomic_load_n(&object->isMarked, __ATOMIC_RELAXED)) return;
+        if (__atomic_exchange_n(&object->isMarked, true, __ATOMIC_ACQ_REL)) return;
+        markerPush(marker, object);
+        return;
+    }
+
     if (object->isMarked) return;
     
     // Thread Safety: Lock if concurrent GC is active
-    if (gcConcurrentActive) pthread_mutex_lock(&gcMutex);
+    if (vm->gcConcurrentActive) pthread_mutex_lock(&vm->gcMutex);
     
     // Double check after lock
     if (object->isMarked) {
-        if (gcConcurrentActive) pthread_mutex_unlock(&gcMutex);
+        if (vm->gcConcurrentActive) pthread_mutex_unlock(&vm->gcMutex);
         return;
     }
     
@@ -62,7 +102,7 @@ void markObject(VM* vm, Obj* object) {
     
     vm->grayStack[vm->grayCount++] = object;
     
-    if (gcConcurrentActive) pthread_mutex_unlock(&gcMutex);
+    if (vm->gcConcurrentActive) pthread_mutex_unlock(&vm->gcMutex);
 }
 
 // Re-gray a potentially black object (for Write Barrier)
@@ -70,7 +110,7 @@ void grayObject(VM* vm, Obj* object) {
     if (object == NULL) return;
     
     // Thread Safety
-    if (gcConcurrentActive) pthread_mutex_lock(&gcMutex);
+    if (vm->gcConcurrentActive) pthread_mutex_lock(&vm->gcMutex);
     
     // Force push to gray stack even if already marked
     if (vm->grayCapacity < vm->grayCount + 1) {
@@ -81,7 +121,7 @@ void grayObject(VM* vm, Obj* object) {
     
     vm->grayStack[vm->grayCount++] = object;
     
-    if (gcConcurrentActive) pthread_mutex_unlock(&gcMutex);
+    if (vm->gcConcurrentActive) pthread_mutex_unlock(&vm->gcMutex);
 }
 
 // ... (markValue, etc same)
@@ -101,6 +141,8 @@ static void markArray(VM* vm, Array* array) {
 static void blackenObject(VM* vm, Obj* object) {
     switch (object->type) {
         case OBJ_STRING:
+        case OBJ_STRING_BUILDER:
+        case OBJ_TYPED_ARRAY:
         case OBJ_NATIVE:
         case OBJ_RESOURCE:
             break;
@@ -108,6 +150,10 @@ static void blackenObject(VM* vm, Obj* object) {
         case OBJ_UPVALUE:
             // markValue(vm, ((ObjUpvalue*)object)->closed);
             break;
+
+        case OBJ_STRING_SLICE:
+            markObject(vm, (Obj*)((StringSlice*)object)->parent);
+            break;
             
         case OBJ_FUNCTION: {
             Function* function = (Function*)object;
@@ -135,6 +181,11 @@ static void blackenObject(VM* vm, Obj* object) {
                 for (int i = 0; i < chunk->constantCount; i++) {
                     markValue(vm, chunk->constants[i]);
                 }
+                if (chunk->propCaches) {
+                    for (int i = 0; i < chunk->codeSize; i++) {
+                        markObject(vm, chunk->propCaches[i].shape);
+                    }
+                }
             }
             break;
         }
@@ -147,12 +198,8 @@ static void blackenObject(VM* vm, Obj* object) {
         
         case OBJ_MAP: {
             Map* map = (Map*)object;
-            for (int i = 0; i < TABLE_SIZE; i++) {
-                MapEntry* entry = map->buckets[i];
-                while (entry) {
-                    markValue(vm, entry->value);
-                    entry = entry->next;
-                }
+            for (int i = 0; i < map->count; i++) {
+                markValue(vm, map->entries[i].value);
             }
             break;
         }
@@ -162,24 +209,12 @@ static void blackenObject(VM* vm, Obj* object) {
             // Mark parent? Yes if it's reachable.
             markObject(vm, (Obj*)env->enclosing);
             
-            // Mark values and key strings in buckets
-            for (int i = 0; i < TABLE_SIZE; i++) {
-                VarEntry* entry = env->buckets[i];
-                while (entry) {
-                    markValue(vm, entry->value);
-                    // CRITICAL: Mark the key string to prevent pruning
-                    if (entry->keyString) markObject(vm, (Obj*)entry->keyString);
-                    entry = entry->next;
-                }
-                
-                // Functions in env
-                FuncEntry* funcEntry = env->funcBuckets[i];
-                while (funcEntry) {
-                    if (funcEntry->function) markObject(vm, (Obj*)funcEntry->function);
-                    // CRITICAL: Mark the key string to prevent pruning
-                    if (funcEntry->keyString) markObject(vm, (Obj*)funcEntry->keyString);
-                    funcEntry = funcEntry->next;
-                }
+            // Mark values (functions included) and key strings
+            for (int i = 0; i < env->count; i++) {
+                VarEntry* entry = &env->vars[i];
+                markValue(vm, entry->value);
+                // CRITICAL: Mark the key string to prevent pruning
+                if (entry->keyString) markObject(vm, (Obj*)entry->keyString);
             }
             break;
         }
@@ -198,53 +233,223 @@ static void blackenObject(VM* vm, Obj* object) {
         case OBJ_STRUCT_INSTANCE: {
             StructInstance* inst = (StructInstance*)object;
             markObject(vm, (Obj*)inst->def);
-            if (inst->fields) {
-                for (int i = 0; i < inst->def->fieldCount; i++) {
-                    markValue(vm, inst->fields[i]);
-                }
+            for (int i = 0; i < inst->fieldCount; i++) {
+                markValue(vm, inst->fields[i]);
             }
             break;
         }
 
+        case OBJ_FUTURE: {
+            markValue(vm, ((Future*)object)->result);
+            break;
+        }
+
         default: break;
     }
 }
 
-static void markRoots(VM* vm) {
+// Mark one coroutine's live registers and call frames
+void markExecState(VM* vm, Value* registers, int regBase, int regTop,
+                   CallFrame* callStack, int callStackTop) {
     // Mark current active register window
-    if (vm->regTop > vm->regBase) {
-        for (int i = vm->regBase; i < vm->regTop; i++) {
-            markValue(vm, vm->registers[i]);
+    if (regTop > regBase) {
+        for (int i = regBase; i < regTop; i++) {
+            markValue(vm, registers[i]);
         }
     }
 
     // Mark all suspended caller frames' registers
-    for (int i = 0; i < vm->callStackTop; i++) {
-        CallFrame* frame = &vm->callStack[i];
+    for (int i = 0; i < callStackTop; i++) {
+        CallFrame* frame = &callStack[i];
         if (frame->chunk) {
             int end = frame->regBase + frame->chunk->maxRegs + 1;
             for (int r = frame->regBase; r < end; r++) {
-                markValue(vm, vm->registers[r]);
+                markValue(vm, registers[r]);
+            }
+        } else if (frame->regTop > frame->regBase) {
+            // Native re-entry frame: caller's window is [regBase, regTop)
+            for (int r = frame->regBase; r < frame->regTop; r++) {
+                markValue(vm, registers[r]);
             }
         }
     }
 
+    // Mark Call Frames and their environments
+    for (int i = 0; i < callStackTop; i++) {
+        markObject(vm, (Obj*)callStack[i].env);
+        if (callStack[i].function) markObject(vm, (Obj*)callStack[i].function);
+        markObject(vm, (Obj*)callStack[i].prevGlobalEnv);
+    }
+}
+
+static void markRoots(VM* vm) {
+    // Running coroutine, then every coroutine suspended while it runs
+    markExecState(vm, vm->registers, vm->regBase, vm->regTop, vm->callStack, vm->callStackTop);
+    for (ExecState* e = vm->suspendedExec; e; e = e->prev) {
+        markExecState(vm, e->registers, e->regBase, e->regTop, e->callStack, e->callStackTop);
+        markObject(vm, (Obj*)e->globalEnv);
+    }
+    markTasks(vm);
+
     // Mark legacy stack (AST walker compatibility)
     for (Value* slot = vm->stack; slot < vm->stack + vm->stackTop; slot++) {
         markValue(vm, *slot);
     }
-
-    // Mark Call Frames and their environments
-    for (int i = 0; i < vm->callStackTop; i++) {
-        markObject(vm, (Obj*)vm->callStack[i].env);
-        if (vm->callStack[i].function) markObject(vm, (Obj*)vm->callStack[i].function);
-    }
     
     // Mark Global Environment
     markObject(vm, (Obj*)vm->globalEnv);
     markObject(vm, (Obj*)vm->defEnv);
 
-    // Mark Global Handles (if any)
+    // Mark Global Handles (natives holding VM objects across calls)
+    for (int i = 0; i < vm->pinnedCount; i++) {
+        markObject(vm, vm->pinned[i]);
+    }
+}
+
+void pinObject(VM* vm, Obj* object) {
+    if (object == NULL) return;
+    for (int i = 0; i < vm->pinnedCount; i++) {
+        if (vm->pinned[i] == object) return;
+    }
+    retainObject(vm, object);
+}
+
+void retainObject(VM* vm, Obj* object) {
+    if (object == NULL) return;
+    if (vm->pinnedCount >= vm->pinnedCapacity) {
+        vm->pinnedCapacity = vm->pinnedCapacity < 8 ? 8 : vm->pinnedCapacity * 2;
+        vm->pinned = realloc(vm->pinned, sizeof(Obj*) * vm->pinnedCapacity);
+        if (vm->pinned == NULL) exit(1);
+    }
+    vm->pinned[vm->pinnedCount++] = object;
+}
+
+void releaseObject(VM* vm, Obj* object) {
+    for (int i = vm->pinnedCount - 1; i >= 0; i--) {
+        if (vm->pinned[i] == object) {
+            vm->pinned[i] = vm->pinned[--vm->pinnedCount];
+            return;
+        }
+    }
+}
+
+void deferCollections(VM* vm) {
+    if (vm->gcDeferDepth++ > 0) return;
+    // Run an overdue collection first: a caller that allocates only while
+    // deferred (e.g. a loop over a streaming reader) would otherwise never
+    // collect
+    if (vm->bytesAllocated > vm->nextGC) garbageCollect(vm);
+    vm->gcDeferredNextGC = vm->nextGC;
+    vm->nextGC = SIZE_MAX;
+}
+
+void resumeCollections(VM* vm) {
+    if (--vm->gcDeferDepth == 0) vm->nextGC = vm->gcDeferredNextGC;
+}
+
+void rememberObject(VM* vm, Obj* object) {
+    if (object->isRemembered) return;
+    if (vm->rememberedCount >= vm->rememberedCapacity) {
+        vm->rememberedCapacity = GROW_CAPACITY(vm->rememberedCapacity);
+        vm->remembered = (Obj**)realloc(vm->remembered, sizeof(Obj*) * vm->rememberedCapacity);
+        if (vm->remembered == NULL) exit(1);
+    }
+    object->isRemembered = true;
+    vm->remembered[vm->rememberedCount++] = object;
+}
+
+static bool isYoung(Obj* object) {
+    return object != NULL && object->generation != GC_GEN_OLD;
+}
+
+static bool isYoungValue(Value value) {
+    return IS_OBJ(value) && isYoung(AS_OBJ(value));
+}
+
+// Does 'object' still reference anything in the nursery?
+static bool hasYoungChild(Obj* object) {
+    switch (object->type) {
+        case OBJ_FUNCTION: {
+            Function* function = (Function*)object;
+            if (isYoung((Obj*)function->closure)) return true;
+            if (function->bytecodeChunk) {
+                BytecodeChunk* chunk = function->bytecodeChunk;
+                for (int i = 0; i < chunk->constantCount; i++) {
+                    if (isYoungValue(chunk->constants[i])) return true;
+                }
+                if (chunk->propCaches) {
+                    for (int i = 0; i < chunk->codeSize; i++) {
+                        if (isYoung(chunk->propCaches[i].shape)) return true;
+                    }
+                }
+            }
+            return false;
+        }
+        case OBJ_ARRAY: {
+            Array* array = (Array*)object;
+            for (int i = 0; i < array->count; i++) {
+                if (isYoungValue(array->items[i])) return true;
+            }
+            return false;
+        }
+        case OBJ_MAP: {
+            Map* map = (Map*)object;
+            for (int i = 0; i < map->count; i++) {
+                if (isYoungValue(map->entries[i].value)) return true;
+            }
+            return false;
+        }
+        case OBJ_ENVIRONMENT: {
+            Environment* env = (Environment*)object;
+            if (isYoung((Obj*)env->enclosing)) return true;
+            for (int i = 0; i < env->count; i++) {
+                if (isYoungValue(env->vars[i].value) || isYoung((Obj*)env->vars[i].keyString)) return true;
+            }
+            return false;
+        }
+        case OBJ_MODULE:
+            return isYoung((Obj*)((Module*)object)->env);
+        case OBJ_STRUCT_INSTANCE: {
+            StructInstance* inst = (StructInstance*)object;
+            if (isYoung((Obj*)inst->def)) return true;
+            for (int i = 0; i < inst->fieldCount; i++) {
+                if (isYoungValue(inst->fields[i])) return true;
+            }
+            return false;
+        }
+        case OBJ_FUTURE:
+            return isYoungValue(((Future*)object)->result);
+        case OBJ_STRING_SLICE:
+            return isYoung((Obj*)((StringSlice*)object)->parent);
+        default:
+            return false;
+    }
+}
+
+// Whether an old object must stay in the remembered set. Bytecode functions
+// always stay: the compiler and inline caches write into their chunks
+// without a barrier.
+static bool needsRemembering(Obj* object) {
+    if (object->type == OBJ_FUNCTION && ((Function*)object)->bytecodeChunk) return true;
+    return hasYoungChild(object);
+}
+
+// After a sweep: keep only remembered objects that still point into the
+// nursery, and add newly promoted objects that do
+static void rebuildRememberedSet(VM* vm, Obj** promoted, int promotedCount) {
+    int live = 0;
+    for (int i = 0; i < vm->rememberedCount; i++) {
+        Obj* object = vm->remembered[i];
+        if (needsRemembering(object)) {
+            vm->remembered[live++] = object;
+        } else {
+            object->isRemembered = false;
+        }
+    }
+    vm->rememberedCount = live;
+    for (int i = 0; i < promotedCount; i++) {
+        if (needsRemembering(promoted[i])) rememberObject(vm, promoted[i]);
+    }
 }
 
 static void traceReferences(VM* vm) {
@@ -266,33 +471,191 @@ static int traceReferencesIncremental(VM* vm, int workUnits) {
     return vm->grayCount;
 }
 
+// ---- Parallel marking ----
+// Markers share work through packets: a marker with a deep stack hands the
+// top GC_MARK_PACKET entries to the pool whenever another marker is idle.
+// Marking ends when every marker is idle and the pool is empty.
+
+#define GC_MARK_PACKET 128
+#define GC_PARALLEL_MARK_MIN (16 * 1024 * 1024) // Smaller heaps mark faster on one thread
+
+typedef struct MarkPacket {
+    struct MarkPacket* next;
+    int count;
+    Obj* items[GC_MARK_PACKET];
+} MarkPacket;
+
+struct MarkPool {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    MarkPacket* packets;
+    int idle;       // Markers waiting for a packet
+    int markers;
+    bool done;
+};
+
+static void markerPush(GCMarker* marker, Obj* object) {
+    if (marker->count >= marker->capacity) {
+        marker->capacity = GROW_CAPACITY(marker->capacity);
+        marker->stack = (Obj**)realloc(marker->stack, sizeof(Obj*) * marker->capacity);
+        if (marker->stack == NULL) exit(1);
+    }
+    marker->stack[marker->count++] = object;
+}
+
+static void publishPacket(MarkPool* pool, MarkPacket* packet) {
+    pthread_mutex_lock(&pool->lock);
+    packet->next = pool->packets;
+    pool->packets = packet;
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void sharePacket(GCMarker* marker) {
+    MarkPacket* packet = malloc(sizeof(MarkPacket));
+    if (packet == NULL) return; // Keep the work local
+    marker->count -= GC_MARK_PACKET;
+    memcpy(packet->items, marker->stack + marker->count, sizeof(Obj*) * GC_MARK_PACKET);
+    packet->count = GC_MARK_PACKET;
+    publishPacket(marker->pool, packet);
+}
+
+// Wait for shared work; false once marking has finished everywhere
+static bool takePacket(GCMarker* marker) {
+    MarkPool* pool = marker->pool;
+    MarkPacket* packet = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->idle++;
+    while (pool->packets == NULL && !pool->done) {
+        if (pool->idle == pool->markers) {
+            pool->done = true;
+            pthread_cond_broadcast(&pool->ready);
+            break;
+        }
+        pthread_cond_wait(&pool->ready, &pool->lock);
+    }
+    if (pool->packets) {
+        packet = pool->packets;
+        pool->packets = packet->next;
+        pool->idle--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (packet == NULL) return false;
+    for (int i = 0; i < packet->count; i++) markerPush(marker, packet->items[i]);
+    free(packet);
+    return true;
+}
+
+static void runMarker(GCMarker* marker) {
+    currentMarker = marker;
+    do {
+        while (marker->count > 0) {
+            Obj* object = marker->stack[--marker->count];
+            blackenObject(marker->vm, object);
+            if (marker->count >= 2 * GC_MARK_PACKET &&
+                __atomic_load_n(&marker->pool->idle, __ATOMIC_RELAXED) > 0) {
+                sharePacket(marker);
+            }
+        }
+    } while (takePacket(marker));
+    currentMarker = NULL;
+}
+
+static void* markerThread(void* arg) {
+    runMarker((GCMarker*)arg);
+    return NULL;
+}
+
+// Trace everything reachable from 'seeds' using 'threads' markers (the
+// calling thread is one of them)
+static void traceParallel(VM* vm, Obj** seeds, int seedCount, int threads) {
+    MarkPool pool;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pool.packets = NULL;
+    pool.idle = 0;
+    pool.markers = threads;
+    pool.done = false;
+
+    // Seed the pool with the roots
+    while (seedCount > 0) {
+        MarkPacket* packet = malloc(sizeof(MarkPacket));
+        if (packet == NULL) exit(1);
+        int n = seedCount < GC_MARK_PACKET ? seedCount : GC_MARK_PACKET;
+        seedCount -= n;
+        memcpy(packet->items, seeds + seedCount, sizeof(Obj*) * n);
+        packet->count = n;
+        packet->next = pool.packets;
+        pool.packets = packet;
+    }
+
+    GCMarker markers[GC_MAX_MARK_THREADS];
+    pthread_t tids[GC_MAX_MARK_THREADS];
+    bool started[GC_MAX_MARK_THREADS];
+    for (int i = 0; i < threads; i++) {
+        markers[i] = (GCMarker){vm, &pool, NULL, 0, 0};
+        started[i] = false;
+    }
+    for (int i = 1; i < threads; i++) {
+        started[i] = pthread_create(&tids[i], NULL, markerThread, &markers[i]) == 0;
+        if (!started[i]) {
+            // Fewer helpers: the pool must not wait for a marker that never runs
+            pthread_mutex_lock(&pool.lock);
+            pool.markers--;
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+    runMarker(&markers[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) pthread_join(tids[i], NULL);
+    }
+    for (int i = 0; i < threads; i++) free(markers[i].stack);
+
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+}
+
+// Full-heap trace: parallel when the heap is big enough to benefit
+static void traceMajor(VM* vm) {
+    if (vm->gcMarkThreads > 1 && vm->bytesAllocated >= GC_PARALLEL_MARK_MIN) {
+        traceParallel(vm, vm->grayStack, vm->grayCount, vm->gcMarkThreads);
+        vm->grayCount = 0;
+    } else {
+        traceReferences(vm);
+    }
+}
+
 void freeObject(VM* vm, Obj* object) {
-    (void)vm;
     switch (object->type) {
         case OBJ_STRING: {
             ObjString* string = (ObjString*)object;
-            free(string->chars);
-            free(object);
+            heapFree(&vm->heap, object, sizeof(ObjString) + string->length + 1);
             break;
         }
         case OBJ_ARRAY: {
             Array* array = (Array*)object;
-            free(array->items);
-            free(object);
+            if (!array->share) {
+                free(array->items);
+            } else if (--array->share->refs == 0) {
+                free(array->share->items);
+                free(array->share);
+            }
+            heapFree(&vm->heap, object, sizeof(Array));
             break;
         }
+        case OBJ_STRING_SLICE:
+            heapFree(&vm->heap, object, sizeof(StringSlice));
+            break;
         case OBJ_MAP: {
             Map* map = (Map*)object;
-            for (int i = 0; i < TABLE_SIZE; i++) {
-                MapEntry* entry = map->buckets[i];
-                while (entry) {
-                    MapEntry* next = entry->next;
-                    free(entry->key); 
-                    free(entry);
-                    entry = next;
-                }
+            for (int i = 0; i < map->count; i++) {
+                free(map->entries[i].key);
             }
-            free(object);
+            free(map->entries);
+            free(map->index);
+            heapFree(&vm->heap, object, sizeof(Map));
             break;
         }
         case OBJ_FUNCTION: {
@@ -310,20 +673,19 @@ void freeObject(VM* vm, Obj* object) {
                 // params is allocated in parser, typically part of AST
                 // Don't free here as it's part of AST lifecycle
             }
-            free(object);
+            heapFree(&vm->heap, object, sizeof(Function));
             break;
         }
         case OBJ_STRUCT_DEF: {
             StructDef* def = (StructDef*)object;
             for (int i = 0; i < def->fieldCount; i++) free(def->fields[i]);
             free(def->fields);
-            free(def);
+            heapFree(&vm->heap, object, sizeof(StructDef));
             break;
         }
         case OBJ_STRUCT_INSTANCE: {
             StructInstance* inst = (StructInstance*)object;
-            free(inst->fields);
-            free(object);
+            heapFree(&vm->heap, object, sizeof(StructInstance) + sizeof(Value) * (size_t)inst->fieldCount);
             break;
         }
         case OBJ_MODULE: {
@@ -335,56 +697,45 @@ void freeObject(VM* vm, Obj* object) {
             // Leaving Env leak for now significantly safer than double free if alias shared.
             // But we malloc'd it.
             // free(mod->env); // TODO: safe verify
-            free(object);
+            heapFree(&vm->heap, object, sizeof(Module));
+            break;
+        }
+        case OBJ_STRING_BUILDER: {
+            StringBuilder* sb = (StringBuilder*)object;
+            free(sb->chars);
+            heapFree(&vm->heap, object, sizeof(StringBuilder));
+            break;
+        }
+        case OBJ_TYPED_ARRAY: {
+            TypedArray* ta = (TypedArray*)object;
+            free(ta->data);
+            heapFree(&vm->heap, object, sizeof(TypedArray));
             break;
         }
         case OBJ_RESOURCE: {
             ObjResource* res = (ObjResource*)object;
             if (res->cleanup) res->cleanup(res->data);
-            free(object);
+            heapFree(&vm->heap, object, sizeof(ObjResource));
             break;
         }
         case OBJ_FUTURE: {
             Future* f = (Future*)object;
             pthread_mutex_destroy(&f->mu);
             pthread_cond_destroy(&f->cv);
-            free(object);
+            heapFree(&vm->heap, object, sizeof(Future));
             break;
         }
         case OBJ_ENVIRONMENT: {
             Environment* env = (Environment*)object;
-            for (int i = 0; i < TABLE_SIZE; i++) {
-                VarEntry* entry = env->buckets[i];
-                while (entry) {
-                    VarEntry* next = entry->next;
-                    if (entry->key && entry->ownsKey) free(entry->key);
-                    free(entry);
-                    entry = next;
-                }
-                
-                FuncEntry* fEntry = env->funcBuckets[i];
-                while (fEntry) {
-                    FuncEntry* next = fEntry->next;
-                    // fEntry->key is assumed interned or managed?
-                    // According to vm.c registerNativeFunction, key is internString()->chars.
-                    // But FuncEntry allocation in findFuncEntry uses interned key.
-                    // However, we should check ownsKey equivalents or if we dup'd it.
-                    // In findModuleEntry we have issues.
-                    // Generally functions use interned keys.
-                    // Just free the entry struct.
-                    if (fEntry->key && fEntry->function && fEntry->function->isNative && !fEntry->function->name.start) {
-                        // Special case? No.
-                    }
-                     free(fEntry); // Keys are usually shared/interned.
-                     fEntry = next;
-                }
-            }
-            free(object);
+            // Keys are interned strings owned by the string pool
+            free(env->vars);
+            free(env->index);
+            heapFree(&vm->heap, object, sizeof(Environment));
             break;
         }
 
         default:
-            free(object);
+            heapFree(&vm->heap, object, sizeof(Obj));
             break;
     }
 }
@@ -392,19 +743,146 @@ void freeObject(VM* vm, Obj* object) {
 // Remove unmarked strings from the pool (must happen before sweep frees them)
 static void pruneStringPool(VM* vm) {
     pthread_mutex_lock(&vm->stringPool.lock);
-    for (int i = 0; i < vm->stringPool.count; i++) {
-        ObjString* str = (ObjString*)vm->stringPool.strings[i];
-        if (!((Obj*)str)->isMarked) {
-            // Remove from pool (swap with last)
-            vm->stringPool.strings[i] = vm->stringPool.strings[vm->stringPool.count - 1];
-            vm->stringPool.hashes[i] = vm->stringPool.hashes[vm->stringPool.count - 1];
-            vm->stringPool.count--;
-            i--; // Retry this index with swapped element
+    StringPool* pool = &vm->stringPool;
+    for (int i = 0; i < pool->capacity; i++) {
+        ObjString* str = pool->entries[i];
+        if (str == NULL || str == STRING_POOL_TOMBSTONE) continue;
+        if (!((Obj*)str)->isMarked && !((Obj*)str)->isPermanent) {
+            // Leave a tombstone so probe chains through this slot stay intact
+            pool->entries[i] = STRING_POOL_TOMBSTONE;
+            pool->count--;
+            pool->tombstones++;
         }
     }
     pthread_mutex_unlock(&vm->stringPool.lock);
 }
 
+// Drop one dead string from the pool (minor collections; caller holds the lock)
+static void unpoolString(VM* vm, ObjString* str) {
+    StringPool* pool = &vm->stringPool;
+    unsigned int mask = (unsigned int)pool->capacity - 1;
+    for (unsigned int i = str->hash & mask; pool->entries[i] != NULL; i = (i + 1) & mask) {
+        if (pool->entries[i] == str) {
+            pool->entries[i] = STRING_POOL_TOMBSTONE;
+            pool->count--;
+            pool->tombstones++;
+            return;
+        }
+    }
+}
+
+// Estimate an object's footprint (what its allocation charged to bytesAllocated)
+static size_t objectSize(Obj* object) {
+    switch (object->type) {
+        case OBJ_STRING: return sizeof(ObjString) + ((ObjString*)object)->length + 1;
+        case OBJ_ARRAY: {
+            // A shared buffer is counted with the last array that releases it
+            Array* array = (Array*)object;
+            if (array->share) return sizeof(Array) + (array->share->refs == 1 ? array->share->bytes : 0);
+            return sizeof(Array) + array->capacity * sizeof(Value);
+        }
+        case OBJ_STRING_SLICE: return sizeof(StringSlice);
+        case OBJ_MAP: {
+            Map* m = (Map*)object;
+            return sizeof(Map) + m->capacity * sizeof(MapEntry) + m->indexCapacity * sizeof(int);
+        }
+        case OBJ_FUNCTION: return sizeof(Function);
+        case OBJ_STRUCT_INSTANCE:
+            return sizeof(StructInstance) + sizeof(Value) * (size_t)((StructInstance*)object)->fieldCount;
+        case OBJ_STRING_BUILDER: return sizeof(StringBuilder) + ((StringBuilder*)object)->capacity;
+        case OBJ_TYPED_ARRAY: {
+            TypedArray* ta = (TypedArray*)object;
+            return sizeof(TypedArray) + (size_t)ta->count * typedElementSize(ta->kind);
+        }
+        case OBJ_ENVIRONMENT: {
+            Environment* env = (Environment*)object;
+            return sizeof(Environment) + env->capacity * sizeof(VarEntry) + env->indexCapacity * sizeof(int);
+        }
+        default: return sizeof(Obj);
+    }
+}
+
+// Drop stale marks in the nursery (objects allocated black by a concurrent
+// cycle, permanent objects created pre-marked) so a new mark phase starts
+// from a clean slate and traces them
+static void clearNurseryMarks(VM* vm) {
+    for (Obj* object = vm->nursery; object != NULL; object = object->next) {
+        object->isMarked = false;
+    }
+}
+
+// Minor sweep. Survivors age by one collection and move onto the old list
+// at GC_TENURE_AGE; dead strings leave the intern pool one by one (minor
+// collections skip the full pool prune).
+static size_t sweepNursery(VM* vm) {
+    Obj** promoted = NULL;
+    int promotedCount = 0;
+    int promotedCapacity = 0;
+    size_t freedBytes = 0;
+    int liveCount = 0;
+
+    pthread_mutex_lock(&vm->stringPool.lock);
+    Obj** link = &vm->nursery;
+    while (*link != NULL) {
+        Obj* object = *link;
+        if (object->isPermanent || object->isMarked) {
+            object->isMarked = false;
+            if (++object->generation >= GC_TENURE_AGE) {
+                *link = object->next;
+                object->generation = GC_GEN_OLD;
+                object->next = vm->objects;
+                vm->objects = object;
+                if (promotedCount >= promotedCapacity) {
+                    promotedCapacity = GROW_CAPACITY(promotedCapacity);
+                    promoted = (Obj**)realloc(promoted, sizeof(Obj*) * promotedCapacity);
+                    if (promoted == NULL) exit(1);
+                }
+                promoted[promotedCount++] = object;
+            } else {
+                liveCount++;
+                link = &object->next;
+            }
+        } else {
+            *link = object->next;
+            if (object->type == OBJ_STRING) unpoolString(vm, (ObjString*)object);
+            freedBytes += objectSize(object);
+            freeObject(vm, object);
+        }
+    }
+    pthread_mutex_unlock(&vm->stringPool.lock);
+
+    vm->nurseryCount = liveCount;
+    rebuildRememberedSet(vm, promoted, promotedCount);
+    free(promoted);
+    return freedBytes;
+}
+
+// Move every nursery object onto the old list (the concurrent collector
+// only sweeps vm->objects)
+static void promoteNursery(VM* vm) {
+    while (vm->nursery) {
+        Obj* object = vm->nursery;
+        vm->nursery = object->next;
+        object->generation = GC_GEN_OLD;
+        object->next = vm->objects;
+        vm->objects = object;
+        if (needsRemembering(object)) rememberObject(vm, object);
+    }
+    vm->nurseryCount = 0;
+}
+
+// Before a full sweep: forget remembered objects that are about to be freed
+static void pruneRememberedSet(VM* vm) {
+    int live = 0;
+    for (int i = 0; i < vm->rememberedCount; i++) {
+        Obj* object = vm->remembered[i];
+        if (object->isMarked || object->isPermanent) {
+            vm->remembered[live++] = object;
+        }
+    }
+    vm->rememberedCount = live;
+}
+
 static size_t sweep(VM* vm, Obj** listHead) {
     Obj* previous = NULL;
     Obj* object = *listHead;
@@ -412,11 +890,10 @@ static size_t sweep(VM* vm, Obj** listHead) {
     size_t freedBytes = 0;
     
     while (object != NULL) {
-        // Permanent objects are always considered marked and their mark is never reset
+        // Permanent objects are never freed, but are still traced each cycle
+        // (their children are only kept alive through them)
         if (object->isPermanent || object->isMarked) {
-            if (!object->isPermanent) {
-                object->isMarked = false;
-            }
+            object->isMarked = false;
             previous = object;
             object = object->next;
         } else {
@@ -425,20 +902,10 @@ static size_t sweep(VM* vm, Obj** listHead) {
             if (previous != NULL) {
                 previous->next = object;
             } else {
-                vm->objects = object;
+                *listHead = object;
             }
             
-            // Estimate freed bytes (rough estimation based on object type)
-            size_t objSize = sizeof(Obj);
-            switch (unreached->type) {
-                case OBJ_STRING: objSize = sizeof(ObjString) + ((ObjString*)unreached)->length; break;
-                case OBJ_ARRAY: objSize = sizeof(Array) + ((Array*)unreached)->capacity * sizeof(Value); break;
-                case OBJ_MAP: objSize = sizeof(Map); break;
-                case OBJ_FUNCTION: objSize = sizeof(Function); break;
-                case OBJ_ENVIRONMENT: objSize = sizeof(Environment); break;
-                default: objSize = sizeof(Obj); break;
-            }
-            freedBytes += objSize;
+            freedBytes += objectSize(unreached);
             freedCount++;
             
             freeObject(vm, unreached);
@@ -448,6 +915,41 @@ static size_t sweep(VM* vm, Obj** listHead) {
     return freedBytes;
 }
 
+// Full-collection threshold bounds: at least 32KB, and at most 4MB (or half
+// the live heap, if larger) of growth past the live heap. The cap is
+// relative so a large live heap (e.g. a big Map) does not force a
+// collection on every allocation; vm->gcMaxHeadroom overrides it.
+#define GC_MIN_THRESHOLD (1024 * 32)
+#define GC_MAX_HEADROOM  (1024 * 1024 * 4)
+
+// Set the next full collection at 'majorThreshold' (clamped). Until the heap
+// reaches it, collections run every nurseryBudget bytes and are minor.
+static void scheduleNextGC(VM* vm, size_t majorThreshold) {
+    size_t headroom = vm->gcMaxHeadroom;
+    if (headroom == 0) {
+        headroom = vm->bytesAllocated / 2;
+        if (headroom < GC_MAX_HEADROOM) headroom = GC_MAX_HEADROOM;
+    }
+    if (majorThreshold < GC_MIN_THRESHOLD) {
+        majorThreshold = GC_MIN_THRESHOLD;
+    }
+    if (majorThreshold > vm->bytesAllocated + headroom) {
+        majorThreshold = vm->bytesAllocated + headroom;
+    }
+    vm->nextMajorGC = majorThreshold;
+    vm->nextGC = vm->bytesAllocated + vm->nurseryBudget;
+    if (vm->nextGC > majorThreshold) vm->nextGC = majorThreshold;
+}
+
+static void creditFreed(VM* vm, size_t freedBytes) {
+    // Sizes are estimates: guard against underflow
+    if (freedBytes > vm->bytesAllocated) {
+        vm->bytesAllocated = 0;
+    } else {
+        vm->bytesAllocated -= freedBytes;
+    }
+}
+
 // Helper: get current time in microseconds
 static uint64_t getCurrentTimeUs(void) {
     struct timespec ts;
@@ -455,74 +957,258 @@ static uint64_t getCurrentTimeUs(void) {
     return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
 }
 
-void collectGarbage(VM* vm) {
-    uint64_t startTime = getCurrentTimeUs();
-    size_t beforeBytes = vm->bytesAllocated;
+// Pause accounting shared by every stop-the-world collection and step
+static void recordPause(VM* vm, uint64_t pauseUs) {
+    static const uint64_t limits[GC_PAUSE_BUCKETS - 1] = GC_PAUSE_BUCKET_LIMITS;
+    int bucket = 0;
+    while (bucket < GC_PAUSE_BUCKETS - 1 && pauseUs >= limits[bucket]) bucket++;
+    vm->gcPauseHistogram[bucket]++;
+    vm->gcTotalPauseUs += pauseUs;
+    vm->gcLastPauseUs = pauseUs;
+    if (pauseUs > vm->gcMaxPauseUs) vm->gcMaxPauseUs = pauseUs;
+}
+
+// Adaptive threshold after a full collection: if we freed a lot (>50% of
+// the heap) we can be more relaxed; if we freed little (<20%), trigger sooner
+static void scheduleAfterMajor(VM* vm, size_t beforeBytes, size_t freedBytes) {
+    double freedRatio = (beforeBytes > 0) ? (double)freedBytes / (double)beforeBytes : 0.0;
+    size_t majorThreshold;
     
-    // Track peak memory
-    if (vm->bytesAllocated > vm->gcPeakMemory) {
-        vm->gcPeakMemory = vm->bytesAllocated;
+    if (freedRatio > 0.5) {
+        // Freed a lot - can wait longer
+        majorThreshold = vm->bytesAllocated * 3;
+    } else if (freedRatio < 0.2) {
+        // Freed little - trigger sooner
+        majorThreshold = vm->bytesAllocated + (vm->bytesAllocated / 2);
+    } else {
+        // Normal doubling
+        majorThreshold = vm->bytesAllocated * 2;
     }
     
-    // Promote nursery to old generation
-    if (vm->nursery) {
-        Obj* tail = vm->nursery;
-        while (tail->next) tail = tail->next;
-        tail->next = vm->objects;
-        vm->objects = vm->nursery;
-        vm->nursery = NULL;
-        vm->nurseryCount = 0;
+    scheduleNextGC(vm, majorThreshold);
+}
+
+// ---- Lazy sweeping ----
+// A major collection detaches the old list into vm->sweepPending instead of
+// sweeping it inside the pause. Allocation then sweeps GC_SWEEP_SLICE
+// objects at a time; survivors go back onto vm->objects. Until the list is
+// drained only minor collections run (their marking never enters old
+// objects, so the stale marks on pending survivors are harmless).
+
+#define GC_SWEEP_SLICE 256
+
+static void sweepPendingSlice(VM* vm, int budget) {
+    size_t freedBytes = 0;
+    Obj* object = vm->sweepPending;
+    while (object != NULL && budget-- > 0) {
+        Obj* next = object->next;
+        if (object->isPermanent || object->isMarked) {
+            object->isMarked = false;
+            object->next = vm->objects;
+            vm->objects = object;
+        } else {
+            freedBytes += objectSize(object);
+            freeObject(vm, object);
+        }
+        object = next;
+    }
+    vm->sweepPending = object;
+
+    creditFreed(vm, freedBytes);
+    vm->sweepFreedBytes += freedBytes;
+    vm->gcTotalFreed += freedBytes;
+    if (vm->sweepPending == NULL) {
+        scheduleAfterMajor(vm, vm->sweepStartBytes, vm->sweepFreedBytes);
+    }
+}
+
+static void sweepLazily(VM* vm) {
+    sweepPendingSlice(vm, GC_SWEEP_SLICE);
+}
+
+// A new mark phase needs every old mark reset first
+static void finishLazySweep(VM* vm) {
+    while (vm->sweepPending) sweepPendingSlice(vm, INT32_MAX);
+}
+
+// Old objects with young children are roots for nursery marking
+static void traceRemembered(VM* vm) {
+    for (int i = 0; i < vm->rememberedCount; i++) {
+        blackenObject(vm, vm->remembered[i]);
+    }
+}
+
+// Minor collection: trace from the roots and the remembered set without
+// entering the old generation, then sweep only the nursery
+static void collectNursery(VM* vm) {
+    uint64_t startTime = getCurrentTimeUs();
+    if (vm->bytesAllocated > vm->gcPeakMemory) {
+        vm->gcPeakMemory = vm->bytesAllocated;
     }
 
-    // Mark phase
+    clearNurseryMarks(vm);
+    vm->gcMinorActive = true;
     vm->gcPhase = 1;  // GC_MARKING
     markRoots(vm);
+    traceRemembered(vm);
     traceReferences(vm);
-    
-    // Sweep phase
-    pruneStringPool(vm);
+    vm->gcMinorActive = false;
+
     vm->gcPhase = 2;  // GC_SWEEPING
-    size_t freedBytes = sweep(vm, &vm->objects);
+    size_t freedBytes = sweepNursery(vm);
     vm->gcPhase = 0;  // GC_IDLE
-    
-    // Decrement bytesAllocated to reflect freed memory
-    if (freedBytes > vm->bytesAllocated) {
-        vm->bytesAllocated = 0;
+    creditFreed(vm, freedBytes);
+
+    vm->gcCollectCount++;
+    vm->gcMinorCount++;
+    vm->gcTotalFreed += freedBytes;
+    recordPause(vm, getCurrentTimeUs() - startTime);
+
+    // Promotions grow the old generation toward nextMajorGC
+    vm->nextGC = vm->bytesAllocated + vm->nurseryBudget;
+}
+
+// End of a major mark: sweep phase. The nursery was marked too, so it is
+// tenured whole and handed to the lazy sweep along with the old list; the
+// pause only relinks it. With no young objects left the remembered set is
+// empty.
+static void finishMajor(VM* vm, size_t beforeBytes) {
+    pruneStringPool(vm);
+    for (int i = 0; i < vm->rememberedCount; i++) {
+        vm->remembered[i]->isRemembered = false;
+    }
+    vm->rememberedCount = 0;
+
+    vm->gcPhase = 2;  // GC_SWEEPING
+    Obj* tail = NULL;
+    for (Obj* object = vm->nursery; object != NULL; object = object->next) {
+        object->generation = GC_GEN_OLD;
+        tail = object;
+    }
+    if (tail) {
+        tail->next = vm->objects;
+        vm->sweepPending = vm->nursery;
     } else {
-        vm->bytesAllocated -= freedBytes;
+        vm->sweepPending = vm->objects;
     }
-    
-    // Update statistics
-    uint64_t pauseTime = getCurrentTimeUs() - startTime;
+    vm->objects = NULL;
+    vm->nursery = NULL;
+    vm->nurseryCount = 0;
+    vm->gcPhase = 0;  // GC_IDLE
+
     vm->gcCollectCount++;
-    vm->gcTotalPauseUs += pauseTime;
-    vm->gcLastPauseUs = pauseTime;
-    vm->gcTotalFreed += freedBytes;
-    
-    // Adaptive threshold: adjust based on heap pressure
-    // If we freed a lot (>50% of heap), we can be more relaxed
-    // If we freed little (<20%), trigger sooner
-    double freedRatio = (beforeBytes > 0) ? (double)freedBytes / (double)beforeBytes : 0.0;
+
+    // Only minor collections until the old list is swept; the threshold is
+    // set once the final freed total is known
+    vm->sweepStartBytes = beforeBytes;
+    vm->sweepFreedBytes = 0;
+    vm->nextMajorGC = SIZE_MAX;
+    vm->nextGC = vm->bytesAllocated + vm->nurseryBudget;
+    if (vm->sweepPending == NULL) {
+        scheduleAfterMajor(vm, beforeBytes, 0);
+    }
+}
+
+// Last step of an incremental mark. The mutator ran between steps:
+// - Every old object it stored into is in the remembered set (the write
+//   barrier adds it once), so tracing the set catches new references out
+//   of old objects an earlier step already scanned.
+// - Natives fill fresh Maps and Arrays without a barrier, so nursery marks
+//   can't be trusted: clear them and retrace the nursery from the roots.
+static void remark(VM* vm) {
+    clearNurseryMarks(vm);
+    markRoots(vm);
+    traceRemembered(vm);
+    traceMajor(vm);
+}
+
+// Stop-the-world major collection (completes an incremental cycle in
+// progress). 'sweepNow' also finishes the old-generation sweep in the pause.
+static void collectMajor(VM* vm, bool sweepNow) {
+    finishLazySweep(vm);
+
+    uint64_t startTime = getCurrentTimeUs();
+    size_t beforeBytes = vm->bytesAllocated;
     
-    if (freedRatio > 0.5) {
-        // Freed a lot - can wait longer
-        vm->nextGC = vm->bytesAllocated * 3;
-    } else if (freedRatio < 0.2) {
-        // Freed little - trigger sooner
-        vm->nextGC = vm->bytesAllocated + (vm->bytesAllocated / 2);
+    // Track peak memory
+    if (vm->bytesAllocated > vm->gcPeakMemory) {
+        vm->gcPeakMemory = vm->bytesAllocated;
+    }
+
+    // Mark phase (both generations)
+    if (vm->gcPhase == 1) {
+        remark(vm);
     } else {
-        // Normal doubling
-        vm->nextGC = vm->bytesAllocated * 2;
+        clearNurseryMarks(vm);
+        vm->gcPhase = 1;  // GC_MARKING
+        markRoots(vm);
+        traceMajor(vm);
     }
-    
-    // Minimum threshold
-    if (vm->nextGC < 1024 * 32) {
-        vm->nextGC = 1024 * 32;  // 32KB minimum
+
+    finishMajor(vm, beforeBytes);
+    if (sweepNow) finishLazySweep(vm);
+
+    recordPause(vm, getCurrentTimeUs() - startTime);
+}
+
+// ---- Pause-budget mode ----
+// With vm->gcTargetPauseUs set, a major cycle runs as incremental steps
+// spaced GC_STEP_SLICE bytes of allocation apart. Each marking step is
+// resized toward the target: doubled while well under it, halved when over.
+
+#define GC_STEP_SLICE     (64 * 1024)
+#define GC_STEP_MIN_UNITS 64
+#define GC_STEP_MAX_UNITS (1 << 20)
+
+static void collectIncrementalStep(VM* vm) {
+    bool marking = vm->gcPhase == 1;
+    uint64_t startTime = getCurrentTimeUs();
+    bool done = collectGarbageIncremental(vm, vm->gcIncrementalUnits);
+    uint64_t pauseTime = getCurrentTimeUs() - startTime;
+    recordPause(vm, pauseTime);
+
+    if (done) return;
+    vm->nextGC = vm->bytesAllocated + GC_STEP_SLICE;
+
+    // Only plain marking steps say how much work fits in the budget
+    if (!marking) return;
+    if (pauseTime > vm->gcTargetPauseUs) {
+        if (vm->gcIncrementalUnits > GC_STEP_MIN_UNITS) vm->gcIncrementalUnits /= 2;
+    } else if (pauseTime < vm->gcTargetPauseUs / 2) {
+        if (vm->gcIncrementalUnits < GC_STEP_MAX_UNITS) vm->gcIncrementalUnits *= 2;
     }
-    // Maximum threshold: cap growth to prevent unbounded heap
-    if (vm->nextGC > 1024 * 1024 * 4) {
-        vm->nextGC = 1024 * 1024 * 4;  // 4MB maximum
+}
+
+void collectGarbage(VM* vm) {
+    // A concurrent cycle owns the heap until its sweep finishes
+    if (isGCActive(vm)) return;
+
+    // Young objects are usually dead by now; only go full once the old
+    // generation has grown past its threshold (or an incremental cycle is
+    // in progress and must be completed)
+    if (vm->gcPhase == 0 && vm->bytesAllocated < vm->nextMajorGC) {
+        collectNursery(vm);
+        return;
     }
+
+    if (vm->gcTargetPauseUs > 0) {
+        collectIncrementalStep(vm);
+        return;
+    }
+
+    collectMajor(vm, false);
+}
+
+// Explicit full collection (ucoreGC.collect): everything unreachable is freed
+// before returning
+void collectGarbageFull(VM* vm) {
+    if (isGCActive(vm)) return;
+    collectMajor(vm, true);
+}
+
+void collectGarbageMinor(VM* vm) {
+    if (isGCActive(vm) || vm->gcPhase != 0) return;
+    collectNursery(vm);
 }
 
 // Incremental GC for long-running processes
@@ -531,12 +1217,16 @@ void collectGarbage(VM* vm) {
 bool collectGarbageIncremental(VM* vm, int workUnits) {
     // Phase 0: Not started - begin marking
     if (vm->gcPhase == 0) {
+        finishLazySweep(vm);
+
         // Track peak memory
         if (vm->bytesAllocated > vm->gcPeakMemory) {
             vm->gcPeakMemory = vm->bytesAllocated;
         }
         
+        clearNurseryMarks(vm);
         vm->gcPhase = 1;  // GC_MARKING
+        vm->sweepStartBytes = vm->bytesAllocated;
         markRoots(vm);
         // Don't trace yet, will do incrementally
         return false;
@@ -545,35 +1235,10 @@ bool collectGarbageIncremental(VM* vm, int workUnits) {
     // Phase 1: Marking in progress
     if (vm->gcPhase == 1) {
         int remaining = traceReferencesIncremental(vm, workUnits);
-        if (remaining == 0) {
-            // Marking complete, start sweep
-            vm->gcPhase = 2;
-        }
-        return false;
-    }
-    
-    // Phase 2: Sweeping
-    if (vm->gcPhase == 2) {
-        pruneStringPool(vm);
-        size_t freedBytes = sweep(vm, &vm->objects);
-        vm->gcPhase = 0;  // GC_IDLE
-        
-        // Decrement bytesAllocated to reflect freed memory
-        if (freedBytes > vm->bytesAllocated) {
-            vm->bytesAllocated = 0;
-        } else {
-            vm->bytesAllocated -= freedBytes;
-        }
-        
-        // Update statistics
-        vm->gcCollectCount++;
-        vm->gcTotalFreed += freedBytes;
-        
-        // Adaptive threshold
-        vm->nextGC = vm->bytesAllocated * 2;
-        if (vm->nextGC < 1024 * 32) vm->nextGC = 1024 * 32;
-        if (vm->nextGC > 1024 * 1024 * 4) vm->nextGC = 1024 * 1024 * 4;
-        
+        if (remaining > 0) return false;
+
+        remark(vm);
+        finishMajor(vm, vm->sweepStartBytes);
         return true;  // Collection complete
     }
     
@@ -583,120 +1248,72 @@ bool collectGarbageIncremental(VM* vm, int workUnits) {
 // Concurrent GC thread worker
 typedef struct {
     VM* vm;
-    int workUnits;
 } ConcurrentGCArgs;
 
 static void* concurrentMarkWorker(void* arg) {
     ConcurrentGCArgs* args = (ConcurrentGCArgs*)arg;
     VM* vm = args->vm;
-    int workUnits = args->workUnits;
+    int threads = vm->gcMarkThreads;
     
-    pthread_mutex_lock(&gcMutex);
-    gcConcurrentActive = 1;
+    pthread_mutex_lock(&vm->gcMutex);
+    vm->gcConcurrentActive = 1;
+    vm->heap.concurrent = 1;
     
-    // Roots already marked by main thread (STW) before spawning
-    // vm->gcPhase = 1;  // Already set
-    
-    // Trace incrementally
+    // Roots already marked by main thread (STW) before spawning.
+    // Markers trace without the lock; the mutator's write barrier may
+    // re-gray objects meanwhile, so drain until the gray stack stays empty.
     while (vm->grayCount > 0) {
-        int batch = (vm->grayCount < workUnits) ? vm->grayCount : workUnits;
-        for (int i = 0; i < batch && vm->grayCount > 0; i++) {
-            Obj* object = vm->grayStack[--vm->grayCount];
-            // blackenObject is called inline here
-            switch (object->type) {
-                case OBJ_FUNCTION: {
-                    Function* func = (Function*)object;
-                    if (func->closure) markObject(vm, (Obj*)func->closure);
-                    if (func->bytecodeChunk) {
-                        for (int j = 0; j < func->bytecodeChunk->constantCount; j++) {
-                            markValue(vm, func->bytecodeChunk->constants[j]);
-                        }
-                    }
-                    break;
-                }
-                case OBJ_ARRAY: {
-                    Array* arr = (Array*)object;
-                    for (int j = 0; j < arr->count; j++) {
-                        markValue(vm, arr->items[j]);
-                    }
-                    break;
-                }
-                case OBJ_MAP: {
-                    Map* m = (Map*)object;
-                    for (int j = 0; j < TABLE_SIZE; j++) {
-                        MapEntry* e = m->buckets[j];
-                        while (e) {
-                            markValue(vm, e->value);
-                            e = e->next;
-                        }
-                    }
-                    break;
-                }
-                case OBJ_ENVIRONMENT: {
-                    Environment* env = (Environment*)object;
-                    if (env->enclosing) markObject(vm, (Obj*)env->enclosing);
-                    for (int j = 0; j < TABLE_SIZE; j++) {
-                        VarEntry* ve = env->buckets[j];
-                        while (ve) { markValue(vm, ve->value); ve = ve->next; }
-                    }
-                    break;
-                }
-                default: break;
-            }
-        }
-        // Brief yield to reduce contention
-        pthread_mutex_unlock(&gcMutex);
-        struct timespec ts = {0, 100000}; // 100 microseconds
-        nanosleep(&ts, NULL);
-        pthread_mutex_lock(&gcMutex);
+        Obj** seeds = vm->grayStack;
+        int seedCount = vm->grayCount;
+        vm->grayStack = NULL;
+        vm->grayCount = 0;
+        vm->grayCapacity = 0;
+        pthread_mutex_unlock(&vm->gcMutex);
+
+        traceParallel(vm, seeds, seedCount, threads);
+        free(seeds);
+
+        pthread_mutex_lock(&vm->gcMutex);
     }
     
     // Sweep (must be exclusive)
     pruneStringPool(vm);
+    pruneRememberedSet(vm);
     vm->gcPhase = 2;
     size_t freedBytes = sweep(vm, &vm->objects);
     vm->gcPhase = 0;
-    
-    if (freedBytes > vm->bytesAllocated) {
-        vm->bytesAllocated = 0; // Guard against underflow due to estimations
-    } else {
-        vm->bytesAllocated -= freedBytes;
-    }
+    creditFreed(vm, freedBytes);
 
     vm->gcCollectCount++;
     vm->gcTotalFreed += freedBytes;
     vm->gcLastCollectTime = getCurrentTimeUs();
     
     // Adaptive threshold
-    vm->nextGC = vm->bytesAllocated * 2;
-    if (vm->nextGC < 1024 * 32) vm->nextGC = 1024 * 32;
-    if (vm->nextGC > 1024 * 1024 * 4) vm->nextGC = 1024 * 1024 * 4;
+    scheduleNextGC(vm, vm->bytesAllocated * 2);
     
-    gcConcurrentActive = 0;
-    pthread_mutex_unlock(&gcMutex);
+    vm->heap.concurrent = 0;
+    vm->gcConcurrentActive = 0;
+    pthread_mutex_unlock(&vm->gcMutex);
     
     free(args);
     return NULL;
 }
 
-// Start concurrent GC in background thread
+// Start concurrent GC in background thread. Marking runs on
+// vm->gcMarkThreads markers until done, so 'workUnits' is unused.
 void collectGarbageConcurrent(VM* vm, int workUnits) {
+    (void)workUnits;
     // Don't start if already running
-    if (gcConcurrentActive) return;
+    if (vm->gcConcurrentActive) return;
     
-    pthread_mutex_lock(&gcMutex);
+    finishLazySweep(vm);
+    pthread_mutex_lock(&vm->gcMutex);
     
     // Snapshot: Promote current nursery to Old Generation (vm->objects)
-    if (vm->nursery) {
-         Obj* tail = vm->nursery;
-         while (tail->next) tail = tail->next;
-         tail->next = vm->objects;
-         vm->objects = vm->nursery;
-         vm->nursery = NULL;
-         vm->nurseryCount = 0;
-    }
+    clearNurseryMarks(vm);
+    promoteNursery(vm);
     
-    pthread_mutex_unlock(&gcMutex);
+    pthread_mutex_unlock(&vm->gcMutex);
     
     // Phase 1: Mark Roots (STW - Main Thread)
     // Must be done HERE, before spawning thread, to ensure stack safety.
@@ -705,7 +1322,6 @@ void collectGarbageConcurrent(VM* vm, int workUnits) {
     
     ConcurrentGCArgs* args = malloc(sizeof(ConcurrentGCArgs));
     args->vm = vm;
-    args->workUnits = workUnits > 0 ? workUnits : 50;
     
     pthread_t thread;
     pthread_attr_t attr;
@@ -717,6 +1333,6 @@ void collectGarbageConcurrent(VM* vm, int workUnits) {
 }
 
 // Check if concurrent GC is active
-bool isGCActive(void) {
-    return gcConcurrentActive != 0;
+bool isGCActive(VM* vm) {
+    return vm->gcConcurrentActive != 0;
 }
@@ -3,21 +3,20 @@
 #include "lexer.h"
 #include "parser.h"
 #include "vm.h"
-#include "ucore_uon.h"
-#include "ucore_http.h"
-#include "ucore_timer.h"
-#include "ucore_system.h"
-#include "ucore_json.h"
-#include "ucore_string.h"
-#include "ucore_scraper.h"
-#include "ucore_tui.h"
 
 #include "bytecode/chunk.h"
+#include "bytecode/cache.h"
 #include "bytecode/compiler.h"
 #include "bytecode/interpreter.h"
+#include "runtime/scheduler.h"
+#include "runtime/isolate.h"
+#include "runtime/profiler.h"
+#include "runtime/fileio.h"
+#include "runtime/imports.h"
 
 const char* g_source = NULL;
 const char* g_filename = NULL;
+_Thread_local jmp_buf* g_errorTrap = NULL;
 
 // Helper to print error line with context
 static void printErrorLine(int line, const char* highlightStart, int highlightLen) {
@@ -68,6 +67,7 @@ static void printErrorLine(int line, const char* highlightStart, int highlightLe
 
 // Generic error
 void error(const char* message, int line) {
+    if (g_errorTrap) longjmp(*g_errorTrap, 1);
     fprintf(stderr, "Error in %s at line %d:\n", g_filename ? g_filename : "<unknown>", line);
     fprintf(stderr, "  %s\n", message);
     printErrorLine(line, NULL, 0);
@@ -76,183 +76,91 @@ void error(const char* message, int line) {
 
 // Error at specific token
 void errorAtToken(Token token, const char* message) {
+    if (g_errorTrap) longjmp(*g_errorTrap, 1);
     fprintf(stderr, "Error in %s at line %d:\n", g_filename ? g_filename : "<unknown>", token.line);
     fprintf(stderr, "  %s\n", message);
     printErrorLine(token.line, token.start, token.length);
     exit(1);
 }
 
-// Read file
-static char* readFile(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (!file) {
+// Load a script (mapped if it is large); the lexer scans it in place
+static void readSource(const char* path, FileBuffer* out) {
+    if (!fileOpen(path, out)) {
         fprintf(stderr, "Could not open file \"%s\".\n", path);
         exit(1);
     }
-
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
-
-    char* buffer = malloc(fileSize + 1);
-    if (!buffer) {
-        fclose(file);
-        fprintf(stderr, "Memory allocation failed.\n");
-        exit(1);
-    }
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    if (bytesRead < fileSize) {
-        free(buffer);
-        fclose(file);
-        fprintf(stderr, "Could not read file \"%s\".\n", path);
-        exit(1);
-    }
-
-    buffer[bytesRead] = '\0';
-    fclose(file);
-    return buffer;
 }
 
-// Initialize parser
-void initParser(Parser* parser) {
-    parser->tokens = malloc(64 * sizeof(Token));  // Start with 64 tokens
-    if (!parser->tokens) {
-        error("Memory allocation failed.", 0);
-    }
-    parser->current = 0;
-    parser->count = 0;
-    parser->capacity = 64;
+// Lex and parse a whole source file. The lexer runs as the parser pulls
+// tokens; the tree lives in the parser's arena until freeParser().
+static Node* parseSource(const char* source, Parser* parser) {
+    initParser(parser, source);
+    Node* ast = parse(parser);
+    printf("Tokenized %d tokens successfully.\n", parser->tokenCount);
+    return ast;
 }
 
-// Free parser resources
-void freeParser(Parser* parser) {
-    if (parser->tokens) {
-        free(parser->tokens);
-        parser->tokens = NULL;
-    }
+// Top-level function owning a script's chunk (roots its constants)
+static Function* newScriptFunction(VM* vm, BytecodeChunk* chunk, const char* path) {
+    Function* script = (Function*)ALLOCATE_OBJ(vm, Function, OBJ_FUNCTION);
+    script->paramCount = 0;
+    script->name.start = "<script>";
+    script->name.length = 8;
+    script->name.line = 0;
+    script->body = NULL;
+    script->closure = NULL;
+    script->isNative = false;
+    script->native = NULL;
+    script->isAsync = false;
+    script->params = NULL;
+    script->moduleEnv = NULL;
+    script->bytecodeChunk = chunk;
+    script->modulePath = path ? strdup(path) : NULL;
+    return script;
 }
 
-// Add token to parser (grows array as needed)
-void addToken(Parser* parser, Token token) {
-    // Grow array if needed
-    if (parser->count >= parser->capacity) {
-        parser->capacity *= 2;
-        parser->tokens = realloc(parser->tokens, parser->capacity * sizeof(Token));
-        if (!parser->tokens) {
-            error("Memory allocation failed.", token.line);
+// --compile: write a .unnac cache next to each source, and each module it
+// imports, without running it. Each file compiles against its own empty
+// global environment; globals are stored by name and resolved when the
+// cache is loaded.
+static int compileFiles(VM* vm, int count, char** paths) {
+    Environment* runEnv = vm->globalEnv;
+    for (int i = 0; i < count; i++) {
+        g_filename = paths[i];
+        FileBuffer source;
+        readSource(paths[i], &source);
+        g_source = source.data;
+
+        Parser parser;
+        Node* ast = parseSource(source.data, &parser);
+
+        vm->globalEnv = newEnvironment(vm, NULL); // Rooted as the global env
+        BytecodeChunk* chunk = malloc(sizeof(BytecodeChunk));
+        initChunk(chunk);
+        Function* script = newScriptFunction(vm, chunk, paths[i]);
+        vm->stack[vm->stackTop++] = OBJ_VAL(script);
+
+        if (!compileToBytecode(vm, ast, chunk, paths[i])) {
+            fprintf(stderr, "Bytecode compilation failed.\n");
+            exit(1);
         }
+        freeParser(&parser);
+        char* cachePath = bytecodeCachePath(paths[i]);
+        if (!writeBytecodeCache(vm, paths[i], source.data, chunk)) {
+            fprintf(stderr, "Could not write \"%s\".\n", cachePath);
+            exit(1);
+        }
+        printf("Compiled %s -> %s\n", paths[i], cachePath);
+        free(cachePath);
+        precompileImports(vm, paths[i], chunk, true); // Their caches too
+
+        vm->stackTop--;
+        vm->globalEnv = runEnv;
+        fileClose(&source);
+        g_source = NULL;
     }
-    
-    parser->tokens[parser->count++] = token;
-}
-
-// Free AST
-static void freeAST(Node* node) {
-    if (!node) return;
-    switch (node->type) {
-        case NODE_EXPR_LITERAL:
-            if (node->literal.token.type == TOKEN_STRING) {
-                // No need to free token.start, it's from source
-            }
-            break;
-        case NODE_EXPR_BINARY:
-            freeAST(node->binary.left);
-            freeAST(node->binary.right);
-            break;
-        case NODE_EXPR_UNARY:
-            freeAST(node->unary.expr);
-            break;
-        case NODE_EXPR_AWAIT:
-            // await <expr> -> free inner expression
-            freeAST(node->unary.expr);
-            break;
-        case NODE_EXPR_VAR:
-            break;
-        case NODE_EXPR_GET:
-            // object.property -> free object
-            freeAST(node->get.object);
-            break;
-        case NODE_EXPR_INDEX:
-            // target[index] -> free both
-            freeAST(node->index.target);
-            freeAST(node->index.index);
-            break;
-        case NODE_EXPR_CALL:
-            freeAST(node->call.arguments);
-            break;
-        case NODE_STMT_VAR_DECL:
-            freeAST(node->varDecl.initializer);
-            break;
-        case NODE_STMT_ASSIGN:
-            freeAST(node->assign.value);
-            break;
-        case NODE_STMT_INDEX_ASSIGN:
-            // target[index] = value
-            freeAST(node->indexAssign.target);
-            freeAST(node->indexAssign.index);
-            freeAST(node->indexAssign.value);
-            break;
-        case NODE_STMT_PRINT:
-            freeAST(node->print.expr);
-            break;
-        case NODE_STMT_IF:
-            freeAST(node->ifStmt.condition);
-            freeAST(node->ifStmt.thenBranch);
-            freeAST(node->ifStmt.elseBranch);
-            break;
-        case NODE_STMT_WHILE:
-            freeAST(node->whileStmt.condition);
-            freeAST(node->whileStmt.body);
-            break;
-        case NODE_STMT_FOR:
-            freeAST(node->forStmt.initializer);
-            freeAST(node->forStmt.condition);
-            freeAST(node->forStmt.increment);
-            freeAST(node->forStmt.body);
-            break;
-        case NODE_STMT_FOREACH:
-            freeAST(node->foreachStmt.collection);
-            freeAST(node->foreachStmt.body);
-            break;
-        case NODE_STMT_STRUCT_DECL:
-            if (node->structDecl.fields) {
-                free(node->structDecl.fields);
-            }
-            break;
-        case NODE_STMT_PROP_ASSIGN:
-            freeAST(node->propAssign.object);
-            freeAST(node->propAssign.value);
-            break;
-        case NODE_STMT_BLOCK:
-            for (int i = 0; i < node->block.count; i++) {
-                freeAST(node->block.statements[i]);
-            }
-            free(node->block.statements);
-            break;
-        case NODE_STMT_FUNCTION:
-            freeAST(node->function.body);
-            free(node->function.params);
-            break;
-        case NODE_STMT_RETURN:
-            freeAST(node->returnStmt.value);
-            break;
-        case NODE_STMT_IMPORT:
-            // tokens only; nothing to free
-            break;
-
-        case NODE_EXPR_ARRAY_LITERAL:
-            // Free elements linked list
-            {
-                Node* current = node->arrayLiteral.elements;
-                while (current) {
-                    Node* next = current->next;
-                    freeAST(current);
-                    current = next; // current->next pointer logic is slightly weird here as freeAST frees the node itself.
-                }
-            }
-            break;
-    }
-    free(node);
+    finishPrecompile(vm);
+    return 0;
 }
 
 int main(int argc, char** argv) {
@@ -263,7 +171,9 @@ int main(int argc, char** argv) {
     }
 
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [--opt] <file.unna>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <file.unna> [args...]\n", argv[0]);
+        fprintf(stderr, "       %s --compile <file.unna>...   Write .unnac bytecode caches\n", argv[0]);
+        fprintf(stderr, "       %s --profile[=sample[:out.folded]] <file.unna> [args...]\n", argv[0]);
         fprintf(stderr, "       %s -v | --version\n", argv[0]);
         return 1;
     }
@@ -271,8 +181,42 @@ int main(int argc, char** argv) {
     
     // Parse arguments (keeping for future flags if needed)
     char* filename = NULL;
+    bool compileOnly = strcmp(argv[1], "--compile") == 0;
+
+    // --profile: counters report; --profile=sample[:path]: folded stack samples
+    bool profile = false;
+    bool profileSample = false;
+    const char* foldedPath = "profile.folded";
+    if (strcmp(argv[1], "--profile") == 0) {
+        profile = true;
+    } else if (strncmp(argv[1], "--profile=sample", 16) == 0 &&
+               (argv[1][16] == '\0' || argv[1][16] == ':')) {
+        profile = profileSample = true;
+        if (argv[1][16] == ':' && argv[1][17] != '\0') foldedPath = argv[1] + 17;
+    } else if (strncmp(argv[1], "--profile", 9) == 0) {
+        fprintf(stderr, "Error: Unknown profile mode '%s'\n", argv[1]);
+        return 1;
+    }
+#ifndef UNNARIZE_PROFILE
+    (void)profileSample;
+    (void)foldedPath;
+    if (profile) {
+        fprintf(stderr, "Error: This build has no profiler; rebuild with 'make profile'\n");
+        return 1;
+    }
+#endif
+    if (profile) {
+        // The script sees its arguments as if the flag were not there
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+        if (argc < 2) {
+            fprintf(stderr, "Error: No input file specified\n");
+            return 1;
+        }
+    }
     
-    for (int i = 1; i < argc; i++) {
+    for (int i = compileOnly ? 2 : 1; i < argc; i++) {
         if (filename == NULL) {
             filename = argv[i];
         }
@@ -284,108 +228,101 @@ int main(int argc, char** argv) {
     }
 
     g_filename = filename;
-    char* source = readFile(filename);
-    g_source = source;
 
-    // Lexer
-    Lexer lexer;
-    initLexer(&lexer, source);
-
-    // Initialize parser with dynamic array
-    Parser parser;
-    initParser(&parser);
-    
-    // Tokenize - no more token limit!
-    while (true) {
-        Token token = scanToken(&lexer);
-        addToken(&parser, token);
-        if (token.type == TOKEN_EOF) break;
+    // VM (on the heap, like every isolate's)
+    VM* vm = calloc(1, sizeof(VM));
+    if (!vm) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 1;
     }
-
-    printf("Tokenized %d tokens successfully.\n", parser.count);
-
-    // Parse
-    Node* ast = parse(&parser);
-
-    // VM
-    static VM vm;  // Static: too large for stack (~576KB)
-    initVM(&vm);
-    vm.argc = argc;
-    vm.argv = argv;
+    initVM(vm);
+    vm->argc = argc;
+    vm->argv = argv;
 
     // Set script directory for relative paths
-    setScriptDir(&vm, filename);
+    setScriptDir(vm, filename);
 
     char* projectRoot = getenv("UNNARIZE_ROOT");
     if (projectRoot) {
-        strncpy(vm.projectRoot, projectRoot, 1023);
+        strncpy(vm->projectRoot, projectRoot, 1023);
     } else {
-        if (getcwd(vm.projectRoot, 1024) == NULL) {
+        if (getcwd(vm->projectRoot, 1024) == NULL) {
             fprintf(stderr, "Check for getcwd failed.");
         }
     }
 
-    registerUCoreUON(&vm); // Register built-in core libraries
-    registerUCoreHttp(&vm);
-    registerUCoreTimer(&vm); // Register Timer
-    registerUCoreJson(&vm);  // Register Json
-    registerUCoreScraper(&vm); // Register Scraper
-    registerUCoreString(&vm);  // Register String Utils
-    registerUCoreTui(&vm);      // Register TUI
-
-    registerUCoreSystem(&vm); // Register System
-    registerBuiltins(&vm);    // Register built-in natives (has, keys)
+    registerCoreLibraries(vm); // Built-in natives and the ucore libraries
     
-
+    if (compileOnly) {
+        int status = compileFiles(vm, argc - 2, argv + 2);
+        freeVM(vm);
+        free(vm);
+        return status;
+    }
     
     // VM Execution
     BytecodeChunk* chunk = malloc(sizeof(BytecodeChunk));
     initChunk(chunk);
     
     // Allocate script function to root constants during compilation
-    Function* script = (Function*)ALLOCATE_OBJ(&vm, Function, OBJ_FUNCTION);
-    script->paramCount = 0;
-    script->name.start = "<script>";
-    script->name.length = 8;
-    script->name.line = 0;
-    script->body = NULL;
-    script->closure = NULL;
-    script->isNative = false;
-    script->bytecodeChunk = chunk;
-    script->modulePath = g_filename ? strdup(g_filename) : NULL;
+    Function* script = newScriptFunction(vm, chunk, g_filename);
     
     // Root script on stack
-    vm.stack[vm.stackTop++] = OBJ_VAL(script);
+    vm->stack[vm->stackTop++] = OBJ_VAL(script);
     
-    if (compileToBytecode(&vm, ast, chunk, g_filename)) {
+    // A fresh .unnac cache replaces lexing, parsing and compiling, so no
+    // tokenizing banner is printed for it
+    FileBuffer source = {0};
+    bool compiled = loadBytecodeCache(vm, filename, chunk);
+    if (!compiled) {
+        readSource(filename, &source);
+        g_source = source.data;
+        Parser parser;
+        Node* ast = parseSource(source.data, &parser);
+        compiled = compileToBytecode(vm, ast, chunk, g_filename);
+        freeParser(&parser); // The whole tree at once
+    }
+    
+    if (compiled) {
+        // The modules it imports compile on worker threads meanwhile
+        precompileImports(vm, g_filename, chunk, false);
+#ifdef UNNARIZE_PROFILE
+        if (profile) profilerStart(vm, profileSample ? PROFILE_SAMPLE : PROFILE_COUNT, foldedPath);
+#endif
         // Setup CallFrame
-        if (vm.callStackTop < CALL_STACK_MAX) {
-            CallFrame* frame = &vm.callStack[vm.callStackTop++];
+        if (vm->callStackTop < CALL_STACK_MAX) {
+            CallFrame* frame = &vm->callStack[vm->callStackTop++];
             frame->function = script;
             frame->chunk = chunk;
             frame->ip = chunk->code;
-            frame->env = vm.globalEnv; // Bind global env
+            frame->env = vm->globalEnv; // Bind global env
             frame->regBase = 0;
+            PROFILE_ENTER(vm, frame, script);
         }
         
         // Execute VM
-        executeBytecode(&vm, chunk, 0);
+        executeBytecode(vm, chunk, 0);
+
+        // Let tasks that were never awaited run to completion
+        runScheduler(vm);
+#ifdef UNNARIZE_PROFILE
+        profilerStop(vm);
+#endif
         
-        // vm.callStackTop-- is handled by the return instruction
+        // vm->callStackTop-- is handled by the return instruction
     } else {
         fprintf(stderr, "Bytecode compilation failed.\n");
         exit(1);
     }
     
-    vm.stackTop--; // Pop script (script will be freed by freeVM -> freeObject)
+    vm->stackTop--; // Pop script (script will be freed by freeVM -> freeObject)
     // Don't free chunk here - it will be freed when script Function is freed
 
 
     // Cleanup
-    freeAST(ast);
-    freeParser(&parser);
-    freeVM(&vm);
-    free(source);
+    freeVM(vm);
+    free(vm);
+    fileClose(&source);
 
     return 0;
 }
\ No newline at end of file
@@ -1,18 +1,88 @@
-
 #include "parser.h"
 
-// Helper to advance parser
+#define NODE_BLOCK_NODES 512        // Nodes per node slab
+#define DATA_BLOCK_SIZE 16384       // Bytes per block of the data arena
+
+// ---- Arena ----
+
+static ArenaBlock* newBlock(ArenaBlock* next, size_t size) {
+    ArenaBlock* block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) error("Memory allocation failed.", 0);
+    block->next = next;
+    block->used = 0;
+    block->size = size;
+    return block;
+}
+
+// Bump-allocate 'size' bytes from the arena at '*list', max_align_t aligned
+static void* arenaAlloc(ArenaBlock** list, size_t size, size_t blockSize) {
+    size = (size + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    ArenaBlock* block = *list;
+    if (!block || block->size - block->used < size) {
+        block = newBlock(block, size > blockSize ? size : blockSize);
+        *list = block;
+    }
+    void* p = (char*)block->data + block->used;
+    block->used += size;
+    return p;
+}
+
+// Grow an array allocated from the data arena. The newest allocation
+// grows in place; any other is copied and its old space abandoned.
+static void* arenaGrow(Parser* parser, void* old, size_t oldSize, size_t newSize) {
+    if (!old) return arenaAlloc(&parser->data, newSize, DATA_BLOCK_SIZE);
+    ArenaBlock* block = parser->data;
+    oldSize = (oldSize + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    newSize = (newSize + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1);
+    if (block && (char*)old + oldSize == (char*)block->data + block->used &&
+        block->size - block->used >= newSize - oldSize) {
+        block->used += newSize - oldSize;
+        return old;
+    }
+    void* p = arenaAlloc(&parser->data, newSize, DATA_BLOCK_SIZE);
+    memcpy(p, old, oldSize);
+    return p;
+}
+
+static void freeBlocks(ArenaBlock* block) {
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void initParser(Parser* parser, const char* source) {
+    initLexer(&parser->lexer, source);
+    parser->previous = (Token){TOKEN_EOF, NULL, 0, 1};
+    parser->current = scanToken(&parser->lexer);
+    parser->tokenCount = 1;
+    parser->nodes = NULL;
+    parser->data = NULL;
+}
+
+void freeParser(Parser* parser) {
+    freeBlocks(parser->nodes);
+    freeBlocks(parser->data);
+    parser->nodes = NULL;
+    parser->data = NULL;
+}
+
+// ---- Tokens ----
+
+// Helper to advance parser; the lexer stops for good at EOF (or an error)
 static Token advance(Parser* parser) {
-    if (parser->current < parser->count) {
-        return parser->tokens[parser->current++];
+    parser->previous = parser->current;
+    if (parser->current.type != TOKEN_EOF) {
+        parser->current = scanToken(&parser->lexer);
+        parser->tokenCount++;
     }
-    return (Token){TOKEN_EOF, NULL, 0, 0};
+    return parser->previous;
 }
 
 // Check current token type
 static bool check(Parser* parser, TokenType type) {
-    if (parser->current >= parser->count) return false;
-    return parser->tokens[parser->current].type == type;
+    return parser->current.type == type;
 }
 
 // Match and advance if type
@@ -27,10 +97,24 @@ static bool match(Parser* parser, TokenType type) {
 // Consume token or error
 static Token consume(Parser* parser, TokenType type, const char* message) {
     if (check(parser, type)) return advance(parser);
-    errorAtToken(parser->tokens[parser->current], message);
+    errorAtToken(parser->current, message);
     return (Token){TOKEN_EOF, NULL, 0, 0};
 }
 
+// Allocate a node, tagged with the line of the token just consumed.
+// statement() and declaration() retag with the line the construct starts on.
+static Node* newNode(Parser* parser) {
+    Node* node = arenaAlloc(&parser->nodes, sizeof(Node), NODE_BLOCK_NODES * sizeof(Node));
+    node->next = NULL;
+    node->line = parser->previous.line;
+    return node;
+}
+
+// Line of the next token
+static int currentLine(Parser* parser) {
+    return parser->current.line;
+}
+
 // Forward declarations for recursive parsing
 static Node* expression(Parser* parser);
 static Node* statement(Parser* parser);
@@ -42,17 +126,16 @@ static Node* finishPostfix(Parser* parser, Node* expr);
 // Parse primary (literals, vars, groups)
 static Node* primary(Parser* parser) {
     if (match(parser, TOKEN_NUMBER) || match(parser, TOKEN_STRING) || 
-        match(parser, TOKEN_TRUE) || match(parser, TOKEN_FALSE)) {
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        match(parser, TOKEN_TRUE) || match(parser, TOKEN_FALSE) ||
+        match(parser, TOKEN_NIL)) {
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_LITERAL;
-        node->literal.token = parser->tokens[parser->current - 1];
+        node->literal.token = parser->previous;
         return node;
     }
     if (match(parser, TOKEN_LEFT_BRACKET)) {
         // Array literal [e1, e2, ...]
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_ARRAY_LITERAL;
         node->arrayLiteral.elements = NULL;
         node->arrayLiteral.count = 0;
@@ -70,11 +153,10 @@ static Node* primary(Parser* parser) {
     }
     if (match(parser, TOKEN_IDENTIFIER)) {
         // Variable reference base
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_VAR;
         node->type = NODE_EXPR_VAR;
-        node->var.name = parser->tokens[parser->current - 1];
+        node->var.name = parser->previous;
         node->var.slot = -1; // Initialize slot
         return finishPostfix(parser, node);
     }
@@ -83,7 +165,7 @@ static Node* primary(Parser* parser) {
         consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after expression.");
         return finishPostfix(parser, expr);
     }
-    error("Expect expression.", parser->tokens[parser->current].line);
+    error("Expect expression.", parser->current.line);
     return NULL;
 }
 
@@ -92,18 +174,16 @@ static Node* unary(Parser* parser) {
     if (match(parser, TOKEN_AWAIT)) {
         // await expression
         Node* expr = unary(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_AWAIT;
-        node->unary.op = parser->tokens[parser->current - 1]; // store 'await' token
+        node->unary.op = parser->previous; // store 'await' token
         node->unary.expr = expr;
         return node;
     }
     if (match(parser, TOKEN_MINUS) || match(parser, TOKEN_PLUS) || match(parser, TOKEN_BANG)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* expr = unary(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_UNARY;
         node->unary.op = op;
         node->unary.expr = expr;
@@ -116,8 +196,7 @@ static Node* unary(Parser* parser) {
 static Node* finishPostfix(Parser* parser, Node* expr) {
     for (;;) {
         if (match(parser, TOKEN_LEFT_PAREN)) {
-            Node* call = malloc(sizeof(Node));
-            call->next = NULL;
+            Node* call = newNode(parser);
             call->type = NODE_EXPR_CALL;
             call->call.callee = expr;
             call->call.arguments = NULL;
@@ -135,8 +214,7 @@ static Node* finishPostfix(Parser* parser, Node* expr) {
             expr = call;
         } else if (match(parser, TOKEN_DOT)) {
             Token name = consume(parser, TOKEN_IDENTIFIER, "Expect property name after '.'.");
-            Node* get = malloc(sizeof(Node));
-            get->next = NULL;
+            Node* get = newNode(parser);
             get->type = NODE_EXPR_GET;
             get->get.object = expr;
             get->get.name = name;
@@ -144,8 +222,7 @@ static Node* finishPostfix(Parser* parser, Node* expr) {
         } else if (match(parser, TOKEN_LEFT_BRACKET)) {
             Node* indexExpr = expression(parser);
             consume(parser, TOKEN_RIGHT_BRACKET, "Expect ']' after index expression.");
-            Node* idx = malloc(sizeof(Node));
-            idx->next = NULL;
+            Node* idx = newNode(parser);
             idx->type = NODE_EXPR_INDEX;
             idx->index.target = expr;
             idx->index.index = indexExpr;
@@ -161,10 +238,9 @@ static Node* finishPostfix(Parser* parser, Node* expr) {
 static Node* factor(Parser* parser) {
     Node* expr = unary(parser);
     while (match(parser, TOKEN_STAR) || match(parser, TOKEN_SLASH) || match(parser, TOKEN_PERCENT)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = unary(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -178,10 +254,9 @@ static Node* factor(Parser* parser) {
 static Node* term(Parser* parser) {
     Node* expr = factor(parser);
     while (match(parser, TOKEN_PLUS) || match(parser, TOKEN_MINUS)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = factor(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -196,10 +271,9 @@ static Node* comparison(Parser* parser) {
     Node* expr = term(parser);
     while (match(parser, TOKEN_GREATER) || match(parser, TOKEN_GREATER_EQUAL) ||
            match(parser, TOKEN_LESS) || match(parser, TOKEN_LESS_EQUAL)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = term(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -213,10 +287,9 @@ static Node* comparison(Parser* parser) {
 static Node* equality(Parser* parser) {
     Node* expr = comparison(parser);
     while (match(parser, TOKEN_EQUAL_EQUAL) || match(parser, TOKEN_BANG_EQUAL)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = comparison(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -230,10 +303,9 @@ static Node* equality(Parser* parser) {
 static Node* logicAnd(Parser* parser) {
     Node* expr = equality(parser);
     while (match(parser, TOKEN_AND)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = equality(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -247,10 +319,9 @@ static Node* logicAnd(Parser* parser) {
 static Node* logicOr(Parser* parser) {
     Node* expr = logicAnd(parser);
     while (match(parser, TOKEN_OR)) {
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* right = logicAnd(parser);
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_EXPR_BINARY;
         node->binary.left = expr;
         node->binary.op = op;
@@ -270,41 +341,42 @@ static Node* assignment(Parser* parser) {
         match(parser, TOKEN_STAR_EQUAL) ||
         match(parser, TOKEN_SLASH_EQUAL)) {
         
-        Token op = parser->tokens[parser->current - 1];
+        Token op = parser->previous;
         Node* value = assignment(parser); // Right-assoc
         
+        // The target's node becomes the assignment (nothing is freed in
+        // the arena, so nothing is left behind either)
         if (expr->type == NODE_EXPR_VAR) {
-            Node* node = malloc(sizeof(Node));
-            node->next = NULL;
+            Token name = expr->var.name;
+            Node* node = expr;
+            node->line = parser->previous.line;
             node->type = NODE_STMT_ASSIGN;
-            node->assign.name = expr->var.name;
+            node->assign.name = name;
             node->assign.operator = op;
             node->assign.value = value;
             node->assign.slot = -1; // Initialize slot
-            // Free the variable node as it's being converted to assignment target
-            free(expr); 
             return node;
         } else if (expr->type == NODE_EXPR_INDEX) {
-            Node* node = malloc(sizeof(Node));
-            node->next = NULL;
+            Node* target = expr->index.target;
+            Node* index = expr->index.index;
+            Node* node = expr;
+            node->line = parser->previous.line;
             node->type = NODE_STMT_INDEX_ASSIGN;
-            node->indexAssign.target = expr->index.target;
-            node->indexAssign.index = expr->index.index;
+            node->indexAssign.target = target;
+            node->indexAssign.index = index;
             node->indexAssign.operator = op;
             node->indexAssign.value = value;
-            node->indexAssign.value = value;
-            // Free the index node structure (but keep children which are moved)
-            free(expr);
             return node;
         } else if (expr->type == NODE_EXPR_GET) {
-            Node* node = malloc(sizeof(Node));
-            node->next = NULL;
+            Node* object = expr->get.object;
+            Token name = expr->get.name;
+            Node* node = expr;
+            node->line = parser->previous.line;
             node->type = NODE_STMT_PROP_ASSIGN;
-            node->propAssign.object = expr->get.object;
-            node->propAssign.name = expr->get.name;
+            node->propAssign.object = object;
+            node->propAssign.name = name;
             node->propAssign.operator = op;
             node->propAssign.value = value;
-            free(expr);
             return node;
         }
         error("Invalid assignment target.", op.line);
@@ -317,22 +389,28 @@ static Node* expression(Parser* parser) {
     return assignment(parser);
 }
 
+// Append to a block's statement list (in the data arena)
+static void addStatement(Parser* parser, Node* block, Node* statement) {
+    if (block->block.count == block->block.capacity) {
+        int capacity = block->block.capacity < 8 ? 8 : block->block.capacity * 2;
+        block->block.statements = arenaGrow(parser, block->block.statements,
+                                            block->block.capacity * sizeof(Node*),
+                                            capacity * sizeof(Node*));
+        block->block.capacity = capacity;
+    }
+    block->block.statements[block->block.count++] = statement;
+}
+
 // Block { ... }
 static Node* block(Parser* parser) {
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_BLOCK;
-    node->block.statements = malloc(8 * sizeof(Node*));
+    node->block.statements = NULL;
     node->block.count = 0;
-    node->block.capacity = 8;
+    node->block.capacity = 0;
 
     while (!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF)) {
-        Node* decl = declaration(parser);
-        if (node->block.count == node->block.capacity) {
-            node->block.capacity *= 2;
-            node->block.statements = realloc(node->block.statements, node->block.capacity * sizeof(Node*));
-        }
-        node->block.statements[node->block.count++] = decl;
+        addStatement(parser, node, declaration(parser));
     }
 
     consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after block.");
@@ -344,19 +422,19 @@ static Node* function(Parser* parser) {
     Token name = consume(parser, TOKEN_IDENTIFIER, "Expect function name.");
     consume(parser, TOKEN_LEFT_PAREN, "Expect '(' after function name.");
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_FUNCTION;
     node->function.name = name;
-    node->function.params = malloc(8 * sizeof(Token));
+    node->function.params = arenaAlloc(&parser->data, 8 * sizeof(Token), DATA_BLOCK_SIZE);
     node->function.paramCount = 0;
     int capacity = 8;
 
     if (!check(parser, TOKEN_RIGHT_PAREN)) {
         do {
             if (node->function.paramCount == capacity) {
+                node->function.params = arenaGrow(parser, node->function.params, capacity * sizeof(Token),
+                                                  capacity * 2 * sizeof(Token));
                 capacity *= 2;
-                node->function.params = realloc(node->function.params, capacity * sizeof(Token));
             }
             node->function.params[node->function.paramCount++] = consume(parser, TOKEN_IDENTIFIER, "Expect parameter name.");
         } while (match(parser, TOKEN_COMMA));
@@ -380,8 +458,7 @@ static Node* varDeclaration(Parser* parser) {
 
     consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_VAR_DECL;
     node->varDecl.name = name;
     node->varDecl.initializer = initializer;
@@ -394,8 +471,7 @@ static Node* printStatement(Parser* parser) {
     Node* expr = expression(parser);
     consume(parser, TOKEN_SEMICOLON, "Expect ';' after print value.");
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_PRINT;
     node->print.expr = expr;
     return node;
@@ -409,8 +485,7 @@ static Node* returnStatement(Parser* parser) {
     }
     consume(parser, TOKEN_SEMICOLON, "Expect ';' after return value.");
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_RETURN;
     node->returnStmt.value = value;
     return node;
@@ -428,8 +503,7 @@ static Node* ifStatement(Parser* parser) {
         elseBranch = statement(parser);
     }
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_IF;
     node->ifStmt.condition = condition;
     node->ifStmt.thenBranch = thenBranch;
@@ -444,8 +518,7 @@ static Node* whileStatement(Parser* parser) {
     consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after condition.");
     Node* body = statement(parser);
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_WHILE;
     node->whileStmt.condition = condition;
     node->whileStmt.body = body;
@@ -468,8 +541,7 @@ static Node* forStatement(Parser* parser) {
             consume(parser, TOKEN_RIGHT_PAREN, "Expect ')' after foreach collection.");
             Node* body = statement(parser);
             
-            Node* node = malloc(sizeof(Node));
-            node->next = NULL;
+            Node* node = newNode(parser);
             node->type = NODE_STMT_FOREACH;
             node->foreachStmt.iterator = name;
             node->foreachStmt.collection = collection;
@@ -485,8 +557,7 @@ static Node* forStatement(Parser* parser) {
         }
         consume(parser, TOKEN_SEMICOLON, "Expect ';' after variable declaration.");
 
-        Node* varNode = malloc(sizeof(Node));
-        varNode->next = NULL;
+        Node* varNode = newNode(parser);
         varNode->type = NODE_STMT_VAR_DECL;
         varNode->varDecl.name = name;
         varNode->varDecl.initializer = initExpr;
@@ -511,8 +582,7 @@ static Node* forStatement(Parser* parser) {
 
     Node* body = statement(parser);
 
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_FOR;
     node->forStmt.initializer = initializer;
     node->forStmt.condition = condition;
@@ -522,7 +592,7 @@ static Node* forStatement(Parser* parser) {
 }
 
 // Statement
-static Node* statement(Parser* parser) {
+static Node* statementBody(Parser* parser) {
     if (match(parser, TOKEN_PRINT)) return printStatement(parser);
     if (match(parser, TOKEN_IF)) return ifStatement(parser);
     if (match(parser, TOKEN_WHILE)) return whileStatement(parser);
@@ -536,27 +606,33 @@ static Node* statement(Parser* parser) {
     return exprStmt;
 }
 
+static Node* statement(Parser* parser) {
+    int line = currentLine(parser);
+    Node* node = statementBody(parser);
+    if (node) node->line = line;
+    return node;
+}
+
 // Struct declaration
 static Node* structDeclaration(Parser* parser) {
     Token name = consume(parser, TOKEN_IDENTIFIER, "Expect struct name.");
     consume(parser, TOKEN_LEFT_BRACE, "Expect '{' before struct body.");
 
-    Token* fields = malloc(8 * sizeof(Token));
+    Token* fields = arenaAlloc(&parser->data, 8 * sizeof(Token), DATA_BLOCK_SIZE);
     int count = 0;
     int capacity = 8;
     
     while (!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF)) {
         if (count == capacity) {
+            fields = arenaGrow(parser, fields, capacity * sizeof(Token), capacity * 2 * sizeof(Token));
             capacity *= 2;
-            fields = realloc(fields, capacity * sizeof(Token));
         }
         fields[count++] = consume(parser, TOKEN_IDENTIFIER, "Expect field name.");
         consume(parser, TOKEN_SEMICOLON, "Expect ';' after field name.");
     }
     consume(parser, TOKEN_RIGHT_BRACE, "Expect '}' after struct body.");
     
-    Node* node = malloc(sizeof(Node));
-    node->next = NULL;
+    Node* node = newNode(parser);
     node->type = NODE_STMT_STRUCT_DECL;
     node->structDecl.name = name;
     node->structDecl.fields = fields;
@@ -565,7 +641,7 @@ static Node* structDeclaration(Parser* parser) {
 }
 
 // Declaration (var or stmt or function)
-static Node* declaration(Parser* parser) {
+static Node* declarationBody(Parser* parser) {
     if (match(parser, TOKEN_STRUCT)) return structDeclaration(parser);
     if (match(parser, TOKEN_VAR)) return varDeclaration(parser);
     if (match(parser, TOKEN_IMPORT)) {
@@ -579,8 +655,7 @@ static Node* declaration(Parser* parser) {
         Token alias = consume(parser, TOKEN_IDENTIFIER, "Expect alias after 'as'.");
         consume(parser, TOKEN_SEMICOLON, "Expect ';' after import statement.");
 
-        Node* node = malloc(sizeof(Node));
-        node->next = NULL;
+        Node* node = newNode(parser);
         node->type = NODE_STMT_IMPORT;
         node->importStmt.module = module;
         node->importStmt.alias = alias;
@@ -602,23 +677,24 @@ static Node* declaration(Parser* parser) {
     return statement(parser);
 }
 
+static Node* declaration(Parser* parser) {
+    int line = currentLine(parser);
+    Node* node = declarationBody(parser);
+    if (node) node->line = line;
+    return node;
+}
+
 // Main parse function
 Node* parse(Parser* parser) {
     // Parse top-level declarations into a block
-    Node* root = malloc(sizeof(Node));
-    root->next = NULL;
+    Node* root = newNode(parser);
     root->type = NODE_STMT_BLOCK;
-    root->block.statements = malloc(8 * sizeof(Node*));
+    root->block.statements = NULL;
     root->block.count = 0;
-    root->block.capacity = 8;
+    root->block.capacity = 0;
 
     while (!match(parser, TOKEN_EOF)) {
-        Node* decl = declaration(parser);
-        if (root->block.count == root->block.capacity) {
-            root->block.capacity *= 2;
-            root->block.statements = realloc(root->block.statements, root->block.capacity * sizeof(Node*));
-        }
-        root->block.statements[root->block.count++] = decl;
+        addStatement(parser, root, declaration(parser));
     }
 
     return root;
@@ -0,0 +1,240 @@
+#include "runtime/extension.h"
+#include "extern.h"
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Extensions see the interpreter's values as they are, so both headers
+// must agree bit for bit
+_Static_assert(sizeof(UnnaValue) == sizeof(Value), "Value size");
+_Static_assert(UNNA_NIL == NIL_VAL, "nil encoding");
+_Static_assert(UNNA_TRUE == TAGGED_TRUE && UNNA_FALSE == TAGGED_FALSE, "bool encoding");
+_Static_assert(UNNA_INT(-7) == INT_VAL(-7), "int encoding");
+_Static_assert((int)UNNA_INT32 == (int)TYPED_INT32 && (int)UNNA_FLOAT64 == (int)TYPED_FLOAT64,
+               "typed array kinds");
+
+// Allocate without collecting: an extension's fresh values are not rooted
+static size_t holdCollections(VM* vm) {
+    size_t next = vm->nextGC;
+    vm->nextGC = SIZE_MAX;
+    return next;
+}
+
+static void releaseCollections(VM* vm, size_t next) {
+    vm->nextGC = next;
+}
+
+static UnnaKind apiKind(UnnaValue v) {
+    if (IS_NIL(v)) return UNNA_KIND_NIL;
+    if (IS_BOOL(v)) return UNNA_KIND_BOOL;
+    if (IS_INT(v)) return UNNA_KIND_INT;
+    if (!IS_OBJ(v)) return UNNA_KIND_FLOAT;
+    switch (AS_OBJ(v)->type) {
+        case OBJ_STRING:
+        case OBJ_STRING_BUILDER:
+        case OBJ_STRING_SLICE: return UNNA_KIND_STRING;
+        case OBJ_ARRAY: return UNNA_KIND_ARRAY;
+        case OBJ_MAP: return UNNA_KIND_MAP;
+        case OBJ_TYPED_ARRAY: return UNNA_KIND_TYPED_ARRAY;
+        case OBJ_FUNCTION: return UNNA_KIND_FUNCTION;
+        default: return UNNA_KIND_OTHER;
+    }
+}
+
+static bool apiStringView(UnnaValue v, UnnaStringView* out) {
+    return viewText(v, &out->chars, &out->length);
+}
+
+static bool apiArrayView(UnnaValue v, UnnaArrayView* out) {
+    if (!IS_ARRAY(v)) return false;
+    Array* a = (Array*)AS_OBJ(v);
+    out->items = a->items;
+    out->count = a->count;
+    return true;
+}
+
+static bool apiTypedView(UnnaValue v, UnnaTypedView* out) {
+    if (!IS_TYPED_ARRAY(v)) return false;
+    TypedArray* ta = AS_TYPED_ARRAY(v);
+    out->kind = (UnnaTypedKind)ta->kind;
+    out->data = ta->data;
+    out->count = ta->count;
+    return true;
+}
+
+static bool apiMapGet(UnnaValue map, const char* key, int length, UnnaValue* out) {
+    if (!IS_MAP(map)) return false;
+    MapEntry* e = mapFindEntry((Map*)AS_OBJ(map), key, length, NULL);
+    if (!e) return false;
+    *out = e->value;
+    return true;
+}
+
+static UnnaValue apiNewString(UnnaVM* vm, const char* chars, int length) {
+    return OBJ_VAL(internString(vm, chars, length));
+}
+
+static UnnaValue apiNewArray(UnnaVM* vm, const UnnaValue* items, int count) {
+    size_t next = holdCollections(vm);
+    Array* a = newArray(vm);
+    if (count > 0) {
+        a->items = reallocate(vm, NULL, 0, sizeof(Value) * (size_t)count);
+        memcpy(a->items, items, sizeof(Value) * (size_t)count);
+        a->capacity = count;
+        a->count = count;
+    }
+    releaseCollections(vm, next);
+    return OBJ_VAL(a);
+}
+
+static UnnaValue apiNewMap(UnnaVM* vm, const UnnaStringView* keys, const UnnaValue* values, int count) {
+    size_t next = holdCollections(vm);
+    Map* m = newMap(vm);
+    for (int i = 0; i < count; i++) mapSetStr(m, keys[i].chars, keys[i].length, values[i]);
+    releaseCollections(vm, next);
+    return OBJ_VAL(m);
+}
+
+static UnnaValue apiNewTypedArray(UnnaVM* vm, UnnaTypedKind kind, const void* data, int count) {
+    if (count < 0) count = 0;
+    TypedArray* ta = newTypedArray(vm, (TypedKind)kind, count);
+    if (data) memcpy(ta->data, data, (size_t)count * typedElementSize(ta->kind));
+    return OBJ_VAL(ta);
+}
+
+static bool apiArraySet(UnnaVM* vm, UnnaValue array, int index, UnnaValue v) {
+    if (!IS_ARRAY(array)) return false;
+    Array* a = (Array*)AS_OBJ(array);
+    if (index < 0 || index >= a->count) return false;
+    arrayWritable(vm, a);
+    a->items[index] = v;
+    WRITE_BARRIER(vm, a);
+    return true;
+}
+
+static bool apiArrayPush(UnnaVM* vm, UnnaValue array, UnnaValue v) {
+    if (!IS_ARRAY(array)) return false;
+    arrayPush(vm, (Array*)AS_OBJ(array), v);
+    return true;
+}
+
+static bool apiMapSet(UnnaVM* vm, UnnaValue map, const char* key, int length, UnnaValue v) {
+    (void)vm;
+    if (!IS_MAP(map)) return false;
+    mapSetStr((Map*)AS_OBJ(map), key, length, v);
+    return true;
+}
+
+static UnnaHandle* apiPin(UnnaVM* vm, UnnaValue v) {
+    UnnaHandle* handle = malloc(sizeof(UnnaHandle));
+    if (!handle) error("Memory allocation failed.", 0);
+    handle->value = v;
+    if (IS_OBJ(v)) retainObject(vm, AS_OBJ(v));
+    return handle;
+}
+
+static void apiUnpin(UnnaVM* vm, UnnaHandle* handle) {
+    if (!handle) return;
+    if (IS_OBJ(handle->value)) releaseObject(vm, AS_OBJ(handle->value));
+    free(handle);
+}
+
+static void apiDeferGC(UnnaVM* vm) {
+    deferCollections(vm);
+}
+
+static void apiResumeGC(UnnaVM* vm) {
+    resumeCollections(vm);
+}
+
+static UnnaValue apiCall(UnnaVM* vm, UnnaValue function, UnnaValue* args, int argCount) {
+    if (!IS_OBJ(function) || AS_OBJ(function)->type != OBJ_FUNCTION) {
+        printf("Error: Extension called a value that is not a function.\n");
+        return NIL_VAL;
+    }
+    return callFunction(vm, (Function*)AS_OBJ(function), args, argCount);
+}
+
+static void apiError(UnnaVM* vm, const char* message) {
+    (void)vm;
+    printf("Error: %s\n", message);
+}
+
+static const UnnaApi unnaApi = {
+    .abiVersion = UNNA_ABI_VERSION,
+    .kind = apiKind,
+    .stringView = apiStringView,
+    .arrayView = apiArrayView,
+    .typedView = apiTypedView,
+    .mapGet = apiMapGet,
+    .newString = apiNewString,
+    .newArray = apiNewArray,
+    .newMap = apiNewMap,
+    .newTypedArray = apiNewTypedArray,
+    .arraySet = apiArraySet,
+    .arrayPush = apiArrayPush,
+    .mapSet = apiMapSet,
+    .pin = apiPin,
+    .unpin = apiUnpin,
+    .deferGC = apiDeferGC,
+    .resumeGC = apiResumeGC,
+    .call = apiCall,
+    .error = apiError,
+};
+
+bool isExtensionPath(const char* path) {
+    size_t len = strlen(path);
+    return len > 3 && strcmp(path + len - 3, ".so") == 0;
+}
+
+static void extensionFailed(const char* path, const char* why) {
+    fprintf(stderr, "Runtime Error: Could not import extension '%s': %s\n", path, why);
+    exit(1);
+}
+
+Module* loadExtension(VM* vm, const char* path) {
+    if (vm->externHandleCount >= TABLE_SIZE) extensionFailed(path, "too many extensions loaded");
+
+    // dlopen searches the library path for bare names; imports are files
+    char* file = NULL;
+    if (!strchr(path, '/')) {
+        file = malloc(strlen(path) + 3);
+        if (!file) exit(1);
+        sprintf(file, "./%s", path);
+    }
+    void* handle = dlopen(file ? file : path, RTLD_NOW | RTLD_LOCAL);
+    free(file);
+    if (!handle) extensionFailed(path, dlerror());
+
+    const UnnaExtension* ext = (const UnnaExtension*)dlsym(handle, UNNA_EXTENSION_SYMBOL);
+    if (!ext) {
+        dlclose(handle);
+        extensionFailed(path, "no '" UNNA_EXTENSION_SYMBOL "' table exported");
+    }
+    if (ext->abiVersion != UNNA_ABI_VERSION) {
+        char why[96];
+        snprintf(why, sizeof(why), "built for extension ABI %u, this interpreter has %u",
+                 (unsigned)ext->abiVersion, (unsigned)UNNA_ABI_VERSION);
+        dlclose(handle);
+        extensionFailed(path, why);
+    }
+    vm->externHandles[vm->externHandleCount++] = handle;
+    if (ext->init && !ext->init(vm, &unnaApi)) extensionFailed(path, "its init() failed");
+
+    Module* mod = ALLOCATE_OBJ(vm, Module, OBJ_MODULE);
+    mod->name = strdup(ext->name ? ext->name : path);
+    mod->env = NULL;
+    mod->source = NULL;
+    vm->stack[vm->stackTop++] = OBJ_VAL(mod); // Root across the env and natives
+    mod->env = newEnvironment(vm, NULL);
+    WRITE_BARRIER(vm, (Obj*)mod);
+    for (const UnnaFunction* fn = ext->functions; fn && fn->name; fn++) {
+        // Same signature as NativeFn: the values are passed untouched.
+        // Strings arrive as they are (slices too), for zero-copy views.
+        defineNative(vm, mod->env, fn->name, fn->function, fn->arity)->keepsViews = true;
+    }
+    vm->stackTop--;
+    return mod;
+}
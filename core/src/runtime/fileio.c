@@ -0,0 +1,111 @@
+#define _DEFAULT_SOURCE // madvise, MAP_ANONYMOUS
+#include "runtime/fileio.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool readInto(int fd, size_t size, FileBuffer* out) {
+    char* buf = malloc(size + 1);
+    if (!buf) return false;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, buf + done, size - done);
+        if (n <= 0) break;      // Error, or the file shrank
+        done += (size_t)n;
+    }
+    buf[done] = '\0';
+    out->data = buf;
+    out->length = done;
+    out->mapped = 0;
+    return true;
+}
+
+// The file is mapped over a zeroed anonymous reservation one byte longer,
+// so the '\0' after the last byte exists even when the size is a multiple
+// of the page size (reading past the end of a file mapping would SIGBUS).
+static bool mapInto(int fd, size_t size, FileBuffer* out) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t span = (size + 1 + page - 1) / page * page;
+    void* base = mmap(NULL, span, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return false;
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, span);
+        return false;
+    }
+    out->data = base;
+    out->length = size;
+    out->mapped = span;
+    return true;
+}
+
+static bool loadFile(const char* path, FileBuffer* out, size_t mapMin) {
+    out->data = NULL;
+    out->length = 0;
+    out->mapped = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size_t size = (size_t)st.st_size;
+        ok = (size > 0 && size >= mapMin && mapInto(fd, size, out)) || readInto(fd, size, out);
+    }
+    close(fd);
+    return ok;
+}
+
+bool fileOpen(const char* path, FileBuffer* out) {
+    return loadFile(path, out, FILE_MAP_MIN);
+}
+
+bool fileMap(const char* path, FileBuffer* out) {
+    return loadFile(path, out, 0);
+}
+
+void fileClose(FileBuffer* file) {
+    if (file->mapped) munmap((void*)file->data, file->mapped);
+    else free((void*)file->data);
+    file->data = NULL;
+    file->length = 0;
+    file->mapped = 0;
+}
+
+void fileDrop(FileBuffer* file, size_t offset) {
+    if (!file->mapped) return;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t bytes = offset / page * page;
+    if (bytes > 0) madvise((void*)file->data, bytes, MADV_DONTNEED);
+}
+
+static void mappingCleanup(void* data) {
+    fileClose((FileBuffer*)data);
+    free(data);
+}
+
+Value fileString(VM* vm, FileBuffer* file) {
+    if (file->length > INT_MAX) {
+        fileClose(file);
+        return NIL_VAL;
+    }
+    if (!file->mapped) {
+        ObjString* s = internString(vm, file->data, (int)file->length);
+        fileClose(file);
+        return OBJ_VAL(s);
+    }
+
+    FileBuffer* owned = malloc(sizeof(FileBuffer));
+    if (!owned) error("Memory allocation failed.", 0);
+    *owned = *file;
+    ObjResource* mapping = ALLOCATE_OBJ(vm, ObjResource, OBJ_RESOURCE);
+    mapping->data = owned;
+    mapping->cleanup = mappingCleanup;
+    mapping->next = NULL;
+    mapping->share = NULL;
+    vm->stack[vm->stackTop++] = OBJ_VAL(mapping);
+    Value str = bufferSlice(vm, (Obj*)mapping, owned->data, (int)owned->length);
+    vm->stackTop--;
+    return str;
+}
@@ -0,0 +1,208 @@
+#include "runtime/heap.h"
+#include "vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Object Heap
+ *
+ * Pages are HEAP_PAGE_SIZE-aligned, so a slot's page header is found by
+ * masking its address; heapFree() needs no per-object header. Each size
+ * class allocates from its 'current' page, then from pages that regained
+ * free slots (the partial list), then from a fresh page. Fresh pages are
+ * carved by bumping a pointer, which keeps a burst of young objects
+ * contiguous.
+ */
+
+#ifndef DEBUG_HEAP_MALLOC
+static const uint32_t classSizes[HEAP_SIZE_CLASSES] = {16, 32, 48, 64, 96, 128, 192, 256};
+
+// Size class for each 16-byte step up to HEAP_MAX_SMALL
+static const uint8_t classForStep[HEAP_MAX_SMALL / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+#endif
+
+#define PAGE_HEADER_SIZE ((sizeof(HeapPage) + 15) & ~(size_t)15)
+
+static inline HeapPage* pageOf(void* pointer) {
+    return (HeapPage*)((uintptr_t)pointer & ~(uintptr_t)(HEAP_PAGE_SIZE - 1));
+}
+
+void initHeap(Heap* heap) {
+    for (int i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        heap->classes[i].current = NULL;
+        heap->classes[i].partial = NULL;
+    }
+    heap->emptyPages = NULL;
+    heap->emptyPageCount = 0;
+    heap->pageCount = 0;
+    heap->largeBytes = 0;
+    heap->concurrent = 0;
+    pthread_mutex_init(&heap->lock, NULL);
+}
+
+static void freePageList(HeapPage* page) {
+    while (page) {
+        HeapPage* next = page->next;
+        free(page);
+        page = next;
+    }
+}
+
+// Pages still holding live slots are unreachable once the VM has freed its
+// objects, so only the tracked lists need releasing
+void freeHeap(Heap* heap) {
+    for (int i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        free(heap->classes[i].current);
+        freePageList(heap->classes[i].partial);
+        heap->classes[i].current = NULL;
+        heap->classes[i].partial = NULL;
+    }
+    freePageList(heap->emptyPages);
+    heap->emptyPages = NULL;
+    heap->emptyPageCount = 0;
+    heap->pageCount = 0;
+    pthread_mutex_destroy(&heap->lock);
+}
+
+#ifndef DEBUG_HEAP_MALLOC
+// Slab-only helpers; DEBUG_HEAP_MALLOC hands every object straight to malloc
+static HeapPage* newPage(Heap* heap, int sizeClass) {
+    HeapPage* page = heap->emptyPages;
+    if (page) {
+        heap->emptyPages = page->next;
+        heap->emptyPageCount--;
+    } else {
+        void* memory = NULL;
+        if (posix_memalign(&memory, HEAP_PAGE_SIZE, HEAP_PAGE_SIZE) != 0) {
+            fprintf(stderr, "Out of memory allocating heap page.\n");
+            exit(1);
+        }
+        page = (HeapPage*)memory;
+        heap->pageCount++;
+    }
+    page->next = NULL;
+    page->prev = NULL;
+    page->freeList = NULL;
+    page->bump = (char*)page + PAGE_HEADER_SIZE;
+    page->end = (char*)page + HEAP_PAGE_SIZE;
+    page->slotSize = classSizes[sizeClass];
+    page->liveCount = 0;
+    page->sizeClass = (uint8_t)sizeClass;
+    page->inPartialList = false;
+    return page;
+}
+
+static void releasePage(Heap* heap, HeapPage* page) {
+    if (heap->emptyPageCount < HEAP_EMPTY_PAGE_CACHE) {
+        page->next = heap->emptyPages;
+        heap->emptyPages = page;
+        heap->emptyPageCount++;
+    } else {
+        free(page);
+        heap->pageCount--;
+    }
+}
+
+static void unlinkPartial(HeapClass* cls, HeapPage* page) {
+    if (page->prev) page->prev->next = page->next;
+    else cls->partial = page->next;
+    if (page->next) page->next->prev = page->prev;
+    page->next = NULL;
+    page->prev = NULL;
+    page->inPartialList = false;
+}
+
+static inline void* takeSlot(HeapPage* page) {
+    void* slot = page->freeList;
+    if (slot) {
+        page->freeList = *(void**)slot;
+    } else if (page->bump + page->slotSize <= page->end) {
+        slot = page->bump;
+        page->bump += page->slotSize;
+    } else {
+        return NULL;
+    }
+    page->liveCount++;
+    return slot;
+}
+#endif
+
+void* heapAlloc(Heap* heap, size_t size) {
+#ifdef DEBUG_HEAP_MALLOC
+    (void)heap;
+    void* debugSlot = malloc(size);
+    if (!debugSlot) exit(1);
+    return debugSlot;
+#else
+    bool locked = heap->concurrent; // Concurrent sweep may be freeing slots
+    if (locked) pthread_mutex_lock(&heap->lock);
+
+    if (size > HEAP_MAX_SMALL) {
+        void* large = malloc(size);
+        if (!large) exit(1);
+        heap->largeBytes += size;
+        if (locked) pthread_mutex_unlock(&heap->lock);
+        return large;
+    }
+
+    int sizeClass = classForStep[(size + 15) / 16];
+    HeapClass* cls = &heap->classes[sizeClass];
+    void* slot = cls->current ? takeSlot(cls->current) : NULL;
+    if (!slot) {
+        // Current page is full: it rejoins the partial list when a slot frees
+        HeapPage* page = cls->partial;
+        if (page) {
+            unlinkPartial(cls, page);
+        } else {
+            page = newPage(heap, sizeClass);
+        }
+        cls->current = page;
+        slot = takeSlot(page);
+    }
+
+    if (locked) pthread_mutex_unlock(&heap->lock);
+    return slot;
+#endif
+}
+
+void heapFree(Heap* heap, void* pointer, size_t size) {
+    if (pointer == NULL) return;
+#ifdef DEBUG_HEAP_MALLOC
+    (void)heap;
+    (void)size;
+    free(pointer);
+#else
+    bool locked = heap->concurrent;
+    if (locked) pthread_mutex_lock(&heap->lock);
+
+    if (size > HEAP_MAX_SMALL) {
+        free(pointer);
+        heap->largeBytes -= size;
+        if (locked) pthread_mutex_unlock(&heap->lock);
+        return;
+    }
+
+    HeapPage* page = pageOf(pointer);
+    *(void**)pointer = page->freeList;
+    page->freeList = pointer;
+    page->liveCount--;
+
+    HeapClass* cls = &heap->classes[page->sizeClass];
+    if (page != cls->current) {
+        if (page->liveCount == 0) {
+            if (page->inPartialList) unlinkPartial(cls, page);
+            releasePage(heap, page);
+        } else if (!page->inPartialList) {
+            page->next = cls->partial;
+            page->prev = NULL;
+            if (cls->partial) cls->partial->prev = page;
+            cls->partial = page;
+            page->inPartialList = true;
+        }
+    }
+
+    if (locked) pthread_mutex_unlock(&heap->lock);
+#endif
+}
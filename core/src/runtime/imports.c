@@ -0,0 +1,515 @@
+#include "runtime/imports.h"
+#include "bytecode/cache.h"
+#include "bytecode/compiler.h"
+#include "bytecode/opcodes.h"
+#include "runtime/extension.h"
+#include "lexer.h"
+#include "parser.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMPORT_BUCKETS 256          // Power of two
+#define IMPORT_MAX_THREADS 16
+
+typedef enum {
+    IMAGE_UNSEEN,       // Known, not queued
+    IMAGE_QUEUED,       // Waiting for a worker
+    IMAGE_COMPILING,    // A worker has it
+    IMAGE_READY,        // 'data' holds the module; never changes again
+    IMAGE_IMPORTER      // Left to the import: it got there first, or a worker could not compile it
+} ImageState;
+
+struct ModuleImage {
+    dev_t device;               // Identity of the source file, if it exists
+    ino_t inode;
+    bool exists;
+    const char* path;           // Import path a worker compiles it under (an entry's)
+    ImageState state;
+    bool attempted;             // A worker tried it
+    bool saved;                 // The worker wrote its .unnac
+    FileBuffer bytes;           // .unnac image: the cache file mapped, or encoded here
+    struct ModuleImage* next;
+    struct ModuleImage* nextQueued;
+};
+
+struct ImportCache {
+    pthread_mutex_t lock;       // Guards everything below while workers run
+    pthread_cond_t changed;     // A module was queued or finished, or a worker left
+    ImportEntry* buckets[IMPORT_BUCKETS];
+    ModuleImage* images;
+    ModuleImage* queueHead;
+    ModuleImage* queueTail;
+    pthread_t threads[IMPORT_MAX_THREADS];
+    int threadCount;            // Started and not yet joined
+    int running;                // Workers still looking for work
+    int busy;                   // Workers compiling (and so possibly queueing more)
+    bool stopping;
+    bool writeCaches;
+};
+
+static ImportCache* importCache(VM* vm) {
+    if (vm->imports) return vm->imports;
+    ImportCache* cache = calloc(1, sizeof(ImportCache));
+    if (!cache) error("Memory allocation failed.", 0);
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->changed, NULL);
+    vm->imports = cache;
+    return cache;
+}
+
+// ---- Resolution ----
+
+// The path imports have always used: dirname(importer) + "/" + rawPath for
+// a path starting with '.', rawPath as written otherwise. Written to
+// 'buffer' if it fits, else malloc'd.
+static const char* joinImportPath(const char* importer, const char* rawPath,
+                                  char* buffer, size_t capacity) {
+    if (rawPath[0] != '.' || !importer) return rawPath;
+    const char* slash = strrchr(importer, '/');
+    const char* dir = ".";
+    size_t dirLength = 1;
+    if (slash == importer) {
+        dir = "/";
+    } else if (slash) {
+        dir = importer;
+        dirLength = (size_t)(slash - importer);
+    }
+    size_t rawLength = strlen(rawPath);
+    size_t length = dirLength + 1 + rawLength;
+    char* path = buffer;
+    if (length + 1 > capacity) {
+        path = malloc(length + 1);
+        if (!path) error("Memory allocation failed.", 0);
+    }
+    memcpy(path, dir, dirLength);
+    path[dirLength] = '/';
+    memcpy(path + dirLength + 1, rawPath, rawLength + 1);
+    return path;
+}
+
+static ImportEntry* findEntry(ImportCache* cache, const char* path, unsigned int h) {
+    for (ImportEntry* e = cache->buckets[h & (IMPORT_BUCKETS - 1)]; e; e = e->next) {
+        if (e->hash == h && strcmp(e->path, path) == 0) return e;
+    }
+    return NULL;
+}
+
+// Paths name the same module if they reach the same file
+static ModuleImage* findImage(ImportCache* cache, const char* path, const struct stat* st) {
+    for (ModuleImage* image = cache->images; image; image = image->next) {
+        if (st ? image->exists && image->device == st->st_dev && image->inode == st->st_ino
+               : !image->exists && strcmp(image->path, path) == 0) {
+            return image;
+        }
+    }
+    return NULL;
+}
+
+static ImportEntry* lookupEntry(ImportCache* cache, const char* path) {
+    unsigned int h = hash(path, (int)strlen(path));
+    pthread_mutex_lock(&cache->lock);
+    ImportEntry* entry = findEntry(cache, path, h);
+    pthread_mutex_unlock(&cache->lock);
+    if (entry) return entry;
+
+    // First sight of this path: identify its file outside the lock
+    struct stat st;
+    bool exists = stat(path, &st) == 0;
+
+    pthread_mutex_lock(&cache->lock);
+    entry = findEntry(cache, path, h); // Another thread may have added it meanwhile
+    if (!entry) {
+        entry = malloc(sizeof(ImportEntry));
+        if (!entry) error("Memory allocation failed.", 0);
+        entry->path = strdup(path);
+        entry->hash = h;
+        entry->image = findImage(cache, path, exists ? &st : NULL);
+        if (!entry->image) {
+            ModuleImage* image = calloc(1, sizeof(ModuleImage));
+            if (!image) error("Memory allocation failed.", 0);
+            image->exists = exists;
+            if (exists) {
+                image->device = st.st_dev;
+                image->inode = st.st_ino;
+            }
+            image->path = entry->path;
+            image->state = IMAGE_UNSEEN;
+            image->next = cache->images;
+            cache->images = image;
+            entry->image = image;
+        }
+        unsigned int bucket = h & (IMPORT_BUCKETS - 1);
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+ImportEntry* resolveImport(VM* vm, const char* importerPath, const char* rawPath) {
+    char buffer[1024];
+    const char* path = joinImportPath(importerPath, rawPath, buffer, sizeof(buffer));
+    ImportEntry* entry = lookupEntry(importCache(vm), path);
+    if (path != buffer && path != rawPath) free((char*)path);
+    return entry;
+}
+
+// ---- Compiling ----
+
+Function* newModuleFunction(VM* vm, BytecodeChunk* chunk, const char* path, Environment* env) {
+    Function* func = heapAlloc(&vm->heap, sizeof(Function)); // Freed by freeObject
+    func->obj.type = OBJ_FUNCTION;
+    func->obj.isMarked = false;
+    func->obj.isPermanent = false;
+    func->obj.generation = GC_GEN_OLD; // Linked straight onto the old list
+    func->obj.isRemembered = false;
+    func->obj.next = vm->objects;
+    vm->objects = (Obj*)func;
+    rememberObject(vm, (Obj*)func);
+    func->name = (Token){0};
+    func->params = NULL;
+    func->paramCount = 0;
+    func->isNative = false;
+    func->isAsync = false;
+    func->bytecodeChunk = chunk;
+    func->modulePath = path ? strdup(path) : NULL;
+    func->moduleEnv = env;
+    func->closure = NULL;
+    func->native = NULL;
+    func->body = NULL;
+    return func;
+}
+
+// Lex, parse and compile the source at 'path' against vm->globalEnv, the
+// tree living in 'parser' until compiled. Returns false only if the file
+// cannot be read.
+static bool compileSource(VM* vm, const char* path, BytecodeChunk* chunk, FileBuffer* source,
+                          Parser* parser, bool* compiled) {
+    if (!fileOpen(path, source)) return false;
+    initParser(parser, source->data);
+    Node* ast = parse(parser);
+    *compiled = compileToBytecode(vm, ast, chunk, path);
+    freeParser(parser);
+    return true;
+}
+
+static void publishImage(ImportCache* cache, ModuleImage* image, FileBuffer bytes) {
+    pthread_mutex_lock(&cache->lock);
+    image->bytes = bytes;
+    image->state = IMAGE_READY;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// An encoded image, owned like a file read into memory
+static FileBuffer encodedBytes(uint8_t* data, size_t size) {
+    FileBuffer bytes = { (const char*)data, size, 0 };
+    return bytes;
+}
+
+static bool loadImage(VM* vm, const char* path, FileBuffer* bytes, BytecodeChunk* chunk) {
+    return loadBytecodeImage(vm, path, (const uint8_t*)bytes->data, bytes->length, chunk);
+}
+
+bool loadModule(VM* vm, ImportEntry* entry, BytecodeChunk* chunk, FileBuffer* source) {
+    ImportCache* cache = importCache(vm);
+    ModuleImage* image = entry->image;
+    pthread_mutex_lock(&cache->lock);
+    while (image->state == IMAGE_COMPILING) pthread_cond_wait(&cache->changed, &cache->lock);
+    bool ready = image->state == IMAGE_READY;
+    if (!ready) image->state = IMAGE_IMPORTER; // Compiling it now beats waiting in the queue
+    pthread_mutex_unlock(&cache->lock);
+
+    if (ready && loadImage(vm, entry->path, &image->bytes, chunk)) return true;
+
+    // A fresh .unnac cache replaces lexing, parsing and compiling, and
+    // becomes the image as it is
+    FileBuffer bytes;
+    if (readBytecodeCache(entry->path, &bytes)) {
+        if (loadImage(vm, entry->path, &bytes, chunk)) {
+            if (ready) fileClose(&bytes);
+            else publishImage(cache, image, bytes);
+            return true;
+        }
+        fileClose(&bytes);
+    }
+
+    Parser parser;
+    bool compiled = true;
+    if (!compileSource(vm, entry->path, chunk, source, &parser, &compiled)) return false;
+    // Encoded before the module runs and quickens its code
+    if (!ready && compiled) {
+        size_t size = 0;
+        uint8_t* data = encodeBytecodeImage(vm, entry->path, NULL, chunk, &size);
+        if (data) publishImage(cache, image, encodedBytes(data, size));
+    }
+    return true;
+}
+
+// ---- Precompiling ----
+
+static void enqueueImage(ImportCache* cache, ModuleImage* image) {
+    image->state = IMAGE_QUEUED;
+    image->nextQueued = NULL;
+    if (cache->queueTail) cache->queueTail->nextQueued = image;
+    else cache->queueHead = image;
+    cache->queueTail = image;
+}
+
+// Queue the modules a chunk tree imports (nested functions included)
+static void queueImports(ImportCache* cache, BytecodeChunk* chunk, const char* importer) {
+    bool queued = false;
+    for (int i = 0; i < chunk->codeSize; i++) {
+        uint32_t inst = chunk->code[i];
+        if (DECODE_OP(inst) != OP_IMPORT) continue;
+        Value name = chunk->constants[DECODE_Bx(inst)];
+        if (!IS_STRING(name)) continue;
+        const char* rawPath = AS_CSTRING(name);
+        char buffer[1024];
+        const char* path = joinImportPath(importer, rawPath, buffer, sizeof(buffer));
+        if (!isExtensionPath(path)) {
+            ImportEntry* entry = lookupEntry(cache, path);
+            pthread_mutex_lock(&cache->lock);
+            if (entry->image->state == IMAGE_UNSEEN) {
+                enqueueImage(cache, entry->image);
+                queued = true;
+            }
+            pthread_mutex_unlock(&cache->lock);
+        }
+        if (path != buffer && path != rawPath) free((char*)path);
+    }
+    if (queued) {
+        pthread_mutex_lock(&cache->lock);
+        pthread_cond_broadcast(&cache->changed);
+        pthread_mutex_unlock(&cache->lock);
+    }
+    for (int i = 0; i < chunk->constantCount; i++) {
+        Value v = chunk->constants[i];
+        if (IS_OBJ(v) && AS_OBJ(v)->type == OBJ_FUNCTION) {
+            Function* func = (Function*)AS_OBJ(v);
+            if (func->bytecodeChunk) queueImports(cache, func->bytecodeChunk, importer);
+        }
+    }
+}
+
+// A syntax error in a module ends the program only when it is imported
+static bool compileTrapped(VM* vm, const char* path, BytecodeChunk* chunk, FileBuffer* source) {
+    jmp_buf trap;
+    bool compiled = false;
+    Parser parser = {0}; // Freed here if the error skips compileSource's own free
+    if (setjmp(trap) != 0) {
+        g_errorTrap = NULL;
+        freeParser(&parser);
+        return false;
+    }
+    g_errorTrap = &trap;
+    bool read = compileSource(vm, path, chunk, source, &parser, &compiled);
+    g_errorTrap = NULL;
+    return read && compiled;
+}
+
+// Compile one module in the worker's VM, against an empty global
+// environment as --compile does, and queue what it imports
+static bool precompileModule(ImportCache* cache, VM* vm, ModuleImage* image,
+                             FileBuffer* bytes, bool* saved) {
+    int base = vm->stackTop;
+    Environment* env = newEnvironment(vm, NULL);
+    vm->globalEnv = env; // Rooted as the global env
+    BytecodeChunk* chunk = malloc(sizeof(BytecodeChunk));
+    if (!chunk) error("Memory allocation failed.", 0);
+    initChunk(chunk);
+    Function* func = newModuleFunction(vm, chunk, image->path, env);
+    vm->stack[vm->stackTop++] = OBJ_VAL(func);
+
+    // A fresh .unnac cache is the image as it is; it is loaded only to find
+    // the module's imports
+    bool ok = readBytecodeCache(image->path, bytes);
+    if (ok && !loadImage(vm, image->path, bytes, chunk)) {
+        fileClose(bytes);
+        ok = false;
+    }
+
+    FileBuffer source = {0};
+    if (!ok) {
+        if (compileTrapped(vm, image->path, chunk, &source)) {
+            // The source goes into the header only if the image is saved
+            const char* text = cache->writeCaches ? source.data : NULL;
+            size_t size = 0;
+            uint8_t* data = encodeBytecodeImage(vm, image->path, text, chunk, &size);
+            if (data && text) *saved = saveBytecodeImage(image->path, data, size);
+            if (data) *bytes = encodedBytes(data, size);
+            ok = data != NULL;
+        }
+        vm->stackTop = base + 1; // A trapped error may leave roots behind
+    }
+    if (ok) queueImports(cache, chunk, image->path);
+    vm->stackTop = base;
+    fileClose(&source);
+    return ok;
+}
+
+// Compile-only VM: a heap, string pool and globals, no core libraries
+static VM* newCompilerVM(void) {
+    VM* vm = calloc(1, sizeof(VM));
+    if (!vm) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    initVMWithRegisters(vm, FRAME_REG_MAX);
+    vm->gcMarkThreads = 1;
+    return vm;
+}
+
+static void* precompileWorker(void* arg) {
+    ImportCache* cache = (ImportCache*)arg;
+    VM* vm = NULL; // Made on the first module, kept for the rest
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->stopping) {
+        ModuleImage* image = cache->queueHead;
+        if (!image) {
+            if (cache->busy == 0) break; // Nobody left to queue more
+            pthread_cond_wait(&cache->changed, &cache->lock);
+            continue;
+        }
+        cache->queueHead = image->nextQueued;
+        if (!cache->queueHead) cache->queueTail = NULL;
+        if (image->state != IMAGE_QUEUED) continue; // Its importer took it
+
+        image->state = IMAGE_COMPILING;
+        image->attempted = true;
+        cache->busy++;
+        pthread_mutex_unlock(&cache->lock);
+
+        if (!vm) vm = newCompilerVM();
+        FileBuffer bytes = { NULL, 0, 0 };
+        bool saved = false;
+        bool ok = precompileModule(cache, vm, image, &bytes, &saved);
+
+        pthread_mutex_lock(&cache->lock);
+        cache->busy--;
+        image->bytes = bytes;
+        image->saved = saved;
+        image->state = ok ? IMAGE_READY : IMAGE_IMPORTER;
+        pthread_cond_broadcast(&cache->changed);
+    }
+    cache->running--;
+    pthread_cond_broadcast(&cache->changed);
+    pthread_mutex_unlock(&cache->lock);
+
+    if (vm) {
+        freeVM(vm);
+        free(vm);
+    }
+    return NULL;
+}
+
+// One worker per core the running script leaves free
+static int importThreads(bool atLeastOne) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    char* threads = getenv("UNNARIZE_IMPORT_THREADS");
+    if (threads) count = atol(threads);
+    if (count > IMPORT_MAX_THREADS) count = IMPORT_MAX_THREADS;
+    if (count < 1) count = atLeastOne ? 1 : 0;
+    return (int)count;
+}
+
+static void joinWorkers(ImportCache* cache) {
+    for (int i = 0; i < cache->threadCount; i++) pthread_join(cache->threads[i], NULL);
+    cache->threadCount = 0;
+}
+
+void precompileImports(VM* vm, const char* path, BytecodeChunk* chunk, bool writeCaches) {
+    int threads = importThreads(writeCaches);
+    if (threads == 0) return;
+    ImportCache* cache = importCache(vm);
+    pthread_mutex_lock(&cache->lock);
+    if (writeCaches) cache->writeCaches = true;
+    pthread_mutex_unlock(&cache->lock);
+
+    queueImports(cache, chunk, path);
+
+    pthread_mutex_lock(&cache->lock);
+    bool start = cache->running == 0 && cache->queueHead != NULL;
+    pthread_mutex_unlock(&cache->lock);
+    if (!start) return; // Nothing to do, or the running workers will see it
+
+    joinWorkers(cache); // Earlier ones have all left
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_lock(&cache->lock);
+        cache->running++;
+        pthread_mutex_unlock(&cache->lock);
+        if (pthread_create(&cache->threads[cache->threadCount], NULL, precompileWorker, cache) != 0) {
+            pthread_mutex_lock(&cache->lock);
+            cache->running--;
+            pthread_mutex_unlock(&cache->lock);
+            break; // Whatever stays queued is compiled by its import
+        }
+        cache->threadCount++;
+    }
+}
+
+static int compareImages(const void* a, const void* b) {
+    return strcmp((*(ModuleImage* const*)a)->path, (*(ModuleImage* const*)b)->path);
+}
+
+void finishPrecompile(VM* vm) {
+    ImportCache* cache = vm->imports;
+    if (!cache) return;
+    joinWorkers(cache); // They leave once the queue is empty and nobody is compiling
+    if (!cache->writeCaches) return;
+
+    // Report in path order, not in the order the workers finished
+    int count = 0;
+    for (ModuleImage* image = cache->images; image; image = image->next) count++;
+    ModuleImage** sorted = malloc(sizeof(ModuleImage*) * (size_t)(count > 0 ? count : 1));
+    if (!sorted) error("Memory allocation failed.", 0);
+    int n = 0;
+    for (ModuleImage* image = cache->images; image; image = image->next) sorted[n++] = image;
+    qsort(sorted, (size_t)n, sizeof(ModuleImage*), compareImages);
+    for (int i = 0; i < n; i++) {
+        ModuleImage* image = sorted[i];
+        if (image->saved) {
+            char* cachePath = bytecodeCachePath(image->path);
+            printf("Compiled %s -> %s\n", image->path, cachePath);
+            free(cachePath);
+        } else if (image->attempted && image->exists && image->state != IMAGE_READY) {
+            // A missing file is the import's to report, once, when it runs
+            fprintf(stderr, "Could not compile imported module \"%s\".\n", image->path);
+        }
+    }
+    free(sorted);
+}
+
+void freeImports(VM* vm) {
+    ImportCache* cache = vm->imports;
+    if (!cache) return;
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = true;
+    pthread_cond_broadcast(&cache->changed);
+    pthread_mutex_unlock(&cache->lock);
+    joinWorkers(cache);
+
+    for (int i = 0; i < IMPORT_BUCKETS; i++) {
+        ImportEntry* entry = cache->buckets[i];
+        while (entry) {
+            ImportEntry* next = entry->next;
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+    }
+    ModuleImage* image = cache->images;
+    while (image) {
+        ModuleImage* next = image->next;
+        fileClose(&image->bytes);
+        free(image);
+        image = next;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->changed);
+    free(cache);
+    vm->imports = NULL;
+}
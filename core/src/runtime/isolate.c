@@ -0,0 +1,515 @@
+#include "runtime/isolate.h"
+#include "bytecode/chunk.h"
+#include "bytecode/interpreter.h"
+#include "ucore_uon.h"
+#include "ucore_http.h"
+#include "ucore_timer.h"
+#include "ucore_gc.h"
+#include "ucore_system.h"
+#include "ucore_json.h"
+#include "ucore_string.h"
+#include "ucore_scraper.h"
+#include "ucore_tui.h"
+#include "ucore_array.h"
+#include "ucore_thread.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void registerCoreLibraries(VM* vm) {
+    registerUCoreUON(vm);
+    registerUCoreHttp(vm);
+    registerUCoreTimer(vm);
+    registerUCoreGC(vm);
+    registerUCoreJson(vm);
+    registerUCoreScraper(vm);
+    registerUCoreString(vm);
+    registerUCoreTui(vm);
+    registerUCoreSystem(vm);
+    registerUCoreArray(vm);
+    registerUCoreThread(vm);
+    registerBuiltins(vm); // Built-in natives (has, keys)
+}
+
+VM* isolateCreate(VM* parent, int registers) {
+    VM* vm = calloc(1, sizeof(VM));
+    if (!vm) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(1);
+    }
+    initVMWithRegisters(vm, registers > 0 ? registers : STACK_MAX);
+    vm->gcMarkThreads = 1; // Isolates already run one per core
+    vm->argc = parent->argc;
+    vm->argv = parent->argv;
+    memcpy(vm->scriptDir, parent->scriptDir, sizeof(vm->scriptDir));
+    memcpy(vm->projectRoot, parent->projectRoot, sizeof(vm->projectRoot));
+    registerCoreLibraries(vm);
+    return vm;
+}
+
+void isolateDestroy(VM* isolate) {
+    freeVM(isolate);
+    free(isolate);
+}
+
+// ---- Copying between VMs ----
+
+// Source object -> copy, so shared and cyclic references stay shared
+typedef struct {
+    Obj* from;
+    Obj* to;
+} CopyEntry;
+
+typedef struct {
+    VM* to;
+    VM* from;
+    CopyEntry* entries;
+    int count;
+    int capacity;           // Power of two
+    bool* importedSlots;    // Target global slots already filled by this copy
+    int importedCapacity;
+    bool ok;
+    bool transfer;          // Typed arrays hand over their buffers
+} CopyContext;
+
+static Value copyValue(CopyContext* ctx, Value value);
+
+static unsigned int pointerHash(Obj* object) {
+    uintptr_t x = (uintptr_t)object;
+    x ^= x >> 17;
+    x *= 0xed5ad4bbu;
+    x ^= x >> 11;
+    return (unsigned int)x;
+}
+
+static Obj* copyFind(CopyContext* ctx, Obj* from) {
+    if (ctx->capacity == 0) return NULL;
+    unsigned int mask = (unsigned int)ctx->capacity - 1;
+    for (unsigned int i = pointerHash(from) & mask;; i = (i + 1) & mask) {
+        if (!ctx->entries[i].from) return NULL;
+        if (ctx->entries[i].from == from) return ctx->entries[i].to;
+    }
+}
+
+static void copyRemember(CopyContext* ctx, Obj* from, Obj* to) {
+    if ((ctx->count + 1) * 2 > ctx->capacity) {
+        int capacity = ctx->capacity ? ctx->capacity * 2 : 64;
+        CopyEntry* entries = calloc((size_t)capacity, sizeof(CopyEntry));
+        if (!entries) exit(1);
+        for (int i = 0; i < ctx->capacity; i++) {
+            if (!ctx->entries[i].from) continue;
+            unsigned int j = pointerHash(ctx->entries[i].from) & (unsigned int)(capacity - 1);
+            while (entries[j].from) j = (j + 1) & (unsigned int)(capacity - 1);
+            entries[j] = ctx->entries[i];
+        }
+        free(ctx->entries);
+        ctx->entries = entries;
+        ctx->capacity = capacity;
+    }
+    unsigned int mask = (unsigned int)ctx->capacity - 1;
+    unsigned int i = pointerHash(from) & mask;
+    while (ctx->entries[i].from) i = (i + 1) & mask;
+    ctx->entries[i].from = from;
+    ctx->entries[i].to = to;
+    ctx->count++;
+}
+
+static void copyFailed(CopyContext* ctx, const char* what) {
+    if (ctx->ok) printf("Error: %s cannot be copied into another VM.\n", what);
+    ctx->ok = false;
+}
+
+// The target's own global of the same name (natives and core modules)
+static Value targetGlobal(CopyContext* ctx, const char* name, int length) {
+    VarEntry* entry = envFindEntry(ctx->to->globalEnv, name, length, hash(name, length));
+    return entry ? entry->value : UNDEFINED_VAL;
+}
+
+// Point a global instruction at the target's slot for the same name, and
+// give that slot the source's value the first time it is seen
+static int importGlobal(CopyContext* ctx, Environment* fromEnv, int slot) {
+    VarEntry* source = &fromEnv->vars[slot];
+    ObjString* name = internString(ctx->to, source->key, source->keyLength);
+    int target = envReserveSlot(ctx->to, ctx->to->globalEnv, name);
+
+    if (target >= ctx->importedCapacity) {
+        int capacity = ctx->importedCapacity ? ctx->importedCapacity : 64;
+        while (capacity <= target) capacity *= 2;
+        ctx->importedSlots = realloc(ctx->importedSlots, sizeof(bool) * (size_t)capacity);
+        if (!ctx->importedSlots) exit(1);
+        memset(ctx->importedSlots + ctx->importedCapacity, 0,
+               sizeof(bool) * (size_t)(capacity - ctx->importedCapacity));
+        ctx->importedCapacity = capacity;
+    }
+    if (ctx->importedSlots[target]) return target;
+    ctx->importedSlots[target] = true;
+
+    Value value = source->value;
+    if (IS_UNDEFINED(value)) return target;
+    Value copy = copyValue(ctx, value);
+    // Re-read the entry: copying may have grown the target's globals
+    VarEntry* entry = &ctx->to->globalEnv->vars[target];
+    WRITE_BARRIER(ctx->to, ctx->to->globalEnv);
+    entry->value = copy;
+    return target;
+}
+
+static bool isGlobalInstruction(uint32_t inst) {
+    uint8_t op = DECODE_OP(inst);
+    return op == OP_GETGLOBAL || op == OP_SETGLOBAL || op == OP_DEFGLOBAL;
+}
+
+static Function* copyFunction(CopyContext* ctx, Function* func) {
+    if (func->isNative) {
+        Value own = targetGlobal(ctx, func->name.start, func->name.length);
+        if (IS_OBJ(own) && AS_OBJ(own)->type == OBJ_FUNCTION && ((Function*)AS_OBJ(own))->isNative) {
+            return (Function*)AS_OBJ(own);
+        }
+        copyFailed(ctx, "A native function");
+        return NULL;
+    }
+    if (!func->bytecodeChunk) {
+        copyFailed(ctx, "An uncompiled function");
+        return NULL;
+    }
+
+    Function* copy = ALLOCATE_OBJ(ctx->to, Function, OBJ_FUNCTION);
+    copyRemember(ctx, (Obj*)func, (Obj*)copy);
+    copy->name = (Token){0};
+    copy->params = NULL;
+    copy->paramCount = func->paramCount;
+    copy->body = NULL;
+    copy->closure = NULL;
+    copy->isNative = false;
+    copy->native = NULL;
+    copy->keepsViews = false;
+    copy->isAsync = func->isAsync;
+    copy->modulePath = func->modulePath; // Owned by the parent's module table
+    copy->moduleEnv = NULL; // Everything lands in the target's globals
+
+    BytecodeChunk* src = func->bytecodeChunk;
+    BytecodeChunk* chunk = malloc(sizeof(BytecodeChunk));
+    if (!chunk) exit(1);
+    initChunk(chunk);
+    copy->bytecodeChunk = chunk;
+    chunk->code = malloc(sizeof(uint32_t) * (size_t)(src->codeSize ? src->codeSize : 1));
+    chunk->lineNumbers = malloc(sizeof(int) * (size_t)(src->codeSize ? src->codeSize : 1));
+    if (!chunk->code || !chunk->lineNumbers) exit(1);
+    memcpy(chunk->code, src->code, sizeof(uint32_t) * (size_t)src->codeSize);
+    memcpy(chunk->lineNumbers, src->lineNumbers, sizeof(int) * (size_t)src->codeSize);
+    chunk->codeSize = chunk->codeCapacity = chunk->lineCapacity = src->codeSize;
+    chunk->maxRegs = src->maxRegs;
+
+    // Constants keep their indices; the code's global slots are renumbered
+    for (int i = 0; i < src->constantCount; i++) {
+        addConstant(chunk, copyValue(ctx, src->constants[i]));
+    }
+    Environment* fromEnv = func->moduleEnv ? func->moduleEnv : ctx->from->globalEnv;
+    for (int i = 0; i < chunk->codeSize; i++) {
+        uint32_t inst = chunk->code[i];
+        if (!isGlobalInstruction(inst)) continue;
+        int slot = importGlobal(ctx, fromEnv, DECODE_Bx(inst));
+        chunk->code[i] = ENCODE_ABx(DECODE_OP(inst), DECODE_A(inst), slot);
+    }
+
+    // The name must live as long as the function: keep it in its constants
+    ObjString* name = internString(ctx->to, func->name.start ? func->name.start : "", func->name.length);
+    addConstant(chunk, OBJ_VAL(name));
+    copy->name.type = TOKEN_IDENTIFIER;
+    copy->name.start = name->chars;
+    copy->name.length = name->length;
+    copy->name.line = func->name.line;
+    return copy;
+}
+
+static StructDef* copyStructDef(CopyContext* ctx, StructDef* def) {
+    Obj* seen = copyFind(ctx, (Obj*)def);
+    if (seen) return (StructDef*)seen;
+    StructDef* copy = ALLOCATE_OBJ(ctx->to, StructDef, OBJ_STRUCT_DEF);
+    copyRemember(ctx, (Obj*)def, (Obj*)copy);
+    ObjString* name = internString(ctx->to, def->name, (int)strlen(def->name));
+    pinObject(ctx->to, (Obj*)name); // StructDef names are borrowed, not traced
+    copy->name = name->chars;
+    copy->fieldCount = def->fieldCount;
+    copy->fields = malloc(sizeof(char*) * (size_t)(def->fieldCount ? def->fieldCount : 1));
+    if (!copy->fields) exit(1);
+    for (int i = 0; i < def->fieldCount; i++) copy->fields[i] = strdup(def->fields[i]);
+    return copy;
+}
+
+static Value copyValue(CopyContext* ctx, Value value) {
+    if (!IS_OBJ(value) || !ctx->ok) return IS_OBJ(value) ? NIL_VAL : value;
+    Obj* object = AS_OBJ(value);
+
+    switch (object->type) {
+        case OBJ_STRING: {
+            ObjString* s = (ObjString*)object;
+            return OBJ_VAL(internString(ctx->to, s->chars, s->length));
+        }
+        case OBJ_STRING_BUILDER: {
+            StringBuilder* sb = (StringBuilder*)object;
+            return OBJ_VAL(internString(ctx->to, sb->chars, sb->length));
+        }
+        case OBJ_STRING_SLICE: {
+            StringSlice* slice = (StringSlice*)object;
+            return OBJ_VAL(internString(ctx->to, slice->chars, slice->length));
+        }
+        default:
+            break;
+    }
+
+    Obj* seen = copyFind(ctx, object);
+    if (seen) return OBJ_VAL(seen);
+
+    switch (object->type) {
+        case OBJ_ARRAY: {
+            Array* array = (Array*)object;
+            Array* copy = newArray(ctx->to);
+            copyRemember(ctx, object, (Obj*)copy);
+            for (int i = 0; i < array->count; i++) {
+                arrayPush(ctx->to, copy, copyValue(ctx, array->items[i]));
+            }
+            return OBJ_VAL(copy);
+        }
+        case OBJ_MAP: {
+            Map* map = (Map*)object;
+            Map* copy = newMap(ctx->to);
+            copyRemember(ctx, object, (Obj*)copy);
+            for (int i = 0; i < map->count; i++) {
+                MapEntry* e = &map->entries[i];
+                Value v = copyValue(ctx, e->value);
+                if (e->isIntKey) mapSetInt(copy, e->intKey, v);
+                else mapSetStr(copy, e->key, e->keyLength, v);
+            }
+            return OBJ_VAL(copy);
+        }
+        case OBJ_TYPED_ARRAY: {
+            TypedArray* ta = (TypedArray*)object;
+            size_t bytes = (size_t)ta->count * typedElementSize(ta->kind);
+            if (ctx->transfer) {
+                // The buffer changes owner; the source is left empty
+                TypedArray* moved = newTypedArray(ctx->to, ta->kind, 0);
+                copyRemember(ctx, object, (Obj*)moved);
+                free(moved->data);
+                moved->data = ta->data;
+                moved->count = ta->count;
+                ctx->to->bytesAllocated += bytes;
+                ta->data = calloc(1, typedElementSize(ta->kind));
+                if (!ta->data) exit(1);
+                ta->count = 0;
+                ctx->from->bytesAllocated -= bytes;
+                return OBJ_VAL(moved);
+            }
+            TypedArray* copy = newTypedArray(ctx->to, ta->kind, ta->count);
+            copyRemember(ctx, object, (Obj*)copy);
+            memcpy(copy->data, ta->data, bytes);
+            return OBJ_VAL(copy);
+        }
+        case OBJ_STRUCT_DEF:
+            return OBJ_VAL(copyStructDef(ctx, (StructDef*)object));
+        case OBJ_STRUCT_INSTANCE: {
+            StructInstance* inst = (StructInstance*)object;
+            StructDef* def = copyStructDef(ctx, inst->def);
+            StructInstance* copy = newStructInstance(ctx->to, def); // Fields nil until copied
+            copyRemember(ctx, object, (Obj*)copy);
+            for (int i = 0; i < def->fieldCount; i++) {
+                copy->fields[i] = copyValue(ctx, inst->fields[i]);
+            }
+            return OBJ_VAL(copy);
+        }
+        case OBJ_FUNCTION: {
+            Function* copy = copyFunction(ctx, (Function*)object);
+            return copy ? OBJ_VAL(copy) : NIL_VAL;
+        }
+        case OBJ_MODULE: {
+            Module* module = (Module*)object;
+            Value own = targetGlobal(ctx, module->name, (int)strlen(module->name));
+            if (IS_OBJ(own) && AS_OBJ(own)->type == OBJ_MODULE) return own;
+            copyFailed(ctx, "An imported module");
+            return NIL_VAL;
+        }
+        case OBJ_RESOURCE: {
+            ObjResource* res = (ObjResource*)object;
+            if (!res->share) {
+                copyFailed(ctx, "A resource (open file, cursor or socket)");
+                return NIL_VAL;
+            }
+            // A second handle to the same resource (channels)
+            ObjResource* copy = ALLOCATE_OBJ(ctx->to, ObjResource, OBJ_RESOURCE);
+            copyRemember(ctx, object, (Obj*)copy);
+            copy->data = res->share(res->data);
+            copy->cleanup = res->cleanup;
+            copy->next = res->next;
+            copy->share = res->share;
+            return OBJ_VAL(copy);
+        }
+        case OBJ_FUTURE:
+            copyFailed(ctx, "A future");
+            return NIL_VAL;
+        default:
+            copyFailed(ctx, "A value of this type");
+            return NIL_VAL;
+    }
+}
+
+static Value copyBetween(VM* to, VM* from, Value value, bool transfer, bool* ok) {
+    CopyContext ctx = { to, from, NULL, 0, 0, NULL, 0, true, transfer };
+    // Nothing is reachable from the target's roots until the caller stores
+    // the result, so no collection may run until then
+    deferCollections(to);
+    Value copy = copyValue(&ctx, value);
+    resumeCollections(to);
+    free(ctx.entries);
+    free(ctx.importedSlots);
+    if (ok) *ok = ctx.ok;
+    return ctx.ok ? copy : NIL_VAL;
+}
+
+Value isolateCopy(VM* to, VM* from, Value value, bool* ok) {
+    return copyBetween(to, from, value, false, ok);
+}
+
+Value isolateTransfer(VM* to, VM* from, Value value, bool* ok) {
+    return copyBetween(to, from, value, true, ok);
+}
+
+// ---- Parallel map ----
+
+typedef struct {
+    VM* vm;                 // Isolate owning everything below
+    Partition part;
+    PreparedCall map;
+    PreparedCall reduce;
+    bool hasReduce;
+    int resultSlot;         // vm->stack slot: results Array, or the accumulator
+    bool hasResult;
+} MapJob;
+
+static void* runMapJob(void* arg) {
+    MapJob* job = (MapJob*)arg;
+    VM* vm = job->vm;
+    Array* results = NULL;
+    if (!job->hasReduce) {
+        results = newArray(vm);
+        vm->stack[job->resultSlot] = OBJ_VAL(results);
+        job->hasResult = true;
+    }
+    int recordSlot = vm->stackTop++;
+    vm->stack[recordSlot] = NIL_VAL;
+
+    Value record;
+    while (job->part.next(vm, job->part.state, &record)) {
+        vm->stack[recordSlot] = record;
+        Value result = callPrepared(vm, &job->map, &vm->stack[recordSlot]);
+        if (IS_NIL(result)) continue;
+        if (results) {
+            arrayPush(vm, results, result);
+        } else if (!job->hasResult) {
+            vm->stack[job->resultSlot] = result;
+            job->hasResult = true;
+        } else {
+            Value args[2] = { vm->stack[job->resultSlot], result };
+            vm->stack[job->resultSlot] = callPrepared(vm, &job->reduce, args);
+        }
+    }
+    vm->stackTop = recordSlot;
+    return NULL;
+}
+
+bool isolateParallelMap(VM* vm, Function* fn, Function* reduce,
+                        Partition* parts, int count, Value* out) {
+    *out = NIL_VAL;
+    PreparedCall mapCall, reduceCall;
+    if (!prepareCall(fn, 1, &mapCall)) {
+        printf("Error: parallelMap function must take one argument (the record).\n");
+        return false;
+    }
+    if (reduce && !prepareCall(reduce, 2, &reduceCall)) {
+        printf("Error: parallelMap reduce function must take two arguments.\n");
+        return false;
+    }
+
+    // Isolates are built here, one after another, while this VM is idle
+    MapJob* jobs = calloc((size_t)count, sizeof(MapJob));
+    pthread_t* threads = calloc((size_t)count, sizeof(pthread_t));
+    if (!jobs || !threads) exit(1);
+    bool ok = true;
+    int created = 0;
+    for (int i = 0; i < count && ok; i++) {
+        MapJob* job = &jobs[i];
+        job->vm = isolateCreate(vm, 0);
+        created++;
+        job->part = parts[i];
+        job->hasReduce = reduce != NULL;
+
+        Value mapFn = isolateCopy(job->vm, vm, OBJ_VAL(fn), &ok);
+        job->resultSlot = job->vm->stackTop;
+        job->vm->stack[job->vm->stackTop++] = NIL_VAL;
+        job->vm->stack[job->vm->stackTop++] = mapFn; // Root the imported code
+        if (!ok) break;
+        prepareCall((Function*)AS_OBJ(mapFn), 1, &job->map);
+        if (reduce) {
+            Value reduceFn = isolateCopy(job->vm, vm, OBJ_VAL(reduce), &ok);
+            job->vm->stack[job->vm->stackTop++] = reduceFn;
+            if (!ok) break;
+            prepareCall((Function*)AS_OBJ(reduceFn), 2, &job->reduce);
+        }
+    }
+
+    int started = 0;
+    if (ok) {
+        for (; started < count; started++) {
+            if (pthread_create(&threads[started], NULL, runMapJob, &jobs[started]) != 0) break;
+        }
+        // Fewer threads than partitions: run the rest here
+        for (int i = started; i < count; i++) runMapJob(&jobs[i]);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    }
+
+    // Merge: copy each partition's results back in order, then fold. The
+    // copies are unreachable until pushed, so collections wait until the end
+    if (ok) {
+        int base = vm->stackTop;
+        deferCollections(vm);
+        Array* merged = newArray(vm);
+        vm->stack[vm->stackTop++] = OBJ_VAL(merged);
+        for (int i = 0; i < count && ok; i++) {
+            MapJob* job = &jobs[i];
+            if (!job->hasResult) continue;
+            CopyContext ctx = { vm, job->vm, NULL, 0, 0, NULL, 0, true, false };
+            Value part = job->vm->stack[job->resultSlot];
+            if (!reduce) {
+                Array* items = (Array*)AS_OBJ(part);
+                for (int k = 0; k < items->count && ctx.ok; k++) {
+                    arrayPush(vm, merged, copyValue(&ctx, items->items[k]));
+                }
+            } else {
+                arrayPush(vm, merged, copyValue(&ctx, part));
+            }
+            free(ctx.entries);
+            free(ctx.importedSlots);
+            ok = ctx.ok;
+        }
+        resumeCollections(vm);
+        if (!ok) {
+            *out = NIL_VAL;
+        } else if (!reduce) {
+            *out = OBJ_VAL(merged);
+        } else if (merged->count > 0) {
+            int accSlot = vm->stackTop++;
+            vm->stack[accSlot] = merged->items[0];
+            for (int i = 1; i < merged->count; i++) {
+                Value args[2] = { vm->stack[accSlot], merged->items[i] };
+                vm->stack[accSlot] = callPrepared(vm, &reduceCall, args);
+            }
+            *out = vm->stack[accSlot];
+        }
+        vm->stackTop = base;
+    }
+
+    for (int i = 0; i < created; i++) isolateDestroy(jobs[i].vm);
+    free(jobs);
+    free(threads);
+    return ok;
+}
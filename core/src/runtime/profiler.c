@@ -0,0 +1,523 @@
+#include "runtime/profiler.h"
+
+#ifdef UNNARIZE_PROFILE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define PROFILE_SAMPLE_INTERVAL_US 1000        // SIGPROF every millisecond of CPU time
+#define PROFILE_SAMPLE_WORDS (4u * 1024 * 1024) // Sample buffer, touched only as it fills
+#define PROFILE_TOP_FUNCTIONS 30
+#define PROFILE_TOP_LINES 20
+
+static uint64_t nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ===== Entries =====
+
+static uint32_t hashFunction(Function* fn) {
+    uintptr_t key = (uintptr_t)fn >> 4;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static void growEntries(Profiler* p) {
+    int capacity = p->capacity ? p->capacity * 2 : 256;
+    ProfileEntry** slots = calloc((size_t)capacity, sizeof(ProfileEntry*));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed for the profiler.\n");
+        exit(1);
+    }
+    for (int i = 0; i < p->capacity; i++) {
+        ProfileEntry* e = p->slots[i];
+        if (!e) continue;
+        uint32_t h = hashFunction(e->function) & (uint32_t)(capacity - 1);
+        while (slots[h]) h = (h + 1) & (uint32_t)(capacity - 1);
+        slots[h] = e;
+    }
+    free(p->slots);
+    p->slots = slots;
+    p->capacity = capacity;
+}
+
+static char* entryName(Function* fn) {
+    if (fn->name.length > 0 && strncmp(fn->name.start, "<script>", 8) != 0) {
+        return strndup(fn->name.start, (size_t)fn->name.length);
+    }
+    // Scripts and modules are named after their file
+    const char* path = fn->modulePath ? fn->modulePath : "?";
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = strlen(base) + 3;
+    char* name = malloc(len);
+    snprintf(name, len, "<%s>", base);
+    return name;
+}
+
+// A freed Function whose address is reused merges into the old entry;
+// names are copied so the report never reads a collected object.
+static ProfileEntry* entryFor(Profiler* p, Function* fn) {
+    if ((p->count + 1) * 4 > p->capacity * 3) growEntries(p);
+    uint32_t mask = (uint32_t)(p->capacity - 1);
+    uint32_t h = hashFunction(fn) & mask;
+    while (p->slots[h]) {
+        if (p->slots[h]->function == fn) return p->slots[h];
+        h = (h + 1) & mask;
+    }
+
+    ProfileEntry* e = calloc(1, sizeof(ProfileEntry));
+    if (!e) {
+        fprintf(stderr, "Memory allocation failed for the profiler.\n");
+        exit(1);
+    }
+    e->function = fn;
+    e->name = entryName(fn);
+    e->file = !fn->isNative && fn->modulePath ? strdup(fn->modulePath) : NULL;
+    e->chunk = fn->isNative ? NULL : fn->bytecodeChunk;
+    if (p->mode == PROFILE_COUNT && e->chunk && e->chunk->codeSize > 0) {
+        e->hits = calloc((size_t)e->chunk->codeSize, sizeof(uint64_t));
+    }
+    p->slots[h] = e;
+    p->count++;
+    return e;
+}
+
+// ===== Hooks =====
+
+void profileEnter(VM* vm, CallFrame* frame, Function* fn) {
+    Profiler* p = vm->profiler;
+    ProfileEntry* e = entryFor(p, fn);
+    e->calls++;
+    p->counters.functionCalls++;
+    frame->profNative = NULL;
+    frame->profChildren = 0;
+    frame->profStart = p->mode == PROFILE_COUNT ? nowNanos() : 0;
+    e->active++;
+    frame->profEntry = e; // Last: the sampler may read the frame at any time
+}
+
+void profileLeave(VM* vm, CallFrame* frame) {
+    Profiler* p = vm->profiler;
+    ProfileEntry* e = frame->profEntry;
+    if (!e) return;
+    frame->profEntry = NULL;
+    e->active--;
+    if (p->mode != PROFILE_COUNT) return;
+
+    uint64_t elapsed = nowNanos() - frame->profStart;
+    if (e->active == 0) e->totalNanos += elapsed;
+    e->selfNanos += elapsed > frame->profChildren ? elapsed - frame->profChildren : 0;
+    if (frame > vm->callStack) (frame - 1)->profChildren += elapsed;
+}
+
+void profileNativeBegin(VM* vm, Function* fn, ProfileNativeCall* call) {
+    Profiler* p = vm->profiler;
+    call->frame = vm->callStackTop > 0 ? &vm->callStack[vm->callStackTop - 1] : NULL;
+    call->entry = entryFor(p, fn);
+    call->entry->calls++;
+    call->entry->active++;
+    p->counters.functionCalls++;
+    call->prevNative = NULL;
+    call->children = 0;
+    if (call->frame) {
+        call->prevNative = call->frame->profNative;
+        call->children = call->frame->profChildren;
+        call->frame->profNative = call->entry;
+    }
+    call->start = p->mode == PROFILE_COUNT ? nowNanos() : 0;
+}
+
+void profileNativeEnd(VM* vm, ProfileNativeCall* call) {
+    Profiler* p = vm->profiler;
+    ProfileEntry* e = call->entry;
+    e->active--;
+    if (p->mode == PROFILE_COUNT) {
+        // Bytecode called back from the native is its child, not its self time
+        uint64_t elapsed = nowNanos() - call->start;
+        uint64_t inner = call->frame ? call->frame->profChildren - call->children : 0;
+        if (e->active == 0) e->totalNanos += elapsed;
+        e->selfNanos += elapsed > inner ? elapsed - inner : 0;
+        if (call->frame) call->frame->profChildren = call->children + elapsed;
+    }
+    if (call->frame) call->frame->profNative = call->prevNative;
+}
+
+uint64_t* profileHits(VM* vm, BytecodeChunk* chunk) {
+    Profiler* p = vm->profiler;
+    if (!p || p->mode != PROFILE_COUNT || vm->callStackTop <= 0) return NULL;
+    ProfileEntry* e = vm->callStack[vm->callStackTop - 1].profEntry;
+    return e && e->chunk == chunk ? e->hits : NULL;
+}
+
+// ===== Sampling =====
+
+static Profiler* g_sampleProfiler = NULL;
+static VM* g_sampleVM = NULL;
+static struct sigaction g_prevAction;
+
+// Async-signal-safe: copies the entries of the running call stack into the
+// preallocated buffer, frames bottom-up with each frame's native after it
+static void sampleHandler(int sig) {
+    (void)sig;
+    Profiler* p = g_sampleProfiler;
+    VM* vm = g_sampleVM;
+    if (!p || !vm) return;
+    CallFrame* frames = vm->callStack;
+    int top = vm->callStackTop;
+    if (!frames || top <= 0) return;
+    if (top > CALL_STACK_MAX) top = CALL_STACK_MAX;
+
+    size_t need = 1 + 2 * (size_t)top;
+    if (p->sampleUsed + need > p->sampleCapacity) {
+        p->samplesDropped++;
+        return;
+    }
+    void** out = &p->samples[p->sampleUsed + 1];
+    size_t depth = 0;
+    for (int i = 0; i < top; i++) {
+        if (frames[i].profEntry) out[depth++] = frames[i].profEntry;
+        if (frames[i].profNative) out[depth++] = frames[i].profNative;
+    }
+    if (depth == 0) return;
+    p->samples[p->sampleUsed] = (void*)(uintptr_t)depth;
+    p->sampleUsed += 1 + depth;
+    p->sampleCount++;
+}
+
+static void startSampling(VM* vm, Profiler* p) {
+    p->sampleCapacity = PROFILE_SAMPLE_WORDS;
+    p->samples = malloc(p->sampleCapacity * sizeof(void*));
+    if (!p->samples) {
+        fprintf(stderr, "Memory allocation failed for the profiler.\n");
+        exit(1);
+    }
+    g_sampleProfiler = p;
+    g_sampleVM = vm;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sampleHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, &g_prevAction);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILE_SAMPLE_INTERVAL_US;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+static void stopSampling(void) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    sigaction(SIGPROF, &g_prevAction, NULL);
+    g_sampleProfiler = NULL;
+    g_sampleVM = NULL;
+}
+
+typedef struct {
+    char* stack;
+    uint64_t count;
+} FoldedStack;
+
+static bool writeFolded(Profiler* p) {
+    FILE* out = fopen(p->foldedPath, "w");
+    if (!out) return false;
+
+    // Identical stacks are merged through a string-keyed table
+    int capacity = 1024;
+    int count = 0;
+    FoldedStack* table = calloc((size_t)capacity, sizeof(FoldedStack));
+    size_t bufCap = 4096;
+    char* buf = malloc(bufCap);
+
+    size_t pos = 0;
+    while (pos < p->sampleUsed) {
+        size_t depth = (size_t)(uintptr_t)p->samples[pos];
+        size_t len = 0;
+        for (size_t i = 0; i < depth; i++) {
+            ProfileEntry* e = p->samples[pos + 1 + i];
+            size_t n = strlen(e->name);
+            if (len + n + 2 > bufCap) {
+                while (len + n + 2 > bufCap) bufCap *= 2;
+                buf = realloc(buf, bufCap);
+            }
+            if (i > 0) buf[len++] = ';';
+            memcpy(buf + len, e->name, n);
+            len += n;
+        }
+        buf[len] = '\0';
+        pos += 1 + depth;
+
+        if ((count + 1) * 2 > capacity) {
+            int newCapacity = capacity * 2;
+            FoldedStack* grown = calloc((size_t)newCapacity, sizeof(FoldedStack));
+            for (int i = 0; i < capacity; i++) {
+                if (!table[i].stack) continue;
+                uint32_t h = 2166136261u;
+                for (const char* c = table[i].stack; *c; c++) h = (h ^ (uint8_t)*c) * 16777619u;
+                uint32_t slot = h & (uint32_t)(newCapacity - 1);
+                while (grown[slot].stack) slot = (slot + 1) & (uint32_t)(newCapacity - 1);
+                grown[slot] = table[i];
+            }
+            free(table);
+            table = grown;
+            capacity = newCapacity;
+        }
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)buf[i]) * 16777619u;
+        uint32_t slot = h & (uint32_t)(capacity - 1);
+        while (table[slot].stack && strcmp(table[slot].stack, buf) != 0) {
+            slot = (slot + 1) & (uint32_t)(capacity - 1);
+        }
+        if (!table[slot].stack) {
+            table[slot].stack = strdup(buf);
+            count++;
+        }
+        table[slot].count++;
+    }
+
+    for (int i = 0; i < capacity; i++) {
+        if (!table[i].stack) continue;
+        fprintf(out, "%s %llu\n", table[i].stack, (unsigned long long)table[i].count);
+        free(table[i].stack);
+    }
+    free(table);
+    free(buf);
+    return fclose(out) == 0;
+}
+
+// ===== Report =====
+
+typedef struct {
+    const char* file;
+    int line;
+    uint64_t hits;
+} LineHits;
+
+static int compareSelfTime(const void* a, const void* b) {
+    const ProfileEntry* x = *(ProfileEntry* const*)a;
+    const ProfileEntry* y = *(ProfileEntry* const*)b;
+    if (x->selfNanos != y->selfNanos) return x->selfNanos < y->selfNanos ? 1 : -1;
+    return x->calls < y->calls ? 1 : (x->calls > y->calls ? -1 : 0);
+}
+
+static int compareLinePosition(const void* a, const void* b) {
+    const LineHits* x = a;
+    const LineHits* y = b;
+    int c = strcmp(x->file, y->file);
+    if (c != 0) return c;
+    return x->line - y->line;
+}
+
+static int compareLineHits(const void* a, const void* b) {
+    const LineHits* x = a;
+    const LineHits* y = b;
+    if (x->hits != y->hits) return x->hits < y->hits ? 1 : -1;
+    return compareLinePosition(a, b);
+}
+
+static int compareOpCounts(const void* a, const void* b) {
+    uint64_t x = ((const uint64_t*)a)[0];
+    uint64_t y = ((const uint64_t*)b)[0];
+    return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Print line 'line' of 'path', trimmed; the last file read is kept
+static void printSourceLine(const char* path, int line) {
+    static char* cachedPath = NULL;
+    static char* cachedSource = NULL;
+    if (!path) {
+        free(cachedPath);
+        free(cachedSource);
+        cachedPath = cachedSource = NULL;
+        return;
+    }
+    if (!cachedPath || strcmp(cachedPath, path) != 0) {
+        free(cachedPath);
+        free(cachedSource);
+        cachedPath = strdup(path);
+        cachedSource = NULL;
+        FILE* f = fopen(path, "rb");
+        if (f) {
+            fseek(f, 0L, SEEK_END);
+            long size = ftell(f);
+            rewind(f);
+            cachedSource = malloc((size_t)size + 1);
+            size_t n = fread(cachedSource, 1, (size_t)size, f);
+            cachedSource[n] = '\0';
+            fclose(f);
+        }
+    }
+    if (!cachedSource) return;
+
+    const char* s = cachedSource;
+    for (int l = 1; l < line && *s; s++) {
+        if (*s == '\n') l++;
+    }
+    while (*s == ' ' || *s == '\t') s++;
+    const char* end = s;
+    while (*end && *end != '\n' && *end != '\r') end++;
+    int len = (int)(end - s);
+    if (len > 60) len = 60;
+    fprintf(stderr, "  %.*s", len, s);
+}
+
+static void printReport(Profiler* p) {
+    uint64_t totalInstructions = 0;
+    for (int i = 0; i < OPCODE_COUNT; i++) totalInstructions += p->opCounts[i];
+    p->counters.instructionsExecuted = totalInstructions;
+    double totalMs = (double)p->counters.totalTimeMicros / 1000.0;
+    fflush(stdout); // Keep the script's own output ahead of the report
+
+    fprintf(stderr, "\n== Profile: %.3f ms, %llu instructions, %llu calls, %llu loop iterations ==\n",
+            totalMs, (unsigned long long)totalInstructions,
+            (unsigned long long)p->counters.functionCalls,
+            (unsigned long long)p->counters.loopsExecuted);
+
+    // Functions by self time
+    ProfileEntry** entries = malloc(sizeof(ProfileEntry*) * (size_t)(p->count ? p->count : 1));
+    int n = 0;
+    for (int i = 0; i < p->capacity; i++) {
+        if (p->slots[i]) entries[n++] = p->slots[i];
+    }
+    qsort(entries, (size_t)n, sizeof(ProfileEntry*), compareSelfTime);
+    double allNanos = (double)p->counters.totalTimeMicros * 1000.0;
+    fprintf(stderr, "\nFunctions (by self time)\n");
+    fprintf(stderr, "%12s %12s %12s %7s  %s\n", "calls", "total ms", "self ms", "self %", "function");
+    for (int i = 0; i < n && i < PROFILE_TOP_FUNCTIONS; i++) {
+        ProfileEntry* e = entries[i];
+        fprintf(stderr, "%12llu %12.3f %12.3f %6.1f%%  %s",
+                (unsigned long long)e->calls, (double)e->totalNanos / 1e6,
+                (double)e->selfNanos / 1e6,
+                allNanos > 0 ? 100.0 * (double)e->selfNanos / allNanos : 0.0, e->name);
+        if (e->file) {
+            const char* base = strrchr(e->file, '/');
+            fprintf(stderr, " (%s)", base ? base + 1 : e->file);
+        } else {
+            fprintf(stderr, " (native)");
+        }
+        fprintf(stderr, "\n");
+    }
+
+    // Opcodes by count
+    uint64_t ops[OPCODE_COUNT][2];
+    int opCount = 0;
+    for (int i = 0; i < OPCODE_COUNT; i++) {
+        if (p->opCounts[i] == 0) continue;
+        ops[opCount][0] = p->opCounts[i];
+        ops[opCount][1] = (uint64_t)i;
+        opCount++;
+    }
+    qsort(ops, (size_t)opCount, sizeof(ops[0]), compareOpCounts);
+    fprintf(stderr, "\nOpcodes\n");
+    fprintf(stderr, "%14s %7s  %s\n", "count", "%", "opcode");
+    for (int i = 0; i < opCount; i++) {
+        const OpcodeInfo* info = getOpcodeInfo((OpCode)ops[i][1]);
+        fprintf(stderr, "%14llu %6.1f%%  %s\n", (unsigned long long)ops[i][0],
+                100.0 * (double)ops[i][0] / (double)totalInstructions,
+                info && info->name ? info->name : "?");
+    }
+
+    // Source lines, instruction hits mapped through lineNumbers
+    size_t lineCap = 256, lineCount = 0;
+    LineHits* lines = malloc(lineCap * sizeof(LineHits));
+    for (int i = 0; i < n; i++) {
+        ProfileEntry* e = entries[i];
+        if (!e->hits || !e->file || !e->chunk->lineNumbers) continue;
+        for (int pc = 0; pc < e->chunk->codeSize; pc++) {
+            if (!e->hits[pc]) continue;
+            if (lineCount == lineCap) {
+                lineCap *= 2;
+                lines = realloc(lines, lineCap * sizeof(LineHits));
+            }
+            lines[lineCount++] = (LineHits){e->file, e->chunk->lineNumbers[pc], e->hits[pc]};
+        }
+    }
+    qsort(lines, lineCount, sizeof(LineHits), compareLinePosition);
+    size_t merged = 0;
+    for (size_t i = 0; i < lineCount; i++) {
+        if (merged > 0 && compareLinePosition(&lines[merged - 1], &lines[i]) == 0) {
+            lines[merged - 1].hits += lines[i].hits;
+        } else {
+            lines[merged++] = lines[i];
+        }
+    }
+    qsort(lines, merged, sizeof(LineHits), compareLineHits);
+    fprintf(stderr, "\nLines (instructions executed)\n");
+    fprintf(stderr, "%14s %7s  %s\n", "hits", "%", "line");
+    for (size_t i = 0; i < merged && i < PROFILE_TOP_LINES; i++) {
+        const char* base = strrchr(lines[i].file, '/');
+        fprintf(stderr, "%14llu %6.1f%%  %s:%d", (unsigned long long)lines[i].hits,
+                100.0 * (double)lines[i].hits / (double)totalInstructions,
+                base ? base + 1 : lines[i].file, lines[i].line);
+        printSourceLine(lines[i].file, lines[i].line);
+        fprintf(stderr, "\n");
+    }
+    printSourceLine(NULL, 0);
+
+    free(lines);
+    free(entries);
+}
+
+// ===== Lifecycle =====
+
+void profilerStart(VM* vm, ProfileMode mode, const char* foldedPath) {
+    Profiler* p = calloc(1, sizeof(Profiler));
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed for the profiler.\n");
+        exit(1);
+    }
+    p->mode = mode;
+    p->foldedPath = foldedPath ? strdup(foldedPath) : NULL;
+    p->startNanos = nowNanos();
+    p->counters.startTimeMicros = p->startNanos / 1000;
+    growEntries(p);
+    vm->profiler = p;
+    if (mode == PROFILE_SAMPLE) startSampling(vm, p);
+}
+
+void profilerStop(VM* vm) {
+    Profiler* p = vm->profiler;
+    if (!p) return;
+    if (p->mode == PROFILE_SAMPLE) stopSampling();
+    vm->profiler = NULL;
+    p->counters.totalTimeMicros = (nowNanos() - p->startNanos) / 1000;
+
+    if (p->mode == PROFILE_COUNT) {
+        printReport(p);
+    } else if (writeFolded(p)) {
+        fprintf(stderr, "Profile: %llu samples written to %s",
+                (unsigned long long)p->sampleCount, p->foldedPath);
+        if (p->samplesDropped) {
+            fprintf(stderr, " (%llu dropped)", (unsigned long long)p->samplesDropped);
+        }
+        fprintf(stderr, "\n");
+    } else {
+        fprintf(stderr, "Could not write \"%s\": %s\n", p->foldedPath, strerror(errno));
+    }
+
+    for (int i = 0; i < p->capacity; i++) {
+        ProfileEntry* e = p->slots[i];
+        if (!e) continue;
+        free(e->name);
+        free(e->file);
+        free(e->hits);
+        free(e);
+    }
+    free(p->slots);
+    free(p->samples);
+    free(p->foldedPath);
+    free(p);
+}
+
+#endif // UNNARIZE_PROFILE
@@ -0,0 +1,371 @@
+#include "runtime/scheduler.h"
+#include "bytecode/interpreter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <ucontext.h>
+
+/**
+ * Cooperative Async Scheduler
+ *
+ * Only one coroutine touches the VM at a time. The main program drives the
+ * scheduler loop whenever it has to wait; tasks never run the loop, they
+ * just swap back to whoever resumed them. A suspended coroutine's
+ * registers and frames stay in its own buffers, so interpreter locals
+ * (regs, ip) remain valid across a switch.
+ */
+
+#define TASK_CSTACK_SIZE (512 * 1024)
+
+// What a suspended coroutine is waiting for (at most one of future / fds)
+typedef struct TaskWait {
+    Future* future;
+    struct pollfd* fds;     // The waiter's own array; revents are filled in
+    int nfds;               // 0 when not waiting on a socket or pipe
+    bool fdReady;
+    uint64_t wakeAt;        // Monotonic microseconds, 0 = no deadline
+} TaskWait;
+
+struct Task {
+    Future* future;         // The Future this task will resolve
+    Function* func;         // Function to execute
+    Value* args;            // Arguments array (owned copy)
+    int argCount;           // Number of arguments
+    bool started;           // Has execution started?
+    bool completed;         // Is execution complete?
+    bool running;           // Executing, or suspended as a resumer of another task
+    ExecState exec;         // Saved VM state while suspended
+    TaskWait wait;
+    ucontext_t ctx;
+    ucontext_t* resumer;    // Context to swap back to on yield
+    void* cstack;
+};
+
+// makecontext() only passes ints, so the entry point reads these
+static _Thread_local VM* g_startVM = NULL;   // Per thread: each isolate runs its own tasks
+static _Thread_local Task* g_startTask = NULL;
+
+static uint64_t monotonicMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static void clearWait(TaskWait* w) {
+    w->future = NULL;
+    w->fds = NULL;
+    w->nfds = 0;
+    w->fdReady = false;
+    w->wakeAt = 0;
+}
+
+static bool waitSatisfied(TaskWait* w, uint64_t now) {
+    if (w->future) return w->future->done;
+    if (w->nfds > 0 && w->fdReady) return true;
+    if (w->wakeAt) return now >= w->wakeAt;
+    return w->nfds == 0; // Plain yield: runnable
+}
+
+static void saveExec(VM* vm, ExecState* e) {
+    e->registers = vm->registers;
+    e->regBase = vm->regBase;
+    e->regTop = vm->regTop;
+    e->callStack = vm->callStack;
+    e->callStackTop = vm->callStackTop;
+    e->globalEnv = vm->globalEnv;
+}
+
+static void loadExec(VM* vm, ExecState* e) {
+    vm->registers = e->registers;
+    vm->regBase = e->regBase;
+    vm->regTop = e->regTop;
+    vm->callStack = e->callStack;
+    vm->callStackTop = e->callStackTop;
+    vm->globalEnv = e->globalEnv;
+}
+
+// Run 't' until it yields or finishes, then restore the caller's state
+static void switchToTask(VM* vm, Task* t) {
+    ExecState saved;
+    saveExec(vm, &saved);
+    saved.prev = vm->suspendedExec;
+    vm->suspendedExec = &saved;
+
+    Task* prevTask = vm->currentTask;
+    ucontext_t here;
+    t->resumer = &here;
+    t->running = true;
+    loadExec(vm, &t->exec);
+    vm->currentTask = t;
+
+    swapcontext(&here, &t->ctx);
+
+    saveExec(vm, &t->exec);
+    t->running = false;
+    vm->currentTask = prevTask;
+    vm->suspendedExec = saved.prev;
+    loadExec(vm, &saved);
+}
+
+// Suspend the current task until its wait is satisfied
+static void taskYield(VM* vm) {
+    Task* t = vm->currentTask;
+    swapcontext(&t->ctx, t->resumer);
+}
+
+static void resolveFuture(VM* vm, Future* f, Value v) {
+    pthread_mutex_lock(&f->mu);
+    f->result = v;
+    WRITE_BARRIER(vm, f);
+    f->done = true;
+    pthread_cond_broadcast(&f->cv);
+    pthread_mutex_unlock(&f->mu);
+}
+
+static void taskEntry(void) {
+    VM* vm = g_startVM;
+    Task* t = g_startTask;
+
+    Value result;
+    if (t->func->isNative) {
+        result = t->func->native(vm, t->args, t->argCount);
+    } else {
+        result = callBytecodeFunction(vm, t->func, t->args, t->argCount);
+    }
+    resolveFuture(vm, t->future, result);
+    t->completed = true;
+
+    // Never resumed again; the resumer frees this stack
+    swapcontext(&t->ctx, t->resumer);
+}
+
+static void freeTask(Task* t) {
+    free(t->cstack);
+    free(t->exec.registers);
+    free(t->exec.callStack);
+    free(t->args);
+    free(t);
+}
+
+// Drop finished tasks (only from the main program, never on a task stack)
+static void reapTasks(VM* vm) {
+    int live = 0;
+    for (int i = 0; i < vm->taskCount; i++) {
+        Task* t = vm->taskQueue[i];
+        if (t->completed && !t->running) {
+            freeTask(t);
+        } else {
+            vm->taskQueue[live++] = t;
+        }
+    }
+    vm->taskCount = live;
+}
+
+// Block in poll() (or sleep) until some waiter can make progress
+static void pollWaiters(VM* vm, TaskWait* rootWait) {
+    int cap = 0;
+    for (int i = 0; i <= vm->taskCount; i++) {
+        TaskWait* w = i < vm->taskCount ? &vm->taskQueue[i]->wait : rootWait;
+        if (w) cap += w->nfds;
+    }
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * (cap > 0 ? cap : 1));
+    struct pollfd** owners = malloc(sizeof(struct pollfd*) * (cap > 0 ? cap : 1));
+    TaskWait** waiters = malloc(sizeof(TaskWait*) * (cap > 0 ? cap : 1));
+    int nfds = 0;
+    uint64_t deadline = 0;
+
+    for (int i = 0; i <= vm->taskCount; i++) {
+        TaskWait* w;
+        if (i < vm->taskCount) {
+            Task* t = vm->taskQueue[i];
+            if (t->completed || t->running) continue;
+            w = &t->wait;
+        } else {
+            w = rootWait;
+            if (!w) continue;
+        }
+        for (int f = 0; !w->fdReady && f < w->nfds; f++) {
+            fds[nfds] = w->fds[f];
+            fds[nfds].revents = 0;
+            owners[nfds] = &w->fds[f];
+            waiters[nfds++] = w;
+        }
+        if (w->wakeAt && (deadline == 0 || w->wakeAt < deadline)) deadline = w->wakeAt;
+    }
+
+    if (nfds == 0 && deadline == 0) {
+        printf("Runtime Error: Deadlock: awaited Future can never be resolved.\n");
+        exit(1);
+    }
+
+    uint64_t now = monotonicMicros();
+    uint64_t waitUs = deadline > now ? deadline - now : 0;
+    if (nfds == 0) {
+        struct timespec ts = { (time_t)(waitUs / 1000000ULL), (long)(waitUs % 1000000ULL) * 1000L };
+        nanosleep(&ts, NULL);
+    } else {
+        int timeoutMs = deadline == 0 ? -1 : (int)((waitUs + 999) / 1000);
+        if (poll(fds, nfds, timeoutMs) > 0) {
+            for (int i = 0; i < nfds; i++) {
+                owners[i]->revents = fds[i].revents;
+                if (fds[i].revents) waiters[i]->fdReady = true;
+            }
+        }
+    }
+
+    free(fds);
+    free(owners);
+    free(waiters);
+}
+
+// Main-program scheduler loop: run ready tasks until 'rootWait' is
+// satisfied (or, with NULL, until every task has finished)
+static void runUntil(VM* vm, TaskWait* rootWait) {
+    while (1) {
+        if (rootWait && waitSatisfied(rootWait, monotonicMicros())) return;
+        reapTasks(vm);
+        if (!rootWait && vm->taskCount == 0) return;
+
+        bool progressed = false;
+        for (int i = 0; i < vm->taskCount; i++) {
+            Task* t = vm->taskQueue[i];
+            if (t->completed || t->running) continue;
+            if (!waitSatisfied(&t->wait, monotonicMicros())) continue;
+            clearWait(&t->wait);
+            switchToTask(vm, t);
+            progressed = true;
+        }
+        if (!progressed) pollWaiters(vm, rootWait);
+    }
+}
+
+// Suspend the running coroutine on 'w'
+static void waitFor(VM* vm, TaskWait* w) {
+    Task* t = vm->currentTask;
+    if (t) {
+        t->wait = *w;
+        do {
+            taskYield(vm);
+        } while (w->future && !w->future->done);
+        clearWait(&t->wait);
+    } else {
+        runUntil(vm, w);
+    }
+}
+
+Value spawnTask(VM* vm, Function* func, Value* args, int argCount) {
+    // Task is queued before allocating so the GC sees its arguments
+    Task* t = calloc(1, sizeof(Task));
+    t->func = func;
+    t->argCount = argCount;
+    t->args = malloc(sizeof(Value) * (argCount > 0 ? argCount : 1));
+    memcpy(t->args, args, sizeof(Value) * argCount);
+    clearWait(&t->wait);
+
+    if (vm->taskCount >= vm->taskCapacity) {
+        vm->taskCapacity = vm->taskCapacity < 8 ? 8 : vm->taskCapacity * 2;
+        vm->taskQueue = realloc(vm->taskQueue, sizeof(Task*) * vm->taskCapacity);
+    }
+    vm->taskQueue[vm->taskCount++] = t;
+
+    Future* future = ALLOCATE_OBJ(vm, Future, OBJ_FUTURE);
+    future->done = false;
+    future->result = NIL_VAL;
+    pthread_mutex_init(&future->mu, NULL);
+    pthread_cond_init(&future->cv, NULL);
+    t->future = future;
+
+    // Fresh coroutine state: own registers, frames and C stack
+    t->exec.registers = calloc((size_t)vm->regCapacity, sizeof(Value));
+    t->exec.callStack = calloc(CALL_STACK_MAX, sizeof(CallFrame));
+    t->exec.regBase = 0;
+    t->exec.regTop = 0;
+    t->exec.callStackTop = 0;
+    t->exec.globalEnv = func->moduleEnv ? func->moduleEnv : vm->globalEnv;
+    t->cstack = malloc(TASK_CSTACK_SIZE);
+    if (!t->exec.registers || !t->exec.callStack || !t->cstack) {
+        printf("Runtime Error: Out of memory spawning async task.\n");
+        exit(1);
+    }
+
+    getcontext(&t->ctx);
+    t->ctx.uc_stack.ss_sp = t->cstack;
+    t->ctx.uc_stack.ss_size = TASK_CSTACK_SIZE;
+    t->ctx.uc_link = NULL;
+    makecontext(&t->ctx, taskEntry, 0);
+
+    // Eager start: run until the first suspension point
+    g_startVM = vm;
+    g_startTask = t;
+    t->started = true;
+    switchToTask(vm, t);
+
+    return OBJ_VAL(future);
+}
+
+void awaitFuture(VM* vm, Future* future) {
+    if (future->done) return;
+    TaskWait w;
+    clearWait(&w);
+    w.future = future;
+    waitFor(vm, &w);
+}
+
+void taskSleep(VM* vm, uint64_t micros) {
+    TaskWait w;
+    clearWait(&w);
+    w.wakeAt = monotonicMicros() + (micros ? micros : 1);
+    waitFor(vm, &w);
+}
+
+void taskWaitFd(VM* vm, int fd, short events) {
+    if (!vm->currentTask && vm->taskCount == 0) return; // Nothing to overlap with: just block
+    struct pollfd pfd = { fd, events, 0 };
+    taskWaitPoll(vm, &pfd, 1);
+}
+
+void taskWaitPoll(VM* vm, struct pollfd* fds, int count) {
+    for (int i = 0; i < count; i++) fds[i].revents = 0;
+    if (!vm->currentTask && vm->taskCount == 0) {
+        while (poll(fds, (nfds_t)count, -1) < 0) {} // Only EINTR; nothing else to run
+        return;
+    }
+    TaskWait w;
+    clearWait(&w);
+    w.fds = fds;
+    w.nfds = count;
+    waitFor(vm, &w);
+}
+
+void runScheduler(VM* vm) {
+    if (vm->currentTask) return;
+    runUntil(vm, NULL);
+}
+
+void markTasks(VM* vm) {
+    for (int i = 0; i < vm->taskCount; i++) {
+        Task* t = vm->taskQueue[i];
+        markObject(vm, (Obj*)t->future);
+        markObject(vm, (Obj*)t->func);
+        for (int a = 0; a < t->argCount; a++) markValue(vm, t->args[a]);
+        markObject(vm, (Obj*)t->wait.future);
+        // Running tasks' state lives in the VM or on the suspendedExec chain
+        if (t->started && !t->completed && !t->running) {
+            markExecState(vm, t->exec.registers, t->exec.regBase, t->exec.regTop,
+                          t->exec.callStack, t->exec.callStackTop);
+            markObject(vm, (Obj*)t->exec.globalEnv);
+        }
+    }
+}
+
+void freeTasks(VM* vm) {
+    for (int i = 0; i < vm->taskCount; i++) {
+        if (!vm->taskQueue[i]->running) freeTask(vm->taskQueue[i]);
+    }
+    free(vm->taskQueue);
+    vm->taskQueue = NULL;
+    vm->taskCount = 0;
+    vm->taskCapacity = 0;
+}
@@ -5,6 +5,9 @@
 #include <unistd.h>
 #include "vm.h"
 #include "resolver.h"
+#include "bytecode/interpreter.h"
+#include "runtime/scheduler.h"
+#include "runtime/imports.h"
 #include <dlfcn.h>
 #include <time.h>
 #include <math.h>
@@ -77,7 +80,7 @@ static bool futureIsDone(Future* f) {
 */
 
 
-// Optimized FNV-1a hash function for variables (faster than previous implementation)
+// Optimized FNV-1a hash function (full 32-bit; callers reduce it to their table size)
 unsigned int hash(const char* key, int length) {
     unsigned int hash = 2166136261u;
     const unsigned char* data = (const unsigned char*)key;
@@ -85,7 +88,7 @@ unsigned int hash(const char* key, int length) {
         hash ^= data[i];
         hash *= 16777619;
     }
-    return hash % TABLE_SIZE;
+    return hash;
 }
 
 // Set script directory from script path
@@ -151,11 +154,12 @@ char* resolvePath(VM* vm, const char* path) {
 /* GC Functions moved to gc.c */
 
 Obj* allocateObject(VM* vm, size_t size, ObjType type) {
-    Obj* object = (Obj*)reallocate(vm, NULL, 0, size);
+    Obj* object = (Obj*)allocateObjectMemory(vm, size);
     object->type = type;
-    object->isMarked = (vm->gcPhase == 1 || isGCActive()); // Allocate Black during Marking to prevent Stack leaks
+    object->isMarked = (vm->gcPhase == 1 || isGCActive(vm)); // Allocate Black during Marking to prevent Stack leaks
     object->isPermanent = false; // Default: subject to GC
     object->generation = 0;
+    object->isRemembered = false;
     
     // Generational allocation: add to nursery
     object->next = vm->nursery;
@@ -197,12 +201,21 @@ void freeVM(VM* vm) {
     }
     vm->externHandleCount = 0;
 
+    // Background compiles of imports still use the cache
+    freeImports(vm);
 
+    // Library state first: it may hold pinned objects or open handles
+    while (vm->libStates) {
+        LibState* state = vm->libStates;
+        vm->libStates = state->next;
+        if (state->destroy) state->destroy(state->data);
+        free(state);
+    }
 
-    if (vm->stringPool.strings) {
+    if (vm->stringPool.entries) {
          // Strings are managed as ObjStrings and will be freed by the object loop
-         free(vm->stringPool.strings);
-         free(vm->stringPool.hashes);
+         free(vm->stringPool.entries);
+         vm->stringPool.entries = NULL;
          pthread_mutex_destroy(&vm->stringPool.lock);
     }
     
@@ -214,6 +227,14 @@ void freeVM(VM* vm) {
         object = next;
     }
     
+    // Old objects still awaiting a lazy sweep
+    object = vm->sweepPending;
+    while (object != NULL) {
+        Obj* next = object->next;
+        freeObject(vm, object);
+        object = next;
+    }
+
     // Free nursery objects (Young Gen)
     object = vm->nursery;
     while (object != NULL) {
@@ -224,12 +245,47 @@ void freeVM(VM* vm) {
     
     // Free gray stack
     if (vm->grayStack) free(vm->grayStack);
+    if (vm->pinned) free(vm->pinned);
+    if (vm->remembered) free(vm->remembered);
+
+    freeTasks(vm);
+    free(vm->registers);
+    free(vm->callStack);
     
      // Free value pool
     if (vm->valuePool.values) {
         free(vm->valuePool.values);
         free(vm->valuePool.free_list);
     }
+
+    freeHeap(&vm->heap); // Every object was freed above
+    pthread_mutex_destroy(&vm->gcMutex);
+}
+
+void* getLibState(VM* vm, const void* key) {
+    for (LibState* state = vm->libStates; state; state = state->next) {
+        if (state->key == key) return state->data;
+    }
+    return NULL;
+}
+
+void setLibState(VM* vm, const void* key, void* data, void (*destroy)(void* data)) {
+    for (LibState* state = vm->libStates; state; state = state->next) {
+        if (state->key != key) continue;
+        if (state->destroy && state->data != data) state->destroy(state->data);
+        state->data = data;
+        state->destroy = destroy;
+        return;
+    }
+    LibState* state = malloc(sizeof(LibState));
+    if (!state) {
+        error("Memory allocation failed.", 0);
+    }
+    state->key = key;
+    state->data = data;
+    state->destroy = destroy;
+    state->next = vm->libStates;
+    vm->libStates = state;
 }
 // Helper to check truthiness
 static bool isTruthy(Value v) {
@@ -252,16 +308,53 @@ static bool isTruthy(Value v) {
 static unsigned int hashIntKey(int k) {
     unsigned int x = (unsigned int)k;
     x ^= x >> 16; x *= 0x7feb352d; x ^= x >> 15; x *= 0x846ca68b; x ^= x >> 16;
-    return x % TABLE_SIZE;
+    return x;
 }
 
-// Pointer hash for fast lookups (O(1))
-static unsigned int hashPointer(const void* ptr) {
-    uintptr_t x = (uintptr_t)ptr;
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = (x >> 16) ^ x;
-    return x % TABLE_SIZE;
+// ---- String pool (open addressing, linear probing) ----
+
+// Find the slot holding (str, length) or the slot where it should be inserted.
+// Caller must hold stringPool.lock.
+static ObjString** stringPoolFindSlot(StringPool* pool, const char* str, int length, unsigned int h) {
+    unsigned int mask = (unsigned int)pool->capacity - 1;
+    unsigned int index = h & mask;
+    ObjString** tombstone = NULL;
+    for (;;) {
+        ObjString** slot = &pool->entries[index];
+        ObjString* entry = *slot;
+        if (entry == NULL) {
+            // Reuse the first tombstone on the probe path for inserts
+            return tombstone ? tombstone : slot;
+        }
+        if (entry == STRING_POOL_TOMBSTONE) {
+            if (!tombstone) tombstone = slot;
+        } else if (entry->hash == h && entry->length == length &&
+                   memcmp(entry->chars, str, length) == 0) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Rehash into a table sized for the live count; drops all tombstones.
+static void stringPoolResize(StringPool* pool, int capacity) {
+    ObjString** old = pool->entries;
+    int oldCapacity = pool->capacity;
+
+    pool->entries = calloc((size_t)capacity, sizeof(ObjString*));
+    if (!pool->entries) error("Memory allocation failed for string pool.", 0);
+    pool->capacity = capacity;
+    pool->tombstones = 0;
+
+    unsigned int mask = (unsigned int)capacity - 1;
+    for (int i = 0; i < oldCapacity; i++) {
+        ObjString* entry = old[i];
+        if (entry == NULL || entry == STRING_POOL_TOMBSTONE) continue;
+        unsigned int index = entry->hash & mask;
+        while (pool->entries[index]) index = (index + 1) & mask;
+        pool->entries[index] = entry;
+    }
+    free(old);
 }
 
 ObjString* internString(VM* vm, const char* str, int length) {
@@ -270,64 +363,56 @@ ObjString* internString(VM* vm, const char* str, int length) {
 
     // Long strings are NOT interned: they live only on the GC heap and are
     // collected as soon as they become unreachable. This prevents the pool
-    // from pinning megabytes of intermediate concatenation results.
+    // from pinning megabytes of intermediate concatenation results. Their
+    // hash is computed on first use (stringHash), so building one is a copy.
     if (length > 256) {
-        ObjString* strObj = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
+        ObjString* strObj = (ObjString*)allocateObject(vm, sizeof(ObjString) + length + 1, OBJ_STRING);
         strObj->length = length;
-        strObj->hash   = hash(str, length);
-        strObj->chars  = malloc(length + 1);
-        vm->bytesAllocated += (length + 1);
+        strObj->hash   = 0;
         memcpy(strObj->chars, str, length);
         strObj->chars[length] = '\0';
         return strObj;
     }
 
     unsigned int h = hash(str, length);
+    StringPool* pool = &vm->stringPool;
 
     // Step 1: Find existing match (Lock)
-    pthread_mutex_lock(&vm->stringPool.lock);
-    for (int i = 0; i < vm->stringPool.count; i++) {
-        ObjString* strObj = (ObjString*)vm->stringPool.strings[i];
-         if (strObj->hash == h && strObj->length == length && memcmp(strObj->chars, str, length) == 0) {
-             pthread_mutex_unlock(&vm->stringPool.lock);
-             return strObj;
-         }
-    }
-    pthread_mutex_unlock(&vm->stringPool.lock);
+    pthread_mutex_lock(&pool->lock);
+    ObjString* found = *stringPoolFindSlot(pool, str, length, h);
+    pthread_mutex_unlock(&pool->lock);
+    if (found && found != STRING_POOL_TOMBSTONE) return found;
     
     // Step 2: Create new (No Lock, might trigger GC)
-    ObjString* strObj = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
+    ObjString* strObj = (ObjString*)allocateObject(vm, sizeof(ObjString) + length + 1, OBJ_STRING);
     strObj->length = length;
     strObj->hash = h;
-    strObj->chars = malloc(length + 1);
-    vm->bytesAllocated += (length + 1);
     memcpy(strObj->chars, str, length);
     strObj->chars[length] = '\0';
     
     // Step 3: Add to pool (Lock again)
-    pthread_mutex_lock(&vm->stringPool.lock);
-    
-    // Double Check (in case another thread inserted it while we were allocating)
-    for (int i = 0; i < vm->stringPool.count; i++) {
-        ObjString* existing = (ObjString*)vm->stringPool.strings[i];
-         if (existing->hash == h && existing->length == length && memcmp(existing->chars, str, length) == 0) {
-             pthread_mutex_unlock(&vm->stringPool.lock);
-             // Lost the race — abandon our duplicate; GC will collect it.
-             return existing;
-         }
-    }
+    pthread_mutex_lock(&pool->lock);
 
-    if (vm->stringPool.count == vm->stringPool.capacity) {
-        int oldCap = vm->stringPool.capacity;
-        vm->stringPool.capacity = oldCap < 8 ? 8 : oldCap * 2;
-        vm->stringPool.strings = (char**)realloc(vm->stringPool.strings, sizeof(char*) * vm->stringPool.capacity);
-        vm->stringPool.hashes = (unsigned int*)realloc(vm->stringPool.hashes, sizeof(unsigned int) * vm->stringPool.capacity);
-        if (!vm->stringPool.strings || !vm->stringPool.hashes) error("Memory allocation failed for string pool.", 0);
+    // Keep load (live + tombstones) under 75%; grow only if live strings need it
+    if ((pool->count + pool->tombstones + 1) * 4 > pool->capacity * 3) {
+        int newCapacity = pool->capacity;
+        while ((pool->count + 1) * 2 > newCapacity) newCapacity *= 2;
+        stringPoolResize(pool, newCapacity);
+    }
+    
+    // Re-probe: GC may have pruned the pool, or another thread inserted it
+    // while we were allocating.
+    ObjString** slot = stringPoolFindSlot(pool, str, length, h);
+    ObjString* existing = *slot;
+    if (existing && existing != STRING_POOL_TOMBSTONE) {
+        pthread_mutex_unlock(&pool->lock);
+        // Lost the race — abandon our duplicate; GC will collect it.
+        return existing;
     }
-    vm->stringPool.strings[vm->stringPool.count] = (char*)strObj;
-    vm->stringPool.hashes[vm->stringPool.count] = h;
-    vm->stringPool.count++;
-    pthread_mutex_unlock(&vm->stringPool.lock);
+    if (existing == STRING_POOL_TOMBSTONE) pool->tombstones--;
+    *slot = strObj;
+    pool->count++;
+    pthread_mutex_unlock(&pool->lock);
     
     return strObj;
 }
@@ -345,109 +430,58 @@ static void internToken(VM* vm, Token* token) {
     }
 }
 
-// Recursively intern all identifiers and string literals in AST
-static void internAST(VM* vm, Node* node) {
-    if (!node) return;
-    
-    switch (node->type) {
-        case NODE_EXPR_LITERAL:
-            if (node->literal.token.type == TOKEN_STRING) internToken(vm, &node->literal.token);
-            break;
-        case NODE_EXPR_BINARY:
-            internAST(vm, node->binary.left);
-            internAST(vm, node->binary.right);
-            break;
-        case NODE_EXPR_UNARY:
-            internAST(vm, node->unary.expr);
-            break;
-        case NODE_EXPR_VAR:
-            internToken(vm, &node->var.name);
-            break;
-        case NODE_EXPR_CALL:
-            internAST(vm, node->call.callee);
-            internAST(vm, node->call.arguments);
-            break;
-        case NODE_EXPR_GET:
-            internAST(vm, node->get.object);
-            internToken(vm, &node->get.name);
-            break;
-        case NODE_EXPR_INDEX:
-            internAST(vm, node->index.target);
-            internAST(vm, node->index.index);
-            break;
-        case NODE_STMT_VAR_DECL:
-            internToken(vm, &node->varDecl.name);
-            internAST(vm, node->varDecl.initializer);
-            break;
-        case NODE_STMT_ASSIGN:
-            internToken(vm, &node->assign.name);
-            internAST(vm, node->assign.value);
-            break;
-        case NODE_STMT_INDEX_ASSIGN:
-            internAST(vm, node->indexAssign.target);
-            internAST(vm, node->indexAssign.index);
-            internAST(vm, node->indexAssign.value);
-            break;
-        case NODE_STMT_PRINT:
-            internAST(vm, node->print.expr);
-            break;
-        case NODE_STMT_IF:
-            internAST(vm, node->ifStmt.condition);
-            internAST(vm, node->ifStmt.thenBranch);
-            internAST(vm, node->ifStmt.elseBranch);
-            break;
-        case NODE_STMT_WHILE:
-            internAST(vm, node->whileStmt.condition);
-            internAST(vm, node->whileStmt.body);
-            break;
-        case NODE_STMT_FOR:
-            internAST(vm, node->forStmt.initializer);
-            internAST(vm, node->forStmt.condition);
-            internAST(vm, node->forStmt.increment);
-            internAST(vm, node->forStmt.body);
-            break;
-        case NODE_STMT_BLOCK:
-            for (int i = 0; i < node->block.count; i++) {
-                internAST(vm, node->block.statements[i]);
-            }
-            break;
-        case NODE_STMT_FUNCTION:
-            internToken(vm, &node->function.name);
-            for (int i = 0; i < node->function.paramCount; i++) {
-                internToken(vm, &node->function.params[i]);
-            }
-            internAST(vm, node->function.body);
-            break;
-        case NODE_STMT_RETURN:
-            internAST(vm, node->returnStmt.value);
-            break;
-        case NODE_STMT_IMPORT:
-            internToken(vm, &node->importStmt.module);
-            internToken(vm, &node->importStmt.alias);
-            break;
-        case NODE_EXPR_ARRAY_LITERAL:
-            internAST(vm, node->arrayLiteral.elements);
-            break;
-        case NODE_STMT_FOREACH:
-            internToken(vm, &node->foreachStmt.iterator);
-            internAST(vm, node->foreachStmt.collection);
-            internAST(vm, node->foreachStmt.body);
-            break;
-        case NODE_STMT_STRUCT_DECL:
-            internToken(vm, &node->structDecl.name);
-            for (int i = 0; i < node->structDecl.fieldCount; i++) {
-                internToken(vm, &node->structDecl.fields[i]);
+// Intern all identifiers and string literals in one pass over the parser's
+// node slabs, in allocation order: no tree walk is needed, since every node
+// lives in them and none is ever freed
+static void internAST(VM* vm, Parser* parser) {
+    for (ArenaBlock* block = parser->nodes; block; block = block->next) {
+        Node* nodes = (Node*)block->data;
+        size_t count = block->used / sizeof(Node);
+        for (size_t n = 0; n < count; n++) {
+            Node* node = &nodes[n];
+            switch (node->type) {
+                case NODE_EXPR_LITERAL:
+                    if (node->literal.token.type == TOKEN_STRING) internToken(vm, &node->literal.token);
+                    break;
+                case NODE_EXPR_VAR:
+                    internToken(vm, &node->var.name);
+                    break;
+                case NODE_EXPR_GET:
+                    internToken(vm, &node->get.name);
+                    break;
+                case NODE_STMT_VAR_DECL:
+                    internToken(vm, &node->varDecl.name);
+                    break;
+                case NODE_STMT_ASSIGN:
+                    internToken(vm, &node->assign.name);
+                    break;
+                case NODE_STMT_FUNCTION:
+                    internToken(vm, &node->function.name);
+                    for (int i = 0; i < node->function.paramCount; i++) {
+                        internToken(vm, &node->function.params[i]);
+                    }
+                    break;
+                case NODE_STMT_IMPORT:
+                    internToken(vm, &node->importStmt.module);
+                    internToken(vm, &node->importStmt.alias);
+                    break;
+                case NODE_STMT_FOREACH:
+                    internToken(vm, &node->foreachStmt.iterator);
+                    break;
+                case NODE_STMT_STRUCT_DECL:
+                    internToken(vm, &node->structDecl.name);
+                    for (int i = 0; i < node->structDecl.fieldCount; i++) {
+                        internToken(vm, &node->structDecl.fields[i]);
+                    }
+                    break;
+                case NODE_STMT_PROP_ASSIGN:
+                    internToken(vm, &node->propAssign.name);
+                    break;
+                default:
+                    break;
             }
-            break;
-        case NODE_STMT_PROP_ASSIGN:
-            internAST(vm, node->propAssign.object);
-            internToken(vm, &node->propAssign.name);
-            internAST(vm, node->propAssign.value);
-            break;
-        default:
-            break;
+        }
     }
-    internAST(vm, node->next);
 }
 
 // Module cache lookup/insert by logical module name
@@ -476,142 +510,53 @@ static bool fileExists(const char* path) {
 
 // Find or insert variable with proper scope resolution
 static VarEntry* findEntry(VM* vm, Token name, bool insert) {
-    // Assumption: name.start IS interned via internAST
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
+    unsigned int h = hash(name.start, name.length);
     
     // If not inserting, search up the chain
     if (!insert) {
         Environment* env = vm->env;
         while (env) {
-            VarEntry* entry = env->buckets[h];
-            while (entry) {
-                if (entry->key == name.start) return entry;
-                entry = entry->next;
+            VarEntry* entry = envFindEntry(env, name.start, name.length, h);
+            if (entry) {
+                WRITE_BARRIER(vm, env); // Callers may assign through the entry
+                return entry;
             }
             env = env->enclosing;
         }
         return NULL;
     }
     
-    // If inserting, search only current environment
-    VarEntry* entry = vm->env->buckets[h];
-    while (entry) {
-        if (entry->key == name.start) return entry;
-        entry = entry->next;
-    }
-    
-    // If inserting, create new entry in current environment
-    if (insert) {
-        entry = malloc(sizeof(VarEntry));
-        if (!entry) {
-            error("Memory allocation failed.", name.line);
-        }
-        
-        entry->key = (char*)name.start; // Already interned
-        entry->keyString = NULL; // Cannot get ObjString from char* here
-        entry->keyLength = name.length;
-        entry->ownsKey = false; // Owned by StringPool
-        
-        entry->value = INT_VAL(0); // Default init
-        entry->next = vm->env->buckets[h];
-        vm->env->buckets[h] = entry;
-        return entry;
-    }
-    return NULL;
+    // If inserting, search only current environment, then create
+    VarEntry* entry = envFindEntry(vm->env, name.start, name.length, h);
+    if (entry) return entry;
+    ObjString* key = internString(vm, name.start, name.length);
+    return envSet(vm, vm->env, key, INT_VAL(0)); // Default init
 }
 
-// Find or insert function in specific environment
-static FuncEntry* findFuncEntry(Environment* env, Token name, bool insert) {
-    // Assumption: name.start is interned
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
-    FuncEntry* entry = env->funcBuckets[h];
-    while (entry) {
-        if (entry->key == name.start) {
-            return entry;
-        }
-        entry = entry->next;
+// Functions share the variable table; a name resolves to a function when its value is one
+static Function* asFunction(VarEntry* entry) {
+    if (entry && IS_OBJ(entry->value) && AS_OBJ(entry->value)->type == OBJ_FUNCTION) {
+        return (Function*)AS_OBJ(entry->value);
     }
-    if (insert) {
-        entry = malloc(sizeof(FuncEntry));
-        if (!entry) {
-            error("Memory allocation failed.", name.line);
-        }
-        entry->key = (char*)name.start; // Already interned
-        entry->function = NULL;
-        entry->next = env->funcBuckets[h];
-        env->funcBuckets[h] = entry;
-        return entry;
-    }
-    return NULL; // Not found
+    return NULL;
 }
 
-
-
 Function* findFunctionByName(VM* vm, const char* name) {
-    // Intern key first to enable pointer lookup
-    char* key = internString(vm, name, (int)strlen(name))->chars;
-    unsigned int h = hashPointer(key) % TABLE_SIZE;
-    FuncEntry* entry = vm->globalEnv->funcBuckets[h];
-    while (entry) {
-        if (entry->key == key) {
-            return entry->function;
-        }
-        entry = entry->next;
-    }
-    return NULL;
+    int length = (int)strlen(name);
+    return asFunction(envFindEntry(vm->globalEnv, name, length, hash(name, length)));
 }
 
-static Function* findFunction(VM* vm, Token name) {
-    // name.start is interned
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
-    FuncEntry* entry = vm->globalEnv->funcBuckets[h];
-    while (entry) {
-        if (entry->key == name.start) {
-            return entry->function;
-        }
-        entry = entry->next;
-    }
-    return NULL;
+static Function* findFunctionInEnv(Environment* env, Token name) {
+    return asFunction(envFindEntry(env, name.start, name.length, hash(name.start, name.length)));
 }
 
-static Function* findFunctionInEnv(Environment* env, Token name) {
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
-    FuncEntry* entry = env->funcBuckets[h];
-    while (entry) {
-        if (entry->key == name.start) {
-            return entry->function;
-        }
-        entry = entry->next;
-    }
-    return NULL;
+static Function* findFunction(VM* vm, Token name) {
+    return findFunctionInEnv(vm->globalEnv, name);
 }
 
 // Find variable in a specific environment
 static VarEntry* findVarInEnv(Environment* env, Token name) {
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
-    VarEntry* entry = env->buckets[h];
-    while (entry) {
-        if (entry->key == name.start) {
-            return entry;
-        }
-        entry = entry->next;
-    }
-    return NULL;
-}
-
-// Read whole file
-char* readFileAll(const char* path) {
-    FILE* file = fopen(path, "rb");
-    if (!file) return NULL;
-    fseek(file, 0L, SEEK_END);
-    long size = ftell(file);
-    rewind(file);
-    char* buf = malloc(size + 1);
-    if (!buf) { fclose(file); return NULL; }
-    size_t n = fread(buf, 1, size, file);
-    buf[n] = '\0';
-    fclose(file);
-    return buf;
+    return envFindEntry(env, name.start, name.length, hash(name.start, name.length));
 }
 
 // Recursively search for a filename under root. Returns malloc'd full path or NULL
@@ -656,14 +601,19 @@ Array* newArray(VM* vm) {
     arr->items = NULL;
     arr->count = 0;
     arr->capacity = 0;
+    arr->share = NULL;
     return arr;
 }
 
 void arrayPush(VM* vm, Array* a, Value v) {
+    arrayWritable(vm, a);
     if (a->count + 1 > a->capacity) {
         int oldCapacity = a->capacity;
         a->capacity = GROW_CAPACITY(oldCapacity);
+        // Growing may collect; 'v' is often a fresh object reachable from nowhere else
+        vm->stack[vm->stackTop++] = v;
         Value* newItems = (Value*)reallocate(vm, a->items, sizeof(Value) * oldCapacity, sizeof(Value) * a->capacity);
+        vm->stackTop--;
         if (!newItems) {
             printf("Fatal Error: Array allocation failed.\n");
             exit(1);
@@ -671,6 +621,7 @@ void arrayPush(VM* vm, Array* a, Value v) {
         a->items = newItems;
     }
     a->items[a->count++] = v;
+    WRITE_BARRIER(vm, a);
 }
 /*
 static bool arrayPop(Array* a, Value* out) {
@@ -686,76 +637,395 @@ bool arrayPop(Array* a, Value* out) {
     return true;
 }
 
+// Clamp slice bounds to [0, length]; negative ones count from the end
+static void sliceBounds(int length, int* start, int* end) {
+    if (*start < 0) *start += length;
+    if (*end < 0) *end += length;
+    if (*start < 0) *start = 0;
+    if (*end > length) *end = length;
+    if (*end < *start) *end = *start;
+}
+
+// O(1): the slice points into a's items. The first slice turns a's buffer
+// into a shared one; from then on whichever array writes first copies.
+Array* arraySlice(VM* vm, Array* a, int start, int end) {
+    sliceBounds(a->count, &start, &end);
+    Array* slice = newArray(vm);
+    if (end == start) return slice;
+    if (!a->share) {
+        ArrayShare* share = malloc(sizeof(ArrayShare));
+        if (!share) error("Memory allocation failed.", 0);
+        share->items = a->items;
+        share->bytes = (size_t)a->capacity * sizeof(Value);
+        share->refs = 1;
+        a->share = share;
+        a->capacity = a->count; // Shared items never grow in place
+    }
+    a->share->refs++;
+    slice->share = a->share;
+    slice->items = a->items + start;
+    slice->count = end - start;
+    slice->capacity = slice->count;
+    return slice;
+}
+
+void arrayDetach(VM* vm, Array* a) {
+    ArrayShare* share = a->share;
+    int capacity = a->count > 0 ? a->count : 1;
+    Value* items = malloc(sizeof(Value) * capacity);
+    if (!items) error("Memory allocation failed.", 0);
+    memcpy(items, a->items, sizeof(Value) * a->count);
+    vm->bytesAllocated += sizeof(Value) * capacity;
+    a->items = items;
+    a->capacity = capacity;
+    a->share = NULL;
+    if (--share->refs == 0) {
+        vm->bytesAllocated -= share->bytes;
+        free(share->items);
+        free(share);
+    }
+}
+
+// ---- String slice helpers ----
+// Slices of slices point at the original string, so chains never form.
+// The whole string is returned as it is, and an empty range as "".
+Value stringSlice(VM* vm, Value str, int start, int end) {
+    Obj* parent;
+    const char* chars;
+    int length;
+    if (IS_STRING_SLICE(str)) {
+        StringSlice* s = AS_STRING_SLICE(str);
+        parent = s->parent;
+        chars = s->chars;
+        length = s->length;
+    } else {
+        parent = AS_OBJ(str);
+        chars = AS_STRING(str)->chars;
+        length = AS_STRING(str)->length;
+    }
+    sliceBounds(length, &start, &end);
+    if (start == 0 && end == length) return str;
+    return bufferSlice(vm, parent, chars + start, end - start);
+}
+
+// Slice over bytes that 'owner' keeps alive: a string, or a resource such
+// as a mapped file (runtime/fileio.h)
+Value bufferSlice(VM* vm, Obj* owner, const char* chars, int length) {
+    if (length == 0) return OBJ_VAL(internString(vm, "", 0));
+    StringSlice* slice = ALLOCATE_OBJ(vm, StringSlice, OBJ_STRING_SLICE);
+    slice->parent = owner;
+    slice->chars = chars;
+    slice->length = length;
+    return OBJ_VAL(slice);
+}
+
+ObjString* flattenSlice(VM* vm, StringSlice* slice) {
+    return internString(vm, slice->chars, slice->length);
+}
+
+// ---- Typed array helpers ----
+// Elements live outside the object heap; like builder growth, they are
+// charged to bytesAllocated directly and never trigger a collection here.
+TypedArray* newTypedArray(VM* vm, TypedKind kind, int count) {
+    TypedArray* ta = ALLOCATE_OBJ(vm, TypedArray, OBJ_TYPED_ARRAY);
+    ta->kind = kind;
+    ta->count = count;
+    ta->data = calloc(count > 0 ? (size_t)count : 1, typedElementSize(kind));
+    if (!ta->data) error("Memory allocation failed.", 0);
+    vm->bytesAllocated += (size_t)count * typedElementSize(kind);
+    return ta;
+}
+
+// ---- Struct helpers ----
+// One allocation holds the instance and its fields
+StructInstance* newStructInstance(VM* vm, StructDef* def) {
+    StructInstance* inst = (StructInstance*)allocateObject(
+        vm, sizeof(StructInstance) + sizeof(Value) * (size_t)def->fieldCount, OBJ_STRUCT_INSTANCE);
+    inst->def = def;
+    inst->fieldCount = def->fieldCount;
+    for (int i = 0; i < def->fieldCount; i++) inst->fields[i] = NIL_VAL;
+    return inst;
+}
+
+// ---- String builder helpers ----
+// Text of 'value' as string concatenation shows it. Numbers are formatted
+// into 'buf' (at least 64 bytes). The result is NUL-terminated, except for
+// string slices, which point into their parent.
+const char* valueText(Value value, char* buf, int* length) {
+    const char* text;
+    if (IS_STRING(value)) {
+        *length = AS_STRING(value)->length;
+        return AS_CSTRING(value);
+    }
+    if (IS_STRING_BUILDER(value)) {
+        *length = AS_STRING_BUILDER(value)->length;
+        return AS_STRING_BUILDER(value)->chars;
+    }
+    if (IS_STRING_SLICE(value)) {
+        *length = AS_STRING_SLICE(value)->length;
+        return AS_STRING_SLICE(value)->chars;
+    }
+    if (IS_INT(value)) {
+        *length = snprintf(buf, 64, "%ld", (long)AS_INT(value));
+        return buf;
+    }
+    if (IS_FLOAT(value)) {
+        *length = snprintf(buf, 64, "%.14g", AS_FLOAT(value));
+        return buf;
+    }
+    if (IS_BOOL(value)) text = AS_BOOL(value) ? "true" : "false";
+    else if (IS_NIL(value)) text = "nil";
+    else text = "[object]";
+    *length = (int)strlen(text);
+    return text;
+}
+
+StringBuilder* newStringBuilder(VM* vm) {
+    StringBuilder* sb = ALLOCATE_OBJ(vm, StringBuilder, OBJ_STRING_BUILDER);
+    sb->length = 0;
+    sb->capacity = 16;
+    sb->chars = malloc(sb->capacity);
+    if (!sb->chars) error("Memory allocation failed.", 0);
+    sb->chars[0] = '\0';
+    vm->bytesAllocated += sb->capacity;
+    return sb;
+}
+
+// Amortized O(1): the buffer doubles. Growth is charged to bytesAllocated
+// directly, like map growth, so it never triggers a collection.
+void builderAppend(VM* vm, StringBuilder* sb, const char* chars, int length) {
+    if (sb->length + length + 1 > sb->capacity) {
+        int oldCapacity = sb->capacity;
+        int capacity = oldCapacity;
+        while (sb->length + length + 1 > capacity) capacity *= 2;
+        char* grown = realloc(sb->chars, capacity);
+        if (!grown) error("Memory allocation failed.", 0);
+        sb->chars = grown;
+        sb->capacity = capacity;
+        vm->bytesAllocated += capacity - oldCapacity;
+    }
+    memcpy(sb->chars + sb->length, chars, length);
+    sb->length += length;
+    sb->chars[sb->length] = '\0';
+}
+
+void builderAppendValue(VM* vm, StringBuilder* sb, Value value) {
+    char buf[64];
+    int length;
+    const char* text = valueText(value, buf, &length);
+    // Appending a builder to itself reads the buffer it grows
+    if (text == sb->chars) {
+        char* copy = malloc(length + 1);
+        memcpy(copy, text, length);
+        builderAppend(vm, sb, copy, length);
+        free(copy);
+        return;
+    }
+    builderAppend(vm, sb, text, length);
+}
+
+ObjString* flattenBuilder(VM* vm, StringBuilder* sb) {
+    return internString(vm, sb->chars, sb->length);
+}
+
 // ---- Map helpers ----
 Map* newMap(VM* vm) {
     Map* m = ALLOCATE_OBJ(vm, Map, OBJ_MAP);
-    for (int i = 0; i < TABLE_SIZE; i++) m->buckets[i] = NULL;
+    m->vm = vm;
+    m->entries = NULL;
+    m->count = 0;
+    m->capacity = 0;
+    m->index = NULL;
+    m->indexCapacity = 0;
     return m;
 }
-MapEntry* mapFindEntry(Map* m, const char* skey, int slen, int* bucketOut) {
-    unsigned int h = hash(skey, slen);
-    if (bucketOut) *bucketOut = (int)h;
-    MapEntry* e = m->buckets[h];
-    while (e) {
-        if (!e->isIntKey && e->key && (int)strlen(e->key) == slen && strncmp(e->key, skey, slen) == 0) return e;
-        e = e->next;
+
+// Rebuild the index and entry array for 'indexCapacity' slots.
+// Growth is charged to bytesAllocated directly (never triggers a collection,
+// so callers may grow maps that are not yet rooted).
+static void mapGrow(Map* m, int indexCapacity) {
+    int capacity = indexCapacity / 4 * 3;
+    size_t oldBytes = (size_t)m->capacity * sizeof(MapEntry) + (size_t)m->indexCapacity * sizeof(int);
+    size_t newBytes = (size_t)capacity * sizeof(MapEntry) + (size_t)indexCapacity * sizeof(int);
+
+    MapEntry* entries = realloc(m->entries, sizeof(MapEntry) * capacity);
+    int* index = malloc(sizeof(int) * indexCapacity);
+    if (!entries || !index) error("Memory allocation failed.", 0);
+    for (int i = 0; i < indexCapacity; i++) index[i] = HASH_EMPTY_SLOT;
+
+    unsigned int mask = (unsigned int)indexCapacity - 1;
+    for (int i = 0; i < m->count; i++) {
+        unsigned int slot = entries[i].hash & mask;
+        while (index[slot] != HASH_EMPTY_SLOT) slot = (slot + 1) & mask;
+        index[slot] = i;
+    }
+
+    free(m->index);
+    m->entries = entries;
+    m->index = index;
+    m->capacity = capacity;
+    m->indexCapacity = indexCapacity;
+    if (m->vm) m->vm->bytesAllocated += newBytes - oldBytes;
+}
+
+// Append a new entry (caller checked it is absent); returns it for key setup
+static MapEntry* mapAppend(Map* m, unsigned int h) {
+    if (m->count + 1 > m->capacity) {
+        mapGrow(m, m->indexCapacity ? m->indexCapacity * 2 : HASH_MIN_CAPACITY);
+    }
+    unsigned int mask = (unsigned int)m->indexCapacity - 1;
+    unsigned int slot = h & mask;
+    while (m->index[slot] != HASH_EMPTY_SLOT) slot = (slot + 1) & mask;
+    m->index[slot] = m->count;
+    MapEntry* e = &m->entries[m->count++];
+    e->hash = h;
+    return e;
+}
+
+static MapEntry* mapFindStr(Map* m, const char* skey, int slen, unsigned int h, int* bucketOut) {
+    if (bucketOut) *bucketOut = -1;
+    if (m->count == 0) return NULL;
+    unsigned int mask = (unsigned int)m->indexCapacity - 1;
+    for (unsigned int slot = h & mask; m->index[slot] != HASH_EMPTY_SLOT; slot = (slot + 1) & mask) {
+        MapEntry* e = &m->entries[m->index[slot]];
+        if (e->hash == h && !e->isIntKey && e->keyLength == slen && memcmp(e->key, skey, slen) == 0) {
+            if (bucketOut) *bucketOut = m->index[slot];
+            return e;
+        }
     }
     return NULL;
 }
+MapEntry* mapFindEntry(Map* m, const char* skey, int slen, int* bucketOut) {
+    if (m->count == 0) {
+        if (bucketOut) *bucketOut = -1;
+        return NULL;
+    }
+    return mapFindStr(m, skey, slen, hash(skey, slen), bucketOut);
+}
 MapEntry* mapFindEntryInt(Map* m, int ikey, int* bucketOut) {
+    if (bucketOut) *bucketOut = -1;
+    if (m->count == 0) return NULL;
     unsigned int h = hashIntKey(ikey);
-    if (bucketOut) *bucketOut = (int)h;
-    MapEntry* e = m->buckets[h];
-    while (e) {
-        if (e->isIntKey && e->intKey == ikey) return e;
-        e = e->next;
+    unsigned int mask = (unsigned int)m->indexCapacity - 1;
+    for (unsigned int slot = h & mask; m->index[slot] != HASH_EMPTY_SLOT; slot = (slot + 1) & mask) {
+        MapEntry* e = &m->entries[m->index[slot]];
+        if (e->hash == h && e->isIntKey && e->intKey == ikey) {
+            if (bucketOut) *bucketOut = m->index[slot];
+            return e;
+        }
     }
     return NULL;
 }
 void mapSetStr(Map* m, const char* key, int len, Value v) {
-    int b; MapEntry* e = mapFindEntry(m, key, len, &b);
+    mapSetStrHashed(m, key, len, hash(key, len), v);
+}
+void mapSetStrHashed(Map* m, const char* key, int len, unsigned int h, Value v) {
+    if (m->vm) WRITE_BARRIER(m->vm, m);
+    MapEntry* e = mapFindStr(m, key, len, h, NULL);
     if (e) { e->value = v; return; }
-    e = (MapEntry*)malloc(sizeof(MapEntry)); if (!e) error("Memory allocation failed.", 0);
+    char* copy = strndup(key, len); if (!copy) error("Memory allocation failed.", 0);
+    e = mapAppend(m, h);
     e->isIntKey = false; e->intKey = 0;
-    e->key = strndup(key, len); if (!e->key) { free(e); error("Memory allocation failed.", 0);} 
-    e->value = v; e->next = m->buckets[b]; m->buckets[b] = e;
+    e->key = copy; e->keyLength = len;
+    e->value = v;
 }
 void mapSetInt(Map* m, int ikey, Value v) {
-    int b; MapEntry* e = mapFindEntryInt(m, ikey, &b);
+    if (m->vm) WRITE_BARRIER(m->vm, m);
+    MapEntry* e = mapFindEntryInt(m, ikey, NULL);
     if (e) { e->value = v; return; }
-    e = (MapEntry*)malloc(sizeof(MapEntry)); if (!e) error("Memory allocation failed.", 0);
-    e->isIntKey = true; e->intKey = ikey; e->key = NULL; e->value = v; e->next = m->buckets[b]; m->buckets[b] = e;
+    e = mapAppend(m, hashIntKey(ikey));
+    e->isIntKey = true; e->intKey = ikey; e->key = NULL; e->keyLength = 0; e->value = v;
 }
-/*
-static bool mapDeleteInt(Map* m, int ikey) {
-    unsigned int h = hashInt(ikey) % TABLE_SIZE;
-    MapEntry* entry = m->buckets[h];
-    MapEntry* prev = NULL;
-    while (entry) {
-        if (entry->isIntKey && entry->intKey == ikey) {
-            if (prev) prev->next = entry->next;
-            else m->buckets[h] = entry->next;
-            free(entry);
-            m->count--;
-            return true;
-        }
-        prev = entry;
-        entry = entry->next;
+
+// ---- Environment helpers ----
+Environment* newEnvironment(VM* vm, Environment* enclosing) {
+    Environment* env = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
+    env->enclosing = enclosing;
+    env->vars = NULL;
+    env->count = 0;
+    env->capacity = 0;
+    env->index = NULL;
+    env->indexCapacity = 0;
+    return env;
+}
+
+// Same layout as mapGrow; see there for the accounting rule
+static void envGrow(VM* vm, Environment* env, int indexCapacity) {
+    int capacity = indexCapacity / 4 * 3;
+    size_t oldBytes = (size_t)env->capacity * sizeof(VarEntry) + (size_t)env->indexCapacity * sizeof(int);
+    size_t newBytes = (size_t)capacity * sizeof(VarEntry) + (size_t)indexCapacity * sizeof(int);
+
+    VarEntry* vars = realloc(env->vars, sizeof(VarEntry) * capacity);
+    int* index = malloc(sizeof(int) * indexCapacity);
+    if (!vars || !index) error("Memory allocation failed.", 0);
+    for (int i = 0; i < indexCapacity; i++) index[i] = HASH_EMPTY_SLOT;
+
+    unsigned int mask = (unsigned int)indexCapacity - 1;
+    for (int i = 0; i < env->count; i++) {
+        unsigned int slot = vars[i].hash & mask;
+        while (index[slot] != HASH_EMPTY_SLOT) slot = (slot + 1) & mask;
+        index[slot] = i;
     }
-    return false;
+
+    free(env->index);
+    env->vars = vars;
+    env->index = index;
+    env->capacity = capacity;
+    env->indexCapacity = indexCapacity;
+    vm->bytesAllocated += newBytes - oldBytes;
 }
-*/
 
+// Look up a variable in this environment only (no enclosing walk)
+VarEntry* envFindEntry(Environment* env, const char* key, int length, unsigned int hash) {
+    if (!env || env->count == 0) return NULL;
+    unsigned int mask = (unsigned int)env->indexCapacity - 1;
+    for (unsigned int slot = hash & mask; env->index[slot] != HASH_EMPTY_SLOT; slot = (slot + 1) & mask) {
+        VarEntry* entry = &env->vars[env->index[slot]];
+        if (entry->key == key ||
+            (entry->hash == hash && entry->keyLength == length && memcmp(entry->key, key, length) == 0)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
 
-/*
-static bool mapDeleteStr(Map* m, const char* key, int len) {
-    unsigned int h = hash(key, len) % TABLE_SIZE;
-    // ... impl
-    return false;
+// Append a new slot for 'key' (caller checked it is absent)
+static VarEntry* envAppend(VM* vm, Environment* env, ObjString* key, Value value) {
+    if (env->count + 1 > env->capacity) {
+        envGrow(vm, env, env->indexCapacity ? env->indexCapacity * 2 : HASH_MIN_CAPACITY);
+    }
+    unsigned int mask = (unsigned int)env->indexCapacity - 1;
+    unsigned int slot = stringHash(key) & mask;
+    while (env->index[slot] != HASH_EMPTY_SLOT) slot = (slot + 1) & mask;
+    env->index[slot] = env->count;
+
+    VarEntry* entry = &env->vars[env->count++];
+    entry->key = key->chars;
+    entry->keyLength = key->length;
+    entry->hash = stringHash(key);
+    entry->keyString = key; // Store for GC marking
+    entry->value = value;
+    return entry;
 }
-*/
 
+// Define or assign 'key' in this environment; returns its slot
+VarEntry* envSet(VM* vm, Environment* env, ObjString* key, Value value) {
+    WRITE_BARRIER(vm, env);
+    VarEntry* entry = envFindEntry(env, key->chars, key->length, stringHash(key));
+    if (entry) {
+        entry->value = value;
+        return entry;
+    }
+    return envAppend(vm, env, key, value);
+}
 
+// Slot index of 'key', reserving an UNDEFINED_VAL slot if it is not defined yet.
+// Used by the compiler so global access is an indexed load.
+int envReserveSlot(VM* vm, Environment* env, ObjString* key) {
+    VarEntry* entry = envFindEntry(env, key->chars, key->length, stringHash(key));
+    if (!entry) entry = envAppend(vm, env, key, UNDEFINED_VAL);
+    return (int)(entry - env->vars);
+}
 
 // Forward declarations
 static Value evaluate(VM* vm, Node* node);
@@ -767,30 +1037,8 @@ void registerNativeFunction(VM* vm, const char* name, Value (*function)(VM*, Val
     if (!vm || !name || !*name || !function) {
         error("registerNativeFunction: invalid arguments.", 0);
     }
-    // Phase 2: Intern key for pointer lookup
-    char* key = internString(vm, name, (int)strlen(name))->chars;
-    
-    Token t; t.type = TOKEN_IDENTIFIER; t.start = key; t.length = (int)strlen(key); t.line = 0;
-    FuncEntry* entry = findFuncEntry(vm->globalEnv, t, true);
-    if (!entry) error("registerNativeFunction: failed to allocate function entry.", 0);
-    // Allocate or replace function
-    if (entry->function) {
-        free(entry->function);
-        entry->function = NULL;
-    }
-    Function* func = (Function*)malloc(sizeof(Function));
-    if (!func) error("Memory allocation failed.", 0);
-    // Set function name token to point to entry->key which is owned by the table
-    func->name.type = TOKEN_IDENTIFIER;
-    func->name.start = entry->key;
-    func->name.length = (int)strlen(entry->key);
-    func->name.line = 0;
-    func->params = NULL;
-    func->paramCount = 0; // not enforced for native
-    func->body = NULL;
-    func->closure = NULL;
-        func->native = function;
-    entry->function = func;
+    // Natives live in the global variable table like any other function value
+    defineNative(vm, vm->globalEnv, name, function, 0); // paramCount not enforced for native
 }
 
 // Helper to call a function
@@ -799,6 +1047,9 @@ Value callFunction(VM* vm, Function* func, Value* args, int argCount) {
         // Direct call to native C function
         return func->native(vm, args, argCount);
     }
+    if (func->bytecodeChunk) {
+        return callBytecodeFunction(vm, func, args, argCount);
+    }
     if (vm->callStackTop >= CALL_STACK_MAX) {
         error("Call stack overflow.", 0);
     }
@@ -808,10 +1059,7 @@ Value callFunction(VM* vm, Function* func, Value* args, int argCount) {
     // printf("Calling %.*s\n", func->name.length, func->name.start);
     
     // Create new environment for function execution
-    Environment* funcEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    funcEnv->enclosing = func->closure; // Lexical scoping from closure
-    memset(funcEnv->buckets, 0, sizeof(funcEnv->buckets));
-    memset(funcEnv->funcBuckets, 0, sizeof(funcEnv->funcBuckets));
+    Environment* funcEnv = newEnvironment(vm, func->closure); // Lexical scoping from closure
     
     // Check parameter count
     if (argCount != func->paramCount) {
@@ -820,7 +1068,7 @@ Value callFunction(VM* vm, Function* func, Value* args, int argCount) {
         error(errorMsg, 0);
     }
     // Check stack overflow
-    if (vm->stackTop + argCount + 64 > STACK_MAX) { // +64 safety margin
+    if (vm->stackTop + argCount + 64 > ROOT_STACK_MAX) { // +64 safety margin
         error("Stack overflow.", func->name.line); 
         return NIL_VAL;
     }
@@ -843,6 +1091,8 @@ Value callFunction(VM* vm, Function* func, Value* args, int argCount) {
     frame->hasReturned = false;
     frame->returnValue = NIL_VAL;
     frame->function = func; // Root the function
+    frame->chunk = NULL;
+    frame->regTop = 0;
     
     // Setup new frame
     vm->fp = oldStackTop; // New frame starts where arguments began
@@ -857,20 +1107,13 @@ Value callFunction(VM* vm, Function* func, Value* args, int argCount) {
     if (func->params) {
         for (int i = 0; i < argCount; i++) {
              Token param = func->params[i];
-             // Define in env (buckets)
+             // Define in env
              char buf[64];
              int len = param.length; if(len>63)len=63;
              memcpy(buf, param.start, len); buf[len]=0;
              
              ObjString* keyStrObj = internString(vm, buf, len);
-             VarEntry* ve = malloc(sizeof(VarEntry));
-             ve->key = keyStrObj->chars;
-             ve->keyString = keyStrObj; // Store for GC marking
-             ve->keyLength = len;
-             ve->ownsKey = false;
-             ve->value = args[i];
-             ve->next = funcEnv->buckets[hashPointer(ve->key)%TABLE_SIZE];
-             funcEnv->buckets[hashPointer(ve->key)%TABLE_SIZE] = ve;
+             envSet(vm, funcEnv, keyStrObj, args[i]);
         }
     }
     
@@ -911,6 +1154,10 @@ void printValue(Value val) {
             Obj* o = AS_OBJ(val);
             if (IS_STRING(val)) {
                 printf("%s", AS_CSTRING(val));
+            } else if (o->type == OBJ_STRING_BUILDER) {
+                fwrite(((StringBuilder*)o)->chars, 1, ((StringBuilder*)o)->length, stdout);
+            } else if (o->type == OBJ_STRING_SLICE) {
+                fwrite(((StringSlice*)o)->chars, 1, ((StringSlice*)o)->length, stdout);
             } else if (o->type == OBJ_ARRAY) {
                 // Print array contents
                 Array* arr = (Array*)o;
@@ -920,6 +1167,14 @@ void printValue(Value val) {
                     printValue(arr->items[i]);
                 }
                 printf("]");
+            } else if (o->type == OBJ_TYPED_ARRAY) {
+                TypedArray* ta = (TypedArray*)o;
+                printf("[");
+                for (int i = 0; i < ta->count; i++) {
+                    if (i > 0) printf(", ");
+                    printValue(typedArrayGet(ta, i));
+                }
+                printf("]");
             } else if (o->type == OBJ_MAP) {
                 printf("<map>");
             } else if (o->type == OBJ_FUNCTION) {
@@ -1032,7 +1287,9 @@ static void execute(VM* vm, Node* node) {
             if (IS_ARRAY(target) && IS_INT(idx)) {
                 Array* a = (Array*)AS_OBJ(target);
                 if (AS_INT(idx) >= 0 && AS_INT(idx) < a->count) {
+                    arrayWritable(vm, a);
                     a->items[AS_INT(idx)] = val;
+                    WRITE_BARRIER(vm, a);
                 } else {
                     error("Index out of bounds.", 0);
                 }
@@ -1123,6 +1380,12 @@ static void execute(VM* vm, Node* node) {
              func->closure = vm->env; // Capture current environment
              func->paramCount = node->function.paramCount;
              func->body = node->function.body;
+             func->params = node->function.params;
+             func->native = NULL;
+             func->isAsync = node->function.isAsync;
+             func->bytecodeChunk = NULL;
+             func->modulePath = NULL;
+             func->moduleEnv = NULL;
              
              Value v = OBJ_VAL(func);
              
@@ -1173,6 +1436,7 @@ static void execute(VM* vm, Node* node) {
                  }
                  if (idx != -1) {
                      inst->fields[idx] = val;
+                     WRITE_BARRIER(vm, inst);
                  } else {
                      error("Unknown field assignment.", 0);
                  }
@@ -1412,9 +1676,7 @@ static Value evaluate(VM* vm, Node* node) {
                      Value argVals[16]; int ac=0; Node* arg = node->call.arguments;
                      while(arg && ac < 16) { argVals[ac++] = evaluate(vm, arg); arg = arg->next; }
                      if (ac != def->fieldCount) error("Struct inst arg count mismatch", 0);
-                     StructInstance* inst = ALLOCATE_OBJ(vm, StructInstance, OBJ_STRUCT_INSTANCE);
-                     inst->def = def;
-                     inst->fields = malloc(sizeof(Value) * def->fieldCount);
+                     StructInstance* inst = newStructInstance(vm, def);
                      for(int i=0; i<def->fieldCount; i++) inst->fields[i] = argVals[i];
                      
                      Value v = OBJ_VAL(inst); return v;
@@ -1465,18 +1727,15 @@ static Value evaluate(VM* vm, Node* node) {
                      if (strcmp(fname, "keys")==0 && ac==1 && IS_MAP(args[0])) {
                          Map* m = (Map*)AS_OBJ(args[0]);
                          Array* a = newArray(vm);
-                         for(int i=0; i<TABLE_SIZE; i++) {
-                             MapEntry* e = m->buckets[i];
-                             while(e) {
-                                 Value k; 
-                                 if(e->isIntKey) { k = INT_VAL(e->intKey); }
-                                 else { 
-                                     ObjString* s = internString(vm, e->key, (int)strlen(e->key));
-                                     k = OBJ_VAL(s); 
-                                 }
-                                 arrayPush(vm, a, k);
-                                 e = e->next;
+                         for(int i=0; i<m->count; i++) {
+                             MapEntry* e = &m->entries[i];
+                             Value k; 
+                             if(e->isIntKey) { k = INT_VAL(e->intKey); }
+                             else { 
+                                 ObjString* s = internString(vm, e->key, e->keyLength);
+                                 k = OBJ_VAL(s); 
                              }
+                             arrayPush(vm, a, k);
                          }
                          Value v = OBJ_VAL(a); return v;
                      }
@@ -1568,17 +1827,55 @@ static Value evaluate(VM* vm, Node* node) {
 
 // Initialize VM
 void initVM(VM* vm) {
+    initVMWithRegisters(vm, STACK_MAX);
+}
+
+void initVMWithRegisters(VM* vm, int registers) {
     // Initialize GC State FIRST
+    initHeap(&vm->heap);
+    pthread_mutex_init(&vm->gcMutex, NULL);
+    vm->gcConcurrentActive = 0;
     vm->objects = NULL;
     vm->nursery = NULL;
     vm->nurseryCount = 0;
+    vm->remembered = NULL;
+    vm->rememberedCount = 0;
+    vm->rememberedCapacity = 0;
+    vm->sweepPending = NULL;
+    vm->sweepFreedBytes = 0;
+    vm->sweepStartBytes = 0;
+
+    // One marker per core (UNNARIZE_GC_THREADS overrides)
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    char* gcThreads = getenv("UNNARIZE_GC_THREADS");
+    if (gcThreads) cores = atol(gcThreads);
+    if (cores < 1) cores = 1;
+    if (cores > GC_MAX_MARK_THREADS) cores = GC_MAX_MARK_THREADS;
+    vm->gcMarkThreads = (int)cores;
+
+    // Baseline JIT on unless UNNARIZE_JIT=0
+    char* jit = getenv("UNNARIZE_JIT");
+    vm->jitEnabled = !jit || strcmp(jit, "0") != 0;
+
     vm->grayStack = NULL;
     vm->grayCount = 0;
     vm->grayCapacity = 0;
+    vm->pinned = NULL;
+    vm->pinnedCount = 0;
+    vm->pinnedCapacity = 0;
     vm->bytesAllocated = 0;
     vm->nextGC = 1024 * 1024; // Start GC at 1MB
 
 
+    // Main program's register file and call stack (tasks allocate their own)
+    if (registers < FRAME_REG_MAX) registers = FRAME_REG_MAX;
+    vm->regCapacity = registers;
+    vm->registers = calloc((size_t)registers, sizeof(Value));
+    vm->callStack = calloc(CALL_STACK_MAX, sizeof(CallFrame));
+    if (!vm->registers || !vm->callStack) {
+        error("Memory allocation failed for register file.", 0);
+    }
+
     vm->stackTop = 0;
     vm->callStackTop = 0;
     vm->fp = 0;
@@ -1586,19 +1883,18 @@ void initVM(VM* vm) {
     vm->regTop = 0;
 
     // Initialize entire register file to NIL_VAL to prevent GC from scanning garbage
-    for (int i = 0; i < STACK_MAX; i++) {
+    for (int i = 0; i < registers; i++) {
         vm->registers[i] = NIL_VAL;
     }
 
     vm->argc = 0;
     vm->argv = NULL;
+    vm->profiler = NULL;
+    vm->libStates = NULL;
     
     // Create global environment (Starts GC allocation!)
-    vm->globalEnv = ALLOCATE_OBJ(vm, Environment, OBJ_ENVIRONMENT);
-    vm->globalEnv->enclosing = NULL;
-    memset(vm->globalEnv->buckets, 0, sizeof(vm->globalEnv->buckets));
-    memset(vm->globalEnv->funcBuckets, 0, sizeof(vm->globalEnv->funcBuckets));
-    memset(vm->moduleBuckets, 0, sizeof(vm->moduleBuckets));
+    vm->globalEnv = newEnvironment(vm, NULL);
+    vm->imports = NULL;
     
     // Set current environment to global initially
     vm->env = vm->globalEnv;
@@ -1613,11 +1909,11 @@ void initVM(VM* vm) {
     for (int i = 0; i < TABLE_SIZE; i++) vm->externHandles[i] = NULL;
     
     // Initialize string pool for performance optimization
-    vm->stringPool.strings = malloc(64 * sizeof(char*));
-    vm->stringPool.hashes = malloc(64 * sizeof(unsigned int));
+    vm->stringPool.entries = calloc(STRING_POOL_MIN_CAPACITY, sizeof(ObjString*));
     vm->stringPool.count = 0;
-    vm->stringPool.capacity = 64;
-    if (!vm->stringPool.strings || !vm->stringPool.hashes) {
+    vm->stringPool.tombstones = 0;
+    vm->stringPool.capacity = STRING_POOL_MIN_CAPACITY;
+    if (!vm->stringPool.entries) {
         error("Memory allocation failed for string pool.", 0);
     }
     pthread_mutex_init(&vm->stringPool.lock, NULL);
@@ -1640,19 +1936,34 @@ void initVM(VM* vm) {
     vm->taskQueue = NULL;
     vm->taskCount = 0;
     vm->taskCapacity = 0;
+    vm->currentTask = NULL;
+    vm->suspendedExec = NULL;
     
     // Initialize GC statistics
     vm->gcPhase = 0;  // GC_IDLE
+    vm->gcMinorActive = false;
+    vm->gcDeferDepth = 0;
+    vm->gcDeferredNextGC = 0;
     vm->gcCollectCount = 0;
+    vm->gcMinorCount = 0;
     vm->gcTotalPauseUs = 0;
     vm->gcLastPauseUs = 0;
     vm->gcTotalFreed = 0;
     vm->gcPeakMemory = 0;
     vm->gcLastCollectTime = 0;
     vm->gcBytesAllocSinceGC = 0;
+    vm->gcMaxPauseUs = 0;
+    memset(vm->gcPauseHistogram, 0, sizeof(vm->gcPauseHistogram));
+    struct timespec startTs;
+    clock_gettime(CLOCK_MONOTONIC, &startTs);
+    vm->gcStartTimeUs = (uint64_t)startTs.tv_sec * 1000000ULL + (uint64_t)startTs.tv_nsec / 1000ULL;
+    vm->gcTargetPauseUs = 0;
+    vm->gcIncrementalUnits = 1000;
+    vm->gcMaxHeadroom = 0;
     
     // Generational GC
-    vm->nurseryThreshold = 1000;  // Minor GC after 1000 young objects
+    vm->nurseryBudget = 1024 * 1024;  // Minor GC after 1MB of allocation
+    vm->nextMajorGC = vm->nextGC;
 
 }
 
@@ -1660,11 +1971,11 @@ void initVM(VM* vm) {
 // Old freeVM implementation removed (consolidated above)
 
 // Interpret AST
-void interpret(VM* vm, Node* ast) {
+void interpret(VM* vm, Parser* parser, Node* ast) {
     if (!ast) return;
     
-    // Phase 0: Intern Strings (Critical for hashPointer)
-    internAST(vm, ast);
+    // Phase 0: Intern Strings
+    internAST(vm, parser);
     
     // Phase 1: Resolve Locals (Calculate stack slots)
     if (!resolveAST(vm, ast)) {
@@ -1676,107 +1987,42 @@ void interpret(VM* vm, Node* ast) {
 }// Define a global variable with interning
 void defineGlobal(VM* vm, const char* name, Value value) {
     ObjString* keyObj = internString(vm, name, (int)strlen(name));
-    char* key = keyObj->chars;
-    unsigned int h = keyObj->hash % TABLE_SIZE;
-    
-    // Check if exists
-    VarEntry* entry = vm->globalEnv->buckets[h];
-    while (entry) {
-        if (entry->key == key) {
-            entry->value = value;
-            return;
-        }
-        entry = entry->next;
-    }
-    
-    // Create new
-    entry = malloc(sizeof(VarEntry));
-    if (!entry) error("Memory allocation failed.", 0);
-    entry->key = key;
-    entry->keyString = keyObj; // Store for GC marking
-    entry->keyLength = (int)strlen(key);
-    entry->ownsKey = false;
-    entry->value = value;
-    entry->next = vm->globalEnv->buckets[h];
-    vm->globalEnv->buckets[h] = entry;
+    envSet(vm, vm->globalEnv, keyObj, value);
 }
 
 // Helper to define variable in current environment (for hybrid stack/env)
 static void defineInEnv(VM* vm, Environment* env, Token name, Value value) {
     if (!env) return;
-    (void)vm;
-    // name.start is interned
-    unsigned int h = hashPointer(name.start) % TABLE_SIZE;
-    
-    // Check/Update existing in this env
-    VarEntry* entry = env->buckets[h];
-    while (entry) {
-        if (entry->key == name.start) {
-            entry->value = value;
-            return;
-        }
-        entry = entry->next;
-    }
-    
-    // Create new
-    entry = malloc(sizeof(VarEntry));
-    if (!entry) error("Memory allocation failed.", name.line);
-    entry->key = (char*)name.start;
-    entry->keyString = NULL; // Cannot get ObjString from Token here
-    entry->keyLength = name.length;
-    entry->ownsKey = false;
-    entry->value = value;
-    entry->next = env->buckets[h];
-    env->buckets[h] = entry;
+    ObjString* keyObj = internString(vm, name.start, name.length);
+    envSet(vm, env, keyObj, value);
 }
 
 // Define a native function in a specific environment with interning
-void defineNative(VM* vm, Environment* env, const char* name, NativeFn fn, int arity) {
+Function* defineNative(VM* vm, Environment* env, const char* name, NativeFn fn, int arity) {
     ObjString* keyObj = internString(vm, name, (int)strlen(name));
     char* key = keyObj->chars;
-    unsigned int h = keyObj->hash % TABLE_SIZE;
-    
-    FuncEntry* fe = malloc(sizeof(FuncEntry));
-    fe->key = key;
-    fe->keyString = keyObj; // Store for GC marking
-    fe->next = env->funcBuckets[h];
-    env->funcBuckets[h] = fe;
+    vm->stack[vm->stackTop++] = OBJ_VAL(keyObj); // Root key across the allocation
     
     Function* func = ALLOCATE_OBJ(vm, Function, OBJ_FUNCTION);
+    vm->stackTop--;
     func->isNative = true;
     func->native = fn;
+    func->keepsViews = false;
     func->paramCount = arity;
     func->name = (Token){TOKEN_IDENTIFIER, key, (int)strlen(key), 0};
     func->body = NULL;
     func->closure = NULL;
+    func->params = NULL;
+    func->isAsync = false;
+    func->bytecodeChunk = NULL;
+    func->modulePath = NULL;
+    func->moduleEnv = NULL;
     func->obj.isMarked = true; // PERMANENT ROOT
     func->obj.isPermanent = true; // Never sweep
-    
-    fe->function = func;
 
-    // ALSO register as a variable for Bytecode VM (OP_LOAD_GLOBAL checks variable buckets)
-    // We treat the function as a first-class object value
-    Value funcVal = OBJ_VAL(func);
-    
-    // Check/Update existing in this env
-    VarEntry* ve = env->buckets[h];
-    while (ve) {
-        if (ve->key == key) {
-            ve->value = funcVal;
-            return;
-        }
-        ve = ve->next;
-    }
-    
-    // Create new variable entry
-    ve = malloc(sizeof(VarEntry));
-    ve->key = key;
-    ve->keyString = keyObj; // Store for GC marking
-    ve->keyLength = (int)strlen(key);
-    ve->ownsKey = false;
-    ve->value = funcVal;
-    ve->next = env->buckets[h];
-    env->buckets[h] = ve;
+    // Functions are first-class values in the variable table (OP_GETGLOBAL/GETPROP find them there)
+    envSet(vm, env, keyObj, OBJ_VAL(func));
+    return func;
 }
 
 // --- Built-in Natives Implementation ---
@@ -1803,19 +2049,20 @@ static Value nativeKeys(VM* vm, Value* args, int argCount) {
     
     Map* map = (Map*)AS_OBJ(args[0]);
     Array* keys = newArray(vm);
-    
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        MapEntry* e = map->buckets[i];
-        while (e) {
-            if (e->key) {
-                 ObjString* s = internString(vm, e->key, (int)strlen(e->key));
-                 arrayPush(vm, keys, OBJ_VAL(s));
-            } else if (e->isIntKey) {
-                 arrayPush(vm, keys, INT_VAL(e->intKey));
-            }
-            e = e->next;
+    vm->stack[vm->stackTop++] = OBJ_VAL(keys); // Interning and growth may collect
+    
+    for (int i = 0; i < map->count; i++) {
+        MapEntry* e = &map->entries[i];
+        if (e->key) {
+             ObjString* s = internString(vm, e->key, e->keyLength);
+             vm->stack[vm->stackTop++] = OBJ_VAL(s);
+             arrayPush(vm, keys, OBJ_VAL(s));
+             vm->stackTop--;
+        } else if (e->isIntKey) {
+             arrayPush(vm, keys, INT_VAL(e->intKey));
         }
     }
+    vm->stackTop--;
     return OBJ_VAL(keys);
 }
 
@@ -1823,7 +2070,9 @@ static Value nativeLength(VM* vm, Value* args, int argCount) {
     (void)vm; // Unused parameter
     if (argCount != 1) return NIL_VAL;
     if (IS_STRING(args[0])) return INT_VAL(((ObjString*)AS_OBJ(args[0]))->length);
+    if (IS_STRING_SLICE(args[0])) return INT_VAL(AS_STRING_SLICE(args[0])->length);
     if (IS_ARRAY(args[0])) return INT_VAL(((Array*)AS_OBJ(args[0]))->count);
+    if (IS_TYPED_ARRAY(args[0])) return INT_VAL(AS_TYPED_ARRAY(args[0])->count);
     return INT_VAL(0);
 }
 
@@ -1844,12 +2093,38 @@ static Value nativePop(VM* vm, Value* args, int argCount) {
     return NIL_VAL;
 }
 
+// Items or characters start..end-1 (end defaults to the length) as a view.
+// Negative bounds count from the end.
+static Value sliceValue(VM* vm, Value* args, int argCount, bool arrays, const char* usage) {
+    if (argCount < 2 || argCount > 3 || !IS_INT(args[1]) || (argCount == 3 && !IS_INT(args[2]))) {
+        printf("Error: %s.\n", usage);
+        return NIL_VAL;
+    }
+    int start = AS_INT(args[1]);
+    int end = argCount == 3 ? AS_INT(args[2]) : INT32_MAX;
+    if (arrays && IS_ARRAY(args[0])) return OBJ_VAL(arraySlice(vm, (Array*)AS_OBJ(args[0]), start, end));
+    if (IS_STRING_BUILDER(args[0])) args[0] = OBJ_VAL(flattenBuilder(vm, AS_STRING_BUILDER(args[0])));
+    if (IS_STRING(args[0]) || IS_STRING_SLICE(args[0])) return stringSlice(vm, args[0], start, end);
+    printf("Error: %s.\n", usage);
+    return NIL_VAL;
+}
+
+static Value nativeSlice(VM* vm, Value* args, int argCount) {
+    return sliceValue(vm, args, argCount, true, "slice expects (array or string, start, end?)");
+}
+
+static Value nativeSubstr(VM* vm, Value* args, int argCount) {
+    return sliceValue(vm, args, argCount, false, "substr expects (string, start, end?)");
+}
+
 void registerBuiltins(VM* vm) {
     defineNative(vm, vm->globalEnv, "has", nativeHas, 2);
     defineNative(vm, vm->globalEnv, "keys", nativeKeys, 1);
     defineNative(vm, vm->globalEnv, "length", nativeLength, 1);
     defineNative(vm, vm->globalEnv, "push", nativePush, 2);
     defineNative(vm, vm->globalEnv, "pop", nativePop, 1);
+    defineNative(vm, vm->globalEnv, "slice", nativeSlice, 3)->keepsViews = true;
+    defineNative(vm, vm->globalEnv, "substr", nativeSubstr, 3)->keepsViews = true;
 }
 
 // String concatenation helper (exposed for VM)
@@ -0,0 +1,238 @@
+#!/bin/bash
+
+# Unnarize Benchmark Suite
+# Runs each script in examples/benchmark/suite/ in a fresh process: warm-up
+# runs first, then timed trials. Each script times its own run() and prints
+# "result <checksum>" and "time <ms>". Median, p95, min, max and mean go to a
+# JSON file, which can be compared against a saved baseline.
+#
+#   bench.sh [--trials N] [--warmup N] [--only a,b] [--out FILE]
+#            [--label TEXT] [--compare BASELINE] [--threshold PCT]
+#   bench.sh --diff BASELINE RESULTS [--threshold PCT]
+#
+# --compare and --diff exit with status 1 if any median is more than
+# --threshold percent (default 10) slower than the baseline's.
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(cd "$SCRIPT_DIR/../.." && pwd)"
+SUITE_DIR="$SCRIPT_DIR/suite"
+BIN="${UNNARIZE_BIN:-$ROOT_DIR/bin/unnarize}"
+
+BENCHMARKS="dispatch calls property intern map gc_churn json uon http"
+TRIALS=10
+WARMUP=2
+ONLY=""
+OUT="$SCRIPT_DIR/results/latest.json"
+LABEL=""
+BASELINE=""
+THRESHOLD=10
+DIFF_NEW=""
+HTTP_PORT="${BENCH_HTTP_PORT:-18931}"
+
+usage() {
+    sed -n '9,14p' "${BASH_SOURCE[0]}" | sed 's/^# \{0,1\}//'
+    exit 2
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --trials)    TRIALS="$2"; shift 2 ;;
+        --warmup)    WARMUP="$2"; shift 2 ;;
+        --only)      ONLY="$2"; shift 2 ;;
+        --out)       OUT="$2"; shift 2 ;;
+        --label)     LABEL="$2"; shift 2 ;;
+        --compare)   BASELINE="$2"; shift 2 ;;
+        --threshold) THRESHOLD="$2"; shift 2 ;;
+        --diff)      BASELINE="$2"; DIFF_NEW="$3"; shift 3 ;;
+        *)           usage ;;
+    esac
+done
+
+# Print one line per benchmark of a results file: name median p95 result
+read_results() {
+    grep -o '"[a-z_]*": {"median_ms": [0-9.]*, "p95_ms": [0-9.]*[^}]*"result": "[^"]*"' "$1" |
+        sed 's/^"\([a-z_]*\)": {"median_ms": \([0-9.]*\), "p95_ms": \([0-9.]*\).*"result": "\([^"]*\)"/\1 \2 \3 \4/'
+}
+
+# Compare two results files; status 1 on a regression
+compare_results() {
+    local base="$1" new="$2"
+    if [ ! -f "$base" ]; then
+        echo "Error: Baseline \"$base\" not found."
+        return 2
+    fi
+    echo ""
+    echo "Comparing against $base (threshold ${THRESHOLD}%)"
+    awk -v threshold="$THRESHOLD" '
+        NR == FNR { median[$1] = $2; p95[$1] = $3; result[$1] = $4; next }
+        {
+            name = $1
+            if (!(name in median)) {
+                printf "  %-10s %10s %10.2f %9s  %s\n", name, "-", $2, "-", "new"
+                next
+            }
+            change = median[name] > 0 ? ($2 - median[name]) * 100 / median[name] : 0
+            status = "ok"
+            if (change > threshold) { status = "REGRESSION"; failed = 1 }
+            else if (change < -threshold) status = "faster"
+            if ($4 != result[name]) status = status ", result changed"
+            printf "  %-10s %10.2f %10.2f %+8.1f%%  %s\n", name, median[name], $2, change, status
+        }
+        BEGIN { printf "  %-10s %10s %10s %9s  %s\n", "benchmark", "base ms", "new ms", "change", "status" }
+        END { exit failed }
+    ' <(read_results "$base") <(read_results "$new")
+}
+
+if [ -n "$DIFF_NEW" ]; then
+    compare_results "$BASELINE" "$DIFF_NEW"
+    exit $?
+fi
+
+if [ ! -x "$BIN" ]; then
+    echo "Error: Binary not found at $BIN. Please run 'make' first."
+    exit 1
+fi
+
+# A JSON string literal for $1: backslashes, quotes and control characters
+# escaped, so a --label or CPU name cannot break the results file
+json_string() {
+    local s="${1//\\/\\\\}"
+    s="${s//\"/\\\"}"
+    s="${s//$'\n'/\\n}"
+    s="${s//$'\r'/\\r}"
+    s="${s//$'\t'/\\t}"
+    s="$(printf '%s' "$s" | tr -d '\000-\037')"
+    printf '"%s"' "$s"
+}
+
+# Sorted samples on stdin -> "median p95 min max mean"
+summarize() {
+    sort -n | awk '
+        { v[NR] = $1; sum += $1 }
+        END {
+            if (NR == 0) { print "0 0 0 0 0"; exit }
+            median = NR % 2 ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2
+            rank = int(0.95 * NR); if (rank < 0.95 * NR) rank++
+            printf "%.3f %.3f %.3f %.3f %.3f\n", median, v[rank], v[1], v[NR], sum / NR
+        }'
+}
+
+SERVER_PID=""
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=""
+    fi
+}
+trap stop_server EXIT
+
+# The http benchmark needs its server; returns 1 if it never answers
+start_server() {
+    "$BIN" "$SUITE_DIR/http_server.unna" "$HTTP_PORT" > /dev/null 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 50); do
+        if (exec 3<>"/dev/tcp/127.0.0.1/$HTTP_PORT") 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    stop_server
+    return 1
+}
+
+echo "=========================================================="
+echo "   Unnarize Benchmark Suite"
+echo "=========================================================="
+echo "Binary : $BIN"
+echo "Trials : $TRIALS (after $WARMUP warm-up runs)"
+echo ""
+printf "  %-10s %10s %10s %10s %10s\n" "benchmark" "median ms" "p95 ms" "min ms" "max ms"
+
+ENTRIES=""
+FAILED=0
+for name in $BENCHMARKS; do
+    if [ -n "$ONLY" ] && [[ ",$ONLY," != *",$name,"* ]]; then
+        continue
+    fi
+    args=()
+    if [ "$name" = "http" ]; then
+        if ! start_server; then
+            printf "  %-10s skipped (server did not start on port %s)\n" "$name" "$HTTP_PORT"
+            continue
+        fi
+        args=("$HTTP_PORT")
+    fi
+
+    samples=""
+    walls=""
+    result=""
+    ok=1
+    for run in $(seq $((WARMUP + TRIALS))); do
+        start=$(date +%s%N)
+        output=$("$BIN" "$SUITE_DIR/$name.unna" "${args[@]}" 2>&1)
+        status=$?
+        end=$(date +%s%N)
+        time=$(echo "$output" | sed -n 's/^time //p')
+        res=$(echo "$output" | sed -n 's/^result //p')
+        if [ $status -ne 0 ] || [ -z "$time" ]; then
+            printf "  %-10s FAILED (exit %d)\n" "$name" "$status"
+            echo "$output" | tail -n 5 | sed 's/^/      /'
+            ok=0
+            break
+        fi
+        if [ -n "$result" ] && [ "$res" != "$result" ]; then
+            printf "  %-10s FAILED (result changed between runs: %s, %s)\n" "$name" "$result" "$res"
+            ok=0
+            break
+        fi
+        result="$res"
+        if [ "$run" -gt "$WARMUP" ]; then
+            samples="$samples $time"
+            walls="$walls $(( (end - start) / 1000 ))"
+        fi
+    done
+    [ "$name" = "http" ] && stop_server
+    if [ $ok -eq 0 ]; then
+        FAILED=1
+        continue
+    fi
+
+    read -r median p95 min max mean <<< "$(echo $samples | tr ' ' '\n' | summarize)"
+    wall=$(echo $walls | tr ' ' '\n' | summarize | awk '{ printf "%.3f", $1 / 1000 }')
+    printf "  %-10s %10s %10s %10s %10s\n" "$name" "$median" "$p95" "$min" "$max"
+
+    list=$(echo $samples | awk '{ for (i = 1; i <= NF; i++) printf "%s%.3f", (i > 1 ? ", " : ""), $i }')
+    entry="    \"$name\": {\"median_ms\": $median, \"p95_ms\": $p95, \"min_ms\": $min, \"max_ms\": $max"
+    entry="$entry, \"mean_ms\": $mean, \"wall_median_ms\": $wall, \"samples_ms\": [$list], \"result\": \"$result\"}"
+    if [ -n "$ENTRIES" ]; then ENTRIES="$ENTRIES,"$'\n'; fi
+    ENTRIES="$ENTRIES$entry"
+done
+
+# Results: one benchmark per line so the file diffs cleanly
+CPU_INFO=$(grep "model name" /proc/cpuinfo | head -n 1 | cut -d ':' -f 2 | xargs)
+VERSION=$("$BIN" --version 2>/dev/null | awk '{ print $2 }')
+COMMIT=$(git -C "$ROOT_DIR" rev-parse --short HEAD 2>/dev/null)
+mkdir -p "$(dirname "$OUT")"
+{
+    echo "{"
+    echo "  \"label\": $(json_string "${LABEL:-$COMMIT}"),"
+    echo "  \"version\": $(json_string "$VERSION"),"
+    echo "  \"commit\": $(json_string "$COMMIT"),"
+    echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+    echo "  \"cpu\": $(json_string "$CPU_INFO"),"
+    echo "  \"trials\": $TRIALS,"
+    echo "  \"warmup\": $WARMUP,"
+    echo "  \"benchmarks\": {"
+    [ -n "$ENTRIES" ] && echo "$ENTRIES"
+    echo "  }"
+    echo "}"
+} > "$OUT"
+rm -f "$SUITE_DIR/bench_data.uon"
+echo ""
+echo "Results written to $OUT"
+
+if [ -n "$BASELINE" ]; then
+    compare_results "$BASELINE" "$OUT" || FAILED=1
+fi
+exit $FAILED
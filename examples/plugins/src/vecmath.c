@@ -0,0 +1,120 @@
+// Example native extension: numeric kernels over typed and regular arrays.
+// Build with "make plugins", then: import "./build/vecmath.so" as vec;
+#include "extern.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+static const UnnaApi* unna;
+
+// Elements of a Float64Array, Int32Array or array of numbers, as doubles
+static double* numbers(UnnaValue v, int* count) {
+    UnnaTypedView t;
+    UnnaArrayView a;
+    if (unna->typedView(v, &t)) {
+        double* out = malloc(sizeof(double) * (size_t)(t.count ? t.count : 1));
+        for (int i = 0; i < t.count; i++) {
+            out[i] = t.kind == UNNA_FLOAT64 ? ((double*)t.data)[i] : ((int32_t*)t.data)[i];
+        }
+        *count = t.count;
+        return out;
+    }
+    if (unna->arrayView(v, &a)) {
+        double* out = malloc(sizeof(double) * (size_t)(a.count ? a.count : 1));
+        for (int i = 0; i < a.count; i++) out[i] = unnaAsNumber(a.items[i]);
+        *count = a.count;
+        return out;
+    }
+    return NULL;
+}
+
+// dot(a, b) -> float; Float64Arrays are read in place
+static UnnaValue vec_dot(UnnaVM* vm, UnnaValue* args, int argCount) {
+    UnnaTypedView a, b;
+    if (argCount == 2 && unna->typedView(args[0], &a) && unna->typedView(args[1], &b) &&
+        a.kind == UNNA_FLOAT64 && b.kind == UNNA_FLOAT64 && a.count == b.count) {
+        const double* x = a.data;
+        const double* y = b.data;
+        double sum = 0;
+        for (int i = 0; i < a.count; i++) sum += x[i] * y[i];
+        return unnaFloat(sum);
+    }
+    int n = 0, m = 0;
+    double* x = argCount == 2 ? numbers(args[0], &n) : NULL;
+    double* y = argCount == 2 ? numbers(args[1], &m) : NULL;
+    if (!x || !y || n != m) {
+        free(x);
+        free(y);
+        unna->error(vm, "vecmath.dot(a, b) expects two arrays of the same length.");
+        return UNNA_NIL;
+    }
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += x[i] * y[i];
+    free(x);
+    free(y);
+    return unnaFloat(sum);
+}
+
+// stats(a) -> map with min, max and mean (nil if empty)
+static UnnaValue vec_stats(UnnaVM* vm, UnnaValue* args, int argCount) {
+    int n = 0;
+    double* x = argCount == 1 ? numbers(args[0], &n) : NULL;
+    if (!x) {
+        unna->error(vm, "vecmath.stats(a) expects an array.");
+        return UNNA_NIL;
+    }
+    if (n == 0) {
+        free(x);
+        return UNNA_NIL;
+    }
+    double lo = x[0], hi = x[0], sum = 0;
+    for (int i = 0; i < n; i++) {
+        if (x[i] < lo) lo = x[i];
+        if (x[i] > hi) hi = x[i];
+        sum += x[i];
+    }
+    free(x);
+    UnnaStringView keys[] = { { "min", 3 }, { "max", 3 }, { "mean", 4 } };
+    UnnaValue values[] = { unnaFloat(lo), unnaFloat(hi), unnaFloat(sum / n) };
+    return unna->newMap(vm, keys, values, 3);
+}
+
+// words(text) -> array of the whitespace-separated words
+static UnnaValue vec_words(UnnaVM* vm, UnnaValue* args, int argCount) {
+    UnnaStringView text;
+    if (argCount != 1 || !unna->stringView(args[0], &text)) {
+        unna->error(vm, "vecmath.words(text) expects a string.");
+        return UNNA_NIL;
+    }
+    int cap = 16, count = 0;
+    UnnaValue* words = malloc(sizeof(UnnaValue) * (size_t)cap);
+    unna->deferGC(vm); // The new strings are not rooted until the array holds them
+    for (int i = 0; i < text.length;) {
+        while (i < text.length && isspace((unsigned char)text.chars[i])) i++;
+        int start = i;
+        while (i < text.length && !isspace((unsigned char)text.chars[i])) i++;
+        if (i == start) break;
+        if (count == cap) words = realloc(words, sizeof(UnnaValue) * (size_t)(cap *= 2));
+        words[count++] = unna->newString(vm, text.chars + start, i - start);
+    }
+    UnnaValue result = unna->newArray(vm, words, count);
+    unna->resumeGC(vm);
+    free(words);
+    return result;
+}
+
+static bool init(UnnaVM* vm, const UnnaApi* api) {
+    (void)vm;
+    unna = api;
+    return true;
+}
+
+static const UnnaFunction functions[] = {
+    { "dot", vec_dot, 2 },
+    { "stats", vec_stats, 1 },
+    { "words", vec_words, 1 },
+    { NULL, NULL, 0 }
+};
+
+UNNA_EXPORT const UnnaExtension unnaExtension = {
+    UNNA_ABI_VERSION, "vecmath", functions, init
+};